@@ -217,6 +217,54 @@ int Buddy_load_parameter_from_conf(config_file_t in_config,
 
           out_parameter->keep_minimum = keep_min;
 
+        }
+      else if(!STRCMP(key_name, "Thread_Cache_Size"))
+        {
+          size_t cache_size;
+
+          if(s_read_size(key_value, &cache_size))
+            {
+              LogCrit(COMPONENT_MEMALLOC,
+                      "BUDDY LOAD PARAMETER: ERROR: Unexpected value for %s: size expected.",
+                      key_name);
+              return BUDDY_ERR_EINVAL;
+            }
+
+          out_parameter->thread_cache_size = cache_size;
+
+        }
+      else if(!STRCMP(key_name, "Large_Cache_Count"))
+        {
+
+          int count = s_read_int(key_value);
+
+          if(count < 0)
+            {
+              LogCrit(COMPONENT_MEMALLOC,
+                      "BUDDY LOAD PARAMETER: ERROR: Unexpected value for %s: null or positive integer expected.",
+                      key_name);
+              return BUDDY_ERR_EINVAL;
+            }
+
+          out_parameter->large_cache_count = count;
+
+        }
+      else if(!STRCMP(key_name, "Enable_Huge_Pages"))
+        {
+          int bool;
+
+          bool = StrToBoolean(key_value);
+
+          if(bool == -1)
+            {
+              LogCrit(COMPONENT_MEMALLOC,
+                      "BUDDY LOAD PARAMETER: ERROR: Unexpected value for %s: boolean expected.",
+                      key_name);
+              return BUDDY_ERR_EINVAL;
+            }
+
+          out_parameter->huge_pages = bool;
+
         }
       else if(!STRCMP(key_name, "LogFile"))
         {
@@ -49,10 +49,12 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <sys/mman.h>
 
 /* to detect memory corruption */
 #define MAGIC_NUMBER_FREE   0xF4EEB10C
 #define MAGIC_NUMBER_USED   0x1D0BE1AE
+#define MAGIC_NUMBER_CACHED 0xCAC4EB10
 
 #define P( _mutex_ ) pthread_mutex_lock( &_mutex_ )
 #define V( _mutex_ ) pthread_mutex_unlock( &_mutex_ )
@@ -60,6 +62,22 @@
 /* type to hold address differences in buddy */
 #define BUDDY_PTRDIFF_T  ptrdiff_t
 
+/* Freed blocks up to 2^BUDDY_CACHE_MAX_LOG2 bytes are kept in the thread cache */
+#define BUDDY_CACHE_MAX_LOG2   16
+
+/* Max number of extra blocks in the thread cache */
+#define BUDDY_LARGE_CACHE_MAX  16
+
+/* Extra blocks are rounded to this size, so that they can be reused */
+#define BUDDY_LARGE_GRANULARITY  (64 * 1024)
+
+/* Size of a huge page, extra blocks of half of it or more may be mapped in huge pages */
+#define BUDDY_HUGE_PAGE_SIZE     (2 * 1024 * 1024)
+
+/* One labeled allocation out of BUDDY_LABEL_SAMPLING is counted */
+#define BUDDY_LABEL_SAMPLING   64
+#define BUDDY_LABEL_SAMPLES    64
+
 /** Default configuration for Buddy. */
 
 buddy_parameter_t default_buddy_parameter = {
@@ -70,6 +88,9 @@ buddy_parameter_t default_buddy_parameter = {
   .keep_factor      = 3,         /* keep at least 3x the number of used pages */
   .keep_minimum     = 5,         /* Never decrease under 5 allocated pages
                                   * if this value is overcome. */
+  .thread_cache_size = 1048576LL, /* Keep up to 1MB of freed small blocks */
+  .large_cache_count = 4,        /* Keep up to 4 freed extra blocks */
+  .huge_pages       = FALSE,     /* Extra blocks are not mapped in huge pages */
 };
 
 /* ------------------------------------------*
@@ -130,8 +151,9 @@ typedef struct BuddyHeader_t
   const char *label_func;
   unsigned int label_line;
 
-  /* pointer to the next allocated block */
+  /* pointer to the next and previous allocated blocks */
   BuddyBlockPtr_t p_next_allocated;
+  BuddyBlockPtr_t p_prev_allocated;
 
 #ifndef _NO_BLOCK_PREALLOC
   struct prealloc_header *pa_entry;
@@ -148,6 +170,10 @@ typedef struct BuddyHeader_t
   /* Indicate the status for this block. */
   BuddyBlockStatus_t status;
 
+  /* For extra blocks: TRUE if mapped in huge pages
+   * (the thread that frees it may not use them). */
+  unsigned int HugeMapped;
+
 } BuddyHeader_t;
 
 /* aliases */
@@ -187,6 +213,14 @@ typedef struct BuddyBlock_t
 #define BUDDY_MAX_LOG2_SIZE  64
 /* allowed buddyMalloc sizes are from 2^0 to 2^63 */
 
+/** Sampled allocations for a label */
+typedef struct BuddyLabelSample_t
+{
+  const char *label;
+  unsigned long samples;
+  unsigned long long bytes;
+} BuddyLabelSample_t;
+
 /** Thread context */
 typedef struct BuddyThreadContext_t
 {
@@ -208,6 +242,17 @@ typedef struct BuddyThreadContext_t
   /* Memory Map for this thread */
   BuddyBlockPtr_t MemDesc[BUDDY_MAX_LOG2_SIZE];
 
+  /* Thread cache: freed blocks kept reserved, by size */
+  BuddyBlockPtr_t Cache[BUDDY_CACHE_MAX_LOG2 + 1];
+
+  /* Thread cache: freed extra blocks */
+  BuddyBlockPtr_t LargeCache[BUDDY_LARGE_CACHE_MAX];
+  unsigned int NbLargeCached;
+
+  /* Sampled allocations by label */
+  unsigned int LabelTick;
+  BuddyLabelSample_t LabelSamples[BUDDY_LABEL_SAMPLES];
+
   /* Error code for this thread */
   int Errno;
 
@@ -296,14 +341,16 @@ void ShowAllContext()
   for (context = first_context; context != NULL; context = context->next)
     {
       total += context->Stats.TotalMemSpace;
-      used += context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace;
+      used += context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace -
+          context->Stats.LargeCachedSpace;
       count++;
       LogDebug(COMPONENT_MEMALLOC,
                "Context for thread %s (%p) Total Mem Space: %lld MB Used: %lld MB",
                context->label_thread,
                (caddr_t)context->OwnerThread,
                (unsigned long long) context->Stats.TotalMemSpace / 1024 / 1024,
-               (unsigned long long) (context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace) / 1024 / 1024);
+               (unsigned long long) (context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace -
+                                      context->Stats.LargeCachedSpace) / 1024 / 1024);
     }
 
   LogDebug(COMPONENT_MEMALLOC,
@@ -475,39 +522,33 @@ static void add_allocated_block(BuddyThreadContext_t * context, BuddyBlock_t * p
 {
   /* insert block as first entry */
   p_block->Header.p_next_allocated = context->p_allocated;
+  p_block->Header.p_prev_allocated = NULL;
+  if(context->p_allocated != NULL)
+    context->p_allocated->Header.p_prev_allocated = p_block;
   context->p_allocated = p_block;
 }
 
 static void remove_allocated_block(BuddyThreadContext_t * context, BuddyBlock_t * p_block)
 {
-  BuddyBlockPtr_t p_prev_block;
-  BuddyBlockPtr_t p_curr_block;
-
-  p_prev_block = NULL;
-
-  /* browsing allocated blocks list */
-  for(p_curr_block = context->p_allocated;
-      p_curr_block != NULL; p_curr_block = p_curr_block->Header.p_next_allocated)
+  /* the list is doubly linked, no need to browse it */
+  if(p_block->Header.p_prev_allocated == NULL)
     {
-      /* the block to be removed */
-      if(p_curr_block == p_block)
-        {
-          /* if the block is the first of the list */
-          if(p_prev_block == NULL)
-            {
-              context->p_allocated = p_curr_block->Header.p_next_allocated;
-            }
-          else
-            {
-              p_prev_block->Header.p_next_allocated
-                  = p_curr_block->Header.p_next_allocated;
-            }
-          /* useless, but safer */
-          p_curr_block->Header.p_next_allocated = NULL;
-          break;
-        }
-      p_prev_block = p_curr_block;
+      /* not in the list */
+      if(context->p_allocated != p_block)
+        return;
+      context->p_allocated = p_block->Header.p_next_allocated;
     }
+  else
+    p_block->Header.p_prev_allocated->Header.p_next_allocated
+        = p_block->Header.p_next_allocated;
+
+  if(p_block->Header.p_next_allocated != NULL)
+    p_block->Header.p_next_allocated->Header.p_prev_allocated
+        = p_block->Header.p_prev_allocated;
+
+  /* useless, but safer */
+  p_block->Header.p_next_allocated = NULL;
+  p_block->Header.p_prev_allocated = NULL;
 }
 
 /* find the block that is just before another */
@@ -995,15 +1036,25 @@ static void Garbage_StdPages(BuddyThreadContext_t * context,
 
 }
 
+/* Macro used to determine if it is a extra block or not (for BuddyFree) */
+#define IS_EXTRA_BLOCK( _p_block_ ) ( (_p_block_)->Header.Base_ptr == NULL )
+
+/* Extra blocks of (rounded) size of a huge page or more are mapped, not malloc'ed */
+#define IS_HUGE_EXTRA_SIZE( _context_, _size_ ) \
+  ( (_context_)->Config.huge_pages && (_size_) >= BUDDY_HUGE_PAGE_SIZE )
+
 /**
  * AllocLargeBlock:
  * Allocates blocks that are larger than the standard page size.
+ * Freed blocks kept by the thread are reused first.
  */
 BUDDY_ADDR_T AllocLargeBlock(BuddyThreadContext_t * context, size_t Size)
 {
 
-  BuddyBlock_t *p_block;
+  BuddyBlock_t *p_block = NULL;
   size_t total_size = Size + size_header64;
+  unsigned int i;
+  int is_new = TRUE;
 
   /* sanity checks */
   if(!context)
@@ -1014,11 +1065,52 @@ BUDDY_ADDR_T AllocLargeBlock(BuddyThreadContext_t * context, size_t Size)
       return NULL;
     }
 
-  p_block = (BuddyBlock_t *) malloc(total_size);
+  /* Rounded, so that buffers of close sizes can reuse each other */
+  if(context->Config.huge_pages && total_size >= BUDDY_HUGE_PAGE_SIZE / 2)
+    total_size = (total_size + BUDDY_HUGE_PAGE_SIZE - 1) & ~((size_t) BUDDY_HUGE_PAGE_SIZE - 1);
+  else
+    total_size = (total_size + BUDDY_LARGE_GRANULARITY - 1) &
+        ~((size_t) BUDDY_LARGE_GRANULARITY - 1);
 
-  LogDebug(COMPONENT_MEMALLOC,
-           "Memory EXTRA area allocation for thread %p : ptr=%p ; size=%llu",
-           (caddr_t)pthread_self(), p_block, (unsigned long long)total_size);
+  /* Look for a cached block large enough, that would not waste half of it */
+  for(i = 0; i < context->NbLargeCached; i++)
+    if(context->LargeCache[i]->Header.ExtraInfo >= total_size &&
+       context->LargeCache[i]->Header.ExtraInfo / 2 < total_size)
+      {
+        p_block = context->LargeCache[i];
+        context->LargeCache[i] = context->LargeCache[--context->NbLargeCached];
+        context->Stats.LargeCachedSpace -= p_block->Header.ExtraInfo;
+        context->Stats.NbCacheHits++;
+        is_new = FALSE;
+        break;
+      }
+
+  if(p_block == NULL)
+    {
+      if(context->Config.large_cache_count > 0)
+        context->Stats.NbCacheMisses++;
+
+      if(IS_HUGE_EXTRA_SIZE(context, total_size))
+        {
+          p_block = (BuddyBlock_t *) mmap(NULL, total_size, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if(p_block == (BuddyBlock_t *) MAP_FAILED)
+            p_block = NULL;
+          else
+            {
+#ifdef MADV_HUGEPAGE
+              madvise(p_block, total_size, MADV_HUGEPAGE);
+#endif
+              p_block->Header.HugeMapped = TRUE;
+            }
+        }
+      else if((p_block = (BuddyBlock_t *) malloc(total_size)) != NULL)
+        p_block->Header.HugeMapped = FALSE;
+
+      LogDebug(COMPONENT_MEMALLOC,
+               "Memory EXTRA area allocation for thread %p : ptr=%p ; size=%llu",
+               (caddr_t)pthread_self(), p_block, (unsigned long long)total_size);
+    }
 
   if(!p_block)
     {
@@ -1031,7 +1123,7 @@ BUDDY_ADDR_T AllocLargeBlock(BuddyThreadContext_t * context, size_t Size)
    */
 
   p_block->Header.Base_ptr = NULL;
-  p_block->Header.ExtraInfo = total_size;
+  p_block->Header.ExtraInfo = is_new ? total_size : p_block->Header.ExtraInfo;
 
   p_block->Header.status = RESERVED_BLOCK;
   p_block->Header.MagicNumber = MAGIC_NUMBER_USED;
@@ -1057,7 +1149,8 @@ BUDDY_ADDR_T AllocLargeBlock(BuddyThreadContext_t * context, size_t Size)
 
   /* Update statistics about extra blocks */
 
-  UpdateStats_AddExtraPage(context, total_size);
+  if(is_new)
+    UpdateStats_AddExtraPage(context, total_size);
 
   /* return pointer to the new allocated zone. */
 
@@ -1066,8 +1159,6 @@ BUDDY_ADDR_T AllocLargeBlock(BuddyThreadContext_t * context, size_t Size)
 
 }
 
-/* Macro used to determine if it is a extra block or not (for BuddyFree) */
-#define IS_EXTRA_BLOCK( _p_block_ ) ( (_p_block_)->Header.Base_ptr == NULL )
 
 /**
  * FreeLargeBlock:
@@ -1085,7 +1176,10 @@ void FreeLargeBlock(BuddyThreadContext_t * context, BuddyBlock_t * p_block)
 
   page_size = p_block->Header.ExtraInfo;
 
-  free(p_block);
+  if(p_block->Header.HugeMapped)
+    munmap(p_block, page_size);
+  else
+    free(p_block);
 
   UpdateStats_RemoveExtraPage(context, page_size);
 
@@ -1097,40 +1191,160 @@ void FreeLargeBlock(BuddyThreadContext_t * context, BuddyBlock_t * p_block)
 
 }
 
+static void __BuddyFree(BuddyThreadContext_t * context, BuddyBlock_t * p_block);
+
+/**
+ * BuddyCachePut:
+ * keeps a freed block in the thread cache, still reserved,
+ * for the next allocation of the same size.
+ * Extra blocks are limited in number (large_cache_count) and
+ * small blocks in size (thread_cache_size), each on its own.
+ * \return TRUE if the block was cached.
+ */
+static int BuddyCachePut(BuddyThreadContext_t * context, BuddyBlock_t * p_block)
+{
+  unsigned int k_size;
+
 #ifndef _MONOTHREAD_MEMALLOC
+  /* the context is going away */
+  if(context->destroy_pending)
+    return FALSE;
+#endif
 
-static void __BuddyFree(BuddyThreadContext_t * context, BuddyBlock_t * p_block);
+  if(IS_EXTRA_BLOCK(p_block))
+    {
+      if(context->NbLargeCached >= context->Config.large_cache_count)
+        return FALSE;
+
+      p_block->Header.MagicNumber = MAGIC_NUMBER_CACHED;
+      context->LargeCache[context->NbLargeCached++] = p_block;
+      context->Stats.LargeCachedSpace += p_block->Header.ExtraInfo;
+#ifdef _DEBUG_MEMLEAKS
+      remove_allocated_block(context, p_block);
+#endif
+      return TRUE;
+    }
+
+  k_size = p_block->Header.StdInfo.k_size;
+
+  if(k_size > BUDDY_CACHE_MAX_LOG2 ||
+     context->Stats.CachedSpace + (1 << k_size) > context->Config.thread_cache_size)
+    return FALSE;
+
+  p_block->Header.MagicNumber = MAGIC_NUMBER_CACHED;
+  p_block->Content.FreeBlockInfo.NextBlock = context->Cache[k_size];
+  context->Cache[k_size] = p_block;
+  context->Stats.CachedSpace += 1 << k_size;
+
+  /* counted in CachedSpace, no more in the used space */
+  UpdateStats_FreeStdMemSpace(context, 1 << k_size);
+#ifdef _DEBUG_MEMLEAKS
+  remove_allocated_block(context, p_block);
+#endif
+
+  return TRUE;
+}                               /* BuddyCachePut */
+
+/**
+ * BuddyCacheTake:
+ * gives a block of the thread cache back to the user,
+ * with the label of the current allocation.
+ */
+static void BuddyCacheTake(BuddyThreadContext_t * context, BuddyBlock_t * p_block,
+                           size_t Size)
+{
+  p_block->Header.MagicNumber = MAGIC_NUMBER_USED;
+
+#ifdef _DEBUG_MEMLEAKS
+  p_block->Header.label_user_defined = context->label_user_defined;
+  p_block->Header.label_file = context->label_file;
+  p_block->Header.label_func = context->label_func;
+  p_block->Header.label_line = context->label_line;
+#ifndef _NO_BLOCK_PREALLOC
+  p_block->Header.pa_entry = NULL;
+#endif
+
+  p_block->Header.StdInfo.user_size = Size + size_header64;
+
+  add_allocated_block(context, p_block);
+#endif
+
+  UpdateStats_UseStdMemSpace(context, 1 << p_block->Header.StdInfo.k_size);
+}                               /* BuddyCacheTake */
+
+/**
+ * BuddyCacheFlush:
+ * gives the blocks of the thread cache back to the buddy system.
+ */
+static void BuddyCacheFlush(BuddyThreadContext_t * context)
+{
+  BuddyBlock_t *p_block;
+  unsigned int i;
+
+  for(i = 0; i <= BUDDY_CACHE_MAX_LOG2; i++)
+    while((p_block = context->Cache[i]) != NULL)
+      {
+        context->Cache[i] = p_block->Content.FreeBlockInfo.NextBlock;
+        context->Stats.CachedSpace -= 1 << i;
+        /* __BuddyFree takes it off the used space */
+        context->Stats.StdUsedSpace += 1 << i;
+        p_block->Header.MagicNumber = MAGIC_NUMBER_USED;
+        __BuddyFree(context, p_block);
+      }
+
+  while(context->NbLargeCached > 0)
+    {
+      p_block = context->LargeCache[--context->NbLargeCached];
+      context->Stats.LargeCachedSpace -= p_block->Header.ExtraInfo;
+      p_block->Header.MagicNumber = MAGIC_NUMBER_USED;
+      __BuddyFree(context, p_block);
+    }
+}                               /* BuddyCacheFlush */
+
+/**
+ * BuddyRelease:
+ * releases a block owned by the thread, to its cache if possible.
+ */
+static void BuddyRelease(BuddyThreadContext_t * context, BuddyBlock_t * p_block)
+{
+  if(!BuddyCachePut(context, p_block))
+    __BuddyFree(context, p_block);
+}                               /* BuddyRelease */
+
+#ifndef _MONOTHREAD_MEMALLOC
 
 /** Free owned blocks that have been freed by another thread */
 static void CheckBlocksToBeFreed(BuddyThreadContext_t * context, int do_lock)
 {
   BuddyBlock_t *p_block_to_free;
+  BuddyBlock_t *p_next;
 
-  /* take a block in the list a long as there is one */
+  /* Peek without the lock: a block pushed meanwhile is taken next time */
+  if(context->ToBeFreed_list == NULL)
+    return;
 
-  do
-    {
+  /* take the whole list at once */
 
-      if (do_lock)
-        P(context->ToBeFreed_mutex);
+  if (do_lock)
+    P(context->ToBeFreed_mutex);
 
-      p_block_to_free = context->ToBeFreed_list;
-      if(p_block_to_free)
-        context->ToBeFreed_list = p_block_to_free->Content.NextToBeFreed;
+  p_block_to_free = context->ToBeFreed_list;
+  context->ToBeFreed_list = NULL;
 
-      if (do_lock)
-          V(context->ToBeFreed_mutex);
+  if (do_lock)
+    V(context->ToBeFreed_mutex);
 
-      if(p_block_to_free == NULL)
-        break;
+  for(; p_block_to_free != NULL; p_block_to_free = p_next)
+    {
+      p_next = p_block_to_free->Content.NextToBeFreed;
 
       LogFullDebug(COMPONENT_MEMALLOC,
                    "blocks %p has been released by foreign thread",
                    p_block_to_free);
 
-      __BuddyFree(context, p_block_to_free);
+      context->Stats.NbRemoteFrees++;
+      BuddyRelease(context, p_block_to_free);
     }
-  while(1);
 
 }
 
@@ -1150,6 +1364,9 @@ static int TryContextCleanup(BuddyThreadContext_t * context)
         CheckBlocksToBeFreed(context, FALSE);
 #endif
 
+        /* cached blocks are still reserved */
+        BuddyCacheFlush(context);
+
         /* free pages that has the size of a memory page */
         while ( (p_block = context->MemDesc[context->k_size]) != NULL )
           {
@@ -1300,6 +1517,9 @@ int BuddyInit(buddy_parameter_t * p_buddy_init_info)
       return BUDDY_ERR_EINVAL;
     }
 
+  if(context->Config.large_cache_count > BUDDY_LARGE_CACHE_MAX)
+    context->Config.large_cache_count = BUDDY_LARGE_CACHE_MAX;
+
   /* Sets misc values */
 
   context->k_size = m;
@@ -1310,6 +1530,15 @@ int BuddyInit(buddy_parameter_t * p_buddy_init_info)
   for(i = 0; i < BUDDY_MAX_LOG2_SIZE; i++)
     context->MemDesc[i] = NULL;
 
+  /* Init thread cache */
+
+  for(i = 0; i <= BUDDY_CACHE_MAX_LOG2; i++)
+    context->Cache[i] = NULL;
+
+  context->NbLargeCached = 0;
+  context->LabelTick = 0;
+  memset(context->LabelSamples, 0, sizeof(context->LabelSamples));
+
   /* Init stats */
 
   context->Stats.TotalMemSpace = 0;
@@ -1330,6 +1559,12 @@ int BuddyInit(buddy_parameter_t * p_buddy_init_info)
   context->Stats.NbExtraPages = 0;
   context->Stats.WM_NbExtraPages = 0;
 
+  context->Stats.CachedSpace = 0;
+  context->Stats.LargeCachedSpace = 0;
+  context->Stats.NbCacheHits = 0;
+  context->Stats.NbCacheMisses = 0;
+  context->Stats.NbRemoteFrees = 0;
+
 #ifndef _MONOTHREAD_MEMALLOC
   if(pthread_mutex_init(&context->ToBeFreed_mutex, NULL) != 0)
     {
@@ -1456,6 +1691,30 @@ static BUDDY_ADDR_T __BuddyMalloc(size_t Size, int do_exit_on_error)
   actlog2 = sizelog2;
   allocation = 1 << sizelog2;
 
+  /* A block of this size freed by this thread is reused as is */
+  if(sizelog2 <= BUDDY_CACHE_MAX_LOG2 && sizelog2 <= context->k_size)
+    {
+      if((p_block = context->Cache[sizelog2]) != NULL)
+        {
+          context->Cache[sizelog2] = p_block->Content.FreeBlockInfo.NextBlock;
+          context->Stats.CachedSpace -= allocation;
+          context->Stats.NbCacheHits++;
+
+          BuddyCacheTake(context, p_block, Size);
+
+          LogFullDebug(COMPONENT_MEMALLOC,
+                       "BuddyMalloc(%llu) block=%p => %p (thread cache)",
+                       (unsigned long long)Size,
+                       p_block,
+                       p_block->Content.UserSpace);
+
+          return (BUDDY_ADDR_T) ((BUDDY_PTRDIFF_T) p_block + (BUDDY_PTRDIFF_T) size_header64);
+        }
+
+      if(context->Config.thread_cache_size > 0)
+        context->Stats.NbCacheMisses++;
+    }
+
   /* If it is a non-standard block (largest than page size),
    * We handle the request using AllocLargeBlock( context, size ).
    */
@@ -1816,6 +2075,13 @@ void BuddyFree(BUDDY_ADDR_T ptr)
       break;
 
     case RESERVED_BLOCK:
+      /* blocks in the thread cache are still reserved */
+      if(p_block->Header.MagicNumber == MAGIC_NUMBER_CACHED)
+        {
+          LogWarn(COMPONENT_MEMALLOC, "Double free detected for %p", ptr);
+          return;
+        }
+
       /* check for magic number */
       if(isBadMagicNumber("BuddyFree (RESERVED BLOCK):", context, p_block, MAGIC_NUMBER_USED, 1, NULL))
         {
@@ -1840,9 +2106,14 @@ void BuddyFree(BUDDY_ADDR_T ptr)
       return;
     }
 
-  /* check owner thread */
+  /* check owner thread (the context, as a thread id may be reused
+   * by a new thread while the blocks of the former one are alive) */
 
+#ifndef _MONOTHREAD_MEMALLOC
+  if(p_block->Header.OwnerThreadContext != context)
+#else
   if(p_block->Header.OwnerThread != pthread_self())
+#endif
     {
 #ifndef _MONOTHREAD_MEMALLOC
 
@@ -1882,7 +2153,7 @@ void BuddyFree(BUDDY_ADDR_T ptr)
       return;
     }
 
-  __BuddyFree(context, p_block);
+  BuddyRelease(context, p_block);
   return;
 
 }                               /* BuddyFree */
@@ -1903,6 +2174,7 @@ BUDDY_ADDR_T BuddyRealloc(BUDDY_ADDR_T ptr, size_t Size)
   BUDDY_ADDR_T new_ptr;
   BuddyBlock_t *p_block;
   BuddyThreadContext_t *context;
+  size_t user_space;
 
   LogFullDebug(COMPONENT_MEMALLOC,
                "%p:BuddyRealloc(%p,%llu)",
@@ -1940,12 +2212,24 @@ BUDDY_ADDR_T BuddyRealloc(BUDDY_ADDR_T ptr, size_t Size)
   p_block = (BuddyBlock_t *) (ptr - size_header64);
 
   /* it should not be free */
-  if(p_block->Header.status != RESERVED_BLOCK)
+  if(p_block->Header.status != RESERVED_BLOCK ||
+     p_block->Header.MagicNumber == MAGIC_NUMBER_CACHED)
     {
       context->Errno = BUDDY_ERR_EINVAL;
       return NULL;
     }
 
+  /* size of user space = total size of block - size of header */
+
+  if(IS_EXTRA_BLOCK(p_block))
+    user_space = p_block->Header.ExtraInfo - size_header64;
+  else
+    user_space = (1 << p_block->Header.StdInfo.k_size) - size_header64;
+
+  /* The block is kept if it is large enough, and not twice too large */
+  if(Size <= user_space && Size > user_space / 2)
+    return ptr;
+
   /* allocating the new memory area */
   new_ptr = BuddyMalloc(Size);
 
@@ -1954,32 +2238,16 @@ BUDDY_ADDR_T BuddyRealloc(BUDDY_ADDR_T ptr, size_t Size)
     return NULL;
 
   /* copying the old memory area to the new one. */
-  /* size of user space = total size of block - size of header */
-
-  if(IS_EXTRA_BLOCK(p_block))
-    {
-
-      LogFullDebug(COMPONENT_MEMALLOC,
-                   "%p:Copying %zu bytes from @%p to @%p->@%p",
-                   (BUDDY_ADDR_T) pthread_self(),
-                   p_block->Header.ExtraInfo - size_header64, ptr, new_ptr,
-                   new_ptr + p_block->Header.ExtraInfo - size_header64);
-
-      memcpy(new_ptr, ptr, p_block->Header.ExtraInfo - size_header64);
 
-    }
-  else
-    {
-
-      LogFullDebug(COMPONENT_MEMALLOC,
-                   "%p:Copying %zu bytes from @%p to @%p->@%p",
-                   (BUDDY_ADDR_T) pthread_self(),
-                   (1 << p_block->Header.StdInfo.k_size) - size_header64, ptr, new_ptr,
-                   new_ptr + (1 << p_block->Header.StdInfo.k_size) - size_header64);
+  if(user_space > Size)
+    user_space = Size;
 
-      memcpy(new_ptr, ptr, (1 << p_block->Header.StdInfo.k_size) - size_header64);
+  LogFullDebug(COMPONENT_MEMALLOC,
+               "%p:Copying %zu bytes from @%p to @%p->@%p",
+               (BUDDY_ADDR_T) pthread_self(),
+               user_space, ptr, new_ptr, new_ptr + user_space);
 
-    }
+  memcpy(new_ptr, ptr, user_space);
 
   /* freeing the old memory area */
   BuddyFree(ptr);
@@ -2105,6 +2373,12 @@ void BuddyDumpMem(FILE * output)
                (1.0 * context->Stats.NbStdUsed * context->Stats.StdPageSize)));
     }
 
+  fprintf(output, "%p: Space in Thread Cache: %lu + %lu large  (Hits: %lu, Misses: %lu, Remote Frees: %lu)\n",
+          (BUDDY_ADDR_T) pthread_self(), (unsigned long)context->Stats.CachedSpace,
+          (unsigned long)context->Stats.LargeCachedSpace,
+          context->Stats.NbCacheHits, context->Stats.NbCacheMisses,
+          context->Stats.NbRemoteFrees);
+
   fprintf(output, "\n");
 
   exist = 0;
@@ -2709,14 +2983,16 @@ void BuddyDumpAll(FILE *output)
   for (context = first_context; context != NULL; context = context->next)
     {
       total += context->Stats.TotalMemSpace;
-      total_used += context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace;
+      total_used += context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace -
+          context->Stats.LargeCachedSpace;
       count++;
 
       fprintf(output, "\nMemory Context for thread %s (%p) Total Mem Space: %lld MB Used: %lld MB\n",
               context->label_thread,
               (void *) context->OwnerThread,
               (unsigned long long) context->Stats.TotalMemSpace / 1024 / 1024,
-              (unsigned long long) (context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace) / 1024 / 1024);
+              (unsigned long long) (context->Stats.StdUsedSpace + context->Stats.ExtraMemSpace -
+                                      context->Stats.LargeCachedSpace) / 1024 / 1024);
 
       fprintf(output, "\n-SIZE-  ---USED--- -------------------LABEL-------------------\n");
 
@@ -2916,6 +3192,98 @@ void DisplayMemoryMap(FILE *output)
 
 #endif
 
+#ifndef _DEBUG_MEMLEAKS
+
+/**
+ * BuddyLabelSample:
+ * counts one labeled allocation out of BUDDY_LABEL_SAMPLING.
+ * Labels are string constants, they are told apart by address.
+ */
+static void BuddyLabelSample(size_t Size, const char *label)
+{
+  BuddyThreadContext_t *context;
+  BuddyLabelSample_t *p_sample;
+  unsigned int h, i;
+
+  context = GetThreadContext();
+
+  if(!context || !label)
+    return;
+
+  if(++context->LabelTick < BUDDY_LABEL_SAMPLING)
+    return;
+
+  context->LabelTick = 0;
+
+  h = (unsigned int)(((unsigned long)label >> 3) % BUDDY_LABEL_SAMPLES);
+
+  for(i = 0; i < BUDDY_LABEL_SAMPLES; i++)
+    {
+      p_sample = &context->LabelSamples[(h + i) % BUDDY_LABEL_SAMPLES];
+
+      if(p_sample->label == NULL)
+        p_sample->label = label;
+
+      if(p_sample->label == label)
+        {
+          p_sample->samples++;
+          p_sample->bytes += Size;
+          return;
+        }
+    }
+
+  /* table is full, this label is not counted */
+}                               /* BuddyLabelSample */
+
+BUDDY_ADDR_T BuddyMallocExit_Label(size_t Size, const char *label)
+{
+  BuddyLabelSample(Size, label);
+  return BuddyMallocExit(Size);
+}
+
+BUDDY_ADDR_T BuddyCalloc_Label(size_t NumberOfElements, size_t ElementSize,
+                               const char *label)
+{
+  BuddyLabelSample(NumberOfElements * ElementSize, label);
+  return BuddyCalloc(NumberOfElements, ElementSize);
+}
+
+/**
+ *  Displays an estimate of the labeled allocations
+ *  of current thread, from the samples.
+ */
+void BuddyLabelsSummary(log_components_t component)
+{
+  BuddyThreadContext_t *context;
+  unsigned int i;
+
+  if(!isFullDebug(component) || !isFullDebug(COMPONENT_MEMLEAKS))
+    return;
+
+  context = GetThreadContext();
+
+  if(!context)
+    return;
+
+  LogFullDebug(COMPONENT_MEMLEAKS,
+               "%-40s | %12s | %14s",
+               "description", "allocations", "bytes");
+
+  for(i = 0; i < BUDDY_LABEL_SAMPLES; i++)
+    {
+      if(context->LabelSamples[i].label == NULL)
+        continue;
+
+      LogFullDebug(COMPONENT_MEMLEAKS,
+                   "%-40s | %12lu | %14llu",
+                   context->LabelSamples[i].label,
+                   context->LabelSamples[i].samples * BUDDY_LABEL_SAMPLING,
+                   context->LabelSamples[i].bytes * BUDDY_LABEL_SAMPLING);
+    }
+}                               /* BuddyLabelsSummary */
+
+#endif
+
 /**
  *  test memory corruption for a block.
  */
@@ -2968,6 +3336,15 @@ int _BuddyCheck(BUDDY_ADDR_T ptr, int other_thread_ok, const char *label)
       break;
 
     case RESERVED_BLOCK:
+      /* blocks in the thread cache are still reserved */
+      if(p_block->Header.MagicNumber == MAGIC_NUMBER_CACHED)
+        {
+          LogWarn(COMPONENT_MEMALLOC,
+                  "BuddyCheck: %s Block %p has been freed",
+                  label, ptr);
+          return 0;
+        }
+
       /* check for magic number */
       if(isBadMagicNumber("BuddyCheck (RESERVED BLOCK):", context, p_block, MAGIC_NUMBER_USED, 1, label))
         {
@@ -1224,6 +1224,140 @@ void *TESTB(void *arg)
 
 }
 
+/* TESTC:
+ * thread cache: cache hits, and blocks freed by another thread.
+ */
+
+buddy_parameter_t parameter_cache = {
+  .memory_area_size = MEM_SIZE,
+  .on_demand_alloc  = TRUE,
+  .extra_alloc      = TRUE,
+  .free_areas       = TRUE,
+  .keep_factor      = 3,
+  .keep_minimum     = 5,
+  .thread_cache_size = MEM_SIZE,
+  .large_cache_count = 2,
+  .huge_pages       = FALSE,
+};
+
+#define CHECK_CACHE( _cond_, _msg_ ) do {\
+              if(!(_cond_)) {\
+                LogTest("**** %s ****", _msg_);\
+                exit(1);\
+              }\
+            } while(0)
+
+void *TESTC_remote_free(void *arg)
+{
+  BuddyInit(&parameter_cache);
+  BuddyFree((caddr_t) arg);
+  BuddyDestroy();
+
+  return NULL;
+}
+
+void *TESTC(void *arg)
+{
+
+  int th = (long)arg;
+  int rc;
+  buddy_stats_t before, after;
+  size_t small_size;
+  caddr_t p, q;
+  pthread_t remote;
+
+  LogTest("%d:BuddyInit(%llu)=%d", th, MEM_SIZE, rc = BuddyInit(&parameter_cache));
+
+  if(rc)
+    exit(1);
+
+  /* a small block goes to the cache, and out of the used space */
+
+  p = BuddyMalloc(100);
+  BuddyGetStats(&before);
+  BuddyFree(p);
+  BuddyGetStats(&after);
+
+  small_size = after.CachedSpace - before.CachedSpace;
+
+  CHECK_CACHE(small_size > 0, "freed block not cached");
+  CHECK_CACHE(after.StdUsedSpace + after.CachedSpace ==
+              before.StdUsedSpace + before.CachedSpace,
+              "cached block still counted as used");
+
+#ifdef _DEBUG_MEMLEAKS
+  BuddySetDebugLabel(__FILE__, __FUNCTION__, __LINE__, "cache hit");
+#endif
+
+  q = BuddyMalloc(100);
+  BuddyGetStats(&after);
+
+  CHECK_CACHE(q == p, "block not taken from the cache");
+  CHECK_CACHE(after.NbCacheHits == before.NbCacheHits + 1, "cache hit not counted");
+  CHECK_CACHE(after.StdUsedSpace == before.StdUsedSpace, "block from the cache not counted as used");
+  CHECK_CACHE(after.CachedSpace == before.CachedSpace, "block still counted as cached");
+
+#ifdef _DEBUG_MEMLEAKS
+  CHECK_CACHE(!strcmp(BuddyGetDebugLabel(q), "cache hit"), "block from the cache not relabeled");
+  CHECK_CACHE(BuddyCountDebugLabel("cache hit") == 1, "block from the cache not listed");
+#endif
+
+  BuddyFree(q);
+
+  /* the same for an extra block */
+
+  p = BuddyMalloc(2 * MEM_SIZE);
+  BuddyGetStats(&before);
+  BuddyFree(p);
+  BuddyGetStats(&after);
+
+  CHECK_CACHE(after.LargeCachedSpace > before.LargeCachedSpace, "freed extra block not cached");
+  CHECK_CACHE(after.ExtraMemSpace == before.ExtraMemSpace, "cached extra block released");
+
+  q = BuddyMalloc(2 * MEM_SIZE);
+  BuddyGetStats(&after);
+
+  CHECK_CACHE(q == p, "extra block not taken from the cache");
+  CHECK_CACHE(after.NbCacheHits == before.NbCacheHits + 1, "extra cache hit not counted");
+  CHECK_CACHE(after.LargeCachedSpace == before.LargeCachedSpace,
+              "extra block still counted as cached");
+
+  BuddyFree(q);
+
+  /* a block freed by another thread goes to the cache of its owner
+   * at the next allocation of the owner */
+
+  p = BuddyMalloc(100);
+  BuddyGetStats(&before);
+
+  pthread_create(&remote, NULL, TESTC_remote_free, p);
+  pthread_join(remote, NULL);
+
+  q = BuddyMalloc(1000);
+  BuddyGetStats(&after);
+
+  CHECK_CACHE(after.NbRemoteFrees == before.NbRemoteFrees + 1, "remote free not counted");
+  CHECK_CACHE(after.CachedSpace == before.CachedSpace + small_size,
+              "block freed by another thread not cached");
+  BuddyFree(q);
+
+  q = BuddyMalloc(100);
+  CHECK_CACHE(q == p, "block freed by another thread not taken from the cache");
+  BuddyFree(q);
+
+  /* destroy thread resources, cache included */
+  if((rc = BuddyDestroy()))
+    {
+      LogTest("ERROR in BuddyDestroy: %d", rc);
+      exit(1);
+    }
+
+  LogTest("%d: thread cache tests OK", th);
+
+  return NULL;
+
+}
+
 static char usage[] =
     "Usage :\n"
     "\ttest_buddy <test_name>\n\n"
@@ -1238,7 +1372,8 @@ static char usage[] =
     "\t\t8[mt] : garbage collection stats (mt: multithreaded test)\n"
     "\t\t9[mt] : debug labels (mt: multithreaded test)\n"
     "\t\tA     : multithreaded alloc/free on shared memory segments\n"
-    "\t\tB[mt] : memory corruption tests\n";
+    "\t\tB[mt] : memory corruption tests\n"
+    "\t\tC[mt] : thread cache tests (mt: multithreaded test)\n";
 
 /* Multithread launch macro */
 #define LAUNCH_THREADS( _function_ , _nb_threads_ ) do {\
@@ -1309,6 +1444,9 @@ int main(int argc, char **argv)
   else if(!strcmp(argv[1], "B"))
     TESTB(0);
 
+  else if(!strcmp(argv[1], "C"))
+    TESTC(0);
+
   else if(!strcmp(argv[1], "1mt"))
     LAUNCH_THREADS(TEST1, NB_THREADS);
 
@@ -1349,6 +1487,9 @@ int main(int argc, char **argv)
   else if(!strcmp(argv[1], "Bmt"))
     LAUNCH_THREADS(TESTB, NB_THREADS);
 
+  else if(!strcmp(argv[1], "Cmt"))
+    LAUNCH_THREADS(TESTC, NB_THREADS);
+
   else
     {
       LogTest("***** Unknown test: \"%s\" ******", argv[1]);
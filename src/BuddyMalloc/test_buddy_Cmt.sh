@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_buddy_Cmt.sh
+## thread cache tests (multithreaded test)
+##
+
+./test_buddy Cmt
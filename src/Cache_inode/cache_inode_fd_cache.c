@@ -0,0 +1,477 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_inode_fd_cache.c
+ * \brief   Descriptors kept open on the REGULAR_FILE entries.
+ *
+ * cache_inode_fd_cache.c : one LRU of the entries whose file is open in the
+ * FSAL, shared by all the clients. The number of descriptors it holds is
+ * capped by Max_Open_Files: when the cap is exceeded, the least recently
+ * used descriptors that nobody references are closed.
+ *
+ * The opened_file fields of an entry are changed under the entry's lock,
+ * the LRU links, the reference count and the statistics under the mutex of
+ * this module.
+ *
+ * A descriptor that has to be reopened in another mode while it is
+ * referenced is retired: it is set aside on the entry and closed when its
+ * last user releases it, instead of being closed under that user. The LRU never waits for an entry's lock (it holds the mutex
+ * while it tries them), an entry that is busy is just skipped.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "fsal.h"
+#include "log_macros.h"
+#include "cache_inode.h"
+#include "nlm_list.h"
+
+#include <time.h>
+#include <pthread.h>
+
+/* Descriptors closed by one pass of the LRU */
+#define CACHE_INODE_FD_RECLAIM_BATCH 32
+
+static struct glist_head fd_lru = { &fd_lru, &fd_lru };
+static pthread_mutex_t fd_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fd_cache_cond = PTHREAD_COND_INITIALIZER;
+static cache_inode_fd_cache_stat_t fd_cache_stat = {
+  .max_open = 1024
+};
+
+#define fd_of( pentry ) (&(pentry)->object.file.open_fd)
+
+/*
+ * Closes the retired descriptor of an entry, whose lock is held.
+ */
+static void fd_cache_close_retired(cache_entry_t * pentry, cache_inode_client_t * pclient)
+{
+#ifdef _USE_MFSL
+  MFSL_close(&fd_of(pentry)->retired_mfsl_fd, &pclient->mfsl_context, NULL);
+#else
+  FSAL_close(&fd_of(pentry)->retired_fd);
+#endif
+
+  P(fd_cache_mutex);
+  fd_cache_stat.nb_open--;
+  fd_cache_stat.nb_closed++;
+  V(fd_cache_mutex);
+}
+
+/**
+ *
+ * cache_inode_fd_cache_init: sets the cap of the descriptors kept open.
+ *
+ * @param max_open [IN] maximum number of descriptors kept open by all the clients.
+ *
+ */
+void cache_inode_fd_cache_init(unsigned int max_open)
+{
+  P(fd_cache_mutex);
+  fd_cache_stat.max_open = max_open;
+  V(fd_cache_mutex);
+
+  LogInfo(COMPONENT_CACHE_INODE,
+          "Cache Inode: up to %u file descriptors are kept open", max_open);
+}                               /* cache_inode_fd_cache_init */
+
+/**
+ *
+ * cache_inode_fd_cache_insert: records a descriptor the FSAL has just opened.
+ *
+ * The entry goes at the most recently used end of the LRU, with one more
+ * reference held by the caller. The entry's lock must be held.
+ *
+ * @param pentry [IN] the REGULAR_FILE entry.
+ *
+ */
+void cache_inode_fd_cache_insert(cache_entry_t * pentry)
+{
+  P(fd_cache_mutex);
+
+  if(!fd_of(pentry)->in_fd_lru)
+    {
+      glist_add_tail(&fd_lru, &fd_of(pentry)->fd_lru);
+      fd_of(pentry)->in_fd_lru = TRUE;
+      fd_cache_stat.nb_open++;
+    }
+  fd_of(pentry)->refcount++;
+  fd_cache_stat.nb_opened++;
+
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_insert */
+
+/**
+ *
+ * cache_inode_fd_cache_hold: takes a reference on a descriptor that is reused.
+ *
+ * The entry is moved at the most recently used end of the LRU. The entry's lock
+ * must be held.
+ *
+ * @param pentry [IN] the REGULAR_FILE entry.
+ *
+ */
+void cache_inode_fd_cache_hold(cache_entry_t * pentry)
+{
+  P(fd_cache_mutex);
+
+  if(fd_of(pentry)->in_fd_lru)
+    {
+      glist_del(&fd_of(pentry)->fd_lru);
+      glist_add_tail(&fd_lru, &fd_of(pentry)->fd_lru);
+    }
+  fd_of(pentry)->refcount++;
+  fd_cache_stat.nb_open_avoided++;
+
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_hold */
+
+/**
+ *
+ * cache_inode_fd_cache_release: drops a reference taken by an open.
+ *
+ * The users of a retired descriptor opened the file first, their references
+ * are dropped first. The retired descriptor is closed with its last one. The
+ * entry's lock must be held.
+ *
+ * @param pentry  [IN] the REGULAR_FILE entry.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ *
+ * @return the number of references left on the current descriptor.
+ *
+ */
+unsigned int cache_inode_fd_cache_release(cache_entry_t * pentry,
+                                          cache_inode_client_t * pclient)
+{
+  int close_retired = FALSE;
+  unsigned int refcount;
+
+  P(fd_cache_mutex);
+
+  if(fd_of(pentry)->retired_refcount > 0)
+    close_retired = (--fd_of(pentry)->retired_refcount == 0);
+  else if(fd_of(pentry)->refcount > 0)
+    fd_of(pentry)->refcount--;
+
+  refcount = fd_of(pentry)->refcount;
+
+  V(fd_cache_mutex);
+
+  if(close_retired)
+    fd_cache_close_retired(pentry, pclient);
+
+  return refcount;
+}                               /* cache_inode_fd_cache_release */
+
+/**
+ *
+ * cache_inode_fd_cache_retire: sets aside a descriptor about to be replaced.
+ *
+ * If the descriptor of the entry is referenced, it is moved to the retired
+ * slot with its references and leaves the LRU, and the entry can be reopened.
+ * The entry's lock must be held.
+ *
+ * @param pentry [IN] the REGULAR_FILE entry.
+ *
+ * @return 1 if the descriptor was retired, 0 if nobody uses it and it can be
+ *         closed, -1 if it is used and a retired descriptor is still in use.
+ *
+ */
+int cache_inode_fd_cache_retire(cache_entry_t * pentry)
+{
+  int rc;
+
+  P(fd_cache_mutex);
+
+  if(fd_of(pentry)->refcount == 0)
+    rc = 0;
+  else if(fd_of(pentry)->retired_refcount > 0)
+    rc = -1;
+  else
+    {
+#ifdef _USE_MFSL
+      fd_of(pentry)->retired_mfsl_fd = fd_of(pentry)->mfsl_fd;
+#else
+      fd_of(pentry)->retired_fd = fd_of(pentry)->fd;
+#endif
+      fd_of(pentry)->retired_refcount = fd_of(pentry)->refcount;
+      fd_of(pentry)->refcount = 0;
+
+      /* still counted in nb_open, until it is closed */
+      if(fd_of(pentry)->in_fd_lru)
+        {
+          glist_del(&fd_of(pentry)->fd_lru);
+          fd_of(pentry)->in_fd_lru = FALSE;
+        }
+      else
+        fd_cache_stat.nb_open++;
+      rc = 1;
+    }
+
+  V(fd_cache_mutex);
+
+  return rc;
+}                               /* cache_inode_fd_cache_retire */
+
+/**
+ *
+ * cache_inode_fd_cache_remove: records that the descriptor of an entry was closed.
+ *
+ * The references left are kept, their users go on with the descriptor the
+ * entry is reopened with. The entry's lock must be held.
+ *
+ * @param pentry [IN] the REGULAR_FILE entry.
+ *
+ */
+void cache_inode_fd_cache_remove(cache_entry_t * pentry)
+{
+  P(fd_cache_mutex);
+
+  if(fd_of(pentry)->in_fd_lru)
+    {
+      glist_del(&fd_of(pentry)->fd_lru);
+      fd_of(pentry)->in_fd_lru = FALSE;
+      fd_cache_stat.nb_open--;
+      fd_cache_stat.nb_closed++;
+    }
+
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_remove */
+
+/**
+ *
+ * cache_inode_fd_cache_forget: closes the descriptor of an entry that is released.
+ *
+ * Must be called before a REGULAR_FILE entry goes back to its pool. If the LRU
+ * is closing the descriptor at the same time, waits for it to be done with the
+ * entry.
+ *
+ * @param pentry  [IN] the entry.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ *
+ */
+void cache_inode_fd_cache_forget(cache_entry_t * pentry, cache_inode_client_t * pclient)
+{
+  int was_open = FALSE;
+  int was_retired;
+
+  if(pentry->internal_md.type != REGULAR_FILE)
+    return;
+
+  P(fd_cache_mutex);
+
+  while(fd_of(pentry)->evicting)
+    pthread_cond_wait(&fd_cache_cond, &fd_cache_mutex);
+
+  if(fd_of(pentry)->in_fd_lru)
+    {
+      glist_del(&fd_of(pentry)->fd_lru);
+      fd_of(pentry)->in_fd_lru = FALSE;
+      fd_cache_stat.nb_open--;
+      fd_cache_stat.nb_closed++;
+      was_open = TRUE;
+    }
+  fd_of(pentry)->refcount = 0;
+  was_retired = (fd_of(pentry)->retired_refcount > 0);
+  fd_of(pentry)->retired_refcount = 0;
+
+  V(fd_cache_mutex);
+
+  if(was_retired)
+    fd_cache_close_retired(pentry, pclient);
+
+  if(was_open)
+    {
+#ifdef _USE_MFSL
+      MFSL_close(&fd_of(pentry)->mfsl_fd, &pclient->mfsl_context, NULL);
+#else
+      FSAL_close(&fd_of(pentry)->fd);
+#endif
+      fd_of(pentry)->fileno = 0;
+      fd_of(pentry)->last_op = 0;
+    }
+}                               /* cache_inode_fd_cache_forget */
+
+/**
+ *
+ * cache_inode_fd_cache_full: tells if more descriptors than the cap are open.
+ *
+ * @return TRUE if descriptors should be closed, FALSE otherwise.
+ *
+ */
+int cache_inode_fd_cache_full(void)
+{
+  return (fd_cache_stat.nb_open > fd_cache_stat.max_open);
+}                               /* cache_inode_fd_cache_full */
+
+void cache_inode_fd_cache_close_avoided(void)
+{
+  P(fd_cache_mutex);
+  fd_cache_stat.nb_close_avoided++;
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_close_avoided */
+
+void cache_inode_fd_cache_upgraded(void)
+{
+  P(fd_cache_mutex);
+  fd_cache_stat.nb_upgraded++;
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_upgraded */
+
+/**
+ *
+ * cache_inode_fd_cache_reclaim: closes descriptors from the LRU.
+ *
+ * With idle_only, closes the descriptors unused for more than the client's
+ * retention, even if they are referenced: the operations refresh last_op, so
+ * a reference left over by a caller that never closes does not pin the
+ * descriptor forever. Otherwise closes the least recently used descriptors
+ * nobody references until the cap is honoured. Entries whose lock is busy or
+ * that hold state are skipped.
+ *
+ * @param pcaller  [IN] entry whose lock the caller holds, never closed (may be NULL).
+ * @param pclient  [IN] ressource allocated by the client for the nfs management.
+ * @param idle_only [IN] close the idle descriptors instead of enforcing the cap.
+ *
+ * @return the number of descriptors closed.
+ *
+ */
+unsigned int cache_inode_fd_cache_reclaim(cache_entry_t * pcaller,
+                                          cache_inode_client_t * pclient,
+                                          int idle_only)
+{
+  cache_entry_t *victims[CACHE_INODE_FD_RECLAIM_BATCH];
+  int retired[CACHE_INODE_FD_RECLAIM_BATCH];
+  cache_entry_t *pentry;
+  struct glist_head *node;
+  struct glist_head *noden;
+  unsigned int nb_victims;
+  unsigned int nb_closed = 0;
+  unsigned int i;
+  time_t now = time(NULL);
+
+  do
+    {
+      nb_victims = 0;
+
+      P(fd_cache_mutex);
+
+      glist_for_each_safe(node, noden, &fd_lru)
+        {
+          if(nb_victims == CACHE_INODE_FD_RECLAIM_BATCH)
+            break;
+
+          if(!idle_only && fd_cache_stat.nb_open <= fd_cache_stat.max_open)
+            break;
+
+          pentry = container_of(node, cache_entry_t, object.file.open_fd.fd_lru);
+
+          /* The LRU is sorted by last use, the next ones are more recent */
+          if(idle_only && now - fd_of(pentry)->last_op <= pclient->retention)
+            break;
+
+          if(pentry == pcaller ||
+             (!idle_only && (fd_of(pentry)->refcount > 0 ||
+                             fd_of(pentry)->retired_refcount > 0)))
+            continue;
+
+          if(P_w_try(&pentry->lock) != 0)
+            continue;
+
+          if(cache_inode_file_holds_state(pentry))
+            {
+              V_w(&pentry->lock);
+              continue;
+            }
+
+          glist_del(node);
+          fd_of(pentry)->in_fd_lru = FALSE;
+          fd_of(pentry)->evicting = TRUE;
+          fd_of(pentry)->refcount = 0;
+          fd_cache_stat.nb_open--;
+
+          retired[nb_victims] = (fd_of(pentry)->retired_refcount > 0);
+          fd_of(pentry)->retired_refcount = 0;
+          victims[nb_victims++] = pentry;
+        }
+
+      V(fd_cache_mutex);
+
+      for(i = 0; i < nb_victims; i++)
+        {
+          pentry = victims[i];
+
+          LogFullDebug(COMPONENT_CACHE_INODE_GC,
+                       "cache_inode_fd_cache_reclaim: closing pentry %p, fileno = %d, lastop=%d ago",
+                       pentry, fd_of(pentry)->fileno,
+                       (int)(now - fd_of(pentry)->last_op));
+
+#ifdef _USE_MFSL
+          MFSL_close(&fd_of(pentry)->mfsl_fd, &pclient->mfsl_context, NULL);
+#else
+          FSAL_close(&fd_of(pentry)->fd);
+#endif
+          fd_of(pentry)->fileno = 0;
+          fd_of(pentry)->last_op = 0;
+
+          if(retired[i])
+            fd_cache_close_retired(pentry, pclient);
+
+          V_w(&pentry->lock);
+        }
+
+      if(nb_victims > 0)
+        {
+          P(fd_cache_mutex);
+          for(i = 0; i < nb_victims; i++)
+            fd_of(victims[i])->evicting = FALSE;
+          fd_cache_stat.nb_closed += nb_victims;
+          fd_cache_stat.nb_evicted += nb_victims;
+          pthread_cond_broadcast(&fd_cache_cond);
+          V(fd_cache_mutex);
+        }
+
+      nb_closed += nb_victims;
+    }
+  while(nb_victims == CACHE_INODE_FD_RECLAIM_BATCH);
+
+  return nb_closed;
+}                               /* cache_inode_fd_cache_reclaim */
+
+/**
+ *
+ * cache_inode_fd_cache_get_stats: returns the statistics of the descriptors cache.
+ *
+ * @param pstat [OUT] the statistics.
+ *
+ */
+void cache_inode_fd_cache_get_stats(cache_inode_fd_cache_stat_t * pstat)
+{
+  P(fd_cache_mutex);
+  *pstat = fd_cache_stat;
+  V(fd_cache_mutex);
+}                               /* cache_inode_fd_cache_get_stats */
@@ -205,6 +205,9 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
   if (pentry->internal_md.type == SYMBOLIC_LINK)
     cache_inode_release_symlink(pentry, &pgcparam->pclient->pool_entry_symlink);
 
+  /* Close the file if it is still open */
+  cache_inode_fd_cache_forget(pentry, pgcparam->pclient);
+
   /* Free and Destroy the mutex associated with the pentry */
   V_w(&pentry->lock);
 
@@ -616,42 +619,16 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
   return *pstatus;
 }                               /* cache_inode_gc */
 
-int cache_inode_gc_fd_func(LRU_entry_t * plru_entry, void *addparam)
-{
-  cache_entry_t *pentry = NULL;
-  cache_inode_param_gc_t *pgcparam = (cache_inode_param_gc_t *) addparam;
-  cache_inode_status_t status;
-
-  /* Get the entry */
-  pentry = (cache_entry_t *) (plru_entry->buffdata.pdata);
-
-  /* check if a file descriptor is opened on the file for a long time */
-
-  if((pentry->internal_md.type == REGULAR_FILE)
-     && (pentry->object.file.open_fd.fileno != 0)
-     && (time(NULL) - pentry->object.file.open_fd.last_op > pgcparam->pclient->retention))
-    {
-      P_w(&pentry->lock);
-      cache_inode_close(pentry, pgcparam->pclient, &status);
-      V_w(&pentry->lock);
-
-      pgcparam->nb_to_be_purged--;
-    }
-
-  /* return true for continuing */
-  if(pgcparam->nb_to_be_purged == 0)
-    return FALSE;
-  else
-    return TRUE;
-}
-
 /**
  * Garbagge opened file descriptors
+ *
+ * The descriptors of all the clients are in one LRU, the ones unused for
+ * longer than the retention are closed, whichever client opened them.
  */
 cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
                                        cache_inode_status_t * pstatus)
 {
-  cache_inode_param_gc_t gcparam;
+  unsigned int nb_closed;
 
   /* Set the return default to CACHE_INODE_SUCCESS */
   *pstatus = CACHE_INODE_SUCCESS;
@@ -664,20 +641,10 @@ cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
   if(time(NULL) - pclient->time_of_last_gc_fd < pclient->retention)
     return *pstatus;
 
-  gcparam.ht = NULL;            /* not used */
-  gcparam.pclient = pclient;
-  gcparam.nb_to_be_purged = pclient->max_fd;
-
-  if(LRU_apply_function(pclient->lru_gc, cache_inode_gc_fd_func, (void *)&gcparam) !=
-     LRU_LIST_SUCCESS)
-    {
-      *pstatus = CACHE_INODE_LRU_ERROR;
-      return *pstatus;
-    }
+  nb_closed = cache_inode_fd_cache_reclaim(NULL, pclient, TRUE);
 
   LogDebug(COMPONENT_CACHE_INODE_GC,
-           "File descriptor GC: %u files closed",
-           pclient->max_fd - gcparam.nb_to_be_purged);
+           "File descriptor GC: %u files closed", nb_closed);
   pclient->time_of_last_gc_fd = time(NULL);
 
   *pstatus = CACHE_INODE_SUCCESS;
@@ -110,6 +110,8 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
     sprintf(name, "Cache Inode Worker #%d", thread_index);
   else if(thread_index == SMALL_CLIENT_INDEX)
     sprintf(name, "Cache Inode Small Client");
+  else if(thread_index == SNAPSHOT_CLIENT_INDEX)
+    sprintf(name, "Cache Inode Snapshot Client");
   else
     sprintf(name, "Cache Inode NLM Async #%d", thread_index - NLM_THREAD_INDEX);
 
@@ -136,6 +138,12 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
 
   pclient->time_of_last_gc_fd = time(NULL);
 
+#ifndef _USE_MFSL
+  /* Once per client, its IOs wait on them one at a time */
+  pthread_mutex_init(&pclient->async_io_mutex, NULL);
+  pthread_cond_init(&pclient->async_io_cond, NULL);
+#endif
+
   MakePool(&pclient->pool_entry, pclient->nb_prealloc, cache_entry_t, NULL, NULL);
   NamePool(&pclient->pool_entry, "%s Entry Pool", name);
   if(!IsPoolPreallocated(&pclient->pool_entry))
@@ -246,6 +246,9 @@ cache_inode_status_t cache_inode_kill_entry( cache_entry_t          * pentry,
       parent_iter = parent_iter_next;
     }
 
+  /* Close the file if it is still open */
+  cache_inode_fd_cache_forget(pentry, pclient);
+
   /* If entry is datacached, remove it from the cache */
   if(pentry->internal_md.type == REGULAR_FILE)
     {
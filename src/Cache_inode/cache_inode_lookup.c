@@ -97,6 +97,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t        * pentry_parent,
   struct avltree_node *dirent_node;
   cache_inode_dir_entry_t *new_dir_entry;
   cache_entry_t *pentry = NULL;
+  cache_entry_t *pentry_stale = NULL;
   fsal_status_t fsal_status;
 #ifdef _USE_MFSL
   mfsl_object_t object_handle;
@@ -110,6 +111,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t        * pentry_parent,
   cache_inode_status_t cache_status;
   cache_inode_fsal_data_t new_entry_fsdata;
   fsal_accessflags_t access_mask = 0;
+  int use_fsal_attributes = FALSE;
 
   memset( (char *)&new_entry_fsdata, 0, sizeof( new_entry_fsdata ) ) ; 
 
@@ -205,6 +207,19 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t        * pentry_parent,
       	  dirent = avltree_container_of(dirent_node, cache_inode_dir_entry_t,
 					node_n);
 	  pentry = dirent->pentry;
+
+          /* An entry not revalidated since it was invalidated (or reloaded
+           * from a snapshot) may have been renamed, check the name with the FSAL.
+           * An asynchronous parent trusts its cache, as for a cache miss. */
+          if(pentry != NULL && pentry->internal_md.valid_state == STALE
+#ifdef _USE_MFSL_ASYNC
+             && !mfsl_async_is_object_asynchronous(&pentry_parent->mobject)
+#endif
+            )
+            {
+              pentry_stale = pentry;
+              pentry = NULL;
+            }
       }
 
       if(pentry == NULL)
@@ -364,6 +379,16 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t        * pentry_parent,
               return NULL;
             }
 
+          /* Do not return the cached attributes of an entry still to be revalidated */
+          if(*pstatus == CACHE_INODE_ENTRY_EXISTS &&
+             pentry->internal_md.valid_state == STALE)
+            use_fsal_attributes = TRUE;
+
+          /* The name now leads to another object, its old dirent goes away */
+          if(pentry_stale != NULL && pentry_stale != pentry)
+            cache_inode_remove_cached_dirent(pentry_parent, pname, ht, pclient,
+                                             &cache_status);
+
           /* Entry was found in the FSAL, add this entry to the parent
            * directory */
           cache_status = cache_inode_add_cached_dirent(pentry_parent,
@@ -391,7 +416,10 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t        * pentry_parent,
     }
 
   /* Return the attributes */
-  cache_inode_get_attributes(pentry, pattr);
+  if(use_fsal_attributes)
+    *pattr = object_attributes;
+  else
+    cache_inode_get_attributes(pentry, pattr);
 
   *pstatus = cache_inode_valid(pentry_parent, CACHE_INODE_OP_GET, pclient);
 
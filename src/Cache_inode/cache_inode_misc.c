@@ -348,7 +348,7 @@ void cache_inode_release_fsaldata_key(hash_buffer_t * pkey,
  * @param ht [INOUT] hash table used for the cache.
  * @param pclient [INOUT]ressource allocated by the client for the nfs management.
  * @param pcontext [IN] FSAL credentials for the operation.
- * @param create_flag [IN] a flag which shows if the entry is newly created or not
+ * @param create_flag [IN] a flag which shows if the entry is newly created or not (CACHE_INODE_NEW_ENTRY_RELOAD if reloaded from a snapshot)
  * @param pstatus [OUT] returned status.
  *
  * @return the same as *pstatus
@@ -482,9 +482,13 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t   * pfsdata,
       fsal_attributes = *pfsal_attr;
     }
 
-  /* Init the internal metadata */
+  /* Init the internal metadata, an entry reloaded from a snapshot is to be
+   * revalidated on its first use */
   pentry->internal_md.type = type;
-  pentry->internal_md.valid_state = VALID;
+  if(create_flag == CACHE_INODE_NEW_ENTRY_RELOAD)
+    pentry->internal_md.valid_state = STALE;
+  else
+    pentry->internal_md.valid_state = VALID;
   pentry->internal_md.read_time = 0;
   pentry->internal_md.mod_time = pentry->internal_md.alloc_time = time(NULL);
   pentry->internal_md.refresh_time = pentry->internal_md.alloc_time;
@@ -514,6 +518,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t   * pfsdata,
       pentry->object.file.pentry_content = NULL;    /* Not yet a File Content entry associated with this entry */
       init_glist(&pentry->object.file.state_list);  /* No associated states yet */
       init_glist(&pentry->object.file.lock_list);   /* No associated locks yet */
+      init_glist(&pentry->object.file.lock_blocked_list); /* No blocked locks yet */
       if(pthread_mutex_init(&pentry->object.file.lock_list_mutex, NULL) != 0)
         {
           ReleaseToPool(pentry, &pclient->pool_entry);
@@ -531,6 +536,10 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t   * pfsdata,
       pentry->object.file.open_fd.fileno = 0;
       pentry->object.file.open_fd.last_op = 0;
       pentry->object.file.open_fd.openflags = 0;
+      init_glist(&pentry->object.file.open_fd.fd_lru);
+      pentry->object.file.open_fd.in_fd_lru = FALSE;
+      pentry->object.file.open_fd.refcount = 0;
+      pentry->object.file.open_fd.evicting = FALSE;
 #ifdef _USE_MFSL
       memset(&(pentry->object.file.open_fd.mfsl_fd), 0, sizeof(mfsl_file_t));
 #else
@@ -768,7 +777,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t   * pfsdata,
 
   /* if entry is a REGULAR_FILE and has a related data cache entry from a previous server instance that crashed, recover it */
   /* This is done only when this is not a creation (when creating a new file, it is impossible to have it cached)           */
-  if(type == REGULAR_FILE && create_flag == FALSE)
+  if(type == REGULAR_FILE && create_flag != TRUE)
     {
       cache_content_test_cached(pentry,
                                 (cache_content_client_t *) pclient->pcontent_client,
@@ -1060,20 +1069,11 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
 
   if(pentry->internal_md.type == REGULAR_FILE)
     {
+      /* The descriptors left idle by all the clients are closed together */
       if(pclient->use_fd_cache == 1)
         {
-          if(pentry->object.file.open_fd.fileno != 0)
-            {
-              if(time(NULL) - pentry->object.file.open_fd.last_op > pclient->retention)
-                {
-                  if(cache_inode_close(pentry, pclient, &cache_status) !=
-                     CACHE_INODE_SUCCESS)
-                    {
-                      /* Bad close */
-                      return cache_status;
-                    }
-                }
-            }
+          if(cache_inode_gc_fd(pclient, &cache_status) != CACHE_INODE_SUCCESS)
+            return cache_status;
         }
 
       /* Same of local fd cache */
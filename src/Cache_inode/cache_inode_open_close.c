@@ -86,6 +86,114 @@ fsal_file_t * cache_inode_fd(cache_entry_t * pentry)
   return NULL;
 }
 
+/*
+ * Tells if the descriptor kept on the entry can serve an open with openflags.
+ */
+static int cache_inode_fd_usable(cache_entry_t * pentry, fsal_openflags_t openflags)
+{
+  if((pentry->object.file.open_fd.last_op == 0)
+     || (pentry->object.file.open_fd.fileno == 0))
+    return FALSE;
+
+  return ((pentry->object.file.open_fd.openflags == openflags) ||
+          (pentry->object.file.open_fd.openflags == FSAL_O_RDWR));
+}
+
+/*
+ * Flags to open the entry with: a file that is open for reading and is now
+ * written (or the reverse) is reopened read/write, so that the next opens
+ * in either mode reuse the same descriptor.
+ */
+static fsal_openflags_t cache_inode_fd_upgrade(cache_entry_t * pentry,
+                                               fsal_openflags_t openflags)
+{
+  if(pentry->object.file.open_fd.fileno == 0)
+    return openflags;
+
+  if(((pentry->object.file.open_fd.openflags == FSAL_O_RDONLY) &&
+      (openflags == FSAL_O_WRONLY)) ||
+     ((pentry->object.file.open_fd.openflags == FSAL_O_WRONLY) &&
+      (openflags == FSAL_O_RDONLY)))
+    return FSAL_O_RDWR;
+
+  return openflags;
+}
+
+/*
+ * Closes the descriptor kept on the entry, whose lock is held.
+ */
+static fsal_status_t cache_inode_fd_close(cache_entry_t * pentry,
+                                          cache_inode_client_t * pclient)
+{
+  fsal_status_t fsal_status;
+
+#ifdef _USE_MFSL
+  fsal_status = MFSL_close(&(pentry->object.file.open_fd.mfsl_fd), &pclient->mfsl_context, NULL);
+#else
+  fsal_status = FSAL_close(&(pentry->object.file.open_fd.fd));
+#endif
+
+  pentry->object.file.open_fd.last_op = 0;
+  pentry->object.file.open_fd.fileno = 0;
+
+  cache_inode_fd_cache_remove(pentry);
+
+  return fsal_status;
+}
+
+static fsal_status_t cache_inode_fd_open(cache_entry_t * pentry,
+                                         cache_inode_client_t * pclient,
+                                         fsal_openflags_t openflags,
+                                         fsal_op_context_t * pcontext)
+{
+#ifdef _USE_MFSL
+  return MFSL_open(&(pentry->mobject),
+                   pcontext,
+                   &pclient->mfsl_context,
+                   openflags,
+                   &pentry->object.file.open_fd.mfsl_fd,
+                   &(pentry->object.file.attributes),
+                   NULL );
+#else
+  return FSAL_open(&(pentry->object.file.handle),
+                   pcontext,
+                   openflags,
+                   &pentry->object.file.open_fd.fd,
+                   &(pentry->object.file.attributes));
+#endif
+}
+
+static fsal_status_t cache_inode_fd_open_by_name(cache_entry_t * pentry_dir,
+                                                 fsal_name_t * pname,
+                                                 cache_entry_t * pentry_file,
+                                                 cache_inode_client_t * pclient,
+                                                 fsal_openflags_t openflags,
+                                                 fsal_op_context_t * pcontext)
+{
+#ifdef _USE_MFSL
+  return MFSL_open_by_name(&(pentry_dir->mobject),
+                           pname,
+                           pcontext,
+                           &pclient->mfsl_context,
+                           openflags,
+                           &pentry_file->object.file.open_fd.mfsl_fd,
+                           &(pentry_file->object.file.attributes),
+#ifdef _USE_PNFS
+                           &pentry_file->object.file.pnfs_file ) ;
+#else
+                           NULL );
+#endif /* _USE_PNFS */
+
+#else
+  return FSAL_open_by_name(&(pentry_dir->object.file.handle),
+                           pname,
+                           pcontext,
+                           openflags,
+                           &pentry_file->object.file.open_fd.fd,
+                           &(pentry_file->object.file.attributes));
+#endif
+}
+
 /**
  *
  * cache_content_open: opens the local fd on  the cache.
@@ -109,6 +217,8 @@ cache_inode_status_t cache_inode_open(cache_entry_t * pentry,
                                       cache_inode_status_t * pstatus)
 {
   fsal_status_t fsal_status;
+  fsal_openflags_t newflags;
+  int retired;
 
   if((pentry == NULL) || (pclient == NULL) || (pcontext == NULL) || (pstatus == NULL))
     return CACHE_INODE_INVALID_ARGUMENT;
@@ -119,53 +229,63 @@ cache_inode_status_t cache_inode_open(cache_entry_t * pentry,
       return *pstatus;
     }
 
-  /* Open file need to be closed, unless it is already open as read/write */
-  if((pentry->object.file.open_fd.openflags != FSAL_O_RDWR) &&
-     (pentry->object.file.open_fd.openflags != 0) &&
-     (pentry->object.file.open_fd.fileno != 0) &&
-     (pentry->object.file.open_fd.openflags != openflags))
+  if(cache_inode_fd_usable(pentry, openflags))
     {
-#ifdef _USE_MFSL
-      fsal_status = MFSL_close(&(pentry->object.file.open_fd.mfsl_fd), &pclient->mfsl_context, NULL);
-#else
-      fsal_status = FSAL_close(&(pentry->object.file.open_fd.fd));
-#endif
-      if(FSAL_IS_ERROR(fsal_status) && (fsal_status.major != ERR_FSAL_NOT_OPENED))
-        {
-          *pstatus = cache_inode_error_convert(fsal_status);
-
-          LogDebug(COMPONENT_CACHE_INODE,
-                   "cache_inode_open: returning %d(%s) from FSAL_close",
-                   *pstatus, cache_inode_err_str(*pstatus));
+      /* The kept descriptor serves this open */
+      cache_inode_fd_cache_hold(pentry);
+    }
+  else
+    {
+      newflags = cache_inode_fd_upgrade(pentry, openflags);
 
-          return *pstatus;
+      /* Open file need to be replaced, it is open with other flags. If it is
+       * in use, its last user closes it */
+      if(pentry->object.file.open_fd.fileno != 0)
+        {
+          retired = cache_inode_fd_cache_retire(pentry);
+
+          if(retired < 0)
+            {
+              /* the descriptor it replaced is still in use too */
+              *pstatus = CACHE_INODE_FSAL_DELAY;
+
+              LogDebug(COMPONENT_CACHE_INODE,
+                       "cache_inode_open: pentry %p: descriptor busy, returning %d(%s)",
+                       pentry, *pstatus, cache_inode_err_str(*pstatus));
+
+              return *pstatus;
+            }
+          else if(retired > 0)
+            {
+              pentry->object.file.open_fd.last_op = 0;
+              pentry->object.file.open_fd.fileno = 0;
+            }
+          else
+            {
+              fsal_status = cache_inode_fd_close(pentry, pclient);
+
+              if(FSAL_IS_ERROR(fsal_status) && (fsal_status.major != ERR_FSAL_NOT_OPENED))
+                {
+                  *pstatus = cache_inode_error_convert(fsal_status);
+
+                  LogDebug(COMPONENT_CACHE_INODE,
+                           "cache_inode_open: returning %d(%s) from FSAL_close",
+                           *pstatus, cache_inode_err_str(*pstatus));
+
+                  return *pstatus;
+                }
+            }
         }
 
-      /* force re-openning */
-      pentry->object.file.open_fd.last_op = 0;
-      pentry->object.file.open_fd.fileno = 0;
-
-    }
-
-  if((pentry->object.file.open_fd.last_op == 0)
-     || (pentry->object.file.open_fd.fileno == 0))
-    {
       /* opened file is not preserved yet */
-#ifdef _USE_MFSL
-      fsal_status = MFSL_open(&(pentry->mobject),
-                              pcontext,
-                              &pclient->mfsl_context,
-                              openflags,
-                              &pentry->object.file.open_fd.mfsl_fd,
-                              &(pentry->object.file.attributes),
-                              NULL );
-#else
-      fsal_status = FSAL_open(&(pentry->object.file.handle),
-                              pcontext,
-                              openflags,
-                              &pentry->object.file.open_fd.fd,
-                              &(pentry->object.file.attributes));
-#endif
+      fsal_status = cache_inode_fd_open(pentry, pclient, newflags, pcontext);
+
+      /* The upgrade may be refused (read-only file system...) */
+      if(FSAL_IS_ERROR(fsal_status) && (newflags != openflags))
+        {
+          newflags = openflags;
+          fsal_status = cache_inode_fd_open(pentry, pclient, newflags, pcontext);
+        }
 
       if(FSAL_IS_ERROR(fsal_status))
         {
@@ -178,32 +298,29 @@ cache_inode_status_t cache_inode_open(cache_entry_t * pentry,
           return *pstatus;
         }
 
+      if(newflags != openflags)
+        cache_inode_fd_cache_upgraded();
+
 #ifdef _USE_MFSL
       pentry->object.file.open_fd.fileno = FSAL_FILENO(&(pentry->object.file.open_fd.mfsl_fd.fsal_file));
 #else
       pentry->object.file.open_fd.fileno = FSAL_FILENO(&(pentry->object.file.open_fd.fd));
 #endif
-      pentry->object.file.open_fd.openflags = openflags;
+      pentry->object.file.open_fd.openflags = newflags;
+
+      cache_inode_fd_cache_insert(pentry);
 
       LogDebug(COMPONENT_CACHE_INODE,
                "cache_inode_open: pentry %p: lastop=0, fileno = %d, openflags = %d",
-               pentry, pentry->object.file.open_fd.fileno, (int) openflags);
+               pentry, pentry->object.file.open_fd.fileno, (int) newflags);
     }
 
   /* regular exit */
   pentry->object.file.open_fd.last_op = time(NULL);
 
-  /* if file descriptor is too high, garbage collect FDs */
-  if(pclient->use_fd_cache
-     && (pentry->object.file.open_fd.fileno > pclient->max_fd))
-    {
-      if(cache_inode_gc_fd(pclient, pstatus) != CACHE_INODE_SUCCESS)
-        {
-          LogCrit(COMPONENT_CACHE_INODE_GC,
-                  "FAILURE performing FD garbage collection");
-          return *pstatus;
-        }
-    }
+  /* if too many files are open, close the least recently used ones */
+  if(cache_inode_fd_cache_full())
+    cache_inode_fd_cache_reclaim(pentry, pclient, FALSE);
 
   *pstatus = CACHE_INODE_SUCCESS;
   return *pstatus;
@@ -237,6 +354,8 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
                                               cache_inode_status_t * pstatus)
 {
   fsal_status_t fsal_status;
+  fsal_openflags_t newflags;
+  int retired;
   fsal_size_t save_filesize = 0;
   fsal_size_t save_spaceused = 0;
   fsal_time_t save_mtime = {
@@ -260,36 +379,54 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
       return *pstatus;
     }
 
-  /* Open file need to be closed, unless it is already open as read/write */
-  if((pentry_file->object.file.open_fd.openflags != FSAL_O_RDWR) &&
-     (pentry_file->object.file.open_fd.openflags != 0) &&
-     (pentry_file->object.file.open_fd.fileno >= 0) &&
-     (pentry_file->object.file.open_fd.openflags != openflags))
+  if(cache_inode_fd_usable(pentry_file, openflags))
     {
-#ifdef _USE_MFSL
-      fsal_status =
-          MFSL_close(&(pentry_file->object.file.open_fd.mfsl_fd), &pclient->mfsl_context, NULL);
-#else
-      fsal_status = FSAL_close(&(pentry_file->object.file.open_fd.fd));
-#endif
-      if(FSAL_IS_ERROR(fsal_status) && (fsal_status.major != ERR_FSAL_NOT_OPENED))
-        {
-          *pstatus = cache_inode_error_convert(fsal_status);
-
-          LogDebug(COMPONENT_CACHE_INODE,
-                   "cache_inode_open_by_name: returning %d(%s) from FSAL_close",
-                   *pstatus, cache_inode_err_str(*pstatus));
+      /* The kept descriptor serves this open */
+      cache_inode_fd_cache_hold(pentry_file);
+    }
+  else
+    {
+      newflags = cache_inode_fd_upgrade(pentry_file, openflags);
 
-          return *pstatus;
+      /* Open file need to be replaced, it is open with other flags. If it is
+       * in use, its last user closes it */
+      if(pentry_file->object.file.open_fd.fileno != 0)
+        {
+          retired = cache_inode_fd_cache_retire(pentry_file);
+
+          if(retired < 0)
+            {
+              /* the descriptor it replaced is still in use too */
+              *pstatus = CACHE_INODE_FSAL_DELAY;
+
+              LogDebug(COMPONENT_CACHE_INODE,
+                       "cache_inode_open_by_name: pentry %p: descriptor busy, returning %d(%s)",
+                       pentry_file, *pstatus, cache_inode_err_str(*pstatus));
+
+              return *pstatus;
+            }
+          else if(retired > 0)
+            {
+              pentry_file->object.file.open_fd.last_op = 0;
+              pentry_file->object.file.open_fd.fileno = 0;
+            }
+          else
+            {
+              fsal_status = cache_inode_fd_close(pentry_file, pclient);
+
+              if(FSAL_IS_ERROR(fsal_status) && (fsal_status.major != ERR_FSAL_NOT_OPENED))
+                {
+                  *pstatus = cache_inode_error_convert(fsal_status);
+
+                  LogDebug(COMPONENT_CACHE_INODE,
+                           "cache_inode_open_by_name: returning %d(%s) from FSAL_close",
+                           *pstatus, cache_inode_err_str(*pstatus));
+
+                  return *pstatus;
+                }
+            }
         }
 
-      pentry_file->object.file.open_fd.last_op = 0;
-      pentry_file->object.file.open_fd.fileno = 0;
-    }
-
-  if(pentry_file->object.file.open_fd.last_op == 0
-     || pentry_file->object.file.open_fd.fileno == 0)
-    {
       LogDebug(COMPONENT_FSAL,
                "cache_inode_open_by_name: pentry %p: lastop=0", pentry_file);
 
@@ -302,28 +439,16 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
         }
 
       /* opened file is not preserved yet */
-#ifdef _USE_MFSL
-      fsal_status = MFSL_open_by_name(&(pentry_dir->mobject),
-                                      pname,
-                                      pcontext,
-                                      &pclient->mfsl_context,
-                                      openflags,
-                                      &pentry_file->object.file.open_fd.mfsl_fd,
-                                      &(pentry_file->object.file.attributes),
-#ifdef _USE_PNFS
-                                      &pentry_file->object.file.pnfs_file ) ;
-#else
-                                      NULL );
-#endif /* _USE_PNFS */
+      fsal_status = cache_inode_fd_open_by_name(pentry_dir, pname, pentry_file,
+                                                pclient, newflags, pcontext);
 
-#else
-      fsal_status = FSAL_open_by_name(&(pentry_dir->object.file.handle),
-                                      pname,
-                                      pcontext,
-                                      openflags,
-                                      &pentry_file->object.file.open_fd.fd,
-                                      &(pentry_file->object.file.attributes));
-#endif
+      /* The upgrade may be refused (read-only file system...) */
+      if(FSAL_IS_ERROR(fsal_status) && (newflags != openflags))
+        {
+          newflags = openflags;
+          fsal_status = cache_inode_fd_open_by_name(pentry_dir, pname, pentry_file,
+                                                    pclient, newflags, pcontext);
+        }
 
       if(FSAL_IS_ERROR(fsal_status))
         {
@@ -336,6 +461,9 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
           return *pstatus;
         }
 
+      if(newflags != openflags)
+        cache_inode_fd_cache_upgraded();
+
 #ifdef _USE_PROXY
 
       /* If proxy if used, we should keep the name of the file to do FSAL_rcp if needed */
@@ -370,7 +498,9 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
           (int)FSAL_FILENO(&(pentry_file->object.file.open_fd.fd));
 #endif
       pentry_file->object.file.open_fd.last_op = time(NULL);
-      pentry_file->object.file.open_fd.openflags = openflags;
+      pentry_file->object.file.open_fd.openflags = newflags;
+
+      cache_inode_fd_cache_insert(pentry_file);
 
       LogDebug(COMPONENT_FSAL,
                "cache_inode_open_by_name: pentry %p: fd=%u",
@@ -381,17 +511,9 @@ cache_inode_status_t cache_inode_open_by_name(cache_entry_t * pentry_dir,
   /* regular exit */
   pentry_file->object.file.open_fd.last_op = time(NULL);
 
-  /* if file descriptor is too high, garbage collect FDs */
-  if(pclient->use_fd_cache
-     && (pentry_file->object.file.open_fd.fileno > pclient->max_fd))
-    {
-      if(cache_inode_gc_fd(pclient, pstatus) != CACHE_INODE_SUCCESS)
-        {
-          LogCrit(COMPONENT_CACHE_INODE_GC,
-                  "FAILURE performing FD garbage collection");
-          return *pstatus;
-        }
-    }
+  /* if too many files are open, close the least recently used ones */
+  if(cache_inode_fd_cache_full())
+    cache_inode_fd_cache_reclaim(pentry_file, pclient, FALSE);
 
   *pstatus = CACHE_INODE_SUCCESS;
   return *pstatus;
@@ -419,6 +541,7 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
                                        cache_inode_status_t * pstatus)
 {
   fsal_status_t fsal_status;
+  unsigned int refcount;
 
   if((pentry == NULL) || (pclient == NULL) || (pstatus == NULL))
     return CACHE_CONTENT_INVALID_ARGUMENT;
@@ -436,6 +559,9 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
       return *pstatus;
     }
 
+  /* the caller is done with the descriptor */
+  refcount = cache_inode_fd_cache_release(pentry, pclient);
+
   /* if locks are held in the file, do not close */
   if( cache_inode_file_holds_state( pentry ) )
     {
@@ -443,9 +569,11 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
       return *pstatus;
     }
 
-  if((pclient->use_fd_cache == 0) ||
-     (time(NULL) - pentry->object.file.open_fd.last_op > pclient->retention) ||
-     (pentry->object.file.open_fd.fileno > (int)(pclient->max_fd)))
+  /* the descriptor is not closed under its other users */
+  if((refcount == 0) &&
+     ((pclient->use_fd_cache == 0) ||
+      (time(NULL) - pentry->object.file.open_fd.last_op > pclient->retention) ||
+      cache_inode_fd_cache_full()))
     {
 
       LogDebug(COMPONENT_CACHE_INODE,
@@ -453,14 +581,7 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
                pentry, pentry->object.file.open_fd.fileno,
                (int)(time(NULL) - pentry->object.file.open_fd.last_op));
 
-#ifdef _USE_MFSL
-      fsal_status = MFSL_close(&(pentry->object.file.open_fd.mfsl_fd), &pclient->mfsl_context, NULL);
-#else
-      fsal_status = FSAL_close(&(pentry->object.file.open_fd.fd));
-#endif
-
-      pentry->object.file.open_fd.fileno = 0;
-      pentry->object.file.open_fd.last_op = 0;
+      fsal_status = cache_inode_fd_close(pentry, pclient);
 
       if(FSAL_IS_ERROR(fsal_status) && (fsal_status.major != ERR_FSAL_NOT_OPENED))
         {
@@ -473,6 +594,12 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
           return *pstatus;
         }
     }
+  else if(pentry->object.file.open_fd.fileno != 0)
+    {
+      /* the descriptor is kept for the next opens */
+      cache_inode_fd_cache_close_avoided();
+    }
+
 #ifdef _USE_PROXY
   /* If proxy if used, free the name if needed */
   if(pentry->object.file.pname != NULL)
@@ -60,6 +60,93 @@
 #include <time.h>
 #include <pthread.h>
 
+#ifndef _USE_MFSL
+/* An IO handed to the FSAL, the worker waits for its completion */
+typedef struct cache_inode_async_io__
+{
+  cache_inode_client_t *pclient;                /* its mutex and cond are used */
+  int done;
+  fsal_status_t status;
+  fsal_size_t io_amount;
+  fsal_boolean_t end_of_file;
+} cache_inode_async_io_t;
+
+static void cache_inode_async_io_done(void *cb_arg,
+                                      fsal_status_t status,
+                                      fsal_size_t io_amount,
+                                      fsal_boolean_t end_of_file)
+{
+  cache_inode_async_io_t *pio = (cache_inode_async_io_t *) cb_arg;
+  cache_inode_client_t *pclient = pio->pclient;
+
+  P(pclient->async_io_mutex);
+  pio->status = status;
+  pio->io_amount = io_amount;
+  pio->end_of_file = end_of_file;
+  pio->done = TRUE;
+  pthread_cond_signal(&pclient->async_io_cond);
+  V(pclient->async_io_mutex);
+}                               /* cache_inode_async_io_done */
+
+/**
+ *
+ * cache_inode_async_io: does an IO through the asynchronous FSAL entry points.
+ *
+ * The worker does not hold a FSAL call token while the IO is in flight: it
+ * sleeps until the FSAL completion thread wakes it up. On a FSAL with no
+ * asynchronous IO, the IO is done in place.
+ *
+ * @param pfd [IN] the opened file.
+ * @param read_or_write [IN] CACHE_INODE_READ or CACHE_INODE_WRITE.
+ * @param seek_descriptor [IN] absolute position of the IO.
+ * @param io_size [IN] size of the IO.
+ * @param buffer write:[IN] read:[OUT] the buffer for the data.
+ * @param pio_size [OUT] the size of the io that was successfully made.
+ * @param p_fsal_eof [OUT] set if a read reached the end of the file.
+ * @param pclient [INOUT] the client doing the IO, it waits on its condition.
+ *
+ * @return the FSAL status of the IO.
+ *
+ */
+static fsal_status_t cache_inode_async_io(fsal_file_t * pfd,
+                                          cache_inode_io_direction_t read_or_write,
+                                          fsal_seek_t * seek_descriptor,
+                                          fsal_size_t io_size,
+                                          caddr_t buffer,
+                                          fsal_size_t * pio_size,
+                                          fsal_boolean_t * p_fsal_eof,
+                                          cache_inode_client_t * pclient)
+{
+  cache_inode_async_io_t io;
+  fsal_status_t fsal_status;
+
+  io.pclient = pclient;
+  io.done = FALSE;
+
+  if(read_or_write == CACHE_INODE_READ)
+    fsal_status = FSAL_read_async(pfd, seek_descriptor, io_size, buffer,
+                                  cache_inode_async_io_done, &io);
+  else
+    fsal_status = FSAL_write_async(pfd, seek_descriptor, io_size, buffer,
+                                   cache_inode_async_io_done, &io);
+
+  if(!FSAL_IS_ERROR(fsal_status))
+    {
+      P(pclient->async_io_mutex);
+      while(!io.done)
+        pthread_cond_wait(&pclient->async_io_cond, &pclient->async_io_mutex);
+      V(pclient->async_io_mutex);
+
+      fsal_status = io.status;
+      *pio_size = io.io_amount;
+      if(io.end_of_file && p_fsal_eof != NULL)
+        *p_fsal_eof = TRUE;
+    }
+
+  return fsal_status;
+}                               /* cache_inode_async_io */
+#endif                          /* _USE_MFSL */
+
 /**
  *
  * cache_inode_rdwr: Reads/Writes through the cache layer.
@@ -142,6 +229,11 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
       io_direction = CACHE_CONTENT_WRITE;
       openflags = FSAL_O_WRONLY;
       pclient->stat.func_stats.nb_call[CACHE_INODE_WRITE_DATA] += 1;
+
+      /* Don't let writers outrun the data cache flush (not under the entry's lock) */
+      if(pentry->internal_md.type == REGULAR_FILE &&
+         pentry->object.file.pentry_content != NULL)
+        cache_content_write_throttle();
     }
 
   P_w(&pentry->lock);
@@ -353,9 +445,10 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
                                       buffer,
                                       pio_size, p_fsal_eof, &pclient->mfsl_context, NULL);
 #else
-              fsal_status = FSAL_read(&(pentry->object.file.open_fd.fd),
-                                      seek_descriptor,
-                                      io_size, buffer, pio_size, p_fsal_eof);
+              fsal_status = cache_inode_async_io(&(pentry->object.file.open_fd.fd),
+                                                 CACHE_INODE_READ, seek_descriptor,
+                                                 io_size, buffer, pio_size, p_fsal_eof,
+                                                 pclient);
 #endif
             }
           else
@@ -365,8 +458,10 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
                                        seek_descriptor,
                                        io_size, buffer, pio_size, &pclient->mfsl_context, NULL);
 #else
-              fsal_status = FSAL_write(&(pentry->object.file.open_fd.fd),
-                                       seek_descriptor, io_size, buffer, pio_size);
+              fsal_status = cache_inode_async_io(&(pentry->object.file.open_fd.fd),
+                                                 CACHE_INODE_WRITE, seek_descriptor,
+                                                 io_size, buffer, pio_size, p_fsal_eof,
+                                                 pclient);
 #endif
 
 #if 0
@@ -426,6 +521,8 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
 
               pentry->object.file.open_fd.last_op = 0;
               pentry->object.file.open_fd.fileno = 0;
+              cache_inode_fd_cache_release(pentry, pclient);
+              cache_inode_fd_cache_remove(pentry);
 
               V_w(&pentry->lock);
 
@@ -317,6 +317,23 @@ cache_inode_status_t cache_inode_read_conf_client_parameter(config_file_t in_con
         {
           pparam->use_fd_cache = StrToBoolean(key_value);
         }
+      else if(!strcasecmp(key_name, "Max_Open_Files"))
+        {
+          pparam->max_open_files = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Snapshot_File"))
+        {
+          strncpy(pparam->snapshot_file, key_value, MAXPATHLEN);
+          pparam->snapshot_file[MAXPATHLEN - 1] = '\0';
+        }
+      else if(!strcasecmp(key_name, "Snapshot_Max_Entries"))
+        {
+          pparam->snapshot_max_entries = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Snapshot_Interval"))
+        {
+          pparam->snapshot_interval = atoi(key_value);
+        }
       else if(!strcasecmp( key_name, "Use_FSAL_Hash" ) )
         {
           pparam->use_fsal_hash = StrToBoolean(key_value);
@@ -508,6 +525,12 @@ void cache_inode_print_conf_client_parameter(FILE * output,
           (int)param.grace_period_dirent);
   fprintf(output, "CacheInode Client: Use_Test_Access              = %d\n",
           param.use_test_access);
+  fprintf(output, "CacheInode Client: Snapshot_File                = %s\n",
+          param.snapshot_file);
+  fprintf(output, "CacheInode Client: Snapshot_Max_Entries         = %u\n",
+          param.snapshot_max_entries);
+  fprintf(output, "CacheInode Client: Snapshot_Interval            = %u\n",
+          param.snapshot_interval);
 }                               /* cache_inode_print_conf_client_parameter */
 
 /**
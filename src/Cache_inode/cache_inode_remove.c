@@ -470,6 +470,9 @@ cache_inode_status_t cache_inode_remove_sw(cache_entry_t * pentry,             /
       	return *pstatus;
       }
 
+      /* Close the file if it is still open */
+      cache_inode_fd_cache_forget(to_remove_entry, pclient);
+
       /* Finally put the main pentry back to pool */
       if(use_mutex)
         V_w(&to_remove_entry->lock);
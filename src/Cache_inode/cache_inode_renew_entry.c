@@ -57,6 +57,26 @@
 #include <pthread.h>
 #include <assert.h>
 
+/* Entries refreshed before this time are out of date */
+static time_t cache_inode_invalidated_all = 0;
+
+/**
+ *
+ * cache_inode_invalidate_all: marks all the cached entries as out of date.
+ *
+ * Used when the changes made to the filesystem were lost (an upcall queue
+ * overflowed): each entry is refreshed the next time it is used, even if its
+ * expiration type is Never.
+ *
+ */
+void cache_inode_invalidate_all(void)
+{
+  cache_inode_invalidated_all = time(NULL);
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "cache_inode_invalidate_all: all the cached entries will be refreshed");
+}                               /* cache_inode_invalidate_all */
+
 /**
  *
  * cache_inode_renew_entry: Renews the attributes for an entry.
@@ -153,6 +173,16 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
         }
     }
 
+  /* Refreshed before an invalidation of the whole cache, same as an upcall
+   * on this entry */
+  if(entry_time <= cache_inode_invalidated_all &&
+     pentry->internal_md.valid_state == VALID)
+    {
+      pentry->internal_md.valid_state = STALE;
+      if(pentry->internal_md.type == DIRECTORY)
+        pentry->object.dir.has_been_readdir = CACHE_INODE_RENEW_NEEDED;
+    }
+
   /* An entry that is a regular file with an associated File Content Entry won't
    * expire until data exists in File Content Cache, to avoid attributes incoherency */
 
@@ -267,9 +297,9 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
   /* if( pclient->getattr_dir_invalidation && ... */
   /* Check for dir content expiration and/or staleness */
   if(pentry->internal_md.type == DIRECTORY &&
-     pclient->expire_type_dirent != CACHE_INODE_EXPIRE_NEVER &&
      pentry->object.dir.has_been_readdir == CACHE_INODE_YES &&
-     ((current_time - entry_time >= pclient->grace_period_dirent)
+     ((pclient->expire_type_dirent != CACHE_INODE_EXPIRE_NEVER &&
+       current_time - entry_time >= pclient->grace_period_dirent)
       || (pentry->internal_md.valid_state == STALE)))
     {
       /* Would be better if state was a flag that we could and/or the bits but
@@ -367,9 +397,10 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
   /* if( pentry->internal_md.type == DIRECTORY && ... */
   /* if the directory has not been readdir, only update its attributes */
   else if(pentry->internal_md.type == DIRECTORY &&
-          pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
           pentry->object.dir.has_been_readdir != CACHE_INODE_YES &&
-	  ((current_time - entry_time >= pclient->grace_period_attr) || (pentry->internal_md.valid_state == STALE)))
+	  ((pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
+            current_time - entry_time >= pclient->grace_period_attr)
+           || (pentry->internal_md.valid_state == STALE)))
     {
       /* Would be better if state was a flag that we could and/or the bits but
        * in any case we need to get rid of stale so we only go through here
@@ -458,8 +489,8 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
   /* else if( pentry->internal_md.type == DIRECTORY && ... */
   /* Check for attributes expiration in other cases */
   else if(pentry->internal_md.type != DIRECTORY &&
-          pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
-	  ((current_time - entry_time >= pclient->grace_period_attr)
+	  ((pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
+            current_time - entry_time >= pclient->grace_period_attr)
 	   || (pentry->internal_md.valid_state == STALE)))
     {
       /* Would be better if state was a flag that we could and/or the bits but
@@ -562,8 +593,8 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
   /* if(  pentry->internal_md.type   != DIR_CONTINUE && ... */
   /* Check for link content expiration */
   if(pentry->internal_md.type == SYMBOLIC_LINK &&
-     pclient->expire_type_link != CACHE_INODE_EXPIRE_NEVER &&
-     ((current_time - entry_time >= pclient->grace_period_link)
+     ((pclient->expire_type_link != CACHE_INODE_EXPIRE_NEVER &&
+       current_time - entry_time >= pclient->grace_period_link)
       || (pentry->internal_md.valid_state == STALE)))
     {
       assert(pentry->object.symlink);
@@ -0,0 +1,977 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_inode_snapshot.c
+ * \brief   Snapshot of the hottest cache inode entries, reloaded at startup.
+ *
+ * cache_inode_snapshot.c : snapshot of the hottest cache inode entries.
+ *
+ * The most recently used entries are written to a binary file: FSAL handle,
+ * attributes, name in the parent directory and rank in the LRU. Parents are
+ * written before their children so that the file can be reloaded in one
+ * pass. Reloaded entries are added as STALE: nothing is trusted before it is
+ * revalidated by the FSAL, the snapshot only saves the cost of building the
+ * entries and of the lookups that lead to them.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "stuff_alloc.h"
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "fsal.h"
+#include "cache_inode.h"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+
+/* A snapshot is not reloaded above this depth in the namespace */
+#define CACHE_INODE_SNAPSHOT_MAX_DEPTH 256
+
+typedef struct cache_inode_snapshot_slot__
+{
+  time_t rank_time;                             /**< Last use of the entry                */
+  cache_inode_fsal_data_t fsdata;               /**< Hash key of the entry                */
+  cache_entry_t *pentry;                        /**< The entry, NULL if it is not saved   */
+  unsigned int parent;                          /**< Slot of the parent, or NO_PARENT     */
+  unsigned int depth;                           /**< Depth of the entry in the snapshot   */
+  unsigned int index;                           /**< Index of the record in the file      */
+  cache_inode_snapshot_record_t record;         /**< Record to be written                 */
+  fsal_name_t name;                             /**< Name in the parent directory         */
+  char *link;                                   /**< Content of a symbolic link           */
+} cache_inode_snapshot_slot_t;
+
+typedef struct cache_inode_snapshot_ref__
+{
+  cache_entry_t *pentry;
+  unsigned int slot;
+} cache_inode_snapshot_ref_t;
+
+/**
+ *
+ * cache_inode_snapshot_checksum: computes the checksum of a buffer.
+ *
+ * @param hash   [IN] checksum of the previous buffers.
+ * @param buffer [IN] buffer to be added to the checksum.
+ * @param len    [IN] length of the buffer.
+ *
+ * @return the checksum (32 bits FNV-1a).
+ *
+ */
+static unsigned int cache_inode_snapshot_checksum(unsigned int hash, void *buffer, size_t len)
+{
+  unsigned char *p = (unsigned char *)buffer;
+  size_t i;
+
+  for(i = 0; i < len; i++)
+    {
+      hash ^= p[i];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}                               /* cache_inode_snapshot_checksum */
+
+/**
+ *
+ * cache_inode_snapshot_heap_down: restores the min-heap of the candidates.
+ *
+ * @param slots [INOUT] the heap, ordered by rank_time.
+ * @param count [IN]    number of slots in the heap.
+ * @param i     [IN]    slot to be moved down.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void cache_inode_snapshot_heap_down(cache_inode_snapshot_slot_t * slots,
+                                           unsigned int count, unsigned int i)
+{
+  cache_inode_snapshot_slot_t tmp;
+  unsigned int child;
+
+  while((child = 2 * i + 1) < count)
+    {
+      if(child + 1 < count && slots[child + 1].rank_time < slots[child].rank_time)
+        child += 1;
+
+      if(slots[i].rank_time <= slots[child].rank_time)
+        break;
+
+      tmp = slots[i];
+      slots[i] = slots[child];
+      slots[child] = tmp;
+      i = child;
+    }
+}                               /* cache_inode_snapshot_heap_down */
+
+/**
+ *
+ * cache_inode_snapshot_heap_up: inserts the last slot in the min-heap.
+ *
+ * @param slots [INOUT] the heap, ordered by rank_time.
+ * @param i     [IN]    slot to be moved up.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void cache_inode_snapshot_heap_up(cache_inode_snapshot_slot_t * slots, unsigned int i)
+{
+  cache_inode_snapshot_slot_t tmp;
+
+  while(i > 0 && slots[(i - 1) / 2].rank_time > slots[i].rank_time)
+    {
+      tmp = slots[i];
+      slots[i] = slots[(i - 1) / 2];
+      slots[(i - 1) / 2] = tmp;
+      i = (i - 1) / 2;
+    }
+}                               /* cache_inode_snapshot_heap_up */
+
+static int cache_inode_snapshot_by_time(const void *a, const void *b)
+{
+  const cache_inode_snapshot_slot_t *sa = a;
+  const cache_inode_snapshot_slot_t *sb = b;
+
+  /* Most recently used first */
+  if(sa->rank_time != sb->rank_time)
+    return (sa->rank_time > sb->rank_time) ? -1 : 1;
+  return 0;
+}
+
+static int cache_inode_snapshot_by_pentry(const void *a, const void *b)
+{
+  const cache_inode_snapshot_ref_t *ra = a;
+  const cache_inode_snapshot_ref_t *rb = b;
+
+  if(ra->pentry != rb->pentry)
+    return (ra->pentry < rb->pentry) ? -1 : 1;
+  return 0;
+}
+
+/* Used to sort the slots in the order of the file: parents first, then rank */
+static cache_inode_snapshot_slot_t *cache_inode_snapshot_sort_slots;
+
+static int cache_inode_snapshot_by_depth(const void *a, const void *b)
+{
+  const cache_inode_snapshot_slot_t *sa =
+      &cache_inode_snapshot_sort_slots[*(const unsigned int *)a];
+  const cache_inode_snapshot_slot_t *sb =
+      &cache_inode_snapshot_sort_slots[*(const unsigned int *)b];
+
+  if(sa->depth != sb->depth)
+    return (sa->depth < sb->depth) ? -1 : 1;
+  if(sa->record.rank != sb->record.rank)
+    return (sa->record.rank < sb->record.rank) ? -1 : 1;
+  return 0;
+}
+
+/**
+ *
+ * cache_inode_snapshot_collect: picks the most recently used entries.
+ *
+ * The hash table is walked one partition at a time, under the partition's
+ * read lock, only the key and the last use time of each entry are read.
+ *
+ * @param ht          [IN]  the cache inode hash table.
+ * @param slots       [OUT] array of max_entries slots, filled as a min-heap.
+ * @param max_entries [IN]  number of entries to be kept.
+ *
+ * @return the number of slots filled.
+ *
+ */
+static unsigned int cache_inode_snapshot_collect(hash_table_t * ht,
+                                                 cache_inode_snapshot_slot_t * slots,
+                                                 unsigned int max_entries)
+{
+  struct rbt_head *tete_rbt;
+  struct rbt_node *it;
+  hash_data_t *pdata;
+  cache_entry_t *pentry;
+  unsigned int count = 0;
+  unsigned int i;
+  time_t rank_time;
+
+  for(i = 0; i < ht->parameter.index_size; i++)
+    {
+      P_r(&ht->array_lock[i]);
+
+      tete_rbt = &((ht->array_rbt)[i]);
+      RBT_LOOP(tete_rbt, it)
+      {
+        pdata = (hash_data_t *) it->rbt_opaq;
+        pentry = (cache_entry_t *) pdata->buffval.pdata;
+        rank_time = CACHE_INODE_TIME(pentry);
+
+        if(count < max_entries)
+          {
+            slots[count].rank_time = rank_time;
+            slots[count].fsdata = *(cache_inode_fsal_data_t *) pdata->buffkey.pdata;
+            cache_inode_snapshot_heap_up(slots, count);
+            count += 1;
+          }
+        else if(rank_time > slots[0].rank_time)
+          {
+            slots[0].rank_time = rank_time;
+            slots[0].fsdata = *(cache_inode_fsal_data_t *) pdata->buffkey.pdata;
+            cache_inode_snapshot_heap_down(slots, count, 0);
+          }
+
+        RBT_INCREMENT(it);
+      }
+
+      V_r(&ht->array_lock[i]);
+    }
+
+  return count;
+}                               /* cache_inode_snapshot_collect */
+
+/**
+ *
+ * cache_inode_snapshot_lookup_slot: finds the slot of a cached entry.
+ *
+ * @param refs    [IN] the saved entries, sorted by address.
+ * @param nb_refs [IN] number of saved entries.
+ * @param pentry  [IN] the entry.
+ *
+ * @return the slot, CACHE_INODE_SNAPSHOT_NO_PARENT if the entry is not saved.
+ *
+ */
+static unsigned int cache_inode_snapshot_lookup_slot(cache_inode_snapshot_ref_t * refs,
+                                                     unsigned int nb_refs,
+                                                     cache_entry_t * pentry)
+{
+  cache_inode_snapshot_ref_t key;
+  cache_inode_snapshot_ref_t *pref;
+
+  key.pentry = pentry;
+  pref = bsearch(&key, refs, nb_refs, sizeof(cache_inode_snapshot_ref_t),
+                 cache_inode_snapshot_by_pentry);
+
+  return (pref == NULL) ? CACHE_INODE_SNAPSHOT_NO_PARENT : pref->slot;
+}                               /* cache_inode_snapshot_lookup_slot */
+
+/**
+ *
+ * cache_inode_snapshot_write: writes the snapshot file.
+ *
+ * The file is written aside and renamed, a snapshot is either complete or
+ * the previous one is kept.
+ *
+ * @param path  [IN] path of the snapshot.
+ * @param slots [IN] the slots.
+ * @param order [IN] the slots to be written, in the order of the file.
+ * @param count [IN] number of records.
+ *
+ * @return 0 if successful, -1 otherwise (errno is set).
+ *
+ */
+static int cache_inode_snapshot_write(char *path,
+                                      cache_inode_snapshot_slot_t * slots,
+                                      unsigned int *order, unsigned int count)
+{
+  char tmp_path[MAXPATHLEN];
+  cache_inode_snapshot_header_t header;
+  cache_inode_snapshot_slot_t *pslot;
+  FILE *stream;
+  unsigned int checksum = 2166136261U;
+  unsigned int i;
+  int errsv;
+
+  snprintf(tmp_path, MAXPATHLEN, "%s.tmp", path);
+
+  if((stream = fopen(tmp_path, "w")) == NULL)
+    return -1;
+
+  memset(&header, 0, sizeof(header));
+  header.magic = CACHE_INODE_SNAPSHOT_MAGIC;
+  header.version = CACHE_INODE_SNAPSHOT_VERSION;
+  header.handle_size = sizeof(fsal_handle_t);
+  header.attr_size = sizeof(fsal_attrib_list_t);
+  header.nb_records = count;
+  header.saved_time = (u_int64_t) time(NULL);
+
+  /* The header is written again with the checksum once the records are there */
+  if(fwrite(&header, sizeof(header), 1, stream) != 1)
+    goto error;
+
+  for(i = 0; i < count; i++)
+    {
+      pslot = &slots[order[i]];
+
+      if(fwrite(&pslot->record, sizeof(pslot->record), 1, stream) != 1)
+        goto error;
+      checksum = cache_inode_snapshot_checksum(checksum, &pslot->record,
+                                               sizeof(pslot->record));
+
+      if(pslot->record.name_len > 0)
+        {
+          if(fwrite(pslot->name.name, pslot->record.name_len, 1, stream) != 1)
+            goto error;
+          checksum = cache_inode_snapshot_checksum(checksum, pslot->name.name,
+                                                   pslot->record.name_len);
+        }
+
+      if(pslot->record.link_len > 0)
+        {
+          if(fwrite(pslot->link, pslot->record.link_len, 1, stream) != 1)
+            goto error;
+          checksum = cache_inode_snapshot_checksum(checksum, pslot->link,
+                                                   pslot->record.link_len);
+        }
+    }
+
+  header.checksum = checksum;
+
+  if(fseek(stream, 0L, SEEK_SET) != 0 ||
+     fwrite(&header, sizeof(header), 1, stream) != 1 ||
+     fflush(stream) != 0 || fsync(fileno(stream)) != 0)
+    goto error;
+
+  if(fclose(stream) != 0)
+    {
+      errsv = errno;
+      unlink(tmp_path);
+      errno = errsv;
+      return -1;
+    }
+
+  return rename(tmp_path, path);
+
+ error:
+  errsv = errno;
+  fclose(stream);
+  unlink(tmp_path);
+  errno = errsv;
+  return -1;
+}                               /* cache_inode_snapshot_write */
+
+/**
+ *
+ * cache_inode_snapshot_save: saves the hottest entries of the cache.
+ *
+ * The max_entries most recently used entries are written to the snapshot
+ * file, with their name in their parent directory when the parent is saved
+ * too. Entries that are still STALE (not revalidated since they were
+ * invalidated or reloaded) are not saved, so a snapshot does not keep
+ * entries that no client used.
+ *
+ * @param ht          [IN]  the cache inode hash table.
+ * @param path        [IN]  path of the snapshot file.
+ * @param max_entries [IN]  max number of entries to be saved.
+ * @param pnb_saved   [OUT] number of entries saved.
+ * @param pstatus     [OUT] returned status.
+ *
+ * @return CACHE_INODE_SUCCESS if successful, an error otherwise.
+ *
+ */
+cache_inode_status_t cache_inode_snapshot_save(hash_table_t * ht,
+                                               char *path,
+                                               unsigned int max_entries,
+                                               unsigned int *pnb_saved,
+                                               cache_inode_status_t * pstatus)
+{
+  cache_inode_snapshot_slot_t *slots = NULL;
+  cache_inode_snapshot_ref_t *refs = NULL;
+  unsigned int *order = NULL;
+  unsigned int count;
+  unsigned int nb_refs = 0;
+  unsigned int nb_saved = 0;
+  unsigned int i;
+  unsigned int slot;
+  unsigned int pass;
+  int changed;
+  hash_buffer_t key, value;
+  cache_entry_t *pentry;
+  struct avltree_node *dirent_node;
+  cache_inode_dir_entry_t *dirent;
+
+  *pstatus = CACHE_INODE_SUCCESS;
+  *pnb_saved = 0;
+
+  if(max_entries == 0)
+    return *pstatus;
+
+  if((slots = (cache_inode_snapshot_slot_t *)
+      Mem_Alloc(max_entries * sizeof(cache_inode_snapshot_slot_t))) == NULL)
+    {
+      *pstatus = CACHE_INODE_MALLOC_ERROR;
+      return *pstatus;
+    }
+
+  /* 1- Pick the candidates, then rank them */
+  count = cache_inode_snapshot_collect(ht, slots, max_entries);
+  qsort(slots, count, sizeof(cache_inode_snapshot_slot_t), cache_inode_snapshot_by_time);
+
+  if(count == 0 ||
+     (refs = (cache_inode_snapshot_ref_t *)
+      Mem_Alloc(count * sizeof(cache_inode_snapshot_ref_t))) == NULL ||
+     (order = (unsigned int *)Mem_Alloc(count * sizeof(unsigned int))) == NULL)
+    {
+      *pstatus = (count == 0) ? CACHE_INODE_SUCCESS : CACHE_INODE_MALLOC_ERROR;
+      goto out;
+    }
+
+  /* 2- Resolve the candidates still in the cache */
+  for(i = 0; i < count; i++)
+    {
+      slots[i].pentry = NULL;
+      slots[i].link = NULL;
+      slots[i].parent = CACHE_INODE_SNAPSHOT_NO_PARENT;
+      slots[i].name.len = 0;
+
+      key.pdata = (caddr_t) & slots[i].fsdata;
+      key.len = sizeof(cache_inode_fsal_data_t);
+
+      if(HashTable_Get(ht, &key, &value) != HASHTABLE_SUCCESS)
+        continue;
+
+      slots[i].pentry = (cache_entry_t *) value.pdata;
+      refs[nb_refs].pentry = slots[i].pentry;
+      refs[nb_refs].slot = i;
+      nb_refs += 1;
+    }
+
+  qsort(refs, nb_refs, sizeof(cache_inode_snapshot_ref_t), cache_inode_snapshot_by_pentry);
+
+  /* 3- Copy the entries, directories give the names of their saved children */
+  for(i = 0; i < count; i++)
+    {
+      if((pentry = slots[i].pentry) == NULL)
+        continue;
+
+      /* The entry may have been recycled since it was resolved */
+      key.pdata = (caddr_t) & slots[i].fsdata;
+      key.len = sizeof(cache_inode_fsal_data_t);
+
+      if(HashTable_Get(ht, &key, &value) != HASHTABLE_SUCCESS ||
+         (cache_entry_t *) value.pdata != pentry)
+        {
+          slots[i].pentry = NULL;
+          continue;
+        }
+
+      P_r(&pentry->lock);
+
+      if(pentry->internal_md.valid_state != VALID ||
+         (pentry->internal_md.type != REGULAR_FILE &&
+          pentry->internal_md.type != DIRECTORY &&
+          pentry->internal_md.type != SYMBOLIC_LINK &&
+          pentry->internal_md.type != SOCKET_FILE &&
+          pentry->internal_md.type != FIFO_FILE &&
+          pentry->internal_md.type != BLOCK_FILE &&
+          pentry->internal_md.type != CHARACTER_FILE))
+        {
+          V_r(&pentry->lock);
+          slots[i].pentry = NULL;
+          continue;
+        }
+
+      memset(&slots[i].record, 0, sizeof(cache_inode_snapshot_record_t));
+      slots[i].record.rank = i;
+      slots[i].record.type = pentry->internal_md.type;
+      slots[i].record.policy = pentry->policy;
+      slots[i].record.handle = slots[i].fsdata.handle;
+      cache_inode_get_attributes(pentry, &slots[i].record.attributes);
+
+      if(pentry->internal_md.type == SYMBOLIC_LINK &&
+         (CACHE_INODE_KEEP_CONTENT(pentry->policy)) &&
+         pentry->object.symlink->content.len > 0 &&
+         pentry->object.symlink->content.len < FSAL_MAX_PATH_LEN)
+        {
+          if((slots[i].link = (char *)Mem_Alloc(pentry->object.symlink->content.len)) != NULL)
+            {
+              memcpy(slots[i].link, pentry->object.symlink->content.path,
+                     pentry->object.symlink->content.len);
+              slots[i].record.link_len = pentry->object.symlink->content.len;
+            }
+        }
+
+      /* A symbolic link without its content can't be reloaded */
+      if(pentry->internal_md.type == SYMBOLIC_LINK &&
+         (CACHE_INODE_KEEP_CONTENT(pentry->policy)) && slots[i].record.link_len == 0)
+        {
+          V_r(&pentry->lock);
+          slots[i].pentry = NULL;
+          continue;
+        }
+
+      if(pentry->internal_md.type == DIRECTORY &&
+         (dirent_node = avltree_first(&pentry->object.dir.dentries)) != NULL)
+        {
+          do
+            {
+              dirent = avltree_container_of(dirent_node, cache_inode_dir_entry_t, node_n);
+
+              if(dirent->pentry == NULL || dirent->pentry == pentry)
+                continue;
+
+              /* Hard links: the first name found is kept */
+              slot = cache_inode_snapshot_lookup_slot(refs, nb_refs, dirent->pentry);
+              if(slot != CACHE_INODE_SNAPSHOT_NO_PARENT &&
+                 slots[slot].parent == CACHE_INODE_SNAPSHOT_NO_PARENT &&
+                 dirent->name.len > 0 && dirent->name.len < FSAL_MAX_NAME_LEN)
+                {
+                  slots[slot].parent = i;
+                  slots[slot].name = dirent->name;
+                }
+            }
+          while((dirent_node = avltree_next(dirent_node)) != NULL);
+        }
+
+      V_r(&pentry->lock);
+    }
+
+  /* 4- Parents are to be written before their children */
+  for(i = 0; i < count; i++)
+    {
+      if(slots[i].parent != CACHE_INODE_SNAPSHOT_NO_PARENT &&
+         slots[slots[i].parent].pentry == NULL)
+        slots[i].parent = CACHE_INODE_SNAPSHOT_NO_PARENT;
+
+      slots[i].depth = (slots[i].parent == CACHE_INODE_SNAPSHOT_NO_PARENT) ? 0 : UINT_MAX;
+    }
+
+  for(pass = 0, changed = TRUE; changed && pass < CACHE_INODE_SNAPSHOT_MAX_DEPTH; pass++)
+    {
+      changed = FALSE;
+      for(i = 0; i < count; i++)
+        if(slots[i].depth == UINT_MAX && slots[slots[i].parent].depth != UINT_MAX)
+          {
+            slots[i].depth = slots[slots[i].parent].depth + 1;
+            changed = TRUE;
+          }
+    }
+
+  for(i = 0; i < count; i++)
+    {
+      /* Too deep, or a loop made by concurrent renames: keep it without its name */
+      if(slots[i].depth == UINT_MAX)
+        {
+          slots[i].depth = 0;
+          slots[i].parent = CACHE_INODE_SNAPSHOT_NO_PARENT;
+        }
+
+      if(slots[i].pentry != NULL)
+        order[nb_saved++] = i;
+    }
+
+  cache_inode_snapshot_sort_slots = slots;
+  qsort(order, nb_saved, sizeof(unsigned int), cache_inode_snapshot_by_depth);
+
+  for(i = 0; i < nb_saved; i++)
+    slots[order[i]].index = i;
+
+  for(i = 0; i < nb_saved; i++)
+    {
+      cache_inode_snapshot_slot_t *pslot = &slots[order[i]];
+
+      if(pslot->parent == CACHE_INODE_SNAPSHOT_NO_PARENT)
+        {
+          pslot->record.parent = CACHE_INODE_SNAPSHOT_NO_PARENT;
+          pslot->record.name_len = 0;
+        }
+      else
+        {
+          pslot->record.parent = slots[pslot->parent].index;
+          pslot->record.name_len = pslot->name.len;
+        }
+    }
+
+  /* 5- Write it */
+  if(cache_inode_snapshot_write(path, slots, order, nb_saved) != 0)
+    {
+      LogCrit(COMPONENT_CACHE_INODE,
+              "Could not write cache inode snapshot %s: error %d (%s)",
+              path, errno, strerror(errno));
+      *pstatus = CACHE_INODE_IO_ERROR;
+      goto out;
+    }
+
+  *pnb_saved = nb_saved;
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "Cache inode snapshot %s: %u entries saved", path, nb_saved);
+
+ out:
+  for(i = 0; i < count && refs != NULL && order != NULL; i++)
+    if(slots[i].link != NULL)
+      Mem_Free(slots[i].link);
+  if(order != NULL)
+    Mem_Free(order);
+  if(refs != NULL)
+    Mem_Free(refs);
+  Mem_Free(slots);
+
+  return *pstatus;
+}                               /* cache_inode_snapshot_save */
+
+/**
+ *
+ * cache_inode_snapshot_read: reads and checks a snapshot file.
+ *
+ * @param path     [IN]  path of the snapshot.
+ * @param pbuffer  [OUT] content of the file (to be freed with Mem_Free).
+ * @param precords [OUT] pointers to the records in the buffer (to be freed with Mem_Free).
+ * @param pcount   [OUT] number of records.
+ *
+ * @return 0 if successful, -1 otherwise (errno is ENOENT if there is no snapshot).
+ *
+ */
+static int cache_inode_snapshot_read(char *path, char **pbuffer,
+                                     cache_inode_snapshot_record_t *** precords,
+                                     unsigned int *pcount)
+{
+  cache_inode_snapshot_header_t *pheader;
+  cache_inode_snapshot_record_t **records = NULL;
+  cache_inode_snapshot_record_t *precord;
+  struct stat st;
+  char *buffer = NULL;
+  size_t offset;
+  unsigned int i;
+  int fd;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(cache_inode_snapshot_header_t))
+    {
+      close(fd);
+      errno = EINVAL;
+      return -1;
+    }
+
+  if((buffer = (char *)Mem_Alloc(st.st_size)) == NULL)
+    {
+      close(fd);
+      errno = ENOMEM;
+      return -1;
+    }
+
+  for(offset = 0; offset < (size_t) st.st_size;)
+    {
+      ssize_t rc = read(fd, buffer + offset, st.st_size - offset);
+
+      if(rc <= 0)
+        {
+          if(rc < 0 && errno == EINTR)
+            continue;
+          close(fd);
+          Mem_Free(buffer);
+          errno = EIO;
+          return -1;
+        }
+      offset += rc;
+    }
+
+  close(fd);
+
+  pheader = (cache_inode_snapshot_header_t *) buffer;
+
+  if(pheader->magic != CACHE_INODE_SNAPSHOT_MAGIC ||
+     pheader->version != CACHE_INODE_SNAPSHOT_VERSION ||
+     pheader->handle_size != sizeof(fsal_handle_t) ||
+     pheader->attr_size != sizeof(fsal_attrib_list_t) ||
+     pheader->checksum != cache_inode_snapshot_checksum(2166136261U,
+                                                        buffer + sizeof(*pheader),
+                                                        st.st_size - sizeof(*pheader)))
+    {
+      Mem_Free(buffer);
+      errno = EINVAL;
+      return -1;
+    }
+
+  if(pheader->nb_records > 0 &&
+     (records = (cache_inode_snapshot_record_t **)
+      Mem_Alloc(pheader->nb_records * sizeof(cache_inode_snapshot_record_t *))) == NULL)
+    {
+      Mem_Free(buffer);
+      errno = ENOMEM;
+      return -1;
+    }
+
+  for(i = 0, offset = sizeof(*pheader); i < pheader->nb_records; i++)
+    {
+      if(offset + sizeof(cache_inode_snapshot_record_t) > (size_t) st.st_size)
+        break;
+
+      precord = (cache_inode_snapshot_record_t *) (buffer + offset);
+
+      if(precord->name_len >= FSAL_MAX_NAME_LEN ||
+         precord->link_len >= FSAL_MAX_PATH_LEN ||
+         (precord->parent != CACHE_INODE_SNAPSHOT_NO_PARENT && precord->parent >= i) ||
+         offset + sizeof(*precord) + precord->name_len + precord->link_len >
+         (size_t) st.st_size)
+        break;
+
+      records[i] = precord;
+      offset += sizeof(*precord) + precord->name_len + precord->link_len;
+    }
+
+  if(i != pheader->nb_records)
+    {
+      if(records != NULL)
+        Mem_Free(records);
+      Mem_Free(buffer);
+      errno = EINVAL;
+      return -1;
+    }
+
+  *pbuffer = buffer;
+  *precords = records;
+  *pcount = pheader->nb_records;
+
+  return 0;
+}                               /* cache_inode_snapshot_read */
+
+/* The entry cached for a handle if it is still pentry, NULL otherwise */
+static cache_entry_t *cache_inode_snapshot_resolve(hash_table_t * ht,
+                                                   fsal_handle_t * phandle,
+                                                   cache_entry_t * pentry)
+{
+  cache_inode_fsal_data_t fsdata;
+  hash_buffer_t key;
+  hash_buffer_t value;
+
+  memset(&fsdata, 0, sizeof(fsdata));
+  fsdata.handle = *phandle;
+  fsdata.cookie = 0;
+
+  if(cache_inode_fsaldata_2_key(&key, &fsdata, NULL) ||
+     HashTable_Get(ht, &key, &value) != HASHTABLE_SUCCESS ||
+     (cache_entry_t *) value.pdata != pentry)
+    return NULL;
+
+  return pentry;
+}                               /* cache_inode_snapshot_resolve */
+
+/**
+ *
+ * cache_inode_snapshot_load: reloads a snapshot in the cache.
+ *
+ * Entries are added as STALE, with the attributes of the snapshot, and are
+ * linked to their parent directory when it is reloaded too and was not
+ * fully read by readdir in the meantime. Entries already cached are left
+ * as they are. Loading stops at the low water mark of the garbage collector.
+ * The entries are then validated from the coldest to the hottest, so that
+ * their order in the LRU of pclient follows the snapshot. The workers may
+ * kill a reloaded entry meanwhile, each one is looked up again by handle
+ * before it is used.
+ *
+ * @param ht         [INOUT] the cache inode hash table.
+ * @param path       [IN]    path of the snapshot file.
+ * @param pclient    [INOUT] the client the entries are allocated for.
+ * @param pcontext   [IN]    FSAL credentials.
+ * @param pnb_loaded [OUT]   number of entries reloaded.
+ * @param pstatus    [OUT]   returned status.
+ *
+ * @return CACHE_INODE_SUCCESS if successful (or if there is no snapshot), an error otherwise.
+ *
+ */
+cache_inode_status_t cache_inode_snapshot_load(hash_table_t * ht,
+                                               char *path,
+                                               cache_inode_client_t * pclient,
+                                               fsal_op_context_t * pcontext,
+                                               unsigned int *pnb_loaded,
+                                               cache_inode_status_t * pstatus)
+{
+  cache_inode_snapshot_record_t **records = NULL;
+  cache_inode_snapshot_record_t *precord;
+  cache_entry_t **entries = NULL;
+  unsigned int *by_rank = NULL;
+  char *buffer = NULL;
+  char *pname;
+  unsigned int count = 0;
+  unsigned int nb_loaded = 0;
+  unsigned int lwmark;
+  unsigned int i;
+  cache_inode_fsal_data_t fsdata;
+  cache_inode_create_arg_t create_arg;
+  cache_inode_status_t status;
+  cache_inode_dir_entry_t *new_dir_entry;
+  cache_entry_t *pentry;
+  cache_entry_t *pentry_parent;
+  fsal_name_t name;
+
+  *pstatus = CACHE_INODE_SUCCESS;
+  *pnb_loaded = 0;
+
+  if(cache_inode_snapshot_read(path, &buffer, &records, &count) != 0)
+    {
+      if(errno == ENOENT)
+        {
+          LogEvent(COMPONENT_CACHE_INODE,
+                   "No cache inode snapshot %s, starting cold", path);
+          return *pstatus;
+        }
+
+      LogCrit(COMPONENT_CACHE_INODE,
+              "Cache inode snapshot %s can't be used: error %d (%s)",
+              path, errno, strerror(errno));
+      *pstatus = CACHE_INODE_INVALID_ARGUMENT;
+      return *pstatus;
+    }
+
+  if(count == 0)
+    goto out;
+
+  if((entries = (cache_entry_t **) Mem_Alloc(count * sizeof(cache_entry_t *))) == NULL ||
+     (by_rank = (unsigned int *)Mem_Alloc(count * sizeof(unsigned int))) == NULL)
+    {
+      *pstatus = CACHE_INODE_MALLOC_ERROR;
+      goto out;
+    }
+
+  memset(entries, 0, count * sizeof(cache_entry_t *));
+  for(i = 0; i < count; i++)
+    by_rank[i] = CACHE_INODE_SNAPSHOT_NO_PARENT;
+
+  lwmark = cache_inode_get_gc_policy().lwmark_nb_entries;
+
+  /* Parents come first in the file */
+  for(i = 0; i < count; i++)
+    {
+      precord = records[i];
+
+      if(HashTable_GetSize(ht) >= lwmark)
+        {
+          LogEvent(COMPONENT_CACHE_INODE,
+                   "Cache inode snapshot reload stopped at the gc low water mark (%u entries)",
+                   lwmark);
+          break;
+        }
+
+      memset(&fsdata, 0, sizeof(fsdata));
+      fsdata.handle = precord->handle;
+      fsdata.cookie = 0;
+
+      memset(&create_arg, 0, sizeof(create_arg));
+      pname = (char *)(precord + 1);
+      if(precord->type == SYMBOLIC_LINK)
+        {
+          memcpy(create_arg.link_content.path, pname + precord->name_len,
+                 precord->link_len);
+          create_arg.link_content.path[precord->link_len] = '\0';
+          create_arg.link_content.len = precord->link_len;
+        }
+
+      pentry = cache_inode_new_entry(&fsdata,
+                                     &precord->attributes,
+                                     (cache_inode_file_type_t) precord->type,
+                                     (cache_inode_policy_t) precord->policy,
+                                     &create_arg,
+                                     NULL,
+                                     ht,
+                                     pclient,
+                                     pcontext,
+                                     CACHE_INODE_NEW_ENTRY_RELOAD,
+                                     &status);
+
+      /* Entries already cached (export roots, or used meanwhile) are left alone */
+      if(pentry == NULL || status != CACHE_INODE_SUCCESS)
+        continue;
+
+      entries[i] = pentry;
+      if(precord->rank < count)
+        by_rank[precord->rank] = i;
+      nb_loaded += 1;
+
+      if(precord->parent == CACHE_INODE_SNAPSHOT_NO_PARENT ||
+         entries[precord->parent] == NULL)
+        continue;
+
+      if((pentry_parent = cache_inode_snapshot_resolve(ht, &records[precord->parent]->handle,
+                                                       entries[precord->parent])) == NULL)
+        {
+          entries[precord->parent] = NULL;
+          continue;
+        }
+
+      /* A directory fully read by readdir only has names known by the FSAL */
+      memset(&name, 0, sizeof(name));
+      memcpy(name.name, pname, precord->name_len);
+      name.len = precord->name_len;
+
+      P_w(&pentry_parent->lock);
+      if(pentry_parent->internal_md.type == DIRECTORY &&
+         pentry_parent->object.dir.has_been_readdir != CACHE_INODE_YES)
+        cache_inode_add_cached_dirent(pentry_parent, &name, pentry, ht,
+                                      &new_dir_entry, pclient, pcontext, &status);
+      V_w(&pentry_parent->lock);
+    }
+
+  /* From the coldest to the hottest, the hottest end up at the tail of the LRU */
+  for(i = count; i > 0; i--)
+    {
+      if(by_rank[i - 1] == CACHE_INODE_SNAPSHOT_NO_PARENT)
+        continue;
+
+      precord = records[by_rank[i - 1]];
+      if((pentry = cache_inode_snapshot_resolve(ht, &precord->handle,
+                                                entries[by_rank[i - 1]])) == NULL)
+        continue;
+
+      P_w(&pentry->lock);
+      /* An entry used meanwhile is in the LRU of a worker, leave it there */
+      if(pentry->gc_lru == pclient->lru_gc)
+        cache_inode_valid(pentry, CACHE_INODE_OP_GET, pclient);
+      V_w(&pentry->lock);
+    }
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "Cache inode snapshot %s: %u entries reloaded out of %u",
+           path, nb_loaded, count);
+
+ out:
+  *pnb_loaded = nb_loaded;
+
+  if(by_rank != NULL)
+    Mem_Free(by_rank);
+  if(entries != NULL)
+    Mem_Free(entries);
+  if(records != NULL)
+    Mem_Free(records);
+  Mem_Free(buffer);
+
+  return *pstatus;
+}                               /* cache_inode_snapshot_load */
@@ -76,6 +76,9 @@ fsal_status_t FUSEFSAL_InitClientContext(fsal_op_context_t *context)
   /* initialy set the export entry to none */
   p_thr_context->export_context = NULL;
 
+  /* no group list is held yet */
+  p_thr_context->credential.grouplist = NULL;
+
   /* set credential info */
   p_thr_context->credential.user = 0;
   p_thr_context->credential.group = 0;
@@ -138,6 +141,7 @@ fsal_status_t FUSEFSAL_GetClientContext(fsal_op_context_t *context,  /* IN/OUT
   p_thr_context->credential.user = uid;
   p_thr_context->credential.group = gid;
   p_thr_context->credential.nbgroups = 0; /* no alt groups at present */
+  p_thr_context->credential.grouplist = NULL;
 
   /* build fuse context */
   p_thr_context->ganefuse_context.ganefuse = NULL;
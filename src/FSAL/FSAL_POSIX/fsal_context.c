@@ -105,6 +105,16 @@ fsal_status_t POSIXFSAL_InitClientContext(fsal_op_context_t * thr_context)
   /* initialy set the export entry to none */
   p_thr_context->export_context = NULL;
 
+  /* no group list is held yet */
+  p_thr_context->credential.grouplist = NULL;
+
+  /* the namespace is served by the local index, no database needed */
+  if(posixdb_index_enabled())
+    {
+      p_thr_context->p_conn = NULL;
+      Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_InitClientContext);
+    }
+
   st = fsal_posixdb_connect(&global_posixdb_params, &(p_thr_context->p_conn));
   if(FSAL_POSIXDB_IS_ERROR(st))
     {
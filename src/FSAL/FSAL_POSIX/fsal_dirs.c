@@ -90,11 +90,11 @@ fsal_status_t POSIXFSAL_opendir(fsal_handle_t * dir_handle,      /* IN */
   p_dir_descriptor->p_dbentries = NULL;
   p_dir_descriptor->dbentries_count = 0;
   /* fill the p_dbentries list */
-  statusdb = fsal_posixdb_getChildren(p_dir_descriptor->context.p_conn,
-                                      &(p_dir_descriptor->handle),
-                                      FSAL_POSIXDB_MAXREADDIRBLOCKSIZE,
-                                      &(p_dir_descriptor->p_dbentries),
-                                      &(p_dir_descriptor->dbentries_count));
+  statusdb = posixdb_index_getChildren(p_dir_descriptor->context.p_conn,
+                                       &(p_dir_descriptor->handle),
+                                       FSAL_POSIXDB_MAXREADDIRBLOCKSIZE,
+                                       &(p_dir_descriptor->p_dbentries),
+                                       &(p_dir_descriptor->dbentries_count));
   if(FSAL_POSIXDB_IS_ERROR(statusdb))   /* too many entries in the directory, or another error */
     p_dir_descriptor->dbentries_count = -1;
 
@@ -275,9 +275,9 @@ fsal_status_t POSIXFSAL_readdir(fsal_dir_t * dir_descriptor,     /* IN */
         }
       else if(!strcmp(dp->d_name, ".."))
         {
-          stdb = fsal_posixdb_getParentDirHandle(p_dir_descriptor->context.p_conn,
-                                                 &(p_dir_descriptor->handle),
-                                                 (posixfsal_handle_t *) &(p_pdirent[*p_nb_entries].handle));
+          stdb = posixdb_index_getParentDirHandle(p_dir_descriptor->context.p_conn,
+                                                  &(p_dir_descriptor->handle),
+                                                  (posixfsal_handle_t *) &(p_pdirent[*p_nb_entries].handle));
           if(FSAL_POSIXDB_IS_ERROR(stdb) && FSAL_IS_ERROR(st = posixdb2fsal_error(stdb)))
             goto readdir_error;
         }
@@ -78,6 +78,10 @@ fsal_status_t POSIXFSAL_Init(fsal_parameter_t * init_info       /* IN */
   my_init();
 #endif
 
+  /* Load the local index of the namespace, if any */
+  if(posixdb_index_init(posix_init) != 0)
+    Return(ERR_FSAL_BAD_INIT, 0, INDEX_FSAL_Init);
+
   Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_Init);
 
 }
@@ -486,11 +486,11 @@ fsal_status_t fsal_internal_posixdb_add_entry(fsal_posixdb_conn * p_conn,
     ReturnCode(ERR_FSAL_FAULT, 0);
 
  add:
-  stdb = fsal_posixdb_add(p_conn, p_info, p_dir_handle, p_filename, p_new_handle);
+  stdb = posixdb_index_add(p_conn, p_info, p_dir_handle, p_filename, p_new_handle);
 
   if(stdb.major == ERR_FSAL_POSIXDB_CONSISTENCY)
     {                           /* there is already an entry with this path, but it's an inconsistent one */
-      stdb = fsal_posixdb_deleteHandle(p_conn, p_new_handle);
+      stdb = posixdb_index_deleteHandle(p_conn, p_new_handle);
       if(FSAL_POSIXDB_IS_ERROR(stdb))
         return posixdb2fsal_error(stdb);
       goto add;
@@ -563,11 +563,11 @@ fsal_status_t fsal_internal_getPathFromHandle(posixfsal_op_context_t * p_context
   /* if there is a path in the posixfsal_handle_t variable, then try to use it instead of querying the database for it */
   /* Read the path from the Handle. If it's valid & coherent, then no need to query the database ! */
   /* if !p_buffstat, we don't need to check the path */
-  statusdb = fsal_posixdb_getInfoFromHandle(p_context->p_conn,
-                                            p_handle,
-                                            paths,
-                                            (is_dir ? 1 : global_fs_info.maxlink),
-                                            &count);
+  statusdb = posixdb_index_getInfoFromHandle(p_context->p_conn,
+                                             p_handle,
+                                             paths,
+                                             (is_dir ? 1 : global_fs_info.maxlink),
+                                             &count);
   if(FSAL_POSIXDB_IS_ERROR(statusdb)
      && FSAL_IS_ERROR(status = posixdb2fsal_error(statusdb)))
     return status;
@@ -610,7 +610,7 @@ fsal_status_t fsal_internal_getPathFromHandle(posixfsal_op_context_t * p_context
               if(!FSAL_IS_ERROR(status))
                 {
                   statusdb =
-                      fsal_posixdb_delete(p_context->p_conn, &parenthdl, &filename, NULL);
+                      posixdb_index_delete(p_context->p_conn, &parenthdl, &filename, NULL);
                   /* no need to check if there was an error, because it doesn't change the behavior of the function */
                 }
 
@@ -633,7 +633,7 @@ fsal_status_t fsal_internal_getPathFromHandle(posixfsal_op_context_t * p_context
         {
           /* not consistent !! */
           /* delete the stale handle */
-          statusdb = fsal_posixdb_deleteHandle(p_context->p_conn, p_handle);
+          statusdb = posixdb_index_deleteHandle(p_context->p_conn, p_handle);
           if(FSAL_POSIXDB_IS_ERROR(statusdb)
              && FSAL_IS_ERROR(status = posixdb2fsal_error(statusdb)))
             return status;
@@ -677,9 +677,9 @@ fsal_status_t fsal_internal_getInfoFromName(posixfsal_op_context_t * p_context,
   fsal_posixdb_status_t stdb;
   fsal_status_t st;
 
-  stdb = fsal_posixdb_getInfoFromName(p_context->p_conn,
-                                      p_parent_dir_handle,
-                                      p_fsalname, NULL, p_object_handle);
+  stdb = posixdb_index_getInfoFromName(p_context->p_conn,
+                                       p_parent_dir_handle,
+                                       p_fsalname, NULL, p_object_handle);
   switch (stdb.major)
     {
     case ERR_FSAL_POSIXDB_NOERR:
@@ -689,7 +689,7 @@ fsal_status_t fsal_internal_getInfoFromName(posixfsal_op_context_t * p_context,
         {
           /* Entry not consistent */
           /* Delete the Handle entry, then add a new one (with a Parent entry) */
-          stdb = fsal_posixdb_deleteHandle(p_context->p_conn, p_object_handle);
+          stdb = posixdb_index_deleteHandle(p_context->p_conn, p_object_handle);
           if(FSAL_POSIXDB_IS_ERROR(stdb) && FSAL_IS_ERROR(st = posixdb2fsal_error(stdb)))
             return st;
           /* don't break, add a new entry */
@@ -772,7 +772,7 @@ fsal_status_t fsal_internal_getInfoFromChildrenList(posixfsal_op_context_t * p_c
           /* Entry not consistent */
           /* Delete the Handle entry, then add a new one (with a Parent entry) */
           stdb =
-              fsal_posixdb_deleteHandle(p_context->p_conn, &(p_children[count].handle));
+              posixdb_index_deleteHandle(p_context->p_conn, &(p_children[count].handle));
 
           if(FSAL_POSIXDB_IS_ERROR(stdb) && FSAL_IS_ERROR(st = posixdb2fsal_error(stdb)))
             return st;
@@ -11,6 +11,7 @@
 
 #include  "fsal.h"
 #include <sys/stat.h>
+#include "posixdb_index.h"
 
 /* defined the set of attributes supported with POSIX */
 #define POSIX_SUPPORTED_ATTRIBUTES (                                       \
@@ -163,9 +163,9 @@ fsal_status_t POSIXFSAL_lookup(fsal_handle_t * parent_directory_handle,  /* IN *
       else if(!FSAL_namecmp(p_filename, (fsal_name_t *) & FSAL_DOT_DOT))
         {
           /* lookup ".." */
-          statusdb = fsal_posixdb_getParentDirHandle(p_context->p_conn,
-                                                     p_parent_directory_handle,
-                                                     p_object_handle);
+          statusdb = posixdb_index_getParentDirHandle(p_context->p_conn,
+                                                      p_parent_directory_handle,
+                                                      p_object_handle);
 
         }
       else
@@ -175,10 +175,10 @@ fsal_status_t POSIXFSAL_rename(fsal_handle_t * old_parentdir_handle,     /* IN *
   /***********************************
    * Rename the file in the database *
    ***********************************/
-  statusdb = fsal_posixdb_replace(p_context->p_conn,
-                                  &info,
-                                  p_old_parentdir_handle,
-                                  p_old_name, p_new_parentdir_handle, p_new_name);
+  statusdb = posixdb_index_replace(p_context->p_conn,
+                                   &info,
+                                   p_old_parentdir_handle,
+                                   p_old_name, p_new_parentdir_handle, p_new_name);
 
   switch (statusdb.major)
     {
@@ -388,6 +388,11 @@ fsal_status_t POSIXFSAL_SetDefault_FS_specific_parameter(fsal_parameter_t * out_
 
 #endif
 
+  /* no local index */
+  p_init_info->index_dir[0] = '\0';
+  p_init_info->index_sync = TRUE;
+  p_init_info->index_commit_delay = 0;
+
   ReturnCode(ERR_FSAL_NO_ERROR, 0);
 
 }
@@ -817,6 +822,38 @@ fsal_status_t POSIXFSAL_load_FS_specific_parameter_from_conf(config_file_t in_co
           strncpy(p_init_info->dbparams.passwdfile,
                   key_value, FSAL_MAX_PATH_LEN);
         }
+      else if(!STRCMP(key_name, "Index_Dir"))
+        {
+          strncpy(p_init_info->index_dir, key_value, FSAL_MAX_PATH_LEN);
+        }
+      else if(!STRCMP(key_name, "Index_Sync"))
+        {
+          int bool = StrToBoolean(key_value);
+
+          if(bool == -1)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                   "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: 0 or 1 expected.",
+                   key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+
+          p_init_info->index_sync = bool;
+        }
+      else if(!STRCMP(key_name, "Index_Commit_Delay"))
+        {
+          int delay = atoi(key_value);
+
+          if(delay < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                   "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: positive integer expected.",
+                   key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+
+          p_init_info->index_commit_delay = delay;
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -826,11 +863,13 @@ fsal_status_t POSIXFSAL_load_FS_specific_parameter_from_conf(config_file_t in_co
         }
     }
 
-  if(p_init_info->dbparams.host[0] == '\0'
-     || p_init_info->dbparams.dbname[0] == '\0')
+  /* with a local index, the database is only used to fill it the first time */
+  if(p_init_info->index_dir[0] == '\0'
+     && (p_init_info->dbparams.host[0] == '\0'
+         || p_init_info->dbparams.dbname[0] == '\0'))
     {
       LogCrit(COMPONENT_CONFIG,
-           "FSAL LOAD PARAMETER: DB_Host and DB_Name MUST be specified in the configuration file");
+           "FSAL LOAD PARAMETER: DB_Host and DB_Name (or Index_Dir) MUST be specified in the configuration file");
       ReturnCode(ERR_FSAL_NOENT, 0);
     }
 
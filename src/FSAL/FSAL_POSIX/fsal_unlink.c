@@ -57,6 +57,8 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
   struct stat buffstat, buffstat_parent;
   fsal_path_t fsalpath;
   fsal_posixdb_fileinfo_t info;
+  dev_t devid;
+  ino_t inode;
 
   /* sanity checks. */
   if(!p_parent_directory_handle || !p_context || !p_object_name)
@@ -94,13 +96,40 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
    * Lock the handle entry related to this file in the database *
    **************************************************************/
 
-  statusdb = fsal_posixdb_lockHandleForUpdate(p_context->p_conn, &info);
+  statusdb = posixdb_index_lockHandleForUpdate(p_context->p_conn, &info);
   if(FSAL_IS_ERROR(status = posixdb2fsal_error(statusdb)))
     {
-      fsal_posixdb_cancelHandleLock(p_context->p_conn);
+      posixdb_index_cancelHandleLock(p_context->p_conn);
       Return(status.major, status.minor, INDEX_FSAL_unlink);
     }
 
+  /* another unlink may have changed the link count before the lock was taken */
+  devid = info.devid;
+  inode = info.inode;
+
+  TakeTokenFSCall();
+  rc = lstat(fsalpath.path, &buffstat);
+  errsv = errno;
+  ReleaseTokenFSCall();
+  if(rc)
+    {
+      posixdb_index_cancelHandleLock(p_context->p_conn);
+      Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_unlink);
+    }
+
+  if(FSAL_IS_ERROR(status = fsal_internal_posix2posixdb_fileinfo(&buffstat, &info)))
+    {
+      posixdb_index_cancelHandleLock(p_context->p_conn);
+      Return(status.major, status.minor, INDEX_FSAL_unlink);
+    }
+
+  /* the name was given to another object, the lock does not cover it */
+  if(info.devid != devid || info.inode != inode)
+    {
+      posixdb_index_cancelHandleLock(p_context->p_conn);
+      Return(ERR_FSAL_DELAY, 0, INDEX_FSAL_unlink);
+    }
+
   /****************
    * CHECK ACCESS *
    ****************/
@@ -108,7 +137,7 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
      && buffstat_parent.st_uid != p_context->credential.user
      && buffstat.st_uid != p_context->credential.user && p_context->credential.user != 0)
     {
-      fsal_posixdb_cancelHandleLock(p_context->p_conn);
+      posixdb_index_cancelHandleLock(p_context->p_conn);
       Return(ERR_FSAL_ACCESS, 0, INDEX_FSAL_unlink);
     }
 
@@ -116,7 +145,7 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
      (status =
       fsal_internal_testAccess(p_context, FSAL_W_OK | FSAL_X_OK, &buffstat_parent, NULL)))
     {
-      fsal_posixdb_cancelHandleLock(p_context->p_conn);
+      posixdb_index_cancelHandleLock(p_context->p_conn);
       Return(status.major, status.minor, INDEX_FSAL_unlink);
     }
 
@@ -130,7 +159,7 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
   ReleaseTokenFSCall();
   if(rc)
     {
-      fsal_posixdb_cancelHandleLock(p_context->p_conn);
+      posixdb_index_cancelHandleLock(p_context->p_conn);
       Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_unlink);
     }
 
@@ -140,8 +169,8 @@ fsal_status_t POSIXFSAL_unlink(fsal_handle_t * parent_directory_handle,  /* IN *
 
   /* We have to delete the path from the database, and the handle if the object was a directory or has no more hardlink */
   statusdb =
-      fsal_posixdb_delete(p_context->p_conn, p_parent_directory_handle, p_object_name,
-                          &info);
+      posixdb_index_delete(p_context->p_conn, p_parent_directory_handle, p_object_name,
+                           &info);
   /* After this operation, there's no need to 'fsal_posixdb_cancelHandleLock' because the transaction is ended */
   switch (statusdb.major)
     {
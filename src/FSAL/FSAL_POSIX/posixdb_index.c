@@ -0,0 +1,1661 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ */
+
+/**
+ *
+ * \file    posixdb_index.c
+ * \brief   Local index of the handles and names of the POSIX FSAL.
+ *
+ * The index holds the content of the Handle and Parent tables: one entry
+ * per object (id, timestamp and POSIX information) and one link per name
+ * of an object in a directory. The root directory is the object that has
+ * a link to itself with an empty name, as in the database.
+ *
+ * Lookups are served from memory under a read lock. Every change is
+ * appended to a batch of fixed size records; the flusher thread writes the
+ * whole batch to POSIXDB_INDEX_FILE and syncs it once for all the threads
+ * that filled it, which then wait for that sync when Index_Sync is set.
+ * If a batch cannot be written, the log is cut back to its last complete
+ * batch and no more records are written: the changes waiting for a sync
+ * fail, and every later change is refused, with or without Index_Sync,
+ * until the server is restarted.
+ * lockHandleForUpdate takes a mutex chosen by the device and inode of the
+ * object; the thread holds it until cancelHandleLock or the next change,
+ * as the database holds the row until the end of its transaction.
+ * At startup the log is replayed, and rewritten with only the live
+ * records when it has grown too much. The first time the index is used,
+ * it is filled from the database if one is configured, so the handles
+ * already given to the clients stay valid.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fsal.h"
+#include "fsal_internal.h"
+#include "posixdb_index.h"
+#include "posixdb_consistency.h"
+#include "stuff_alloc.h"
+#include "RW_Lock.h"
+#include "nlm_list.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define ReturnCodeIndex( _code_, _minor_ ) do {              \
+               fsal_posixdb_status_t _struct_status_;        \
+               (_struct_status_).major = (_code_) ;          \
+               (_struct_status_).minor = (_minor_) ;         \
+               return (_struct_status_);                     \
+              } while(0)
+
+typedef enum posixdb_index_op__
+{
+  POSIXDB_INDEX_OP_HEADER = 0,
+  POSIXDB_INDEX_OP_HANDLE,      /* create or update an object */
+  POSIXDB_INDEX_OP_DELHANDLE,   /* delete an object and its links */
+  POSIXDB_INDEX_OP_LINK,        /* name an object in a directory */
+  POSIXDB_INDEX_OP_UNLINK       /* remove a name from a directory */
+} posixdb_index_op_t;
+
+/* On disk record. For the header, id is the version and nlink the record size */
+typedef struct posixdb_index_rec__
+{
+  uint32_t magic;
+  uint32_t op;
+  uint64_t id;
+  int32_t ts;
+  int32_t parent_ts;
+  uint64_t parent_id;
+  uint64_t devid;
+  uint64_t inode;
+  int64_t ctime;
+  int32_t nlink;
+  int32_t ftype;
+  uint32_t namelen;
+  char name[FSAL_MAX_NAME_LEN];
+  uint32_t checksum;
+} posixdb_index_rec_t;
+
+typedef struct posixdb_index_entry__
+{
+  struct glist_head id_list;    /* bucket in the id hash table */
+  struct glist_head inode_list; /* bucket in the devid/inode hash table */
+  struct glist_head paths;      /* links that name this object */
+  struct glist_head children;   /* links in this directory */
+  fsal_u64_t id;
+  int ts;
+  fsal_posixdb_fileinfo_t info;
+} posixdb_index_entry_t;
+
+typedef struct posixdb_index_link__
+{
+  struct glist_head name_list;  /* bucket in the name hash table */
+  struct glist_head path_list;  /* in the paths of the object */
+  struct glist_head child_list; /* in the children of the directory */
+  posixdb_index_entry_t *parent;
+  posixdb_index_entry_t *object;
+  fsal_name_t name;
+} posixdb_index_link_t;
+
+static int index_enabled = FALSE;
+static int index_loading = FALSE;
+static rw_lock_t index_lock;
+
+static struct glist_head *id_hash;
+static struct glist_head *inode_hash;
+static struct glist_head *name_hash;
+
+static posixdb_index_entry_t *index_root = NULL;
+static fsal_u64_t index_next_id = 1;
+static unsigned int index_nb_entries = 0;
+static unsigned int index_nb_links = 0;
+
+static char index_path[FSAL_MAX_PATH_LEN + sizeof(POSIXDB_INDEX_FILE) + 1];
+static int index_fd = -1;
+static int index_dir_fd = -1;
+static int index_sync = TRUE;
+static unsigned int index_commit_delay = 0;
+
+/* Group commit: the threads fill the current batch, the flusher writes the other one */
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+static posixdb_index_rec_t *batch[2];
+static unsigned int batch_cur = 0;
+static unsigned int batch_len = 0;
+static unsigned long long queued_seq = 0;
+static unsigned long long committed_seq = 0;
+static unsigned long long good_seq = 0;         /* last record on disk */
+static int index_failed = FALSE;              /* set under batch_mutex */
+static off_t index_good_offset = 0;            /* end of the last batch on disk */
+
+static fsal_name_t root_name = { "", 0 };
+
+/* lockHandleForUpdate */
+static pthread_mutex_t handle_locks[POSIXDB_INDEX_LOCK_SIZE];
+static pthread_once_t handle_locks_once = PTHREAD_ONCE_INIT;
+static __thread int handle_lock_held = -1;
+
+/* FNV-1a */
+static uint32_t index_fnv(uint32_t h, const void *p_data, size_t len)
+{
+  const unsigned char *p = (const unsigned char *)p_data;
+  size_t i;
+
+  for(i = 0; i < len; i++)
+    {
+      h ^= p[i];
+      h *= 16777619;
+    }
+
+  return h;
+}
+
+static unsigned int hash_id(fsal_u64_t id)
+{
+  return (unsigned int)(id % POSIXDB_INDEX_HASH_SIZE);
+}
+
+static unsigned int hash_inode(dev_t devid, ino_t inode)
+{
+  return (unsigned int)((1999 * (unsigned long long)inode + devid) % POSIXDB_INDEX_HASH_SIZE);
+}
+
+static unsigned int hash_name(posixdb_index_entry_t * p_parent, fsal_name_t * p_name)
+{
+  uint32_t h = 2166136261U;
+
+  h = index_fnv(h, &p_parent->id, sizeof(p_parent->id));
+  h = index_fnv(h, p_name->name, p_name->len);
+
+  return h % POSIXDB_INDEX_HASH_SIZE;
+}
+
+static void index_handle_locks_init(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < POSIXDB_INDEX_LOCK_SIZE; i++)
+    pthread_mutex_init(&handle_locks[i], NULL);
+}
+
+/* Ends the update the thread started with lockHandleForUpdate, if any */
+static void index_handle_unlock(void)
+{
+  if(handle_lock_held < 0)
+    return;
+
+  V(handle_locks[handle_lock_held]);
+  handle_lock_held = -1;
+}
+
+/* ---------------------------------------------------------------------------
+ * In memory index
+ * ------------------------------------------------------------------------- */
+
+static posixdb_index_entry_t *index_find_id(fsal_u64_t id, int ts)
+{
+  struct glist_head *node;
+  posixdb_index_entry_t *p_entry;
+
+  glist_for_each(node, &id_hash[hash_id(id)])
+  {
+    p_entry = glist_entry(node, posixdb_index_entry_t, id_list);
+    if(p_entry->id == id && p_entry->ts == ts)
+      return p_entry;
+  }
+
+  return NULL;
+}
+
+static posixdb_index_entry_t *index_find(posixfsal_handle_t * p_handle)
+{
+  return index_find_id(p_handle->data.id, p_handle->data.ts);
+}
+
+static posixdb_index_entry_t *index_find_inode(dev_t devid, ino_t inode)
+{
+  struct glist_head *node;
+  posixdb_index_entry_t *p_entry;
+
+  glist_for_each(node, &inode_hash[hash_inode(devid, inode)])
+  {
+    p_entry = glist_entry(node, posixdb_index_entry_t, inode_list);
+    if(p_entry->info.devid == devid && p_entry->info.inode == inode)
+      return p_entry;
+  }
+
+  return NULL;
+}
+
+static posixdb_index_link_t *index_lookup(posixdb_index_entry_t * p_parent,
+                                          fsal_name_t * p_name)
+{
+  struct glist_head *node;
+  posixdb_index_link_t *p_link;
+
+  glist_for_each(node, &name_hash[hash_name(p_parent, p_name)])
+  {
+    p_link = glist_entry(node, posixdb_index_link_t, name_list);
+    if(p_link->parent == p_parent && p_link->name.len == p_name->len
+       && !memcmp(p_link->name.name, p_name->name, p_name->len))
+      return p_link;
+  }
+
+  return NULL;
+}
+
+static void index_fill_handle(posixdb_index_entry_t * p_entry, posixfsal_handle_t * p_handle)
+{
+  memset(p_handle, 0, sizeof(posixfsal_handle_t));
+  p_handle->data.id = p_entry->id;
+  p_handle->data.ts = p_entry->ts;
+  p_handle->data.info = p_entry->info;
+}
+
+/* Queues a record for the flusher. Called with index_lock held for writing,
+ * so that the log has the order of the changes. */
+static void index_log_queue(posixdb_index_rec_t * p_rec)
+{
+  if(index_loading)
+    return;
+
+  p_rec->magic = POSIXDB_INDEX_MAGIC;
+  p_rec->checksum = index_fnv(2166136261U, p_rec, offsetof(posixdb_index_rec_t, checksum));
+
+  P(batch_mutex);
+
+  while(batch_len == POSIXDB_INDEX_BATCH_MAX)
+    pthread_cond_wait(&commit_cond, &batch_mutex);
+
+  batch[batch_cur][batch_len++] = *p_rec;
+  queued_seq++;
+
+  pthread_cond_signal(&batch_cond);
+
+  V(batch_mutex);
+}
+
+static unsigned long long index_log_last(void)
+{
+  unsigned long long seq;
+
+  P(batch_mutex);
+  seq = queued_seq;
+  V(batch_mutex);
+
+  return seq;
+}
+
+/* Returns TRUE once a batch could not be written */
+static int index_log_failed(void)
+{
+  int failed;
+
+  P(batch_mutex);
+  failed = index_failed;
+  V(batch_mutex);
+
+  return failed;
+}
+
+/* Waits for the records queued so far to be on disk.
+ * Returns 0 if they are, -1 if they could not be written.
+ * Without Index_Sync, only fails once the log has failed. */
+static int index_log_wait(unsigned long long seq)
+{
+  int rc;
+
+  P(batch_mutex);
+
+  if(index_sync)
+    {
+      while(committed_seq < seq)
+        pthread_cond_wait(&commit_cond, &batch_mutex);
+
+      rc = (good_seq < seq) ? -1 : 0;
+    }
+  else
+    rc = index_failed ? -1 : 0;
+
+  V(batch_mutex);
+
+  return rc;
+}
+
+static void index_rec_entry(posixdb_index_rec_t * p_rec, posixdb_index_op_t op,
+                            posixdb_index_entry_t * p_entry)
+{
+  memset(p_rec, 0, sizeof(posixdb_index_rec_t));
+  p_rec->op = op;
+  p_rec->id = p_entry->id;
+  p_rec->ts = p_entry->ts;
+  p_rec->devid = p_entry->info.devid;
+  p_rec->inode = p_entry->info.inode;
+  p_rec->ctime = p_entry->info.ctime;
+  p_rec->nlink = p_entry->info.nlink;
+  p_rec->ftype = p_entry->info.ftype;
+}
+
+static void index_rec_link(posixdb_index_rec_t * p_rec, posixdb_index_op_t op,
+                           posixdb_index_link_t * p_link)
+{
+  memset(p_rec, 0, sizeof(posixdb_index_rec_t));
+  p_rec->op = op;
+  p_rec->id = p_link->object->id;
+  p_rec->ts = p_link->object->ts;
+  p_rec->parent_id = p_link->parent->id;
+  p_rec->parent_ts = p_link->parent->ts;
+  p_rec->namelen = p_link->name.len;
+  memcpy(p_rec->name, p_link->name.name, p_link->name.len);
+}
+
+/* Creates an object, or updates its information */
+static posixdb_index_entry_t *index_set_entry(fsal_u64_t id, int ts,
+                                              fsal_posixdb_fileinfo_t * p_info)
+{
+  posixdb_index_entry_t *p_entry;
+  posixdb_index_rec_t rec;
+
+  if((p_entry = index_find_id(id, ts)) == NULL)
+    {
+      if((p_entry = (posixdb_index_entry_t *) Mem_Alloc(sizeof(posixdb_index_entry_t))) == NULL)
+        return NULL;
+
+      p_entry->id = id;
+      p_entry->ts = ts;
+      p_entry->info = *p_info;
+      init_glist(&p_entry->paths);
+      init_glist(&p_entry->children);
+      glist_add_tail(&id_hash[hash_id(id)], &p_entry->id_list);
+      glist_add_tail(&inode_hash[hash_inode(p_info->devid, p_info->inode)],
+                     &p_entry->inode_list);
+      index_nb_entries++;
+
+      if(id >= index_next_id)
+        index_next_id = id + 1;
+    }
+  else
+    {
+      if(p_entry->info.devid != p_info->devid || p_entry->info.inode != p_info->inode)
+        {
+          glist_del(&p_entry->inode_list);
+          glist_add_tail(&inode_hash[hash_inode(p_info->devid, p_info->inode)],
+                         &p_entry->inode_list);
+        }
+      p_entry->info = *p_info;
+    }
+
+  index_rec_entry(&rec, POSIXDB_INDEX_OP_HANDLE, p_entry);
+  index_log_queue(&rec);
+
+  return p_entry;
+}
+
+static void index_free_link(posixdb_index_link_t * p_link)
+{
+  glist_del(&p_link->name_list);
+  glist_del(&p_link->path_list);
+  glist_del(&p_link->child_list);
+  index_nb_links--;
+  Mem_Free(p_link);
+}
+
+static void index_del_link(posixdb_index_link_t * p_link)
+{
+  posixdb_index_rec_t rec;
+
+  index_rec_link(&rec, POSIXDB_INDEX_OP_UNLINK, p_link);
+  index_log_queue(&rec);
+
+  if(p_link->object == index_root && p_link->parent == index_root)
+    index_root = NULL;
+
+  index_free_link(p_link);
+}
+
+/* Names an object in a directory, replacing the link that had this name */
+static posixdb_index_link_t *index_set_link(posixdb_index_entry_t * p_parent,
+                                            posixdb_index_entry_t * p_object,
+                                            fsal_name_t * p_name)
+{
+  posixdb_index_link_t *p_link;
+  posixdb_index_rec_t rec;
+
+  if((p_link = index_lookup(p_parent, p_name)) != NULL)
+    index_free_link(p_link);
+
+  if((p_link = (posixdb_index_link_t *) Mem_Alloc(sizeof(posixdb_index_link_t))) == NULL)
+    return NULL;
+
+  p_link->parent = p_parent;
+  p_link->object = p_object;
+  FSAL_namecpy(&p_link->name, p_name);
+  glist_add_tail(&name_hash[hash_name(p_parent, p_name)], &p_link->name_list);
+  glist_add_tail(&p_object->paths, &p_link->path_list);
+  glist_add_tail(&p_parent->children, &p_link->child_list);
+  index_nb_links++;
+
+  if(p_parent == p_object)
+    index_root = p_object;
+
+  index_rec_link(&rec, POSIXDB_INDEX_OP_LINK, p_link);
+  index_log_queue(&rec);
+
+  return p_link;
+}
+
+/* Deletes an object and all the links to and from it */
+static void index_del_entry(posixdb_index_entry_t * p_entry)
+{
+  struct glist_head *node;
+  struct glist_head *noden;
+  posixdb_index_rec_t rec;
+
+  index_rec_entry(&rec, POSIXDB_INDEX_OP_DELHANDLE, p_entry);
+  index_log_queue(&rec);
+
+  glist_for_each_safe(node, noden, &p_entry->paths)
+      index_free_link(glist_entry(node, posixdb_index_link_t, path_list));
+
+  glist_for_each_safe(node, noden, &p_entry->children)
+      index_free_link(glist_entry(node, posixdb_index_link_t, child_list));
+
+  if(p_entry == index_root)
+    index_root = NULL;
+
+  glist_del(&p_entry->id_list);
+  glist_del(&p_entry->inode_list);
+  index_nb_entries--;
+  Mem_Free(p_entry);
+}
+
+/* Removes a name of an object, and the object with its last name
+ * (fsal_posixdb_deleteParent) */
+static void index_delete_path(posixdb_index_link_t * p_link)
+{
+  posixdb_index_entry_t *p_object = p_link->object;
+  fsal_posixdb_fileinfo_t info;
+
+  if(p_object->info.nlink <= 1)
+    {
+      index_del_entry(p_object);
+    }
+  else
+    {
+      index_del_link(p_link);
+      info = p_object->info;
+      info.nlink--;
+      index_set_entry(p_object->id, p_object->ts, &info);
+    }
+}
+
+/* Deletes an object and everything below it (fsal_posixdb_recursiveDelete) */
+static void index_delete_tree(posixdb_index_entry_t * p_entry)
+{
+  struct glist_head *node;
+  posixdb_index_link_t *p_link;
+
+  while(1)
+    {
+      p_link = NULL;
+      glist_for_each(node, &p_entry->children)
+      {
+        p_link = glist_entry(node, posixdb_index_link_t, child_list);
+        if(p_link->object != p_entry)
+          break;
+        p_link = NULL;
+      }
+
+      if(p_link == NULL)
+        break;
+
+      if(p_link->object->info.ftype == FSAL_TYPE_DIR)
+        index_delete_tree(p_link->object);
+      else
+        index_delete_path(p_link);
+    }
+
+  index_del_entry(p_entry);
+}
+
+/* Path of an object through its first name, "" for the root (fsal_posixdb_buildOnePath) */
+static fsal_posixdb_status_t index_build_path(posixdb_index_entry_t * p_entry,
+                                              fsal_path_t * p_path)
+{
+  char buff[FSAL_MAX_PATH_LEN];
+  char *pos = buff + FSAL_MAX_PATH_LEN;
+  unsigned int len = 0;
+  posixdb_index_link_t *p_link;
+
+  while(1)
+    {
+      p_link = glist_first_entry(&p_entry->paths, posixdb_index_link_t, path_list);
+      if(p_link == NULL)
+        ReturnCodeIndex(ERR_FSAL_POSIXDB_NOPATH, 0);
+
+      /* root reached */
+      if(p_link->parent == p_entry)
+        break;
+
+      if(len + 1 + p_link->name.len >= FSAL_MAX_PATH_LEN)
+        ReturnCodeIndex(ERR_FSAL_POSIXDB_PATHTOOLONG, 0);
+
+      pos -= p_link->name.len;
+      memcpy(pos, p_link->name.name, p_link->name.len);
+      *(--pos) = '/';
+      len += 1 + p_link->name.len;
+
+      p_entry = p_link->parent;
+    }
+
+  memcpy(p_path->path, pos, len);
+  p_path->path[len] = '\0';
+  p_path->len = len;
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+static fsal_posixdb_status_t index_append_name(fsal_path_t * p_path, fsal_name_t * p_name)
+{
+  if(p_path->len + 1 + p_name->len >= FSAL_MAX_PATH_LEN)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_PATHTOOLONG, 0);
+
+  p_path->path[p_path->len] = '/';
+  memcpy(&p_path->path[p_path->len + 1], p_name->name, p_name->len);
+  p_path->len += 1 + p_name->len;
+  p_path->path[p_path->len] = '\0';
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/* ---------------------------------------------------------------------------
+ * Log
+ * ------------------------------------------------------------------------- */
+
+static int index_write_recs(int fd, posixdb_index_rec_t * p_recs, unsigned int nb)
+{
+  char *p = (char *)p_recs;
+  size_t left = nb * sizeof(posixdb_index_rec_t);
+  ssize_t rc;
+
+  while(left > 0)
+    {
+      rc = write(fd, p, left);
+      if(rc < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          return -errno;
+        }
+      p += rc;
+      left -= rc;
+    }
+
+  return 0;
+}
+
+static void index_rec_header(posixdb_index_rec_t * p_rec)
+{
+  memset(p_rec, 0, sizeof(posixdb_index_rec_t));
+  p_rec->magic = POSIXDB_INDEX_MAGIC;
+  p_rec->op = POSIXDB_INDEX_OP_HEADER;
+  p_rec->id = POSIXDB_INDEX_VERSION;
+  p_rec->nlink = sizeof(posixdb_index_rec_t);
+  p_rec->checksum = index_fnv(2166136261U, p_rec, offsetof(posixdb_index_rec_t, checksum));
+}
+
+static void index_replay(posixdb_index_rec_t * p_rec)
+{
+  posixdb_index_entry_t *p_entry;
+  posixdb_index_entry_t *p_parent;
+  posixdb_index_link_t *p_link;
+  fsal_posixdb_fileinfo_t info;
+  fsal_name_t name;
+
+  switch (p_rec->op)
+    {
+    case POSIXDB_INDEX_OP_HANDLE:
+      memset(&info, 0, sizeof(info));
+      info.devid = p_rec->devid;
+      info.inode = p_rec->inode;
+      info.ctime = p_rec->ctime;
+      info.nlink = p_rec->nlink;
+      info.ftype = p_rec->ftype;
+      index_set_entry(p_rec->id, p_rec->ts, &info);
+      break;
+
+    case POSIXDB_INDEX_OP_DELHANDLE:
+      if((p_entry = index_find_id(p_rec->id, p_rec->ts)) != NULL)
+        index_del_entry(p_entry);
+      break;
+
+    case POSIXDB_INDEX_OP_LINK:
+    case POSIXDB_INDEX_OP_UNLINK:
+      if(p_rec->namelen > FSAL_MAX_NAME_LEN)
+        break;
+      memset(&name, 0, sizeof(name));
+      memcpy(name.name, p_rec->name, p_rec->namelen);
+      name.len = p_rec->namelen;
+
+      if((p_parent = index_find_id(p_rec->parent_id, p_rec->parent_ts)) == NULL)
+        break;
+
+      if(p_rec->op == POSIXDB_INDEX_OP_UNLINK)
+        {
+          if((p_link = index_lookup(p_parent, &name)) != NULL)
+            index_del_link(p_link);
+        }
+      else if((p_entry = index_find_id(p_rec->id, p_rec->ts)) != NULL)
+        {
+          index_set_link(p_parent, p_entry, &name);
+        }
+      break;
+    }
+}
+
+/* Replays the log, and cuts it after the last valid record.
+ * Returns the number of records, or -1 on error. */
+static int index_log_load(void)
+{
+  FILE *stream;
+  posixdb_index_rec_t rec;
+  int nb = 0;
+  off_t valid = 0;
+
+  if((stream = fopen(index_path, "r")) == NULL)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not open %s: %s",
+              index_path, strerror(errno));
+      return -1;
+    }
+
+  while(fread(&rec, sizeof(rec), 1, stream) == 1)
+    {
+      if(rec.magic != POSIXDB_INDEX_MAGIC
+         || rec.checksum != index_fnv(2166136261U, &rec,
+                                      offsetof(posixdb_index_rec_t, checksum)))
+        break;
+
+      if(nb == 0)
+        {
+          if(rec.op != POSIXDB_INDEX_OP_HEADER || rec.id != POSIXDB_INDEX_VERSION
+             || rec.nlink != sizeof(posixdb_index_rec_t))
+            {
+              LogCrit(COMPONENT_FSAL,
+                      "POSIXDB index: %s has version %llu and record size %d, expected %u and %u",
+                      index_path, (unsigned long long)rec.id, rec.nlink,
+                      POSIXDB_INDEX_VERSION, (unsigned int)sizeof(posixdb_index_rec_t));
+              fclose(stream);
+              return -1;
+            }
+        }
+      else
+        index_replay(&rec);
+
+      nb++;
+      valid += sizeof(rec);
+    }
+
+  fclose(stream);
+
+  /* A record was being written when the server stopped */
+  if(nb > 0 && truncate(index_path, valid) != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not truncate %s: %s",
+              index_path, strerror(errno));
+      return -1;
+    }
+
+  return nb;
+}
+
+/* Rewrites the log with the live records only */
+static int index_log_compact(void)
+{
+  char tmp_path[sizeof(index_path) + sizeof(".compact")];
+  posixdb_index_rec_t *p_recs;
+  struct glist_head *node;
+  unsigned int i, nb;
+  int fd, rc = 0;
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.compact", index_path);
+
+  if((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not create %s: %s",
+              tmp_path, strerror(errno));
+      return -1;
+    }
+
+  /* the objects first, so that the links find them when replayed */
+  p_recs = batch[0];
+  index_rec_header(&p_recs[0]);
+  nb = 1;
+
+  for(i = 0; i < POSIXDB_INDEX_HASH_SIZE && rc == 0; i++)
+    glist_for_each(node, &id_hash[i])
+    {
+      index_rec_entry(&p_recs[nb], POSIXDB_INDEX_OP_HANDLE,
+                      glist_entry(node, posixdb_index_entry_t, id_list));
+      p_recs[nb].magic = POSIXDB_INDEX_MAGIC;
+      p_recs[nb].checksum = index_fnv(2166136261U, &p_recs[nb],
+                                      offsetof(posixdb_index_rec_t, checksum));
+      if(++nb == POSIXDB_INDEX_BATCH_MAX)
+        {
+          if((rc = index_write_recs(fd, p_recs, nb)) != 0)
+            break;
+          nb = 0;
+        }
+    }
+
+  for(i = 0; i < POSIXDB_INDEX_HASH_SIZE && rc == 0; i++)
+    glist_for_each(node, &name_hash[i])
+    {
+      index_rec_link(&p_recs[nb], POSIXDB_INDEX_OP_LINK,
+                     glist_entry(node, posixdb_index_link_t, name_list));
+      p_recs[nb].magic = POSIXDB_INDEX_MAGIC;
+      p_recs[nb].checksum = index_fnv(2166136261U, &p_recs[nb],
+                                      offsetof(posixdb_index_rec_t, checksum));
+      if(++nb == POSIXDB_INDEX_BATCH_MAX)
+        {
+          if((rc = index_write_recs(fd, p_recs, nb)) != 0)
+            break;
+          nb = 0;
+        }
+    }
+
+  if(rc == 0 && nb > 0)
+    rc = index_write_recs(fd, p_recs, nb);
+
+  if(rc == 0 && fsync(fd) != 0)
+    rc = -errno;
+
+  close(fd);
+
+  if(rc == 0 && rename(tmp_path, index_path) != 0)
+    rc = -errno;
+
+  if(rc != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not write %s: %s",
+              tmp_path, strerror(-rc));
+      unlink(tmp_path);
+      return -1;
+    }
+
+  fsync(index_dir_fd);
+
+  return 0;
+}
+
+/* Fills the index with a directory of the database and everything below it */
+static int index_import_dir(fsal_posixdb_conn * p_conn, posixdb_index_entry_t * p_dir)
+{
+  fsal_posixdb_status_t st;
+  fsal_posixdb_child *p_children = NULL;
+  posixfsal_handle_t dir_handle;
+  posixdb_index_entry_t *p_entry;
+  unsigned int i, count = 0;
+  int rc = 0;
+  int is_new;
+
+  index_fill_handle(p_dir, &dir_handle);
+
+  st = fsal_posixdb_getChildren(p_conn, &dir_handle, 0, &p_children, &count);
+  if(FSAL_POSIXDB_IS_ERROR(st))
+    return -1;
+
+  for(i = 0; i < count && rc == 0; i++)
+    {
+      p_entry = index_find(&p_children[i].handle);
+      is_new = (p_entry == NULL);
+
+      if(is_new)
+        p_entry = index_set_entry(p_children[i].handle.data.id,
+                                  p_children[i].handle.data.ts,
+                                  &p_children[i].handle.data.info);
+
+      if(p_entry == NULL || index_set_link(p_dir, p_entry, &p_children[i].name) == NULL)
+        rc = -1;
+      else if(is_new && p_entry->info.ftype == FSAL_TYPE_DIR)
+        rc = index_import_dir(p_conn, p_entry);
+    }
+
+  if(p_children)
+    Mem_Free(p_children);
+
+  return rc;
+}
+
+static int index_import_db(fsal_posixdb_conn_params_t * p_params)
+{
+  fsal_posixdb_conn *p_conn;
+  fsal_posixdb_status_t st;
+  posixfsal_handle_t root_handle;
+  posixdb_index_entry_t *p_root;
+  int rc;
+
+  st = fsal_posixdb_connect(p_params, &p_conn);
+  if(FSAL_POSIXDB_IS_ERROR(st))
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not connect to database %s",
+              p_params->dbname);
+      return -1;
+    }
+
+  st = fsal_posixdb_getInfoFromName(p_conn, NULL, NULL, NULL, &root_handle);
+  if(FSAL_POSIXDB_IS_NOENT(st))
+    {
+      /* empty database */
+      fsal_posixdb_disconnect(p_conn);
+      return 0;
+    }
+
+  if(FSAL_POSIXDB_IS_ERROR(st)
+     || (p_root = index_set_entry(root_handle.data.id, root_handle.data.ts,
+                                  &root_handle.data.info)) == NULL
+     || index_set_link(p_root, p_root, &root_name) == NULL)
+    rc = -1;
+  else
+    rc = index_import_dir(p_conn, p_root);
+
+  fsal_posixdb_disconnect(p_conn);
+
+  if(rc != 0)
+    LogCrit(COMPONENT_FSAL, "POSIXDB index: could not import database %s",
+            p_params->dbname);
+  else
+    LogEvent(COMPONENT_FSAL,
+             "POSIXDB index: imported %u objects and %u names from database %s",
+             index_nb_entries, index_nb_links, p_params->dbname);
+
+  return rc;
+}
+
+static void *posixdb_index_flusher(void *arg)
+{
+  unsigned int cur, len;
+  unsigned long long seq;
+  int rc;
+
+  SetNameFunction("posixdb_index");
+
+  while(1)
+    {
+      P(batch_mutex);
+
+      while(batch_len == 0)
+        pthread_cond_wait(&batch_cond, &batch_mutex);
+
+      if(index_commit_delay > 0)
+        {
+          /* let the other threads join the batch */
+          V(batch_mutex);
+          usleep(index_commit_delay);
+          P(batch_mutex);
+        }
+
+      cur = batch_cur;
+      len = batch_len;
+      seq = queued_seq;
+      batch_cur ^= 1;
+      batch_len = 0;
+
+      /* wake up the threads waiting for room */
+      pthread_cond_broadcast(&commit_cond);
+
+      V(batch_mutex);
+
+      /* after a failure, the records would not be replayed in order */
+      if(index_failed)
+        rc = -EIO;
+      else
+        {
+          rc = index_write_recs(index_fd, batch[cur], len);
+          if(rc == 0 && index_sync && fdatasync(index_fd) != 0)
+            rc = -errno;
+
+          if(rc != 0)
+            {
+              LogCrit(COMPONENT_FSAL,
+                      "POSIXDB index: could not write %u records to %s: %s, no more changes will be logged",
+                      len, index_path, strerror(-rc));
+
+              /* a torn batch must not be replayed */
+              if(ftruncate(index_fd, index_good_offset) != 0)
+                LogCrit(COMPONENT_FSAL, "POSIXDB index: could not truncate %s: %s",
+                        index_path, strerror(errno));
+            }
+          else
+            index_good_offset += len * sizeof(posixdb_index_rec_t);
+        }
+
+      P(batch_mutex);
+      committed_seq = seq;
+      if(rc == 0)
+        good_seq = seq;
+      else
+        index_failed = TRUE;
+      pthread_cond_broadcast(&commit_cond);
+      V(batch_mutex);
+    }
+
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * Interface
+ * ------------------------------------------------------------------------- */
+
+/**
+ * posixdb_index_init:
+ * Loads the index from Index_Dir and starts its flusher.
+ * Does nothing if Index_Dir is not set.
+ *
+ * \return 0 if OK, -1 on error.
+ */
+int posixdb_index_init(posixfs_specific_initinfo_t * p_init_info)
+{
+  pthread_attr_t attr;
+  pthread_t thrid;
+  struct stat st;
+  unsigned int i;
+  int nb = 0;
+  int is_new;
+  int rc;
+
+  if(p_init_info->index_dir[0] == '\0')
+    return 0;
+
+  index_sync = p_init_info->index_sync;
+  index_commit_delay = p_init_info->index_commit_delay;
+  snprintf(index_path, sizeof(index_path), "%s/%s", p_init_info->index_dir,
+           POSIXDB_INDEX_FILE);
+
+  id_hash = (struct glist_head *)Mem_Alloc(3 * POSIXDB_INDEX_HASH_SIZE * sizeof(struct glist_head));
+  batch[0] = (posixdb_index_rec_t *) Mem_Alloc(2 * POSIXDB_INDEX_BATCH_MAX * sizeof(posixdb_index_rec_t));
+  if(id_hash == NULL || batch[0] == NULL)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not allocate the index");
+      return -1;
+    }
+  inode_hash = id_hash + POSIXDB_INDEX_HASH_SIZE;
+  name_hash = inode_hash + POSIXDB_INDEX_HASH_SIZE;
+  batch[1] = batch[0] + POSIXDB_INDEX_BATCH_MAX;
+
+  for(i = 0; i < 3 * POSIXDB_INDEX_HASH_SIZE; i++)
+    init_glist(&id_hash[i]);
+
+  if(rw_lock_init(&index_lock) != 0)
+    return -1;
+
+  /* Only one server may use the index */
+  if((index_dir_fd = open(p_init_info->index_dir, O_RDONLY)) < 0
+     || flock(index_dir_fd, LOCK_EX | LOCK_NB) != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not lock %s: %s",
+              p_init_info->index_dir, strerror(errno));
+      return -1;
+    }
+
+  is_new = (stat(index_path, &st) != 0 || st.st_size == 0);
+
+  index_loading = TRUE;
+
+  if(!is_new)
+    nb = index_log_load();
+  else if(p_init_info->dbparams.dbname[0] != '\0')
+    nb = index_import_db(&p_init_info->dbparams);
+
+  index_loading = FALSE;
+
+  if(nb < 0)
+    return -1;
+
+  if(is_new || (nb > POSIXDB_INDEX_COMPACT_MIN
+                && nb > 2 * (index_nb_entries + index_nb_links)))
+    {
+      if(index_log_compact() != 0)
+        return -1;
+    }
+
+  if((index_fd = open(index_path, O_WRONLY | O_APPEND)) < 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not open %s: %s",
+              index_path, strerror(errno));
+      return -1;
+    }
+
+  if((index_good_offset = lseek(index_fd, 0, SEEK_END)) < 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not seek %s: %s",
+              index_path, strerror(errno));
+      return -1;
+    }
+
+  pthread_attr_init(&attr);
+  pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  if((rc = pthread_create(&thrid, &attr, posixdb_index_flusher, NULL)) != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "POSIXDB index: could not start the flusher: %s",
+              strerror(rc));
+      return -1;
+    }
+
+  index_enabled = TRUE;
+
+  LogEvent(COMPONENT_FSAL, "POSIXDB index: %u objects and %u names in %s",
+           index_nb_entries, index_nb_links, index_path);
+
+  return 0;
+}                               /* posixdb_index_init */
+
+/**
+ * posixdb_index_enabled:
+ * Tells if the namespace is served by the local index.
+ */
+int posixdb_index_enabled(void)
+{
+  return index_enabled;
+}
+
+/**
+ * posixdb_index_getInfoFromName:
+ * See fsal_posixdb_getInfoFromName.
+ */
+fsal_posixdb_status_t posixdb_index_getInfoFromName(fsal_posixdb_conn * p_conn,        /* IN */
+                                                    posixfsal_handle_t * p_parent_directory_handle,    /* IN */
+                                                    fsal_name_t * p_objectname, /* IN */
+                                                    fsal_path_t * p_path,       /* OUT */
+                                                    posixfsal_handle_t * p_handle /* OUT */ )
+{
+  posixdb_index_entry_t *p_parent = NULL;
+  posixdb_index_link_t *p_link;
+  fsal_posixdb_status_t st;
+
+  if(!index_enabled)
+    return fsal_posixdb_getInfoFromName(p_conn, p_parent_directory_handle,
+                                        p_objectname, p_path, p_handle);
+
+  if(!p_handle || (p_parent_directory_handle && p_parent_directory_handle->data.id
+                   && !p_objectname))
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+
+  P_r(&index_lock);
+
+  if(p_parent_directory_handle && p_parent_directory_handle->data.id)
+    {
+      if((p_parent = index_find(p_parent_directory_handle)) == NULL
+         || (p_link = index_lookup(p_parent, p_objectname)) == NULL)
+        {
+          V_r(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+        }
+      index_fill_handle(p_link->object, p_handle);
+    }
+  else
+    {
+      if(index_root == NULL)
+        {
+          V_r(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+        }
+      index_fill_handle(index_root, p_handle);
+    }
+
+  if(p_path && p_parent)
+    {
+      st = index_build_path(p_parent, p_path);
+      if(!FSAL_POSIXDB_IS_ERROR(st))
+        st = index_append_name(p_path, p_objectname);
+      if(FSAL_POSIXDB_IS_ERROR(st))
+        {
+          V_r(&index_lock);
+          return st;
+        }
+    }
+
+  V_r(&index_lock);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_getInfoFromHandle:
+ * See fsal_posixdb_getInfoFromHandle.
+ */
+fsal_posixdb_status_t posixdb_index_getInfoFromHandle(fsal_posixdb_conn * p_conn,      /* IN */
+                                                      posixfsal_handle_t * p_object_handle,    /* IN/OUT */
+                                                      fsal_path_t * p_paths,   /* OUT */
+                                                      int paths_size,  /* IN */
+                                                      int *p_count /* OUT */ )
+{
+  posixdb_index_entry_t *p_entry;
+  posixdb_index_link_t *p_link;
+  struct glist_head *node;
+  fsal_posixdb_status_t st;
+  int count = 0;
+  int toomanypaths = 0;
+
+  if(!index_enabled)
+    return fsal_posixdb_getInfoFromHandle(p_conn, p_object_handle, p_paths,
+                                          paths_size, p_count);
+
+  if(!p_object_handle || ((!p_paths || !p_count) && paths_size > 0))
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+
+  P_r(&index_lock);
+
+  if((p_entry = index_find(p_object_handle)) == NULL)
+    {
+      V_r(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+    }
+
+  p_object_handle->data.info = p_entry->info;
+
+  if(p_paths)
+    {
+      glist_for_each(node, &p_entry->paths)
+      {
+        if(count == paths_size)
+          {
+            toomanypaths = 1;
+            break;
+          }
+
+        p_link = glist_entry(node, posixdb_index_link_t, path_list);
+
+        /* the root is named "" in itself, its path is "/" */
+        st = index_build_path(p_link->parent, &p_paths[count]);
+        if(!FSAL_POSIXDB_IS_ERROR(st))
+          st = index_append_name(&p_paths[count], &p_link->name);
+        if(FSAL_POSIXDB_IS_ERROR(st))
+          {
+            V_r(&index_lock);
+            return st;
+          }
+        count++;
+      }
+
+      *p_count = count;
+
+      if(count == 0)
+        {
+          V_r(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_NOPATH, 0);
+        }
+    }
+
+  V_r(&index_lock);
+
+  ReturnCodeIndex(toomanypaths ? ERR_FSAL_POSIXDB_TOOMANYPATHS : ERR_FSAL_POSIXDB_NOERR,
+                  0);
+}
+
+/**
+ * posixdb_index_add:
+ * See fsal_posixdb_add.
+ */
+fsal_posixdb_status_t posixdb_index_add(fsal_posixdb_conn * p_conn,    /* IN */
+                                        fsal_posixdb_fileinfo_t * p_object_info,       /* IN */
+                                        posixfsal_handle_t * p_parent_directory_handle,        /* IN */
+                                        fsal_name_t * p_filename,      /* IN */
+                                        posixfsal_handle_t * p_object_handle /* OUT */ )
+{
+  posixdb_index_entry_t *p_parent = NULL;
+  posixdb_index_entry_t *p_entry;
+  posixdb_index_link_t *p_link;
+  unsigned long long seq;
+
+  if(!index_enabled)
+    return fsal_posixdb_add(p_conn, p_object_info, p_parent_directory_handle,
+                            p_filename, p_object_handle);
+
+  /* parent_directory and filename are NULL only if it is the root directory */
+  if(!p_object_info || !p_object_handle
+     || (p_filename && !p_parent_directory_handle) || (!p_filename
+                                                       && p_parent_directory_handle))
+    {
+      index_handle_unlock();
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+    }
+
+  P_w(&index_lock);
+
+  /* the change is now ordered before the next update of the object */
+  index_handle_unlock();
+
+  if(index_log_failed())
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+    }
+
+  if(p_parent_directory_handle
+     && (p_parent = index_find(p_parent_directory_handle)) == NULL)
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+    }
+
+  if((p_entry = index_find_inode(p_object_info->devid, p_object_info->inode)) != NULL)
+    {
+      index_fill_handle(p_entry, p_object_handle);
+
+      if(fsal_posixdb_consistency_check(&(p_object_handle->data.info), p_object_info))
+        {
+          /* p_object_handle has been filled in order to be able to fix the consistency later */
+          V_w(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_CONSISTENCY, 0);
+        }
+
+      if(p_object_info->nlink != p_entry->info.nlink
+         || p_object_info->ctime != p_entry->info.ctime)
+        {
+          index_set_entry(p_entry->id, p_entry->ts, p_object_info);
+          p_object_handle->data.info = *p_object_info;
+        }
+    }
+  else
+    {
+      if((p_entry = index_set_entry(index_next_id, (int)time(NULL), p_object_info)) == NULL)
+        {
+          V_w(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_NO_MEM, 0);
+        }
+      index_fill_handle(p_entry, p_object_handle);
+    }
+
+  if(p_parent == NULL)
+    {
+      p_parent = p_entry;
+      p_filename = &root_name;
+    }
+
+  p_link = index_lookup(p_parent, p_filename);
+
+  if(p_link == NULL || p_link->object != p_entry)
+    {
+      /* the name was given to another object */
+      if(p_link != NULL)
+        index_delete_path(p_link);
+
+      if(index_set_link(p_parent, p_entry, p_filename) == NULL)
+        {
+          V_w(&index_lock);
+          ReturnCodeIndex(ERR_FSAL_POSIXDB_NO_MEM, 0);
+        }
+    }
+
+  seq = index_log_last();
+
+  V_w(&index_lock);
+
+  if(index_log_wait(seq) != 0)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_replace:
+ * See fsal_posixdb_replace.
+ */
+fsal_posixdb_status_t posixdb_index_replace(fsal_posixdb_conn * p_conn,        /* IN */
+                                            fsal_posixdb_fileinfo_t * p_object_info,   /* IN */
+                                            posixfsal_handle_t * p_parent_directory_handle_old,        /* IN */
+                                            fsal_name_t * p_filename_old,      /* IN */
+                                            posixfsal_handle_t * p_parent_directory_handle_new,        /* IN */
+                                            fsal_name_t * p_filename_new /* IN */ )
+{
+  posixdb_index_entry_t *p_parent_old;
+  posixdb_index_entry_t *p_parent_new;
+  posixdb_index_entry_t *p_object;
+  posixdb_index_link_t *p_link;
+  posixdb_index_link_t *p_target;
+  unsigned long long seq;
+
+  if(!index_enabled)
+    return fsal_posixdb_replace(p_conn, p_object_info, p_parent_directory_handle_old,
+                                p_filename_old, p_parent_directory_handle_new,
+                                p_filename_new);
+
+  if(!p_object_info || !p_parent_directory_handle_old || !p_filename_old
+     || !p_parent_directory_handle_new || !p_filename_new)
+    {
+      index_handle_unlock();
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+    }
+
+  P_w(&index_lock);
+
+  /* the change is now ordered before the next update of the object */
+  index_handle_unlock();
+
+  if(index_log_failed())
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+    }
+
+  if((p_parent_old = index_find(p_parent_directory_handle_old)) == NULL
+     || (p_link = index_lookup(p_parent_old, p_filename_old)) == NULL
+     || (p_parent_new = index_find(p_parent_directory_handle_new)) == NULL)
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+    }
+
+  p_object = p_link->object;
+
+  if(fsal_posixdb_consistency_check(&p_object->info, p_object_info))
+    {
+      LogCrit(COMPONENT_FSAL, "Consistency check failed while renaming a file : Handle deleted");
+      index_delete_tree(p_object);
+    }
+  else
+    {
+      p_target = index_lookup(p_parent_new, p_filename_new);
+
+      /* nothing changes when both names are links to the same object */
+      if(p_target == NULL || p_target->object != p_object)
+        {
+          /* Remove target entry if it exists */
+          if(p_target != NULL)
+            {
+              if(p_target->object->info.ftype == FSAL_TYPE_DIR)
+                index_delete_tree(p_target->object);
+              else
+                index_delete_path(p_target);
+            }
+
+          index_del_link(p_link);
+          index_set_link(p_parent_new, p_object, p_filename_new);
+        }
+    }
+
+  seq = index_log_last();
+
+  V_w(&index_lock);
+
+  if(index_log_wait(seq) != 0)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_delete:
+ * See fsal_posixdb_delete.
+ */
+fsal_posixdb_status_t posixdb_index_delete(fsal_posixdb_conn * p_conn, /* IN */
+                                           posixfsal_handle_t * p_parent_directory_handle,     /* IN */
+                                           fsal_name_t * p_filename,   /* IN */
+                                           fsal_posixdb_fileinfo_t * p_object_info /* IN */ )
+{
+  posixdb_index_entry_t *p_parent;
+  posixdb_index_link_t *p_link;
+  fsal_nodetype_t ftype;
+  unsigned long long seq;
+
+  if(!index_enabled)
+    return fsal_posixdb_delete(p_conn, p_parent_directory_handle, p_filename,
+                               p_object_info);
+
+  if(!p_parent_directory_handle || !p_filename)
+    {
+      index_handle_unlock();
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+    }
+
+  P_w(&index_lock);
+
+  /* the change is now ordered before the next update of the object */
+  index_handle_unlock();
+
+  if(index_log_failed())
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+    }
+
+  if((p_parent = index_find(p_parent_directory_handle)) == NULL
+     || (p_link = index_lookup(p_parent, p_filename)) == NULL)
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+    }
+
+  ftype = p_link->object->info.ftype;
+
+  if(p_object_info && fsal_posixdb_consistency_check(&p_link->object->info, p_object_info))
+    {
+      /* not consistent, the bad handle have to be deleted */
+      LogCrit(COMPONENT_FSAL, "Consistency check failed while deleting a Path : Handle deleted");
+      ftype = FSAL_TYPE_DIR;
+    }
+
+  if(ftype == FSAL_TYPE_DIR)
+    index_delete_tree(p_link->object);
+  else
+    index_delete_path(p_link);
+
+  seq = index_log_last();
+
+  V_w(&index_lock);
+
+  if(index_log_wait(seq) != 0)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_deleteHandle:
+ * See fsal_posixdb_deleteHandle.
+ */
+fsal_posixdb_status_t posixdb_index_deleteHandle(fsal_posixdb_conn * p_conn,   /* IN */
+                                                 posixfsal_handle_t * p_handle /* IN */ )
+{
+  posixdb_index_entry_t *p_entry;
+  unsigned long long seq;
+
+  if(!index_enabled)
+    return fsal_posixdb_deleteHandle(p_conn, p_handle);
+
+  if(!p_handle)
+    {
+      index_handle_unlock();
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+    }
+
+  P_w(&index_lock);
+
+  /* the change is now ordered before the next update of the object */
+  index_handle_unlock();
+
+  if(index_log_failed())
+    {
+      V_w(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+    }
+
+  if((p_entry = index_find(p_handle)) != NULL)
+    index_delete_tree(p_entry);
+
+  seq = index_log_last();
+
+  V_w(&index_lock);
+
+  if(index_log_wait(seq) != 0)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_getChildren:
+ * See fsal_posixdb_getChildren.
+ */
+fsal_posixdb_status_t posixdb_index_getChildren(fsal_posixdb_conn * p_conn,    /* IN */
+                                                posixfsal_handle_t * p_parent_directory_handle,        /* IN */
+                                                unsigned int max_count, fsal_posixdb_child ** p_children,      /* OUT */
+                                                unsigned int *p_count /* OUT */ )
+{
+  posixdb_index_entry_t *p_parent;
+  posixdb_index_link_t *p_link;
+  struct glist_head *node;
+  unsigned int count = 0;
+
+  if(!index_enabled)
+    return fsal_posixdb_getChildren(p_conn, p_parent_directory_handle, max_count,
+                                    p_children, p_count);
+
+  if(!p_parent_directory_handle || !p_children || !p_count)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+
+  *p_children = NULL;
+  *p_count = 0;
+
+  P_r(&index_lock);
+
+  if((p_parent = index_find(p_parent_directory_handle)) != NULL)
+    glist_for_each(node, &p_parent->children)
+    {
+      if(glist_entry(node, posixdb_index_link_t, child_list)->object != p_parent)
+        count++;
+    }
+
+  if(count == 0)
+    {
+      V_r(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+    }
+
+  if(max_count && count > max_count)
+    {
+      V_r(&index_lock);
+      LogCrit(COMPONENT_FSAL, "Children count %u exceed max_count %u in posixdb_index_getChildren",
+              count, max_count);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_TOOMANYPATHS, 0);
+    }
+
+  *p_children = (fsal_posixdb_child *) Mem_Alloc(sizeof(fsal_posixdb_child) * count);
+  if(*p_children == NULL)
+    {
+      V_r(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+    }
+
+  glist_for_each(node, &p_parent->children)
+  {
+    p_link = glist_entry(node, posixdb_index_link_t, child_list);
+    if(p_link->object == p_parent)
+      continue;
+
+    index_fill_handle(p_link->object, &(*p_children)[*p_count].handle);
+    FSAL_namecpy(&(*p_children)[*p_count].name, &p_link->name);
+    (*p_count)++;
+  }
+
+  V_r(&index_lock);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_getParentDirHandle:
+ * See fsal_posixdb_getParentDirHandle.
+ */
+fsal_posixdb_status_t posixdb_index_getParentDirHandle(fsal_posixdb_conn * p_conn,     /* IN */
+                                                       posixfsal_handle_t * p_object_handle,   /* IN */
+                                                       posixfsal_handle_t * p_parent_directory_handle  /* OUT */
+    )
+{
+  posixdb_index_entry_t *p_entry;
+  posixdb_index_link_t *p_link = NULL;
+
+  if(!index_enabled)
+    return fsal_posixdb_getParentDirHandle(p_conn, p_object_handle,
+                                           p_parent_directory_handle);
+
+  if(!p_parent_directory_handle || !p_object_handle)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+
+  P_r(&index_lock);
+
+  if((p_entry = index_find(p_object_handle)) != NULL)
+    p_link = glist_first_entry(&p_entry->paths, posixdb_index_link_t, path_list);
+
+  if(p_link == NULL)
+    {
+      V_r(&index_lock);
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_NOENT, 0);
+    }
+
+  index_fill_handle(p_link->parent, p_parent_directory_handle);
+
+  V_r(&index_lock);
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_lockHandleForUpdate:
+ * See fsal_posixdb_lockHandleForUpdate. Serializes the threads updating
+ * the object p_info describes, until posixdb_index_cancelHandleLock or
+ * the next change the thread makes.
+ */
+fsal_posixdb_status_t posixdb_index_lockHandleForUpdate(fsal_posixdb_conn * p_conn,    /* IN */
+                                                        fsal_posixdb_fileinfo_t * p_info /* IN */ )
+{
+  if(!index_enabled)
+    return fsal_posixdb_lockHandleForUpdate(p_conn, p_info);
+
+  if(!p_info)
+    ReturnCodeIndex(ERR_FSAL_POSIXDB_FAULT, 0);
+
+  pthread_once(&handle_locks_once, index_handle_locks_init);
+
+  /* one update at a time per thread, as one transaction per connection */
+  index_handle_unlock();
+
+  handle_lock_held = hash_inode(p_info->devid, p_info->inode) % POSIXDB_INDEX_LOCK_SIZE;
+  P(handle_locks[handle_lock_held]);
+
+  if(index_log_failed())
+    {
+      index_handle_unlock();
+      ReturnCodeIndex(ERR_FSAL_POSIXDB_CMDFAILED, EIO);
+    }
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
+
+/**
+ * posixdb_index_cancelHandleLock:
+ * See fsal_posixdb_cancelHandleLock.
+ */
+fsal_posixdb_status_t posixdb_index_cancelHandleLock(fsal_posixdb_conn * p_conn /* IN */ )
+{
+  if(!index_enabled)
+    return fsal_posixdb_cancelHandleLock(p_conn);
+
+  index_handle_unlock();
+
+  ReturnCodeIndex(ERR_FSAL_POSIXDB_NOERR, 0);
+}
@@ -0,0 +1,93 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ */
+
+/**
+ *
+ * \file    posixdb_index.h
+ * \brief   Local index of the handles and names of the POSIX FSAL.
+ *
+ * When Index_Dir is set, the handle <-> path mappings are kept in memory
+ * and made persistent in an append-only log under that directory, instead
+ * of being queried from the database. The log records are group committed
+ * by a flusher thread. The posixdb_index_* functions take the same
+ * arguments as the fsal_posixdb_* ones and call them when no index is
+ * configured.
+ *
+ */
+
+#ifndef _POSIXDB_INDEX_H
+#define _POSIXDB_INDEX_H
+
+#include "fsal.h"
+
+#define POSIXDB_INDEX_FILE          "posixdb.index"
+#define POSIXDB_INDEX_MAGIC         0x50584958
+#define POSIXDB_INDEX_VERSION       1
+
+/* Buckets of the id, inode and name hash tables */
+#define POSIXDB_INDEX_HASH_SIZE     131071
+
+/* Mutexes serializing the updates of an object (lockHandleForUpdate) */
+#define POSIXDB_INDEX_LOCK_SIZE     127
+
+/* Records the flusher writes (and syncs) at once */
+#define POSIXDB_INDEX_BATCH_MAX     1024
+
+/* The log is rewritten at startup when it holds that many records
+ * and less than half of them are still live */
+#define POSIXDB_INDEX_COMPACT_MIN   4096
+
+int posixdb_index_init(posixfs_specific_initinfo_t * p_init_info);
+
+int posixdb_index_enabled(void);
+
+fsal_posixdb_status_t posixdb_index_getInfoFromName(fsal_posixdb_conn * p_conn,        /* IN */
+                                                    posixfsal_handle_t * p_parent_directory_handle,    /* IN */
+                                                    fsal_name_t * p_objectname, /* IN */
+                                                    fsal_path_t * p_path,       /* OUT */
+                                                    posixfsal_handle_t * p_handle /* OUT */ );
+
+fsal_posixdb_status_t posixdb_index_getInfoFromHandle(fsal_posixdb_conn * p_conn,      /* IN */
+                                                      posixfsal_handle_t * p_object_handle,    /* IN/OUT */
+                                                      fsal_path_t * p_paths,   /* OUT */
+                                                      int paths_size,  /* IN */
+                                                      int *p_count /* OUT */ );
+
+fsal_posixdb_status_t posixdb_index_add(fsal_posixdb_conn * p_conn,    /* IN */
+                                        fsal_posixdb_fileinfo_t * p_object_info,       /* IN */
+                                        posixfsal_handle_t * p_parent_directory_handle,        /* IN */
+                                        fsal_name_t * p_filename,      /* IN */
+                                        posixfsal_handle_t * p_object_handle /* OUT */ );
+
+fsal_posixdb_status_t posixdb_index_replace(fsal_posixdb_conn * p_conn,        /* IN */
+                                            fsal_posixdb_fileinfo_t * p_object_info,   /* IN */
+                                            posixfsal_handle_t * p_parent_directory_handle_old,        /* IN */
+                                            fsal_name_t * p_filename_old,      /* IN */
+                                            posixfsal_handle_t * p_parent_directory_handle_new,        /* IN */
+                                            fsal_name_t * p_filename_new /* IN */ );
+
+fsal_posixdb_status_t posixdb_index_delete(fsal_posixdb_conn * p_conn, /* IN */
+                                           posixfsal_handle_t * p_parent_directory_handle,     /* IN */
+                                           fsal_name_t * p_filename,   /* IN */
+                                           fsal_posixdb_fileinfo_t * p_object_info /* IN */ );
+
+fsal_posixdb_status_t posixdb_index_deleteHandle(fsal_posixdb_conn * p_conn,   /* IN */
+                                                 posixfsal_handle_t * p_handle /* IN */ );
+
+fsal_posixdb_status_t posixdb_index_getChildren(fsal_posixdb_conn * p_conn,    /* IN */
+                                                posixfsal_handle_t * p_parent_directory_handle,        /* IN */
+                                                unsigned int max_count, fsal_posixdb_child ** p_children,      /* OUT */
+                                                unsigned int *p_count /* OUT */ );
+
+fsal_posixdb_status_t posixdb_index_getParentDirHandle(fsal_posixdb_conn * p_conn,     /* IN */
+                                                       posixfsal_handle_t * p_object_handle,   /* IN */
+                                                       posixfsal_handle_t * p_parent_directory_handle  /* OUT */
+    );
+
+fsal_posixdb_status_t posixdb_index_lockHandleForUpdate(fsal_posixdb_conn * p_conn,    /* IN */
+                                                        fsal_posixdb_fileinfo_t * p_info /* IN */ );
+
+fsal_posixdb_status_t posixdb_index_cancelHandleLock(fsal_posixdb_conn * p_conn /* IN */ );
+
+#endif                          /* _POSIXDB_INDEX_H */
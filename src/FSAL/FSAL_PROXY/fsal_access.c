@@ -86,6 +86,7 @@ fsal_status_t PROXYFSAL_access(fsal_handle_t * object_handle,      /* IN */
   uint32_t bitmap_val[2];
   uint32_t bitmap_res[2];
   uint32_t accessflag = 0;
+  fsal_boolean_t granted;
   proxyfsal_op_context_t * p_context = (proxyfsal_op_context_t *)context;
 
   fsal_proxy_internal_fattr_t fattr_internal;
@@ -126,13 +127,23 @@ fsal_status_t PROXYFSAL_access(fsal_handle_t * object_handle,      /* IN */
     accessflag |= ACCESS4_LOOKUP;
 
   if(access_type & FSAL_W_OK)
-    accessflag |= (ACCESS4_MODIFY & ACCESS4_EXTEND);
+    accessflag |= (ACCESS4_MODIFY | ACCESS4_EXTEND);
 
   if(access_type & FSAL_F_OK)
     accessflag |= ACCESS4_LOOKUP;
 
   /* >> convert your fsal access type to your FS access type << */
 
+  /* The lookup that found the object may have brought the answer */
+  if(fsal_internal_proxy_piggyback_access(p_context, object_handle, accessflag,
+                                          object_attributes, &granted))
+    {
+      if(!granted)
+        Return(ERR_FSAL_ACCESS, 0, INDEX_FSAL_access);
+
+      Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_access);
+    }
+
   /* Get NFSv4 File handle */
   if(fsal_internal_proxy_extract_fh(&nfs4fh, object_handle) == FALSE)
     Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_access);
@@ -174,6 +185,14 @@ fsal_status_t PROXYFSAL_access(fsal_handle_t * object_handle,      /* IN */
   if(resnfs4.status != NFS4_OK)
     return fsal_internal_proxy_error_convert(resnfs4.status, INDEX_FSAL_access);
 
+  /* Rights the server knows about must all be granted */
+  if(accessflag &
+     resnfs4.resarray.resarray_val[FSAL_ACCESS_IDX_OP_ACCESS].nfs_resop4_u.opaccess.
+     ACCESS4res_u.resok4.supported &
+     ~resnfs4.resarray.resarray_val[FSAL_ACCESS_IDX_OP_ACCESS].nfs_resop4_u.opaccess.
+     ACCESS4res_u.resok4.access)
+    Return(ERR_FSAL_ACCESS, 0, INDEX_FSAL_access);
+
   /* get attributes if object_attributes is not null.
    * If an error occures during getattr operation,
    * an error bit is set in the output structure.
@@ -90,6 +90,10 @@ fsal_status_t PROXYFSAL_getattrs(fsal_handle_t * filehandle,       /* IN */
 
   PRINT_HANDLE("PROXYFSAL_getattrs", filehandle);
 
+  /* The lookup that found the object may have brought them */
+  if(fsal_internal_proxy_piggyback_getattrs(p_context, filehandle, object_attributes))
+    Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_getattrs);
+
   /* >> get attributes from your filesystem << */
   /* Setup results structures */
   argnfs4.argarray.argarray_val = argoparray;
@@ -226,6 +230,8 @@ fsal_status_t PROXYFSAL_setattrs(fsal_handle_t * filehandle,       /* IN */
   char fattr_val[FSAL_SETATTR_VAL_BUFFER];
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : object_attributes is optional.
    */
@@ -204,6 +204,9 @@ fsal_status_t PROXYFSAL_InitClientContext(fsal_op_context_t *context)
   /* initialy set the export entry to none */
   p_thr_context->export_context = NULL;
 
+  /* no group list is held yet */
+  p_thr_context->credential.grouplist = NULL;
+
   /* It is now time to initiate the rpc client within the thread's specific material */
   /* Keep here the reference to the server */
   p_thr_context->srv_prognum = global_fsal_proxy_specific_info.srv_prognum;
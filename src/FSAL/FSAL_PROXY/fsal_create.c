@@ -117,6 +117,8 @@ fsal_status_t PROXYFSAL_create(fsal_handle_t * parent_directory_handle,    /* IN
   char owner_val[FSAL_PROXY_OWNER_LEN];
   unsigned int owner_len = 0;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : object_attributes is optional.
    */
@@ -377,6 +379,8 @@ fsal_status_t PROXYFSAL_mkdir(fsal_handle_t * parent_directory_handle,     /* IN
   char fattr_val[FSAL_MKDIR_VAL_BUFFER];
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : object_attributes is optional.
    */
@@ -569,6 +573,8 @@ fsal_status_t PROXYFSAL_link(fsal_handle_t * target_handle,        /* IN */
 
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : attributes is optional.
    */
@@ -688,6 +694,8 @@ fsal_status_t PROXYFSAL_mknode(fsal_handle_t * parentdir_handle,   /* IN */
     )
 {
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : link_attributes is optional.
    */
@@ -40,6 +40,8 @@
 #define strnlen( s, l ) strlen( s )
 #endif
 
+extern proxyfs_specific_initinfo_t global_fsal_proxy_specific_info;
+
 /**
  * FSAL_open_by_name:
  * Open a regular file for reading/writing its data content.
@@ -516,6 +518,173 @@ fsal_status_t PROXYFSAL_open(fsal_handle_t * filehandle,   /* IN */
   Return(fsal_status.major, fsal_status.minor, INDEX_FSAL_open);
 }
 
+/**
+ * proxyfsal_rdwr_chunked:
+ * Reads or writes a large buffer with several READ/WRITE compounds
+ * in flight at once on the pipelined connections.
+ *
+ * No chunk is sent after one could not be sent. The contiguous chunks
+ * are summed up to the first short or failed one, so the caller sees a
+ * short read/write as with a single compound. A write that left data
+ * after a hole (a later chunk was written after a short or failed one)
+ * fails instead, a short count would hide the data beyond it.
+ *
+ * \param file_descriptor (input): the opened file.
+ * \param offset (input): where the I/O starts.
+ * \param buffer_size (input): amount of data to read/write.
+ * \param buffer (input/output): the data.
+ * \param is_write (input): TRUE for a write, FALSE for a read.
+ * \param io_amount (output): amount of data read/written.
+ * \param end_of_file (output): the read reached the end of the file.
+ *
+ * \return ERR_FSAL_NO_ERROR if the first chunk succeeded and the data
+ *         written is contiguous, the error of the failed chunk otherwise.
+ */
+static fsal_status_t proxyfsal_rdwr_chunked(proxyfsal_file_t * file_descriptor,
+                                            fsal_off_t offset,
+                                            fsal_size_t buffer_size,
+                                            caddr_t buffer,
+                                            fsal_boolean_t is_write,
+                                            fsal_size_t * io_amount,
+                                            fsal_boolean_t * end_of_file)
+{
+  COMPOUND4args argnfs4[FSAL_PROXY_MAX_IO_CHUNKS];
+  COMPOUND4res resnfs4[FSAL_PROXY_MAX_IO_CHUNKS];
+  nfs_argop4 argoparray[FSAL_PROXY_MAX_IO_CHUNKS][2];
+  nfs_resop4 resoparray[FSAL_PROXY_MAX_IO_CHUNKS][2];
+  proxy_rpc_call_t calls[FSAL_PROXY_MAX_IO_CHUNKS];
+  enum clnt_stat stat[FSAL_PROXY_MAX_IO_CHUNKS];
+  fsal_size_t chunk_size[FSAL_PROXY_MAX_IO_CHUNKS];
+  fsal_size_t chunk_done;
+  fsal_size_t chunk;
+  fsal_size_t done = 0;
+  fsal_boolean_t eof = FALSE;
+  fsal_boolean_t short_io = FALSE;
+  nfsstat4 first_status = NFS4_OK;
+  unsigned int stop;
+  struct timeval timeout = TIMEOUTRPC;
+  unsigned int nb_chunks;
+  unsigned int i;
+  nfs_fh4 nfs4fh;
+  int index = is_write ? INDEX_FSAL_write : INDEX_FSAL_read;
+
+  if(fsal_internal_proxy_extract_fh(&nfs4fh, (fsal_handle_t *) &(file_descriptor->fhandle)) == FALSE)
+    Return(ERR_FSAL_FAULT, 0, index);
+
+  chunk = global_fsal_proxy_specific_info.io_chunk_size;
+  nb_chunks = (buffer_size + chunk - 1) / chunk;
+  if(nb_chunks > FSAL_PROXY_MAX_IO_CHUNKS)
+    {
+      /* Larger I/O than what is sent at once, spread it evenly */
+      nb_chunks = FSAL_PROXY_MAX_IO_CHUNKS;
+      chunk = (buffer_size + nb_chunks - 1) / nb_chunks;
+    }
+
+  if(FSAL_proxy_change_user(file_descriptor->pcontext) == NULL)
+    Return(ERR_FSAL_PERM, 0, index);
+
+  TakeTokenFSCall();
+
+  for(i = 0; i < nb_chunks; i++)
+    {
+      chunk_size[i] = (i == nb_chunks - 1) ? buffer_size - i * chunk : chunk;
+
+      argnfs4[i].argarray.argarray_val = argoparray[i];
+      resnfs4[i].resarray.resarray_val = resoparray[i];
+      argnfs4[i].minorversion = 0;
+      argnfs4[i].tag.utf8string_val = NULL;
+      argnfs4[i].tag.utf8string_len = 0;
+      argnfs4[i].argarray.argarray_len = 0;
+
+      COMPOUNDV4_ARG_ADD_OP_PUTFH(argnfs4[i], nfs4fh);
+      if(is_write)
+        COMPOUNDV4_ARG_ADD_OP_WRITE(argnfs4[i], &(file_descriptor->stateid),
+                                    offset + i * chunk, buffer + i * chunk,
+                                    chunk_size[i]);
+      else
+        {
+          COMPOUNDV4_ARG_ADD_OP_READ(argnfs4[i], &(file_descriptor->stateid),
+                                     offset + i * chunk, chunk_size[i]);
+
+          /* The data is decoded straight in its place in the buffer */
+          resoparray[i][1].nfs_resop4_u.opread.READ4res_u.resok4.data.data_val =
+              buffer + i * chunk;
+        }
+
+      stat[i] = proxy_rpc_compound_start(file_descriptor->pcontext,
+                                         &argnfs4[i], &resnfs4[i], &calls[i]);
+      if(stat[i] != RPC_SUCCESS)
+        {
+          /* the I/O stops at this chunk, do not leave data after it */
+          nb_chunks = i + 1;
+          break;
+        }
+    }
+
+  /* Every call that was sent is waited for, its buffers are still in use */
+  for(i = 0; i < nb_chunks; i++)
+    if(stat[i] == RPC_SUCCESS)
+      stat[i] = proxy_rpc_compound_wait(&calls[i], timeout);
+
+  ReleaseTokenFSCall();
+
+  for(i = 0; i < nb_chunks && !short_io; i++)
+    {
+      if(stat[i] != RPC_SUCCESS)
+        break;
+
+      if(resnfs4[i].status != NFS4_OK)
+        {
+          first_status = resnfs4[i].status;
+          break;
+        }
+
+      if(is_write)
+        chunk_done = resoparray[i][1].nfs_resop4_u.opwrite.WRITE4res_u.resok4.count;
+      else
+        {
+          chunk_done = resoparray[i][1].nfs_resop4_u.opread.READ4res_u.resok4.data.data_len;
+          eof = resoparray[i][1].nfs_resop4_u.opread.READ4res_u.resok4.eof;
+        }
+
+      done += chunk_done;
+      short_io = (chunk_done < chunk_size[i]) || eof;
+    }
+
+  /* chunk i - 1 was short, or chunk i failed */
+  stop = short_io ? i - 1 : i;
+
+  if(is_write && stop < nb_chunks)
+    for(i = stop + 1; i < nb_chunks; i++)
+      if(stat[i] == RPC_SUCCESS && resnfs4[i].status == NFS4_OK
+         && resoparray[i][1].nfs_resop4_u.opwrite.WRITE4res_u.resok4.count > 0)
+        {
+          LogCrit(COMPONENT_FSAL,
+                  "FSAL_write: chunk %u of %u was written after a failed or short one, the write fails",
+                  i, nb_chunks);
+          if(stat[stop] != RPC_SUCCESS)
+            Return(ERR_FSAL_IO, stat[stop], index);
+          if(first_status != NFS4_OK)
+            return fsal_internal_proxy_error_convert(first_status, index);
+          Return(ERR_FSAL_IO, 0, index);
+        }
+
+  if(stop == 0 && !short_io)
+    {
+      if(stat[0] != RPC_SUCCESS)
+        Return(ERR_FSAL_IO, stat[0], index);
+      return fsal_internal_proxy_error_convert(first_status, index);
+    }
+
+  *io_amount = done;
+  if(end_of_file != NULL)
+    *end_of_file = eof;
+
+  file_descriptor->current_offset = offset + done;
+
+  Return(ERR_FSAL_NO_ERROR, 0, index);
+}                               /* proxyfsal_rdwr_chunked */
+
 /**
  * FSAL_read:
  * Perform a read operation on an opened file.
@@ -585,11 +754,17 @@ fsal_status_t PROXYFSAL_read(fsal_file_t * file_desc,        /* IN */
           break;
 
         case FSAL_SEEK_END:
+        default:
           Return(ERR_FSAL_INVAL, 0, INDEX_FSAL_read);
           break;
         }
     }
 
+  /* Large reads are split over the pipelined connections */
+  if(proxy_rpc_enabled() && buffer_size > global_fsal_proxy_specific_info.io_chunk_size)
+    return proxyfsal_rdwr_chunked(file_descriptor, offset, buffer_size, buffer,
+                                  FALSE, read_amount, end_of_file);
+
   /* Setup results structures */
   argnfs4.argarray.argarray_val = argoparray;
   resnfs4.resarray.resarray_val = resoparray;
@@ -693,6 +868,8 @@ fsal_status_t PROXYFSAL_write(fsal_file_t * file_desc,       /* IN */
   nfs_argop4 argoparray[FSAL_WRITE_NB_OP_ALLOC];
   nfs_resop4 resoparray[FSAL_WRITE_NB_OP_ALLOC];
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks. */
   if(!file_descriptor || !buffer || !write_amount)
     Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_write);
@@ -712,11 +889,17 @@ fsal_status_t PROXYFSAL_write(fsal_file_t * file_desc,       /* IN */
           break;
 
         case FSAL_SEEK_END:
+        default:
           Return(ERR_FSAL_INVAL, 0, INDEX_FSAL_write);
           break;
         }
     }
 
+  /* Large writes are split over the pipelined connections */
+  if(proxy_rpc_enabled() && buffer_size > global_fsal_proxy_specific_info.io_chunk_size)
+    return proxyfsal_rdwr_chunked(file_descriptor, offset, buffer_size, buffer,
+                                  TRUE, write_amount, NULL);
+
   /* Setup results structures */
   argnfs4.argarray.argarray_val = argoparray;
   resnfs4.resarray.resarray_val = resoparray;
@@ -86,6 +86,10 @@ static int FS_Specific_Init(proxyfs_specific_initinfo_t * fs_init_info)
         return rc;
     }
 #endif
+  /* Start the pipelined connections to the remote server */
+  if(proxy_rpc_init(&global_fsal_proxy_specific_info) != 0)
+    return -1;
+
   /* Init the thread in charge of renewing the client id */
   /* Init for thread parameter (mostly for scheduling) */
   pthread_attr_init(&attr_thr);
@@ -11,6 +11,7 @@
 
 #include  "fsal.h"
 #include "nfs4.h"
+#include "nlm_list.h"
 
 #ifndef FSAL_INTERNAL_H
 #define FSAL_INTERNAL_H
@@ -138,6 +139,66 @@ int fsal_internal_ClientReconnect(proxyfsal_op_context_t * p_thr_context);
 fsal_status_t FSAL_proxy_open_confirm(proxyfsal_file_t * pfd);
 void *FSAL_proxy_change_user(proxyfsal_op_context_t * p_thr_context);
 
+/*
+ * Results piggybacked on LOOKUP (fsal_proxy_internal.c)
+ */
+
+/* How long (in seconds) piggybacked results may be used */
+#define FSAL_PROXY_PIGGYBACK_TTL 1
+
+/* All the rights asked along with a lookup */
+#define FSAL_PROXY_ACCESS4_ALL ( ACCESS4_READ | ACCESS4_LOOKUP | ACCESS4_MODIFY | \
+                                 ACCESS4_EXTEND | ACCESS4_DELETE | ACCESS4_EXECUTE )
+
+void fsal_internal_proxy_piggyback_set(proxyfsal_op_context_t * p_context,
+                                       fsal_handle_t * phandle,
+                                       fsal_attrib_list_t * pattr,
+                                       ACCESS4resok * pres_access,
+                                       unsigned int generation);
+fsal_boolean_t fsal_internal_proxy_piggyback_access(proxyfsal_op_context_t * p_context,
+                                                    fsal_handle_t * phandle,
+                                                    uint32_t accessflag,
+                                                    fsal_attrib_list_t * pattr,
+                                                    fsal_boolean_t * pgranted);
+fsal_boolean_t fsal_internal_proxy_piggyback_getattrs(proxyfsal_op_context_t * p_context,
+                                                      fsal_handle_t * phandle,
+                                                      fsal_attrib_list_t * pattr);
+unsigned int fsal_internal_proxy_piggyback_generation(void);
+void fsal_internal_proxy_piggyback_invalidate(void);
+
+/*
+ * Pipelined client toward the remote server (fsal_proxy_rpc.c)
+ */
+#define PROXY_RPC_PENDING    1
+#define PROXY_RPC_RECEIVING  2
+#define PROXY_RPC_DONE       3
+
+typedef struct proxy_rpc_call__
+{
+  struct glist_head link;                      /**< In the pending calls of pconn */
+  u_int32_t xid;
+  struct proxy_rpc_conn__ *pconn;
+  COMPOUND4res *pres;
+  char *sendbuf;
+  char *recvbuf;                               /**< Given by the receiver when DONE */
+  u_int32_t recvsize;                          /**< Expected size of the reply      */
+  u_int32_t reply_len;
+  int state;
+  enum clnt_stat stat;
+  pthread_cond_t cond;
+} proxy_rpc_call_t;
+
+int proxy_rpc_init(proxyfs_specific_initinfo_t * fs_init_info);
+int proxy_rpc_enabled(void);
+enum clnt_stat proxy_rpc_compound_start(proxyfsal_op_context_t * p_context,
+                                        COMPOUND4args * parg,
+                                        COMPOUND4res * pres,
+                                        proxy_rpc_call_t * pcall);
+enum clnt_stat proxy_rpc_compound_wait(proxy_rpc_call_t * pcall, struct timeval timeout);
+enum clnt_stat FSAL_proxy_compound(proxyfsal_op_context_t * p_context,
+                                   COMPOUND4args * parg,
+                                   COMPOUND4res * pres, struct timeval timeout);
+
 /* All the call to FSAL to be wrapped */
 fsal_status_t PROXYFSAL_access(fsal_handle_t * p_object_handle,    /* IN */
                                fsal_op_context_t * p_context,      /* IN */
@@ -36,6 +36,8 @@
 #include "nfs_proto_functions.h"
 #include "fsal_nfsv4_macros.h"
 
+extern proxyfs_specific_initinfo_t global_fsal_proxy_specific_info;
+
 /**
  * PROXYFSAL_lookup :
  * Looks up for an object into a directory.
@@ -92,9 +94,12 @@ fsal_status_t PROXYFSAL_lookup(fsal_handle_t * parent_directory_handle,    /* IN
   fsal_attrib_list_t attributes;
   unsigned int index_getfh = 0;
   unsigned int index_getattr = 0;
+  unsigned int index_access = 0;
+  unsigned int generation;
+  ACCESS4resok *pres_access = NULL;
   proxyfsal_op_context_t * p_context = (proxyfsal_op_context_t *)context;
 
-#define FSAL_LOOKUP_NB_OP_ALLOC 4
+#define FSAL_LOOKUP_NB_OP_ALLOC 5
   nfs_argop4 argoparray[FSAL_LOOKUP_NB_OP_ALLOC];
   nfs_resop4 resoparray[FSAL_LOOKUP_NB_OP_ALLOC];
   uint32_t bitmap_res[2];
@@ -314,6 +319,16 @@ fsal_status_t PROXYFSAL_lookup(fsal_handle_t * parent_directory_handle,    /* IN
         }
     }
 
+  /* The caller checks the access to the object right after, ask for it now,
+   * unless it is checked from the attributes */
+  if(global_fsal_proxy_specific_info.lookup_access)
+    {
+      index_access = argnfs4.argarray.argarray_len;
+      COMPOUNDV4_ARG_ADD_OP_ACCESS(argnfs4, FSAL_PROXY_ACCESS4_ALL);
+    }
+
+  generation = fsal_internal_proxy_piggyback_generation();
+
   TakeTokenFSCall();
 
   /* Call the NFSv4 function */
@@ -326,8 +341,17 @@ fsal_status_t PROXYFSAL_lookup(fsal_handle_t * parent_directory_handle,    /* IN
     }
   ReleaseTokenFSCall();
 
-  if(resnfs4.status != NFS4_OK)
+  if(resnfs4.status == NFS4_OK)
+    {
+      if(global_fsal_proxy_specific_info.lookup_access)
+        pres_access =
+            &resnfs4.resarray.resarray_val[index_access].nfs_resop4_u.opaccess.
+            ACCESS4res_u.resok4;
+    }
+  else if(!global_fsal_proxy_specific_info.lookup_access ||
+          resnfs4.resarray.resarray_len != index_access + 1)
     return fsal_internal_proxy_error_convert(resnfs4.status, INDEX_FSAL_lookup);
+  /* else only the piggybacked ACCESS failed, the lookup itself is done */
 
   /* Use NFSv4 service function to build the FSAL_attr */
   if(nfs4_Fattr_To_FSAL_attr(&attributes,
@@ -353,6 +377,9 @@ fsal_status_t PROXYFSAL_lookup(fsal_handle_t * parent_directory_handle,    /* IN
 
   PRINT_HANDLE("PROXYFSAL_lookup object found", object_handle);
 
+  fsal_internal_proxy_piggyback_set(p_context, object_handle, &attributes, pres_access,
+                                    generation);
+
   /* Return attributes if asked */
   if(object_attributes)
     {
@@ -268,10 +268,8 @@ do {
   if( __renew_rc == 0 )                                                                   \
       {                                                                                   \
         if( FSAL_proxy_change_user( pcontext ) == NULL ) break  ;                         \
-        if( ( rc = clnt_call( pcontext->rpc_client, NFSPROC4_COMPOUND,                    \
-                              (xdrproc_t)xdr_COMPOUND4args, (caddr_t)&argcompound,        \
-                              (xdrproc_t)xdr_COMPOUND4res,  (caddr_t)&rescompound,        \
-                              timeout ) ) == RPC_SUCCESS )                                \
+        if( ( rc = FSAL_proxy_compound( pcontext, &argcompound, &rescompound,             \
+                                        timeout ) ) == RPC_SUCCESS )                      \
               break ;                                                                     \
        }                                                                                  \
   LogEvent(COMPONENT_FSAL, "Reconnecting to the remote server.." ) ;                      \
@@ -1525,3 +1525,207 @@ void *FSAL_proxy_change_user(proxyfsal_op_context_t * p_thr_context)
   /* Return authentication */
   return p_thr_context->rpc_client->cl_auth;
 }                               /* FSAL_proxy_change_user */
+
+/*
+ * Results piggybacked on a LOOKUP compound.
+ *
+ * cache_inode follows a lookup with an access check (and sometimes a
+ * getattr) on the object it just found, or on the next lookup's parent
+ * during a path walk. PROXYFSAL_lookup asks ACCESS for every right in the
+ * same compound and keeps the result here; the next PROXYFSAL_access or
+ * PROXYFSAL_getattrs on that object from this thread is answered from it,
+ * once, if it is recent enough.
+ *
+ * Every operation that changes an object on the server, in any thread, bumps
+ * proxy_piggyback_generation through fsal_internal_proxy_piggyback_invalidate.
+ * A result is only kept if no change was made while its lookup was on the
+ * wire, and only used while the generation is still the same.
+ */
+typedef struct fsal_proxy_piggyback__
+{
+  proxyfsal_handle_t handle;
+  uid_t user;
+  gid_t group;
+  int nbgroups;
+  gid_t alt_groups[FSAL_NGROUPS_MAX];  /* the server's answer depends on them too */
+  time_t time;
+  unsigned int generation;
+  uint32_t access_supported;
+  uint32_t access_granted;
+  fsal_boolean_t access_valid;
+  fsal_boolean_t attr_valid;
+  fsal_attrib_list_t attributes;
+} fsal_proxy_piggyback_t;
+
+static __thread fsal_proxy_piggyback_t proxy_piggyback;
+
+static unsigned int proxy_piggyback_generation = 0;
+
+/**
+ * fsal_internal_proxy_piggyback_generation :
+ * Gets the generation to give to fsal_internal_proxy_piggyback_set, to be
+ * read before the lookup compound is sent.
+ */
+unsigned int fsal_internal_proxy_piggyback_generation(void)
+{
+  return __sync_fetch_and_add(&proxy_piggyback_generation, 0);
+}                               /* fsal_internal_proxy_piggyback_generation */
+
+/**
+ * fsal_internal_proxy_piggyback_set :
+ * Keeps the attributes and access rights fetched with a lookup.
+ *
+ * @param p_context [IN] the context the lookup was made with.
+ * @param phandle [IN] the object found.
+ * @param pattr [IN] its attributes.
+ * @param pres_access [IN] the ACCESS result, NULL if it failed.
+ * @param generation [IN] the generation read before the lookup was sent.
+ *
+ */
+void fsal_internal_proxy_piggyback_set(proxyfsal_op_context_t * p_context,
+                                       fsal_handle_t * phandle,
+                                       fsal_attrib_list_t * pattr,
+                                       ACCESS4resok * pres_access,
+                                       unsigned int generation)
+{
+  /* Something changed while the lookup was on the wire */
+  if(generation != fsal_internal_proxy_piggyback_generation())
+    {
+      proxy_piggyback.access_valid = FALSE;
+      proxy_piggyback.attr_valid = FALSE;
+      return;
+    }
+
+  memcpy(&proxy_piggyback.handle, phandle, sizeof(proxyfsal_handle_t));
+  if(p_context->credential.nbgroups < 0
+     || p_context->credential.nbgroups > FSAL_NGROUPS_MAX)
+    {
+      proxy_piggyback.access_valid = FALSE;
+      proxy_piggyback.attr_valid = FALSE;
+      return;
+    }
+
+  proxy_piggyback.user = p_context->credential.user;
+  proxy_piggyback.group = p_context->credential.group;
+  proxy_piggyback.nbgroups = p_context->credential.nbgroups;
+  memcpy(proxy_piggyback.alt_groups, p_context->credential.alt_groups,
+         proxy_piggyback.nbgroups * sizeof(gid_t));
+  proxy_piggyback.time = time(NULL);
+  proxy_piggyback.generation = generation;
+
+  memcpy(&proxy_piggyback.attributes, pattr, sizeof(fsal_attrib_list_t));
+  proxy_piggyback.attr_valid = TRUE;
+
+  if(pres_access != NULL)
+    {
+      proxy_piggyback.access_supported = pres_access->supported;
+      proxy_piggyback.access_granted = pres_access->access;
+      proxy_piggyback.access_valid = TRUE;
+    }
+  else
+    proxy_piggyback.access_valid = FALSE;
+}                               /* fsal_internal_proxy_piggyback_set */
+
+/**
+ * fsal_internal_proxy_piggyback_match :
+ * Tells if the piggybacked results are about this object, for this user
+ * with the same groups.
+ */
+static fsal_boolean_t fsal_internal_proxy_piggyback_match(proxyfsal_op_context_t * p_context,
+                                                          fsal_handle_t * phandle)
+{
+  fsal_status_t status;
+
+  if(time(NULL) - proxy_piggyback.time > FSAL_PROXY_PIGGYBACK_TTL)
+    return FALSE;
+
+  if(proxy_piggyback.generation != fsal_internal_proxy_piggyback_generation())
+    return FALSE;
+
+  if(proxy_piggyback.user != p_context->credential.user ||
+     proxy_piggyback.group != p_context->credential.group ||
+     proxy_piggyback.nbgroups != p_context->credential.nbgroups)
+    return FALSE;
+
+  if(memcmp(proxy_piggyback.alt_groups, p_context->credential.alt_groups,
+            proxy_piggyback.nbgroups * sizeof(gid_t)) != 0)
+    return FALSE;
+
+  return PROXYFSAL_handlecmp((fsal_handle_t *) & proxy_piggyback.handle, phandle,
+                             &status) == 0;
+}                               /* fsal_internal_proxy_piggyback_match */
+
+/**
+ * fsal_internal_proxy_piggyback_access :
+ * Answers an access check from the piggybacked ACCESS result.
+ *
+ * @param p_context [IN] the context of the check.
+ * @param phandle [IN] the object.
+ * @param accessflag [IN] the ACCESS4 rights to check.
+ * @param pattr [OUT] the object attributes, may be NULL.
+ * @param pgranted [OUT] TRUE if all the rights are granted.
+ *
+ * @return TRUE if the check was answered, FALSE if it has to go to the server.
+ */
+fsal_boolean_t fsal_internal_proxy_piggyback_access(proxyfsal_op_context_t * p_context,
+                                                    fsal_handle_t * phandle,
+                                                    uint32_t accessflag,
+                                                    fsal_attrib_list_t * pattr,
+                                                    fsal_boolean_t * pgranted)
+{
+  if(!proxy_piggyback.access_valid)
+    return FALSE;
+
+  if(!fsal_internal_proxy_piggyback_match(p_context, phandle))
+    return FALSE;
+
+  /* The server could not tell about some of the rights */
+  if(accessflag & ~proxy_piggyback.access_supported)
+    return FALSE;
+
+  proxy_piggyback.access_valid = FALSE;
+
+  *pgranted = (accessflag & ~proxy_piggyback.access_granted) == 0;
+
+  if(pattr != NULL)
+    memcpy(pattr, &proxy_piggyback.attributes, sizeof(fsal_attrib_list_t));
+
+  return TRUE;
+}                               /* fsal_internal_proxy_piggyback_access */
+
+/**
+ * fsal_internal_proxy_piggyback_getattrs :
+ * Answers a getattr from the piggybacked attributes.
+ *
+ * @param p_context [IN] the context of the getattr.
+ * @param phandle [IN] the object.
+ * @param pattr [OUT] the object attributes.
+ *
+ * @return TRUE if the getattr was answered, FALSE if it has to go to the server.
+ */
+fsal_boolean_t fsal_internal_proxy_piggyback_getattrs(proxyfsal_op_context_t * p_context,
+                                                      fsal_handle_t * phandle,
+                                                      fsal_attrib_list_t * pattr)
+{
+  if(!proxy_piggyback.attr_valid)
+    return FALSE;
+
+  if(!fsal_internal_proxy_piggyback_match(p_context, phandle))
+    return FALSE;
+
+  proxy_piggyback.attr_valid = FALSE;
+
+  memcpy(pattr, &proxy_piggyback.attributes, sizeof(fsal_attrib_list_t));
+
+  return TRUE;
+}                               /* fsal_internal_proxy_piggyback_getattrs */
+
+/**
+ * fsal_internal_proxy_piggyback_invalidate :
+ * Outdates the piggybacked results of all the threads, called by the
+ * operations that change objects.
+ */
+void fsal_internal_proxy_piggyback_invalidate(void)
+{
+  __sync_fetch_and_add(&proxy_piggyback_generation, 1);
+}                               /* fsal_internal_proxy_piggyback_invalidate */
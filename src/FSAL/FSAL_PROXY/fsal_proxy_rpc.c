@@ -0,0 +1,813 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    fsal_proxy_rpc.c
+ * \brief   Pipelined RPC client toward the remote NFSv4 server.
+ *
+ * fsal_proxy_rpc.c : Pipelined RPC client toward the remote NFSv4 server.
+ *
+ * The compounds of all the thread contexts are sent on a pool of
+ * Backend_Connections TCP connections. A caller encodes its call, sends it
+ * and sleeps; it does not hold the connection while the server works. One
+ * receiver thread per connection reads the replies and hands each of them
+ * to the caller waiting on its XID. Many compounds are thus in flight on
+ * each connection.
+ *
+ * The per context rpc_client is still used to set up the context (NULL
+ * ping, SETCLIENTID) and holds the AUTH_UNIX credential of the caller.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>              /* For rresvport */
+#ifdef _USE_GSSRPC
+#include <gssrpc/rpc.h>
+#include <gssrpc/xdr.h>
+#else
+#include <rpc/rpc.h>
+#include <rpc/xdr.h>
+#endif
+#include "nfs4.h"
+#include "BuddyMalloc.h"
+#include "stuff_alloc.h"
+#include "fsal_internal.h"
+#include "fsal_common.h"
+
+extern proxyfs_specific_initinfo_t global_fsal_proxy_specific_info;
+#ifndef _NO_BUDDY_SYSTEM
+extern buddy_parameter_t default_buddy_parameter;
+#endif
+
+#define PROXY_RPC_LAST_FRAG    0x80000000
+#define PROXY_RPC_PENDING_HASH 64
+
+typedef struct proxy_rpc_conn__
+{
+  unsigned int index;
+  int fd;                                      /**< -1 while not connected          */
+  pthread_mutex_t send_mutex;                  /**< One record at a time on fd      */
+  pthread_mutex_t mutex;                       /**< Protects fd and pending         */
+  int up;                                      /**< Unlocked hint that fd is set    */
+  struct glist_head pending[PROXY_RPC_PENDING_HASH];
+  pthread_t receiver_thrid;
+} proxy_rpc_conn_t;
+
+static proxy_rpc_conn_t *proxy_rpc_conns = NULL;
+static unsigned int proxy_rpc_nb_conns = 0;
+static unsigned int proxy_rpc_next_conn = 0;
+static u_int32_t proxy_rpc_xid = 0;
+
+/**
+ *
+ * proxy_rpc_enabled: tells if the compounds go through the connection pool.
+ *
+ * @return TRUE if the pool is used, FALSE otherwise.
+ *
+ */
+int proxy_rpc_enabled(void)
+{
+  return proxy_rpc_nb_conns != 0;
+}                               /* proxy_rpc_enabled */
+
+/* Reads exactly len bytes, returns 0 or -1 */
+static int proxy_rpc_read_full(int fd, char *buf, size_t len)
+{
+  ssize_t rc;
+
+  while(len > 0)
+    {
+      rc = read(fd, buf, len);
+      if(rc == 0)
+        return -1;
+      if(rc < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          return -1;
+        }
+      buf += rc;
+      len -= rc;
+    }
+
+  return 0;
+}                               /* proxy_rpc_read_full */
+
+/* Reads and throws len bytes away, returns 0 or -1 */
+static int proxy_rpc_skip(int fd, size_t len)
+{
+  char scratch[1024];
+  size_t chunk;
+
+  while(len > 0)
+    {
+      chunk = len > sizeof(scratch) ? sizeof(scratch) : len;
+      if(proxy_rpc_read_full(fd, scratch, chunk) != 0)
+        return -1;
+      len -= chunk;
+    }
+
+  return 0;
+}                               /* proxy_rpc_skip */
+
+/**
+ *
+ * proxy_rpc_connect: opens a connection to the remote server.
+ *
+ * @return the socket, or -1 if failed.
+ *
+ */
+static int proxy_rpc_connect(void)
+{
+  struct sockaddr_in addr_rpc;
+  int fd;
+  int priv_port = 0;
+  int one = 1;
+
+  memset(&addr_rpc, 0, sizeof(addr_rpc));
+  addr_rpc.sin_port = global_fsal_proxy_specific_info.srv_port;
+  addr_rpc.sin_family = AF_INET;
+  addr_rpc.sin_addr.s_addr = global_fsal_proxy_specific_info.srv_addr;
+
+  if(global_fsal_proxy_specific_info.use_privileged_client_port == TRUE)
+    fd = rresvport(&priv_port);
+  else
+    fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  if(fd < 0)
+    return -1;
+
+  if(connect(fd, (struct sockaddr *)&addr_rpc, sizeof(addr_rpc)) < 0)
+    {
+      close(fd);
+      return -1;
+    }
+
+  /* Small compounds must not wait for each other */
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return fd;
+}                               /* proxy_rpc_connect */
+
+/* Completes a call, must be called with the connection mutex held */
+static void proxy_rpc_complete_locked(proxy_rpc_call_t * pcall, enum clnt_stat stat)
+{
+  pcall->stat = stat;
+  pcall->state = PROXY_RPC_DONE;
+  pthread_cond_signal(&pcall->cond);
+}                               /* proxy_rpc_complete_locked */
+
+/**
+ *
+ * proxy_rpc_conn_down: closes a broken connection and fails its pending calls.
+ *
+ * @param pconn [INOUT] the connection.
+ *
+ */
+static void proxy_rpc_conn_down(proxy_rpc_conn_t * pconn)
+{
+  struct glist_head *glist;
+  struct glist_head *glistn;
+  proxy_rpc_call_t *pcall;
+  unsigned int i;
+
+  P(pconn->send_mutex);
+  P(pconn->mutex);
+
+  if(pconn->fd >= 0)
+    {
+      close(pconn->fd);
+      pconn->fd = -1;
+      pconn->up = FALSE;
+    }
+
+  for(i = 0; i < PROXY_RPC_PENDING_HASH; i++)
+    glist_for_each_safe(glist, glistn, &pconn->pending[i])
+    {
+      pcall = glist_entry(glist, proxy_rpc_call_t, link);
+      glist_del(&pcall->link);
+      proxy_rpc_complete_locked(pcall, RPC_CANTRECV);
+    }
+
+  V(pconn->mutex);
+  V(pconn->send_mutex);
+
+  LogEvent(COMPONENT_FSAL, "Connection #%u to the remote server lost", pconn->index);
+}                               /* proxy_rpc_conn_down */
+
+/**
+ *
+ * proxy_rpc_receive_record: reads one reply and gives it to its caller.
+ *
+ * The reply is read into a buffer of the receiver, that is handed to the
+ * caller with the completion: the caller never sees a buffer being filled.
+ * Only the receiver changes fd, it reads it without the lock.
+ *
+ * @param pconn [INOUT] the connection.
+ *
+ * @return 0 if successful, -1 if the connection is broken.
+ *
+ */
+static int proxy_rpc_receive_record(proxy_rpc_conn_t * pconn)
+{
+  struct glist_head *glist;
+  proxy_rpc_call_t *pcall = NULL;
+  u_int32_t mark;
+  u_int32_t fraglen;
+  u_int32_t xid;
+  u_int32_t len;
+  u_int32_t bufsize = 0;
+  int last;
+  char *buf = NULL;
+  char *newbuf;
+
+  if(proxy_rpc_read_full(pconn->fd, (char *)&mark, sizeof(mark)) != 0)
+    return -1;
+
+  mark = ntohl(mark);
+  fraglen = mark & ~PROXY_RPC_LAST_FRAG;
+  last = (mark & PROXY_RPC_LAST_FRAG) != 0;
+
+  if(fraglen < sizeof(xid))
+    return -1;
+
+  if(proxy_rpc_read_full(pconn->fd, (char *)&xid, sizeof(xid)) != 0)
+    return -1;
+
+  /* Claim the caller, it may not give up its buffers from now on */
+  P(pconn->mutex);
+  glist_for_each(glist, &pconn->pending[ntohl(xid) % PROXY_RPC_PENDING_HASH])
+  {
+    proxy_rpc_call_t *pcur = glist_entry(glist, proxy_rpc_call_t, link);
+
+    if(pcur->xid == ntohl(xid))
+      {
+        pcall = pcur;
+        break;
+      }
+  }
+  if(pcall != NULL)
+    {
+      glist_del(&pcall->link);
+      pcall->state = PROXY_RPC_RECEIVING;
+      bufsize = pcall->recvsize;
+    }
+  V(pconn->mutex);
+
+  if(pcall == NULL)
+    {
+      /* Late reply to a call that timed out */
+      LogDebug(COMPONENT_FSAL, "Reply with unknown xid %u dropped", ntohl(xid));
+
+      if(proxy_rpc_skip(pconn->fd, fraglen - sizeof(xid)) != 0)
+        return -1;
+
+      while(!last)
+        {
+          if(proxy_rpc_read_full(pconn->fd, (char *)&mark, sizeof(mark)) != 0)
+            return -1;
+          mark = ntohl(mark);
+          last = (mark & PROXY_RPC_LAST_FRAG) != 0;
+          if(proxy_rpc_skip(pconn->fd, mark & ~PROXY_RPC_LAST_FRAG) != 0)
+            return -1;
+        }
+
+      return 0;
+    }
+
+  if(bufsize < fraglen)
+    bufsize = fraglen;
+  buf = (char *)Mem_Alloc_Label(bufsize, "proxy_rpc reply");
+  if(buf == NULL)
+    goto fail;
+
+  memcpy(buf, &xid, sizeof(xid));
+  len = sizeof(xid);
+
+  do
+    {
+      if(len + fraglen - sizeof(xid) > bufsize)
+        {
+          /* Bigger than expected, grow the buffer */
+          newbuf = (char *)Mem_Alloc_Label(len + fraglen, "proxy_rpc reply");
+          if(newbuf == NULL)
+            goto fail;
+          memcpy(newbuf, buf, len);
+          Mem_Free(buf);
+          buf = newbuf;
+          bufsize = len + fraglen;
+        }
+
+      if(proxy_rpc_read_full(pconn->fd, buf + len, fraglen - sizeof(xid)) != 0)
+        goto fail;
+      len += fraglen - sizeof(xid);
+
+      if(last)
+        break;
+
+      if(proxy_rpc_read_full(pconn->fd, (char *)&mark, sizeof(mark)) != 0)
+        goto fail;
+      mark = ntohl(mark);
+      last = (mark & PROXY_RPC_LAST_FRAG) != 0;
+
+      /* Later fragments have no xid, account for it */
+      fraglen = (mark & ~PROXY_RPC_LAST_FRAG) + sizeof(xid);
+    }
+  while(1);
+
+  P(pconn->mutex);
+  pcall->recvbuf = buf;
+  pcall->reply_len = len;
+  proxy_rpc_complete_locked(pcall, RPC_SUCCESS);
+  V(pconn->mutex);
+
+  return 0;
+
+ fail:
+  if(buf != NULL)
+    Mem_Free(buf);
+
+  P(pconn->mutex);
+  proxy_rpc_complete_locked(pcall, RPC_CANTRECV);
+  V(pconn->mutex);
+
+  return -1;
+}                               /* proxy_rpc_receive_record */
+
+/**
+ *
+ * proxy_rpc_receiver_thread: keeps a connection up and dispatches its replies.
+ *
+ * @param arg [IN] the connection.
+ *
+ * @return never returns.
+ *
+ */
+static void *proxy_rpc_receiver_thread(void *arg)
+{
+  proxy_rpc_conn_t *pconn = (proxy_rpc_conn_t *) arg;
+  char thrname[MAXNAMLEN];
+  int fd;
+#ifndef _NO_BUDDY_SYSTEM
+  buddy_parameter_t buddy_param = default_buddy_parameter;
+#endif
+
+  snprintf(thrname, MAXNAMLEN, "proxy_rpc_recv#%u", pconn->index);
+  SetNameFunction(thrname);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(&buddy_param) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogCrit(COMPONENT_FSAL,
+              "%s: Memory manager could not be initialized, exiting...", thrname);
+      exit(1);
+    }
+#endif
+
+  while(1)
+    {
+      if((fd = proxy_rpc_connect()) < 0)
+        {
+          LogMajor(COMPONENT_FSAL,
+                   "Connection #%u: cannot connect to the remote server, retrying in %u s",
+                   pconn->index, global_fsal_proxy_specific_info.retry_sleeptime);
+          sleep(global_fsal_proxy_specific_info.retry_sleeptime);
+          continue;
+        }
+
+      P(pconn->send_mutex);
+      P(pconn->mutex);
+      pconn->fd = fd;
+      pconn->up = TRUE;
+      V(pconn->mutex);
+      V(pconn->send_mutex);
+
+      LogDebug(COMPONENT_FSAL, "Connection #%u to the remote server is up", pconn->index);
+
+      while(proxy_rpc_receive_record(pconn) == 0) ;
+
+      proxy_rpc_conn_down(pconn);
+    }
+
+  return NULL;
+}                               /* proxy_rpc_receiver_thread */
+
+/**
+ *
+ * proxy_rpc_init: starts the connection pool.
+ *
+ * The pool is not used with UDP or RPCSEC_GSS, the per context client is
+ * kept then.
+ *
+ * @param fs_init_info [INOUT] the FSAL specific parameters, io_chunk_size is
+ *                            set to what fits in the buffers.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int proxy_rpc_init(proxyfs_specific_initinfo_t * fs_init_info)
+{
+  pthread_attr_t attr_thr;
+  unsigned int i, j;
+  unsigned int chunk_max;
+  int rc;
+
+  /* A chunk and its compound must fit in the send and receive buffers */
+  chunk_max = fs_init_info->srv_sendsize < fs_init_info->srv_recvsize ?
+      fs_init_info->srv_sendsize : fs_init_info->srv_recvsize;
+  chunk_max = chunk_max > 2 * FSAL_PROXY_COMPOUND_OVERHEAD ?
+      chunk_max - FSAL_PROXY_COMPOUND_OVERHEAD : FSAL_PROXY_COMPOUND_OVERHEAD;
+
+  if(fs_init_info->io_chunk_size == 0 || fs_init_info->io_chunk_size > chunk_max)
+    fs_init_info->io_chunk_size = chunk_max;
+
+  if(fs_init_info->nb_connections == 0)
+    return 0;
+
+  if(strcmp(fs_init_info->srv_proto, "tcp"))
+    {
+      LogEvent(COMPONENT_FSAL,
+               "NFS_Proto is %s, Backend_Connections is only used with tcp",
+               fs_init_info->srv_proto);
+      return 0;
+    }
+
+  if(fs_init_info->active_krb5 == TRUE)
+    {
+      LogEvent(COMPONENT_FSAL,
+               "Backend_Connections is not used with RPCSEC_GSS");
+      return 0;
+    }
+
+  if((proxy_rpc_conns = (proxy_rpc_conn_t *)
+      Mem_Alloc_Label(fs_init_info->nb_connections * sizeof(proxy_rpc_conn_t),
+                      "proxy_rpc_conn_t")) == NULL)
+    return -1;
+
+  proxy_rpc_xid = (u_int32_t) time(NULL) ^ (u_int32_t) getpid();
+
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < fs_init_info->nb_connections; i++)
+    {
+      proxy_rpc_conn_t *pconn = &proxy_rpc_conns[i];
+
+      pconn->index = i;
+      pconn->fd = -1;
+      pconn->up = FALSE;
+      pthread_mutex_init(&pconn->send_mutex, NULL);
+      pthread_mutex_init(&pconn->mutex, NULL);
+      for(j = 0; j < PROXY_RPC_PENDING_HASH; j++)
+        init_glist(&pconn->pending[j]);
+
+      if((rc = pthread_create(&pconn->receiver_thrid, &attr_thr,
+                              proxy_rpc_receiver_thread, (void *)pconn)) != 0)
+        {
+          LogError(COMPONENT_FSAL, ERR_SYS, ERR_PTHREAD_CREATE, rc);
+          return -1;
+        }
+    }
+
+  proxy_rpc_nb_conns = fs_init_info->nb_connections;
+
+  LogEvent(COMPONENT_FSAL,
+           "Compounds to the remote server are pipelined on %u connections, READ/WRITE split in chunks of %u bytes",
+           proxy_rpc_nb_conns, fs_init_info->io_chunk_size);
+
+  return 0;
+}                               /* proxy_rpc_init */
+
+/**
+ *
+ * proxy_rpc_compound_start: sends a compound without waiting for its reply.
+ *
+ * The arguments may be released once this returns, the results (and the
+ * buffers they point to) must be kept until proxy_rpc_compound_wait.
+ *
+ * @param p_context [IN] the thread context, it gives the credentials.
+ * @param parg [IN] the compound.
+ * @param pres [OUT] where the reply will be decoded.
+ * @param pcall [OUT] the call, to be given to proxy_rpc_compound_wait.
+ *
+ * @return RPC_SUCCESS if the call was sent, an error otherwise (then
+ *         proxy_rpc_compound_wait must not be called).
+ *
+ */
+enum clnt_stat proxy_rpc_compound_start(proxyfsal_op_context_t * p_context,
+                                        COMPOUND4args * parg,
+                                        COMPOUND4res * pres,
+                                        proxy_rpc_call_t * pcall)
+{
+  proxy_rpc_conn_t *pconn = NULL;
+  struct rpc_msg call_msg;
+  XDR xdrs;
+  u_int proc = NFSPROC4_COMPOUND;
+  u_int32_t mark;
+  u_int32_t len;
+  unsigned int start;
+  unsigned int i;
+  ssize_t rc;
+  char *ptr;
+  int fd;
+
+  memset(pcall, 0, sizeof(proxy_rpc_call_t));
+  pcall->pres = pres;
+
+  /* Pick the next connection that is up, fd itself is read when sending */
+  start = __sync_fetch_and_add(&proxy_rpc_next_conn, 1);
+  for(i = 0; i < proxy_rpc_nb_conns; i++)
+    {
+      pconn = &proxy_rpc_conns[(start + i) % proxy_rpc_nb_conns];
+      if(pconn->up)
+        break;
+    }
+  if(i == proxy_rpc_nb_conns)
+    return RPC_CANTSEND;
+
+  pcall->pconn = pconn;
+  pcall->xid = __sync_add_and_fetch(&proxy_rpc_xid, 1);
+  pthread_cond_init(&pcall->cond, NULL);
+
+  pcall->sendbuf = (char *)Mem_Alloc_Label(p_context->srv_sendsize + sizeof(mark),
+                                          "proxy_rpc call");
+  pcall->recvsize = p_context->srv_recvsize;
+  if(pcall->sendbuf == NULL)
+    goto fail;
+
+  /* Encode the call after room for the record mark */
+  xdrmem_create(&xdrs, pcall->sendbuf + sizeof(mark), p_context->srv_sendsize, XDR_ENCODE);
+
+  memset(&call_msg, 0, sizeof(call_msg));
+  call_msg.rm_xid = pcall->xid;
+  call_msg.rm_direction = CALL;
+  call_msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+  call_msg.rm_call.cb_prog = p_context->srv_prognum;
+  call_msg.rm_call.cb_vers = FSAL_PROXY_NFS_V4;
+
+  if(!xdr_callhdr(&xdrs, &call_msg) ||
+     !xdr_u_int(&xdrs, &proc) ||
+     !AUTH_MARSHALL(p_context->rpc_client->cl_auth, &xdrs) ||
+     !xdr_COMPOUND4args(&xdrs, parg))
+    {
+      LogCrit(COMPONENT_FSAL,
+              "Cannot encode a compound of %u operations in %u bytes (NFS_SendSize)",
+              parg->argarray.argarray_len, p_context->srv_sendsize);
+      XDR_DESTROY(&xdrs);
+      Mem_Free(pcall->sendbuf);
+      pthread_cond_destroy(&pcall->cond);
+      return RPC_CANTENCODEARGS;
+    }
+
+  len = XDR_GETPOS(&xdrs);
+  XDR_DESTROY(&xdrs);
+
+  mark = htonl(PROXY_RPC_LAST_FRAG | len);
+  memcpy(pcall->sendbuf, &mark, sizeof(mark));
+  len += sizeof(mark);
+
+  /* Wait for the reply before it can come */
+  P(pconn->mutex);
+  glist_add_tail(&pconn->pending[pcall->xid % PROXY_RPC_PENDING_HASH], &pcall->link);
+  pcall->state = PROXY_RPC_PENDING;
+  V(pconn->mutex);
+
+  /* The fd cannot change while send_mutex is held */
+  P(pconn->send_mutex);
+  P(pconn->mutex);
+  fd = pconn->fd;
+  V(pconn->mutex);
+
+  ptr = pcall->sendbuf;
+  rc = 0;
+  while(len > 0 && fd >= 0)
+    {
+      rc = send(fd, ptr, len, MSG_NOSIGNAL);
+      if(rc < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          break;
+        }
+      ptr += rc;
+      len -= rc;
+    }
+
+  if(len > 0 && fd >= 0)
+    {
+      /* Let the receiver see the connection is broken */
+      shutdown(fd, SHUT_RDWR);
+    }
+
+  V(pconn->send_mutex);
+
+  /* The arguments are no longer needed */
+  Mem_Free(pcall->sendbuf);
+  pcall->sendbuf = NULL;
+
+  if(len > 0)
+    {
+      P(pconn->mutex);
+      if(pcall->state == PROXY_RPC_PENDING)
+        {
+          glist_del(&pcall->link);
+          pcall->state = PROXY_RPC_DONE;
+          pcall->stat = RPC_CANTSEND;
+        }
+      /* else the connection was shut down meanwhile and failed the call */
+      rc = (pcall->state == PROXY_RPC_DONE);
+      V(pconn->mutex);
+
+      if(rc)
+        {
+          if(pcall->recvbuf != NULL)
+            Mem_Free(pcall->recvbuf);
+          pthread_cond_destroy(&pcall->cond);
+          return RPC_CANTSEND;
+        }
+    }
+
+  return RPC_SUCCESS;
+
+ fail:
+  pthread_cond_destroy(&pcall->cond);
+  return RPC_SYSTEMERROR;
+}                               /* proxy_rpc_compound_start */
+
+/**
+ *
+ * proxy_rpc_compound_wait: waits for the reply of a compound and decodes it.
+ *
+ * @param pcall [INOUT] the call given by proxy_rpc_compound_start.
+ * @param timeout [IN] how long to wait for the reply.
+ *
+ * @return RPC_SUCCESS if the reply is in the results, an error otherwise.
+ *
+ */
+enum clnt_stat proxy_rpc_compound_wait(proxy_rpc_call_t * pcall, struct timeval timeout)
+{
+  proxy_rpc_conn_t *pconn = pcall->pconn;
+  struct timeval now;
+  struct timespec deadline;
+  struct rpc_msg reply_msg;
+  enum clnt_stat stat;
+  XDR xdrs;
+  int rc;
+
+  gettimeofday(&now, NULL);
+  deadline.tv_sec = now.tv_sec + timeout.tv_sec;
+  deadline.tv_nsec = (now.tv_usec + timeout.tv_usec) * 1000;
+  if(deadline.tv_nsec >= 1000000000)
+    {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+  P(pconn->mutex);
+  while(pcall->state != PROXY_RPC_DONE)
+    {
+      if(pcall->state == PROXY_RPC_PENDING)
+        {
+          rc = pthread_cond_timedwait(&pcall->cond, &pconn->mutex, &deadline);
+          if(rc == ETIMEDOUT && pcall->state == PROXY_RPC_PENDING)
+            {
+              glist_del(&pcall->link);
+              pcall->state = PROXY_RPC_DONE;
+              pcall->stat = RPC_TIMEDOUT;
+            }
+        }
+      else
+        {
+          /* The reply is being read, it will be quick */
+          pthread_cond_wait(&pcall->cond, &pconn->mutex);
+        }
+    }
+  V(pconn->mutex);
+
+  stat = pcall->stat;
+
+  if(stat == RPC_SUCCESS)
+    {
+      xdrmem_create(&xdrs, pcall->recvbuf, pcall->reply_len, XDR_DECODE);
+
+      memset(&reply_msg, 0, sizeof(reply_msg));
+      reply_msg.acpted_rply.ar_verf = _null_auth;
+      reply_msg.acpted_rply.ar_results.where = (caddr_t) pcall->pres;
+      reply_msg.acpted_rply.ar_results.proc = (xdrproc_t) xdr_COMPOUND4res;
+
+      if(!xdr_replymsg(&xdrs, &reply_msg))
+        stat = RPC_CANTDECODERES;
+      else if(reply_msg.rm_reply.rp_stat != MSG_ACCEPTED)
+        stat = RPC_AUTHERROR;
+      else
+        switch (reply_msg.acpted_rply.ar_stat)
+          {
+          case SUCCESS:
+            break;
+          case PROG_UNAVAIL:
+            stat = RPC_PROGUNAVAIL;
+            break;
+          case PROG_MISMATCH:
+            stat = RPC_PROGVERSMISMATCH;
+            break;
+          case PROC_UNAVAIL:
+            stat = RPC_PROCUNAVAIL;
+            break;
+          case GARBAGE_ARGS:
+            stat = RPC_CANTDECODEARGS;
+            break;
+          default:
+            stat = RPC_SYSTEMERROR;
+            break;
+          }
+
+      if(reply_msg.rm_reply.rp_stat == MSG_ACCEPTED &&
+         reply_msg.acpted_rply.ar_verf.oa_base != NULL)
+        {
+          xdrs.x_op = XDR_FREE;
+          xdr_opaque_auth(&xdrs, &reply_msg.acpted_rply.ar_verf);
+        }
+
+      XDR_DESTROY(&xdrs);
+    }
+
+  if(pcall->recvbuf != NULL)
+    Mem_Free(pcall->recvbuf);
+  pthread_cond_destroy(&pcall->cond);
+
+  return stat;
+}                               /* proxy_rpc_compound_wait */
+
+/**
+ *
+ * FSAL_proxy_compound: calls a compound on the remote server.
+ *
+ * Goes through the connection pool when it is enabled, through the
+ * context's own client otherwise.
+ *
+ * @param p_context [IN] the thread context.
+ * @param parg [IN] the compound.
+ * @param pres [OUT] the reply.
+ * @param timeout [IN] how long to wait for the reply.
+ *
+ * @return the RPC status.
+ *
+ */
+enum clnt_stat FSAL_proxy_compound(proxyfsal_op_context_t * p_context,
+                                   COMPOUND4args * parg,
+                                   COMPOUND4res * pres, struct timeval timeout)
+{
+  proxy_rpc_call_t call;
+  enum clnt_stat stat;
+
+  if(!proxy_rpc_enabled())
+    return clnt_call(p_context->rpc_client, NFSPROC4_COMPOUND,
+                     (xdrproc_t) xdr_COMPOUND4args, (caddr_t) parg,
+                     (xdrproc_t) xdr_COMPOUND4res, (caddr_t) pres, timeout);
+
+  if((stat = proxy_rpc_compound_start(p_context, parg, pres, &call)) != RPC_SUCCESS)
+    return stat;
+
+  return proxy_rpc_compound_wait(&call, timeout);
+}                               /* FSAL_proxy_compound */
@@ -116,6 +116,8 @@ fsal_status_t PROXYFSAL_rename(fsal_handle_t * old_parent,       /* IN */
   fsal_proxy_internal_fattr_t fattr_internal_old;
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : src/tgt_dir_attributes are optional.
    */
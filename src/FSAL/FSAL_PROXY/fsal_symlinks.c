@@ -269,6 +269,8 @@ fsal_status_t PROXYFSAL_symlink(fsal_handle_t * parent_directory_handle,   /* IN
   char fattr_val[FSAL_SYMLINK_VAL_BUFFER];
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : link_attributes is optional.
    */
@@ -528,6 +528,9 @@ fsal_status_t PROXYFSAL_SetDefault_FS_specific_parameter(fsal_parameter_t * out_
 
   strcpy(init_info->srv_proto, "tcp");
   strncpy(init_info->openfh_wd, "/.hl_dir", MAXPATHLEN);
+  init_info->nb_connections = FSAL_PROXY_NB_CONNECTIONS;
+  init_info->io_chunk_size = 0;    /* Derived from the buffer sizes */
+  init_info->lookup_access = FALSE; /* Set from Use_Test_Access */
 
 #ifdef _HANDLE_MAPPING
   init_info->enable_handle_mapping = FALSE;
@@ -982,6 +985,14 @@ fsal_status_t PROXYFSAL_load_FS_specific_parameter_from_conf(config_file_t in_co
         {
           init_info->retry_sleeptime = (unsigned int)atoi(key_value);
         }
+      else if(!STRCMP(key_name, "Backend_Connections"))
+        {
+          init_info->nb_connections = (unsigned int)atoi(key_value);
+        }
+      else if(!STRCMP(key_name, "Backend_IO_Chunk"))
+        {
+          init_info->io_chunk_size = (unsigned int)atoi(key_value);
+        }
 ///#ifdef _ALLOW_NFS_PROTO_CHOICE
       else if(!STRCMP(key_name, "NFS_Proto"))
         {
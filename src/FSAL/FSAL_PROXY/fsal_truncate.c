@@ -244,6 +244,8 @@ fsal_status_t PROXYFSAL_truncate(fsal_handle_t * file_hdl,       /* IN */
   fsal_proxy_internal_fattr_t fattr_internal;
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : object_attributes is optional.
    */
@@ -92,6 +92,8 @@ fsal_status_t PROXYFSAL_unlink(fsal_handle_t * parentdir_handle,   /* IN */
   fsal_proxy_internal_fattr_t fattr_internal;
   struct timeval timeout = TIMEOUTRPC;
 
+  fsal_internal_proxy_piggyback_invalidate();
+
   /* sanity checks.
    * note : parentdir_attributes are optional.
    *        parentdir_handle is mandatory,
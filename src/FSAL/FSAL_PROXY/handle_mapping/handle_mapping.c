@@ -238,6 +238,51 @@ int handle_mapping_hash_add(hash_table_t * p_hash,
   return HANDLEMAP_SUCCESS;
 }
 
+int handle_mapping_hash_get(hash_table_t * p_hash,
+                            uint64_t object_id,
+                            unsigned int handle_hash, fsal_handle_t * p_handle)
+{
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  digest_pool_entry_t digest;
+
+  digest.nfs23_digest.object_id = object_id;
+  digest.nfs23_digest.handle_hash = handle_hash;
+
+  buffkey.pdata = (caddr_t) & digest;
+  buffkey.len = sizeof(digest_pool_entry_t);
+
+  if(HashTable_Get(p_hash, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+    return HANDLEMAP_STALE;
+
+  *p_handle = ((handle_pool_entry_t *) buffval.pdata)->handle;
+
+  return HANDLEMAP_SUCCESS;
+}
+
+int handle_mapping_hash_del(hash_table_t * p_hash,
+                            uint64_t object_id, unsigned int handle_hash)
+{
+  hash_buffer_t buffkey, stored_buffkey;
+  hash_buffer_t stored_buffval;
+  digest_pool_entry_t digest;
+
+  digest.nfs23_digest.object_id = object_id;
+  digest.nfs23_digest.handle_hash = handle_hash;
+
+  buffkey.pdata = (caddr_t) & digest;
+  buffkey.len = sizeof(digest_pool_entry_t);
+
+  if(HashTable_Del(p_hash, &buffkey, &stored_buffkey, &stored_buffval) !=
+     HASHTABLE_SUCCESS)
+    return HANDLEMAP_STALE;
+
+  digest_free((digest_pool_entry_t *) stored_buffkey.pdata);
+  handle_free((handle_pool_entry_t *) stored_buffval.pdata);
+
+  return HANDLEMAP_SUCCESS;
+}
+
 /**
  * Init handle mapping module.
  * Reloads the content of the mapping files it they exist,
@@ -303,7 +348,7 @@ int HandleMap_Init(const handle_map_param_t * p_param)
 
   if(rc)
     {
-      LogCrit(COMPONENT_FSAL, "ERROR %d reloading handle mapping from database", rc);
+      LogCrit(COMPONENT_FSAL, "ERROR %d reloading handle mapping from logs", rc);
       return rc;
     }
 
@@ -380,36 +425,13 @@ int HandleMap_SetFH(nfs23_map_handle_t * p_in_nfs23_digest, fsal_handle_t * p_in
  */
 int HandleMap_DelFH(nfs23_map_handle_t * p_in_nfs23_digest)
 {
-  int rc;
-  hash_buffer_t buffkey, stored_buffkey;
-  hash_buffer_t stored_buffval;
-
-  digest_pool_entry_t digest;
-
-  digest_pool_entry_t *p_stored_digest;
-  handle_pool_entry_t *p_stored_handle;
-
   /* first, delete it from hash table */
 
-  digest.nfs23_digest = *p_in_nfs23_digest;
-
-  buffkey.pdata = (caddr_t) & digest;
-  buffkey.len = sizeof(digest_pool_entry_t);
-
-  rc = HashTable_Del(handle_map_hash, &buffkey, &stored_buffkey, &stored_buffval);
-
-  if(rc != HASHTABLE_SUCCESS)
-    {
-      return HANDLEMAP_STALE;
-    }
-
-  p_stored_digest = (digest_pool_entry_t *) stored_buffkey.pdata;
-  p_stored_handle = (handle_pool_entry_t *) stored_buffval.pdata;
-
-  digest_free(p_stored_digest);
-  handle_free(p_stored_handle);
+  if(handle_mapping_hash_del(handle_map_hash, p_in_nfs23_digest->object_id,
+                             p_in_nfs23_digest->handle_hash) != HANDLEMAP_SUCCESS)
+    return HANDLEMAP_STALE;
 
-  /* then, submit the request to the database */
+  /* then, append it to the log */
 
   return handlemap_db_delete(p_in_nfs23_digest);
 
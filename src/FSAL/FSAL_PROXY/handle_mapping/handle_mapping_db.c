@@ -1,3 +1,31 @@
+/**
+ * \file handle_mapping_db.c
+ *
+ * \brief  Persistent storage of the handle map, as append-only logs.
+ *
+ * The map is split in HandleMap_DB_Count partitions, one log file each
+ * (handlemap.log.<n>). A log is an array of fixed size records, mapped in
+ * memory: adding or removing a mapping appends one record with a memcpy,
+ * the kernel writes the pages back. The first record of a log is a header
+ * telling the record size, so that a log written by a build with another
+ * fsal_handle_t size is not misread.
+ *
+ * At startup, the partitions are read back in parallel, one thread each,
+ * and replayed into the hash table. A torn record at the end of a log (a
+ * crash during an append) stops the replay and is overwritten by the next
+ * append.
+ *
+ * A log keeps growing with the deleted entries; once more than half of
+ * its records are dead, it is rewritten with only the live entries (at
+ * startup, or by the compaction thread every HANDLEMAP_LOG_COMPACT_PERIOD).
+ *
+ * The content of the former SQLite databases (handlemap.sqlite.<n>) is
+ * imported once, so that clients keep their handles across the upgrade.
+ * The import is complete only once the marker file (handlemap.imported)
+ * exists, it is created after the logs are on disk. Logs found without it
+ * come from an interrupted import, they are emptied and the import starts
+ * over.
+ */
 #include "config.h"
 #include "handle_mapping.h"
 #include "handle_mapping_db.h"
@@ -6,615 +34,496 @@
 #include "stuff_alloc.h"
 #include <sqlite3.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <dirent.h>
 #include <fnmatch.h>
 #include <pthread.h>
 
-/* sqlite check macros */
-
-#define CheckTable( _p_conn_, _code_, _msg_str_, _result_ ) do { \
- if ( (_code_) != SQLITE_OK ) \
-    {                                                                             \
-        LogCrit(COMPONENT_FSAL, "SQLite command failed in %s line %i", __FUNCTION__, __LINE__); \
-        LogCrit(COMPONENT_FSAL, "%s (%d)", (_msg_str_?_msg_str_:sqlite3_errmsg(_p_conn_)), _code_ ); \
-        if (_msg_str_) { sqlite3_free( _msg_str_); _msg_str_ = NULL; }     \
-        if (_result_) { sqlite3_free_table( _result_ ); _result_ = NULL; } \
-        return HANDLEMAP_DB_ERROR;  \
-    } \
-  } while (0)
-
-#define CheckCommand( _p_conn_, _code_, _msg_str_ ) do { \
-  if ( (_code_) != SQLITE_OK ) \
-    {                                                                             \
-        LogCrit(COMPONENT_FSAL, "SQLite command failed in %s line %i", __FUNCTION__, __LINE__); \
-        LogCrit(COMPONENT_FSAL, "%s (%d)", (_msg_str_?_msg_str_:sqlite3_errmsg(_p_conn_)), _code_ ); \
-        if (_msg_str_) {sqlite3_free( _msg_str_); _msg_str_ = NULL ; } \
-        return HANDLEMAP_DB_ERROR;  \
-    } \
-  } while (0)
-
-#define CheckPrepare( _p_conn_, _code_ ) do { \
-  if ( (_code_) != SQLITE_OK)                        \
-    {                                                                             \
-        LogCrit(COMPONENT_FSAL, "SQLite prepare statement failed in %s line %i", __FUNCTION__, __LINE__); \
-        LogCrit(COMPONENT_FSAL, "%s (%d)", sqlite3_errmsg( _p_conn_ ), _code_ ); \
-        return HANDLEMAP_DB_ERROR;  \
-    } \
-  } while (0)
-
-#define CheckBind( _p_conn_, _code_, _stmt_ ) do { \
-  if ( (_code_) != SQLITE_OK)                                                        \
-    {                                                                                \
-        LogCrit(COMPONENT_FSAL, "SQLite parameter binding failed in %s line %i", __FUNCTION__, __LINE__); \
-        LogCrit(COMPONENT_FSAL, "%s (%d)", sqlite3_errmsg( _p_conn_ ), _code_ ); \
-        sqlite3_clear_bindings( _stmt_ ); \
-        return HANDLEMAP_DB_ERROR;  \
-    }  \
-  } while (0)
-
-#define CheckStep( _p_conn_, _code_, _stmt_ ) do { \
-  if ( (_code_) != SQLITE_OK  && (_code_) != SQLITE_ROW && (_code_) != SQLITE_DONE ) \
-    {                                                                                \
-        LogCrit(COMPONENT_FSAL, "SQLite command failed in %s line %i", __FUNCTION__, __LINE__); \
-        LogCrit(COMPONENT_FSAL, "%s (%d)", sqlite3_errmsg( _p_conn_ ), _code_ ); \
-        sqlite3_reset( _stmt_ );    \
-        return HANDLEMAP_DB_ERROR;  \
-    }  \
-  } while (0)
-
-/* Type of DB operations */
-typedef enum
-{
-  LOAD = 1,
-  INSERT,
-  DELETE
-} db_op_type;
-
-/* DB operation arguments */
-typedef struct db_op_item__
-{
-  db_op_type op_type;
-
-  /* operation info */
-
-  union
-  {
-    struct
-    {
-      nfs23_map_handle_t nfs23_digest;
-      fsal_handle_t fsal_handle;
-    } fh_info;
-
-    hash_table_t *hash;
-  } op_arg;
+/* Type of log records */
+#define LOG_OP_HEADER  1
+#define LOG_OP_INSERT  2
+#define LOG_OP_DELETE  3
 
-  /* for chained list */
-  struct db_op_item__ *p_next;
+#define LOG_VERSION    1
 
-} db_op_item_t;
-
-/* the queue for each DB flusher thread */
-typedef struct flusher_queue__
+typedef struct log_record__
 {
-  /* the queue for high priority operations */
-  db_op_item_t *highprio_first;
-  db_op_item_t *highprio_last;
-
-  /* the queue for low priority operations */
-  db_op_item_t *lowprio_first;
-  db_op_item_t *lowprio_last;
-
-  /* number of operations pending */
-  unsigned int nb_waiting;
-
-  pthread_mutex_t queues_mutex;
-
-  pthread_cond_t work_avail_condition;
-  pthread_cond_t work_done_condition;
-
-  /* status (used for work_done_condition) */
-  enum
-  { NOT_READY, IDLE, WORKING, FINISHED } status;
-
-} flusher_queue_t;
-
-#define LOAD_ALL_STATEMENT  0
-#define INSERT_STATEMENT    1
-#define DELETE_STATEMENT    2
-
-#define STATEMENT_COUNT     3
+  uint32_t magic;
+  uint32_t op_type;
+  uint64_t object_id;                          /**< record size in the header */
+  uint32_t handle_hash;                        /**< version in the header     */
+  uint32_t checksum;
+  fsal_handle_t fsal_handle;
+} log_record_t;
 
-/* thread info */
-typedef struct db_thread_info__
+/* one log per partition */
+typedef struct log_partition__
 {
-  pthread_t thr_id;
-  unsigned int thr_index;
-
-  flusher_queue_t work_queue;
+  unsigned int index;
+  char path[MAXPATHLEN + sizeof(LOG_FILE_PREFIX) + 12];   /* <dir>/<prefix>.<n> */
 
-  /* SQLite database connection */
-  sqlite3 *db_conn;
+  int fd;
+  char *map;                                   /**< the whole file, mapped  */
+  size_t map_size;
+  size_t end;                                  /**< where the next record goes */
 
-  /* prepared statement table */
-  sqlite3_stmt *prep_stmt[STATEMENT_COUNT];
+  unsigned int nb_records;                     /**< not counting the header  */
+  unsigned int nb_live;
 
-  /* this pool is accessed by submitter
-   * and by the db thread */
-  pthread_mutex_t pool_mutex;
-  struct prealloc_pool dbop_pool;
+  /* appends and compaction */
+  pthread_mutex_t mutex;
 
-} db_thread_info_t;
+  /* bulk loading at startup */
+  pthread_t loader_thrid;
+  hash_table_t *hash;
+  int load_rc;
+} log_partition_t;
 
 static char dbmap_dir[MAXPATHLEN];
 static char db_tmpdir[MAXPATHLEN];
-static unsigned int nb_db_threads;
+static unsigned int nb_partitions;
 static int synchronous;
 
-/* used for clean shutdown */
-static int do_terminate = FALSE;
-
-/* all information and context for threads */
-static db_thread_info_t db_thread[MAX_DB];
+/* the table the map is loaded to, for compaction */
+static hash_table_t *loaded_hash = NULL;
 
-/* Initialize basic structures for a thread */
-static int init_db_thread_info(db_thread_info_t * p_thr_info,
-                               unsigned int nb_dbop_prealloc)
-{
-  unsigned int i;
+static log_partition_t partitions[MAX_DB];
 
-  if(!p_thr_info)
-    return HANDLEMAP_INTERNAL_ERROR;
+static pthread_t compaction_thrid;
 
-  memset(p_thr_info, 0, sizeof(db_thread_info_t));
-
-  p_thr_info->work_queue.highprio_first = NULL;
-  p_thr_info->work_queue.highprio_last = NULL;
-  p_thr_info->work_queue.lowprio_first = NULL;
-  p_thr_info->work_queue.lowprio_last = NULL;
-
-  p_thr_info->work_queue.nb_waiting = 0;
+/* makes the entries of the map directory durable */
+static int handlemap_sync_dir(void)
+{
+  int fd;
+  int rc;
 
-  if(pthread_mutex_init(&p_thr_info->work_queue.queues_mutex, NULL))
+  fd = open(dbmap_dir, O_RDONLY | O_DIRECTORY);
+  if(fd < 0)
     return HANDLEMAP_SYSTEM_ERROR;
 
-  if(pthread_cond_init(&p_thr_info->work_queue.work_avail_condition, NULL))
-    return HANDLEMAP_SYSTEM_ERROR;
+  rc = fsync(fd);
+  close(fd);
 
-  if(pthread_cond_init(&p_thr_info->work_queue.work_done_condition, NULL))
-    return HANDLEMAP_SYSTEM_ERROR;
+  return (rc == 0) ? HANDLEMAP_SUCCESS : HANDLEMAP_SYSTEM_ERROR;
+}
 
-  /* init thread status */
-  p_thr_info->work_queue.status = NOT_READY;
+/* FNV-1a over the record, checksum excluded */
+static uint32_t log_checksum(log_record_t * p_rec)
+{
+  uint32_t saved = p_rec->checksum;
+  uint32_t hash = 2166136261U;
+  unsigned char *p;
+  size_t i;
 
-  p_thr_info->db_conn = NULL;
+  p_rec->checksum = 0;
 
-  for(i = 0; i < STATEMENT_COUNT; i++)
-    p_thr_info->prep_stmt[i] = NULL;
+  for(p = (unsigned char *)p_rec, i = 0; i < sizeof(log_record_t); i++)
+    hash = (hash ^ p[i]) * 16777619U;
 
-  /* init memory pool */
+  p_rec->checksum = saved;
 
-  if(pthread_mutex_init(&p_thr_info->pool_mutex, NULL))
-    return HANDLEMAP_SYSTEM_ERROR;
+  return hash;
+}
 
-  InitPool(&p_thr_info->dbop_pool, nb_dbop_prealloc, db_op_item_t, NULL, NULL);
+static void log_record_fill(log_record_t * p_rec, uint32_t op_type,
+                            uint64_t object_id, uint32_t handle_hash,
+                            fsal_handle_t * p_handle)
+{
+  memset(p_rec, 0, sizeof(log_record_t));
 
-  return HANDLEMAP_SUCCESS;
+  p_rec->magic = HANDLEMAP_LOG_MAGIC;
+  p_rec->op_type = op_type;
+  p_rec->object_id = object_id;
+  p_rec->handle_hash = handle_hash;
+  if(p_handle != NULL)
+    p_rec->fsal_handle = *p_handle;
+
+  p_rec->checksum = log_checksum(p_rec);
 }
 
-/* Called by a thread to initialize its database access.
- * After this call:
- *  - database connection is established
- *  - schema is created
- *  - prepared statements are ready to be used
- */
-static int init_database_access(db_thread_info_t * p_thr_info)
+/* is this a complete record ? */
+static int log_record_valid(log_record_t * p_rec)
 {
-  char db_file[MAXPATHLEN];
-  int rc;
-  char **result = NULL;
-  int rows, cols;
-  char *errmsg = NULL;
-  const char *unparsed;
+  if(p_rec->magic != HANDLEMAP_LOG_MAGIC)
+    return FALSE;
 
-  /* first open the database file */
+  return p_rec->checksum == log_checksum(p_rec);
+}
 
-  snprintf(db_file, MAXPATHLEN, "%s/%s.%u", dbmap_dir, DB_FILE_PREFIX,
-           p_thr_info->thr_index);
+/* (re)map the log file with the given size, extending it if needed */
+static int log_map(log_partition_t * p_part, size_t size)
+{
+  struct stat st;
+  char *new_map;
 
-  rc = sqlite3_open(db_file, &p_thr_info->db_conn);
+  if(fstat(p_part->fd, &st) != 0)
+    return HANDLEMAP_SYSTEM_ERROR;
 
-  if(rc != 0)
+  if((size_t) st.st_size < size && ftruncate(p_part->fd, size) != 0)
     {
-      if(p_thr_info->db_conn)
-        {
-          LogCrit(COMPONENT_FSAL,
-                  "ERROR: could not connect to SQLite3 database (file %s): %s",
-                  db_file, sqlite3_errmsg(p_thr_info->db_conn));
-          sqlite3_close(p_thr_info->db_conn);
-        }
-      else
-        {
-          LogCrit(COMPONENT_FSAL,
-                  "ERROR: could not connect to SQLite3 database (file %s): status=%d",
-                  db_file, rc);
-        }
-      return HANDLEMAP_DB_ERROR;
+      LogCrit(COMPONENT_FSAL, "ERROR: could not extend handle map log %s: %s",
+              p_part->path, strerror(errno));
+      return HANDLEMAP_SYSTEM_ERROR;
     }
 
-  /* Now check, that the map table exists */
-  rc = sqlite3_get_table(p_thr_info->db_conn,
-                         "SELECT name FROM sqlite_master WHERE type = 'table' AND name = '"
-                         MAP_TABLE "'", &result, &rows, &cols, &errmsg);
-
-  CheckTable(p_thr_info->db_conn, rc, errmsg, result);
+  new_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, p_part->fd, 0);
 
-  /* no need for the result, just the number of rows returned */
-  sqlite3_free_table(result);
-
-  if(rows != 1)
+  if(new_map == MAP_FAILED)
     {
-      /* table must be created */
-      rc = sqlite3_exec(p_thr_info->db_conn,
-                        "CREATE TABLE " MAP_TABLE " ( "
-                        OBJID_FIELD "   BIGINT NOT NULL, "
-                        HASH_FIELD "    INT NOT NULL, "
-                        HANDLE_FIELD "  TEXT, "
-                        "PRIMARY KEY(" OBJID_FIELD ", " HASH_FIELD ") )",
-                        NULL, NULL, &errmsg);
-
-      CheckCommand(p_thr_info->db_conn, rc, errmsg);
-
+      LogCrit(COMPONENT_FSAL, "ERROR: could not map handle map log %s: %s",
+              p_part->path, strerror(errno));
+      return HANDLEMAP_SYSTEM_ERROR;
     }
 
-  /* Now, create prepared statements */
+  if(p_part->map != NULL)
+    munmap(p_part->map, p_part->map_size);
 
-  rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-                          "SELECT " OBJID_FIELD "," HASH_FIELD "," HANDLE_FIELD " FROM "
-                          MAP_TABLE, -1, &(p_thr_info->prep_stmt[LOAD_ALL_STATEMENT]),
-                          &unparsed);
+  p_part->map = new_map;
+  p_part->map_size = size;
 
-  CheckPrepare(p_thr_info->db_conn, rc);
-
-  rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-                          "INSERT INTO " MAP_TABLE "(" OBJID_FIELD "," HASH_FIELD ","
-                          HANDLE_FIELD ") " "VALUES (?1, ?2, ?3 )", -1,
-                          &(p_thr_info->prep_stmt[INSERT_STATEMENT]), &unparsed);
-
-  CheckPrepare(p_thr_info->db_conn, rc);
-
-  rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-                          "DELETE FROM " MAP_TABLE " WHERE " OBJID_FIELD "=?1 AND "
-                          HASH_FIELD "=?2", -1,
-                          &(p_thr_info->prep_stmt[DELETE_STATEMENT]), &unparsed);
-
-  CheckPrepare(p_thr_info->db_conn, rc);
-
-  /* Everything is OK now ! */
   return HANDLEMAP_SUCCESS;
+}
 
-}                               /* init_database_access */
-
-static int db_load_operation(db_thread_info_t * p_info, hash_table_t * p_hash)
+/* open (or create) the log of a partition and check its header */
+static int log_open(log_partition_t * p_part)
 {
-  /* the object id to be inserted to hash table */
-  uint64_t object_id;
-  unsigned int handle_hash;
-  const char *fsal_handle_str;
-  fsal_handle_t fsal_handle;
-  unsigned int nb_loaded = 0;
+  struct stat st;
+  log_record_t *p_header;
+  size_t size;
   int rc;
-  struct timeval t1;
-  struct timeval t2;
-  struct timeval tdiff;
-
-  gettimeofday(&t1, NULL);
 
-  rc = sqlite3_step(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-  CheckStep(p_info->db_conn, rc, p_info->prep_stmt[LOAD_ALL_STATEMENT]);
+  p_part->fd = open(p_part->path, O_RDWR | O_CREAT, 0600);
 
-  /* something to read */
-  while(rc == SQLITE_ROW)
+  if(p_part->fd < 0)
     {
-      object_id = sqlite3_column_int64(p_info->prep_stmt[LOAD_ALL_STATEMENT], 0);
-      handle_hash = sqlite3_column_int(p_info->prep_stmt[LOAD_ALL_STATEMENT], 1);
-      fsal_handle_str = sqlite3_column_text(p_info->prep_stmt[LOAD_ALL_STATEMENT], 2);
-
-      /* convert hexa string representation to binary data */
-      sscanHandle(&fsal_handle, fsal_handle_str);
+      LogCrit(COMPONENT_FSAL, "ERROR: could not open handle map log %s: %s",
+              p_part->path, strerror(errno));
+      return HANDLEMAP_SYSTEM_ERROR;
+    }
 
-      /* now insert it to the hash table */
+  if(fstat(p_part->fd, &st) != 0)
+    return HANDLEMAP_SYSTEM_ERROR;
 
-      rc = handle_mapping_hash_add(p_hash, object_id, handle_hash, &fsal_handle);
+  /* whole records only, a torn tail is replaced by the next append */
+  size = (st.st_size / sizeof(log_record_t)) * sizeof(log_record_t);
+  if(size < HANDLEMAP_LOG_CHUNK)
+    size = HANDLEMAP_LOG_CHUNK;
 
-      if(rc == 0)
-        nb_loaded++;
-      else
-        LogCrit(COMPONENT_FSAL,
-                "ERROR %d adding entry to hash table <object_id=%llu, FH_hash=%u, FSAL_Handle=%s>",
-                rc, (unsigned long long)object_id, handle_hash, fsal_handle_str);
+  if((rc = log_map(p_part, size)))
+    return rc;
 
-      rc = sqlite3_step(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-      CheckStep(p_info->db_conn, rc, p_info->prep_stmt[LOAD_ALL_STATEMENT]);
+  p_header = (log_record_t *) p_part->map;
 
+  if((size_t) st.st_size < sizeof(log_record_t) || p_header->magic == 0)
+    {
+      /* new log, or its creation was interrupted */
+      log_record_fill(p_header, LOG_OP_HEADER, sizeof(log_record_t), LOG_VERSION,
+                      NULL);
+    }
+  else if(!log_record_valid(p_header) || p_header->op_type != LOG_OP_HEADER
+          || p_header->object_id != sizeof(log_record_t)
+          || p_header->handle_hash != LOG_VERSION)
+    {
+      LogCrit(COMPONENT_FSAL,
+              "ERROR: %s is not a handle map log for this build (record size %llu, expected %llu)",
+              p_part->path, (unsigned long long)p_header->object_id,
+              (unsigned long long)sizeof(log_record_t));
+      return HANDLEMAP_DB_ERROR;
     }
 
-  /* clear results */
-  sqlite3_reset(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-
-  /* print time and item count */
-
-  gettimeofday(&t2, NULL);
-  timersub(&t2, &t1, &tdiff);
-
-  LogEvent(COMPONENT_FSAL, "Reloaded %u items in %d.%06ds",
-            nb_loaded, (int)tdiff.tv_sec, (int)tdiff.tv_usec);
+  p_part->end = sizeof(log_record_t);
+  p_part->nb_records = 0;
+  p_part->nb_live = 0;
 
   return HANDLEMAP_SUCCESS;
+}
 
-}                               /* db_load_operation */
+static void log_close(log_partition_t * p_part)
+{
+  if(p_part->map != NULL)
+    munmap(p_part->map, p_part->map_size);
+  p_part->map = NULL;
+  p_part->map_size = 0;
+
+  if(p_part->fd >= 0)
+    close(p_part->fd);
+  p_part->fd = -1;
+}
 
-static int db_insert_operation(db_thread_info_t * p_info,
-                               nfs23_map_handle_t * p_nfs23_digest,
-                               fsal_handle_t * p_handle)
+/* append a record, the partition mutex must be held */
+static int log_append_locked(log_partition_t * p_part, uint32_t op_type,
+                             nfs23_map_handle_t * p_nfs23_digest,
+                             fsal_handle_t * p_handle)
 {
+  log_record_t *p_rec;
+  long pagesize;
+  size_t start;
   int rc;
-  char handle_str[2 * sizeof(fsal_handle_t) + 1];
 
-  rc = sqlite3_bind_int64(p_info->prep_stmt[INSERT_STATEMENT], 1,
-                          p_nfs23_digest->object_id);
-  CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+  if(p_part->end + sizeof(log_record_t) > p_part->map_size)
+    if((rc = log_map(p_part, p_part->map_size + HANDLEMAP_LOG_CHUNK)))
+      return rc;
 
-  rc = sqlite3_bind_int(p_info->prep_stmt[INSERT_STATEMENT], 2,
-                        p_nfs23_digest->handle_hash);
-  CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+  p_rec = (log_record_t *) (p_part->map + p_part->end);
 
-  snprintHandle(handle_str, 2 * sizeof(fsal_handle_t) + 1, p_handle);
+  log_record_fill(p_rec, op_type, p_nfs23_digest->object_id,
+                  p_nfs23_digest->handle_hash, p_handle);
 
-  rc = sqlite3_bind_text(p_info->prep_stmt[INSERT_STATEMENT], 3, handle_str, -1,
-                         SQLITE_STATIC);
-  CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+  if(synchronous)
+    {
+      pagesize = sysconf(_SC_PAGESIZE);
+      start = p_part->end - (p_part->end % pagesize);
 
-  rc = sqlite3_step(p_info->prep_stmt[INSERT_STATEMENT]);
-  CheckStep(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+      if(msync(p_part->map + start, p_part->end + sizeof(log_record_t) - start,
+               MS_SYNC) != 0)
+        return HANDLEMAP_SYSTEM_ERROR;
+    }
 
-  /* clear results */
-  sqlite3_reset(p_info->prep_stmt[INSERT_STATEMENT]);
+  p_part->end += sizeof(log_record_t);
+  p_part->nb_records++;
 
   return HANDLEMAP_SUCCESS;
+}
 
-}                               /* db_insert_operation */
-
-static int db_delete_operation(db_thread_info_t * p_info,
-                               nfs23_map_handle_t * p_nfs23_digest)
+/* is this insert record the current mapping of its digest ? */
+static int log_record_live(hash_table_t * p_hash, log_record_t * p_rec)
 {
-  int rc;
+  fsal_handle_t handle;
 
-  rc = sqlite3_bind_int64(p_info->prep_stmt[DELETE_STATEMENT], 1,
-                          p_nfs23_digest->object_id);
-  CheckBind(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
+  if(handle_mapping_hash_get(p_hash, p_rec->object_id, p_rec->handle_hash,
+                             &handle) != HANDLEMAP_SUCCESS)
+    return FALSE;
 
-  rc = sqlite3_bind_int(p_info->prep_stmt[DELETE_STATEMENT], 2,
-                        p_nfs23_digest->handle_hash);
-  CheckBind(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
-
-  rc = sqlite3_step(p_info->prep_stmt[DELETE_STATEMENT]);
-  CheckStep(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
+  return !memcmp(&handle, &p_rec->fsal_handle, sizeof(fsal_handle_t));
+}
 
-  /* clear results */
-  sqlite3_reset(p_info->prep_stmt[DELETE_STATEMENT]);
+/**
+ * Rewrites a log with only its live records.
+ * The partition mutex must be held.
+ */
+static int log_compact_locked(log_partition_t * p_part)
+{
+  char tmp_path[sizeof(p_part->path) + sizeof(".compact")];
+  log_record_t *p_rec;
+  log_record_t header;
+  unsigned int nb_before = p_part->nb_records;
+  unsigned int nb_kept = 0;
+  size_t off;
+  int fd;
+  int rc;
+  struct timeval t1;
+  struct timeval t2;
+  struct timeval tdiff;
 
-  return HANDLEMAP_SUCCESS;
+  if(loaded_hash == NULL)
+    return HANDLEMAP_SUCCESS;
 
-}                               /* db_delete_operation */
+  gettimeofday(&t1, NULL);
 
-/* push a task to the queue */
-static int dbop_push(flusher_queue_t * p_queue, db_op_item_t * p_op)
-{
-  P(p_queue->queues_mutex);
+  snprintf(tmp_path, sizeof(tmp_path), "%s.compact", p_part->path);
 
-  /* add an item at the end of the queue */
-  switch (p_op->op_type)
+  fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if(fd < 0)
     {
-    case LOAD:
-    case INSERT:
+      LogCrit(COMPONENT_FSAL, "ERROR: could not create %s: %s", tmp_path,
+              strerror(errno));
+      return HANDLEMAP_SYSTEM_ERROR;
+    }
 
-      /* high priority operations */
+  log_record_fill(&header, LOG_OP_HEADER, sizeof(log_record_t), LOG_VERSION, NULL);
+  if(write(fd, &header, sizeof(header)) != sizeof(header))
+    goto error;
 
-      p_op->p_next = NULL;
+  for(off = sizeof(log_record_t); off < p_part->end; off += sizeof(log_record_t))
+    {
+      p_rec = (log_record_t *) (p_part->map + off);
 
-      if(p_queue->highprio_last == NULL)
-        {
-          /* first operation */
-          p_queue->highprio_first = p_op;
-          p_queue->highprio_last = p_op;
-        }
-      else
-        {
-          p_queue->highprio_last->p_next = p_op;
-          p_queue->highprio_last = p_op;
-        }
+      if(p_rec->op_type != LOG_OP_INSERT || !log_record_live(loaded_hash, p_rec))
+        continue;
 
-      p_queue->nb_waiting++;
+      if(write(fd, p_rec, sizeof(log_record_t)) != sizeof(log_record_t))
+        goto error;
 
-      break;
+      nb_kept++;
+    }
 
-    case DELETE:
+  if(fsync(fd) != 0)
+    goto error;
 
-      /* low priority operation */
+  close(fd);
 
-      p_op->p_next = NULL;
+  /* the new log replaces the old one at once */
+  if(rename(tmp_path, p_part->path) != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "ERROR: could not rename %s: %s", tmp_path,
+              strerror(errno));
+      unlink(tmp_path);
+      return HANDLEMAP_SYSTEM_ERROR;
+    }
 
-      if(p_queue->lowprio_last == NULL)
-        {
-          /* first operation */
-          p_queue->lowprio_first = p_op;
-          p_queue->lowprio_last = p_op;
-        }
-      else
-        {
-          p_queue->lowprio_last->p_next = p_op;
-          p_queue->lowprio_last = p_op;
-        }
+  if(handlemap_sync_dir() != HANDLEMAP_SUCCESS)
+    LogWarn(COMPONENT_FSAL, "Could not sync directory %s: %s", dbmap_dir,
+            strerror(errno));
 
-      p_queue->nb_waiting++;
+  log_close(p_part);
 
-      break;
+  if((rc = log_open(p_part)))
+    return rc;
 
-    default:
-      LogCrit(COMPONENT_FSAL,
-              "ERROR in dbop_push: Invalid operation type %d", p_op->op_type);
-    }
+  p_part->end = (nb_kept + 1) * sizeof(log_record_t);
+  p_part->nb_records = nb_kept;
+  p_part->nb_live = nb_kept;
 
-  /* there now some work available */
-  pthread_cond_signal(&p_queue->work_avail_condition);
+  gettimeofday(&t2, NULL);
+  timersub(&t2, &t1, &tdiff);
 
-  V(p_queue->queues_mutex);
+  LogEvent(COMPONENT_FSAL,
+           "Compacted handle map log %s: %u records, %u kept, in %d.%06ds",
+           p_part->path, nb_before, nb_kept, (int)tdiff.tv_sec, (int)tdiff.tv_usec);
 
   return HANDLEMAP_SUCCESS;
 
+ error:
+  LogCrit(COMPONENT_FSAL, "ERROR: could not write %s: %s", tmp_path, strerror(errno));
+  close(fd);
+  unlink(tmp_path);
+  return HANDLEMAP_SYSTEM_ERROR;
 }
 
-static void *database_worker_thread(void *arg)
+/* does the log hold more dead records than live ones ? */
+static int log_needs_compaction(log_partition_t * p_part)
 {
-  db_thread_info_t *p_info = (db_thread_info_t *) arg;
-  int rc;
-  db_op_item_t *to_be_done = NULL;
+  return p_part->nb_records >= HANDLEMAP_LOG_COMPACT_MIN
+      && p_part->nb_live < p_part->nb_records / 2;
+}
+
+/* replays a log into the hash table (one thread per partition) */
+static void *log_loader_thread(void *arg)
+{
+  log_partition_t *p_part = (log_partition_t *) arg;
+  log_record_t *p_rec;
+  unsigned int nb_loaded = 0;
   char thread_name[256];
+  int rc;
+  struct timeval t1;
+  struct timeval t2;
+  struct timeval tdiff;
 
-  /* initialize logging */
-  snprintf(thread_name, 256, "DB thread #%u", p_info->thr_index);
+  snprintf(thread_name, 256, "Handle map loader #%u", p_part->index);
   SetNameFunction(thread_name);
 
-  /* initialize memory management */
-
 #ifndef _NO_BUDDY_SYSTEM
-
+  /* the hash table entries are allocated from here */
   if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
     {
-      /* Failed init */
       LogCrit(COMPONENT_FSAL, "ERROR: Could not initialize memory manager");
-      exit(rc);
+      p_part->load_rc = HANDLEMAP_SYSTEM_ERROR;
+      return NULL;
     }
 #endif
 
-  rc = init_database_access(p_info);
+  gettimeofday(&t1, NULL);
 
-  if(rc != HANDLEMAP_SUCCESS)
+  for(p_part->end = sizeof(log_record_t);
+      p_part->end + sizeof(log_record_t) <= p_part->map_size;
+      p_part->end += sizeof(log_record_t))
     {
-      /* Failed init */
-      LogCrit(COMPONENT_FSAL, "ERROR: Database initialization error %d", rc);
-      exit(rc);
-    }
+      p_rec = (log_record_t *) (p_part->map + p_part->end);
 
-  /* main loop */
-  while(1)
-    {
+      /* end of the log, or a record torn by a crash */
+      if(!log_record_valid(p_rec))
+        break;
 
-      /* Is "work done" or "work available" condition verified ? */
+      p_part->nb_records++;
 
-      P(p_info->work_queue.queues_mutex);
+      if(p_part->hash == NULL)
+        continue;
 
-      /* nothing to be done ? */
-      while(p_info->work_queue.highprio_first == NULL
-            && p_info->work_queue.lowprio_first == NULL)
+      switch (p_rec->op_type)
         {
-          to_be_done = NULL;
-          p_info->work_queue.status = IDLE;
-          pthread_cond_signal(&p_info->work_queue.work_done_condition);
-
-          /* if termination is requested, exit */
-          if(do_terminate)
+        case LOG_OP_INSERT:
+          rc = handle_mapping_hash_add(p_part->hash, p_rec->object_id,
+                                       p_rec->handle_hash, &p_rec->fsal_handle);
+          if(rc == HANDLEMAP_SUCCESS)
             {
-              p_info->work_queue.status = FINISHED;
-              V(p_info->work_queue.queues_mutex);
-              return (void *)p_info;
+              nb_loaded++;
+              p_part->nb_live++;
             }
+          else if(rc != HANDLEMAP_EXISTS)
+            LogCrit(COMPONENT_FSAL,
+                    "ERROR %d adding entry to hash table <object_id=%llu, FH_hash=%u>",
+                    rc, (unsigned long long)p_rec->object_id, p_rec->handle_hash);
+          break;
 
-          /* else, wait for something to do */
-          pthread_cond_wait(&p_info->work_queue.work_avail_condition,
-                            &p_info->work_queue.queues_mutex);
+        case LOG_OP_DELETE:
+          if(handle_mapping_hash_del(p_part->hash, p_rec->object_id,
+                                     p_rec->handle_hash) == HANDLEMAP_SUCCESS)
+            {
+              nb_loaded--;
+              p_part->nb_live--;
+            }
+          break;
 
+        default:
+          LogCrit(COMPONENT_FSAL, "ERROR: Invalid record type %u in %s",
+                  p_rec->op_type, p_part->path);
         }
+    }
 
-      /* there is something to do : first check the highest priority list,
-       * then the lower priority.
-       */
+  gettimeofday(&t2, NULL);
+  timersub(&t2, &t1, &tdiff);
 
-      if(p_info->work_queue.highprio_first != NULL)
-        {
-          /* take the next item in the list */
-          to_be_done = p_info->work_queue.highprio_first;
-          p_info->work_queue.highprio_first = to_be_done->p_next;
-
-          /* still any entries in the list ? */
-          if(p_info->work_queue.highprio_first == NULL)
-            p_info->work_queue.highprio_last = NULL;
-          /* it it the last entry ? */
-          else if(p_info->work_queue.highprio_first->p_next == NULL)
-            p_info->work_queue.highprio_last = p_info->work_queue.highprio_first;
-
-          /* something to do */
-          p_info->work_queue.status = WORKING;
-        }
-      else if(p_info->work_queue.lowprio_first != NULL)
-        {
-          /* take the next item in the list */
-          to_be_done = p_info->work_queue.lowprio_first;
-          p_info->work_queue.lowprio_first = to_be_done->p_next;
-
-          /* still any entries in the list ? */
-          if(p_info->work_queue.lowprio_first == NULL)
-            p_info->work_queue.lowprio_last = NULL;
-          /* it it the last entry ? */
-          else if(p_info->work_queue.lowprio_first->p_next == NULL)
-            p_info->work_queue.lowprio_last = p_info->work_queue.lowprio_first;
-
-          /* something to do */
-          p_info->work_queue.status = WORKING;
-        }
+  LogEvent(COMPONENT_FSAL, "Reloaded %u items from %s in %d.%06ds",
+           nb_loaded, p_part->path, (int)tdiff.tv_sec, (int)tdiff.tv_usec);
 
-      p_info->work_queue.nb_waiting--;
+  p_part->load_rc = HANDLEMAP_SUCCESS;
 
-      V(p_info->work_queue.queues_mutex);
+  return NULL;
+}
 
-      /* PROCESS THE REQUEST */
+/* rewrites the logs that are mostly dead, in the background */
+static void *log_compaction_thread(void *arg)
+{
+  unsigned int i;
+  int rc;
 
-      switch (to_be_done->op_type)
-        {
-        case LOAD:
-          db_load_operation(p_info, to_be_done->op_arg.hash);
-          break;
+  SetNameFunction("Handle map compaction");
 
-        case INSERT:
-          db_insert_operation(p_info, &to_be_done->op_arg.fh_info.nfs23_digest,
-                              &to_be_done->op_arg.fh_info.fsal_handle);
-          break;
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
+    {
+      LogCrit(COMPONENT_FSAL, "ERROR: Could not initialize memory manager");
+      return NULL;
+    }
+#endif
 
-        case DELETE:
-          db_delete_operation(p_info, &to_be_done->op_arg.fh_info.nfs23_digest);
-          break;
+  while(1)
+    {
+      sleep(HANDLEMAP_LOG_COMPACT_PERIOD);
 
-        default:
-          LogCrit(COMPONENT_FSAL, "ERROR: Invalid operation type %d",
-                  to_be_done->op_type);
-        }
+      for(i = 0; i < nb_partitions; i++)
+        {
+          P(partitions[i].mutex);
 
-      /* free the db operation item */
-      P(p_info->pool_mutex);
-      ReleaseToPool(to_be_done, &p_info->dbop_pool);
-      V(p_info->pool_mutex);
+          if(log_needs_compaction(&partitions[i]))
+            log_compact_locked(&partitions[i]);
 
-    }                           /* loop forever */
+          V(partitions[i].mutex);
+        }
+    }
 
-  return (void *)p_info;
+  return NULL;
 }
 
 /**
- * count the number of database instances in a given directory
- * (this is used for checking that the number of db
- * matches the number of threads)
+ * count the number of log partitions in a given directory
+ * (this is used for checking that the number of logs
+ * matches the configured count)
  */
-int handlemap_db_count(const char *dir)
+static int handlemap_count_files(const char *dir, const char *prefix)
 {
   DIR *dir_hdl;
   struct dirent direntry;
@@ -625,7 +534,7 @@ int handlemap_db_count(const char *dir)
   unsigned int count = 0;
   int end_of_dir = FALSE;
 
-  snprintf(db_pattern, MAXPATHLEN, "%s.*[0-9]", DB_FILE_PREFIX);
+  snprintf(db_pattern, MAXPATHLEN, "%s.*[0-9]", prefix);
 
   dir_hdl = opendir(dir);
 
@@ -646,7 +555,7 @@ int handlemap_db_count(const char *dir)
           if(!strcmp(".", direntry.d_name) || !strcmp("..", direntry.d_name))
             continue;
 
-          /* does it match the expected db pattern ? */
+          /* does it match the expected pattern ? */
           if(!fnmatch(db_pattern, direntry.d_name, FNM_PATHNAME))
             count++;
 
@@ -678,30 +587,118 @@ int handlemap_db_count(const char *dir)
 
   return count;
 
-}                               /* handlemap_db_count */
+}                               /* handlemap_count_files */
+
+int handlemap_db_count(const char *dir)
+{
+  return handlemap_count_files(dir, LOG_FILE_PREFIX);
+}
 
 unsigned int select_db_queue(const nfs23_map_handle_t * p_nfs23_digest)
 {
   unsigned int h =
       ((p_nfs23_digest->object_id * 1049) ^ p_nfs23_digest->handle_hash) % 2477;
 
-  h = h % nb_db_threads;
+  h = h % nb_partitions;
 
   return h;
 }
 
+/* imports one of the former SQLite databases into the logs */
+static int handlemap_import_sqlite(const char *db_file)
+{
+  sqlite3 *db_conn = NULL;
+  sqlite3_stmt *stmt = NULL;
+  const char *unparsed;
+  nfs23_map_handle_t nfs23_digest;
+  fsal_handle_t fsal_handle;
+  log_partition_t *p_part;
+  unsigned int nb_imported = 0;
+  int rc;
+
+  if(sqlite3_open(db_file, &db_conn) != SQLITE_OK)
+    {
+      LogCrit(COMPONENT_FSAL, "ERROR: could not open SQLite3 database %s", db_file);
+      if(db_conn)
+        sqlite3_close(db_conn);
+      return HANDLEMAP_DB_ERROR;
+    }
+
+  rc = sqlite3_prepare_v2(db_conn,
+                          "SELECT " OBJID_FIELD "," HASH_FIELD "," HANDLE_FIELD " FROM "
+                          MAP_TABLE, -1, &stmt, &unparsed);
+
+  if(rc != SQLITE_OK)
+    {
+      /* no table, nothing to import */
+      sqlite3_close(db_conn);
+      return HANDLEMAP_SUCCESS;
+    }
+
+  while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+      nfs23_digest.object_id = sqlite3_column_int64(stmt, 0);
+      nfs23_digest.handle_hash = sqlite3_column_int(stmt, 1);
+      sscanHandle(&fsal_handle, (const char *)sqlite3_column_text(stmt, 2));
+
+      p_part = &partitions[select_db_queue(&nfs23_digest)];
+
+      if(log_append_locked(p_part, LOG_OP_INSERT, &nfs23_digest, &fsal_handle))
+        break;
+
+      nb_imported++;
+    }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db_conn);
+
+  LogEvent(COMPONENT_FSAL, "Imported %u items from %s", nb_imported, db_file);
+
+  return (rc == SQLITE_DONE) ? HANDLEMAP_SUCCESS : HANDLEMAP_DB_ERROR;
+}
+
+/* the logs are on disk, the import is done */
+static int handlemap_import_commit(const char *marker_path)
+{
+  unsigned int i;
+  int fd;
+
+  for(i = 0; i < nb_partitions; i++)
+    if(msync(partitions[i].map, partitions[i].end, MS_SYNC) != 0)
+      {
+        LogCrit(COMPONENT_FSAL, "ERROR: could not sync %s: %s", partitions[i].path,
+                strerror(errno));
+        return HANDLEMAP_SYSTEM_ERROR;
+      }
+
+  fd = open(marker_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if(fd < 0 || fsync(fd) != 0)
+    {
+      LogCrit(COMPONENT_FSAL, "ERROR: could not create %s: %s", marker_path,
+              strerror(errno));
+      if(fd >= 0)
+        close(fd);
+      return HANDLEMAP_SYSTEM_ERROR;
+    }
+  close(fd);
+
+  return handlemap_sync_dir();
+}
+
 /**
  * Initialize databases access
- * - init DB queues
- * - start threads
- * - establish DB connections
- * - create db schema if it was empty
+ * - open (or create) the log of each partition
+ * - import the former SQLite databases if it was not done yet
  */
 int handlemap_db_init(const char *db_dir,
                       const char *tmp_dir,
                       unsigned int db_count,
                       unsigned int nb_dbop_prealloc, int synchronous_insert)
 {
+  char db_file[MAXPATHLEN + sizeof(DB_FILE_PREFIX) + 12];
+  char marker_path[MAXPATHLEN + sizeof(IMPORT_DONE_FILE) + 1];
+  int import_done;
+  int import;
   unsigned int i;
   int rc;
 
@@ -710,185 +707,161 @@ int handlemap_db_init(const char *db_dir,
   strncpy(dbmap_dir, db_dir, MAXPATHLEN);
   strncpy(db_tmpdir, tmp_dir, MAXPATHLEN);
 
-  if(db_count > MAX_DB)
+  if(db_count == 0 || db_count > MAX_DB)
     return HANDLEMAP_INVALID_PARAM;
 
-  nb_db_threads = db_count;
+  nb_partitions = db_count;
   synchronous = synchronous_insert;
-  /* set global database engine info */
 
+  /* only used by the SQLite import */
   sqlite3_temp_directory = db_tmpdir;
 
-  /* initialize structures for each thread and launch it */
+  snprintf(marker_path, sizeof(marker_path), "%s/%s", dbmap_dir, IMPORT_DONE_FILE);
+  import_done = (access(marker_path, F_OK) == 0);
+  import = !import_done && (handlemap_count_files(dbmap_dir, DB_FILE_PREFIX) > 0);
 
-  for(i = 0; i < nb_db_threads; i++)
-    {
-      /** @todo ici coller  out_parameter->fs_specific_info.hdlmap_nb_db_op_prealloc */
-      rc = init_db_thread_info(&db_thread[i], 100);
-      if(rc)
-        return rc;
+  if(import && handlemap_count_files(dbmap_dir, LOG_FILE_PREFIX) > 0)
+    LogEvent(COMPONENT_FSAL,
+             "The import of the SQLite handle maps was interrupted, starting it over");
 
-      db_thread[i].thr_index = i;
+  for(i = 0; i < nb_partitions; i++)
+    {
+      memset(&partitions[i], 0, sizeof(log_partition_t));
+      partitions[i].index = i;
+      partitions[i].fd = -1;
+      snprintf(partitions[i].path, sizeof(partitions[i].path), "%s/%s.%u", dbmap_dir,
+               LOG_FILE_PREFIX, i);
 
-      rc = pthread_create(&db_thread[i].thr_id, NULL, database_worker_thread,
-                          &db_thread[i]);
-      if(rc)
+      if(pthread_mutex_init(&partitions[i].mutex, NULL))
         return HANDLEMAP_SYSTEM_ERROR;
-    }
 
-  /* I'm ready to serve, my Lord ! */
-  return HANDLEMAP_SUCCESS;
-}
+      /* what a former import left is imported again */
+      if(import && unlink(partitions[i].path) != 0 && errno != ENOENT)
+        {
+          LogCrit(COMPONENT_FSAL, "ERROR: could not remove %s: %s",
+                  partitions[i].path, strerror(errno));
+          return HANDLEMAP_SYSTEM_ERROR;
+        }
 
-/* wait that a thread has done all its jobs */
-static void wait_thread_jobs_finished(db_thread_info_t * p_thr_info)
-{
+      if((rc = log_open(&partitions[i])))
+        return rc;
+    }
 
-  P(p_thr_info->work_queue.queues_mutex);
+  if(import)
+    {
+      /* first start with logs: keep the handles given by the SQLite maps */
+      for(i = 0; i < MAX_DB; i++)
+        {
+          snprintf(db_file, sizeof(db_file), "%s/%s.%u", dbmap_dir, DB_FILE_PREFIX, i);
 
-  /* wait until the thread has no more tasks in its queue
-   * and it is no more working
-   */
-  while(p_thr_info->work_queue.highprio_first != NULL
-        || p_thr_info->work_queue.lowprio_first != NULL
-        || p_thr_info->work_queue.status == WORKING)
-    pthread_cond_wait(&p_thr_info->work_queue.work_done_condition,
-                      &p_thr_info->work_queue.queues_mutex);
+          if(access(db_file, R_OK) != 0)
+            continue;
 
-  V(p_thr_info->work_queue.queues_mutex);
+          if((rc = handlemap_import_sqlite(db_file)))
+            return rc;
+        }
+    }
+
+  if(!import_done && (rc = handlemap_import_commit(marker_path)))
+    return rc;
 
+  /* I'm ready to serve, my Lord ! */
+  return HANDLEMAP_SUCCESS;
 }
 
 /**
- * Gives the order to each DB thread to reload
- * the content of its database and insert it
- * to the hash table.
- * The function blocks until all threads have loaded their data.
+ * Replays all the logs into the hash table,
+ * one thread per partition.
+ * The function blocks until all partitions are loaded.
  */
 int handlemap_db_reaload_all(hash_table_t * target_hash)
 {
+  pthread_attr_t attr_thr;
   unsigned int i;
-  db_op_item_t *new_task;
   int rc;
 
-  /* give the job to all threads */
-  for(i = 0; i < nb_db_threads; i++)
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_JOINABLE);
+
+  for(i = 0; i < nb_partitions; i++)
     {
-      /* get a new db operation  */
-      P(db_thread[i].pool_mutex);
+      partitions[i].hash = target_hash;
+      partitions[i].load_rc = HANDLEMAP_INTERNAL_ERROR;
+      partitions[i].nb_records = 0;
+      partitions[i].nb_live = 0;
 
-      GetFromPool(new_task, &db_thread[i].dbop_pool, db_op_item_t);
+      if(pthread_create(&partitions[i].loader_thrid, &attr_thr, log_loader_thread,
+                        &partitions[i]))
+        return HANDLEMAP_SYSTEM_ERROR;
+    }
 
-      V(db_thread[i].pool_mutex);
+  for(i = 0; i < nb_partitions; i++)
+    {
+      pthread_join(partitions[i].loader_thrid, NULL);
 
-      if(!new_task)
-        return HANDLEMAP_SYSTEM_ERROR;
+      if(partitions[i].load_rc != HANDLEMAP_SUCCESS)
+        return partitions[i].load_rc;
+    }
 
-      /* can you fill it ? */
-      new_task->op_type = LOAD;
-      new_task->op_arg.hash = target_hash;
+  if(target_hash == NULL)
+    return HANDLEMAP_SUCCESS;
 
-      rc = dbop_push(&db_thread[i].work_queue, new_task);
+  loaded_hash = target_hash;
 
-      if(rc)
-        return rc;
-    }
+  for(i = 0; i < nb_partitions; i++)
+    if(log_needs_compaction(&partitions[i]) && (rc = log_compact_locked(&partitions[i])))
+      return rc;
 
-  /* wait for all threads to finish their job */
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
 
-  for(i = 0; i < nb_db_threads; i++)
-    {
-      wait_thread_jobs_finished(&db_thread[i]);
-    }
+  if(pthread_create(&compaction_thrid, &attr_thr, log_compaction_thread, NULL))
+    return HANDLEMAP_SYSTEM_ERROR;
 
   return HANDLEMAP_SUCCESS;
 
 }                               /* handlemap_db_reaload_all */
 
 /**
- * Submit a db 'insert' request.
- * The request is inserted in the appropriate db queue.
+ * Appends an 'insert' record to the log of the digest's partition.
  */
 int handlemap_db_insert(nfs23_map_handle_t * p_in_nfs23_digest,
                         fsal_handle_t * p_in_handle)
 {
-  unsigned int i;
-  db_op_item_t *new_task;
+  log_partition_t *p_part = &partitions[select_db_queue(p_in_nfs23_digest)];
   int rc;
 
-  if(!synchronous)
-    {
-      /* which thread is going to handle this inode ? */
-
-      i = select_db_queue(p_in_nfs23_digest);
-
-      /* get a new db operation  */
-      P(db_thread[i].pool_mutex);
+  P(p_part->mutex);
 
-      GetFromPool(new_task, &db_thread[i].dbop_pool, db_op_item_t);
+  if((rc = log_append_locked(p_part, LOG_OP_INSERT, p_in_nfs23_digest, p_in_handle))
+     == HANDLEMAP_SUCCESS)
+    p_part->nb_live++;
 
-      V(db_thread[i].pool_mutex);
-
-      if(!new_task)
-        return HANDLEMAP_SYSTEM_ERROR;
-
-      /* fill the task info */
-      new_task->op_type = INSERT;
-      new_task->op_arg.fh_info.nfs23_digest = *p_in_nfs23_digest;
-      new_task->op_arg.fh_info.fsal_handle = *p_in_handle;
-
-      rc = dbop_push(&db_thread[i].work_queue, new_task);
-
-      if(rc)
-        return rc;
-    }
-  /* else: @todo not supported yet */
-
-  return HANDLEMAP_SUCCESS;
+  V(p_part->mutex);
 
+  return rc;
 }
 
 /**
- * Submit a db 'delete' request.
- * The request is inserted in the appropriate db queue.
- * (always asynchronous)
+ * Appends a 'delete' record to the log of the digest's partition.
  */
 int handlemap_db_delete(nfs23_map_handle_t * p_in_nfs23_digest)
 {
-  unsigned int i;
-  db_op_item_t *new_task;
+  log_partition_t *p_part = &partitions[select_db_queue(p_in_nfs23_digest)];
   int rc;
 
-  /* which thread is going to handle this inode ? */
-
-  i = select_db_queue(p_in_nfs23_digest);
-
-  /* get a new db operation  */
-  P(db_thread[i].pool_mutex);
-
-  GetFromPool(new_task, &db_thread[i].dbop_pool, db_op_item_t);
-
-  V(db_thread[i].pool_mutex);
+  P(p_part->mutex);
 
-  if(!new_task)
-    return HANDLEMAP_SYSTEM_ERROR;
-
-  /* fill the task info */
-  new_task->op_type = DELETE;
-  new_task->op_arg.fh_info.nfs23_digest = *p_in_nfs23_digest;
+  if((rc = log_append_locked(p_part, LOG_OP_DELETE, p_in_nfs23_digest, NULL))
+     == HANDLEMAP_SUCCESS && p_part->nb_live > 0)
+    p_part->nb_live--;
 
-  rc = dbop_push(&db_thread[i].work_queue, new_task);
-
-  if(rc)
-    return rc;
-
-  return HANDLEMAP_SUCCESS;
+  V(p_part->mutex);
 
+  return rc;
 }
 
 /**
- * Wait for all queues to be empty
- * and all current DB request to be done.
+ * Write the logs to disk.
  */
 int handlemap_db_flush()
 {
@@ -896,33 +869,31 @@ int handlemap_db_flush()
   struct timeval t1;
   struct timeval t2;
   struct timeval tdiff;
-  unsigned int to_sync = 0;
-
-  for(i = 0; i < nb_db_threads; i++)
-    {
-      to_sync += db_thread[i].work_queue.nb_waiting;
-    }
-
-  LogEvent(COMPONENT_FSAL,
-           "Waiting for database synchronization (%u operations pending)",
-           to_sync);
+  int rc = HANDLEMAP_SUCCESS;
 
   gettimeofday(&t1, NULL);
 
-  /* wait for all threads to finish their job */
-
-  for(i = 0; i < nb_db_threads; i++)
+  for(i = 0; i < nb_partitions; i++)
     {
-      wait_thread_jobs_finished(&db_thread[i]);
+      P(partitions[i].mutex);
+
+      if(msync(partitions[i].map, partitions[i].end, MS_SYNC) != 0)
+        {
+          LogCrit(COMPONENT_FSAL, "ERROR: could not sync %s: %s", partitions[i].path,
+                  strerror(errno));
+          rc = HANDLEMAP_SYSTEM_ERROR;
+        }
+
+      V(partitions[i].mutex);
     }
 
   gettimeofday(&t2, NULL);
 
   timersub(&t2, &t1, &tdiff);
 
-  LogEvent(COMPONENT_FSAL, "Database synchronized in %d.%06ds",
+  LogEvent(COMPONENT_FSAL, "Handle map logs synchronized in %d.%06ds",
            (int)tdiff.tv_sec, (int)tdiff.tv_usec);
 
-  return HANDLEMAP_SUCCESS;
+  return rc;
 
 }
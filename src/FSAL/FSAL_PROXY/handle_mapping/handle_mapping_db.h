@@ -4,8 +4,25 @@
 #include "handle_mapping.h"
 #include "HashTable.h"
 
+#define LOG_FILE_PREFIX "handlemap.log"
+
+/* former SQLite databases, imported at the first start with logs */
 #define DB_FILE_PREFIX "handlemap.sqlite"
 
+/* created once the SQLite databases are imported (or found absent) */
+#define IMPORT_DONE_FILE "handlemap.imported"
+
+#define HANDLEMAP_LOG_MAGIC 0x484d4c47   /* "HMLG" */
+
+/* logs are extended (and remapped) by this many bytes */
+#define HANDLEMAP_LOG_CHUNK (4 * 1024 * 1024)
+
+/* a log is compacted when it has this many records and less than half are live */
+#define HANDLEMAP_LOG_COMPACT_MIN 4096
+
+/* seconds between two checks of the compaction thread */
+#define HANDLEMAP_LOG_COMPACT_PERIOD 300
+
 /* Database definition */
 #define MAP_TABLE      "HandleMap"
 #define OBJID_FIELD    "ObjectId"
@@ -15,16 +32,16 @@
 #define MAX_DB  32
 
 /**
- * count the number of database instances in a given directory
- * (this is used for checking that the number of db
- * matches the number of threads)
+ * count the number of log partitions in a given directory
+ * (this is used for checking that the number of logs
+ * matches the configured count)
  */
 int handlemap_db_count(const char *dir);
 
 /**
  * Initialize databases access
- * (init DB queues, start threads, establish DB connections,
- * and create db schema if it was empty).
+ * (open or create the logs, and import the former
+ * SQLite databases if there was no log yet).
  */
 int handlemap_db_init(const char *db_dir,
                       const char *tmp_dir,
@@ -32,30 +49,27 @@ int handlemap_db_init(const char *db_dir,
                       unsigned int nb_dbop_prealloc, int synchronous_insert);
 
 /**
- * Gives the order to each DB thread to reload
- * the content of its database and insert it
- * to the hash table.
- * The function blocks until all threads have loaded their data.
+ * Replays all the logs into the hash table, one thread
+ * per partition, then starts the compaction thread.
+ * The function blocks until all partitions are loaded.
  */
 int handlemap_db_reaload_all(hash_table_t * target_hash);
 
 /**
- * Submit a db 'insert' request.
- * The request is inserted in the appropriate db queue.
+ * Appends an 'insert' record to the log
+ * of the digest's partition.
  */
 int handlemap_db_insert(nfs23_map_handle_t * p_in_nfs23_digest,
                         fsal_handle_t * p_in_handle);
 
 /**
- * Submit a db 'delete' request.
- * The request is inserted in the appropriate db queue.
- * (always asynchronous)
+ * Appends a 'delete' record to the log
+ * of the digest's partition.
  */
 int handlemap_db_delete(nfs23_map_handle_t * p_in_nfs23_digest);
 
 /**
- * Wait for all queues to be empty
- * and all current DB request to be done.
+ * Write the logs to disk.
  */
 int handlemap_db_flush();
 
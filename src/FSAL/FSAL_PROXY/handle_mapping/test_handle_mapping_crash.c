@@ -0,0 +1,334 @@
+/*
+ * Crash and replay tests of the handle map logs (handle_mapping_db.c).
+ *
+ * Each start of the server is a child process: it loads the map, checks
+ * what it finds, changes the map and dies without flushing anything, as a
+ * crash would (the records are in the shared mapping of the log, so they
+ * reach the file anyway). Between two starts, the parent damages the log
+ * the way a crash at a bad time would have.
+ *
+ * usage: test_handle_mapping_crash [<db_dir>]
+ * (a new directory under /tmp is used if none is given)
+ */
+#include "config.h"
+#include "handle_mapping.h"
+#include "handle_mapping_db.h"
+#include "stuff_alloc.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if ((a) != (b)) {                         \
+      LogTest(msg, ## args);                          \
+      _exit(1);                                    \
+    }                                             \
+} while(0)
+
+#define NB_FIRST   100
+#define NB_CHURN   (HANDLEMAP_LOG_COMPACT_MIN + 1000)
+#define NB_KEPT    10
+#define CHURN_BASE 100000
+
+static char *dir;
+
+/* one partition, so that the last record of the log is known */
+static void start(void)
+{
+  handle_map_param_t param;
+  int rc;
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
+    {
+      LogTest("ERROR: Could not initialize memory manager");
+      _exit(1);
+    }
+#endif
+
+  strcpy(param.databases_directory, dir);
+  strcpy(param.temp_directory, "/tmp");
+  param.database_count = 1;
+  param.hashtable_size = 27;
+  param.nb_handles_prealloc = 1024;
+  param.nb_db_op_prealloc = 1024;
+  param.synchronous_insert = FALSE;
+
+  rc = HandleMap_Init(&param);
+  EQUALS(rc, HANDLEMAP_SUCCESS, "HandleMap_Init() = %d", rc);
+}
+
+static void digest_of(unsigned int i, nfs23_map_handle_t * p_digest)
+{
+  p_digest->object_id = 12345 + i;
+  p_digest->handle_hash = (1999 * i) % 479001599;
+}
+
+static void set_fh(unsigned int i)
+{
+  nfs23_map_handle_t digest;
+  fsal_handle_t handle;
+  int rc;
+
+  digest_of(i, &digest);
+  memset(&handle, i & 0xFF, sizeof(fsal_handle_t));
+
+  rc = HandleMap_SetFH(&digest, &handle);
+  EQUALS(rc, HANDLEMAP_SUCCESS, "HandleMap_SetFH(%u) = %d", i, rc);
+}
+
+static void del_fh(unsigned int i)
+{
+  nfs23_map_handle_t digest;
+  int rc;
+
+  digest_of(i, &digest);
+
+  rc = HandleMap_DelFH(&digest);
+  EQUALS(rc, HANDLEMAP_SUCCESS, "HandleMap_DelFH(%u) = %d", i, rc);
+}
+
+static void check_fh(unsigned int i, int present)
+{
+  nfs23_map_handle_t digest;
+  fsal_handle_t handle, expected;
+  int rc;
+
+  digest_of(i, &digest);
+  memset(&expected, i & 0xFF, sizeof(fsal_handle_t));
+
+  rc = HandleMap_GetFH(&digest, &handle);
+
+  if(!present)
+    {
+      EQUALS(rc, HANDLEMAP_STALE, "Handle %u should be gone, HandleMap_GetFH() = %d", i,
+             rc);
+      return;
+    }
+
+  EQUALS(rc, HANDLEMAP_SUCCESS, "Handle %u was lost, HandleMap_GetFH() = %d", i, rc);
+  EQUALS(memcmp(&handle, &expected, sizeof(fsal_handle_t)), 0,
+         "Handle %u was reloaded with another content", i);
+}
+
+/* runs one start of the server, the function is the life of the process */
+static void run(const char *name, void (*life) (void))
+{
+  pid_t pid;
+  int status;
+
+  pid = fork();
+  EQUALS((pid >= 0), 1, "fork: %s", strerror(errno));
+
+  if(pid == 0)
+    {
+      start();
+      life();
+      /* crash: no flush, no cleanup */
+      _exit(0);
+    }
+
+  waitpid(pid, &status, 0);
+  EQUALS((WIFEXITED(status) && WEXITSTATUS(status) == 0), 1, "%s failed", name);
+
+  LogTest("%s: OK", name);
+}
+
+static void log_path(char *path, size_t size)
+{
+  snprintf(path, size, "%s/%s.0", dir, LOG_FILE_PREFIX);
+}
+
+/*
+ * Number of valid records of the log, header apart,
+ * and offset of the last one.
+ * A record starts with its magic number, the header tells the record size.
+ */
+static unsigned int log_scan(size_t * p_last)
+{
+  char path[MAXPATHLEN];
+  unsigned char *buf;
+  uint64_t rec_size;
+  uint32_t magic;
+  unsigned int nb = 0;
+  size_t off;
+  ssize_t len;
+  int fd;
+
+  log_path(path, sizeof(path));
+
+  fd = open(path, O_RDONLY);
+  EQUALS((fd >= 0), 1, "open %s: %s", path, strerror(errno));
+
+  EQUALS(pread(fd, &rec_size, sizeof(rec_size), 8), sizeof(rec_size),
+         "can't read the header of %s", path);
+
+  buf = malloc(rec_size);
+
+  for(off = rec_size;; off += rec_size)
+    {
+      len = pread(fd, buf, rec_size, off);
+      if(len != rec_size)
+        break;
+
+      memcpy(&magic, buf, sizeof(magic));
+      if(magic != HANDLEMAP_LOG_MAGIC)
+        break;
+
+      *p_last = off;
+      nb++;
+    }
+
+  free(buf);
+  close(fd);
+
+  return nb;
+}
+
+/* the last record was only partly written when the server died */
+static void tear_last_record(void)
+{
+  char path[MAXPATHLEN];
+  char garbage[8];
+  size_t last = 0;
+  int fd;
+
+  EQUALS(log_scan(&last), NB_FIRST, "the log should hold %u records", NB_FIRST);
+
+  log_path(path, sizeof(path));
+  memset(garbage, 0x5A, sizeof(garbage));
+
+  fd = open(path, O_WRONLY);
+  EQUALS(pwrite(fd, garbage, sizeof(garbage), last + 24), sizeof(garbage),
+         "can't tear the last record of %s", path);
+  close(fd);
+}
+
+/* a compaction died after writing its new log, before renaming it */
+static void leave_compact_file(void)
+{
+  char path[MAXPATHLEN];
+  char garbage[100];
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/%s.0.compact", dir, LOG_FILE_PREFIX);
+  memset(garbage, 0xA5, sizeof(garbage));
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  EQUALS(write(fd, garbage, sizeof(garbage)), sizeof(garbage), "can't write %s", path);
+  close(fd);
+}
+
+static void first_life(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < NB_FIRST; i++)
+    set_fh(i);
+}
+
+/* the torn record is lost, the others are back, the next append replaces it */
+static void after_tear(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < NB_FIRST - 1; i++)
+    check_fh(i, TRUE);
+  check_fh(NB_FIRST - 1, FALSE);
+
+  set_fh(NB_FIRST);
+}
+
+static void check_first(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < NB_FIRST - 1; i++)
+    check_fh(i, TRUE);
+  check_fh(NB_FIRST - 1, FALSE);
+  check_fh(NB_FIRST, TRUE);
+}
+
+/* most of the records die, the log needs compaction at the next start */
+static void churn(void)
+{
+  unsigned int i;
+
+  check_first();
+
+  for(i = 0; i < NB_CHURN; i++)
+    set_fh(CHURN_BASE + i);
+
+  for(i = NB_KEPT; i < NB_CHURN; i++)
+    del_fh(CHURN_BASE + i);
+}
+
+static void check_compacted(void)
+{
+  unsigned int i;
+
+  check_first();
+
+  for(i = 0; i < NB_CHURN; i++)
+    check_fh(CHURN_BASE + i, i < NB_KEPT);
+}
+
+int main(int argc, char **argv)
+{
+  char tmpl[] = "/tmp/handlemap_crash.XXXXXX";
+  char path[MAXPATHLEN];
+  size_t last;
+
+  SetNamePgm("test_handle_mapping_crash");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  SetNameHost("localhost");
+  InitLogging();
+
+  if(argc > 2)
+    {
+      LogTest("usage: test_handle_mapping_crash [<db_dir>]");
+      exit(1);
+    }
+
+  if(argc == 2)
+    dir = argv[1];
+  else if((dir = mkdtemp(tmpl)) == NULL)
+    {
+      LogTest("mkdtemp: %s", strerror(errno));
+      exit(1);
+    }
+
+  /* a torn record at the tail of the log */
+  run("first start", first_life);
+  tear_last_record();
+  run("start after a torn record", after_tear);
+  run("start after the torn record was replaced", check_first);
+
+  /* compaction at startup, over the leftover of a former one */
+  run("start with dead records", churn);
+  leave_compact_file();
+  run("start with a compaction left unfinished", check_compacted);
+
+  EQUALS(log_scan(&last), NB_FIRST + NB_KEPT,
+         "the compacted log should hold %u records", NB_FIRST + NB_KEPT);
+  snprintf(path, sizeof(path), "%s/%s.0.compact", dir, LOG_FILE_PREFIX);
+  EQUALS(access(path, F_OK), -1, "%s should have been renamed", path);
+
+  /* the renamed log is replayed as it is */
+  run("start after the compaction", check_compacted);
+
+  if(argc == 1)
+    {
+      log_path(path, sizeof(path));
+      unlink(path);
+      snprintf(path, sizeof(path), "%s/%s", dir, IMPORT_DONE_FILE);
+      unlink(path);
+      rmdir(dir);
+    }
+
+  LogTest("ALL HANDLE MAP CRASH TESTS COMPLETED SUCCESSFULLY!!");
+  exit(0);
+}
@@ -0,0 +1,609 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ *
+ * \file    fsal_async.c
+ * \brief   Asynchronous read/write through io_uring.
+ *
+ * One ring is shared by all the workers. A worker fills a submission entry
+ * and hands it to the kernel, a reaper thread gets the completions and calls
+ * the callbacks. The number of IOs in flight is bounded by the ring depth
+ * (Async_IO_Depth), not by Max_FS_calls. cache_inode_rdwr waits for the
+ * completion of its IO, so there are at most as many IOs in flight as there
+ * are workers doing READ or WRITE.
+ *
+ * The descriptors opened by FSAL_open are registered to the ring, in the
+ * slot of the same number, so that the kernel does not look them up at
+ * each IO. Descriptors above Async_IO_Files, or whose registration failed,
+ * are used unregistered.
+ *
+ * The ring is driven through the raw system calls, there is no dependency
+ * on liburing.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fsal.h"
+#include "fsal_internal.h"
+#include "fsal_convert.h"
+
+#ifdef _USE_IO_URING
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "SemN.h"
+#include "stuff_alloc.h"
+
+/* One IO in flight, the kernel gives back its address as user_data */
+typedef struct vfsfsal_async_io__
+{
+  struct vfsfsal_async_io__ *next_free;
+  fsal_io_callback_t callback;
+  void *cb_arg;
+  int is_read;
+  struct iovec iov;
+} vfsfsal_async_io_t;
+
+typedef struct vfsfsal_ring__
+{
+  int ring_fd;
+  unsigned int nb_entries;
+
+  /* Submission queue, protected by sq_mutex */
+  pthread_mutex_t sq_mutex;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  struct io_uring_sqe *sqes;
+  vfsfsal_async_io_t *free_ios;
+
+  /* Completion queue, only read by the reaper */
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  /* One token per free submission entry */
+  semaphore_t sem_slots;
+
+  /* Registered descriptors, protected by files_mutex */
+  pthread_mutex_t files_mutex;
+  unsigned int nb_files;
+  char *files_registered;       /* TRUE if slot fd holds fd */
+
+  void *sq_ptr;
+  size_t sq_size;
+  void *cq_ptr;
+  size_t cq_size;
+  size_t sqes_size;
+  vfsfsal_async_io_t *ios;
+} vfsfsal_ring_t;
+
+static vfsfsal_ring_t vfs_ring;
+static int vfs_ring_ready = FALSE;
+static pthread_t vfs_ring_reaper_thrid;
+
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                              unsigned int flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg,
+                                 unsigned int nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * vfsfsal_async_reaper: gets the completions and calls the callbacks.
+ */
+static void *vfsfsal_async_reaper(void *arg)
+{
+  vfsfsal_ring_t *pring = (vfsfsal_ring_t *) arg;
+  vfsfsal_async_io_t *pio;
+  fsal_io_callback_t callback;
+  void *cb_arg;
+  fsal_status_t status;
+  fsal_boolean_t end_of_file;
+  unsigned int head, tail;
+  int res, rc;
+
+  SetNameFunction("vfs_aio_reaper");
+
+  while(1)
+    {
+      rc = sys_io_uring_enter(pring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+      if(rc < 0 && errno != EINTR)
+        {
+          LogCrit(COMPONENT_FSAL,
+                  "io_uring_enter failed, error %d (%s)", errno, strerror(errno));
+          sleep(1);
+          continue;
+        }
+
+      head = *pring->cq_head;
+      tail = __atomic_load_n(pring->cq_tail, __ATOMIC_ACQUIRE);
+
+      while(head != tail)
+        {
+          struct io_uring_cqe *pcqe = &pring->cqes[head & *pring->cq_mask];
+
+          pio = (vfsfsal_async_io_t *) (uintptr_t) pcqe->user_data;
+          res = pcqe->res;
+          head++;
+
+          /* Give the cqe back before the callback, which may take long */
+          __atomic_store_n(pring->cq_head, head, __ATOMIC_RELEASE);
+
+          callback = pio->callback;
+          cb_arg = pio->cb_arg;
+          end_of_file = FALSE;
+
+          if(res < 0)
+            {
+              status.major = posix2fsal_error(-res);
+              status.minor = -res;
+              res = 0;
+            }
+          else
+            {
+              status.major = ERR_FSAL_NO_ERROR;
+              status.minor = 0;
+              if(pio->is_read && res == 0)
+                end_of_file = TRUE;
+            }
+
+          P(pring->sq_mutex);
+          pio->next_free = pring->free_ios;
+          pring->free_ios = pio;
+          V(pring->sq_mutex);
+          semaphore_V(&pring->sem_slots);
+
+          callback(cb_arg, status, (fsal_size_t) res, end_of_file);
+        }
+    }
+
+  return NULL;
+}                               /* vfsfsal_async_reaper */
+
+/**
+ * vfsfsal_async_init: sets up the ring and starts the reaper.
+ *
+ * A ring that cannot be set up is not fatal, IOs are then done
+ * synchronously.
+ */
+fsal_status_t vfsfsal_async_init(vfsfs_specific_initinfo_t * p_init_info)
+{
+  vfsfsal_ring_t *pring = &vfs_ring;
+  struct io_uring_params params;
+  pthread_attr_t attr;
+  int *fds;
+  unsigned int i;
+  int rc;
+
+  if(p_init_info->async_io_depth == 0)
+    {
+      LogDebug(COMPONENT_FSAL, "FSAL INIT: Asynchronous IO is disabled.");
+      ReturnCode(ERR_FSAL_NO_ERROR, 0);
+    }
+
+  memset(pring, 0, sizeof(vfsfsal_ring_t));
+  memset(&params, 0, sizeof(params));
+
+  pring->ring_fd = sys_io_uring_setup(p_init_info->async_io_depth, &params);
+  if(pring->ring_fd < 0)
+    {
+      LogEvent(COMPONENT_FSAL,
+               "FSAL INIT: io_uring is not available (error %d, %s), IOs will be synchronous.",
+               errno, strerror(errno));
+      ReturnCode(ERR_FSAL_NO_ERROR, 0);
+    }
+
+  pring->nb_entries = params.sq_entries;
+
+  pring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  pring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if(pring->cq_size > pring->sq_size)
+        pring->sq_size = pring->cq_size;
+      pring->cq_size = pring->sq_size;
+    }
+
+  pring->sq_ptr = mmap(NULL, pring->sq_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, pring->ring_fd, IORING_OFF_SQ_RING);
+  if(pring->sq_ptr == MAP_FAILED)
+    goto err_close;
+
+  if(params.features & IORING_FEAT_SINGLE_MMAP)
+    pring->cq_ptr = pring->sq_ptr;
+  else
+    {
+      pring->cq_ptr = mmap(NULL, pring->cq_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, pring->ring_fd, IORING_OFF_CQ_RING);
+      if(pring->cq_ptr == MAP_FAILED)
+        goto err_unmap_sq;
+    }
+
+  pring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  pring->sqes = mmap(NULL, pring->sqes_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, pring->ring_fd, IORING_OFF_SQES);
+  if(pring->sqes == MAP_FAILED)
+    goto err_unmap_cq;
+
+  pring->sq_head = (unsigned int *)((char *)pring->sq_ptr + params.sq_off.head);
+  pring->sq_tail = (unsigned int *)((char *)pring->sq_ptr + params.sq_off.tail);
+  pring->sq_mask = (unsigned int *)((char *)pring->sq_ptr + params.sq_off.ring_mask);
+  pring->sq_array = (unsigned int *)((char *)pring->sq_ptr + params.sq_off.array);
+  pring->cq_head = (unsigned int *)((char *)pring->cq_ptr + params.cq_off.head);
+  pring->cq_tail = (unsigned int *)((char *)pring->cq_ptr + params.cq_off.tail);
+  pring->cq_mask = (unsigned int *)((char *)pring->cq_ptr + params.cq_off.ring_mask);
+  pring->cqes = (struct io_uring_cqe *)((char *)pring->cq_ptr + params.cq_off.cqes);
+
+  pring->ios = (vfsfsal_async_io_t *) Mem_Alloc_Label(pring->nb_entries *
+                                                      sizeof(vfsfsal_async_io_t),
+                                                      "vfsfsal_async_io_t");
+  if(pring->ios == NULL)
+    goto err_unmap_sqes;
+
+  for(i = 0; i < pring->nb_entries; i++)
+    {
+      pring->ios[i].next_free = pring->free_ios;
+      pring->free_ios = &pring->ios[i];
+    }
+
+  pthread_mutex_init(&pring->sq_mutex, NULL);
+  pthread_mutex_init(&pring->files_mutex, NULL);
+
+  if((rc = semaphore_init(&pring->sem_slots, pring->nb_entries)) != 0)
+    {
+      Mem_Free(pring->ios);
+      goto err_unmap_sqes;
+    }
+
+  /* Register an empty descriptor table, FSAL_open fills it */
+  if(p_init_info->async_io_files > 0)
+    {
+      fds = (int *)Mem_Alloc_Label(p_init_info->async_io_files * sizeof(int),
+                                   "io_uring fds");
+      pring->files_registered = (char *)Mem_Alloc_Label(p_init_info->async_io_files,
+                                                        "io_uring registered fds");
+      if(fds != NULL && pring->files_registered != NULL)
+        {
+          for(i = 0; i < p_init_info->async_io_files; i++)
+            fds[i] = -1;
+          memset(pring->files_registered, FALSE, p_init_info->async_io_files);
+
+          if(sys_io_uring_register(pring->ring_fd, IORING_REGISTER_FILES, fds,
+                                   p_init_info->async_io_files) == 0)
+            pring->nb_files = p_init_info->async_io_files;
+          else
+            LogEvent(COMPONENT_FSAL,
+                     "FSAL INIT: Could not register descriptors to io_uring (error %d, %s)",
+                     errno, strerror(errno));
+        }
+      if(fds != NULL)
+        Mem_Free(fds);
+      if(pring->nb_files == 0 && pring->files_registered != NULL)
+        {
+          Mem_Free(pring->files_registered);
+          pring->files_registered = NULL;
+        }
+    }
+
+  pthread_attr_init(&attr);
+  pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  if((rc = pthread_create(&vfs_ring_reaper_thrid, &attr, vfsfsal_async_reaper, pring)) != 0)
+    {
+      LogCrit(COMPONENT_FSAL,
+              "FSAL INIT: Could not create the io_uring reaper thread, error %d (%s)",
+              rc, strerror(rc));
+      ReturnCode(ERR_FSAL_SERVERFAULT, rc);
+    }
+
+  vfs_ring_ready = TRUE;
+
+  LogEvent(COMPONENT_FSAL,
+           "FSAL INIT: Asynchronous IO through io_uring, %u entries, %u registered descriptors.",
+           pring->nb_entries, pring->nb_files);
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+
+ err_unmap_sqes:
+  munmap(pring->sqes, pring->sqes_size);
+ err_unmap_cq:
+  if(pring->cq_ptr != pring->sq_ptr)
+    munmap(pring->cq_ptr, pring->cq_size);
+ err_unmap_sq:
+  munmap(pring->sq_ptr, pring->sq_size);
+ err_close:
+  LogEvent(COMPONENT_FSAL,
+           "FSAL INIT: Could not map the io_uring queues, IOs will be synchronous.");
+  close(pring->ring_fd);
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}                               /* vfsfsal_async_init */
+
+/**
+ * vfsfsal_async_update_fd: sets the registered slot of a descriptor.
+ */
+static void vfsfsal_async_update_fd(int slot, int fd)
+{
+  struct io_uring_files_update update;
+
+  memset(&update, 0, sizeof(update));
+  update.offset = slot;
+  update.fds = (uintptr_t) & fd;
+
+  P(vfs_ring.files_mutex);
+
+  /* Unregistered first, so that no IO uses the slot while it changes */
+  vfs_ring.files_registered[slot] = FALSE;
+
+  if(sys_io_uring_register(vfs_ring.ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0)
+    LogDebug(COMPONENT_FSAL,
+             "Could not update io_uring descriptor slot %d, error %d (%s)",
+             slot, errno, strerror(errno));
+  else if(fd >= 0)
+    vfs_ring.files_registered[slot] = TRUE;
+
+  V(vfs_ring.files_mutex);
+}                               /* vfsfsal_async_update_fd */
+
+/**
+ * vfsfsal_async_register_fd: called by FSAL_open on a new descriptor.
+ */
+void vfsfsal_async_register_fd(int fd)
+{
+  if(!vfs_ring_ready || fd < 0 || (unsigned int)fd >= vfs_ring.nb_files)
+    return;
+
+  vfsfsal_async_update_fd(fd, fd);
+}                               /* vfsfsal_async_register_fd */
+
+/**
+ * vfsfsal_async_unregister_fd: called by FSAL_close before it closes the descriptor.
+ */
+void vfsfsal_async_unregister_fd(int fd)
+{
+  if(!vfs_ring_ready || fd < 0 || (unsigned int)fd >= vfs_ring.nb_files)
+    return;
+
+  vfsfsal_async_update_fd(fd, -1);
+}                               /* vfsfsal_async_unregister_fd */
+
+/**
+ * vfsfsal_async_submit: queues one IO to the ring.
+ *
+ * Blocks while the ring is full.
+ */
+static int vfsfsal_async_submit(int fd, int is_read, off_t offset, caddr_t buffer,
+                                size_t size, fsal_io_callback_t callback, void *cb_arg)
+{
+  vfsfsal_ring_t *pring = &vfs_ring;
+  vfsfsal_async_io_t *pio;
+  struct io_uring_sqe *psqe;
+  unsigned int tail, index;
+  int fixed_file = FALSE;
+  int rc;
+
+  semaphore_P(&pring->sem_slots);
+
+  P(pring->sq_mutex);
+
+  /* The slot must not change before the kernel took the entry, the
+   * descriptor is looked up when the entry is submitted */
+  if((unsigned int)fd < pring->nb_files)
+    {
+      P(pring->files_mutex);
+      fixed_file = pring->files_registered[fd];
+    }
+
+  /* There is a free entry for each token */
+  pio = pring->free_ios;
+  pring->free_ios = pio->next_free;
+
+  pio->callback = callback;
+  pio->cb_arg = cb_arg;
+  pio->is_read = is_read;
+  pio->iov.iov_base = buffer;
+  pio->iov.iov_len = size;
+
+  tail = *pring->sq_tail;
+  index = tail & *pring->sq_mask;
+  psqe = &pring->sqes[index];
+
+  memset(psqe, 0, sizeof(struct io_uring_sqe));
+  psqe->opcode = is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+  psqe->off = offset;
+  psqe->addr = (uintptr_t) & pio->iov;
+  psqe->len = 1;
+  psqe->user_data = (uintptr_t) pio;
+  psqe->fd = fd;
+
+  /* The slot is only used if the descriptor really is in it, the IOs on a
+   * descriptor are over before FSAL_close unregisters it */
+  if(fixed_file)
+    psqe->flags |= IOSQE_FIXED_FILE;
+
+  pring->sq_array[index] = index;
+  __atomic_store_n(pring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  do
+    rc = sys_io_uring_enter(pring->ring_fd, 1, 0, 0);
+  while(rc < 0 && errno == EINTR);
+
+  if((unsigned int)fd < pring->nb_files)
+    V(pring->files_mutex);
+
+  if(rc < 0)
+    {
+      rc = errno;
+
+      /* The entry was not consumed, take it back */
+      __atomic_store_n(pring->sq_tail, tail, __ATOMIC_RELEASE);
+      pio->next_free = pring->free_ios;
+      pring->free_ios = pio;
+      V(pring->sq_mutex);
+      semaphore_V(&pring->sem_slots);
+
+      return rc;
+    }
+
+  V(pring->sq_mutex);
+
+  return 0;
+}                               /* vfsfsal_async_submit */
+
+/**
+ * FSAL_read_async:
+ * Submit a read on an opened file, callback is called when it is done.
+ *
+ * \param file_descriptor (input):
+ *        The file descriptor returned by FSAL_open.
+ * \param seek_descriptor (input):
+ *        Specifies the position where data is to be read.
+ * \param buffer_size (input):
+ *        Amount (in bytes) of data to be read.
+ * \param buffer (output):
+ *        Address where the read data is to be stored in memory.
+ *        It must stay valid until callback is called.
+ * \param callback (input):
+ *        Called with the outcome of the read.
+ * \param cb_arg (input):
+ *        Given back to callback.
+ *
+ * \return Major error codes:
+ *      - ERR_FSAL_NO_ERROR: the read is submitted.
+ *      - Another error code if the read could not be submitted.
+ */
+fsal_status_t VFSFSAL_read_async(fsal_file_t * file_desc,       /* IN */
+                                 fsal_seek_t * p_seek_descriptor,       /* IN */
+                                 fsal_size_t buffer_size,       /* IN */
+                                 caddr_t buffer,        /* OUT */
+                                 fsal_io_callback_t callback,   /* IN */
+                                 void *cb_arg /* IN */ )
+{
+  vfsfsal_file_t *p_file_descriptor = (vfsfsal_file_t *) file_desc;
+  fsal_status_t status;
+  fsal_size_t read_amount = 0;
+  fsal_boolean_t end_of_file = FALSE;
+  int rc;
+
+  /* sanity checks. */
+  if(!p_file_descriptor || !buffer || !callback)
+    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_read);
+
+  if(!vfs_ring_ready || !p_seek_descriptor || p_seek_descriptor->whence != FSAL_SEEK_SET)
+    {
+      status = VFSFSAL_read(file_desc, p_seek_descriptor, buffer_size, buffer,
+                            &read_amount, &end_of_file);
+      callback(cb_arg, status, read_amount, end_of_file);
+      Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_read);
+    }
+
+  rc = vfsfsal_async_submit(p_file_descriptor->fd, TRUE, p_seek_descriptor->offset,
+                            buffer, (size_t) buffer_size, callback, cb_arg);
+  if(rc != 0)
+    Return(posix2fsal_error(rc), rc, INDEX_FSAL_read);
+
+  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_read);
+}                               /* VFSFSAL_read_async */
+
+/**
+ * FSAL_write_async:
+ * Submit a write on an opened file, callback is called when it is done.
+ *
+ * \param file_descriptor (input):
+ *        The file descriptor returned by FSAL_open.
+ * \param seek_descriptor (input):
+ *        Specifies the position where data is to be written.
+ * \param buffer_size (input):
+ *        Amount (in bytes) of data to be written.
+ * \param buffer (input):
+ *        Address in memory of the data to write to file.
+ *        It must stay valid until callback is called.
+ * \param callback (input):
+ *        Called with the outcome of the write.
+ * \param cb_arg (input):
+ *        Given back to callback.
+ *
+ * \return Major error codes:
+ *      - ERR_FSAL_NO_ERROR: the write is submitted.
+ *      - Another error code if the write could not be submitted.
+ */
+fsal_status_t VFSFSAL_write_async(fsal_file_t * file_desc,      /* IN */
+                                  fsal_seek_t * p_seek_descriptor,      /* IN */
+                                  fsal_size_t buffer_size,      /* IN */
+                                  caddr_t buffer,       /* IN */
+                                  fsal_io_callback_t callback,  /* IN */
+                                  void *cb_arg /* IN */ )
+{
+  vfsfsal_file_t *p_file_descriptor = (vfsfsal_file_t *) file_desc;
+  fsal_status_t status;
+  fsal_size_t write_amount = 0;
+  int rc;
+
+  /* sanity checks. */
+  if(!p_file_descriptor || !buffer || !callback)
+    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_write);
+
+  if(p_file_descriptor->ro)
+    Return(ERR_FSAL_PERM, 0, INDEX_FSAL_write);
+
+  if(!vfs_ring_ready || !p_seek_descriptor || p_seek_descriptor->whence != FSAL_SEEK_SET)
+    {
+      status = VFSFSAL_write(file_desc, p_seek_descriptor, buffer_size, buffer,
+                             &write_amount);
+      callback(cb_arg, status, write_amount, FALSE);
+      Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_write);
+    }
+
+  rc = vfsfsal_async_submit(p_file_descriptor->fd, FALSE, p_seek_descriptor->offset,
+                            buffer, (size_t) buffer_size, callback, cb_arg);
+  if(rc != 0)
+    Return(posix2fsal_error(rc), rc, INDEX_FSAL_write);
+
+  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_write);
+}                               /* VFSFSAL_write_async */
+
+#endif                          /* _USE_IO_URING */
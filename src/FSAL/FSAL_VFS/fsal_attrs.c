@@ -193,7 +193,6 @@ fsal_status_t VFSFSAL_setattrs(fsal_handle_t * p_filehandle,       /* IN */
 {
   vfsfsal_op_context_t * vfs_context = (vfsfsal_op_context_t *) p_context;
   int rc, errsv;
-  unsigned int i;
   fsal_status_t status;
   fsal_attrib_list_t attrs;
 
@@ -336,14 +335,7 @@ fsal_status_t VFSFSAL_setattrs(fsal_handle_t * p_filehandle,       /* IN */
 
       int in_grp = 0;
       /* set in_grp */
-      if(vfs_context->credential.group == attrs.group)
-        in_grp = 1;
-      else
-        for(i = 0; i < vfs_context->credential.nbgroups; i++)
-          {
-            if((in_grp = (attrs.group == vfs_context->credential.alt_groups[i])))
-              break;
-          }
+      in_grp = fsal_is_group_member(p_context, attrs.group);
 
       /* it must also be in target group */
       if(vfs_context->credential.user != 0 && !in_grp)
@@ -37,6 +37,10 @@ fsal_functions_t fsal_vfs_functions = {
   .fsal_read = VFSFSAL_read,
   .fsal_write = VFSFSAL_write,
   .fsal_sync = VFSFSAL_sync,
+#ifdef _USE_IO_URING
+  .fsal_read_async = VFSFSAL_read_async,
+  .fsal_write_async = VFSFSAL_write_async,
+#endif
   .fsal_close = VFSFSAL_close,
   .fsal_open_by_fileid = COMMON_open_by_fileid,
   .fsal_close_by_fileid = COMMON_close_by_fileid,
@@ -90,7 +94,12 @@ fsal_functions_t fsal_vfs_functions = {
   .fsal_removexattrbyid = VFSFSAL_RemoveXAttrById,
   .fsal_removexattrbyname = VFSFSAL_RemoveXAttrByName,
   .fsal_getextattrs = COMMON_getextattrs_notsupp,
-  .fsal_getfileno = VFSFSAL_GetFileno
+  .fsal_getfileno = VFSFSAL_GetFileno,
+#ifdef _USE_FSAL_UP
+  .fsal_up_init = VFSFSAL_UP_Init,
+  .fsal_up_addfilter = VFSFSAL_UP_AddFilter,
+  .fsal_up_getevents = VFSFSAL_UP_GetEvents
+#endif /* _USE_FSAL_UP */
 };
 
 fsal_const_t fsal_vfs_consts = {
@@ -192,6 +192,9 @@ fsal_status_t VFSFSAL_InitClientContext(fsal_op_context_t * p_context)
   /* initialy set the export entry to none */
   p_thr_context->export_context = NULL;
 
+  /* no group list is held yet */
+  p_thr_context->credential.grouplist = NULL;
+
   Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_InitClientContext);
 
 }
@@ -241,6 +244,9 @@ fsal_status_t VFSFSAL_GetClientContext(fsal_op_context_t * thr_context,    /* IN
   p_thr_context->credential.user = uid;
   p_thr_context->credential.group = gid;
 
+  /* the caller that holds a group list for the user sets it */
+  p_thr_context->credential.grouplist = NULL;
+
   if(ng > FSAL_NGROUPS_MAX)
     ng = FSAL_NGROUPS_MAX;
   if((ng > 0) && (alt_groups == NULL))
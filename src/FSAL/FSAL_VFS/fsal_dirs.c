@@ -21,6 +21,8 @@
 #include "fsal_convert.h"
 #include "stuff_alloc.h"
 #include <string.h>
+#include <pthread.h>
+#include "nlm_list.h"
 
 /**
  * FSAL_opendir :
@@ -111,6 +113,209 @@ fsal_status_t VFSFSAL_opendir(fsal_handle_t * p_dir_handle,  /* IN */
 
 }
 
+/*
+ * The entries returned by a readdir call are resolved (handle and
+ * attributes) straight from the directory descriptor with
+ * name_to_handle_at() and fstatat(), nothing is opened. When a call
+ * returns many entries, this work is split into chunks that a small pool
+ * of helper threads resolves along with the calling thread.
+ */
+
+/* Entries a thread resolves at once */
+#define VFS_READDIR_CHUNK 64
+
+typedef struct vfsfsal_readdir_batch__
+{
+  struct glist_head list;       /* pending batches, under readdir_mutex */
+  int dirfd;
+  fsal_attrib_mask_t get_attr_mask;
+  fsal_dirent_t *p_dirents;
+  int *p_errors;                /* errno of each entry, 0 if resolved */
+  unsigned int nb_entries;
+  unsigned int next;            /* first entry no thread has taken yet */
+  unsigned int done;            /* entries resolved so far */
+  pthread_cond_t done_cond;
+} vfsfsal_readdir_batch_t;
+
+static pthread_mutex_t readdir_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readdir_cond = PTHREAD_COND_INITIALIZER;
+static struct glist_head readdir_batches;
+static unsigned int readdir_threads = 0;
+static unsigned int readdir_parallel_min = VFS_READDIR_PARALLEL_MIN_DEFAULT;
+
+/* Resolves the entries [first, first + count[ of a batch.
+ * The names are already set, the handles and attributes are filled. */
+static void vfsfsal_readdir_resolve(vfsfsal_readdir_batch_t * p_batch,
+                                    unsigned int first, unsigned int count)
+{
+  fsal_dirent_t *p_dirent;
+  fsal_status_t st;
+  struct stat buffstat;
+  unsigned int i;
+  int rc;
+
+  for(i = first; i < first + count; i++)
+    {
+      p_dirent = &p_batch->p_dirents[i];
+      p_batch->p_errors[i] = 0;
+
+      /* name_to_handle_at does not follow symlinks, the handle of a
+       * symlink is the one of the link itself */
+      TakeTokenFSCall();
+      st = fsal_internal_get_handle_at(p_batch->dirfd, p_dirent->name.name,
+                                       &p_dirent->handle);
+      ReleaseTokenFSCall();
+
+      if(FSAL_IS_ERROR(st))
+        {
+          p_batch->p_errors[i] = st.minor ? st.minor : EIO;
+          continue;
+        }
+
+      p_dirent->attributes.asked_attributes = p_batch->get_attr_mask;
+
+      /* Only the handle is needed if no attribute was asked */
+      if(p_batch->get_attr_mask == 0)
+        continue;
+
+      TakeTokenFSCall();
+      rc = fstatat(p_batch->dirfd, p_dirent->name.name, &buffstat, AT_SYMLINK_NOFOLLOW);
+      if(rc < 0)
+        rc = errno;
+      ReleaseTokenFSCall();
+
+      if(rc == ENOENT)
+        {
+          /* removed since it was read */
+          p_batch->p_errors[i] = ENOENT;
+          continue;
+        }
+
+      if(rc != 0 || FSAL_IS_ERROR(posix2fsal_attributes(&buffstat, &p_dirent->attributes)))
+        {
+          FSAL_CLEAR_MASK(p_dirent->attributes.asked_attributes);
+          FSAL_SET_MASK(p_dirent->attributes.asked_attributes, FSAL_ATTR_RDATTR_ERR);
+        }
+    }
+}
+
+/* Takes and resolves chunks of a batch until they are all taken.
+ * Called with readdir_mutex held, returns with it held. */
+static void vfsfsal_readdir_work(vfsfsal_readdir_batch_t * p_batch)
+{
+  unsigned int first, count;
+
+  while(p_batch->next < p_batch->nb_entries)
+    {
+      first = p_batch->next;
+      count = p_batch->nb_entries - first;
+      if(count > VFS_READDIR_CHUNK)
+        count = VFS_READDIR_CHUNK;
+      p_batch->next += count;
+
+      /* Nothing left for the helpers */
+      if(p_batch->next == p_batch->nb_entries)
+        glist_del(&p_batch->list);
+
+      V(readdir_mutex);
+      vfsfsal_readdir_resolve(p_batch, first, count);
+      P(readdir_mutex);
+
+      p_batch->done += count;
+      if(p_batch->done == p_batch->nb_entries)
+        pthread_cond_signal(&p_batch->done_cond);
+    }
+}
+
+static void *vfsfsal_readdir_helper(void *arg)
+{
+  char thr_name[32];
+  vfsfsal_readdir_batch_t *p_batch;
+
+  snprintf(thr_name, sizeof(thr_name), "vfs_readdir#%lu", (unsigned long)arg);
+  SetNameFunction(thr_name);
+
+  P(readdir_mutex);
+  while(1)
+    {
+      while(glist_empty(&readdir_batches))
+        pthread_cond_wait(&readdir_cond, &readdir_mutex);
+
+      p_batch = glist_first_entry(&readdir_batches, vfsfsal_readdir_batch_t, list);
+      vfsfsal_readdir_work(p_batch);
+    }
+
+  return NULL;
+}
+
+/**
+ * vfsfsal_readdir_init :
+ *     Starts the threads that help VFSFSAL_readdir on large directories.
+ *     Readdir works inline if they cannot be started.
+ */
+fsal_status_t vfsfsal_readdir_init(vfsfs_specific_initinfo_t * p_init_info)
+{
+  pthread_attr_t attr;
+  pthread_t thrid;
+  unsigned long i;
+  int rc;
+
+  init_glist(&readdir_batches);
+  readdir_parallel_min = p_init_info->readdir_parallel_min;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < p_init_info->readdir_threads; i++)
+    {
+      if((rc = pthread_create(&thrid, &attr, vfsfsal_readdir_helper, (void *)i)) != 0)
+        {
+          LogCrit(COMPONENT_FSAL,
+                  "FSAL INIT: Could not create readdir helper thread, error %d (%s)",
+                  rc, strerror(rc));
+          break;
+        }
+      readdir_threads++;
+    }
+
+  pthread_attr_destroy(&attr);
+
+  LogEvent(COMPONENT_FSAL,
+           "FSAL INIT: %u readdir helper threads, used from %u entries.",
+           readdir_threads, readdir_parallel_min);
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* Resolves a batch, with the helpers if it is large enough */
+static void vfsfsal_readdir_run(vfsfsal_readdir_batch_t * p_batch)
+{
+  p_batch->next = 0;
+  p_batch->done = 0;
+
+  if(readdir_threads == 0 || p_batch->nb_entries < readdir_parallel_min)
+    {
+      vfsfsal_readdir_resolve(p_batch, 0, p_batch->nb_entries);
+      return;
+    }
+
+  pthread_cond_init(&p_batch->done_cond, NULL);
+
+  P(readdir_mutex);
+  glist_add_tail(&readdir_batches, &p_batch->list);
+  pthread_cond_broadcast(&readdir_cond);
+
+  /* the calling thread works too */
+  vfsfsal_readdir_work(p_batch);
+
+  while(p_batch->done < p_batch->nb_entries)
+    pthread_cond_wait(&p_batch->done_cond, &readdir_mutex);
+  V(readdir_mutex);
+
+  pthread_cond_destroy(&p_batch->done_cond);
+}
+
 /**
  * FSAL_readdir :
  *     Read the entries of an opened directory.
@@ -153,7 +358,7 @@ struct linux_dirent
   char d_name[];
 };
 
-#define BUF_SIZE 1024
+#define BUF_SIZE 32768
 
 fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
                               fsal_cookie_t startposition,      /* IN */
@@ -168,21 +373,15 @@ fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
   vfsfsal_dir_t * p_dir_descriptor = (vfsfsal_dir_t * ) dir_descriptor;
   vfsfsal_cookie_t start_position;
   vfsfsal_cookie_t * p_end_position = (vfsfsal_cookie_t *) end_position;
+  vfsfsal_readdir_batch_t batch;
   fsal_status_t st;
   fsal_count_t max_dir_entries;
-  fsal_name_t entry_name;
-  char buff[BUF_SIZE];
+  fsal_count_t first, i;
+  char *buff;
   struct linux_dirent *dp = NULL;
   int bpos = 0;
-  int tmpfd = 0;
 
-  char d_type;
-  struct stat buffstat;
-
-  int errsv, rc = 0;
-
-  memset(buff, 0, BUF_SIZE);
-  memset(&entry_name, 0, sizeof(fsal_name_t));
+  int rc = 0;
 
   /*****************/
   /* sanity checks */
@@ -204,6 +403,22 @@ fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
   if(rc)
     Return(posix2fsal_error(rc), rc, INDEX_FSAL_readdir);
 
+  p_end_position->data.cookie = start_position.data.cookie;
+
+  if((buff = (char *)Mem_Alloc(BUF_SIZE)) == NULL)
+    Return(ERR_FSAL_NOMEM, ENOMEM, INDEX_FSAL_readdir);
+
+  memset(&batch, 0, sizeof(batch));
+  batch.dirfd = p_dir_descriptor->fd;
+  batch.get_attr_mask = get_attr_mask;
+
+  if(max_dir_entries > 0 &&
+     (batch.p_errors = (int *)Mem_Alloc(max_dir_entries * sizeof(int))) == NULL)
+    {
+      Mem_Free(buff);
+      Return(ERR_FSAL_NOMEM, ENOMEM, INDEX_FSAL_readdir);
+    }
+
   /************************/
   /* browse the directory */
   /************************/
@@ -211,16 +426,16 @@ fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
   *p_nb_entries = 0;
   while(*p_nb_entries < max_dir_entries)
     {
-    /***********************/
-      /* read the next entry */
-    /***********************/
+    /************************/
+      /* read the next entries */
+    /************************/
       TakeTokenFSCall();
       rc = syscall(SYS_getdents, p_dir_descriptor->fd, buff, BUF_SIZE);
       ReleaseTokenFSCall();
       if(rc < 0)
         {
           rc = errno;
-          Return(posix2fsal_error(rc), rc, INDEX_FSAL_readdir);
+          goto out_error;
         }
       /* End of directory */
       if(rc == 0)
@@ -229,129 +444,77 @@ fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
           break;
         }
 
-    /***********************************/
-      /* Get information about the entry */
-    /***********************************/
+    /******************************************************/
+      /* Collect the names, the handles are built afterwards */
+    /******************************************************/
 
-      for(bpos = 0; bpos < rc;)
+      first = *p_nb_entries;
+
+      for(bpos = 0; bpos < rc && *p_nb_entries < max_dir_entries;)
         {
           dp = (struct linux_dirent *)(buff + bpos);
-          d_type = *(buff + bpos + dp->d_reclen - 1);
-
           bpos += dp->d_reclen;
 
-          if(!(*p_nb_entries < max_dir_entries))
-            break;
+          /* the entry is consumed, even if it is not returned */
+          p_end_position->data.cookie = dp->d_off;
 
           /* skip . and .. */
           if(!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
             continue;
 
-          /* build the full path of the file into "fsalpath */
           if(FSAL_IS_ERROR
              (st =
               FSAL_str2name(dp->d_name, FSAL_MAX_NAME_LEN,
                             &(p_pdirent[*p_nb_entries].name))))
-            ReturnStatus(st, INDEX_FSAL_readdir);
-
-          d_type = DT_UNKNOWN;
-
-          // TODO: there is a race here, because between handle fetch
-          // and open at things might change.  we need to figure out if there
-          // is another way to open without the pcontext
-
-          strncpy(entry_name.name, dp->d_name, sizeof(entry_name.name));
-          entry_name.len = strlen(entry_name.name);
-
-         if((tmpfd =
-              openat(p_dir_descriptor->fd, dp->d_name,
-                     O_RDONLY | O_NOFOLLOW | O_NONBLOCK,
-                     0600)) < 0)
             {
-              errsv = errno;
-              if(errsv != ELOOP)        /* ( p_dir_descriptor->fd, dp->d_name) is not a symlink */
-                Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_readdir);
-              else
-                d_type = DT_LNK;
+              Mem_Free(batch.p_errors);
+              Mem_Free(buff);
+              ReturnStatus(st, INDEX_FSAL_readdir);
             }
 
-          /* get object handle */
-          TakeTokenFSCall();
-
-          if(d_type != DT_LNK)
-            {
-              st = fsal_internal_fd2handle((fsal_op_context_t *)&(p_dir_descriptor->context),
-					   tmpfd, &(p_pdirent[*p_nb_entries].handle));
-              close(tmpfd);
-            }
-          else
-            {
-              if(fstatat(p_dir_descriptor->fd, dp->d_name, &buffstat, AT_SYMLINK_NOFOLLOW)
-                 < 0)
-                {
-                  ReleaseTokenFSCall();
-                  Return(posix2fsal_error(errno), errno, INDEX_FSAL_readdir);
-                }
-
-              st = fsal_internal_get_handle_at( p_dir_descriptor->fd, dp->d_name,
-						&p_pdirent[*p_nb_entries].handle) ;
-              if(FSAL_IS_ERROR(st))
-                {
-                  ReleaseTokenFSCall();
-                  ReturnStatus(st, INDEX_FSAL_readdir);
-                }
-              p_pdirent[*p_nb_entries].attributes.asked_attributes = get_attr_mask;
-
-              st = posix2fsal_attributes(&buffstat, &p_pdirent[*p_nb_entries].attributes);
-              if(FSAL_IS_ERROR(st))
-                {
-                  ReleaseTokenFSCall();
-                  FSAL_CLEAR_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes);
-                  FSAL_SET_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes,
-                                FSAL_ATTR_RDATTR_ERR);
-                  ReturnStatus(st, INDEX_FSAL_getattrs);
-                }
-
-            }
-          ReleaseTokenFSCall();
+          ((vfsfsal_cookie_t *) (&p_pdirent[*p_nb_entries].cookie))->data.cookie = dp->d_off;
+          (*p_nb_entries)++;
+        }
 
-          if(FSAL_IS_ERROR(st))
-            ReturnStatus(st, INDEX_FSAL_readdir);
+    /*****************************************/
+      /* Get the handles and the attributes     */
+    /*****************************************/
 
-    /************************
-     * Fills the attributes *
-     ************************/
-          if(d_type != DT_LNK)
-            {
-              p_pdirent[*p_nb_entries].attributes.asked_attributes = get_attr_mask;
-
-              st = VFSFSAL_getattrs(&p_pdirent[*p_nb_entries].handle,
-                                    (fsal_op_context_t *) & p_dir_descriptor->context,
-                                    &p_pdirent[*p_nb_entries].attributes);
-              if(FSAL_IS_ERROR(st))
-                {
-                  FSAL_CLEAR_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes);
-                  FSAL_SET_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes,
-                                FSAL_ATTR_RDATTR_ERR);
-                }
-            }
-          //p_pdirent[*p_nb_entries].cookie.cookie = dp->d_off;
-          ((vfsfsal_cookie_t *) (&p_pdirent[*p_nb_entries].cookie))->data.cookie = dp->d_off;
-          p_pdirent[*p_nb_entries].nextentry = NULL;
-          if(*p_nb_entries)
-            p_pdirent[*p_nb_entries - 1].nextentry = &(p_pdirent[*p_nb_entries]);
+      batch.p_dirents = &p_pdirent[first];
+      batch.nb_entries = *p_nb_entries - first;
+      vfsfsal_readdir_run(&batch);
 
-          //(*p_end_position) = p_pdirent[*p_nb_entries].cookie;
-          memcpy((char *)p_end_position, (char *)&p_pdirent[*p_nb_entries].cookie,
-                 sizeof(vfsfsal_cookie_t));
+      /* Drop the entries removed since they were read */
+      *p_nb_entries = first;
+      for(i = 0; i < batch.nb_entries; i++)
+        {
+          rc = batch.p_errors[i];
+          if(rc == ENOENT)
+            continue;
+          if(rc != 0)
+            goto out_error;
 
+          if(first + i != *p_nb_entries)
+            p_pdirent[*p_nb_entries] = p_pdirent[first + i];
           (*p_nb_entries)++;
-
-        }                       /* for */
+        }
     }                           /* While */
 
+  for(i = 0; i < *p_nb_entries; i++)
+    p_pdirent[i].nextentry = (i + 1 < *p_nb_entries) ? &p_pdirent[i + 1] : NULL;
+
+  if(batch.p_errors)
+    Mem_Free(batch.p_errors);
+  Mem_Free(buff);
+
   Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_readdir);
 
+ out_error:
+  if(batch.p_errors)
+    Mem_Free(batch.p_errors);
+  Mem_Free(buff);
+  Return(posix2fsal_error(rc), rc, INDEX_FSAL_readdir);
+
 }
 
 /**
@@ -199,6 +199,10 @@ fsal_status_t VFSFSAL_open(fsal_handle_t * p_filehandle,   /* IN */
   errsv = errno;
   ReleaseTokenFSCall();
 
+#ifdef _USE_IO_URING
+  vfsfsal_async_register_fd(fd);
+#endif
+
   /* set the read-only flag of the file descriptor */
   ((vfsfsal_file_t *)p_file_descriptor)->ro = openflags & FSAL_O_RDONLY;
 
@@ -509,6 +513,11 @@ fsal_status_t VFSFSAL_close(fsal_file_t * p_file_descriptor        /* IN */
   if(((vfsfsal_file_t *)p_file_descriptor)->fd == 0 )
        Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_close);
 
+#ifdef _USE_IO_URING
+  /* The ring holds a reference on the file as long as it is registered */
+  vfsfsal_async_unregister_fd(((vfsfsal_file_t *)p_file_descriptor)->fd);
+#endif
+
   /* call to close */
   TakeTokenFSCall();
 
@@ -78,6 +78,18 @@ fsal_status_t VFSFSAL_Init(fsal_parameter_t * init_info /* IN */
   if(FSAL_IS_ERROR(status))
     Return(status.major, status.minor, INDEX_FSAL_Init);
 
+#ifdef _USE_IO_URING
+  status = vfsfsal_async_init((vfsfs_specific_initinfo_t *) &init_info->fs_specific_info);
+
+  if(FSAL_IS_ERROR(status))
+    Return(status.major, status.minor, INDEX_FSAL_Init);
+#endif
+
+  status = vfsfsal_readdir_init((vfsfs_specific_initinfo_t *) &init_info->fs_specific_info);
+
+  if(FSAL_IS_ERROR(status))
+    Return(status.major, status.minor, INDEX_FSAL_Init);
+
   /* Regular exit */
   Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_Init);
 
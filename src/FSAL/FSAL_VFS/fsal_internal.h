@@ -34,6 +34,7 @@
 
 #include "fsal.h"
 #include <sys/stat.h>
+#include "fsal_up.h"
 
 /* defined the set of attributes supported with POSIX */
 #define VFS_SUPPORTED_ATTRIBUTES (                                       \
@@ -119,6 +120,20 @@ fsal_status_t fsal_internal_fd2handle(  fsal_op_context_t * p_context,
 
 fsal_status_t fsal_internal_link_at(int srcfd, int dfd, char *name);
 
+#ifdef _USE_IO_URING
+/**
+ * Asynchronous IO through io_uring (fsal_async.c).
+ */
+fsal_status_t vfsfsal_async_init(vfsfs_specific_initinfo_t * p_init_info);
+void vfsfsal_async_register_fd(int fd);
+void vfsfsal_async_unregister_fd(int fd);
+#endif                          /* _USE_IO_URING */
+
+/**
+ * Helper threads of VFSFSAL_readdir (fsal_dirs.c).
+ */
+fsal_status_t vfsfsal_readdir_init(vfsfs_specific_initinfo_t * p_init_info);
+
 fsal_status_t fsal_stat_by_handle(fsal_op_context_t * p_context,
                                   fsal_handle_t * p_handle, struct stat64 *buf);
 
@@ -220,6 +235,22 @@ fsal_status_t VFSFSAL_write(fsal_file_t * p_file_descriptor, /* IN */
                             caddr_t buffer,     /* IN */
                             fsal_size_t * p_write_amount /* OUT */ );
 
+#ifdef _USE_IO_URING
+fsal_status_t VFSFSAL_read_async(fsal_file_t * p_file_descriptor,    /* IN */
+                                 fsal_seek_t * p_seek_descriptor,       /* IN */
+                                 fsal_size_t buffer_size,       /* IN */
+                                 caddr_t buffer,        /* OUT */
+                                 fsal_io_callback_t callback,   /* IN */
+                                 void *cb_arg /* IN */ );
+
+fsal_status_t VFSFSAL_write_async(fsal_file_t * p_file_descriptor,   /* IN */
+                                  fsal_seek_t * p_seek_descriptor,      /* IN */
+                                  fsal_size_t buffer_size,      /* IN */
+                                  caddr_t buffer,       /* IN */
+                                  fsal_io_callback_t callback,  /* IN */
+                                  void *cb_arg /* IN */ );
+#endif                          /* _USE_IO_URING */
+
 fsal_status_t VFSFSAL_close(fsal_file_t * p_file_descriptor /* IN */ );
 
 fsal_status_t VFSFSAL_dynamic_fsinfo(fsal_handle_t * p_filehandle,   /* IN */
@@ -395,3 +426,15 @@ fsal_status_t VFSFSAL_RemoveXAttrByName(fsal_handle_t * p_objecthandle,      /*
 unsigned int VFSFSAL_GetFileno(fsal_file_t * pfile);
 
 fsal_status_t VFSFSAL_sync(fsal_file_t * p_file_descriptor /* IN */);
+
+#ifdef _USE_FSAL_UP
+fsal_status_t VFSFSAL_UP_Init( fsal_up_event_bus_parameter_t * pebparam,      /* IN */
+                               fsal_up_event_bus_context_t * pupebcontext     /* OUT */);
+fsal_status_t VFSFSAL_UP_AddFilter( fsal_up_event_bus_filter_t * pupebfilter,  /* IN */
+                                    fsal_up_event_bus_context_t * pupebcontext /* INOUT */ );
+fsal_status_t VFSFSAL_UP_GetEvents( fsal_up_event_t ** pevents,                  /* OUT */
+                                    fsal_count_t * event_nb,                     /* IN */
+                                    fsal_time_t timeout,                         /* IN */
+                                    fsal_count_t * peventfound,                  /* OUT */
+                                    fsal_up_event_bus_context_t * pupebcontext   /* IN */ );
+#endif /* _USE_FSAL_UP */
@@ -428,11 +428,18 @@ fsal_status_t VFSFSAL_SetDefault_FS_common_parameter(fsal_parameter_t * out_para
 
 fsal_status_t VFSFSAL_SetDefault_FS_specific_parameter(fsal_parameter_t * out_parameter)
 {
+  vfsfs_specific_initinfo_t *initinfo;
+
   /* defensive programming... */
   if(out_parameter == NULL)
     ReturnCode(ERR_FSAL_FAULT, 0);
 
   /* set default values for all parameters of fs_specific_info */
+  initinfo = (vfsfs_specific_initinfo_t *) &out_parameter->fs_specific_info;
+  initinfo->async_io_depth = VFS_ASYNC_IO_DEPTH_DEFAULT;
+  initinfo->async_io_files = VFS_ASYNC_IO_FILES_DEFAULT;
+  initinfo->readdir_threads = VFS_READDIR_THREADS_DEFAULT;
+  initinfo->readdir_parallel_min = VFS_READDIR_PARALLEL_MIN_DEFAULT;
 
 #ifdef _USE_PGSQL
 
@@ -802,6 +809,109 @@ fsal_status_t VFSFSAL_load_FS_specific_parameter_from_conf(config_file_t in_conf
                                                            fsal_parameter_t *
                                                            out_parameter)
 {
+  int err;
+  int var_max, var_index;
+  char *key_name;
+  char *key_value;
+  config_item_t block;
+  vfsfs_specific_initinfo_t *initinfo
+	  = (vfsfs_specific_initinfo_t *) &out_parameter->fs_specific_info;
+
+  block = config_FindItemByName(in_config, CONF_LABEL_FS_SPECIFIC);
+
+  /* The block is optional, defaults are kept */
+  if(block == NULL)
+    ReturnCode(ERR_FSAL_NO_ERROR, 0);
+  else if(config_ItemType(block) != CONFIG_ITEM_BLOCK)
+    {
+      LogCrit(COMPONENT_CONFIG,
+              "FSAL LOAD PARAMETER: Item \"%s\" is expected to be a block",
+              CONF_LABEL_FS_SPECIFIC);
+      ReturnCode(ERR_FSAL_INVAL, 0);
+    }
+
+  var_max = config_GetNbItems(block);
+
+  for(var_index = 0; var_index < var_max; var_index++)
+    {
+      config_item_t item;
+
+      item = config_GetItemByIndex(block, var_index);
+
+      err = config_GetKeyValue(item, &key_name, &key_value);
+      if(err)
+        {
+          LogCrit(COMPONENT_CONFIG,
+                  "FSAL LOAD PARAMETER: ERROR reading key[%d] from section \"%s\" of configuration file.",
+                  var_index, CONF_LABEL_FS_SPECIFIC);
+          ReturnCode(ERR_FSAL_SERVERFAULT, err);
+        }
+
+      if(!STRCMP(key_name, "OpenByHandleDeviceFile"))
+        {
+          /* Not used by this FSAL, kept for the existing configurations */
+        }
+      else if(!STRCMP(key_name, "Async_IO_Depth"))
+        {
+          int depth = s_read_int(key_value);
+
+          if(depth < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: null or positive integer expected.",
+                      key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+          initinfo->async_io_depth = depth;
+        }
+      else if(!STRCMP(key_name, "Async_IO_Files"))
+        {
+          int nb_files = s_read_int(key_value);
+
+          if(nb_files < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: null or positive integer expected.",
+                      key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+          initinfo->async_io_files = nb_files;
+        }
+      else if(!STRCMP(key_name, "Readdir_Threads"))
+        {
+          int nb_threads = s_read_int(key_value);
+
+          if(nb_threads < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: null or positive integer expected.",
+                      key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+          initinfo->readdir_threads = nb_threads;
+        }
+      else if(!STRCMP(key_name, "Readdir_Parallel_Min"))
+        {
+          int nb_entries = s_read_int(key_value);
+
+          if(nb_entries <= 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "FSAL LOAD PARAMETER: ERROR: Unexpected value for %s: positive integer expected.",
+                      key_name);
+              ReturnCode(ERR_FSAL_INVAL, 0);
+            }
+          initinfo->readdir_parallel_min = nb_entries;
+        }
+      else
+        {
+          /* This block used to be ignored, existing configurations may
+           * have anything in it */
+          LogEvent(COMPONENT_CONFIG,
+                   "FSAL LOAD PARAMETER: Unknown key %s (item %s) is ignored",
+                   key_name, CONF_LABEL_FS_SPECIFIC);
+        }
+    }
 
   ReturnCode(ERR_FSAL_NO_ERROR, 0);
 
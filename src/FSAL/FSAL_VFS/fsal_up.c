@@ -0,0 +1,317 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ *
+ * \file    fsal_up.c
+ * \brief   FSAL Upcall Interface
+ *
+ * The changes made to the exported filesystem by local processes are
+ * watched with fanotify. The whole filesystem of the export is marked and
+ * the kernel reports the handle of the object that changed (of the parent
+ * directory for the directory entry changes), which is the key of the
+ * object in cache_inode. The events queued at each call are read at once,
+ * the ones on the same object are merged and the batch goes up the
+ * FSAL_UP bus. The changes made by this daemon are not reported.
+ *
+ * If events are lost (queue overflow, no event left in the pool), the
+ * batch is replaced by a single INVALIDATE_ALL event: the objects they were
+ * about are not known, so every cached entry is refreshed on its next use.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fsal.h"
+#include "fsal_up.h"
+#include "fsal_internal.h"
+#include "fsal_convert.h"
+#include <sys/types.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#ifdef _USE_FSAL_UP
+
+#include <sys/fanotify.h>
+
+#ifdef FAN_REPORT_FID
+
+/* Events that make a cached object obsolete */
+#define VFSFSAL_UP_MASK ( FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | \
+                          FAN_MOVED_TO | FAN_DELETE_SELF | FAN_MOVE_SELF | \
+                          FAN_MODIFY | FAN_ATTRIB | FAN_ONDIR )
+
+/* Size of the buffer the events are read in, read() only returns whole
+ * events so this also caps the size of a batch */
+#define VFSFSAL_UP_BUFFER_SIZE 16384
+
+/* One FSAL_UP thread per filesystem, each with its own notification group */
+static __thread int vfs_up_fd = -1;
+static __thread char vfs_up_buffer[VFSFSAL_UP_BUFFER_SIZE];
+
+static unsigned int vfsfsal_up_event_type(uint64_t mask)
+{
+  if(mask & (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO))
+    return FSAL_UP_EVENT_INVALIDATE;    /* directory content */
+  if(mask & FAN_DELETE_SELF)
+    return FSAL_UP_EVENT_UNLINK;
+  if(mask & FAN_MOVE_SELF)
+    return FSAL_UP_EVENT_RENAME;
+  if(mask & FAN_ATTRIB)
+    return FSAL_UP_EVENT_SETATTR;
+  if(mask & FAN_MODIFY)
+    return FSAL_UP_EVENT_WRITE;
+  return FSAL_UP_EVENT_INVALIDATE;
+}
+
+#endif                          /* FAN_REPORT_FID */
+
+fsal_status_t VFSFSAL_UP_Init( fsal_up_event_bus_parameter_t * pebparam,      /* IN */
+                               fsal_up_event_bus_context_t * pupebcontext     /* OUT */)
+{
+#ifdef FAN_REPORT_FID
+  int errsv;
+  vfsfsal_export_context_t *p_export_context;
+
+  if(pupebcontext == NULL)
+    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_UP_init);
+
+  p_export_context = (vfsfsal_export_context_t *) &pupebcontext->FS_export_context;
+
+  if(vfs_up_fd >= 0)
+    close(vfs_up_fd);
+
+  /* The queue is not bounded: a lost event invalidates the whole cache */
+  vfs_up_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_FID | FAN_UNLIMITED_QUEUE |
+                            FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY);
+  if(vfs_up_fd < 0)
+    {
+      errsv = errno;
+      LogCrit(COMPONENT_FSAL_UP,
+              "VFSFSAL_UP_Init: fanotify_init failed, errno=%d (%s)",
+              errsv, strerror(errsv));
+      Return(ERR_FSAL_NOTSUPP, errsv, INDEX_FSAL_UP_init);
+    }
+
+  if(fanotify_mark(vfs_up_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, VFSFSAL_UP_MASK,
+                   p_export_context->mount_root_fd, NULL) != 0)
+    {
+      errsv = errno;
+      LogCrit(COMPONENT_FSAL_UP,
+              "VFSFSAL_UP_Init: fanotify_mark failed on filesystem %s, errno=%d (%s)",
+              p_export_context->fstype, errsv, strerror(errsv));
+      close(vfs_up_fd);
+      vfs_up_fd = -1;
+      Return(ERR_FSAL_NOTSUPP, errsv, INDEX_FSAL_UP_init);
+    }
+
+  LogEvent(COMPONENT_FSAL_UP,
+           "VFSFSAL_UP_Init: watching the changes made to filesystem %s",
+           p_export_context->fstype);
+
+  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_UP_init);
+#else
+  LogCrit(COMPONENT_FSAL_UP,
+          "VFSFSAL_UP_Init: fanotify does not report file handles on this system");
+  Return(ERR_FSAL_NOTSUPP, 0, INDEX_FSAL_UP_init);
+#endif                          /* FAN_REPORT_FID */
+}
+
+fsal_status_t VFSFSAL_UP_AddFilter( fsal_up_event_bus_filter_t * pupebfilter,  /* IN */
+                                    fsal_up_event_bus_context_t * pupebcontext /* INOUT */ )
+{
+  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_UP_addfilter);
+}
+
+fsal_status_t VFSFSAL_UP_GetEvents( fsal_up_event_t ** pevents,                  /* OUT */
+                                    fsal_count_t * event_nb,                     /* IN */
+                                    fsal_time_t timeout,                         /* IN */
+                                    fsal_count_t * peventfound,                  /* OUT */
+                                    fsal_up_event_bus_context_t * pupebcontext   /* IN */ )
+{
+#ifdef FAN_REPORT_FID
+  struct pollfd pfd;
+  struct fanotify_event_metadata *metadata;
+  struct fanotify_event_info_fid *fid;
+  struct file_handle *fh;
+  fsal_up_event_t *pevent;
+  fsal_up_event_t *ptail = NULL;
+  vfsfsal_handle_t handle;
+  pid_t mypid = getpid();
+  int poll_timeout;
+  ssize_t len;
+  int rc, errsv;
+  unsigned int type;
+  int lost = FALSE;
+
+  if(pupebcontext == NULL || event_nb == NULL || pevents == NULL)
+    {
+      LogDebug(COMPONENT_FSAL, "Error: VFSFSAL_UP_GetEvents() received"
+               " unexpectedly NULL arguments.");
+      Return(ERR_FSAL_INVAL, 0, INDEX_FSAL_UP_getevents);
+    }
+
+  if(vfs_up_fd < 0)
+    Return(ERR_FSAL_NOTSUPP, 0, INDEX_FSAL_UP_getevents);
+
+  if(peventfound != NULL)
+    *peventfound = 0;
+
+  /* A null timeout waits for ever */
+  if(timeout.seconds == 0 && timeout.nseconds == 0)
+    poll_timeout = -1;
+  else
+    poll_timeout = timeout.seconds * 1000 + timeout.nseconds / 1000000;
+
+  pfd.fd = vfs_up_fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  rc = poll(&pfd, 1, poll_timeout);
+  if(rc == 0)
+    Return(ERR_FSAL_TIMEOUT, 0, INDEX_FSAL_UP_getevents);
+  if(rc < 0)
+    {
+      errsv = errno;
+      if(errsv == EINTR)
+        Return(ERR_FSAL_TIMEOUT, 0, INDEX_FSAL_UP_getevents);
+      Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_UP_getevents);
+    }
+
+  len = read(vfs_up_fd, vfs_up_buffer, VFSFSAL_UP_BUFFER_SIZE);
+  if(len < 0)
+    {
+      errsv = errno;
+      if(errsv == EAGAIN || errsv == EINTR)
+        Return(ERR_FSAL_TIMEOUT, 0, INDEX_FSAL_UP_getevents);
+      Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_UP_getevents);
+    }
+
+  for(metadata = (struct fanotify_event_metadata *)vfs_up_buffer;
+      FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len))
+    {
+      if(peventfound != NULL)
+        (*peventfound)++;
+
+      if(metadata->vers != FANOTIFY_METADATA_VERSION)
+        {
+          LogCrit(COMPONENT_FSAL_UP,
+                  "VFSFSAL_UP_GetEvents: unexpected fanotify metadata version %u",
+                  metadata->vers);
+          break;
+        }
+
+      if(metadata->mask & FAN_Q_OVERFLOW)
+        {
+          LogCrit(COMPONENT_FSAL_UP,
+                  "VFSFSAL_UP_GetEvents: fanotify queue overflow, all the cached entries will be refreshed");
+          lost = TRUE;
+          break;
+        }
+
+      /* The cache is already up to date with our own changes */
+      if(metadata->pid == mypid)
+        continue;
+
+      fid = (struct fanotify_event_info_fid *)((char *)metadata + metadata->metadata_len);
+      if(metadata->event_len < metadata->metadata_len + sizeof(*fid) + sizeof(*fh) ||
+         fid->hdr.info_type != FAN_EVENT_INFO_TYPE_FID)
+        continue;
+
+      fh = (struct file_handle *)fid->handle;
+      if(fh->handle_bytes > VFS_HANDLE_LEN)
+        continue;
+
+      /* Same layout as the handles built with name_to_handle_at */
+      memset(&handle, 0, sizeof(vfsfsal_handle_t));
+      handle.data.vfs_handle.handle_bytes = fh->handle_bytes;
+      handle.data.vfs_handle.handle_type = fh->handle_type;
+      memcpy(handle.data.vfs_handle.handle, fh->f_handle, fh->handle_bytes);
+
+      type = vfsfsal_up_event_type(metadata->mask);
+
+      /* Merge with an event of the batch on the same object */
+      for(pevent = *pevents; pevent != NULL; pevent = pevent->next_event)
+        if(!memcmp(&pevent->event_data.event_context.fsal_data.handle, &handle,
+                   sizeof(vfsfsal_handle_t)))
+          break;
+
+      if(pevent != NULL)
+        {
+          if(pevent->event_type != type)
+            pevent->event_type = FSAL_UP_EVENT_INVALIDATE;
+          continue;
+        }
+
+      GetFromPool(pevent, pupebcontext->event_pool, fsal_up_event_t);
+      if(pevent == NULL)
+        {
+          LogCrit(COMPONENT_FSAL_UP,
+                  "VFSFSAL_UP_GetEvents: could not allocate an event, all the cached entries will be refreshed");
+          lost = TRUE;
+          break;
+        }
+
+      memset(&pevent->event_data, 0, sizeof(fsal_up_event_data_t));
+      memcpy(&pevent->event_data.event_context.fsal_data.handle, &handle,
+             sizeof(vfsfsal_handle_t));
+      pevent->event_data.event_context.fsal_data.cookie = DIR_START;
+      pevent->event_type = type;
+      pevent->next_event = NULL;
+
+      if(ptail == NULL)
+        *pevents = pevent;
+      else
+        ptail->next_event = pevent;
+      ptail = pevent;
+
+      (*event_nb)++;
+    }
+
+  /* The objects the lost events were about are not known */
+  if(lost)
+    {
+      while(*pevents != NULL)
+        {
+          pevent = *pevents;
+          *pevents = pevent->next_event;
+          ReleaseToPool(pevent, pupebcontext->event_pool);
+          (*event_nb)--;
+        }
+
+      GetFromPool(pevent, pupebcontext->event_pool, fsal_up_event_t);
+      if(pevent == NULL)
+        Return(ERR_FSAL_NOMEM, 0, INDEX_FSAL_UP_getevents);
+
+      memset(&pevent->event_data, 0, sizeof(fsal_up_event_data_t));
+      pevent->event_type = FSAL_UP_EVENT_INVALIDATE_ALL;
+      pevent->next_event = NULL;
+
+      *pevents = pevent;
+      (*event_nb)++;
+    }
+
+  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_UP_getevents);
+#else
+  Return(ERR_FSAL_NOTSUPP, 0, INDEX_FSAL_UP_getevents);
+#endif                          /* FAN_REPORT_FID */
+}
+
+#endif /* _USE_FSAL_UP */
@@ -8,6 +8,7 @@
 
 #include  "fsal.h"
 #include "FSAL/access_check.h"
+#include <stdlib.h>
 
 
 
@@ -23,19 +24,33 @@ static fsal_status_t fsal_check_access_no_acl(fsal_op_context_t * p_context,   /
                                                      fsal_attrib_list_t * p_object_attributes /* IN */ );
 
 
-#ifdef _USE_NFS4_ACL
-static fsal_boolean_t fsal_check_ace_owner(fsal_uid_t uid, fsal_op_context_t *p_context)
+#ifndef _USE_HPSS
+static int fsal_compare_gid(const void *p1, const void *p2)
 {
-  return (p_context->credential.user == uid);
+  fsal_gid_t gid1 = *(const fsal_gid_t *)p1;
+  fsal_gid_t gid2 = *(const fsal_gid_t *)p2;
+
+  return (gid1 < gid2) ? -1 : (gid1 > gid2) ? 1 : 0;
 }
 
-static fsal_boolean_t fsal_check_ace_group(fsal_gid_t gid, fsal_op_context_t *p_context)
+/* fsal_is_group_member
+ * Tells if the user of a context is a member of a group. When the server
+ * resolved all the groups of the user (Manage_Gids), the sorted list is
+ * searched instead of the groups of the credential.
+ */
+fsal_boolean_t fsal_is_group_member(fsal_op_context_t * p_context, fsal_gid_t gid)
 {
+  fsal_grouplist_t *plist = p_context->credential.grouplist;
   int i;
 
   if(p_context->credential.group == gid)
     return TRUE;
 
+  /* The list may be left over by a previous request of another user */
+  if(plist != NULL && plist->uid == p_context->credential.user)
+    return (bsearch(&gid, plist->groups, plist->nbgroups, sizeof(fsal_gid_t),
+                    fsal_compare_gid) != NULL);
+
   for(i = 0; i < p_context->credential.nbgroups; i++)
     {
       if(p_context->credential.alt_groups[i] == gid)
@@ -44,6 +59,18 @@ static fsal_boolean_t fsal_check_ace_group(fsal_gid_t gid, fsal_op_context_t *p_
 
   return FALSE;
 }
+#endif
+
+#ifdef _USE_NFS4_ACL
+static fsal_boolean_t fsal_check_ace_owner(fsal_uid_t uid, fsal_op_context_t *p_context)
+{
+  return (p_context->credential.user == uid);
+}
+
+static fsal_boolean_t fsal_check_ace_group(fsal_gid_t gid, fsal_op_context_t *p_context)
+{
+  return fsal_is_group_member(p_context, gid);
+}
 
 static fsal_boolean_t fsal_check_ace_matches(fsal_ace_t *pace,
                                              fsal_op_context_t *p_context,
@@ -354,7 +381,10 @@ static fsal_status_t fsal_check_access_no_acl(fsal_op_context_t * p_context,   /
                                                      fsal_attrib_list_t * p_object_attributes /* IN */ )
 {
   fsal_accessflags_t missing_access;
-  unsigned int is_grp, i;
+  unsigned int is_grp;
+#ifdef _USE_HPSS
+  unsigned int i;
+#endif
   fsal_uid_t uid;
   fsal_gid_t gid;
   fsal_accessmode_t mode;
@@ -467,24 +497,12 @@ static fsal_status_t fsal_check_access_no_acl(fsal_op_context_t * p_context,   /
           break;
       }
 #else
-  is_grp = (p_context->credential.group == gid);
+  /* Test if file belongs to user's group or alt groups */
+  is_grp = fsal_is_group_member(p_context, gid);
   if(is_grp)
     LogDebug(COMPONENT_FSAL,
                  "fsal_check_access_no_acl: File belongs to user's group %d",
-                 p_context->credential.group);
-
-  /* Test if file belongs to alt user's groups */
-  if(!is_grp)
-    for(i = 0; i < p_context->credential.nbgroups; i++)
-      {
-        is_grp = (p_context->credential.alt_groups[i] == gid);
-        if(is_grp)
-          LogDebug(COMPONENT_FSAL,
-                       "fsal_check_access_no_acl: File belongs to user's alt group %d",
-                       p_context->credential.alt_groups[i]);
-        if(is_grp)
-          break;
-      }
+                 gid);
 #endif
 
   /* If the gid of the file matches the gid of the user or
@@ -53,6 +53,11 @@ fsal_status_t COMMON_InitClientContext(fsal_op_context_t * p_thr_context)
   /* initialy set the export entry to none */
   p_thr_context->export_context = NULL;
 
+#ifndef _USE_HPSS
+  /* no group list is held yet */
+  p_thr_context->credential.grouplist = NULL;
+#endif
+
   Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_InitClientContext);
 }
 
@@ -77,6 +82,9 @@ fsal_status_t COMMON_GetClientContext(fsal_op_context_t * p_thr_context,  /* IN/
   p_thr_context->credential.user = uid;
   p_thr_context->credential.group = gid;
 
+  /* the caller that holds a group list for the user sets it */
+  p_thr_context->credential.grouplist = NULL;
+
   if(ng > FSAL_NGROUPS_MAX) /* this artificially truncates the group list ! */
 	  ng = FSAL_NGROUPS_MAX;
   p_thr_context->credential.nbgroups = ng;
@@ -429,6 +429,51 @@ fsal_status_t FSAL_sync(fsal_file_t * p_file_descriptor)
   return fsal_functions.fsal_sync(p_file_descriptor);
 }
 
+fsal_status_t FSAL_read_async(fsal_file_t * p_file_descriptor,  /* IN */
+                              fsal_seek_t * p_seek_descriptor,  /* IN */
+                              fsal_size_t buffer_size,  /* IN */
+                              caddr_t buffer,   /* OUT */
+                              fsal_io_callback_t callback,      /* IN */
+                              void *cb_arg      /* IN */ )
+{
+  fsal_status_t status;
+  fsal_size_t read_amount = 0;
+  fsal_boolean_t end_of_file = FALSE;
+
+  if(fsal_functions.fsal_read_async != NULL)
+    return fsal_functions.fsal_read_async(p_file_descriptor, p_seek_descriptor,
+                                          buffer_size, buffer, callback, cb_arg);
+
+  /* No asynchronous IO in this FSAL, complete it in place */
+  status = fsal_functions.fsal_read(p_file_descriptor, p_seek_descriptor, buffer_size,
+                                    buffer, &read_amount, &end_of_file);
+  callback(cb_arg, status, read_amount, end_of_file);
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t FSAL_write_async(fsal_file_t * p_file_descriptor, /* IN */
+                               fsal_seek_t * p_seek_descriptor, /* IN */
+                               fsal_size_t buffer_size, /* IN */
+                               caddr_t buffer,  /* IN */
+                               fsal_io_callback_t callback,     /* IN */
+                               void *cb_arg     /* IN */ )
+{
+  fsal_status_t status;
+  fsal_size_t write_amount = 0;
+
+  if(fsal_functions.fsal_write_async != NULL)
+    return fsal_functions.fsal_write_async(p_file_descriptor, p_seek_descriptor,
+                                           buffer_size, buffer, callback, cb_arg);
+
+  /* No asynchronous IO in this FSAL, complete it in place */
+  status = fsal_functions.fsal_write(p_file_descriptor, p_seek_descriptor, buffer_size,
+                                     buffer, &write_amount);
+  callback(cb_arg, status, write_amount, FALSE);
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}
+
 fsal_status_t FSAL_close(fsal_file_t * p_file_descriptor /* IN */ )
 {
   return fsal_functions.fsal_close(p_file_descriptor);
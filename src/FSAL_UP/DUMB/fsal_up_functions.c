@@ -56,6 +56,7 @@ fsal_status_t dumb_fsal_up_invalidate(fsal_up_event_data_t * pevdata)
       LogDebug(COMPONENT_FSAL_UP,
                "FSAL_UP_DUMB: calling cache_inode_get()");
   pentry = cache_inode_get(&pevdata->event_context.fsal_data,
+                           CACHE_INODE_POLICY_FULL_WRITE_THROUGH,
                            &attr, pevdata->event_context.ht, NULL, NULL,
                            &cache_status);
   if(pentry == NULL)
@@ -79,14 +80,24 @@ fsal_status_t dumb_fsal_up_invalidate(fsal_up_event_data_t * pevdata)
   if(pentry->internal_md.type == DIRECTORY)
     {
       pentry->object.dir.has_been_readdir = CACHE_INODE_RENEW_NEEDED;
-      LogDebug(COMPONENT_FSAL_CB,
-              "FSAL_CB_DUMB: Invalidate reset directory.");
+      LogDebug(COMPONENT_FSAL_UP,
+              "FSAL_UP_DUMB: Invalidate reset directory.");
     }
   V_w(&pentry->lock);
 
   ReturnCode(ERR_FSAL_NO_ERROR, 0);
 }
 
+fsal_status_t dumb_fsal_up_invalidate_all(fsal_up_event_data_t * pevdata)
+{
+  LogEvent(COMPONENT_FSAL_UP,
+           "FSAL_UP_DUMB: events were lost, invalidating all the cached entries");
+
+  cache_inode_invalidate_all();
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}
+
 #define INVALIDATE_STUB {                     \
     return dumb_fsal_up_invalidate(pevdata);  \
   } while(0);
@@ -158,7 +169,8 @@ fsal_up_event_functions_t dumb_event_func = {
   .fsal_up_open = dumb_fsal_up_open,
   .fsal_up_close = dumb_fsal_up_close,
   .fsal_up_setattr = dumb_fsal_up_setattr,
-  .fsal_up_invalidate = dumb_fsal_up_invalidate
+  .fsal_up_invalidate = dumb_fsal_up_invalidate,
+  .fsal_up_invalidate_all = dumb_fsal_up_invalidate_all
 };
 
 fsal_up_event_functions_t *get_fsal_up_dumb_functions()
@@ -45,6 +45,9 @@ void create_fsal_up_threads()
   pthread_attr_t attr_thr;
   fsal_up_arg_t *fsal_up_args;
   exportlist_t *pcurrent;
+  pthread_t zeros;
+
+  memset(&zeros, 0, sizeof(zeros));
 
   /* Initialization of thread attrinbutes borrowed from nfs_init.c */
   if(pthread_attr_init(&attr_thr) != 0)
@@ -70,6 +73,10 @@ void create_fsal_up_threads()
       if (pcurrent->use_fsal_up == FALSE)
         continue;
 
+      /* After a reload, the kept exports already have theirs */
+      if (memcmp(&pcurrent->fsal_up_thr, &zeros, sizeof(pthread_t)) != 0)
+        continue;
+
       /* Make sure there are not multiple fsal_up_threads handling multiple
        * exports on the same filesystem. This could potentially cause issues. */
       LogEvent(COMPONENT_INIT, "Checking if export id %d with filesystem "
@@ -116,6 +123,31 @@ void create_fsal_up_threads()
     }
 }
 
+/* Ends the FSAL_UP threads of exports removed by a reload. A thread sees the
+ * request when FSAL_UP_GetEvents returns, at worst after its timeout. */
+void stop_fsal_up_threads(exportlist_t ** pentries, unsigned int nb_entries)
+{
+  unsigned int i;
+  pthread_t zeros;
+
+  memset(&zeros, 0, sizeof(zeros));
+
+  for(i = 0; i < nb_entries; i++)
+    pentries[i]->fsal_up_stop = TRUE;
+
+  for(i = 0; i < nb_entries; i++)
+    {
+      if (memcmp(&pentries[i]->fsal_up_thr, &zeros, sizeof(pthread_t)) == 0)
+        continue;
+
+      LogEvent(COMPONENT_FSAL_UP, "Waiting for the FSAL UP thread of removed"
+               " export id %d to exit.", pentries[i]->id);
+
+      pthread_join(pentries[i]->fsal_up_thr, NULL);
+      memset(&pentries[i]->fsal_up_thr, 0, sizeof(pthread_t));
+    }
+}
+
 /* Given to MakePool() to be used as a constructor of
  * preallocated memory */
 void constructor_fsal_up_event_t(void *ptr)
@@ -205,7 +237,11 @@ fsal_status_t process_event(fsal_up_event_t *event, fsal_up_event_functions_t *e
       break;
     case FSAL_UP_EVENT_INVALIDATE:
       LogDebug(COMPONENT_FSAL_UP, "FSAL_UP: Process INVALIDATE event");
-      status = event_func->fsal_up_create(&event->event_data);
+      status = event_func->fsal_up_invalidate(&event->event_data);
+      break;
+    case FSAL_UP_EVENT_INVALIDATE_ALL:
+      LogDebug(COMPONENT_FSAL_UP, "FSAL_UP: Process INVALIDATE_ALL event");
+      status = event_func->fsal_up_invalidate_all(&event->event_data);
       break;
     default:
       LogDebug(COMPONENT_FSAL_UP, "Unknown FSAL UP event type found: %d",
@@ -367,8 +403,8 @@ void *fsal_up_thread(void *Arg)
   /* Set the timeout for getting events. */
   timeout = fsal_up_args->export_entry->fsal_up_timeout;
 
-  /* Start querying for events and processing. */
-  while(1)
+  /* Start querying for events and processing, until the export is removed. */
+  while(!fsal_up_args->export_entry->fsal_up_stop)
     {
       /* pevent is passed in as a single empty node, it's expected the
        * FSAL will use the event_pool in the bus_context to populate
@@ -438,6 +474,12 @@ void *fsal_up_thread(void *Arg)
                fsal_up_args->export_entry->id);
     }
 
+  LogEvent(COMPONENT_FSAL_UP, "Exiting FSAL UP Thread for filesystem id"
+           " %llu.%llu export id %u, the export was removed.",
+           fsal_up_args->export_entry->filesystem_id.major,
+           fsal_up_args->export_entry->filesystem_id.minor,
+           fsal_up_args->export_entry->id);
+
   Mem_Free(Arg);
   return NULL;
 }                               /* fsal_up_thread */
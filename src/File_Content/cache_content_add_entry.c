@@ -235,6 +235,9 @@ cache_content_entry_t *cache_content_new_entry(cache_entry_t * pentry_inode,
   pentry_inode->object.file.pentry_content = pfc_pentry;
   pfc_pentry->pentry_inode = pentry_inode;
 
+  /* Record the new entry in the journal used for crash recovery */
+  cache_content_journal_append(pfc_pentry, CACHE_CONTENT_JOURNAL_ADD, pclient);
+
   /* Data cache is considered as more pertinent as data below in case of crash recovery */
   if(how != RECOVER_ENTRY)
     {
@@ -59,9 +59,267 @@
 #include <dirent.h>
 #include <string.h>
 
+#include "stuff_alloc.h"
+
+typedef struct cache_content_validator_arg__
+{
+  cache_content_journal_record_t *precords;
+  off_t *psizes;
+  unsigned int count;
+  unsigned int thread_pos;
+  unsigned int thread_number;
+  char *cache_exportdir;
+} cache_content_validator_arg_t;
+
 /**
  *
- * cache_content_crash_recover: recovers the data cache and the associated inode after a crash.
+ * cache_content_validator_thread: checks the data files for a slice of the journal's entries.
+ *
+ * Stats the data file of the entries whose position modulo thread_number is
+ * thread_pos, and stores its size (or -1 if the data file is missing).
+ *
+ * @param arg [INOUT] a cache_content_validator_arg_t.
+ *
+ * @return NULL.
+ *
+ */
+static void *cache_content_validator_thread(void *arg)
+{
+  cache_content_validator_arg_t *pvalidator = (cache_content_validator_arg_t *) arg;
+  char datapath[MAXPATHLEN];
+  struct stat buffstat;
+  unsigned int i;
+
+  for(i = pvalidator->thread_pos; i < pvalidator->count; i += pvalidator->thread_number)
+    {
+      cache_content_get_datapath(pvalidator->cache_exportdir,
+                                 pvalidator->precords[i].fileid, datapath);
+
+      if(stat(datapath, &buffstat) != 0)
+        pvalidator->psizes[i] = -1;
+      else
+        pvalidator->psizes[i] = buffstat.st_size;
+    }
+
+  return NULL;
+}                               /* cache_content_validator_thread */
+
+/**
+ *
+ * cache_content_validate_records: checks the data files of the journal's entries in parallel.
+ *
+ * @param precords [IN] the live entries from the journal.
+ * @param psizes [OUT] the size of the data file for each entry, -1 if it is missing.
+ * @param count [IN] number of entries.
+ * @param cache_exportdir [IN] path to the export directory in the data cache.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void cache_content_validate_records(cache_content_journal_record_t * precords,
+                                           off_t * psizes,
+                                           unsigned int count,
+                                           char *cache_exportdir)
+{
+  cache_content_validator_arg_t args[CACHE_CONTENT_JOURNAL_VALIDATORS];
+  pthread_t threads[CACHE_CONTENT_JOURNAL_VALIDATORS];
+  int started[CACHE_CONTENT_JOURNAL_VALIDATORS];
+  unsigned int nb_threads;
+  unsigned int i;
+
+  /* No need for many threads when there are few entries */
+  nb_threads = count / 1024 + 1;
+  if(nb_threads > CACHE_CONTENT_JOURNAL_VALIDATORS)
+    nb_threads = CACHE_CONTENT_JOURNAL_VALIDATORS;
+
+  for(i = 0; i < nb_threads; i++)
+    {
+      args[i].precords = precords;
+      args[i].psizes = psizes;
+      args[i].count = count;
+      args[i].thread_pos = i;
+      args[i].thread_number = nb_threads;
+      args[i].cache_exportdir = cache_exportdir;
+
+      /* Thread 0 is the caller itself */
+      started[i] = (i != 0
+                    && pthread_create(&threads[i], NULL,
+                                      cache_content_validator_thread, &args[i]) == 0);
+    }
+
+  cache_content_validator_thread(&args[0]);
+
+  for(i = 1; i < nb_threads; i++)
+    {
+      if(started[i])
+        pthread_join(threads[i], NULL);
+      else
+        cache_content_validator_thread(&args[i]);
+    }
+}                               /* cache_content_validate_records */
+
+/**
+ *
+ * cache_content_crash_recover_journal: recovers the data cache from the journal.
+ *
+ * Recovers the data cache from the entries found in the journal. The data
+ * files are checked in parallel, then the entries are added to the cache
+ * inode and the data cache.
+ *
+ * @param precords [IN] the live entries from the journal.
+ * @param count [IN] number of entries.
+ * @param index [IN] only the entries whose position modulo mod is index are recovered.
+ * @param mod [IN] see index.
+ * @param pclient_data [IN] ressource allocated by the client for the data cache.
+ * @param pclient_inode [IN] ressource allocated by the client for the cache inode.
+ * @param ht [IN] the cache inode's hash table.
+ * @param pcontext [IN] the FSAL context.
+ * @pstatus [OUT] returned status.
+ *
+ * @return CACHE_CONTENT_SUCCESS is successful.
+ *
+ */
+static cache_content_status_t cache_content_crash_recover_journal(cache_content_journal_record_t * precords,
+                                                                  unsigned int count,
+                                                                  unsigned int index,
+                                                                  unsigned int mod,
+                                                                  cache_content_client_t * pclient_data,
+                                                                  cache_inode_client_t * pclient_inode,
+                                                                  hash_table_t * ht,
+                                                                  fsal_op_context_t * pcontext,
+                                                                  cache_content_status_t * pstatus)
+{
+  char cache_exportdir[MAXPATHLEN];
+  off_t *psizes = NULL;
+  unsigned int i, j;
+  unsigned int nb_recovered = 0;
+  unsigned int nb_stale = 0;
+
+  cache_entry_t *pentry = NULL;
+  cache_content_entry_t *pentry_content = NULL;
+  cache_inode_status_t cache_inode_status;
+  cache_content_status_t cache_content_status;
+
+  fsal_attrib_list_t fsal_attr;
+  cache_inode_fsal_data_t fsal_data;
+
+  *pstatus = CACHE_CONTENT_SUCCESS;
+
+  /* Keep only this recoverer's share of the entries */
+  if(mod > 1)
+    {
+      for(i = 0, j = 0; i < count; i++)
+        if(i % mod == index)
+          precords[j++] = precords[i];
+      count = j;
+    }
+
+  if(count == 0)
+    return *pstatus;
+
+  if((psizes = (off_t *) Mem_Alloc(count * sizeof(off_t))) == NULL)
+    {
+      *pstatus = CACHE_CONTENT_MALLOC_ERROR;
+      return *pstatus;
+    }
+
+  if(snprintf(cache_exportdir, MAXPATHLEN, "%s/export_id=%d",
+              pclient_data->cache_dir, 0) >= MAXPATHLEN)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Data cache directory %s: path too long", pclient_data->cache_dir);
+      Mem_Free(psizes);
+      *pstatus = CACHE_CONTENT_LOCAL_CACHE_ERROR;
+      return *pstatus;
+    }
+
+  cache_content_validate_records(precords, psizes, count, cache_exportdir);
+
+  for(i = 0; i < count; i++)
+    {
+      if(psizes[i] == -1)
+        {
+          LogDebug(COMPONENT_CACHE_CONTENT,
+                   "No data file for journaled file ID %"PRIx64", skipping it",
+                   precords[i].fileid);
+          cache_content_journal_forget(pclient_data->cache_dir, precords[i].fileid);
+          nb_stale += 1;
+          continue;
+        }
+
+      /* Populating the cache_inode... */
+      fsal_data.handle = precords[i].handle;
+      fsal_data.cookie = 0;
+
+      if((pentry = cache_inode_get(&fsal_data,
+                                   CACHE_INODE_JOKER_POLICY,
+                                   &fsal_attr,
+                                   ht,
+                                   pclient_inode,
+                                   pcontext, &cache_inode_status)) == NULL)
+        {
+          LogCrit(COMPONENT_CACHE_CONTENT,
+                  "Error adding cached inode for file ID %"PRIx64", error=%d",
+                  precords[i].fileid, cache_inode_status);
+          continue;
+        }
+
+      /* Already recovered (several exports share the same cache directory) */
+      if(pentry->object.file.pentry_content != NULL)
+        continue;
+
+      pentry->object.file.attributes.filesize = (fsal_size_t) psizes[i];
+
+      /* Adding the cached entry to the data cache */
+      if((pentry_content = cache_content_new_entry(pentry,
+                                                   NULL,
+                                                   pclient_data,
+                                                   RECOVER_ENTRY,
+                                                   pcontext,
+                                                   &cache_content_status)) == NULL)
+        {
+          LogCrit(COMPONENT_CACHE_CONTENT,
+                  "Error adding cached data for file ID %"PRIx64", error=%d",
+                  precords[i].fileid, cache_content_status);
+          continue;
+        }
+
+      if((cache_content_status =
+          cache_content_valid(pentry_content, CACHE_CONTENT_OP_GET,
+                              pclient_data)) != CACHE_CONTENT_SUCCESS)
+        {
+          *pstatus = cache_content_status;
+          break;
+        }
+
+      pentry_content->internal_md.mod_time = (time_t) precords[i].mod_time;
+      pentry_content->internal_md.last_flush_time = (time_t) precords[i].last_flush_time;
+
+      /* Data that were not flushed before the crash still have to be */
+      if(precords[i].sync_state == FLUSH_NEEDED)
+        {
+          pentry_content->local_fs_entry.sync_state = FLUSH_NEEDED;
+          cache_content_journal_append(pentry_content, CACHE_CONTENT_JOURNAL_DIRTY,
+                                       pclient_data);
+        }
+
+      nb_recovered += 1;
+    }
+
+  Mem_Free(psizes);
+
+  LogEvent(COMPONENT_CACHE_CONTENT,
+           "Data cache recovered from journal: %u entries recovered, %u stale entries skipped",
+           nb_recovered, nb_stale);
+
+  return *pstatus;
+}                               /* cache_content_crash_recover_journal */
+
+/**
+ *
+ * cache_content_crash_recover_crawl: recovers the data cache by crawling the cache directory.
+ *
+ * Used when the cache directory has no journal (data cache written by an older server).
  *
  * @param pclient [IN]  ressource allocated by the client for the nfs management.
  * @pstatus [OUT] returned status.
@@ -69,7 +327,7 @@
  * @return CACHE_CONTENT_SUCCESS is successful.
  *
  */
-cache_content_status_t cache_content_crash_recover(unsigned short exportid,
+static cache_content_status_t cache_content_crash_recover_crawl(unsigned short exportid,
                                                    unsigned int index,
                                                    unsigned int mod,
                                                    cache_content_client_t * pclient_data,
@@ -237,5 +495,61 @@ cache_content_status_t cache_content_crash_recover(unsigned short exportid,
   /* Close the cache directory */
   closedir(cache_directory);
 
+  return *pstatus;
+}                               /* cache_content_crash_recover_crawl */
+
+/**
+ *
+ * cache_content_crash_recover: recovers the data cache and the associated inode after a crash.
+ *
+ * Recovers the data cache from its journal if there is one, by crawling the
+ * cache directory otherwise. The journal is checkpointed afterwards, so that
+ * it only contains the entries that were actually recovered.
+ *
+ * @param pclient [IN]  ressource allocated by the client for the nfs management.
+ * @pstatus [OUT] returned status.
+ *
+ * @return CACHE_CONTENT_SUCCESS is successful.
+ *
+ */
+cache_content_status_t cache_content_crash_recover(unsigned short exportid,
+                                                   unsigned int index,
+                                                   unsigned int mod,
+                                                   cache_content_client_t * pclient_data,
+                                                   cache_inode_client_t * pclient_inode,
+                                                   hash_table_t * ht,
+                                                   fsal_op_context_t * pcontext,
+                                                   cache_content_status_t * pstatus)
+{
+  cache_content_journal_record_t *precords = NULL;
+  unsigned int count = 0;
+
+  *pstatus = CACHE_CONTENT_SUCCESS;
+
+  if(cache_content_journal_replay(pclient_data->cache_dir, &precords, &count) != 0)
+    {
+      if(errno == ENOENT)
+        LogEvent(COMPONENT_CACHE_CONTENT,
+                 "No journal in data cache %s, crawling the cache directory",
+                 pclient_data->cache_dir);
+      else
+        LogCrit(COMPONENT_CACHE_CONTENT,
+                "Data cache journal in %s is unreadable, errno=%u(%s), crawling the cache directory",
+                pclient_data->cache_dir, errno, strerror(errno));
+
+      cache_content_crash_recover_crawl(exportid, index, mod, pclient_data,
+                                        pclient_inode, ht, pcontext, pstatus);
+    }
+  else
+    {
+      cache_content_crash_recover_journal(precords, count, index, mod, pclient_data,
+                                          pclient_inode, ht, pcontext, pstatus);
+      if(precords != NULL)
+        Mem_Free(precords);
+    }
+
+  /* Compact the records written while recovering */
+  cache_content_journal_checkpoint(pclient_data->cache_dir);
+
   return *pstatus;
 }                               /* cache_content_crash_recover */
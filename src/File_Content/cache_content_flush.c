@@ -198,7 +198,20 @@ cache_content_status_t cache_content_flush(cache_content_entry_t * pentry,
 
   /* Update the internal metadata */
   pentry->internal_md.last_flush_time = time(NULL);
-  pentry->local_fs_entry.sync_state = SYNC_OK;
+
+  /* Once deleted, the entry is no more to be recovered */
+  if(flushhow == CACHE_CONTENT_FLUSH_AND_DELETE)
+    {
+      pentry->local_fs_entry.sync_state = SYNC_OK;
+      cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_RELEASE, pclient);
+    }
+  else if(pentry->local_fs_entry.sync_state == FLUSH_NEEDED)
+    {
+      pentry->local_fs_entry.sync_state = SYNC_OK;
+      cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_CLEAN, pclient);
+    }
+  else
+    pentry->local_fs_entry.sync_state = SYNC_OK;
 
   return *pstatus;
 }                               /* cache_content_flush */
@@ -346,7 +359,13 @@ cache_content_status_t cache_content_refresh(cache_content_entry_t * pentry,
 
       /* Update the internal metadata */
       pentry->internal_md.last_refresh_time = time(NULL);
-      pentry->local_fs_entry.sync_state = SYNC_OK;
+      if(pentry->local_fs_entry.sync_state == FLUSH_NEEDED)
+        {
+          pentry->local_fs_entry.sync_state = SYNC_OK;
+          cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_CLEAN, pclient);
+        }
+      else
+        pentry->local_fs_entry.sync_state = SYNC_OK;
 
     }
 
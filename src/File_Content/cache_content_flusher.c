@@ -0,0 +1,877 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_content_flusher.c
+ * \brief   Management of the file content cache: prioritized, throttled flush to the FSAL.
+ *
+ * cache_content_flusher.c : Management of the file content cache: prioritized, throttled flush to the FSAL.
+ *
+ * The flusher threads share a single list of files to be flushed, built once
+ * from the data cache journal (or from the index files when there is no
+ * journal) and sorted so that the oldest, then the largest, files go first.
+ * Each file is streamed to the FSAL with several writes in flight, and the
+ * overall throughput can be bounded (Flush_Bandwidth).
+ *
+ * This file also keeps the count of bytes written in the data cache and not
+ * flushed yet: writers are slowed down when it goes over Dirty_Threshold,
+ * and the garbage collector is asked to flush early.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "stuff_alloc.h"
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "fsal.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "cache_content.h"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+
+extern cache_content_gc_policy_t cache_content_gc_policy;
+
+typedef struct cache_content_flush_job__
+{
+  fsal_handle_t handle;         /**< FSAL handle of the file                  */
+  u_int64_t fileid;             /**< Fileid used to name the local files      */
+  off_t size;                   /**< Size of the local data file              */
+  time_t max_acmtime;           /**< Last access/change to the local file     */
+  int clean;                    /**< Known to be in sync with the FSAL        */
+} cache_content_flush_job_t;
+
+typedef struct cache_content_flush_queue__
+{
+  pthread_mutex_t mutex;
+  int prepared;
+  cache_content_flush_job_t *jobs;
+  unsigned int count;
+  unsigned int next;
+  cache_content_flush_behaviour_t flushhow;
+  unsigned int passcounter;
+} cache_content_flush_queue_t;
+
+typedef struct cache_content_flush_window__
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  unsigned int inflight;
+  int failed;
+  fsal_status_t status;
+} cache_content_flush_window_t;
+
+typedef struct cache_content_flush_slot__
+{
+  caddr_t buffer;
+  fsal_size_t length;
+  int busy;
+  cache_content_flush_window_t *pwindow;
+} cache_content_flush_slot_t;
+
+static cache_content_flush_queue_t flush_queue = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .prepared = FALSE,
+  .jobs = NULL,
+  .count = 0,
+  .next = 0
+};
+
+/* Token bucket shared by the flushers, for Flush_Bandwidth */
+static pthread_mutex_t bandwidth_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct timeval bandwidth_last;
+static double bandwidth_credit = 0.0;
+
+/* Bytes written in the data cache and not known to be flushed */
+static volatile u_int64_t dirty_bytes = 0;
+static pthread_mutex_t dirty_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dirty_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t flush_request_cond = PTHREAD_COND_INITIALIZER;
+static int flush_requested = FALSE;
+
+/**
+ *
+ * cache_content_flush_job_cmp: qsort's comparison for flush jobs.
+ *
+ * Files not accessed for the longest time go first (by minute), then the
+ * largest ones, which free the most space in the cache.
+ *
+ */
+static int cache_content_flush_job_cmp(const void *a, const void *b)
+{
+  const cache_content_flush_job_t *ja = a;
+  const cache_content_flush_job_t *jb = b;
+
+  if(ja->max_acmtime / 60 != jb->max_acmtime / 60)
+    return (ja->max_acmtime < jb->max_acmtime) ? -1 : 1;
+
+  if(ja->size != jb->size)
+    return (ja->size > jb->size) ? -1 : 1;
+
+  return 0;
+}                               /* cache_content_flush_job_cmp */
+
+/**
+ *
+ * cache_content_get_indexpath: recovers the path of the index file for a specified inum.
+ *
+ */
+static void cache_content_get_indexpath(char *basepath, u_int64_t inum, char *indexpath)
+{
+  size_t len;
+
+  cache_content_get_datapath(basepath, inum, indexpath);
+
+  /* node=<inum>.data -> node=<inum>.index */
+  len = strlen(indexpath);
+  if(len > 4 && len + 1 < MAXPATHLEN)
+    strcpy(indexpath + len - 4, "index");
+}                               /* cache_content_get_indexpath */
+
+/**
+ *
+ * cache_content_flush_add_job: stats a local data file and adds it to the flush list.
+ *
+ * @return TRUE if the job was added, FALSE otherwise.
+ *
+ */
+static int cache_content_flush_add_job(char *cachedir,
+                                       fsal_handle_t * phandle,
+                                       u_int64_t fileid,
+                                       int clean,
+                                       time_t grace_period,
+                                       unsigned int *palloc,
+                                       unsigned int *p_nb_too_young)
+{
+  cache_content_flush_job_t *pjob;
+  char datapath[MAXPATHLEN];
+  struct stat buffstat;
+  time_t max_acmtime = 0;
+
+  cache_content_get_datapath(cachedir, fileid, datapath);
+
+  /* Stat the data file to know if it is eligible or not */
+  if(stat(datapath, &buffstat) == -1)
+    {
+      if(errno != ENOENT)
+        LogCrit(COMPONENT_CACHE_CONTENT,
+                "Can't stat file %s errno=%u(%s), continuing with next entries...",
+                datapath, errno, strerror(errno));
+      return FALSE;
+    }
+
+  if(buffstat.st_atime > max_acmtime)
+    max_acmtime = buffstat.st_atime;
+  if(buffstat.st_mtime > max_acmtime)
+    max_acmtime = buffstat.st_mtime;
+  if(buffstat.st_ctime > max_acmtime)
+    max_acmtime = buffstat.st_ctime;
+
+  if(time(NULL) - max_acmtime < grace_period)
+    {
+      if(p_nb_too_young != NULL)
+        *p_nb_too_young += 1;
+
+      LogDebug(COMPONENT_CACHE_CONTENT, "File %s is too young to die, preserving it...",
+               datapath);
+      return FALSE;
+    }
+
+  if(flush_queue.count == *palloc)
+    {
+      *palloc = (*palloc == 0) ? 1024 : 2 * *palloc;
+
+      if((pjob = (cache_content_flush_job_t *)
+          Mem_Realloc(flush_queue.jobs, *palloc * sizeof(cache_content_flush_job_t))) == NULL)
+        {
+          LogCrit(COMPONENT_CACHE_CONTENT, "Can't allocate the list of files to be flushed");
+          *palloc = flush_queue.count;
+          return FALSE;
+        }
+      flush_queue.jobs = pjob;
+    }
+
+  pjob = &flush_queue.jobs[flush_queue.count++];
+  pjob->handle = *phandle;
+  pjob->fileid = fileid;
+  pjob->size = buffstat.st_size;
+  pjob->max_acmtime = max_acmtime;
+  pjob->clean = clean;
+
+  return TRUE;
+}                               /* cache_content_flush_add_job */
+
+/**
+ *
+ * cache_content_flush_prepare: builds the sorted list of the files to be flushed.
+ *
+ * Uses the journal when there is one: it gives the handles without reading one
+ * index file per entry, and tells which entries are already clean. Falls back
+ * on crawling the index files otherwise. Queue's mutex is supposed to be held.
+ *
+ */
+static void cache_content_flush_prepare(char *cachedir,
+                                        time_t grace_period,
+                                        unsigned int *p_nb_too_young)
+{
+  cache_content_journal_record_t *precords = NULL;
+  unsigned int nb_records = 0;
+  unsigned int alloc = 0;
+  unsigned int i;
+  cache_content_dirinfo_t directory;
+  struct dirent dir_entry;
+  char indexpath[MAXPATHLEN];
+  u_int64_t inum;
+  cache_entry_t inode_entry;
+
+  if(cache_content_journal_replay(nfs_param.cache_layers_param.
+                                  cache_content_client_param.cache_dir,
+                                  &precords, &nb_records) == 0)
+    {
+      for(i = 0; i < nb_records; i++)
+        cache_content_flush_add_job(cachedir, &precords[i].handle, precords[i].fileid,
+                                    (precords[i].sync_state == SYNC_OK),
+                                    grace_period, &alloc, p_nb_too_young);
+
+      if(precords != NULL)
+        Mem_Free(precords);
+    }
+  else if(cache_content_local_cache_opendir(cachedir, &directory) == TRUE)
+    {
+      LogEvent(COMPONENT_CACHE_CONTENT,
+               "No data cache journal, reading the index files in %s", cachedir);
+
+      while(cache_content_local_cache_dir_iter(&directory, &dir_entry, 0, 1))
+        {
+          /* Manage only index files */
+          if((inum = cache_content_get_inum(dir_entry.d_name)) == 0)
+            continue;
+
+          snprintf(indexpath, MAXPATHLEN, "%s/%s", cachedir, dir_entry.d_name);
+
+          if(cache_inode_reload_content(indexpath, &inode_entry) != CACHE_INODE_SUCCESS)
+            {
+              LogCrit(COMPONENT_CACHE_CONTENT, "Invalid index file %s", indexpath);
+              continue;
+            }
+
+          cache_content_flush_add_job(cachedir, &inode_entry.object.file.handle, inum,
+                                      FALSE, grace_period, &alloc, p_nb_too_young);
+        }
+
+      cache_content_local_cache_closedir(&directory);
+    }
+  else
+    LogCrit(COMPONENT_CACHE_CONTENT, "Can't open directory %s", cachedir);
+
+  qsort(flush_queue.jobs, flush_queue.count, sizeof(cache_content_flush_job_t),
+        cache_content_flush_job_cmp);
+
+  LogEvent(COMPONENT_CACHE_CONTENT, "%u files in data cache %s are to be flushed",
+           flush_queue.count, cachedir);
+}                               /* cache_content_flush_prepare */
+
+/**
+ *
+ * cache_content_flush_next_job: gets the next file to be flushed.
+ *
+ * Also checks the data cache filesystem every 100 files when purging until the
+ * low water mark: once reached, the remaining files are only synced.
+ *
+ * @return the job, or NULL when the list is exhausted.
+ *
+ */
+static cache_content_flush_job_t *cache_content_flush_next_job(char *cachedir,
+                                                               unsigned int lw_mark_trigger_flag,
+                                                               cache_content_flush_behaviour_t *
+                                                               pflushhow)
+{
+  cache_content_flush_job_t *pjob = NULL;
+  unsigned long nb_blocks;
+  int is_over_lw;
+
+  P(flush_queue.mutex);
+
+  if(lw_mark_trigger_flag == TRUE
+     && flush_queue.flushhow == CACHE_CONTENT_FLUSH_AND_DELETE
+     && ++flush_queue.passcounter == 100)
+    {
+      flush_queue.passcounter = 0;
+
+      if(cache_content_check_threshold(cachedir,
+                                       cache_content_gc_policy.lwmark_df,
+                                       cache_content_gc_policy.lwmark_df,
+                                       &is_over_lw, &nb_blocks) == CACHE_CONTENT_SUCCESS
+         && !is_over_lw)
+        {
+          /* No need to purge more, downgrade to sync mode */
+          flush_queue.flushhow = CACHE_CONTENT_FLUSH_SYNC_ONLY;
+          LogEvent(COMPONENT_CACHE_CONTENT,
+                   "Datacache: Low Water is reached, I stop purging but continue on syncing");
+        }
+    }
+
+  if(flush_queue.next < flush_queue.count)
+    pjob = &flush_queue.jobs[flush_queue.next++];
+
+  *pflushhow = flush_queue.flushhow;
+
+  V(flush_queue.mutex);
+
+  return pjob;
+}                               /* cache_content_flush_next_job */
+
+/**
+ *
+ * cache_content_flush_throttle: waits until size bytes may be sent to the FSAL.
+ *
+ */
+static void cache_content_flush_throttle(fsal_size_t size)
+{
+  double rate;
+  double delay = 0.0;
+  struct timeval now;
+
+  if(cache_content_gc_policy.flush_bandwidth == 0)
+    return;
+
+  rate = (double)cache_content_gc_policy.flush_bandwidth * 1024.0 * 1024.0;
+
+  P(bandwidth_mutex);
+
+  gettimeofday(&now, NULL);
+
+  if(bandwidth_last.tv_sec != 0)
+    bandwidth_credit += rate * ((now.tv_sec - bandwidth_last.tv_sec) +
+                                (now.tv_usec - bandwidth_last.tv_usec) / 1000000.0);
+  bandwidth_last = now;
+
+  /* No more than one second of burst */
+  if(bandwidth_credit > rate)
+    bandwidth_credit = rate;
+
+  bandwidth_credit -= (double)size;
+
+  if(bandwidth_credit < 0.0)
+    delay = -bandwidth_credit / rate;
+
+  V(bandwidth_mutex);
+
+  if(delay > 0.0)
+    usleep((useconds_t) (delay * 1000000.0));
+}                               /* cache_content_flush_throttle */
+
+#if !( defined( _USE_PROXY ) && defined( _BY_FILEID ) )
+/**
+ *
+ * cache_content_flush_write_done: completion of a write to the FSAL.
+ *
+ */
+static void cache_content_flush_write_done(void *cb_arg,
+                                           fsal_status_t status,
+                                           fsal_size_t io_amount,
+                                           fsal_boolean_t end_of_file)
+{
+  cache_content_flush_slot_t *pslot = (cache_content_flush_slot_t *) cb_arg;
+  cache_content_flush_window_t *pwindow = pslot->pwindow;
+
+  P(pwindow->mutex);
+
+  if(!pwindow->failed && (FSAL_IS_ERROR(status) || io_amount != pslot->length))
+    {
+      pwindow->failed = TRUE;
+      pwindow->status = status;
+      if(!FSAL_IS_ERROR(status))
+        pwindow->status.major = ERR_FSAL_IO;
+    }
+
+  pslot->busy = FALSE;
+  pwindow->inflight -= 1;
+
+  pthread_cond_signal(&pwindow->cond);
+  V(pwindow->mutex);
+}                               /* cache_content_flush_write_done */
+
+/**
+ *
+ * cache_content_flush_stream: copies a local data file to the FSAL.
+ *
+ * The file is read by chunks of CACHE_CONTENT_FLUSH_CHUNK bytes, and up to
+ * nb_slots chunks are written to the FSAL at the same time. The FSAL file is
+ * only truncated to the size of the cached one once every chunk is written,
+ * a copy that fails leaves the entry dirty.
+ *
+ * @return the FSAL status of the copy.
+ *
+ */
+static fsal_status_t cache_content_flush_stream(cache_content_flush_job_t * pjob,
+                                                char *datapath,
+                                                cache_content_flush_slot_t * slots,
+                                                unsigned int nb_slots,
+                                                fsal_op_context_t * pcontext)
+{
+  cache_content_flush_window_t window;
+  fsal_status_t fsal_status;
+  fsal_file_t fsal_fd;
+  fsal_seek_t seek;
+  off_t offset = 0;
+  ssize_t length;
+  unsigned int i;
+  int local_fd;
+
+  if((local_fd = open(datapath, O_RDONLY)) == -1)
+    {
+      fsal_status.major = ERR_FSAL_IO;
+      fsal_status.minor = errno;
+      return fsal_status;
+    }
+
+  fsal_status = FSAL_open(&pjob->handle, pcontext, FSAL_O_WRONLY, &fsal_fd, NULL);
+
+  if(FSAL_IS_ERROR(fsal_status))
+    {
+      close(local_fd);
+      return fsal_status;
+    }
+
+  pthread_mutex_init(&window.mutex, NULL);
+  pthread_cond_init(&window.cond, NULL);
+  window.inflight = 0;
+  window.failed = FALSE;
+
+  for(i = 0; i < nb_slots; i++)
+    {
+      slots[i].busy = FALSE;
+      slots[i].pwindow = &window;
+    }
+
+  while(offset < pjob->size && !window.failed)
+    {
+      /* Wait for a free slot */
+      P(window.mutex);
+      while(window.inflight == nb_slots && !window.failed)
+        pthread_cond_wait(&window.cond, &window.mutex);
+      for(i = 0; i < nb_slots && slots[i].busy; i++) ;
+      V(window.mutex);
+
+      if(window.failed || i == nb_slots)
+        break;
+
+      length = pread(local_fd, slots[i].buffer, CACHE_CONTENT_FLUSH_CHUNK, offset);
+
+      if(length <= 0)
+        {
+          /* The local file can't be read, or was truncated meanwhile: its
+           * size is no longer the one to be flushed, the next pass will do */
+          P(window.mutex);
+          window.failed = TRUE;
+          window.status.major = ERR_FSAL_IO;
+          window.status.minor = (length < 0) ? errno : 0;
+          V(window.mutex);
+          break;
+        }
+
+      cache_content_flush_throttle((fsal_size_t) length);
+
+      P(window.mutex);
+      slots[i].busy = TRUE;
+      slots[i].length = (fsal_size_t) length;
+      window.inflight += 1;
+      V(window.mutex);
+
+      seek.whence = FSAL_SEEK_SET;
+      seek.offset = offset;
+
+      fsal_status = FSAL_write_async(&fsal_fd, &seek, (fsal_size_t) length,
+                                     slots[i].buffer, cache_content_flush_write_done,
+                                     &slots[i]);
+
+      if(FSAL_IS_ERROR(fsal_status))
+        {
+          /* The callback won't be called */
+          P(window.mutex);
+          slots[i].busy = FALSE;
+          window.inflight -= 1;
+          window.failed = TRUE;
+          window.status = fsal_status;
+          V(window.mutex);
+          break;
+        }
+
+      offset += length;
+    }
+
+  /* Wait for the writes in flight */
+  P(window.mutex);
+  while(window.inflight > 0)
+    pthread_cond_wait(&window.cond, &window.mutex);
+  V(window.mutex);
+
+  close(local_fd);
+
+  /* The FSAL file gets the exact size of the cached one */
+  if(!window.failed)
+    {
+      fsal_status = FSAL_truncate(&pjob->handle, pcontext, (fsal_size_t) pjob->size,
+                                  &fsal_fd, NULL);
+      if(FSAL_IS_ERROR(fsal_status))
+        {
+          window.failed = TRUE;
+          window.status = fsal_status;
+        }
+    }
+
+  fsal_status = FSAL_close(&fsal_fd);
+
+  if(window.failed)
+    fsal_status = window.status;
+
+  pthread_cond_destroy(&window.cond);
+  pthread_mutex_destroy(&window.mutex);
+
+  return fsal_status;
+}                               /* cache_content_flush_stream */
+#endif
+
+/**
+ *
+ * cache_content_flush_remove: removes the local files of a flushed entry.
+ *
+ * @return 0 if ok, -1 otherwise.
+ *
+ */
+static int cache_content_flush_remove(char *indexpath, char *datapath)
+{
+  if(unlink(indexpath) && errno != ENOENT)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT, "Can't unlink flushed index %s, errno=%u(%s)",
+              indexpath, errno, strerror(errno));
+      return -1;
+    }
+
+  if(unlink(datapath))
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT, "Can't unlink flushed data %s, errno=%u(%s)",
+              datapath, errno, strerror(errno));
+      return -1;
+    }
+
+  return 0;
+}                               /* cache_content_flush_remove */
+
+/**
+ *
+ * cache_content_flusher_run: flushes the data cache to the FSAL, as one of several flushers.
+ *
+ * Every flusher calls this function: the first one builds the list of the files
+ * to be flushed, then all of them take the files from this list, by priority,
+ * until it is exhausted. Files known to be clean are not copied again, they are
+ * only removed when purging.
+ *
+ * @param cachedir     [IN]    the directory of the export in the data cache
+ * @param flushhow     [IN]    should we delete local files or not ?
+ * @param lw_mark_trig [IN]    should we purge until low water mark is reached ?
+ * @param grace_period [IN]    grace period for a file before being considered for flush
+ * @param p_nb_flushed [INOUT] current flushed count
+ * @param p_nb_too_young [INOUT] current count of files in their grace period
+ * @param p_nb_errors  [INOUT] current flush errors
+ * @param p_nb_orphans [INOUT] current orphan files detected
+ * @param pcontext     [INOUT] the FSAL context for this operation
+ * @param pstatus      [OUT]   the status of the operation.
+ *
+ * @return CACHE_CONTENT_SUCCESS if successful, an error otherwise.
+ *
+ */
+cache_content_status_t cache_content_flusher_run(char *cachedir,
+                                                cache_content_flush_behaviour_t flushhow,
+                                                unsigned int lw_mark_trigger_flag,
+                                                time_t grace_period,
+                                                unsigned int *p_nb_flushed,
+                                                unsigned int *p_nb_too_young,
+                                                unsigned int *p_nb_errors,
+                                                unsigned int *p_nb_orphans,
+                                                fsal_op_context_t * pcontext,
+                                                cache_content_status_t * pstatus)
+{
+  cache_content_flush_slot_t slots[CACHE_CONTENT_FLUSH_MAX_OUTSTANDING];
+  cache_content_flush_behaviour_t local_flushhow;
+  cache_content_flush_job_t *pjob;
+  fsal_status_t fsal_status;
+  char datapath[MAXPATHLEN];
+  char indexpath[MAXPATHLEN];
+  unsigned int nb_slots;
+  unsigned int i;
+#if defined( _USE_PROXY ) && defined( _BY_FILEID )
+  fsal_path_t fsal_path;
+#endif
+
+  *pstatus = CACHE_CONTENT_SUCCESS;
+
+  P(flush_queue.mutex);
+  if(!flush_queue.prepared)
+    {
+      flush_queue.flushhow = flushhow;
+      flush_queue.passcounter = 0;
+      cache_content_flush_prepare(cachedir, grace_period, p_nb_too_young);
+      flush_queue.prepared = TRUE;
+    }
+  V(flush_queue.mutex);
+
+  nb_slots = cache_content_gc_policy.flush_outstanding;
+  if(nb_slots == 0)
+    nb_slots = 1;
+  if(nb_slots > CACHE_CONTENT_FLUSH_MAX_OUTSTANDING)
+    nb_slots = CACHE_CONTENT_FLUSH_MAX_OUTSTANDING;
+
+  for(i = 0; i < nb_slots; i++)
+    if((slots[i].buffer = (caddr_t) Mem_Alloc(CACHE_CONTENT_FLUSH_CHUNK)) == NULL)
+      break;
+
+  if((nb_slots = i) == 0)
+    {
+      *pstatus = CACHE_CONTENT_MALLOC_ERROR;
+      return *pstatus;
+    }
+
+  while((pjob = cache_content_flush_next_job(cachedir, lw_mark_trigger_flag,
+                                             &local_flushhow)) != NULL)
+    {
+      cache_content_get_datapath(cachedir, pjob->fileid, datapath);
+      cache_content_get_indexpath(cachedir, pjob->fileid, indexpath);
+
+      /* Nothing to copy for a clean entry */
+      if(pjob->clean)
+        {
+          if(local_flushhow == CACHE_CONTENT_FLUSH_AND_DELETE)
+            cache_content_flush_remove(indexpath, datapath);
+          continue;
+        }
+
+      LogFullDebug(COMPONENT_CACHE_CONTENT, "Flushing %s (%llu bytes)", datapath,
+                   (unsigned long long)pjob->size);
+
+#if defined( _USE_PROXY ) && defined( _BY_FILEID )
+      cache_content_flush_throttle((fsal_size_t) pjob->size);
+
+      fsal_status = FSAL_str2path(datapath, MAXPATHLEN, &fsal_path);
+      if(!FSAL_IS_ERROR(fsal_status))
+        fsal_status = FSAL_rcp_by_fileid(&pjob->handle, pjob->fileid, pcontext,
+                                         &fsal_path, FSAL_RCP_LOCAL_TO_FS);
+#else
+      fsal_status = cache_content_flush_stream(pjob, datapath, slots, nb_slots, pcontext);
+#endif
+
+      if(FSAL_IS_ERROR(fsal_status))
+        {
+          if((fsal_status.major == ERR_FSAL_NOENT) || (fsal_status.major == ERR_FSAL_STALE))
+            {
+              LogDebug(COMPONENT_CACHE_CONTENT,
+                       "Cached entry %llx doesn't exist anymore in FSAL, removing....",
+                       (unsigned long long)pjob->fileid);
+
+              if(p_nb_orphans != NULL)
+                *p_nb_orphans += 1;
+
+              cache_content_flush_remove(indexpath, datapath);
+            }
+          else
+            {
+              if(p_nb_errors != NULL)
+                *p_nb_errors += 1;
+
+              LogCrit(COMPONENT_CACHE_CONTENT,
+                      "Can't flush file #%llx, fsal_status.major=%u fsal_status.minor=%u",
+                      (unsigned long long)pjob->fileid, fsal_status.major,
+                      fsal_status.minor);
+            }
+          continue;
+        }
+
+      if(p_nb_flushed != NULL)
+        *p_nb_flushed += 1;
+
+      if(local_flushhow == CACHE_CONTENT_FLUSH_AND_DELETE)
+        cache_content_flush_remove(indexpath, datapath);
+    }
+
+  for(i = 0; i < nb_slots; i++)
+    Mem_Free(slots[i].buffer);
+
+  return *pstatus;
+}                               /* cache_content_flusher_run */
+
+/**
+ *
+ * cache_content_dirty_account: accounts for bytes written in the data cache.
+ *
+ * @param size [IN] number of bytes written.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_content_dirty_account(fsal_size_t size)
+{
+  __sync_add_and_fetch(&dirty_bytes, (u_int64_t) size);
+}                               /* cache_content_dirty_account */
+
+/**
+ *
+ * cache_content_dirty_bytes: gets the number of bytes not flushed yet.
+ *
+ * @return the number of bytes written in the data cache and not flushed yet.
+ *
+ */
+u_int64_t cache_content_dirty_bytes(void)
+{
+  return dirty_bytes;
+}                               /* cache_content_dirty_bytes */
+
+/**
+ *
+ * cache_content_dirty_drain: accounts for bytes flushed to the FSAL, wakes up throttled writers.
+ *
+ * @param size [IN] number of bytes flushed.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_content_dirty_drain(u_int64_t size)
+{
+  u_int64_t old;
+
+  do
+    {
+      old = dirty_bytes;
+    }
+  while(!__sync_bool_compare_and_swap(&dirty_bytes, old, (old > size) ? old - size : 0));
+
+  P(dirty_mutex);
+  pthread_cond_broadcast(&dirty_cond);
+  V(dirty_mutex);
+}                               /* cache_content_dirty_drain */
+
+/**
+ *
+ * cache_content_write_throttle: slows a writer down when too much data is waiting for flush.
+ *
+ * When the data written in the cache and not flushed yet goes over
+ * Dirty_Threshold, the garbage collector is asked to flush now, and the writer
+ * waits for the dirty data to go back under the threshold, but no more than
+ * CACHE_CONTENT_THROTTLE_MAX_DELAY milliseconds.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_content_write_throttle(void)
+{
+  u_int64_t threshold;
+  struct timeval now;
+  struct timespec deadline;
+
+  if(cache_content_gc_policy.dirty_threshold == 0)
+    return;
+
+  threshold = (u_int64_t) cache_content_gc_policy.dirty_threshold * 1024 * 1024;
+
+  if(dirty_bytes <= threshold)
+    return;
+
+  gettimeofday(&now, NULL);
+  deadline.tv_sec = now.tv_sec + CACHE_CONTENT_THROTTLE_MAX_DELAY / 1000;
+  deadline.tv_nsec = now.tv_usec * 1000 + (CACHE_CONTENT_THROTTLE_MAX_DELAY % 1000) * 1000000;
+  if(deadline.tv_nsec >= 1000000000)
+    {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+  LogFullDebug(COMPONENT_CACHE_CONTENT,
+               "Data cache has %llu dirty bytes, throttling write",
+               (unsigned long long)dirty_bytes);
+
+  P(dirty_mutex);
+
+  if(!flush_requested)
+    {
+      flush_requested = TRUE;
+      pthread_cond_signal(&flush_request_cond);
+    }
+
+  while(dirty_bytes > threshold)
+    if(pthread_cond_timedwait(&dirty_cond, &dirty_mutex, &deadline) == ETIMEDOUT)
+      break;
+
+  V(dirty_mutex);
+}                               /* cache_content_write_throttle */
+
+/**
+ *
+ * cache_content_flush_wait_request: waits for the next flush pass.
+ *
+ * @param seconds [IN] delay until the next periodic flush pass.
+ *
+ * @return TRUE if the flush pass was requested by throttled writers, FALSE otherwise.
+ *
+ */
+int cache_content_flush_wait_request(unsigned int seconds)
+{
+  struct timespec deadline;
+  int requested;
+
+  deadline.tv_sec = time(NULL) + seconds;
+  deadline.tv_nsec = 0;
+
+  P(dirty_mutex);
+
+  while(!flush_requested)
+    if(pthread_cond_timedwait(&flush_request_cond, &dirty_mutex, &deadline) == ETIMEDOUT)
+      break;
+
+  requested = flush_requested;
+  flush_requested = FALSE;
+
+  V(dirty_mutex);
+
+  return requested;
+}                               /* cache_content_flush_wait_request */
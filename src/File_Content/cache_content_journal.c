@@ -0,0 +1,784 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_content_journal.c
+ * \brief   Management of the file content cache: binary journal for crash recovery.
+ *
+ * cache_content_journal.c : Management of the file content cache: binary journal for crash recovery.
+ *
+ * Every change in the life of a data cache entry (creation, becoming dirty,
+ * becoming clean again, release) is appended as a fixed size record to a
+ * single journal file located in the cache directory. Crash recovery reads
+ * this file instead of crawling the cache directories and parsing one index
+ * file per entry. The GC thread compacts (checkpoints) the journal once
+ * CACHE_CONTENT_JOURNAL_CHECKPOINT records were appended, so that its size
+ * follows the number of live entries and not the history of the cache. The
+ * writers only wait for the records appended during the checkpoint to be
+ * copied to the new journal.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "stuff_alloc.h"
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "cache_content.h"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* The journal is shared by all the data cache clients (they use the same cache directory) */
+static pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int journal_fd = -1;
+static char journal_path[MAXPATHLEN];
+static off_t journal_size = 0;
+static u_int64_t journal_seq = 0;
+
+/* Serializes the checkpoints, held without journal_mutex for most of one */
+static pthread_mutex_t journal_checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static u_int64_t journal_checkpoint_records = 0;        /* records left by the last one */
+
+static void cache_content_journal_write(cache_content_journal_record_t * precord,
+                                        char *cache_dir);
+
+/**
+ *
+ * cache_content_journal_checksum: computes the checksum of a journal record.
+ *
+ * @param precord [IN] the record, its checksum field is ignored.
+ *
+ * @return the checksum (32 bits FNV-1a).
+ *
+ */
+static unsigned int cache_content_journal_checksum(cache_content_journal_record_t * precord)
+{
+  cache_content_journal_record_t tmp;
+  unsigned char *p = (unsigned char *)&tmp;
+  unsigned int hash = 2166136261U;
+  size_t i;
+
+  tmp = *precord;
+  tmp.checksum = 0;
+
+  for(i = 0; i < sizeof(tmp); i++)
+    {
+      hash ^= p[i];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}                               /* cache_content_journal_checksum */
+
+/**
+ *
+ * cache_content_journal_cmp: qsort's comparison for journal records (by fileid, then by seq).
+ *
+ */
+static int cache_content_journal_cmp(const void *a, const void *b)
+{
+  const cache_content_journal_record_t *ra = a;
+  const cache_content_journal_record_t *rb = b;
+
+  if(ra->fileid != rb->fileid)
+    return (ra->fileid < rb->fileid) ? -1 : 1;
+
+  if(ra->seq != rb->seq)
+    return (ra->seq < rb->seq) ? -1 : 1;
+
+  return 0;
+}                               /* cache_content_journal_cmp */
+
+/**
+ *
+ * cache_content_journal_valid_length: finds where the valid records of the journal end.
+ *
+ * A crash may leave whole records that were never written (zeroes, or the
+ * remains of an older content) at the end of the journal. The replay stops at
+ * the first of them, so the records appended after it would be lost.
+ *
+ * @param fd [IN] the journal, opened for reading.
+ * @param size [IN] size of the journal, a multiple of the record size.
+ *
+ * @return the offset of the first damaged record, size if there is none.
+ *
+ */
+static off_t cache_content_journal_valid_length(int fd, off_t size)
+{
+  cache_content_journal_record_t records[256];
+  off_t offset = 0;
+  ssize_t rc;
+  int nb;
+  int i;
+
+  while(offset < size &&
+        (rc = pread(fd, records, sizeof(records), offset)) >= (ssize_t) sizeof(records[0]))
+    {
+      nb = rc / sizeof(records[0]);
+
+      for(i = 0; i < nb; i++, offset += sizeof(records[0]))
+        if(records[i].magic != CACHE_CONTENT_JOURNAL_MAGIC ||
+           records[i].checksum != cache_content_journal_checksum(&records[i]))
+          return offset;
+    }
+
+  return offset;
+}                               /* cache_content_journal_valid_length */
+
+/**
+ *
+ * cache_content_journal_open: opens the journal for appending, if not already done.
+ *
+ * Journal's mutex is supposed to be held.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ *
+ * @return 0 if ok, -1 otherwise.
+ *
+ */
+static int cache_content_journal_open(char *cache_dir)
+{
+  struct stat buffstat;
+
+  if(journal_fd >= 0)
+    return 0;
+
+  snprintf(journal_path, MAXPATHLEN, "%s/%s", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+
+  if((journal_fd = open(journal_path, O_RDWR | O_CREAT | O_APPEND, 0640)) < 0)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't open data cache journal %s, errno=%u(%s)",
+              journal_path, errno, strerror(errno));
+      return -1;
+    }
+
+  if(fstat(journal_fd, &buffstat) != 0)
+    {
+      close(journal_fd);
+      journal_fd = -1;
+      return -1;
+    }
+
+  /* Records appended from now on come after what is already in the journal */
+  journal_size = buffstat.st_size - (buffstat.st_size % sizeof(cache_content_journal_record_t));
+  journal_size = cache_content_journal_valid_length(journal_fd, journal_size);
+  journal_seq = journal_size / sizeof(cache_content_journal_record_t);
+
+  /* Drop what a crash left damaged, new records must stay aligned and readable */
+  if(journal_size != buffstat.st_size && ftruncate(journal_fd, journal_size) != 0)
+    LogCrit(COMPONENT_CACHE_CONTENT,
+            "Can't truncate data cache journal %s, errno=%u(%s)",
+            journal_path, errno, strerror(errno));
+
+  return 0;
+}                               /* cache_content_journal_open */
+
+/**
+ *
+ * cache_content_journal_load: reads the journal and reduces it to the live entries.
+ *
+ * Reads every record in the journal, stops at the first damaged one (a record
+ * partially written at crash time), then keeps the last record of each fileid
+ * that was not released. The records appended after length bytes are not read.
+ *
+ * @param path [IN] path to the journal.
+ * @param length [IN] bytes of the journal to be read, -1 for all of them.
+ * @param pprecords [OUT] array of live records, sorted by fileid (to be freed with Mem_Free).
+ * @param pcount [OUT] number of records in *pprecords.
+ *
+ * @return 0 if ok, -1 otherwise (errno is ENOENT if there is no journal).
+ *
+ */
+static int cache_content_journal_load(char *path, off_t length,
+                                      cache_content_journal_record_t ** pprecords,
+                                      unsigned int *pcount)
+{
+  cache_content_journal_record_t *precords = NULL;
+  struct stat buffstat;
+  unsigned int nb_records;
+  unsigned int nb_valid;
+  unsigned int nb_live;
+  unsigned int i;
+  size_t done;
+  ssize_t rc;
+  int fd;
+
+  *pprecords = NULL;
+  *pcount = 0;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+
+  if(fstat(fd, &buffstat) != 0)
+    {
+      close(fd);
+      return -1;
+    }
+
+  if(length < 0 || length > buffstat.st_size)
+    length = buffstat.st_size;
+
+  nb_records = length / sizeof(cache_content_journal_record_t);
+
+  if(nb_records == 0)
+    {
+      close(fd);
+      return 0;
+    }
+
+  if((precords = (cache_content_journal_record_t *)
+      Mem_Alloc(nb_records * sizeof(cache_content_journal_record_t))) == NULL)
+    {
+      close(fd);
+      errno = ENOMEM;
+      return -1;
+    }
+
+  /* A single sequential read, whatever the number of entries */
+  for(done = 0; done < nb_records * sizeof(cache_content_journal_record_t); done += rc)
+    {
+      rc = read(fd, (char *)precords + done,
+                nb_records * sizeof(cache_content_journal_record_t) - done);
+
+      if(rc <= 0)
+        break;
+    }
+
+  close(fd);
+
+  nb_records = done / sizeof(cache_content_journal_record_t);
+
+  for(nb_valid = 0; nb_valid < nb_records; nb_valid++)
+    {
+      if(precords[nb_valid].magic != CACHE_CONTENT_JOURNAL_MAGIC ||
+         precords[nb_valid].checksum !=
+         cache_content_journal_checksum(&precords[nb_valid]))
+        {
+          LogEvent(COMPONENT_CACHE_CONTENT,
+                   "Data cache journal %s: record %u is damaged, ignoring it and the %u next ones",
+                   path, nb_valid, nb_records - nb_valid - 1);
+          break;
+        }
+    }
+
+  /* Keep the last record for each fileid, drop released entries */
+  qsort(precords, nb_valid, sizeof(cache_content_journal_record_t),
+        cache_content_journal_cmp);
+
+  for(i = 0, nb_live = 0; i < nb_valid; i++)
+    {
+      if(i + 1 < nb_valid && precords[i + 1].fileid == precords[i].fileid)
+        continue;
+
+      if(precords[i].op == CACHE_CONTENT_JOURNAL_RELEASE)
+        continue;
+
+      precords[nb_live++] = precords[i];
+    }
+
+  LogEvent(COMPONENT_CACHE_CONTENT,
+           "Data cache journal %s: %u records read, %u live entries",
+           path, nb_valid, nb_live);
+
+  if(nb_live == 0)
+    {
+      Mem_Free(precords);
+      return 0;
+    }
+
+  *pprecords = precords;
+  *pcount = nb_live;
+
+  return 0;
+}                               /* cache_content_journal_load */
+
+/**
+ *
+ * cache_content_journal_append: appends a record about a data cache entry to the journal.
+ *
+ * Appends a record about a data cache entry to the journal. Failing to journal
+ * is not fatal for the entry: it only means that it may not be recovered after
+ * a crash. Records marking an entry as dirty are synced to disk, since losing
+ * them could mean losing data that was never flushed to the FSAL.
+ *
+ * @param pentry [IN] entry in file content layer for this file.
+ * @param op [IN] the event to be journaled.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_content_journal_append(cache_content_entry_t * pentry,
+                                  cache_content_journal_op_t op,
+                                  cache_content_client_t * pclient)
+{
+  cache_content_journal_record_t record;
+  cache_inode_status_t cache_status;
+  fsal_handle_t *pfsal_handle;
+  unsigned long long fileid;
+  char *bname;
+
+  if(pentry == NULL || pentry->pentry_inode == NULL)
+    return;
+
+  /* The fileid is the one used for naming the data file */
+  if((bname = strrchr(pentry->local_fs_entry.cache_path_data, '/')) == NULL ||
+     sscanf(bname + 1, "node=%llx.data", &fileid) != 1)
+    return;
+
+  memset(&record, 0, sizeof(record));
+  record.magic = CACHE_CONTENT_JOURNAL_MAGIC;
+  record.op = op;
+  record.sync_state = pentry->local_fs_entry.sync_state;
+  record.fileid = (u_int64_t) fileid;
+  record.size = pentry->pentry_inode->object.file.attributes.filesize;
+  record.read_time = pentry->internal_md.read_time;
+  record.mod_time = pentry->internal_md.mod_time;
+  record.last_flush_time = pentry->internal_md.last_flush_time;
+
+  if((pfsal_handle = cache_inode_get_fsal_handle(pentry->pentry_inode,
+                                                 &cache_status)) != NULL)
+    record.handle = *pfsal_handle;
+
+  cache_content_journal_write(&record, pclient->cache_dir);
+}                               /* cache_content_journal_append */
+
+/**
+ *
+ * cache_content_journal_forget: journals the release of an entry that is not in the cache.
+ *
+ * Used at recovery time for journaled entries whose data file is gone.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ * @param fileid [IN] fileid of the entry.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_content_journal_forget(char *cache_dir, u_int64_t fileid)
+{
+  cache_content_journal_record_t record;
+
+  memset(&record, 0, sizeof(record));
+  record.magic = CACHE_CONTENT_JOURNAL_MAGIC;
+  record.op = CACHE_CONTENT_JOURNAL_RELEASE;
+  record.fileid = fileid;
+
+  cache_content_journal_write(&record, cache_dir);
+}                               /* cache_content_journal_forget */
+
+/**
+ *
+ * cache_content_journal_write: appends a record to the journal.
+ *
+ * @param precord [INOUT] the record, its seq and checksum are set here.
+ * @param cache_dir [IN] path to the data cache directory.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void cache_content_journal_write(cache_content_journal_record_t * precord,
+                                        char *cache_dir)
+{
+  ssize_t rc;
+
+  P(journal_mutex);
+
+  if(cache_content_journal_open(cache_dir) != 0)
+    {
+      V(journal_mutex);
+      return;
+    }
+
+  precord->seq = journal_seq++;
+  precord->checksum = cache_content_journal_checksum(precord);
+
+  if((rc = write(journal_fd, precord, sizeof(*precord))) != sizeof(*precord))
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't append to data cache journal %s, errno=%u(%s)",
+              journal_path, errno, strerror(errno));
+
+      /* Don't leave a partial record: it would hide the next ones at recovery */
+      if(rc > 0 && ftruncate(journal_fd, journal_size) != 0)
+        LogCrit(COMPONENT_CACHE_CONTENT,
+                "Can't truncate data cache journal %s, errno=%u(%s)",
+                journal_path, errno, strerror(errno));
+
+      V(journal_mutex);
+      return;
+    }
+
+  journal_size += sizeof(*precord);
+
+  if(precord->op == CACHE_CONTENT_JOURNAL_DIRTY)
+    fdatasync(journal_fd);
+
+  V(journal_mutex);
+}                               /* cache_content_journal_write */
+
+/**
+ *
+ * cache_content_journal_sync_dir: makes a rename in the data cache directory durable.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ *
+ * @return 0 if ok, -1 otherwise.
+ *
+ */
+static int cache_content_journal_sync_dir(char *cache_dir)
+{
+  int fd;
+  int rc;
+
+  if((fd = open(cache_dir, O_RDONLY)) < 0)
+    return -1;
+
+  rc = fsync(fd);
+  close(fd);
+
+  return rc;
+}                               /* cache_content_journal_sync_dir */
+
+/**
+ *
+ * cache_content_journal_copy_tail: copies the records appended during a checkpoint.
+ *
+ * The records are numbered after the ones of the checkpoint, a damaged record
+ * ends the copy as it would end the replay. Journal's mutex is supposed to be
+ * held.
+ *
+ * @param fd_old [IN] the journal being replaced.
+ * @param from [IN] offset of the first record to be copied.
+ * @param fd_new [IN] the checkpoint, opened for appending.
+ * @param seq [IN] seq of the first record copied.
+ *
+ * @return the number of records copied, -1 on error.
+ *
+ */
+static int cache_content_journal_copy_tail(int fd_old, off_t from, int fd_new, u_int64_t seq)
+{
+  cache_content_journal_record_t record;
+  int nb_copied = 0;
+
+  while(pread(fd_old, &record, sizeof(record), from) == sizeof(record))
+    {
+      if(record.magic != CACHE_CONTENT_JOURNAL_MAGIC ||
+         record.checksum != cache_content_journal_checksum(&record))
+        break;
+
+      record.seq = seq + nb_copied;
+      record.checksum = cache_content_journal_checksum(&record);
+
+      if(write(fd_new, &record, sizeof(record)) != sizeof(record))
+        return -1;
+
+      from += sizeof(record);
+      nb_copied++;
+    }
+
+  return nb_copied;
+}                               /* cache_content_journal_copy_tail */
+
+/**
+ *
+ * cache_content_journal_checkpoint: rewrites the journal with only the live entries.
+ *
+ * The records already in the journal are reduced and written to a new file
+ * while the writers go on appending to the old one. The records appended
+ * meanwhile are then copied, under journal's mutex, and the new file replaces
+ * the old one.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ *
+ * @return 0 if ok, -1 otherwise.
+ *
+ */
+int cache_content_journal_checkpoint(char *cache_dir)
+{
+  cache_content_journal_record_t *precords = NULL;
+  char path[MAXPATHLEN];
+  char tmppath[MAXPATHLEN];
+  struct stat buffstat;
+  unsigned int count = 0;
+  unsigned int i;
+  off_t base = 0;
+  size_t done;
+  ssize_t rc;
+  int nb_tail = 0;
+  int fd_old;
+  int fd;
+
+  snprintf(path, MAXPATHLEN, "%s/%s", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+  snprintf(tmppath, MAXPATHLEN, "%s/%s.tmp", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+
+  P(journal_checkpoint_mutex);
+
+  /* Only the checkpoints replace the journal, this is the one compacted */
+  if((fd_old = open(path, O_RDONLY)) >= 0 && fstat(fd_old, &buffstat) == 0)
+    base = buffstat.st_size - (buffstat.st_size % sizeof(cache_content_journal_record_t));
+
+  if(cache_content_journal_load(path, base, &precords, &count) != 0 && errno != ENOENT)
+    {
+      if(fd_old >= 0)
+        close(fd_old);
+      V(journal_checkpoint_mutex);
+      return -1;
+    }
+
+  if((fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0640)) < 0)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't create data cache journal checkpoint %s, errno=%u(%s)",
+              tmppath, errno, strerror(errno));
+      if(precords != NULL)
+        Mem_Free(precords);
+      if(fd_old >= 0)
+        close(fd_old);
+      V(journal_checkpoint_mutex);
+      return -1;
+    }
+
+  for(i = 0; i < count; i++)
+    {
+      precords[i].seq = i;
+      precords[i].checksum = cache_content_journal_checksum(&precords[i]);
+    }
+
+  for(done = 0, rc = 0; done < count * sizeof(cache_content_journal_record_t); done += rc)
+    {
+      rc = write(fd, (char *)precords + done,
+                 count * sizeof(cache_content_journal_record_t) - done);
+
+      if(rc <= 0)
+        break;
+    }
+
+  if(precords != NULL)
+    Mem_Free(precords);
+
+  if(done != count * sizeof(cache_content_journal_record_t) || fsync(fd) != 0)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't write data cache journal checkpoint %s, errno=%u(%s)",
+              tmppath, errno, strerror(errno));
+      close(fd);
+      unlink(tmppath);
+      if(fd_old >= 0)
+        close(fd_old);
+      V(journal_checkpoint_mutex);
+      return -1;
+    }
+
+  /* The writers wait from now on, only for the copy of what they appended */
+  P(journal_mutex);
+
+  if(fd_old >= 0 &&
+     ((nb_tail = cache_content_journal_copy_tail(fd_old, base, fd, count)) < 0 ||
+      (nb_tail > 0 && fdatasync(fd) != 0)))
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't write data cache journal checkpoint %s, errno=%u(%s)",
+              tmppath, errno, strerror(errno));
+      V(journal_mutex);
+      close(fd);
+      unlink(tmppath);
+      close(fd_old);
+      V(journal_checkpoint_mutex);
+      return -1;
+    }
+
+  close(fd);
+  if(fd_old >= 0)
+    close(fd_old);
+
+  if(rename(tmppath, path) != 0)
+    {
+      LogCrit(COMPONENT_CACHE_CONTENT,
+              "Can't install data cache journal checkpoint %s, errno=%u(%s)",
+              path, errno, strerror(errno));
+      V(journal_mutex);
+      unlink(tmppath);
+      V(journal_checkpoint_mutex);
+      return -1;
+    }
+
+  /* Otherwise the old journal may be back after a crash, without the DIRTY
+   * records appended since */
+  if(cache_content_journal_sync_dir(cache_dir) != 0)
+    LogCrit(COMPONENT_CACHE_CONTENT,
+            "Can't sync data cache directory %s, errno=%u(%s)",
+            cache_dir, errno, strerror(errno));
+
+  /* Appends now go to the new journal */
+  if(journal_fd >= 0)
+    {
+      close(journal_fd);
+      journal_fd = -1;
+    }
+
+  rc = cache_content_journal_open(cache_dir);
+
+  V(journal_mutex);
+
+  journal_checkpoint_records = count + nb_tail;
+
+  V(journal_checkpoint_mutex);
+
+  LogDebug(COMPONENT_CACHE_CONTENT,
+           "Data cache journal %s checkpointed, %u live entries, %d records appended meanwhile",
+           path, count, nb_tail);
+
+  return (int)rc;
+}                               /* cache_content_journal_checkpoint */
+
+/**
+ *
+ * cache_content_journal_checkpoint_due: tells if the journal has to be checkpointed.
+ *
+ * The size of the journal on disk is used, the records appended by the flush
+ * processes count too.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ *
+ * @return TRUE if CACHE_CONTENT_JOURNAL_CHECKPOINT records were appended since the last checkpoint.
+ *
+ */
+int cache_content_journal_checkpoint_due(char *cache_dir)
+{
+  char path[MAXPATHLEN];
+  struct stat buffstat;
+  u_int64_t last;
+
+  snprintf(path, MAXPATHLEN, "%s/%s", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+
+  if(stat(path, &buffstat) != 0)
+    return FALSE;
+
+  P(journal_checkpoint_mutex);
+  last = journal_checkpoint_records;
+  V(journal_checkpoint_mutex);
+
+  return (buffstat.st_size / sizeof(cache_content_journal_record_t) >=
+          last + CACHE_CONTENT_JOURNAL_CHECKPOINT);
+}                               /* cache_content_journal_checkpoint_due */
+
+/**
+ *
+ * cache_content_journal_flushed_bytes: sizes of the files flushed since a point of the journal.
+ *
+ * Sums the sizes of the files that became clean, or were released, in the
+ * records appended after *poffset, by this process or a flush process. The
+ * journal must not be checkpointed in between.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ * @param poffset [INOUT] where the previous call stopped, -1 to start at the end of the journal.
+ *
+ * @return the number of bytes flushed.
+ *
+ */
+u_int64_t cache_content_journal_flushed_bytes(char *cache_dir, off_t * poffset)
+{
+  cache_content_journal_record_t record;
+  char path[MAXPATHLEN];
+  struct stat buffstat;
+  u_int64_t flushed = 0;
+  int fd;
+
+  snprintf(path, MAXPATHLEN, "%s/%s", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return 0;
+
+  if(*poffset < 0)
+    {
+      if(fstat(fd, &buffstat) == 0)
+        *poffset = buffstat.st_size - (buffstat.st_size % sizeof(record));
+      close(fd);
+      return 0;
+    }
+
+  /* A record being written is read at the next call */
+  while(pread(fd, &record, sizeof(record), *poffset) == sizeof(record) &&
+        record.magic == CACHE_CONTENT_JOURNAL_MAGIC &&
+        record.checksum == cache_content_journal_checksum(&record))
+    {
+      if(record.op == CACHE_CONTENT_JOURNAL_CLEAN ||
+         record.op == CACHE_CONTENT_JOURNAL_RELEASE)
+        flushed += record.size;
+
+      *poffset += sizeof(record);
+    }
+
+  close(fd);
+
+  return flushed;
+}                               /* cache_content_journal_flushed_bytes */
+
+/**
+ *
+ * cache_content_journal_replay: gets the live data cache entries from the journal.
+ *
+ * @param cache_dir [IN] path to the data cache directory.
+ * @param pprecords [OUT] array of live records, sorted by fileid (to be freed with Mem_Free).
+ * @param pcount [OUT] number of records in *pprecords.
+ *
+ * @return 0 if ok, -1 otherwise (errno is ENOENT if there is no journal).
+ *
+ */
+int cache_content_journal_replay(char *cache_dir,
+                                 cache_content_journal_record_t ** pprecords,
+                                 unsigned int *pcount)
+{
+  char path[MAXPATHLEN];
+  int rc;
+
+  snprintf(path, MAXPATHLEN, "%s/%s", cache_dir, CACHE_CONTENT_JOURNAL_NAME);
+
+  P(journal_mutex);
+  rc = cache_content_journal_load(path, -1, pprecords, pcount);
+  V(journal_mutex);
+
+  return rc;
+}                               /* cache_content_journal_replay */
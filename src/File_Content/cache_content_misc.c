@@ -529,13 +529,23 @@ cache_content_status_t cache_content_valid(cache_content_entry_t * pentry,
     case CACHE_CONTENT_OP_SET:
       pentry->internal_md.mod_time = time(NULL);
       pentry->internal_md.refresh_time = pentry->internal_md.mod_time;
-      pentry->local_fs_entry.sync_state = FLUSH_NEEDED;
+      if(pentry->local_fs_entry.sync_state != FLUSH_NEEDED)
+        {
+          pentry->local_fs_entry.sync_state = FLUSH_NEEDED;
+          cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_DIRTY, pclient);
+        }
       break;
 
     case CACHE_CONTENT_OP_FLUSH:
       pentry->internal_md.mod_time = time(NULL);
       pentry->internal_md.refresh_time = pentry->internal_md.mod_time;
-      pentry->local_fs_entry.sync_state = SYNC_OK;
+      if(pentry->local_fs_entry.sync_state == FLUSH_NEEDED)
+        {
+          pentry->local_fs_entry.sync_state = SYNC_OK;
+          cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_CLEAN, pclient);
+        }
+      else
+        pentry->local_fs_entry.sync_state = SYNC_OK;
       break;
     }
 
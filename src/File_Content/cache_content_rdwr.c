@@ -363,6 +363,9 @@ cache_content_status_t cache_content_rdwr(cache_content_entry_t * pentry,
           return *pstatus;
         }
 
+      /* These bytes are now to be flushed */
+      cache_content_dirty_account((fsal_size_t) iosize_after);
+
       if((cache_content_status =
           cache_content_valid(pentry, CACHE_CONTENT_OP_SET,
                               pclient)) != CACHE_CONTENT_SUCCESS)
@@ -301,6 +301,18 @@ cache_content_status_t cache_content_read_conf_gc_policy(config_file_t in_config
         {
           ppolicy->emergency_grace_delay = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Flush_Bandwidth"))
+        {
+          ppolicy->flush_bandwidth = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Flush_Outstanding_Writes"))
+        {
+          ppolicy->flush_outstanding = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Dirty_Threshold"))
+        {
+          ppolicy->dirty_threshold = atoi(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -336,4 +348,9 @@ void cache_content_print_conf_gc_policy(FILE * output, cache_content_gc_policy_t
   fprintf(output, "Garbage Policy: Nb_Call_Before_GC     = %u\n",
           gcpolicy.nb_call_before_gc);
   fprintf(output, "Garbage Policy: Runtime_Interval      = %u\n", gcpolicy.run_interval);
+  fprintf(output, "Garbage Policy: Flush_Bandwidth       = %u MB/s\n",
+          gcpolicy.flush_bandwidth);
+  fprintf(output, "Garbage Policy: Flush_Outstanding     = %u\n", gcpolicy.flush_outstanding);
+  fprintf(output, "Garbage Policy: Dirty_Threshold       = %u MB\n",
+          gcpolicy.dirty_threshold);
 }                               /* cache_content_print_gc_pol */
@@ -86,6 +86,9 @@ cache_content_status_t cache_content_release_entry(cache_content_entry_t * pentr
   /* stat */
   pclient->stat.func_stats.nb_call[CACHE_CONTENT_RELEASE_ENTRY] += 1;
 
+  /* The entry won't have to be recovered after a crash */
+  cache_content_journal_append(pentry, CACHE_CONTENT_JOURNAL_RELEASE, pclient);
+
   /* Remove the link between the Cache Inode entry and the File Content entry */
   pentry->pentry_inode->object.file.pentry_content = NULL;
 
@@ -0,0 +1,292 @@
+/*
+ * Crash and replay tests of the data cache journal (cache_content_journal.c).
+ *
+ * Each start of the server is a child process that journals a few events
+ * and exits without any cleanup. Between two starts, the test damages the
+ * journal the way a crash at a bad time would have, then checks what the
+ * recovery would get from it.
+ *
+ * usage: test_cache_content_journal [<cache_dir>]
+ * (a new directory under /tmp is used if none is given)
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "stuff_alloc.h"
+#include "log_macros.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "cache_content.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if ((a) != (b)) {                         \
+      LogTest(msg, ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+#define RECORD_SIZE sizeof(cache_content_journal_record_t)
+
+static cache_content_client_t client;
+static fsal_handle_t handle;
+
+/* the journal only needs the handle of the cache inode entry */
+fsal_handle_t *cache_inode_get_fsal_handle(cache_entry_t * pentry,
+                                           cache_inode_status_t * pstatus)
+{
+  *pstatus = CACHE_INODE_SUCCESS;
+  return &handle;
+}
+
+static void journal(u_int64_t fileid, cache_content_journal_op_t op,
+                    cache_content_sync_state_t sync_state, u_int64_t size)
+{
+  cache_content_entry_t entry;
+  cache_entry_t inode;
+
+  memset(&entry, 0, sizeof(entry));
+  memset(&inode, 0, sizeof(inode));
+
+  inode.object.file.attributes.filesize = size;
+  entry.pentry_inode = &inode;
+  entry.local_fs_entry.sync_state = sync_state;
+  /* only the name of the data file is journaled */
+  snprintf(entry.local_fs_entry.cache_path_data, MAXPATHLEN, "export_id=0/%llx/node=%llx.data",
+           (unsigned long long)fileid, (unsigned long long)fileid);
+
+  cache_content_journal_append(&entry, op, &client);
+}
+
+/* runs one start of the server, the function is the life of the process */
+static void run(const char *name, void (*life) (void))
+{
+  pid_t pid;
+  int status;
+
+  pid = fork();
+  EQUALS((pid >= 0), 1, "fork: %s", strerror(errno));
+
+  if(pid == 0)
+    {
+      /* the memory manager of the parent is inherited */
+      life();
+      /* crash: nothing is closed */
+      _exit(0);
+    }
+
+  waitpid(pid, &status, 0);
+  EQUALS((WIFEXITED(status) && WEXITSTATUS(status) == 0), 1, "%s failed", name);
+}
+
+#define PATH_SIZE (MAXPATHLEN + sizeof(CACHE_CONTENT_JOURNAL_NAME) + 8)
+
+static void path_of(char *path, const char *suffix)
+{
+  snprintf(path, PATH_SIZE, "%s/%s%s", client.cache_dir, CACHE_CONTENT_JOURNAL_NAME,
+           suffix);
+}
+
+static off_t journal_size(void)
+{
+  char path[PATH_SIZE];
+  struct stat buffstat;
+
+  path_of(path, "");
+  EQUALS(stat(path, &buffstat), 0, "stat %s: %s", path, strerror(errno));
+
+  return buffstat.st_size;
+}
+
+/*
+ * Replays the journal as the recovery does, and checks the live entries.
+ * expected[] is sorted by fileid, as the replay is.
+ */
+typedef struct expected_entry__
+{
+  u_int64_t fileid;
+  cache_content_journal_op_t op;
+  cache_content_sync_state_t sync_state;
+  u_int64_t size;
+} expected_entry_t;
+
+static void check_replay(const char *step, expected_entry_t * expected, unsigned int nb)
+{
+  cache_content_journal_record_t *precords;
+  unsigned int count;
+  unsigned int i;
+
+  EQUALS(cache_content_journal_replay(client.cache_dir, &precords, &count), 0,
+         "%s: replay failed: %s", step, strerror(errno));
+  EQUALS(count, nb, "%s: %u live entries replayed, %u expected", step, count, nb);
+
+  for(i = 0; i < nb; i++)
+    {
+      EQUALS(precords[i].fileid, expected[i].fileid, "%s: entry %u is fileid %llu", step, i,
+             (unsigned long long)precords[i].fileid);
+      EQUALS(precords[i].op, expected[i].op, "%s: fileid %llu replayed with op %u", step,
+             (unsigned long long)expected[i].fileid, precords[i].op);
+      EQUALS(precords[i].sync_state, expected[i].sync_state,
+             "%s: fileid %llu replayed with sync state %u", step,
+             (unsigned long long)expected[i].fileid, precords[i].sync_state);
+      EQUALS(precords[i].size, expected[i].size, "%s: fileid %llu replayed with size %llu",
+             step, (unsigned long long)expected[i].fileid,
+             (unsigned long long)precords[i].size);
+    }
+
+  if(precords != NULL)
+    Mem_Free(precords);
+
+  LogTest("%s: OK", step);
+}
+
+static void first_life(void)
+{
+  u_int64_t fileid;
+
+  for(fileid = 1; fileid <= 5; fileid++)
+    journal(fileid, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0);
+
+  journal(3, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 4096);
+  journal(2, CACHE_CONTENT_JOURNAL_CLEAN, SYNC_OK, 512);
+}
+
+/*
+ * The server died while appending the release of fileid 2: the size of the
+ * file was updated, not its content (a whole record that is not valid), and
+ * the record after it was half written.
+ */
+static void tear_tail(void)
+{
+  cache_content_journal_record_t record;
+  char path[PATH_SIZE];
+  int fd;
+
+  memset(&record, 0, sizeof(record));
+  record.magic = CACHE_CONTENT_JOURNAL_MAGIC;
+  record.op = CACHE_CONTENT_JOURNAL_RELEASE;
+  record.fileid = 2;
+
+  path_of(path, "");
+  fd = open(path, O_WRONLY | O_APPEND);
+  EQUALS(write(fd, &record, sizeof(record)), sizeof(record), "can't write %s", path);
+  EQUALS(write(fd, &record, sizeof(record) / 2), sizeof(record) / 2, "can't write %s", path);
+  close(fd);
+}
+
+static void second_life(void)
+{
+  journal(4, CACHE_CONTENT_JOURNAL_RELEASE, SYNC_OK, 0);
+}
+
+/* a checkpoint died after writing its new journal, before the rename */
+static void leave_checkpoint_file(void)
+{
+  char path[PATH_SIZE];
+  char garbage[RECORD_SIZE + 10];
+  int fd;
+
+  path_of(path, ".tmp");
+  memset(garbage, 0xA5, sizeof(garbage));
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+  EQUALS(write(fd, garbage, sizeof(garbage)), sizeof(garbage), "can't write %s", path);
+  close(fd);
+}
+
+static void third_life(void)
+{
+  EQUALS(cache_content_journal_checkpoint(client.cache_dir), 0, "checkpoint failed");
+
+  /* goes to the new journal */
+  journal(5, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 100);
+}
+
+int main(int argc, char **argv)
+{
+  char tmpl[] = "/tmp/datacache_journal.XXXXXX";
+  char path[PATH_SIZE];
+  char *dir;
+
+  expected_entry_t after_crash[] = {
+    {1, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+    {2, CACHE_CONTENT_JOURNAL_CLEAN, SYNC_OK, 512},
+    {3, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 4096},
+    {4, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+    {5, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+  };
+  expected_entry_t after_release[] = {
+    {1, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+    {2, CACHE_CONTENT_JOURNAL_CLEAN, SYNC_OK, 512},
+    {3, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 4096},
+    {5, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+  };
+  expected_entry_t after_checkpoint[] = {
+    {1, CACHE_CONTENT_JOURNAL_ADD, JUST_CREATED, 0},
+    {2, CACHE_CONTENT_JOURNAL_CLEAN, SYNC_OK, 512},
+    {3, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 4096},
+    {5, CACHE_CONTENT_JOURNAL_DIRTY, FLUSH_NEEDED, 100},
+  };
+
+  SetDefaultLogging("TEST");
+  SetNamePgm("test_cache_content_journal");
+  InitLogging();
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  if(argc > 2)
+    {
+      LogTest("usage: test_cache_content_journal [<cache_dir>]");
+      exit(1);
+    }
+
+  if(argc == 2)
+    dir = argv[1];
+  else if((dir = mkdtemp(tmpl)) == NULL)
+    {
+      LogTest("mkdtemp: %s", strerror(errno));
+      exit(1);
+    }
+
+  strncpy(client.cache_dir, dir, MAXPATHLEN - 1);
+
+  /* a torn tail is not replayed, and does not hide what is appended after it */
+  run("first start", first_life);
+  tear_tail();
+  check_replay("replay after a torn record", after_crash, 5);
+
+  run("start after a torn record", second_life);
+  check_replay("replay of a record appended after a torn one", after_release, 4);
+  EQUALS(journal_size(), 8 * RECORD_SIZE, "the torn records should have been dropped");
+
+  /* the journal is the old one until the rename */
+  leave_checkpoint_file();
+  check_replay("replay with a checkpoint left unfinished", after_release, 4);
+
+  /* the renamed journal holds the live entries, then what came after */
+  run("start with a checkpoint", third_life);
+  path_of(path, ".tmp");
+  EQUALS(access(path, F_OK), -1, "%s should have been renamed", path);
+  EQUALS(journal_size(), 5 * RECORD_SIZE, "the checkpoint should hold the live entries only");
+  check_replay("replay after a checkpoint", after_checkpoint, 4);
+
+  if(argc == 1)
+    {
+      path_of(path, "");
+      unlink(path);
+      rmdir(dir);
+    }
+
+  LogTest("ALL DATA CACHE JOURNAL TESTS COMPLETED SUCCESSFULLY!!");
+  return 0;
+}
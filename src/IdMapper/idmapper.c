@@ -50,6 +50,10 @@
 #include <strings.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -88,119 +92,652 @@ int nfsidmap_set_conf()
 }
 #endif                          /* _USE_NFSIDMAP */
 
+/* Outcome of a lookup in the directory */
+#define IDMAP_RESOLVED 0
+#define IDMAP_UNKNOWN  1        /* the directory has no such user or group */
+#define IDMAP_ERROR    2        /* the directory could not be queried */
+
+/* Working area of the getpw* and getgr* functions */
+#define IDMAP_PWENT_BUFF_LEN 4096
+
+typedef enum idmap_direction__
+{
+  IDMAP_UID2NAME,
+  IDMAP_NAME2UID,
+  IDMAP_GID2NAME,
+  IDMAP_NAME2GID,
+  IDMAP_UID2GROUPS              /* group list of a user, see idmapper_groups.c */
+} idmap_direction_t;
+
+typedef struct idmap_request__
+{
+  idmap_direction_t direction;
+  unsigned int id;
+  char name[PWENT_MAX_LEN];
+} idmap_request_t;
+
+/* Expired mappings waiting for a resolver thread */
+static idmap_request_t idmap_refresh_queue[IDMAP_REFRESH_QUEUE_SIZE];
+static unsigned int idmap_refresh_head = 0;
+static unsigned int idmap_refresh_count = 0;
+static unsigned int idmap_nb_resolvers = 0;
+static pthread_mutex_t idmap_refresh_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idmap_refresh_cond = PTHREAD_COND_INITIALIZER;
+
+#define idmap_maptype_of( direction ) \
+  (((direction) == IDMAP_UID2NAME || (direction) == IDMAP_NAME2UID) ? UIDMAP_TYPE : GIDMAP_TYPE)
+
+#define idmap_param_of( maptype ) \
+  (((maptype) == UIDMAP_TYPE) ? &nfs_param.uidmap_cache_param : &nfs_param.gidmap_cache_param)
+
+/* getpw*_r and getgr*_r return one of these when the entry does not exist */
+#define idmap_not_found( rc ) \
+  ((rc) == 0 || (rc) == ENOENT || (rc) == ESRCH || (rc) == EBADF || (rc) == EPERM)
+
 /**
  *
- * uid2name: convert a uid to a name. 
+ * idmap_copy_name: copies a name into a fixed size buffer.
  *
- * convert a uid to a name. 
+ * The copy is always NUL terminated, a name that does not fit is not
+ * truncated: it would map to another user or group.
  *
- * @param name [OUT]  the name of the user
- * @param uid  [IN]   the input uid
+ * @param dest [OUT] the destination buffer.
+ * @param size [IN]  the size of dest.
+ * @param src  [IN]  the name to copy.
  *
- * return 1 if successful, 0 otherwise
+ * @return TRUE if the name was copied, FALSE if it is too long.
  *
  */
-int uid2name(char *name, uid_t * puid)
+static int idmap_copy_name(char *dest, size_t size, char *src)
 {
-  char fqname[NFS4_MAX_DOMAIN_LEN];
+  if(strlen(src) >= size)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "idmapper: name %s is longer than %llu characters",
+              src, (unsigned long long)(size - 1));
+      dest[0] = '\0';
+      return FALSE;
+    }
+
+  strncpy(dest, src, size - 1);
+  dest[size - 1] = '\0';
+
+  return TRUE;
+}                               /* idmap_copy_name */
 
 #ifdef _USE_NFSIDMAP
+/**
+ *
+ * idmap_qualify_name: builds name@domain into a fixed size buffer.
+ *
+ * @param dest [OUT] the destination buffer.
+ * @param size [IN]  the size of dest.
+ * @param name [IN]  the unqualified name.
+ *
+ * @return TRUE if the qualified name fits, FALSE otherwise.
+ *
+ */
+static int idmap_qualify_name(char *dest, size_t size, char *name)
+{
+  int len;
+
+  len = snprintf(dest, size, "%s@%s", name, idmap_domain);
+  if(len < 0 || (size_t) len >= size)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "idmapper: name %s@%s is longer than %llu characters",
+              name, idmap_domain, (unsigned long long)(size - 1));
+      dest[0] = '\0';
+      return FALSE;
+    }
+
+  return TRUE;
+}                               /* idmap_qualify_name */
+#endif                          /* _USE_NFSIDMAP */
 
+static int idmap_resolve_uid(uid_t uid, char *name)
+{
+#ifdef _USE_NFSIDMAP
+  char fqname[NFS4_MAX_DOMAIN_LEN];
   int rc;
 
-  if(!nfsidmap_set_conf())
+  rc = nfs4_uid_to_name(uid, idmap_domain, fqname, NFS4_MAX_DOMAIN_LEN);
+  if(rc != 0)
     {
-      LogCrit(COMPONENT_IDMAPPER,
-              "uid2name: nfsidmap_set_conf failed");
-      return 0;
+      LogDebug(COMPONENT_IDMAPPER,
+               "uid2name: nfs4_uid_to_name %d returned %d (%s)",
+               uid, -rc, strerror(-rc));
+      return (rc == -ENOENT) ? IDMAP_UNKNOWN : IDMAP_ERROR;
     }
 
-  if(unamemap_get(*puid, name) == ID_MAPPER_SUCCESS)
+  if(strchr(fqname, '@') == NULL)
     {
       LogFullDebug(COMPONENT_IDMAPPER,
-                   "uid2name: unamemap_get uid %d returned %s",
-                   *puid, name);
-      return 1;
+                   "uid2name: adding domain %s",
+                   idmap_domain);
+      if(!idmap_qualify_name(name, PWENT_MAX_LEN, fqname))
+        return IDMAP_UNKNOWN;
     }
-  else
-    {
-      rc = nfs4_uid_to_name(*puid, idmap_domain, name, NFS4_MAX_DOMAIN_LEN);
-      if(rc != 0)
-        {
-          LogDebug(COMPONENT_IDMAPPER,
-                   "uid2name: nfs4_uid_to_name %d returned %d (%s)",
-                   *puid, -rc, strerror(-rc));
-          return 0;
-        }
+  else if(!idmap_copy_name(name, PWENT_MAX_LEN, fqname))
+    return IDMAP_UNKNOWN;
 
-      strncpy(fqname, name, NFS4_MAX_DOMAIN_LEN);
-      if(strchr(name, '@') == NULL)
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "uid2name: adding domain %s",
-                       idmap_domain);
-          sprintf(fqname, "%s@%s", name, idmap_domain);
-          strncpy(name, fqname, NFS4_MAX_DOMAIN_LEN);
-        }
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "uid2name: nfs4_uid_to_name uid %d returned %s",
+               uid, name);
+#else
+  struct passwd p;
+  struct passwd *pp = NULL;
+  char buff[IDMAP_PWENT_BUFF_LEN];
+  int rc;
 
+#ifdef _SOLARIS
+  pp = getpwuid_r(uid, &p, buff, IDMAP_PWENT_BUFF_LEN);
+  rc = (pp == NULL) ? errno : 0;
+#else
+  rc = getpwuid_r(uid, &p, buff, IDMAP_PWENT_BUFF_LEN, &pp);
+#endif                          /* _SOLARIS */
+  if(pp == NULL)
+    {
       LogFullDebug(COMPONENT_IDMAPPER,
-                   "uid2name: nfs4_uid_to_name uid %d returned %s",
-                   *puid, name);
-
-      if(uidmap_add(fqname, *puid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "uid2name: uidmap_add %s %d failed",
-                  fqname, *puid);
-          return 0;
-        }
+                   "uid2name: getpwuid_r %d failed",
+                   uid);
+      return idmap_not_found(rc) ? IDMAP_UNKNOWN : IDMAP_ERROR;
     }
-  return 1;
 
+  if(!idmap_copy_name(name, PWENT_MAX_LEN, p.pw_name))
+    return IDMAP_UNKNOWN;
+
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "uid2name: getpwuid_r uid %d returned %s",
+               uid, name);
+#endif                          /* _USE_NFSIDMAP */
+
+  return IDMAP_RESOLVED;
+}                               /* idmap_resolve_uid */
+
+static int idmap_resolve_uname(char *name, uid_t * puid)
+{
+  struct passwd passwd;
+  struct passwd *ppasswd = NULL;
+  char buff[IDMAP_PWENT_BUFF_LEN];
+  int rc;
+#ifdef _USE_NFSIDMAP
+  char fqname[NFS4_MAX_DOMAIN_LEN];
+#endif
+#if defined( _USE_NFSIDMAP ) && defined( _HAVE_GSSAPI )
+  gid_t gss_gid;
+  uid_t gss_uid;
+#endif
+
+#ifdef _SOLARIS
+  ppasswd = getpwnam_r(name, &passwd, buff, IDMAP_PWENT_BUFF_LEN);
+  rc = (ppasswd == NULL) ? errno : 0;
 #else
-  struct passwd p;
-  struct passwd *pp;
-  char buff[NFS4_MAX_DOMAIN_LEN];
+  rc = getpwnam_r(name, &passwd, buff, IDMAP_PWENT_BUFF_LEN, &ppasswd);
+#endif                          /* _SOLARIS */
+  if(ppasswd != NULL)
+    {
+      *puid = passwd.pw_uid;
+#ifdef _HAVE_GSSAPI
+      if(uidgidmap_add(passwd.pw_uid, passwd.pw_gid) != ID_MAPPER_SUCCESS)
+        LogCrit(COMPONENT_IDMAPPER,
+                "name2uid: uidgidmap_add uid %d gid %d failed",
+                passwd.pw_uid, passwd.pw_gid);
+#endif                          /* _HAVE_GSSAPI */
+      return IDMAP_RESOLVED;
+    }
 
-  if(unamemap_get(*puid, name) == ID_MAPPER_SUCCESS)
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "name2uid: getpwnam_r %s failed",
+               name);
+
+#ifdef _USE_NFSIDMAP
+  /* obtain fully qualified name */
+  if(strchr(name, '@') == NULL)
+    {
+      if(!idmap_qualify_name(fqname, NFS4_MAX_DOMAIN_LEN, name))
+        return IDMAP_UNKNOWN;
+    }
+  else if(!idmap_copy_name(fqname, NFS4_MAX_DOMAIN_LEN, name))
+    return IDMAP_UNKNOWN;
+
+  rc = nfs4_name_to_uid(fqname, puid);
+  if(rc)
     {
       LogFullDebug(COMPONENT_IDMAPPER,
-                   "uid2name: unamemap_get uid %d returned %s",
-                   *puid, name);
-      return 1;
+                   "name2uid: nfs4_name_to_uid %s failed %d (%s)",
+                   fqname, -rc, strerror(-rc));
+      return (rc == -ENOENT) ? IDMAP_UNKNOWN : IDMAP_ERROR;
     }
-  else
+
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "name2uid: nfs4_name_to_uid %s returned %d",
+               fqname, *puid);
+
+#ifdef _HAVE_GSSAPI
+  /* nfs4_gss_princ_to_ids required to extract uid/gid from gss creds
+   * XXX: currently uses unqualified name as per libnfsidmap comments */
+  rc = nfs4_gss_princ_to_ids("krb5", name, &gss_uid, &gss_gid);
+  if(rc)
+    LogFullDebug(COMPONENT_IDMAPPER,
+                 "name2uid: nfs4_gss_princ_to_ids %s failed %d (%s)",
+                 name, -rc, strerror(-rc));
+  else if(uidgidmap_add(gss_uid, gss_gid) != ID_MAPPER_SUCCESS)
+    LogCrit(COMPONENT_IDMAPPER,
+            "name2uid: uidgidmap_add gss_uid %d gss_gid %d failed",
+            gss_uid, gss_gid);
+#endif                          /* _HAVE_GSSAPI */
+
+  return IDMAP_RESOLVED;
+#else
+  return idmap_not_found(rc) ? IDMAP_UNKNOWN : IDMAP_ERROR;
+#endif                          /* _USE_NFSIDMAP */
+}                               /* idmap_resolve_uname */
+
+static int idmap_resolve_gid(gid_t gid, char *name)
+{
+#ifdef _USE_NFSIDMAP
+  char fqname[NFS4_MAX_DOMAIN_LEN];
+  int rc;
+
+  rc = nfs4_gid_to_name(gid, idmap_domain, fqname, NFS4_MAX_DOMAIN_LEN);
+  if(rc != 0)
     {
+      LogDebug(COMPONENT_IDMAPPER,
+               "gid2name: nfs4_gid_to_name %d returned %d (%s)",
+               gid, -rc, strerror(-rc));
+      return (rc == -ENOENT) ? IDMAP_UNKNOWN : IDMAP_ERROR;
+    }
+
+  if(!idmap_copy_name(name, PWENT_MAX_LEN, fqname))
+    return IDMAP_UNKNOWN;
+
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "gid2name: nfs4_gid_to_name gid %d returned %s",
+               gid, name);
+#else
+  struct group g;
+  struct group *pg = NULL;
+  char buff[IDMAP_PWENT_BUFF_LEN];
+  int rc;
+
 #ifdef _SOLARIS
-      if(getpwuid_r(*puid, &p, buff, MAXPATHLEN) != 0)
+  pg = getgrgid_r(gid, &g, buff, IDMAP_PWENT_BUFF_LEN);
+  rc = (pg == NULL) ? errno : 0;
 #else
-      if((getpwuid_r(*puid, &p, buff, MAXPATHLEN, &pp) != 0) ||
-	 (pp == NULL))
+  rc = getgrgid_r(gid, &g, buff, IDMAP_PWENT_BUFF_LEN, &pg);
 #endif                          /* _SOLARIS */
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "uid2name: getpwuid_r %d failed",
-                       *puid);
-          return 0;
-        }
+  if(pg == NULL)
+    {
+      LogFullDebug(COMPONENT_IDMAPPER,
+                   "gid2name: getgrgid_r %d failed",
+                   gid);
+      return idmap_not_found(rc) ? IDMAP_UNKNOWN : IDMAP_ERROR;
+    }
+
+  if(!idmap_copy_name(name, PWENT_MAX_LEN, g.gr_name))
+    return IDMAP_UNKNOWN;
 
-      strncpy(name, p.pw_name, NFS4_MAX_DOMAIN_LEN);
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "gid2name: getgrgid_r gid %d returned %s",
+               gid, name);
+#endif                          /* _USE_NFSIDMAP */
 
+  return IDMAP_RESOLVED;
+}                               /* idmap_resolve_gid */
+
+static int idmap_resolve_gname(char *name, gid_t * pgid)
+{
+#ifdef _USE_NFSIDMAP
+  int rc;
+
+  rc = nfs4_name_to_gid(name, pgid);
+  if(rc)
+    {
+      LogFullDebug(COMPONENT_IDMAPPER,
+                   "name2gid: nfs4_name_to_gid %s failed %d (%s)",
+                   name, -rc, strerror(-rc));
+      return (rc == -ENOENT) ? IDMAP_UNKNOWN : IDMAP_ERROR;
+    }
+
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "name2gid: nfs4_name_to_gid %s returned %d",
+               name, *pgid);
+#else
+  struct group g;
+  struct group *pg = NULL;
+  char buff[IDMAP_PWENT_BUFF_LEN];
+  int rc;
+
+#ifdef _SOLARIS
+  pg = getgrnam_r(name, &g, buff, IDMAP_PWENT_BUFF_LEN);
+  rc = (pg == NULL) ? errno : 0;
+#else
+  rc = getgrnam_r(name, &g, buff, IDMAP_PWENT_BUFF_LEN, &pg);
+#endif
+  if(pg == NULL)
+    {
       LogFullDebug(COMPONENT_IDMAPPER,
-                   "uid2name: getpwuid_r uid %d returned %s",
-                   *puid, name);
+                   "name2gid: getgrnam_r %s failed",
+                   name);
+      return idmap_not_found(rc) ? IDMAP_UNKNOWN : IDMAP_ERROR;
+    }
+
+  *pgid = g.gr_gid;
+#endif                          /* _USE_NFSIDMAP */
+
+  return IDMAP_RESOLVED;
+}                               /* idmap_resolve_gname */
+
+/**
+ *
+ * idmap_resolve: looks a mapping up in the directory and caches the result.
+ *
+ * A mapping found is cached for Expiration seconds, a user or group that does
+ * not exist for Negative_Expiration seconds. When the directory could not be
+ * queried, nothing is cached: the next lookup asks again, and an expired
+ * mapping being refreshed is kept until the directory is back.
+ *
+ * @param preq       [IN]  the mapping looked up
+ * @param pentry     [OUT] the mapping found
+ * @param background [IN]  TRUE if called by a resolver thread
+ *
+ * @return IDMAP_RESOLVED, IDMAP_UNKNOWN or IDMAP_ERROR
+ *
+ */
+static int idmap_resolve(idmap_request_t * preq, idmap_entry_t * pentry, int background)
+{
+  idmap_type_t maptype = idmap_maptype_of(preq->direction);
+  nfs_idmap_cache_parameter_t *pparam = idmap_param_of(maptype);
+  struct timeval start;
+  struct timeval end;
+  unsigned int latency;
+  uid_t uid = 0;
+  gid_t gid = 0;
+  int rc = IDMAP_ERROR;
+
+  memset(pentry, 0, sizeof(idmap_entry_t));
+
+  gettimeofday(&start, NULL);
+
+  switch (preq->direction)
+    {
+    case IDMAP_UID2NAME:
+      rc = idmap_resolve_uid(preq->id, pentry->name);
+      pentry->id = preq->id;
+      break;
+
+    case IDMAP_NAME2UID:
+      rc = idmap_resolve_uname(preq->name, &uid);
+      memcpy(pentry->name, preq->name, PWENT_MAX_LEN);
+      pentry->id = uid;
+      break;
+
+    case IDMAP_GID2NAME:
+      rc = idmap_resolve_gid(preq->id, pentry->name);
+      pentry->id = preq->id;
+      break;
+
+    case IDMAP_NAME2GID:
+      rc = idmap_resolve_gname(preq->name, &gid);
+      memcpy(pentry->name, preq->name, PWENT_MAX_LEN);
+      pentry->id = gid;
+      break;
+
+    case IDMAP_UID2GROUPS:
+      /* The group lists are looked up by uid2grp_refresh */
+      return IDMAP_ERROR;
+    }
+
+  gettimeofday(&end, NULL);
+  latency = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+  idmap_cache_account_resolve(maptype, rc == IDMAP_RESOLVED, latency, background);
+
+  if(rc == IDMAP_RESOLVED)
+    {
+      if(pparam->expiration != 0)
+        pentry->expire = end.tv_sec + pparam->expiration;
+
+      if(idmap_cache_set(maptype, pentry->name, pentry->id, pentry->expire) !=
+         ID_MAPPER_SUCCESS)
+        LogCrit(COMPONENT_IDMAPPER,
+                "idmap_resolve: caching %s %lu failed",
+                pentry->name, pentry->id);
+    }
+  else if(pparam->negative_expiration != 0 && rc == IDMAP_UNKNOWN)
+    {
+      if(preq->direction == IDMAP_NAME2UID || preq->direction == IDMAP_NAME2GID)
+        idmap_cache_set_negative_name(maptype, preq->name,
+                                      end.tv_sec + pparam->negative_expiration);
+      else
+        idmap_cache_set_negative_id(maptype, preq->id,
+                                    end.tv_sec + pparam->negative_expiration);
+    }
 
-      if(uidmap_add(name, *puid) != ID_MAPPER_SUCCESS)
+  return rc;
+}                               /* idmap_resolve */
+
+/* Has an expired mapping refreshed by a resolver thread, the caller keeps
+ * using the old one meanwhile. Without resolver threads, it is refreshed at
+ * once. */
+static void idmap_refresh(idmap_request_t * preq)
+{
+  idmap_entry_t entry;
+
+  P(idmap_refresh_mutex);
+
+  if(idmap_nb_resolvers == 0)
+    {
+      V(idmap_refresh_mutex);
+      if(preq->direction == IDMAP_UID2GROUPS)
+        uid2grp_refresh(preq->id);
+      else
+        idmap_resolve(preq, &entry, TRUE);
+      return;
+    }
+
+  if(idmap_refresh_count == IDMAP_REFRESH_QUEUE_SIZE)
+    {
+      V(idmap_refresh_mutex);
+
+      /* The next use of the entry will ask again */
+      idmap_cache_account_dropped(idmap_maptype_of(preq->direction));
+      LogDebug(COMPONENT_IDMAPPER,
+               "idmap_refresh: refresh queue is full, refresh postponed");
+      return;
+    }
+
+  idmap_refresh_queue[(idmap_refresh_head + idmap_refresh_count) %
+                      IDMAP_REFRESH_QUEUE_SIZE] = *preq;
+  idmap_refresh_count++;
+
+  pthread_cond_signal(&idmap_refresh_cond);
+
+  V(idmap_refresh_mutex);
+}                               /* idmap_refresh */
+
+/**
+ *
+ * idmap_refresh_grouplist: has the expired group list of a user refreshed.
+ *
+ * @param uid [IN] the user
+ *
+ */
+void idmap_refresh_grouplist(uid_t uid)
+{
+  idmap_request_t request;
+
+  request.direction = IDMAP_UID2GROUPS;
+  request.id = uid;
+  request.name[0] = '\0';
+
+  idmap_refresh(&request);
+}                               /* idmap_refresh_grouplist */
+
+static void *idmap_resolver_thread(void *arg)
+{
+  idmap_request_t request;
+  idmap_entry_t entry;
+  char thr_name[32];
+
+  snprintf(thr_name, sizeof(thr_name), "idmap_resolver#%lu", (unsigned long)arg);
+  SetNameFunction(thr_name);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "Memory manager could not be initialized for the id mapper resolver");
+      return NULL;
+    }
+#endif
+
+  for(;;)
+    {
+      P(idmap_refresh_mutex);
+
+      while(idmap_refresh_count == 0)
+        pthread_cond_wait(&idmap_refresh_cond, &idmap_refresh_mutex);
+
+      request = idmap_refresh_queue[idmap_refresh_head];
+      idmap_refresh_head = (idmap_refresh_head + 1) % IDMAP_REFRESH_QUEUE_SIZE;
+      idmap_refresh_count--;
+
+      V(idmap_refresh_mutex);
+
+      if(request.direction == IDMAP_UID2GROUPS)
+        uid2grp_refresh(request.id);
+      else
+        idmap_resolve(&request, &entry, TRUE);
+    }
+
+  return NULL;
+}                               /* idmap_resolver_thread */
+
+/**
+ *
+ * idmap_resolver_init: starts the threads refreshing the expired mappings.
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_FAIL
+ *
+ */
+int idmap_resolver_init(void)
+{
+  pthread_attr_t attr_thr;
+  pthread_t thrid;
+  unsigned long i;
+  unsigned int nb_resolvers;
+  int rc;
+
+  nb_resolvers = nfs_param.uidmap_cache_param.nb_resolvers;
+  if(nfs_param.gidmap_cache_param.nb_resolvers > nb_resolvers)
+    nb_resolvers = nfs_param.gidmap_cache_param.nb_resolvers;
+
+  if(nb_resolvers == 0)
+    return ID_MAPPER_SUCCESS;
+
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < nb_resolvers; i++)
+    {
+      if((rc = pthread_create(&thrid, &attr_thr, idmap_resolver_thread, (void *)i)) != 0)
         {
           LogCrit(COMPONENT_IDMAPPER,
-                  "uid2name: uidmap_add %s %d failed",
-                  name, *puid);
-          return 0;
+                  "Could not create id mapper resolver thread #%lu, error = %d (%s)",
+                  i, rc, strerror(rc));
+          break;
         }
+
+      P(idmap_refresh_mutex);
+      idmap_nb_resolvers++;
+      V(idmap_refresh_mutex);
     }
 
-  return 1;
+  pthread_attr_destroy(&attr_thr);
+
+  LogInfo(COMPONENT_IDMAPPER,
+          "%u id mapper resolver threads started", idmap_nb_resolvers);
+
+  return (idmap_nb_resolvers == nb_resolvers) ? ID_MAPPER_SUCCESS : ID_MAPPER_FAIL;
+}                               /* idmap_resolver_init */
+
+/**
+ *
+ * idmap_lookup: gets a mapping from the cache, or else from the directory.
+ *
+ * An expired mapping is returned as is and refreshed in the background.
+ *
+ * @param preq   [IN]  the mapping looked up
+ * @param pentry [OUT] the mapping found
+ *
+ * return 1 if successful, 0 otherwise
+ *
+ */
+static int idmap_lookup(idmap_request_t * preq, idmap_entry_t * pentry)
+{
+  idmap_type_t maptype = idmap_maptype_of(preq->direction);
+  int refresh = FALSE;
+  int rc;
+
+  if(preq->direction == IDMAP_NAME2UID || preq->direction == IDMAP_NAME2GID)
+    rc = idmap_cache_get_name(maptype, preq->name, pentry, &refresh);
+  else
+    rc = idmap_cache_get_id(maptype, preq->id, pentry, &refresh);
+
+  if(rc == ID_MAPPER_SUCCESS)
+    {
+      if(refresh)
+        idmap_refresh(preq);
+
+      return pentry->negative ? 0 : 1;
+    }
+
+  return (idmap_resolve(preq, pentry, FALSE) == IDMAP_RESOLVED) ? 1 : 0;
+}                               /* idmap_lookup */
+
+/**
+ *
+ * uid2name: convert a uid to a name. 
+ *
+ * convert a uid to a name. 
+ *
+ * @param name [OUT]  the name of the user
+ * @param uid  [IN]   the input uid
+ *
+ * return 1 if successful, 0 otherwise
+ *
+ */
+int uid2name(char *name, uid_t * puid)
+{
+  idmap_request_t request;
+  idmap_entry_t entry;
+
+#ifdef _USE_NFSIDMAP
+  if(!nfsidmap_set_conf())
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "uid2name: nfsidmap_set_conf failed");
+      return 0;
+    }
 #endif                          /* _USE_NFSIDMAP */
+
+  request.direction = IDMAP_UID2NAME;
+  request.id = *puid;
+
+  if(!idmap_lookup(&request, &entry))
+    return 0;
+
+  strncpy(name, entry.name, NFS4_MAX_DOMAIN_LEN - 1);
+  name[NFS4_MAX_DOMAIN_LEN - 1] = '\0';
+
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "uid2name: uid %d mapped to %s",
+               *puid, name);
+
+  return 1;
 }                               /* uid2name */
 
 /**
@@ -217,18 +754,8 @@ int uid2name(char *name, uid_t * puid)
  */
 int name2uid(char *name, uid_t * puid)
 {
-  struct passwd passwd;
-  struct passwd *ppasswd;
-  char buff[NFS4_MAX_DOMAIN_LEN];
-  uid_t uid;
-#ifdef _HAVE_GSSAPI
-  gid_t gss_gid;
-  uid_t gss_uid;
-#endif
-#ifdef _USE_NFSIDMAP
-  char fqname[NFS4_MAX_DOMAIN_LEN];
-  int rc;
-#endif
+  idmap_request_t request;
+  idmap_entry_t entry;
 
   /* NFsv4 specific features: RPCSEC_GSS will provide user like nfs/<host>
    * choice is made to map them to root */
@@ -243,111 +770,34 @@ int name2uid(char *name, uid_t * puid)
       return 1;
     }
 
-  if(uidmap_get(name, (unsigned long *)&uid) == ID_MAPPER_SUCCESS)
+#ifdef _USE_NFSIDMAP
+  if(!nfsidmap_set_conf())
     {
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "name2uid: uidmap_get mapped %s to uid= %d",
-                   name, uid);
-      *puid = uid;
-
-      return 1 ;
+      LogCrit(COMPONENT_IDMAPPER,
+              "name2uid: nfsidmap_set_conf failed");
+      return 0;
     }
-  else
-    {
-#ifdef _SOLARIS
-      if(getpwnam_r(name, &passwd, buff, NFS4_MAX_DOMAIN_LEN) != 0)
-#else
-      if(getpwnam_r(name, &passwd, buff, NFS4_MAX_DOMAIN_LEN, &ppasswd) != 0)
-#endif                          /* _SOLARIS */
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "name2uid: getpwnam_r %s failed",
-                       name);
-          *puid = -1;
-          return 0;
-        }
-      else
-        {
-          *puid = passwd.pw_uid;
-#ifdef _HAVE_GSSAPI
-          if(uidgidmap_add(passwd.pw_uid, passwd.pw_gid) != ID_MAPPER_SUCCESS)
-            {
-              LogCrit(COMPONENT_IDMAPPER,
-                      "name2uid: uidgidmap_add gss_uid %d gss_gid %d failed",
-                      gss_uid, gss_gid);
-              return 0;
-            }
-#endif                          /* _HAVE_GSSAPI */
-          if(uidmap_add(name, passwd.pw_uid) != ID_MAPPER_SUCCESS)
-            {
-              LogCrit(COMPONENT_IDMAPPER,
-                      "name2uid: uidmap_add %s %d failed",
-                      name, passwd.pw_uid);
-              return 0;
-            }
-
-           return 1 ; /* Job is done */
-        }
-
-#ifdef _USE_NFSIDMAP
-      if(!nfsidmap_set_conf())
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "name2uid: nfsidmap_set_conf failed");
-          return 0;
-        }
-
-      /* obtain fully qualified name */
-      if(strchr(name, '@') == NULL)
-        sprintf(fqname, "%s@%s", name, idmap_domain);
-      else
-        strncpy(fqname, name, NFS4_MAX_DOMAIN_LEN - 1);
-
-      rc = nfs4_name_to_uid(fqname, puid);
-      if(rc)
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "name2uid: nfs4_name_to_uid %s failed %d (%s)",
-                       fqname, -rc, strerror(-rc));
-          return 0;
-        }
-
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "name2uid: nfs4_name_to_uid %s returned %d",
-                   fqname, *puid);
-
-      if(uidmap_add(fqname, *puid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "name2uid: uidmap_add %s %d failed",
-                  fqname, *puid);
-          return 0;
-        }
+#endif                          /* _USE_NFSIDMAP */
 
-#ifdef _HAVE_GSSAPI
-      /* nfs4_gss_princ_to_ids required to extract uid/gid from gss creds
-       * XXX: currently uses unqualified name as per libnfsidmap comments */
-      rc = nfs4_gss_princ_to_ids("krb5", name, &gss_uid, &gss_gid);
-      if(rc)
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "name2uid: nfs4_gss_princ_to_ids %s failed %d (%s)",
-                       name, -rc, strerror(-rc));
-          return 0;
-        }
+  request.direction = IDMAP_NAME2UID;
+  memset(request.name, 0, PWENT_MAX_LEN);
+  if(!idmap_copy_name(request.name, PWENT_MAX_LEN, name))
+    {
+      *puid = -1;
+      return 0;
+    }
 
-      if(uidgidmap_add(gss_uid, gss_gid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "name2uid: uidgidmap_add gss_uid %d gss_gid %d failed",
-                  gss_uid, gss_gid);
-          return 0;
-        }
-#endif                          /* _HAVE_GSSAPI */
+  if(!idmap_lookup(&request, &entry))
+    {
+      *puid = -1;
+      return 0;
+    }
 
-#endif                           /* _USE_NFSIDMAP */
+  *puid = entry.id;
 
-    }
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "name2uid: %s mapped to uid= %d",
+               name, *puid);
 
   return 1;
 }                               /* name2uid */
@@ -430,97 +880,32 @@ int principal2uid(char *principal, uid_t * puid)
  */
 int gid2name(char *name, gid_t * pgid)
 {
-#ifndef _USE_NFSIDMAP
-  struct group g;
-#ifndef _SOLARIS
-  struct group *pg = NULL;
-#endif
-  static char buff[NFS4_MAX_DOMAIN_LEN]; /* Working area for getgrnam_r */
-#endif
+  idmap_request_t request;
+  idmap_entry_t entry;
 
 #ifdef _USE_NFSIDMAP
-  int rc;
-
-  if(gnamemap_get(*pgid, name) == ID_MAPPER_SUCCESS)
-    {
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "gid2name: unamemap_get gid %d returned %s",
-                   *pgid, name);
-      return 1;
-    }
-  else
+  if(!nfsidmap_set_conf())
     {
-      if(!nfsidmap_set_conf())
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "gid2name: nfsidmap_set_conf failed");
-          return 0;
-        }
-
-      rc = nfs4_gid_to_name(*pgid, idmap_domain, name, NFS4_MAX_DOMAIN_LEN);
-      if(rc != 0)
-        {
-          LogDebug(COMPONENT_IDMAPPER,
-                   "gid2name: nfs4_gid_to_name %d returned %d (%s)",
-                   *pgid, -rc, strerror(-rc));
-          return 0;
-        }
-
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "gid2name: nfs4_gid_to_name gid %d returned %s",
-                   *pgid, name);
-
-      if(gidmap_add(name, *pgid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "gid2name: gidmap_add %s %d failed",
-                  name, *pgid);
-          return 0;
-        }
+      LogCrit(COMPONENT_IDMAPPER,
+              "gid2name: nfsidmap_set_conf failed");
+      return 0;
     }
+#endif                          /* _USE_NFSIDMAP */
 
-  return 1;
+  request.direction = IDMAP_GID2NAME;
+  request.id = *pgid;
 
-#else
-  if(gnamemap_get(*pgid, name) == ID_MAPPER_SUCCESS)
-    {
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "gid2name: gnamemap_get gid %d returned %s",
-                   *pgid, name);
-      return 1;
-    }
-  else
-    {
-#ifdef _SOLARIS
-      if(getgrgid_r(*pgid, &g, buff, NFS4_MAX_DOMAIN_LEN) != 0)
-#else
-      if((getgrgid_r(*pgid, &g, buff, NFS4_MAX_DOMAIN_LEN, &pg) != 0) ||
-	 (pg == NULL))
-#endif                          /* _SOLARIS */
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "gid2name: getgrgid_r %d failed",
-                       *pgid);
-          return 0;
-        }
+  if(!idmap_lookup(&request, &entry))
+    return 0;
 
-      strncpy(name, g.gr_name, NFS4_MAX_DOMAIN_LEN);
+  strncpy(name, entry.name, NFS4_MAX_DOMAIN_LEN - 1);
+  name[NFS4_MAX_DOMAIN_LEN - 1] = '\0';
 
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "gid2name: getgrgid_r gid %d returned %s",
-                   *pgid, name);
-
-      if(gidmap_add(name, *pgid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "gid2name: gidmap_add %s %d failed",
-                  name, *pgid);
-          return 0;
-        }
-    }
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "gid2name: gid %d mapped to %s",
+               *pgid, name);
 
   return 1;
-#endif                          /* _USE_NFSIDMAP */
 }                               /* gid2name */
 
 /**
@@ -537,83 +922,38 @@ int gid2name(char *name, gid_t * pgid)
  */
 int name2gid(char *name, gid_t * pgid)
 {
-#ifndef _USE_NFSIDMAP
-  struct group g;
-#ifndef _SOLARIS
-  struct group *pg = NULL;
-#endif
-  static char buff[NFS4_MAX_DOMAIN_LEN]; /* Working area for getgrnam_r */
-#endif
-  gid_t gid;
-  int rc;
+  idmap_request_t request;
+  idmap_entry_t entry;
 
-  if(gidmap_get(name, (unsigned long *)&gid) == ID_MAPPER_SUCCESS)
+#ifdef _USE_NFSIDMAP
+  if(!nfsidmap_set_conf())
     {
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "name2gid: gidmap_get mapped %s to gid= %d",
-                   name, gid);
-      *pgid = gid;
+      LogCrit(COMPONENT_IDMAPPER,
+              "name2gid: nfsidmap_set_conf failed");
+      return 0;
     }
-  else
-    {
-#ifdef _USE_NFSIDMAP
-      if(!nfsidmap_set_conf())
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "name2gid: nfsidmap_set_conf failed");
-          return 0;
-        }
-
-      rc = nfs4_name_to_gid(name, pgid);
-      if(rc)
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "name2gid: nfs4_name_to_gid %s failed %d (%s)",
-                       name, -rc, strerror(-rc));
-          return 0;
-        }
-
-      LogFullDebug(COMPONENT_IDMAPPER,
-                   "name2gid: nfs4_name_to_gid %s returned %d",
-                   name, *pgid);
+#endif                          /* _USE_NFSIDMAP */
 
-      if(gidmap_add(name, *pgid) != ID_MAPPER_SUCCESS)
-        {
-          LogCrit(COMPONENT_IDMAPPER,
-                  "name2gid: gidmap_add %s %d failed",
-                  name, *pgid);
-          return 0;
-        }
+  request.direction = IDMAP_NAME2GID;
+  memset(request.name, 0, PWENT_MAX_LEN);
+  if(!idmap_copy_name(request.name, PWENT_MAX_LEN, name))
+    {
+      *pgid = -1;
+      return 0;
+    }
 
-#else
+  if(!idmap_lookup(&request, &entry))
+    {
+      *pgid = -1;
+      return 0;
+    }
 
-#ifdef _SOLARIS
-      if(getgrnam_r(name, &g, buff, NFS4_MAX_DOMAIN_LEN) != 0)
-#else
-      if(getgrnam_r(name, &g, buff, NFS4_MAX_DOMAIN_LEN, &pg) != 0)
-#endif
-        {
-          LogFullDebug(COMPONENT_IDMAPPER,
-                       "name2gid: getgrnam_r %s failed",
-                       name);
-          *pgid = -1;
-          return 0;
-        }
-      else
-        {
-          *pgid = g.gr_gid;
+  *pgid = entry.id;
 
-          if(gidmap_add(name, g.gr_gid) != ID_MAPPER_SUCCESS)
-            {
-              LogCrit(COMPONENT_IDMAPPER,
-                      "name2gid: gidmap_add %s %d failed",
-                      name, g.gr_gid);
-              return 0;
-            }
+  LogFullDebug(COMPONENT_IDMAPPER,
+               "name2gid: %s mapped to gid= %d",
+               name, *pgid);
 
-        }
-#endif                          /* _USE_NFSIDMAP */
-    }
   return 1;
 }                               /* name2gid */
 
@@ -783,7 +1123,8 @@ int utf82uid(utf8string * utf8str, uid_t * Uid)
   /* User is shown as a string 'user@domain', remove it if libnfsidmap is not used */
   nfs4_stringid_split(buff, uidname, domainname);
 #else
-  strncpy(uidname, buff, NFS4_MAX_DOMAIN_LEN);
+  strncpy(uidname, buff, NFS4_MAX_DOMAIN_LEN - 1);
+  uidname[NFS4_MAX_DOMAIN_LEN - 1] = '\0';
 #endif
 
   rc = name2uid(uidname, Uid);
@@ -835,7 +1176,8 @@ int utf82gid(utf8string * utf8str, gid_t * Gid)
   /* Group is shown as a string 'group@domain' , remove it if libnfsidmap is not used */
   nfs4_stringid_split(buff, gidname, domainname);
 #else
-  strncpy(gidname, buff, NFS4_MAX_DOMAIN_LEN);
+  strncpy(gidname, buff, NFS4_MAX_DOMAIN_LEN - 1);
+  gidname[NFS4_MAX_DOMAIN_LEN - 1] = '\0';
 #endif
 
   rc = name2gid(gidname, Gid);
@@ -43,6 +43,7 @@
 
 #include "HashData.h"
 #include "HashTable.h"
+#include "RW_Lock.h"
 #include "log_macros.h"
 #include "stuff_alloc.h"
 #include "nfs_core.h"
@@ -51,6 +52,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <stdio.h>
+#include <time.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -67,6 +70,25 @@ hash_table_t *ht_pwuid;
 hash_table_t *ht_grgid;
 hash_table_t *ht_uidgid;
 
+/* Do not ask again for the refresh of an expired mapping before that (s) */
+#define IDMAP_REFRESH_RETRY 30
+
+/* Protects the content of the entries, which are updated in place, and the
+ * statistics */
+static pthread_mutex_t idmap_entry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Held for read from HashTable_Get until the entry is no longer used, for
+ * write to free entries (the export reloads clear the tables) */
+static rw_lock_t idmap_entries_lock;
+static idmap_cache_stat_t idmap_cache_stat[2];
+
+#define idmap_stat_of( maptype ) (&idmap_cache_stat[(maptype) == GIDMAP_TYPE])
+
+#ifdef _USE_NFSIDMAP
+extern char idmap_domain[NFS4_MAX_DOMAIN_LEN];
+int nfsidmap_set_conf();
+#endif
+
 /**
  *
  * idmapper_rbt_hash_func: computes the hash value for the entry in id mapper stuff
@@ -197,6 +219,30 @@ int display_idmapper_val(hash_buffer_t * pbuff, char *str)
   return sprintf(str, "%lu", (unsigned long)(pbuff->pdata));
 }                               /* display_idmapper_val */
 
+/**
+ *
+ * display_idmapper_entry: displays the mapping stored in the buffer.
+ *
+ * Displays the mapping stored in the buffer. This function is to be used as 'val_to_str' field in
+ * the hashtable storing the id mapper stuff
+ *
+ * @param buff1 [IN]  buffer to display
+ * @param buff2 [OUT] output string
+ *
+ * @return number of character written.
+ *
+ */
+int display_idmapper_entry(hash_buffer_t * pbuff, char *str)
+{
+  idmap_entry_t *pentry = (idmap_entry_t *) pbuff->pdata;
+
+  if(pentry->negative)
+    return sprintf(str, "(negative) expire=%ld", (long)pentry->expire);
+
+  return sprintf(str, "%s=%lu expire=%ld", pentry->name, pentry->id,
+                 (long)pentry->expire);
+}                               /* display_idmapper_entry */
+
 /**
  *
  * idmap_uid_init: Inits the hashtable for UID mapping.
@@ -210,6 +256,13 @@ int display_idmapper_val(hash_buffer_t * pbuff, char *str)
  */
 int idmap_uid_init(nfs_idmap_cache_parameter_t param)
 {
+  if(rw_lock_init(&idmap_entries_lock) != 0)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "NFS ID MAPPER: Cannot init the IDMAP entries lock");
+      return -1;
+    }
+
   if((ht_pwnam = HashTable_Init(param.hash_param)) == NULL)
     {
       LogCrit(COMPONENT_IDMAPPER,
@@ -393,78 +446,143 @@ int ___idmap_compute_hash_value(char *name, uint32_t * phashval)
 
 /**
  *
- * idmap_add: Adds a value by key
+ * idmap_store: sets the entry stored under a key.
  *
- * Adss a value by key.
+ * Sets the entry stored under a key. The key of the name tables is copied if a
+ * new entry is inserted. An existing entry is updated in place if overwrite is
+ * set and the entry expires, and left as is otherwise.
  *
- * @param ht       [INOUT] the hash table to be used
- * @param key      [IN]  the ip address requested
- * @param val      [OUT] the value
+ * @param ht         [INOUT] the hash table to be used
+ * @param pbuffkey   [IN]    the key
+ * @param string_key [IN]    TRUE if the key is a name, FALSE if it is an id
+ * @param pvalue     [IN]    the mapping to be stored
+ * @param overwrite  [IN]    TRUE if an existing mapping is replaced
  *
- * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR, ID_MAPPER_INVALID_ARGUMENT
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR
  *
  */
-int idmap_add(hash_table_t * ht, char *key, unsigned int val)
+static int idmap_store(hash_table_t * ht, hash_buffer_t * pbuffkey, int string_key,
+                       idmap_entry_t * pvalue, int overwrite)
 {
   hash_buffer_t buffkey;
   hash_buffer_t buffdata;
+  idmap_entry_t *pentry;
   int rc;
-  unsigned long local_val = (unsigned long)val;
 
-  if(ht == NULL || key == NULL)
-    return ID_MAPPER_INVALID_ARGUMENT;
+  P_r(&idmap_entries_lock);
+  if(HashTable_Get(ht, pbuffkey, &buffdata) == HASHTABLE_SUCCESS)
+    {
+      /* The mappings that never expire (map file, GSS principals) stay */
+      if(overwrite)
+        {
+          pentry = (idmap_entry_t *) buffdata.pdata;
+
+          P(idmap_entry_mutex);
+          if(pentry->expire != 0)
+            *pentry = *pvalue;
+          V(idmap_entry_mutex);
+        }
+
+      V_r(&idmap_entries_lock);
+      return ID_MAPPER_SUCCESS;
+    }
+  V_r(&idmap_entries_lock);
 
-  if((buffkey.pdata = (caddr_t) Mem_Alloc(PWENT_MAX_LEN)) == NULL)
+  if((pentry = (idmap_entry_t *) Mem_Alloc(sizeof(idmap_entry_t))) == NULL)
     return ID_MAPPER_INSERT_MALLOC_ERROR;
 
+  *pentry = *pvalue;
+
   /* Build the key */
-  strncpy((char *)(buffkey.pdata), key, PWENT_MAX_LEN);
-  buffkey.len = PWENT_MAX_LEN;
+  buffkey = *pbuffkey;
+  if(string_key)
+    {
+      if((buffkey.pdata = (caddr_t) Mem_Alloc(PWENT_MAX_LEN)) == NULL)
+        {
+          Mem_Free(pentry);
+          return ID_MAPPER_INSERT_MALLOC_ERROR;
+        }
+      strncpy((char *)(buffkey.pdata), (char *)(pbuffkey->pdata), PWENT_MAX_LEN);
+    }
 
   /* Build the value */
-  buffdata.pdata = (caddr_t) local_val;
-  buffdata.len = sizeof(unsigned long);
-  LogFullDebug(COMPONENT_IDMAPPER, "Adding the following principal->uid mapping: %s->%lu",
-	       (char *)buffkey.pdata, (unsigned long int)buffdata.pdata);
+  buffdata.pdata = (caddr_t) pentry;
+  buffdata.len = sizeof(idmap_entry_t);
+
   rc = HashTable_Test_And_Set(ht, &buffkey, &buffdata,
                               HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
 
-  if(rc != HASHTABLE_SUCCESS && rc != HASHTABLE_ERROR_KEY_ALREADY_EXISTS)
+  if(rc == HASHTABLE_SUCCESS)
+    return ID_MAPPER_SUCCESS;
+
+  if(string_key)
+    Mem_Free(buffkey.pdata);
+  Mem_Free(pentry);
+
+  if(rc != HASHTABLE_ERROR_KEY_ALREADY_EXISTS)
     return ID_MAPPER_INSERT_MALLOC_ERROR;
 
+  /* Another thread inserted the key in the meantime */
+  if(overwrite)
+    return idmap_store(ht, pbuffkey, string_key, pvalue, overwrite);
+
   return ID_MAPPER_SUCCESS;
+}                               /* idmap_store */
+
+/**
+ *
+ * idmap_add: Adds a value by key
+ *
+ * Adss a value by key. The mapping never expires and an existing one is kept.
+ *
+ * @param ht       [INOUT] the hash table to be used
+ * @param key      [IN]  the ip address requested
+ * @param val      [OUT] the value
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_add(hash_table_t * ht, char *key, unsigned int val)
+{
+  hash_buffer_t buffkey;
+  idmap_entry_t entry;
+
+  if(ht == NULL || key == NULL)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  buffkey.pdata = (caddr_t) key;
+  buffkey.len = PWENT_MAX_LEN;
+
+  memset(&entry, 0, sizeof(idmap_entry_t));
+  strncpy(entry.name, key, PWENT_MAX_LEN - 1);
+  entry.id = val;
+
+  LogFullDebug(COMPONENT_IDMAPPER, "Adding the following principal->uid mapping: %s->%lu",
+	       entry.name, entry.id);
+
+  return idmap_store(ht, &buffkey, TRUE, &entry, FALSE);
 }                               /* idmap_add */
 
 int namemap_add(hash_table_t * ht, unsigned int key, char *val)
 {
   hash_buffer_t buffkey;
-  hash_buffer_t buffdata;
-  int rc = 0;
+  idmap_entry_t entry;
   unsigned long local_key = (unsigned long)key;
 
   if(ht == NULL || val == NULL)
     return ID_MAPPER_INVALID_ARGUMENT;
 
-  if((buffdata.pdata = (caddr_t) Mem_Alloc(PWENT_MAX_LEN)) == NULL)
-    return ID_MAPPER_INSERT_MALLOC_ERROR;
-
-  /* Build the data */
-  strncpy((char *)(buffdata.pdata), val, PWENT_MAX_LEN);
-  buffdata.len = PWENT_MAX_LEN;
-
-  /* Build the value */
   buffkey.pdata = (caddr_t) local_key;
   buffkey.len = sizeof(unsigned int);
 
-  LogFullDebug(COMPONENT_IDMAPPER, "Adding the following uid->principal mapping: %lu->%s",
-	       (unsigned long int)buffkey.pdata, (char *)buffdata.pdata);
-  rc = HashTable_Test_And_Set(ht, &buffkey, &buffdata,
-                              HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
+  memset(&entry, 0, sizeof(idmap_entry_t));
+  strncpy(entry.name, val, PWENT_MAX_LEN - 1);
+  entry.id = key;
 
-  if(rc != HASHTABLE_SUCCESS && rc != HASHTABLE_ERROR_KEY_ALREADY_EXISTS)
-    return ID_MAPPER_INSERT_MALLOC_ERROR;
+  LogFullDebug(COMPONENT_IDMAPPER, "Adding the following uid->principal mapping: %lu->%s",
+	       entry.id, entry.name);
 
-  return ID_MAPPER_SUCCESS;
+  return idmap_store(ht, &buffkey, FALSE, &entry, FALSE);
 }                               /* idmap_add */
 
 int uidgidmap_add(unsigned int key, unsigned int value)
@@ -513,7 +631,7 @@ static int idmap_free(hash_buffer_t key, hash_buffer_t val)
 {
   if (val.pdata != NULL)
     LogFullDebug(COMPONENT_IDMAPPER, "Freeing uid->principal mapping: %lu->%s",
-		 (unsigned long)key.pdata, (char *)val.pdata);
+		 (unsigned long)key.pdata, ((idmap_entry_t *)val.pdata)->name);
 
   /* key is just an integer caste to charptr */
   if (val.pdata != NULL)
@@ -525,7 +643,9 @@ int idmap_clear()
 {
   int rc;
   LogInfo(COMPONENT_IDMAPPER, "Clearing all principal->uid map entries.");
+  P_w(&idmap_entries_lock);
   rc = HashTable_Delall(ht_pwuid, idmap_free);
+  V_w(&idmap_entries_lock);
   if (rc != HASHTABLE_SUCCESS)
     return ID_MAPPER_FAIL;
   return ID_MAPPER_SUCCESS;
@@ -535,11 +655,12 @@ static int namemap_free(hash_buffer_t key, hash_buffer_t val)
 {
   if (key.pdata != NULL)
     LogFullDebug(COMPONENT_IDMAPPER, "Freeing principal->uid mapping: %s->%lu",
-		 (char *)key.pdata, (unsigned long)val.pdata);
+		 (char *)key.pdata, ((idmap_entry_t *)val.pdata)->id);
 
-  /* val is just an integer caste to charptr */
   if (key.pdata != NULL)
     Mem_Free(key.pdata);  
+  if (val.pdata != NULL)
+    Mem_Free(val.pdata);
   return 1;
 }
 
@@ -547,7 +668,9 @@ int namemap_clear()
 {
   int rc;
   LogInfo(COMPONENT_IDMAPPER, "Clearing all uid->principal map entries.");
+  P_w(&idmap_entries_lock);
   rc = HashTable_Delall(ht_pwnam, namemap_free);
+  V_w(&idmap_entries_lock);
   if (rc != HASHTABLE_SUCCESS)
     return ID_MAPPER_FAIL;
   return ID_MAPPER_SUCCESS;
@@ -635,6 +758,7 @@ int idmap_get(hash_table_t * ht, char *key, unsigned long *pval)
 {
   hash_buffer_t buffkey;
   hash_buffer_t buffval;
+  idmap_entry_t *pentry;
   int status;
 
   if(ht == NULL || key == NULL || pval == NULL)
@@ -643,16 +767,23 @@ int idmap_get(hash_table_t * ht, char *key, unsigned long *pval)
   buffkey.pdata = (caddr_t) key;
   buffkey.len = PWENT_MAX_LEN;
 
+  status = ID_MAPPER_NOT_FOUND;
+
+  P_r(&idmap_entries_lock);
   if(HashTable_Get(ht, &buffkey, &buffval) == HASHTABLE_SUCCESS)
     {
-      *pval = (unsigned long)buffval.pdata;
+      pentry = (idmap_entry_t *) buffval.pdata;
 
-      status = ID_MAPPER_SUCCESS;
-    }
-  else
-    {
-      status = ID_MAPPER_NOT_FOUND;
+      /* A remembered failure is not a mapping */
+      P(idmap_entry_mutex);
+      if(!pentry->negative)
+        {
+          *pval = pentry->id;
+          status = ID_MAPPER_SUCCESS;
+        }
+      V(idmap_entry_mutex);
     }
+  V_r(&idmap_entries_lock);
 
   return status;
 }                               /* idmap_get */
@@ -661,6 +792,7 @@ int namemap_get(hash_table_t * ht, unsigned int key, char *pval)
 {
   hash_buffer_t buffkey;
   hash_buffer_t buffval;
+  idmap_entry_t *pentry;
   int status;
   long local_key = (long)key;
 
@@ -670,16 +802,22 @@ int namemap_get(hash_table_t * ht, unsigned int key, char *pval)
   buffkey.pdata = (caddr_t) local_key;
   buffkey.len = sizeof(unsigned long);
 
+  status = ID_MAPPER_NOT_FOUND;
+
+  P_r(&idmap_entries_lock);
   if(HashTable_Get(ht, &buffkey, &buffval) == HASHTABLE_SUCCESS)
     {
-      strncpy(pval, (char *)buffval.pdata, PWENT_MAX_LEN);
+      pentry = (idmap_entry_t *) buffval.pdata;
 
-      status = ID_MAPPER_SUCCESS;
-    }
-  else
-    {
-      status = ID_MAPPER_NOT_FOUND;
+      P(idmap_entry_mutex);
+      if(!pentry->negative)
+        {
+          strncpy(pval, pentry->name, PWENT_MAX_LEN);
+          status = ID_MAPPER_SUCCESS;
+        }
+      V(idmap_entry_mutex);
     }
+  V_r(&idmap_entries_lock);
 
   return status;
 }                               /* idmap_get */
@@ -752,7 +890,7 @@ int gnamemap_get(unsigned int key, char *val)
  */
 int idmap_remove(hash_table_t * ht, char *key)
 {
-  hash_buffer_t buffkey, old_key;
+  hash_buffer_t buffkey, old_key, old_data;
   int status;
 
   if(ht == NULL || key == NULL)
@@ -761,15 +899,18 @@ int idmap_remove(hash_table_t * ht, char *key)
   buffkey.pdata = (caddr_t) key;
   buffkey.len = PWENT_MAX_LEN;
 
-  if(HashTable_Del(ht, &buffkey, &old_key, NULL) == HASHTABLE_SUCCESS)
+  P_w(&idmap_entries_lock);
+  if(HashTable_Del(ht, &buffkey, &old_key, &old_data) == HASHTABLE_SUCCESS)
     {
       status = ID_MAPPER_SUCCESS;
       Mem_Free(old_key.pdata);
+      Mem_Free(old_data.pdata);
     }
   else
     {
       status = ID_MAPPER_NOT_FOUND;
     }
+  V_w(&idmap_entries_lock);
 
   return status;
 }                               /* idmap_remove */
@@ -786,6 +927,7 @@ int namemap_remove(hash_table_t * ht, unsigned int key)
   buffkey.pdata = (caddr_t) local_key;
   buffkey.len = sizeof(unsigned long);
 
+  P_w(&idmap_entries_lock);
   if(HashTable_Del(ht, &buffkey, NULL, &old_data) == HASHTABLE_SUCCESS)
     {
       status = ID_MAPPER_SUCCESS;
@@ -795,6 +937,7 @@ int namemap_remove(hash_table_t * ht, unsigned int key)
     {
       status = ID_MAPPER_NOT_FOUND;
     }
+  V_w(&idmap_entries_lock);
 
   return status;
 }                               /* idmap_remove */
@@ -984,3 +1127,434 @@ void idmap_get_stats(idmap_type_t maptype, hash_stat_t * phstat,
   HashTable_GetStats(ht_reverse, phstat_reverse);
 
 }                               /* idmap_get_stats */
+
+static int idmap_tables(idmap_type_t maptype, hash_table_t ** pht_name,
+                        hash_table_t ** pht_id)
+{
+  switch (maptype)
+    {
+    case UIDMAP_TYPE:
+      *pht_name = ht_pwnam;
+      *pht_id = ht_pwuid;
+      return ID_MAPPER_SUCCESS;
+
+    case GIDMAP_TYPE:
+      *pht_name = ht_grnam;
+      *pht_id = ht_grgid;
+      return ID_MAPPER_SUCCESS;
+
+    default:
+      /* Using incoherent value */
+      return ID_MAPPER_INVALID_ARGUMENT;
+    }
+}                               /* idmap_tables */
+
+/**
+ *
+ * idmap_cache_set: caches a mapping resolved by the directory.
+ *
+ * Caches a mapping in both directions, replacing the ones already cached.
+ *
+ * @param maptype [IN] UIDMAP_TYPE or GIDMAP_TYPE
+ * @param name    [IN] the name of the user or group
+ * @param id      [IN] its uid or gid
+ * @param expire  [IN] date the mapping has to be refreshed, 0 if never
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_cache_set(idmap_type_t maptype, char *name, unsigned int id, time_t expire)
+{
+  hash_table_t *ht_name;
+  hash_table_t *ht_id;
+  hash_buffer_t buffkey;
+  idmap_entry_t entry;
+  unsigned long local_key = (unsigned long)id;
+  int rc;
+
+  if(name == NULL || idmap_tables(maptype, &ht_name, &ht_id) != ID_MAPPER_SUCCESS)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  memset(&entry, 0, sizeof(idmap_entry_t));
+  strncpy(entry.name, name, PWENT_MAX_LEN - 1);
+  entry.id = id;
+  entry.expire = expire;
+
+  buffkey.pdata = (caddr_t) name;
+  buffkey.len = PWENT_MAX_LEN;
+
+  if((rc = idmap_store(ht_name, &buffkey, TRUE, &entry, TRUE)) != ID_MAPPER_SUCCESS)
+    return rc;
+
+  buffkey.pdata = (caddr_t) local_key;
+  buffkey.len = sizeof(unsigned int);
+
+  return idmap_store(ht_id, &buffkey, FALSE, &entry, TRUE);
+}                               /* idmap_cache_set */
+
+/**
+ *
+ * idmap_cache_set_negative_id: remembers that an id could not be mapped to a name.
+ *
+ * @param maptype [IN] UIDMAP_TYPE or GIDMAP_TYPE
+ * @param id      [IN] the uid or gid
+ * @param expire  [IN] date the lookup has to be done again
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_cache_set_negative_id(idmap_type_t maptype, unsigned int id, time_t expire)
+{
+  hash_table_t *ht_name;
+  hash_table_t *ht_id;
+  hash_buffer_t buffkey;
+  idmap_entry_t entry;
+  unsigned long local_key = (unsigned long)id;
+
+  if(idmap_tables(maptype, &ht_name, &ht_id) != ID_MAPPER_SUCCESS)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  memset(&entry, 0, sizeof(idmap_entry_t));
+  entry.id = id;
+  entry.expire = expire;
+  entry.negative = TRUE;
+
+  buffkey.pdata = (caddr_t) local_key;
+  buffkey.len = sizeof(unsigned int);
+
+  return idmap_store(ht_id, &buffkey, FALSE, &entry, TRUE);
+}                               /* idmap_cache_set_negative_id */
+
+/**
+ *
+ * idmap_cache_set_negative_name: remembers that a name could not be mapped to an id.
+ *
+ * @param maptype [IN] UIDMAP_TYPE or GIDMAP_TYPE
+ * @param name    [IN] the name of the user or group
+ * @param expire  [IN] date the lookup has to be done again
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INSERT_MALLOC_ERROR, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_cache_set_negative_name(idmap_type_t maptype, char *name, time_t expire)
+{
+  hash_table_t *ht_name;
+  hash_table_t *ht_id;
+  hash_buffer_t buffkey;
+  idmap_entry_t entry;
+
+  if(name == NULL || idmap_tables(maptype, &ht_name, &ht_id) != ID_MAPPER_SUCCESS)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  memset(&entry, 0, sizeof(idmap_entry_t));
+  strncpy(entry.name, name, PWENT_MAX_LEN - 1);
+  entry.expire = expire;
+  entry.negative = TRUE;
+
+  buffkey.pdata = (caddr_t) name;
+  buffkey.len = PWENT_MAX_LEN;
+
+  return idmap_store(ht_name, &buffkey, TRUE, &entry, TRUE);
+}                               /* idmap_cache_set_negative_name */
+
+/**
+ *
+ * idmap_cache_lookup: copies a cached entry and accounts for the lookup.
+ *
+ * An expired entry is still returned (positive or negative), *prefresh tells
+ * the caller to have it refreshed. It is set once per IDMAP_REFRESH_RETRY
+ * seconds so that a single refresh is queued even if the entry is used a lot.
+ *
+ */
+static int idmap_cache_lookup(idmap_type_t maptype, hash_table_t * ht,
+                              hash_buffer_t * pbuffkey, idmap_entry_t * pentry,
+                              int *prefresh)
+{
+  hash_buffer_t buffval;
+  idmap_entry_t *pcached;
+  idmap_cache_stat_t *pstat = idmap_stat_of(maptype);
+  time_t now;
+
+  *prefresh = FALSE;
+
+  P_r(&idmap_entries_lock);
+  if(HashTable_Get(ht, pbuffkey, &buffval) != HASHTABLE_SUCCESS)
+    {
+      V_r(&idmap_entries_lock);
+
+      P(idmap_entry_mutex);
+      pstat->nb_miss++;
+      V(idmap_entry_mutex);
+
+      return ID_MAPPER_NOT_FOUND;
+    }
+
+  pcached = (idmap_entry_t *) buffval.pdata;
+  now = time(NULL);
+
+  P(idmap_entry_mutex);
+
+  if(pcached->expire != 0 && now >= pcached->expire &&
+     now - pcached->refresh_asked >= IDMAP_REFRESH_RETRY)
+    {
+      pcached->refresh_asked = now;
+      *prefresh = TRUE;
+    }
+
+  *pentry = *pcached;
+
+  if(pentry->negative)
+    pstat->nb_hit_negative++;
+  else if(pentry->expire != 0 && now >= pentry->expire)
+    pstat->nb_hit_stale++;
+  else
+    pstat->nb_hit++;
+
+  V(idmap_entry_mutex);
+  V_r(&idmap_entries_lock);
+
+  return ID_MAPPER_SUCCESS;
+}                               /* idmap_cache_lookup */
+
+/**
+ *
+ * idmap_cache_get_id: gets the cached entry of an id.
+ *
+ * @param maptype  [IN]  UIDMAP_TYPE or GIDMAP_TYPE
+ * @param id       [IN]  the uid or gid
+ * @param pentry   [OUT] copy of the entry, which may be negative
+ * @param prefresh [OUT] TRUE if the entry is expired and has to be refreshed
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_NOT_FOUND, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_cache_get_id(idmap_type_t maptype, unsigned int id, idmap_entry_t * pentry,
+                       int *prefresh)
+{
+  hash_table_t *ht_name;
+  hash_table_t *ht_id;
+  hash_buffer_t buffkey;
+  unsigned long local_key = (unsigned long)id;
+
+  if(pentry == NULL || prefresh == NULL ||
+     idmap_tables(maptype, &ht_name, &ht_id) != ID_MAPPER_SUCCESS)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  buffkey.pdata = (caddr_t) local_key;
+  buffkey.len = sizeof(unsigned long);
+
+  return idmap_cache_lookup(maptype, ht_id, &buffkey, pentry, prefresh);
+}                               /* idmap_cache_get_id */
+
+/**
+ *
+ * idmap_cache_get_name: gets the cached entry of a name.
+ *
+ * @param maptype  [IN]  UIDMAP_TYPE or GIDMAP_TYPE
+ * @param name     [IN]  the name of the user or group
+ * @param pentry   [OUT] copy of the entry, which may be negative
+ * @param prefresh [OUT] TRUE if the entry is expired and has to be refreshed
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_NOT_FOUND, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_cache_get_name(idmap_type_t maptype, char *name, idmap_entry_t * pentry,
+                         int *prefresh)
+{
+  hash_table_t *ht_name;
+  hash_table_t *ht_id;
+  hash_buffer_t buffkey;
+
+  if(name == NULL || pentry == NULL || prefresh == NULL ||
+     idmap_tables(maptype, &ht_name, &ht_id) != ID_MAPPER_SUCCESS)
+    return ID_MAPPER_INVALID_ARGUMENT;
+
+  buffkey.pdata = (caddr_t) name;
+  buffkey.len = PWENT_MAX_LEN;
+
+  return idmap_cache_lookup(maptype, ht_name, &buffkey, pentry, prefresh);
+}                               /* idmap_cache_get_name */
+
+/**
+ *
+ * idmap_cache_account_resolve: accounts for a lookup made in the directory.
+ *
+ * @param maptype    [IN] UIDMAP_TYPE or GIDMAP_TYPE
+ * @param success    [IN] TRUE if the directory answered
+ * @param latency    [IN] duration of the lookup (usec)
+ * @param background [IN] TRUE if the lookup refreshed an expired entry
+ *
+ */
+void idmap_cache_account_resolve(idmap_type_t maptype, int success,
+                                 unsigned int latency, int background)
+{
+  idmap_cache_stat_t *pstat = idmap_stat_of(maptype);
+
+  P(idmap_entry_mutex);
+
+  pstat->nb_resolve++;
+  if(!success)
+    pstat->nb_resolve_err++;
+  if(background)
+    pstat->nb_refresh++;
+
+  pstat->total_latency += latency;
+  if(latency > pstat->max_latency)
+    pstat->max_latency = latency;
+
+  V(idmap_entry_mutex);
+}                               /* idmap_cache_account_resolve */
+
+void idmap_cache_account_dropped(idmap_type_t maptype)
+{
+  P(idmap_entry_mutex);
+  idmap_stat_of(maptype)->nb_refresh_dropped++;
+  V(idmap_entry_mutex);
+}                               /* idmap_cache_account_dropped */
+
+/**
+ *
+ * idmap_get_cache_stats: gets the lookup statistics of a mapping cache.
+ *
+ * @param maptype [IN]  UIDMAP_TYPE or GIDMAP_TYPE
+ * @param pstat   [OUT] the statistics
+ *
+ */
+void idmap_get_cache_stats(idmap_type_t maptype, idmap_cache_stat_t * pstat)
+{
+  P(idmap_entry_mutex);
+  *pstat = *idmap_stat_of(maptype);
+  V(idmap_entry_mutex);
+}                               /* idmap_get_cache_stats */
+
+/**
+ *
+ * idmap_preload: fills the cache with the content of a passwd or group file.
+ *
+ * The file has the format of /etc/passwd or /etc/group (the output of
+ * 'getent passwd' or 'getent group' is fine), so that the users and groups of
+ * a large directory are known from the start instead of being looked up one
+ * by one. The mappings loaded expire like the resolved ones. With libnfsidmap,
+ * the names are stored qualified with the idmapd domain, as the resolved ones.
+ *
+ * @param path    [IN] path of the file
+ * @param maptype [IN] UIDMAP_TYPE for a passwd file, GIDMAP_TYPE for a group file
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_INVALID_ARGUMENT
+ *
+ */
+int idmap_preload(char *path, idmap_type_t maptype)
+{
+  nfs_idmap_cache_parameter_t *pparam;
+  FILE *stream;
+  char line[MAXPATHLEN];
+  char name[PWENT_MAX_LEN];
+  char *fields[4];
+  char *p;
+  char *end;
+  unsigned long id;
+  time_t expire;
+  unsigned int nb_fields;
+  int rc;
+  unsigned int nb_loaded = 0;
+  unsigned int nb_ignored = 0;
+
+  switch (maptype)
+    {
+    case UIDMAP_TYPE:
+      pparam = &nfs_param.uidmap_cache_param;
+      break;
+
+    case GIDMAP_TYPE:
+      pparam = &nfs_param.gidmap_cache_param;
+      break;
+
+    default:
+      /* Using incoherent value */
+      return ID_MAPPER_INVALID_ARGUMENT;
+    }
+
+#ifdef _USE_NFSIDMAP
+  if(!nfsidmap_set_conf())
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "idmap_preload: nfsidmap_set_conf failed");
+      return ID_MAPPER_INVALID_ARGUMENT;
+    }
+#endif
+
+  if((stream = fopen(path, "r")) == NULL)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "Can't open file %s", path);
+      return ID_MAPPER_INVALID_ARGUMENT;
+    }
+
+  expire = (pparam->expiration != 0) ? time(NULL) + pparam->expiration : 0;
+
+  while(fgets(line, MAXPATHLEN, stream) != NULL)
+    {
+      if((p = strchr(line, '\n')) != NULL)
+        *p = '\0';
+
+      if(line[0] == '\0' || line[0] == '#')
+        continue;
+
+      /* name:password:id[:gid:...], the fields may be empty */
+      nb_fields = 0;
+      p = line;
+      fields[nb_fields++] = p;
+      while(nb_fields < 4 && (p = strchr(p, ':')) != NULL)
+        {
+          *p++ = '\0';
+          fields[nb_fields++] = p;
+        }
+
+      if(nb_fields < 3 || fields[0][0] == '\0')
+        {
+          nb_ignored++;
+          continue;
+        }
+
+      id = strtoul(fields[2], &end, 10);
+      if(end == fields[2] || (*end != '\0' && *end != ':'))
+        {
+          nb_ignored++;
+          continue;
+        }
+
+#ifdef _USE_NFSIDMAP
+      if(strchr(fields[0], '@') == NULL)
+        rc = snprintf(name, PWENT_MAX_LEN, "%s@%s", fields[0], idmap_domain);
+      else
+#endif
+        rc = snprintf(name, PWENT_MAX_LEN, "%s", fields[0]);
+
+      if(rc >= PWENT_MAX_LEN)
+        {
+          nb_ignored++;
+          continue;
+        }
+
+      if(idmap_cache_set(maptype, name, id, expire) != ID_MAPPER_SUCCESS)
+        {
+          nb_ignored++;
+          continue;
+        }
+
+#ifdef _HAVE_GSSAPI
+      if(maptype == UIDMAP_TYPE && nb_fields == 4)
+        uidgidmap_add(id, strtoul(fields[3], NULL, 10));
+#endif
+
+      nb_loaded++;
+    }
+
+  fclose(stream);
+
+  LogEvent(COMPONENT_IDMAPPER,
+           "%s mappings preloaded from %s: %u loaded, %u lines ignored",
+           (maptype == UIDMAP_TYPE) ? "User" : "Group", path, nb_loaded, nb_ignored);
+
+  return ID_MAPPER_SUCCESS;
+}                               /* idmap_preload */
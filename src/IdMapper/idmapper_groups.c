@@ -0,0 +1,522 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    idmapper_groups.c
+ * \brief   Groups of the users, resolved by the server.
+ *
+ * idmapper_groups.c : cache of the full group list of the users, for the
+ * exports with Manage_Gids. AUTH_UNIX credentials carry at most 16 groups,
+ * the server looks the whole list up in the directory instead.
+ *
+ * The lists are sorted so that the access checks can bsearch them, and are
+ * shared: the cache holds one reference, each FSAL context that uses a list
+ * holds one. An expired list is still used while one of the id mapper
+ * resolver threads refreshes it. When several requests of a user whose list
+ * is not cached arrive at once, only one of them looks the list up, the
+ * others wait for it.
+ *
+ * The lists found in cache are taken under a read lock, their reference
+ * counts and the hit statistics are then updated atomically. The write lock
+ * is taken to change the table only.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include "HashData.h"
+#include "HashTable.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "RW_Lock.h"
+#include "nfs_core.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+
+/* Working area of getpwuid_r */
+#define UID2GRP_PWENT_BUFF_LEN 4096
+
+/* Size of the first buffer given to getgrouplist, and the most groups kept */
+#define UID2GRP_INITIAL_GROUPS 64
+#define UID2GRP_MAX_GROUPS     65536
+
+/* Lookups of distinct users that are coalesced at a time */
+#define UID2GRP_MAX_INFLIGHT   64
+
+/* Do not ask again for the refresh of an expired list before that (s) */
+#define UID2GRP_REFRESH_RETRY  30
+
+static hash_table_t *ht_uid2grp;
+
+/* Protects the table content and the statistics of the lookups */
+static rw_lock_t uid2grp_lock;
+
+/* Protects the lookups in flight */
+static pthread_mutex_t uid2grp_inflight_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uid2grp_cond = PTHREAD_COND_INITIALIZER;
+
+static uid_t uid2grp_inflight[UID2GRP_MAX_INFLIGHT];
+static unsigned int uid2grp_nb_inflight = 0;
+
+static idmap_cache_stat_t uid2grp_stat;
+
+static int display_uid2grp_key(hash_buffer_t * pbuff, char *str)
+{
+  return sprintf(str, "%lu", (unsigned long)(pbuff->pdata));
+}
+
+static int display_uid2grp_val(hash_buffer_t * pbuff, char *str)
+{
+  fsal_grouplist_t *plist = (fsal_grouplist_t *) pbuff->pdata;
+
+  return sprintf(str, "%u groups expire=%ld%s", plist->nbgroups, (long)plist->expire,
+                 plist->negative ? " (negative)" : "");
+}
+
+static int uid2grp_compare_gid(const void *p1, const void *p2)
+{
+  gid_t gid1 = *(const gid_t *)p1;
+  gid_t gid2 = *(const gid_t *)p2;
+
+  return (gid1 < gid2) ? -1 : (gid1 > gid2) ? 1 : 0;
+}
+
+/**
+ *
+ * uid2grp_init: Inits the hashtable of the group lists.
+ *
+ * @param param [IN] parameter used to init the cache, keyed by uid
+ *
+ * @return ID_MAPPER_SUCCESS, ID_MAPPER_FAIL
+ *
+ */
+int uid2grp_init(nfs_idmap_cache_parameter_t param)
+{
+  param.hash_param.key_to_str = display_uid2grp_key;
+  param.hash_param.val_to_str = display_uid2grp_val;
+  param.hash_param.name = "UID->Groups Cache";
+
+  if(rw_lock_init(&uid2grp_lock) != 0)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "NFS UID/GROUPS MAPPER: Cannot init the UID2GRP cache lock");
+      return ID_MAPPER_FAIL;
+    }
+
+  if((ht_uid2grp = HashTable_Init(param.hash_param)) == NULL)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "NFS UID/GROUPS MAPPER: Cannot init UID2GRP cache");
+      return ID_MAPPER_FAIL;
+    }
+
+  return ID_MAPPER_SUCCESS;
+}                               /* uid2grp_init */
+
+/* Drops a reference, the list is freed with the last one */
+static void uid2grp_unref(fsal_grouplist_t * plist)
+{
+  if(__sync_sub_and_fetch(&plist->refcount, 1) > 0)
+    return;
+
+  if(plist->groups != NULL)
+    Mem_Free(plist->groups);
+  Mem_Free(plist);
+}                               /* uid2grp_unref */
+
+/**
+ *
+ * uid2grp_release: drops a reference taken by uid2grp_get.
+ *
+ * @param plist [IN] the list, may be NULL
+ *
+ */
+void uid2grp_release(fsal_grouplist_t * plist)
+{
+  if(plist == NULL)
+    return;
+
+  uid2grp_unref(plist);
+}                               /* uid2grp_release */
+
+/* Replaces the list of a user in the table, uid2grp_lock is held for
+ * writing. The reference of the caller is given to the table. */
+static void uid2grp_insert(fsal_grouplist_t * plist)
+{
+  hash_buffer_t buffkey;
+  hash_buffer_t buffdata;
+  hash_buffer_t old_key;
+  hash_buffer_t old_data;
+  unsigned long local_key = (unsigned long)plist->uid;
+
+  buffkey.pdata = (caddr_t) local_key;
+  buffkey.len = sizeof(unsigned long);
+
+  if(HashTable_Del(ht_uid2grp, &buffkey, &old_key, &old_data) == HASHTABLE_SUCCESS)
+    uid2grp_unref((fsal_grouplist_t *) old_data.pdata);
+
+  buffdata.pdata = (caddr_t) plist;
+  buffdata.len = sizeof(fsal_grouplist_t);
+
+  if(HashTable_Test_And_Set(ht_uid2grp, &buffkey, &buffdata,
+                            HASHTABLE_SET_HOW_SET_NO_OVERWRITE) != HASHTABLE_SUCCESS)
+    {
+      LogCrit(COMPONENT_IDMAPPER,
+              "uid2grp_insert: could not cache the groups of uid %u",
+              (unsigned int)plist->uid);
+      uid2grp_unref(plist);
+    }
+}                               /* uid2grp_insert */
+
+/**
+ *
+ * uid2grp_resolve: looks the groups of a user up in the directory.
+ *
+ * @param uid        [IN] the user
+ * @param background [IN] TRUE if called by a resolver thread
+ *
+ * @return a list with one reference, or NULL if the directory could not be
+ * queried (or the user is unknown and failures are not remembered).
+ *
+ */
+static fsal_grouplist_t *uid2grp_resolve(uid_t uid, int background)
+{
+  nfs_idmap_cache_parameter_t *pparam = &nfs_param.gidmap_cache_param;
+  fsal_grouplist_t *plist = NULL;
+  struct passwd p;
+  struct passwd *pp = NULL;
+  char buff[UID2GRP_PWENT_BUFF_LEN];
+  struct timeval start;
+  struct timeval end;
+  unsigned int latency;
+  gid_t *groups = NULL;
+  int size = UID2GRP_INITIAL_GROUPS;
+  int ngroups;
+  int i, j;
+  int rc;
+
+  gettimeofday(&start, NULL);
+
+#ifdef _SOLARIS
+  pp = getpwuid_r(uid, &p, buff, UID2GRP_PWENT_BUFF_LEN);
+  rc = (pp == NULL) ? errno : 0;
+#else
+  rc = getpwuid_r(uid, &p, buff, UID2GRP_PWENT_BUFF_LEN, &pp);
+#endif                          /* _SOLARIS */
+
+  if(pp != NULL)
+    {
+      for(;;)
+        {
+          if((groups = (gid_t *) Mem_Alloc(size * sizeof(gid_t))) == NULL)
+            break;
+
+          ngroups = size;
+          if(getgrouplist(p.pw_name, p.pw_gid, groups, &ngroups) >= 0)
+            break;
+
+          /* ngroups is now the number of groups of the user */
+          Mem_Free(groups);
+          groups = NULL;
+
+          if(size >= UID2GRP_MAX_GROUPS)
+            break;
+          size = (ngroups > size) ? ngroups : 2 * size;
+          if(size > UID2GRP_MAX_GROUPS)
+            size = UID2GRP_MAX_GROUPS;
+        }
+    }
+
+  gettimeofday(&end, NULL);
+  latency = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+  if(groups != NULL)
+    {
+      /* Sorted without duplicates, for bsearch */
+      qsort(groups, ngroups, sizeof(gid_t), uid2grp_compare_gid);
+      for(i = 0, j = 0; i < ngroups; i++)
+        if(j == 0 || groups[i] != groups[j - 1])
+          groups[j++] = groups[i];
+      ngroups = j;
+
+      if((plist = (fsal_grouplist_t *) Mem_Alloc(sizeof(fsal_grouplist_t))) == NULL)
+        {
+          Mem_Free(groups);
+          groups = NULL;
+        }
+      else
+        {
+          memset(plist, 0, sizeof(fsal_grouplist_t));
+          plist->groups = groups;
+          plist->nbgroups = ngroups;
+          if(pparam->expiration != 0)
+            plist->expire = end.tv_sec + pparam->expiration;
+
+          LogFullDebug(COMPONENT_IDMAPPER,
+                       "uid2grp_resolve: uid %u is member of %u groups",
+                       (unsigned int)uid, plist->nbgroups);
+        }
+    }
+  else if(pp == NULL && (rc == 0 || rc == ENOENT || rc == ESRCH) &&
+          pparam->negative_expiration != 0)
+    {
+      /* Unknown user, the groups of its credential are used */
+      if((plist = (fsal_grouplist_t *) Mem_Alloc(sizeof(fsal_grouplist_t))) != NULL)
+        {
+          memset(plist, 0, sizeof(fsal_grouplist_t));
+          plist->negative = TRUE;
+          plist->expire = end.tv_sec + pparam->negative_expiration;
+        }
+    }
+
+  if(plist != NULL)
+    {
+      plist->uid = uid;
+      plist->refcount = 1;
+    }
+  else
+    LogDebug(COMPONENT_IDMAPPER,
+             "uid2grp_resolve: could not get the groups of uid %u",
+             (unsigned int)uid);
+
+  P_w(&uid2grp_lock);
+  uid2grp_stat.nb_resolve++;
+  if(groups == NULL)
+    uid2grp_stat.nb_resolve_err++;
+  if(background)
+    uid2grp_stat.nb_refresh++;
+  uid2grp_stat.total_latency += latency;
+  if(latency > uid2grp_stat.max_latency)
+    uid2grp_stat.max_latency = latency;
+  V_w(&uid2grp_lock);
+
+  return plist;
+}                               /* uid2grp_resolve */
+
+/**
+ *
+ * uid2grp_refresh: looks the groups of a user up again and updates the cache.
+ *
+ * Called by the resolver threads. If the directory cannot be queried, the
+ * list in cache is kept.
+ *
+ * @param uid [IN] the user
+ *
+ */
+void uid2grp_refresh(uid_t uid)
+{
+  fsal_grouplist_t *plist;
+
+  if((plist = uid2grp_resolve(uid, TRUE)) == NULL)
+    return;
+
+  P_w(&uid2grp_lock);
+  uid2grp_insert(plist);
+  V_w(&uid2grp_lock);
+}                               /* uid2grp_refresh */
+
+/* The lookups in flight are managed under uid2grp_inflight_mutex */
+static int uid2grp_is_inflight(uid_t uid)
+{
+  unsigned int i;
+
+  for(i = 0; i < uid2grp_nb_inflight; i++)
+    if(uid2grp_inflight[i] == uid)
+      return TRUE;
+
+  return FALSE;
+}                               /* uid2grp_is_inflight */
+
+static void uid2grp_done_inflight(uid_t uid)
+{
+  unsigned int i;
+
+  for(i = 0; i < uid2grp_nb_inflight; i++)
+    if(uid2grp_inflight[i] == uid)
+      {
+        uid2grp_inflight[i] = uid2grp_inflight[--uid2grp_nb_inflight];
+        break;
+      }
+}                               /* uid2grp_done_inflight */
+
+/**
+ *
+ * uid2grp_lookup: looks the list of a user up in the cache.
+ *
+ * @param uid    [IN]  the user
+ * @param pfound [OUT] TRUE if the user is in cache
+ *
+ * @return the list with a reference, NULL if the user is unknown or not in cache.
+ *
+ */
+static fsal_grouplist_t *uid2grp_lookup(uid_t uid, int *pfound)
+{
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  fsal_grouplist_t *plist = NULL;
+  unsigned long local_key = (unsigned long)uid;
+  time_t now = time(NULL);
+  time_t asked;
+  int refresh = FALSE;
+
+  buffkey.pdata = (caddr_t) local_key;
+  buffkey.len = sizeof(unsigned long);
+
+  P_r(&uid2grp_lock);
+
+  if(HashTable_Get(ht_uid2grp, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+    {
+      V_r(&uid2grp_lock);
+      *pfound = FALSE;
+      return NULL;
+    }
+
+  plist = (fsal_grouplist_t *) buffval.pdata;
+
+  if(plist->expire != 0 && now >= plist->expire)
+    {
+      __sync_fetch_and_add(&uid2grp_stat.nb_hit_stale, 1);
+
+      /* A single request asks for the refresh */
+      asked = plist->refresh_asked;
+      if(now - asked >= UID2GRP_REFRESH_RETRY &&
+         __sync_bool_compare_and_swap(&plist->refresh_asked, asked, now))
+        refresh = TRUE;
+    }
+  else if(plist->negative)
+    __sync_fetch_and_add(&uid2grp_stat.nb_hit_negative, 1);
+  else
+    __sync_fetch_and_add(&uid2grp_stat.nb_hit, 1);
+
+  if(plist->negative)
+    plist = NULL;
+  else
+    __sync_fetch_and_add(&plist->refcount, 1);
+
+  V_r(&uid2grp_lock);
+
+  if(refresh)
+    idmap_refresh_grouplist(uid);
+
+  *pfound = TRUE;
+  return plist;
+}                               /* uid2grp_lookup */
+
+/**
+ *
+ * uid2grp_get: gets the groups of a user.
+ *
+ * @param uid [IN] the user
+ *
+ * @return the sorted list of the groups of the user, with a reference to be
+ * dropped by uid2grp_release. NULL if the groups are unknown, then the
+ * groups of the credential of the request are to be used.
+ *
+ */
+fsal_grouplist_t *uid2grp_get(uid_t uid)
+{
+  fsal_grouplist_t *plist = NULL;
+  int found;
+  int coalesce;
+
+  plist = uid2grp_lookup(uid, &found);
+  if(found)
+    return plist;
+
+  P(uid2grp_inflight_mutex);
+
+  /* Another request of this user may be looking its groups up, or may have
+   * cached them meanwhile */
+  for(;;)
+    {
+      if(!uid2grp_is_inflight(uid))
+        {
+          plist = uid2grp_lookup(uid, &found);
+          if(!found)
+            break;
+
+          V(uid2grp_inflight_mutex);
+          return plist;
+        }
+
+      pthread_cond_wait(&uid2grp_cond, &uid2grp_inflight_mutex);
+    }
+
+  coalesce = (uid2grp_nb_inflight < UID2GRP_MAX_INFLIGHT);
+  if(coalesce)
+    uid2grp_inflight[uid2grp_nb_inflight++] = uid;
+
+  V(uid2grp_inflight_mutex);
+
+  __sync_fetch_and_add(&uid2grp_stat.nb_miss, 1);
+
+  plist = uid2grp_resolve(uid, FALSE);
+
+  if(plist != NULL)
+    {
+      /* One reference for the cache, one for the caller */
+      plist->refcount++;
+
+      P_w(&uid2grp_lock);
+      uid2grp_insert(plist);
+      V_w(&uid2grp_lock);
+
+      if(plist->negative)
+        {
+          uid2grp_unref(plist);
+          plist = NULL;
+        }
+    }
+
+  if(coalesce)
+    {
+      P(uid2grp_inflight_mutex);
+      uid2grp_done_inflight(uid);
+      pthread_cond_broadcast(&uid2grp_cond);
+      V(uid2grp_inflight_mutex);
+    }
+
+  return plist;
+}                               /* uid2grp_get */
+
+/**
+ *
+ * uid2grp_get_stats: gets the lookup statistics of the group lists cache.
+ *
+ * @param pstat [OUT] the statistics
+ *
+ */
+void uid2grp_get_stats(idmap_cache_stat_t * pstat)
+{
+  P_w(&uid2grp_lock);
+  *pstat = uid2grp_stat;
+  V_w(&uid2grp_lock);
+}                               /* uid2grp_get_stats */
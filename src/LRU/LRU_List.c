@@ -311,6 +311,54 @@ int LRU_gc_invalid(LRU_list_t * plru, void *cleanparam)
   return rc;
 }                               /* LRU_gc_invalid */
 
+/**
+ *
+ * LRU_gc_entry : releases one entry of the list.
+ *
+ * Cleans the entry, puts it off the list and back to the pool, without browsing the list.
+ * This is used when the caller already knows which entry expired.
+ *
+ * @param plru Pointer to the list to be managed.
+ * @param pentry Pointer to the entry to be released.
+ * @param cleanparam parameter for the clean_entry function.
+ *
+ * @return LRU_LIST_SUCCESS if successfull, other values show an error.
+ *
+ * @see LRU_gc_invalid
+ */
+int LRU_gc_entry(LRU_list_t * plru, LRU_entry_t * pentry, void *cleanparam)
+{
+  int rc = LRU_LIST_SUCCESS;
+
+  if(plru == NULL || pentry == NULL)
+    return LRU_LIST_EMPTY_LIST;
+
+  if(plru->parameter.clean_entry(pentry, cleanparam) != 0)
+    {
+      LogDebug(COMPONENT_LRU, "Error cleaning pentry %p", pentry);
+      rc = LRU_LIST_BAD_RELEASE_ENTRY;
+    }
+
+  if(pentry->prev != NULL)
+    pentry->prev->next = pentry->next;
+  else
+    plru->LRU = pentry->next;
+
+  if(pentry->next != NULL)
+    pentry->next->prev = pentry->prev;
+  else
+    plru->MRU = pentry->prev;
+
+  if(pentry->valid_state == LRU_ENTRY_INVALID)
+    plru->nb_invalid -= 1;
+  plru->nb_entry -= 1;
+
+  /* Put it back to pre-allocated pool */
+  ReleaseToPool(pentry, &plru->lru_entry_pool);
+
+  return rc;
+}                               /* LRU_gc_entry */
+
 /**
  *
  * LRU_invalidate_by_function: Browse the lru to test if entries should ne invalidated.
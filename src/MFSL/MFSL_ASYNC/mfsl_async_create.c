@@ -101,18 +101,23 @@ fsal_status_t MFSL_create_async_op(mfsl_async_op_desc_t * popasyncdesc)
     }
 
   /* If user is not root, setattr to chown the entry */
+  chown_attr.asked_attributes = 0;
   if(popasyncdesc->op_args.create.owner != 0)
     {
       chown_attr.asked_attributes = FSAL_ATTR_MODE | FSAL_ATTR_OWNER | FSAL_ATTR_GROUP;
       chown_attr.mode = popasyncdesc->op_args.create.mode;
       chown_attr.owner = popasyncdesc->op_args.create.owner;
       chown_attr.group = popasyncdesc->op_args.create.group;
-
-      fsal_status =
-          FSAL_setattrs(&handle, &popasyncdesc->fsal_op_context, &chown_attr,
-                        &popasyncdesc->op_res.create.attr);
     }
 
+  /* The setattrs coalesced with the create are done by the same call */
+  mfsl_async_merge_attrs(&chown_attr, &popasyncdesc->op_args.create.attr_set);
+
+  if(chown_attr.asked_attributes != 0)
+    fsal_status =
+        FSAL_setattrs(&handle, &popasyncdesc->fsal_op_context, &chown_attr,
+                      &popasyncdesc->op_res.create.attr);
+
   V(popasyncdesc->op_args.create.pmfsl_obj_dirdest->lock);
 
   return fsal_status;
@@ -217,6 +222,7 @@ fsal_status_t MFSL_create(mfsl_object_t * parent_directory_handle,      /* IN */
                     pasyncopdesc);
 
   pasyncopdesc->op_type = MFSL_ASYNC_OP_CREATE;
+  pasyncopdesc->op_mobject = pnewfile_handle;
 
   pasyncopdesc->op_args.create.pmfsl_obj_dirdest = parent_directory_handle;
   pasyncopdesc->op_args.create.precreate_name = pprecreated->name;
@@ -224,6 +230,7 @@ fsal_status_t MFSL_create(mfsl_object_t * parent_directory_handle,      /* IN */
   pasyncopdesc->op_args.create.owner = FSAL_OP_CONTEXT_TO_UID(p_context);
   pasyncopdesc->op_args.create.group = FSAL_OP_CONTEXT_TO_GID(p_context);
   pasyncopdesc->op_args.create.mode = accessmode;
+  pasyncopdesc->op_args.create.attr_set.asked_attributes = 0;
   pasyncopdesc->op_res.create.attr.asked_attributes = object_attributes->asked_attributes;
   pasyncopdesc->op_res.create.attr.supported_attributes =
       object_attributes->supported_attributes;
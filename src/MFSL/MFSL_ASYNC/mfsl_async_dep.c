@@ -0,0 +1,616 @@
+/*
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    mfsl_async_dep.c
+ * \brief   Ordering of the pending asynchronous operations.
+ *
+ * Each pending operation is ordered on the objects and the directory
+ * entries it works on: it waits for the operations posted before it on the
+ * same keys, the others run in parallel on any synclet. An operation on an
+ * entry also waits for the pending operations on the directory itself (the
+ * mkdir that made it for instance) and an operation on a directory waits for
+ * the pending operations on its entries, which change its times.
+ *
+ * A setattr or a truncate posted behind an operation on the same object
+ * that was not dispatched yet is merged into it, the FSAL is then called
+ * once for both.
+ *
+ * Two operations are merged only if they are done with the same credentials.
+ * If the dependencies of an operation can't be allocated, its caller waits for
+ * the pending operations to complete and release theirs.
+ *
+ * All the functions of this file are called with mutex_async_list held.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* fsal_types contains constants and type definitions for FSAL */
+#include "fsal_types.h"
+#include "fsal.h"
+#include "mfsl_types.h"
+#include "mfsl.h"
+#include "common_utils.h"
+#include "stuff_alloc.h"
+
+#ifndef _USE_SWIG
+
+/* Attributes a coalesced setattr can carry */
+#define MFSL_ASYNC_MERGEABLE_ATTRS ( FSAL_ATTR_SIZE | FSAL_ATTR_MODE | FSAL_ATTR_OWNER | \
+                                     FSAL_ATTR_GROUP | FSAL_ATTR_ATIME | FSAL_ATTR_MTIME )
+
+extern mfsl_parameter_t mfsl_param;
+extern pthread_mutex_t mutex_async_list;
+
+static struct glist_head dep_hash[MFSL_ASYNC_DEP_HASH_SIZE];
+static struct prealloc_pool dep_track_pool;
+static struct prealloc_pool dep_edge_pool;
+static pthread_cond_t dep_edge_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int dep_edge_waiters = 0;
+
+/**
+ *
+ * mfsl_async_dep_init: initializes the tables of the pending operations.
+ *
+ * @return 0 if successful, a negative value otherwise.
+ *
+ */
+int mfsl_async_dep_init(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < MFSL_ASYNC_DEP_HASH_SIZE; i++)
+    init_glist(&dep_hash[i]);
+
+  MakePool(&dep_track_pool, mfsl_param.nb_pre_async_op_desc, mfsl_async_dep_track_t,
+           NULL, NULL);
+  NamePool(&dep_track_pool, "MFSL_ASYNC Dependency Tracks Pool");
+
+  MakePool(&dep_edge_pool, mfsl_param.nb_pre_async_op_desc, mfsl_async_dep_edge_t,
+           NULL, NULL);
+  NamePool(&dep_edge_pool, "MFSL_ASYNC Dependency Edges Pool");
+
+  if(!IsPoolPreallocated(&dep_track_pool) || !IsPoolPreallocated(&dep_edge_pool))
+    return -1;
+
+  return 0;
+}                               /* mfsl_async_dep_init */
+
+static unsigned int mfsl_async_dep_hash(fsal_handle_t * phandle, fsal_name_t * pname)
+{
+  unsigned int cookie = 0;
+  unsigned int i;
+
+  for(i = 0; i < pname->len; i++)
+    cookie = cookie * 31 + (unsigned char)pname->name[i];
+
+  return FSAL_Handle_to_HashIndex(phandle, cookie, 10, MFSL_ASYNC_DEP_HASH_SIZE);
+}                               /* mfsl_async_dep_hash */
+
+/**
+ *
+ * mfsl_async_dep_get_track: finds the track of an object or of a directory entry.
+ *
+ * The track is created if there is none, with a reference for the caller.
+ *
+ * @param phandle [IN] the object, or the directory.
+ * @param pname   [IN] the entry's name, NULL for the object itself.
+ *
+ * @return the track, NULL if it could not be allocated.
+ *
+ */
+static mfsl_async_dep_track_t *mfsl_async_dep_get_track(fsal_handle_t * phandle,
+                                                        fsal_name_t * pname)
+{
+  fsal_name_t noname;
+  fsal_status_t status;
+  struct glist_head *node;
+  mfsl_async_dep_track_t *ptrack;
+  mfsl_async_dep_track_t *pparent = NULL;
+  unsigned int index;
+
+  if(pname == NULL)
+    {
+      noname.len = 0;
+      noname.name[0] = '\0';
+      pname = &noname;
+    }
+
+  index = mfsl_async_dep_hash(phandle, pname);
+
+  glist_for_each(node, &dep_hash[index])
+    {
+      ptrack = glist_entry(node, mfsl_async_dep_track_t, hash_link);
+
+      if(ptrack->name.len == pname->len &&
+         !FSAL_namecmp(&ptrack->name, pname) &&
+         !FSAL_handlecmp(&ptrack->handle, phandle, &status))
+        {
+          ptrack->refcount++;
+          return ptrack;
+        }
+    }
+
+  /* An entry's track holds a reference on its directory's one */
+  if(pname->len != 0)
+    {
+      if((pparent = mfsl_async_dep_get_track(phandle, NULL)) == NULL)
+        return NULL;
+    }
+
+  GetFromPool(ptrack, &dep_track_pool, mfsl_async_dep_track_t);
+  if(ptrack == NULL)
+    {
+      LogCrit(COMPONENT_MFSL, "Could not allocate a dependency track");
+      if(pparent != NULL)
+        pparent->refcount--;
+      return NULL;
+    }
+
+  ptrack->handle = *phandle;
+  ptrack->name = *pname;
+  ptrack->plast = NULL;
+  ptrack->refcount = 1;
+  ptrack->pparent = pparent;
+  init_glist(&ptrack->children);
+
+  if(pparent != NULL)
+    glist_add_tail(&pparent->children, &ptrack->child_link);
+
+  glist_add_tail(&dep_hash[index], &ptrack->hash_link);
+
+  return ptrack;
+}                               /* mfsl_async_dep_get_track */
+
+static void mfsl_async_dep_put_track(mfsl_async_dep_track_t * ptrack)
+{
+  mfsl_async_dep_track_t *pparent;
+
+  while(ptrack != NULL)
+    {
+      if(--ptrack->refcount > 0)
+        return;
+
+      pparent = ptrack->pparent;
+      if(pparent != NULL)
+        glist_del(&ptrack->child_link);
+
+      glist_del(&ptrack->hash_link);
+      ReleaseToPool(ptrack, &dep_track_pool);
+
+      ptrack = pparent;
+    }
+}                               /* mfsl_async_dep_put_track */
+
+/**
+ *
+ * mfsl_async_dep_reserve_edges: allocates the edges an operation needs.
+ *
+ * @param nb_edge [IN]  the number of edges.
+ * @param ppedge  [OUT] the allocated edges, chained on their next field.
+ *
+ * @return TRUE if all the edges were allocated, FALSE otherwise (none is kept then).
+ *
+ */
+static int mfsl_async_dep_reserve_edges(unsigned int nb_edge,
+                                        mfsl_async_dep_edge_t ** ppedge)
+{
+  mfsl_async_dep_edge_t *pedge;
+
+  *ppedge = NULL;
+
+  while(nb_edge-- > 0)
+    {
+      GetFromPool(pedge, &dep_edge_pool, mfsl_async_dep_edge_t);
+      if(pedge == NULL)
+        {
+          while((pedge = *ppedge) != NULL)
+            {
+              *ppedge = pedge->next;
+              ReleaseToPool(pedge, &dep_edge_pool);
+            }
+          return FALSE;
+        }
+
+      pedge->next = *ppedge;
+      *ppedge = pedge;
+    }
+
+  return TRUE;
+}                               /* mfsl_async_dep_reserve_edges */
+
+/* psucc will not be dispatched before ppred is done, the edge is taken from
+ * the ones reserved by mfsl_async_dep_reserve_edges */
+static void mfsl_async_dep_add_edge(mfsl_async_op_desc_t * ppred,
+                                    mfsl_async_op_desc_t * psucc,
+                                    mfsl_async_dep_edge_t ** ppedge)
+{
+  mfsl_async_dep_edge_t *pedge;
+
+  if(ppred == NULL || ppred == psucc)
+    return;
+
+  pedge = *ppedge;
+  *ppedge = pedge->next;
+
+  pedge->psucc = psucc;
+  pedge->next = ppred->psucc;
+  ppred->psucc = pedge;
+  psucc->nb_pred += 1;
+}                               /* mfsl_async_dep_add_edge */
+
+/* Number of edges mfsl_async_dep_add_edge will use for ppred */
+#define MFSL_ASYNC_DEP_EDGE_NEEDED( ppred, psucc ) \
+  ( ( (ppred) != NULL && (ppred) != (psucc) ) ? 1 : 0 )
+
+/**
+ *
+ * mfsl_async_merge_attrs: merges the attributes of a setattr into another one.
+ *
+ * The attributes of psrc override the ones of pdest.
+ *
+ * @param pdest [INOUT] the attributes to be set first.
+ * @param psrc  [IN]    the attributes to be set next.
+ *
+ * @return TRUE if the attributes were merged, FALSE if psrc holds an attribute
+ *         that can't be.
+ *
+ */
+int mfsl_async_merge_attrs(fsal_attrib_list_t * pdest, fsal_attrib_list_t * psrc)
+{
+  if(psrc->asked_attributes & ~MFSL_ASYNC_MERGEABLE_ATTRS)
+    return FALSE;
+
+  if(psrc->asked_attributes & FSAL_ATTR_SIZE)
+    pdest->filesize = psrc->filesize;
+
+  if(psrc->asked_attributes & FSAL_ATTR_MODE)
+    pdest->mode = psrc->mode;
+
+  if(psrc->asked_attributes & FSAL_ATTR_OWNER)
+    pdest->owner = psrc->owner;
+
+  if(psrc->asked_attributes & FSAL_ATTR_GROUP)
+    pdest->group = psrc->group;
+
+  if(psrc->asked_attributes & FSAL_ATTR_ATIME)
+    pdest->atime = psrc->atime;
+
+  if(psrc->asked_attributes & FSAL_ATTR_MTIME)
+    pdest->mtime = psrc->mtime;
+
+  pdest->asked_attributes |= psrc->asked_attributes;
+
+  return TRUE;
+}                               /* mfsl_async_merge_attrs */
+
+/**
+ *
+ * mfsl_async_dep_coalesce: merges a setattr or a truncate into the pending op on the same object.
+ *
+ * @param popdesc [IN] the operation that is posted.
+ * @param ptrack  [IN] the track of the object it works on.
+ *
+ * @return TRUE if the operation was merged, FALSE otherwise.
+ *
+ */
+static int mfsl_async_dep_coalesce(mfsl_async_op_desc_t * popdesc,
+                                   mfsl_async_dep_track_t * ptrack)
+{
+  mfsl_async_op_desc_t *plast = ptrack->plast;
+  fsal_attrib_list_t *pattr = NULL;
+  fsal_op_context_t *pcontext = &popdesc->fsal_op_context;
+  fsal_op_context_t *plast_context;
+
+  /* The op on the object must not have started, and no op on the entries of
+   * a directory may come in between */
+  if(plast == NULL || plast->dispatched || !glist_empty(&ptrack->children))
+    return FALSE;
+
+  /* The merged op is done with the credentials of the pending one. A create or
+   * a mkdir runs as root, the attributes are then set for its caller. */
+  switch (plast->op_type)
+    {
+    case MFSL_ASYNC_OP_CREATE:
+      if(plast->op_args.create.owner != FSAL_OP_CONTEXT_TO_UID(pcontext) ||
+         plast->op_args.create.group != FSAL_OP_CONTEXT_TO_GID(pcontext))
+        return FALSE;
+      break;
+
+    case MFSL_ASYNC_OP_MKDIR:
+      if(plast->op_args.mkdir.owner != FSAL_OP_CONTEXT_TO_UID(pcontext) ||
+         plast->op_args.mkdir.group != FSAL_OP_CONTEXT_TO_GID(pcontext))
+        return FALSE;
+      break;
+
+    default:
+      plast_context = &plast->fsal_op_context;
+      if(FSAL_OP_CONTEXT_TO_UID(plast_context) != FSAL_OP_CONTEXT_TO_UID(pcontext) ||
+         FSAL_OP_CONTEXT_TO_GID(plast_context) != FSAL_OP_CONTEXT_TO_GID(pcontext))
+        return FALSE;
+      break;
+    }
+
+  if(popdesc->op_type == MFSL_ASYNC_OP_TRUNCATE)
+    {
+      if(plast->op_type != MFSL_ASYNC_OP_TRUNCATE)
+        return FALSE;
+
+      plast->op_args.truncate.size = popdesc->op_args.truncate.size;
+    }
+  else
+    {
+      switch (plast->op_type)
+        {
+        case MFSL_ASYNC_OP_CREATE:
+          pattr = &plast->op_args.create.attr_set;
+          break;
+
+        case MFSL_ASYNC_OP_MKDIR:
+          pattr = &plast->op_args.mkdir.attr_set;
+          break;
+
+        case MFSL_ASYNC_OP_SETATTR:
+          pattr = &plast->op_args.setattr.attr;
+          break;
+
+        default:
+          return FALSE;
+        }
+
+      if(!mfsl_async_merge_attrs(pattr, &popdesc->op_args.setattr.attr))
+        return FALSE;
+    }
+
+  LogDebug(COMPONENT_MFSL, "Asyncop %p (%s) coalesced into asyncop %p (%s)",
+           popdesc, mfsl_async_op_name[popdesc->op_type],
+           plast, mfsl_async_op_name[plast->op_type]);
+
+  return TRUE;
+}                               /* mfsl_async_dep_coalesce */
+
+/**
+ *
+ * mfsl_async_dep_post: orders an operation behind the pending ones it depends on.
+ *
+ * @param popdesc [INOUT] the operation that is posted.
+ *
+ * @return TRUE if the operation was merged into a pending one (it must not be
+ *         posted then), FALSE otherwise.
+ *
+ */
+int mfsl_async_dep_post(mfsl_async_op_desc_t * popdesc)
+{
+  mfsl_object_t *pobject = NULL;
+  mfsl_object_t *pdir = NULL;
+  fsal_name_t *pname = NULL;
+  mfsl_object_t *pdir2 = NULL;
+  fsal_name_t *pname2 = NULL;
+  mfsl_async_dep_track_t *ptrack;
+  mfsl_async_dep_track_t *pobject_track = NULL;
+  mfsl_async_dep_edge_t *pedge = NULL;
+  struct glist_head *node;
+  unsigned int nb_edge;
+  unsigned int i;
+
+  popdesc->nb_pred = 0;
+  popdesc->psucc = NULL;
+  popdesc->nb_track = 0;
+  popdesc->dispatched = FALSE;
+
+  switch (popdesc->op_type)
+    {
+    case MFSL_ASYNC_OP_CREATE:
+      pobject = popdesc->op_mobject;
+      pdir = popdesc->op_args.create.pmfsl_obj_dirdest;
+      pname = &popdesc->op_args.create.filename;
+      break;
+
+    case MFSL_ASYNC_OP_MKDIR:
+      pobject = popdesc->op_mobject;
+      pdir = popdesc->op_args.mkdir.pmfsl_obj_dirdest;
+      pname = &popdesc->op_args.mkdir.dirname;
+      break;
+
+    case MFSL_ASYNC_OP_SYMLINK:
+      pobject = popdesc->op_mobject;
+      pdir = popdesc->op_args.symlink.pmobject_dirdest;
+      pname = &popdesc->op_args.symlink.linkname;
+      break;
+
+    case MFSL_ASYNC_OP_LINK:
+      pobject = popdesc->op_args.link.pmobject_src;
+      pdir = popdesc->op_args.link.pmobject_dirdest;
+      pname = &popdesc->op_args.link.name_link;
+      break;
+
+    case MFSL_ASYNC_OP_REMOVE:
+      pdir = popdesc->op_args.remove.pmobject;
+      pname = &popdesc->op_args.remove.name;
+      break;
+
+    case MFSL_ASYNC_OP_RENAME:
+      pdir = popdesc->op_args.rename.pmobject_src;
+      pname = &popdesc->op_args.rename.name_src;
+      pdir2 = popdesc->op_args.rename.pmobject_dirdest;
+      pname2 = &popdesc->op_args.rename.name_dest;
+      break;
+
+    case MFSL_ASYNC_OP_SETATTR:
+      pobject = popdesc->op_args.setattr.pmobject;
+      break;
+
+    case MFSL_ASYNC_OP_TRUNCATE:
+      pobject = popdesc->op_args.truncate.pmobject;
+      break;
+    }
+
+  if(pobject != NULL && (ptrack = mfsl_async_dep_get_track(&pobject->handle, NULL)) != NULL)
+    {
+      if((popdesc->op_type == MFSL_ASYNC_OP_SETATTR ||
+          popdesc->op_type == MFSL_ASYNC_OP_TRUNCATE) &&
+         mfsl_async_dep_coalesce(popdesc, ptrack))
+        {
+          mfsl_async_dep_put_track(ptrack);
+          return TRUE;
+        }
+
+      pobject_track = ptrack;
+      popdesc->ptrack[popdesc->nb_track++] = ptrack;
+    }
+
+  for(i = 0; i < 2; i++)
+    {
+      if(i == 1)
+        {
+          pdir = pdir2;
+          pname = pname2;
+        }
+
+      if(pdir == NULL || (ptrack = mfsl_async_dep_get_track(&pdir->handle, pname)) == NULL)
+        continue;
+
+      if(popdesc->nb_track == MFSL_ASYNC_DEP_MAX_KEYS)
+        {
+          mfsl_async_dep_put_track(ptrack);
+          break;
+        }
+
+      popdesc->ptrack[popdesc->nb_track++] = ptrack;
+    }
+
+  /* The edges are allocated before the op is linked to any pending one. If
+   * they can't be, wait for pending ops to complete: they release their
+   * edges, and the op has less ops to wait for. The tracks are held meanwhile. */
+  while(1)
+    {
+      nb_edge = 0;
+
+      for(i = 0; i < popdesc->nb_track; i++)
+        {
+          ptrack = popdesc->ptrack[i];
+
+          nb_edge += MFSL_ASYNC_DEP_EDGE_NEEDED(ptrack->plast, popdesc);
+
+          if(ptrack == pobject_track)
+            {
+              glist_for_each(node, &ptrack->children)
+                nb_edge += MFSL_ASYNC_DEP_EDGE_NEEDED(glist_entry(node, mfsl_async_dep_track_t,
+                                                                  child_link)->plast, popdesc);
+            }
+          else if(ptrack->pparent != NULL)
+            nb_edge += MFSL_ASYNC_DEP_EDGE_NEEDED(ptrack->pparent->plast, popdesc);
+        }
+
+      if(mfsl_async_dep_reserve_edges(nb_edge, &pedge))
+        break;
+
+      LogCrit(COMPONENT_MFSL,
+              "Could not allocate %u dependencies for asyncop %p (%s), waiting for the pending asyncops",
+              nb_edge, popdesc, mfsl_async_op_name[popdesc->op_type]);
+
+      dep_edge_waiters++;
+      pthread_cond_wait(&dep_edge_cond, &mutex_async_list);
+      dep_edge_waiters--;
+    }
+
+  for(i = 0; i < popdesc->nb_track; i++)
+    {
+      ptrack = popdesc->ptrack[i];
+
+      if(ptrack == pobject_track)
+        {
+          /* Behind the ops on the object and on its entries if it is a directory */
+          mfsl_async_dep_add_edge(ptrack->plast, popdesc, &pedge);
+          glist_for_each(node, &ptrack->children)
+            mfsl_async_dep_add_edge(glist_entry(node, mfsl_async_dep_track_t,
+                                                child_link)->plast, popdesc, &pedge);
+        }
+      else
+        {
+          /* Behind the ops on the entry and on the directory itself */
+          mfsl_async_dep_add_edge(ptrack->plast, popdesc, &pedge);
+          if(ptrack->pparent != NULL)
+            mfsl_async_dep_add_edge(ptrack->pparent->plast, popdesc, &pedge);
+        }
+
+      ptrack->plast = popdesc;
+    }
+
+  /* A pending op met on several keys may have been counted twice */
+  while(pedge != NULL)
+    {
+      mfsl_async_dep_edge_t *pnext = pedge->next;
+
+      ReleaseToPool(pedge, &dep_edge_pool);
+      pedge = pnext;
+    }
+
+  if(popdesc->nb_pred != 0)
+    LogFullDebug(COMPONENT_MFSL, "Asyncop %p (%s) waits for %u pending asyncops",
+                 popdesc, mfsl_async_op_name[popdesc->op_type], popdesc->nb_pred);
+
+  return FALSE;
+}                               /* mfsl_async_dep_post */
+
+/**
+ *
+ * mfsl_async_dep_complete: releases the operations that wait for one that is done.
+ *
+ * @param popdesc [INOUT] the operation that is done.
+ *
+ * @return the number of operations that can be dispatched now.
+ *
+ */
+int mfsl_async_dep_complete(mfsl_async_op_desc_t * popdesc)
+{
+  mfsl_async_dep_edge_t *pedge;
+  unsigned int i;
+  int nb_ready = 0;
+
+  for(i = 0; i < popdesc->nb_track; i++)
+    {
+      if(popdesc->ptrack[i]->plast == popdesc)
+        popdesc->ptrack[i]->plast = NULL;
+
+      mfsl_async_dep_put_track(popdesc->ptrack[i]);
+    }
+  popdesc->nb_track = 0;
+
+  while((pedge = popdesc->psucc) != NULL)
+    {
+      popdesc->psucc = pedge->next;
+
+      if(--pedge->psucc->nb_pred == 0)
+        nb_ready += 1;
+
+      ReleaseToPool(pedge, &dep_edge_pool);
+    }
+
+  if(dep_edge_waiters != 0)
+    pthread_cond_broadcast(&dep_edge_cond);
+
+  return nb_ready;
+}                               /* mfsl_async_dep_complete */
+
+#endif                          /* ! _USE_SWIG */
@@ -99,17 +99,22 @@ fsal_status_t MFSL_mkdir_async_op(mfsl_async_op_desc_t * popasyncdesc)
     return fsal_status;
 
   /* If user is not root, setattr to chown the entry */
+  chown_attr.asked_attributes = 0;
   if(popasyncdesc->op_args.mkdir.owner != 0)
     {
       chown_attr.asked_attributes = FSAL_ATTR_MODE | FSAL_ATTR_OWNER | FSAL_ATTR_GROUP;
       chown_attr.mode = popasyncdesc->op_args.mkdir.mode;
       chown_attr.owner = popasyncdesc->op_args.mkdir.owner;
       chown_attr.group = popasyncdesc->op_args.mkdir.group;
-
-      fsal_status =
-          FSAL_setattrs(&handle, &popasyncdesc->fsal_op_context, &chown_attr,
-                        &popasyncdesc->op_res.mkdir.attr);
     }
+
+  /* The setattrs coalesced with the mkdir are done by the same call */
+  mfsl_async_merge_attrs(&chown_attr, &popasyncdesc->op_args.mkdir.attr_set);
+
+  if(chown_attr.asked_attributes != 0)
+    fsal_status =
+        FSAL_setattrs(&handle, &popasyncdesc->fsal_op_context, &chown_attr,
+                      &popasyncdesc->op_res.mkdir.attr);
   return fsal_status;
 }                               /* MFSL_mkdir_async_op */
 
@@ -212,10 +217,12 @@ fsal_status_t MFSL_mkdir(mfsl_object_t * parent_directory_handle,       /* IN */
                     pasyncopdesc);
 
   pasyncopdesc->op_type = MFSL_ASYNC_OP_MKDIR;
+  pasyncopdesc->op_mobject = pnewdir_handle;
   pasyncopdesc->op_args.mkdir.pmfsl_obj_dirdest = parent_directory_handle;
   pasyncopdesc->op_args.mkdir.precreate_name = pprecreated->name;
   pasyncopdesc->op_args.mkdir.dirname = *p_dirname;
   pasyncopdesc->op_args.mkdir.mode = accessmode;
+  pasyncopdesc->op_args.mkdir.attr_set.asked_attributes = 0;
   pasyncopdesc->op_args.mkdir.owner = FSAL_OP_CONTEXT_TO_UID(p_context);
   pasyncopdesc->op_args.mkdir.group = FSAL_OP_CONTEXT_TO_GID(p_context);
   pasyncopdesc->op_res.mkdir.attr.asked_attributes = object_attributes->asked_attributes;
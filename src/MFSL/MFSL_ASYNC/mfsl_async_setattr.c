@@ -138,6 +138,7 @@ fsal_status_t MFSL_setattrs(mfsl_object_t * filehandle, /* IN */
   fsal_status_t fsal_status;
   mfsl_async_op_desc_t *pasyncopdesc = NULL;
   mfsl_object_specific_data_t *pasyncdata = NULL;
+  struct timeval op_time;
 
   P(p_mfsl_context->lock);
 
@@ -187,16 +188,20 @@ fsal_status_t MFSL_setattrs(mfsl_object_t * filehandle, /* IN */
 
   pasyncopdesc->op_func = MFSL_setattr_async_op;
   pasyncopdesc->fsal_op_context = *p_context;
+  pasyncopdesc->fsal_op_context.credential.grouplist = NULL;
 
   pasyncopdesc->ptr_mfsl_context = (caddr_t) p_mfsl_context;
 
+  /* The descriptor may be merged into a pending one by MFSL_async_post */
+  op_time = pasyncopdesc->op_time;
+
   fsal_status = MFSL_async_post(pasyncopdesc);
   if(FSAL_IS_ERROR(fsal_status))
     return fsal_status;
 
   /* Update the associated times for this object */
-  pasyncdata->async_attr.ctime.seconds = pasyncopdesc->op_time.tv_sec;
-  pasyncdata->async_attr.ctime.nseconds = pasyncopdesc->op_time.tv_usec;  /** @todo: there may be a coefficient to be applied here */
+  pasyncdata->async_attr.ctime.seconds = op_time.tv_sec;
+  pasyncdata->async_attr.ctime.nseconds = op_time.tv_usec;  /** @todo: there may be a coefficient to be applied here */
   filehandle->health = MFSL_ASYNC_ASYNCHRONOUS;
 
   /* merge the attributes to the asynchronous attributes */
@@ -204,6 +204,7 @@ fsal_status_t MFSL_symlink(mfsl_object_t * parent_directory_handle,     /* IN */
                     pasyncopdesc);
 
   pasyncopdesc->op_type = MFSL_ASYNC_OP_SYMLINK;
+  pasyncopdesc->op_mobject = link_handle;
 
   pasyncopdesc->op_args.symlink.pmobject_dirdest = parent_directory_handle;
   pasyncopdesc->op_args.symlink.precreate_name = tmp_fsal_name;
@@ -54,12 +54,16 @@ extern unsigned int end_of_mfsl;
 
 LRU_list_t *async_op_lru;
 pthread_mutex_t mutex_async_list;
+pthread_cond_t cond_async_list = PTHREAD_COND_INITIALIZER;
 
 /**
  *
  * MFSL_async_post: posts an asynchronous operation to the pending operations list.
  *
- * Posts an asynchronous operation to the pending operations list.
+ * Posts an asynchronous operation to the pending operations list. The operation
+ * is ordered behind the pending ones on the same objects, a setattr or a
+ * truncate may be merged into one of them: popdesc is released then and must
+ * not be used by the caller anymore.
  *
  * @param popdesc [IN]    the asynchronous operation descriptor
  *
@@ -68,13 +72,31 @@ fsal_status_t MFSL_async_post(mfsl_async_op_desc_t * popdesc)
 {
   LRU_entry_t *plru_entry = NULL;
   LRU_status_t lru_status;
+  mfsl_context_t *pmfsl_context;
 /* Do not use RPCBIND by default */
 #define  _RPCB_PROT_H_RPCGEN
 
   P(mutex_async_list);
 
+  if(mfsl_async_dep_post(popdesc))
+    {
+      V(mutex_async_list);
+
+      /* Coalesced into a pending op, there is nothing left to do */
+      pmfsl_context = (mfsl_context_t *) popdesc->ptr_mfsl_context;
+
+      P(pmfsl_context->lock);
+      ReleaseToPool(popdesc, &pmfsl_context->pool_async_op);
+      V(pmfsl_context->lock);
+
+      MFSL_return(ERR_FSAL_NO_ERROR, 0);
+    }
+
   if((plru_entry = LRU_new_entry(async_op_lru, &lru_status)) == NULL)
     {
+      mfsl_async_dep_complete(popdesc);
+      V(mutex_async_list);
+
       LogMajor(COMPONENT_MFSL,"Impossible to post async operation in LRU dispatch list");
       MFSL_return(ERR_FSAL_SERVERFAULT, (int)lru_status);
     }
@@ -119,6 +141,12 @@ fsal_status_t mfsl_async_process_async_op(mfsl_async_op_desc_t * pasyncopdesc)
                     pasyncopdesc->op_type, mfsl_async_op_name[pasyncopdesc->op_type],
                     fsal_status.major, fsal_status.minor);
 
+  /* The ops that waited for this one can be dispatched */
+  P(mutex_async_list);
+  if(mfsl_async_dep_complete(pasyncopdesc) > 0)
+    pthread_cond_signal(&cond_async_list);
+  V(mutex_async_list);
+
   /* Free the previously allocated structures */
   pmfsl_context = (mfsl_context_t *) pasyncopdesc->ptr_mfsl_context;
 
@@ -416,6 +444,7 @@ void *mfsl_async_asynchronous_dispatcher_thread(void *Arg)
   unsigned int passcounter = 0;
   struct timeval current;
   struct timeval delta;
+  struct timespec timeout;
   mfsl_async_op_desc_t *pasyncopdesc = NULL;
   SetNameFunction("MFSL_ASYNC ADT");
 
@@ -439,21 +468,32 @@ void *mfsl_async_asynchronous_dispatcher_thread(void *Arg)
   if((rc = pthread_mutex_init(&mutex_async_list, NULL)) != 0)
     return NULL;
 
+  if(mfsl_async_dep_init() != 0)
+    {
+      LogMajor(COMPONENT_MFSL,"Could not init the dependencies between asynchronous operations");
+      exit(1);
+    }
+
   LogEvent(COMPONENT_MFSL, "Started...");
   while(!end_of_mfsl)
     {
-      /* Sleep for a while */
-      usleep(60000);
+      /* Sleep for a while, or until a synclet releases waiting ops */
+      gettimeofday(&current, NULL);
+      timeout.tv_sec = current.tv_sec + (current.tv_usec + 60000) / 1000000;
+      timeout.tv_nsec = ((current.tv_usec + 60000) % 1000000) * 1000;
+
+      P(mutex_async_list);
+      pthread_cond_timedwait(&cond_async_list, &mutex_async_list, &timeout);
 
       // sleep( mfsl_param.adt_sleeptime ) ;
       if(gettimeofday(&current, NULL) != 0)
         {
           /* Could'not get time of day... Stopping, this may need a major failure */
           LogCrit(COMPONENT_MFSL, " cannot get time of day...");
+          V(mutex_async_list);
           continue;
         }
 
-      P(mutex_async_list);
       for(pentry_dispatch = async_op_lru->LRU; pentry_dispatch != NULL;
           pentry_dispatch = pentry_dispatch->next)
         {
@@ -472,6 +512,11 @@ void *mfsl_async_asynchronous_dispatcher_thread(void *Arg)
               if(delta.tv_usec < mfsl_param.async_window_usec)
                 break;
 
+              /* Still waiting for an op on the same object, the ones behind
+               * it may be independent */
+              if(pasyncopdesc->nb_pred > 0)
+                continue;
+
               /* Choose a synclet to operate on */
               chosen_synclet = mfsl_async_choose_synclet();
               pasyncopdesc->related_synclet_index = chosen_synclet;
@@ -503,6 +548,9 @@ void *mfsl_async_asynchronous_dispatcher_thread(void *Arg)
                                 chosen_synclet);
               V(synclet_data[chosen_synclet].mutex_op_condvar);
 
+              /* Nothing can be merged into it from now on */
+              pasyncopdesc->dispatched = TRUE;
+
               /* Invalidate the entry in dispatch list */
               LRU_invalidate(async_op_lru, pentry_dispatch);
             }
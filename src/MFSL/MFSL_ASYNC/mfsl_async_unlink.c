@@ -177,6 +177,7 @@ fsal_status_t MFSL_unlink(mfsl_object_t * dir_handle,   /* IN */
 
   pasyncopdesc->op_func = MFSL_unlink_async_op;
   pasyncopdesc->fsal_op_context = *p_context;
+  pasyncopdesc->fsal_op_context.credential.grouplist = NULL;
 
   pasyncopdesc->ptr_mfsl_context = (caddr_t) p_mfsl_context;
 
@@ -74,6 +74,7 @@ void DispatchWork9P( request_data_t *preq, unsigned int worker_index)
 {
   LRU_entry_t *pentry = NULL;
   LRU_status_t status;
+  bool_t running;
 
   LogDebug(COMPONENT_DISPATCH,
            "Awaking Worker Thread #%u for 9P request %p, tcpsock=%lu",
@@ -106,8 +107,13 @@ void DispatchWork9P( request_data_t *preq, unsigned int worker_index)
                errno, strerror(errno), worker_index);
       Fatal();
     }
+  running = workers_data[worker_index].running;
   V(workers_data[worker_index].request_pool_mutex);
   V(workers_data[worker_index].wcb.tcb_mutex);
+
+  /* The worker was chosen before it retired: get a thread back on its queue */
+  if(!running)
+    nfs_worker_pool_revive(worker_index);
 }
 
 
@@ -322,7 +322,10 @@ int ganefuse_main(int argc, char *argv[],
 
   /* if this is a single threaded application, set worker count */
   if(single_threaded)
-    nfs_param.core_param.nb_worker = 1;
+    {
+      nfs_param.core_param.nb_worker = 1;
+      nfs_param.core_param.nb_max_worker = 1;
+    }
 
   /* check parameters consitency */
 
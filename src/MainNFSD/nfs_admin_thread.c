@@ -45,13 +45,15 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
+#include <time.h>
 #include "nfs_core.h"
 #include "stuff_alloc.h"
 #include "log_macros.h"
 #include "nfs_tcb.h"
+#include "nfs_qos.h"
 
-exportlist_t *temp_pexportlist;
 pthread_cond_t admin_condvar = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t mutex_admin_condvar = PTHREAD_MUTEX_INITIALIZER;
 bool_t reload_exports;
@@ -73,11 +75,47 @@ void admin_replace_exports()
   V(mutex_admin_condvar);
 }
 
-/* Skips deleting first entry of export list. */
+/* Frees the entries of a reload that did not make it into the export list */
+static void discard_export_list(exportlist_t * pexportlist)
+{
+  while(pexportlist != NULL)
+    {
+      if(pexportlist->proot_handle != NULL)
+        CleanUpExportContext(&pexportlist->FS_export_context);
+      pexportlist = RemoveExportEntry(pexportlist);
+    }
+}
+
+/**
+ *
+ * rebuild_export_list: reloads the export list without pausing the workers.
+ *
+ * The new configuration is compared to the active one. The exports whose block
+ * did not change are kept as they are, with their FSAL context and their
+ * compiled client list. Only the added and changed exports are set up. The new
+ * list is then published and the exports removed or replaced are freed once
+ * no worker may still be using them.
+ *
+ * @return 1 if the new exports are active, 0 or less otherwise.
+ *
+ */
 int rebuild_export_list()
 {
   int status = 0;
   config_file_t config_struct;
+  exportlist_t *pnewlist = NULL;
+  exportlist_t *pentry;
+  exportlist_t *pnext;
+  exportlist_t *pold;
+  exportlist_t *pfresh = NULL;      /* added and changed entries, to be set up */
+  exportlist_t *pfresh_tail = NULL;
+  exportlist_t **pactive;           /* the new list, in the order of the configuration */
+  exportlist_t **pretired;          /* the old entries to be freed */
+  unsigned int nb_active = 0;
+  unsigned int nb_retired = 0;
+  unsigned int nb_kept = 0;
+  unsigned int nb_old = 0;
+  unsigned int i;
 
   /* If no configuration file is given, then the caller must want to reparse the
    * configuration file from startup. */
@@ -99,7 +137,7 @@ int rebuild_export_list()
     }
 
   /* Create the new exports list */
-  status = ReadExports(config_struct, &temp_pexportlist);
+  status = ReadExports(config_struct, &pnewlist);
   if(status < 0)
     {
       LogCrit(COMPONENT_CONFIG,
@@ -113,53 +151,132 @@ int rebuild_export_list()
       return status;
     }
 
+  for(pentry = nfs_param.pexportlist; pentry != NULL; pentry = pentry->next)
+    nb_old++;
+
+  pactive = (exportlist_t **) Mem_Alloc((status + 1) * sizeof(exportlist_t *));
+  pretired = (exportlist_t **) Mem_Alloc((nb_old + 1) * sizeof(exportlist_t *));
+  if(pactive == NULL || pretired == NULL)
+    {
+      LogCrit(COMPONENT_MAIN,
+              "rebuild_export_list: could not allocate the reload tables");
+      if(pactive != NULL)
+        Mem_Free(pactive);
+      if(pretired != NULL)
+        Mem_Free(pretired);
+      discard_export_list(pnewlist);
+      return 0;
+    }
+
+  /* Keep the entries whose configuration block did not change */
+  for(pentry = pnewlist; pentry != NULL; pentry = pnext)
+    {
+      pnext = pentry->next;
+      pentry->next = NULL;
+
+      pold = nfs_Get_export_by_id(nfs_param.pexportlist, pentry->id);
+
+      /* An id given twice keeps its first entry only once */
+      for(i = 0; pold != NULL && i < nb_active; i++)
+        if(pactive[i] == pold)
+          pold = NULL;
+
+      if(pold != NULL && pold->status == EXPORTLIST_OK &&
+         pold->config_signature == pentry->config_signature)
+        {
+          RemoveExportEntry(pentry);
+          pactive[nb_active++] = pold;
+          nb_kept++;
+          continue;
+        }
+
+      pactive[nb_active++] = pentry;
+      if(pfresh_tail == NULL)
+        pfresh = pentry;
+      else
+        pfresh_tail->next = pentry;
+      pfresh_tail = pentry;
+    }
+
   /* At least one worker thread should exist. Each worker thread has a pointer to
    * the same hash table. */
-  if(nfs_export_create_root_entry(temp_pexportlist, admin_ht) != TRUE)
+  if(pfresh != NULL && nfs_export_create_root_entry(pfresh, admin_ht) != TRUE)
     {
       LogCrit(COMPONENT_MAIN,
               "replace_exports: Error initializing Cache Inode root entries");
+      discard_export_list(pfresh);
+      Mem_Free(pactive);
+      Mem_Free(pretired);
       return 0;
     }
 
-  return 1;
-}
+  /* The old entries that are not in the new list go away */
+  for(pold = nfs_param.pexportlist; pold != NULL; pold = pold->next)
+    {
+      for(i = 0; i < nb_active; i++)
+        if(pactive[i] == pold)
+          break;
 
-static void ChangeoverExports()
-{
-  exportlist_t *pcurrent;
+      if(i == nb_active)
+        pretired[nb_retired++] = pold;
+    }
 
-  /* Now we know that the configuration was parsed successfully.
-   * And that worker threads are no longer accessing the export list.
-   * Remove all but the first export entry in the exports list.
-   */
-  pcurrent = nfs_param.pexportlist->next;
+  /* Link the new list from its tail, a reader walking the old list meanwhile
+   * goes on in the new one, entries are not freed under it */
+  for(i = nb_active; i > 0; i--)
+    pactive[i - 1]->next = (i < nb_active) ? pactive[i] : NULL;
 
-  while(pcurrent != NULL)
-    {
-      /* Leave the head so that the list may be replaced later without
-       * changing the reference pointer in worker threads. */
-      CleanUpExportContext(&pcurrent->FS_export_context);
+  /* Requests that still find a retired entry stop using it */
+  for(i = 0; i < nb_retired; i++)
+    pretired[i]->status = EXPORTLIST_UNAVAILABLE;
+
+  nfs_Build_export_index(pactive[0]);
+  __sync_synchronize();
+  nfs_param.pexportlist = pactive[0];
+
+  if(nfs4_PseudoFS_Reload(nfs_param.pexportlist) != 0)
+    LogCrit(COMPONENT_MAIN,
+            "rebuild_export_list: the NFSv4 pseudo fs could not be updated");
 
-      if (pcurrent == nfs_param.pexportlist)
-        break;
+  if(nfs_qos_update_exports(nfs_param.pexportlist) != 0)
+    LogCrit(COMPONENT_MAIN,
+            "rebuild_export_list: the QoS classes of the exports could not be updated");
 
-      nfs_param.pexportlist->next = RemoveExportEntry(pcurrent);
-      pcurrent = nfs_param.pexportlist->next;
+  /* Wait for the requests that may use a retired entry, then free them */
+  nfs_export_synchronize();
+
+#ifdef _USE_FSAL_UP
+  /* The FSAL UP threads of the retired entries use them too */
+  stop_fsal_up_threads(pretired, nb_retired);
+#endif
+
+  for(i = 0; i < nb_retired; i++)
+    {
+      pretired[i]->next = NULL;
+      CleanUpExportContext(&pretired[i]->FS_export_context);
+      RemoveExportEntry(pretired[i]);
     }
 
-  /* Changed the old export list head to the new export list head.
-   * All references to the exports list should be up-to-date now. */
-  memcpy(nfs_param.pexportlist, temp_pexportlist, sizeof(exportlist_t));
+#ifdef _USE_FSAL_UP
+  /* Start those of the new entries, and of the file systems whose thread
+   * belonged to a retired entry */
+  create_fsal_up_threads();
+#endif
 
-  /* We no longer need the head that was created for
-   * the new list since the export list is built as a linked list. */
-  Mem_Free(temp_pexportlist);
-  temp_pexportlist = NULL;
-}
+  LogEvent(COMPONENT_MAIN,
+           "Exports reloaded: %u kept, %u added or changed, %u removed or replaced",
+           nb_kept, nb_active - nb_kept, nb_retired);
+
+  Mem_Free(pactive);
+  Mem_Free(pretired);
+
+  return 1;
+}                               /* rebuild_export_list */
 
 void *admin_thread(void *Arg)
 {
+  struct timespec deadline;
+  time_t refresh;
 #ifndef _NO_BUDDY_SYSTEM
   int rc = 0;
 #endif
@@ -179,31 +296,44 @@ void *admin_thread(void *Arg)
 
   while(1)
     {
+      /* The expanded netgroups are refreshed between the reloads */
+      refresh = nfs_export_refresh_netgroups(nfs_param.pexportlist);
+
       P(mutex_admin_condvar);
-      while(reload_exports == FALSE)
+      if(refresh == 0)
+        {
+          while(reload_exports == FALSE)
             pthread_cond_wait(&(admin_condvar), &(mutex_admin_condvar));
+        }
+      else
+        {
+          deadline.tv_sec = time(NULL) + refresh;
+          deadline.tv_nsec = 0;
+          while(reload_exports == FALSE)
+            if(pthread_cond_timedwait(&(admin_condvar), &(mutex_admin_condvar),
+                                      &deadline) == ETIMEDOUT)
+              break;
+        }
+
+      if(reload_exports == FALSE)
+        {
+          V(mutex_admin_condvar);
+          continue;
+        }
       reload_exports = FALSE;
       V(mutex_admin_condvar);
 
-      if (!rebuild_export_list())
+      /* The workers go on serving requests during the reload */
+      if (rebuild_export_list() <= 0)
         {
           LogCrit(COMPONENT_MAIN,
                   "Attempt to reload exports list from config file failed.");
           continue;
         }
 
-      if(pause_threads(PAUSE_RELOAD_EXPORTS) == PAUSE_EXIT)
-        {
-          LogDebug(COMPONENT_MAIN,
-                   "Export reload interrupted by shutdown while pausing threads");
-          /* Be helpfull and exit
-           * (other termination will just blow us away, and that's ok...
-           */
-          break;
-        }
-
       /* Clear the id mapping cache for gss principals to uid/gid.
-       * The id mapping may have changed.
+       * The id mapping may have changed. The lookups in progress keep the
+       * entries they found until they are done with them.
        */
 #ifdef _HAVE_GSSAPI
 #ifdef _USE_NFSIDMAP
@@ -213,23 +343,8 @@ void *admin_thread(void *Arg)
 #endif /* _USE_NFSIDMAP */
 #endif /* _HAVE_GSSAPI */
 
-      ChangeoverExports();
-
       LogEvent(COMPONENT_MAIN,
                "Exports reloaded and active");
-
-      /* wake_workers could return PAUSE_PAUSE, but we don't have to do
-       * anything special in that case.
-       */
-      if(wake_threads(AWAKEN_RELOAD_EXPORTS) == PAUSE_EXIT)
-        {
-          LogDebug(COMPONENT_MAIN,
-                   "Export reload interrupted by shutdown while waking threads");
-          /* Be helpfull and exit
-           * (other termination will just blow us away, and that's ok...
-           */
-          break;
-        }
     }
 
   return NULL;
@@ -0,0 +1,253 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_cache_inode_snapshot_thread.c
+ * \brief   The thread that reloads and saves the cache inode snapshot.
+ *
+ * nfs_cache_inode_snapshot_thread.c : the snapshot of the hottest cache inode
+ * entries is reloaded in the background at startup, then saved periodically
+ * (if Snapshot_Interval is set) and once more at shutdown.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "cache_content.h"
+#include "nfs_exports.h"
+
+/* Period of the garbage collection of the reloaded entries, when not configured */
+#define CACHE_INODE_SNAPSHOT_DEFAULT_PERIOD 60
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshot_cond = PTHREAD_COND_INITIALIZER;
+static int snapshot_stop_requested = FALSE;
+
+#ifndef _USE_SHARED_FSAL
+static cache_inode_client_t snapshot_client;
+static cache_content_client_t snapshot_content_client;
+static fsal_op_context_t snapshot_fsal_context;
+static nfs_export_reader_t snapshot_export_reader;
+
+/**
+ *
+ * nfs_cache_inode_snapshot_save: saves the snapshot now.
+ *
+ * @param ht [IN] the cache inode hash table.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void nfs_cache_inode_snapshot_save(hash_table_t * ht)
+{
+  cache_inode_client_parameter_t *pparam =
+      &nfs_param.cache_layers_param.cache_inode_client_param;
+  cache_inode_status_t status;
+  unsigned int nb_saved;
+
+  if(cache_inode_snapshot_save(ht, pparam->snapshot_file, pparam->snapshot_max_entries,
+                               &nb_saved, &status) != CACHE_INODE_SUCCESS)
+    LogCrit(COMPONENT_MAIN,
+            "CACHE INODE SNAPSHOT : could not save %s, status=%d",
+            pparam->snapshot_file, status);
+}                               /* nfs_cache_inode_snapshot_save */
+#endif
+
+/**
+ *
+ * cache_inode_snapshot_thread: reloads then saves the cache inode snapshot.
+ *
+ * The entries reloaded are owned by the thread's own cache inode client, the
+ * thread also runs the garbage collection of this client, like the workers do
+ * for theirs.
+ *
+ * @param arg [IN] the cache inode hash table.
+ *
+ * @return NULL when the thread is stopped.
+ *
+ */
+void *cache_inode_snapshot_thread(void *arg)
+{
+#ifdef _USE_SHARED_FSAL
+  SetNameFunction("cache_inode_snapshot_thread");
+
+  LogCrit(COMPONENT_MAIN,
+          "CACHE INODE SNAPSHOT : not supported with multiple FSALs, %s is not used",
+          nfs_param.cache_layers_param.cache_inode_client_param.snapshot_file);
+  return NULL;
+#else
+  hash_table_t *ht = (hash_table_t *) arg;
+  cache_inode_client_parameter_t *pparam =
+      &nfs_param.cache_layers_param.cache_inode_client_param;
+  cache_inode_status_t status;
+  fsal_status_t fsal_status;
+  unsigned int nb_loaded;
+  unsigned int period;
+  time_t last_save;
+  struct timeval now;
+  struct timespec timeout;
+  int stop = FALSE;
+#ifndef _NO_BUDDY_SYSTEM
+  int rc;
+#endif
+
+  SetNameFunction("cache_inode_snapshot_thread");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(&nfs_param.buddy_param_worker)) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogFatal(COMPONENT_MAIN,
+               "CACHE INODE SNAPSHOT : Memory manager could not be initialized");
+    }
+#endif
+
+  if(FSAL_IS_ERROR(FSAL_InitClientContext(&snapshot_fsal_context)))
+    {
+      LogCrit(COMPONENT_MAIN,
+              "CACHE INODE SNAPSHOT : Error initializing thread's credential");
+      return NULL;
+    }
+
+  nfs_export_reader_register(&snapshot_export_reader);
+
+  if(cache_inode_client_init(&snapshot_client, *pparam, SNAPSHOT_CLIENT_INDEX, NULL))
+    {
+      LogCrit(COMPONENT_MAIN,
+              "CACHE INODE SNAPSHOT : Cache Inode client could not be initialized");
+      return NULL;
+    }
+
+  if(cache_content_client_init(&snapshot_content_client,
+                               nfs_param.cache_layers_param.cache_content_client_param,
+                               "snapshot"))
+    {
+      LogCrit(COMPONENT_MAIN,
+              "CACHE INODE SNAPSHOT : Cache Content client could not be initialized");
+      return NULL;
+    }
+
+  snapshot_client.pcontent_client = (caddr_t) & snapshot_content_client;
+
+  /* Entries are reloaded with the credentials of the first export, as the
+   * export roots are at startup. A reload of the exports waits for the end
+   * of the load, the context is not used after it. */
+  nfs_export_read_begin(&snapshot_export_reader);
+
+  if(nfs_param.pexportlist == NULL)
+    LogCrit(COMPONENT_MAIN,
+            "CACHE INODE SNAPSHOT : No export, %s is not reloaded",
+            pparam->snapshot_file);
+  else
+    {
+      fsal_status = FSAL_GetClientContext(&snapshot_fsal_context,
+                                          &nfs_param.pexportlist->FS_export_context,
+                                          0, 0, NULL, 0);
+      if(FSAL_IS_ERROR(fsal_status))
+        LogCrit(COMPONENT_MAIN,
+                "CACHE INODE SNAPSHOT : Could not get a FSAL context, error %d.%d, %s is not reloaded",
+                fsal_status.major, fsal_status.minor, pparam->snapshot_file);
+      else
+        cache_inode_snapshot_load(ht, pparam->snapshot_file, &snapshot_client,
+                                  &snapshot_fsal_context, &nb_loaded, &status);
+    }
+
+  nfs_export_read_end(&snapshot_export_reader);
+
+  last_save = time(NULL);
+
+  period = (pparam->snapshot_interval != 0) ?
+      pparam->snapshot_interval : CACHE_INODE_SNAPSHOT_DEFAULT_PERIOD;
+  if(cache_inode_get_gc_policy().run_interval != 0 &&
+     cache_inode_get_gc_policy().run_interval < period)
+    period = cache_inode_get_gc_policy().run_interval;
+
+  while(!stop)
+    {
+      gettimeofday(&now, NULL);
+      timeout.tv_sec = now.tv_sec + period;
+      timeout.tv_nsec = now.tv_usec * 1000;
+
+      pthread_mutex_lock(&snapshot_mutex);
+      while(!snapshot_stop_requested &&
+            pthread_cond_timedwait(&snapshot_cond, &snapshot_mutex, &timeout) == 0) ;
+      stop = snapshot_stop_requested;
+      pthread_mutex_unlock(&snapshot_mutex);
+
+      if(stop)
+        break;
+
+      /* The reloaded entries are collected as the workers' are */
+      snapshot_client.call_since_last_gc = cache_inode_get_gc_policy().nb_call_before_gc;
+      snapshot_client.time_of_last_gc = 0;
+      cache_inode_gc(ht, &snapshot_client, &status);
+
+      if(pparam->snapshot_interval != 0 &&
+         time(NULL) - last_save >= (time_t) pparam->snapshot_interval)
+        {
+          nfs_cache_inode_snapshot_save(ht);
+          last_save = time(NULL);
+        }
+    }
+
+  /* The workers are stopped, this is the snapshot of the cache as they left it */
+  nfs_cache_inode_snapshot_save(ht);
+
+  LogEvent(COMPONENT_MAIN, "CACHE INODE SNAPSHOT : thread exiting");
+
+  return NULL;
+#endif                          /* _USE_SHARED_FSAL */
+}                               /* cache_inode_snapshot_thread */
+
+/**
+ *
+ * cache_inode_snapshot_stop: asks the snapshot thread to save and exit.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_inode_snapshot_stop(void)
+{
+  pthread_mutex_lock(&snapshot_mutex);
+  snapshot_stop_requested = TRUE;
+  pthread_cond_signal(&snapshot_cond);
+  pthread_mutex_unlock(&snapshot_mutex);
+}                               /* cache_inode_snapshot_stop */
@@ -133,7 +133,11 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
                p_flush_data->thread_index);
     }
 
-  /* check for each pexport entry to get those who are data cached */
+  /* check for each pexport entry to get those who are data cached, a reload
+   * waits for the flush to be done with the export it uses */
+  nfs_export_reader_register(&p_flush_data->export_reader);
+  nfs_export_read_begin(&p_flush_data->export_reader);
+
   for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
     {
 
@@ -169,18 +173,17 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
           snprintf(cache_sub_dir, MAXPATHLEN, "%s/export_id=%d",
                    nfs_param.cache_layers_param.cache_content_client_param.cache_dir, 0);
 
-          if(cache_content_emergency_flush(cache_sub_dir,
-                                           nfs_start_info.flush_behaviour,
-                                           nfs_start_info.lw_mark_trigger,
-                                           nfs_param.cache_layers_param.dcgcpol.emergency_grace_delay,
-                                           p_flush_data->thread_index,
-                                           nfs_start_info.nb_flush_threads,
-                                           &p_flush_data->nb_flushed,
-                                           &p_flush_data->nb_too_young,
-                                           &p_flush_data->nb_errors,
-                                           &p_flush_data->nb_orphans,
-                                           &(fsal_context[p_flush_data->thread_index]),
-                                           &content_status) != CACHE_CONTENT_SUCCESS)
+          /* The flushers share the list of files to be flushed, by priority */
+          if(cache_content_flusher_run(cache_sub_dir,
+                                       nfs_start_info.flush_behaviour,
+                                       nfs_start_info.lw_mark_trigger,
+                                       nfs_param.cache_layers_param.dcgcpol.emergency_grace_delay,
+                                       &p_flush_data->nb_flushed,
+                                       &p_flush_data->nb_too_young,
+                                       &p_flush_data->nb_errors,
+                                       &p_flush_data->nb_orphans,
+                                       &(fsal_context[p_flush_data->thread_index]),
+                                       &content_status) != CACHE_CONTENT_SUCCESS)
             {
               LogCrit(COMPONENT_MAIN,
                       "Flush on Export Entry #%u failed", pexport->id);
@@ -204,6 +207,8 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
                  pexport->id);
     }
 
+  nfs_export_read_end(&p_flush_data->export_reader);
+
   /* Tell the admin that flush is done */
   LogEvent(COMPONENT_MAIN,
            "NFS DATACACHE FLUSHER THREAD #%d : flush of the data cache is done for this thread. Closing thread",
@@ -46,6 +46,8 @@
 #include <string.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include <sys/file.h>           /* for having FNDELAY */
 #include "HashData.h"
 #include "HashTable.h"
@@ -138,6 +140,9 @@ int file_content_gc_manage_entry(LRU_entry_t * plru_entry, void *addparam)
 
 extern  nfs_tcb_t gccb;
 
+/* The export list is walked while a reload may replace it */
+static nfs_export_reader_t gc_export_reader;
+
 void *file_content_gc_thread(void *IndexArg)
 {
   char command[2 * MAXPATHLEN];
@@ -148,11 +153,19 @@ void *file_content_gc_thread(void *IndexArg)
   char cache_sub_dir[MAXPATHLEN];
   cache_content_status_t cache_content_status;
   FILE *command_stream = NULL;
+  u_int64_t dirty_at_start;
+  u_int64_t drained;
+  u_int64_t flushed;
+  off_t journal_offset;
+  struct pollfd pfd;
+  char discard[1024];
+  int done;
 
   char logfile_arg[MAXPATHLEN];
   char *loglevel_arg;
 
   SetNameFunction("file_content_gc_thread");
+  nfs_export_reader_register(&gc_export_reader);
 
   LogEvent(COMPONENT_MAIN,
            "NFS FILE CONTENT GARBAGE COLLECTION : Starting GC thread");
@@ -172,8 +185,11 @@ void *file_content_gc_thread(void *IndexArg)
 
   while(1)
     {
-      /* Sleep until some work is to be done */
-      sleep(nfs_param.cache_layers_param.dcgcpol.run_interval);
+      /* Sleep until some work is to be done, or until writers are throttled */
+      if(cache_content_flush_wait_request(nfs_param.cache_layers_param.dcgcpol.run_interval))
+        LogEvent(COMPONENT_MAIN,
+                 "NFS FILE CONTENT GARBAGE COLLECTION : %llu dirty bytes, flushing now",
+                 (unsigned long long)cache_content_dirty_bytes());
 
       if(gccb.tcb_state != STATE_AWAKE)
         {
@@ -204,6 +220,7 @@ void *file_content_gc_thread(void *IndexArg)
 
       LogEvent(COMPONENT_MAIN,
                "NFS FILE CONTENT GARBAGE COLLECTION : processing...");
+      nfs_export_read_begin(&gc_export_reader);
       for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
         {
           if(pexport->options & EXPORT_OPTION_USE_DATACACHE)
@@ -245,6 +262,7 @@ void *file_content_gc_thread(void *IndexArg)
                 }
             }
         }                       /* for */
+      nfs_export_read_end(&gc_export_reader);
 
       if (strncmp(fcc_log_path, "/dev/null", 9) == 0)
 	switch(LogComponents[COMPONENT_CACHE_INODE_GC].comp_log_type)
@@ -281,16 +299,62 @@ void *file_content_gc_thread(void *IndexArg)
       else
         strncat(command, " -S 3", 2 * MAXPATHLEN);      /* Sync Only */
 
+      /* What is dirty now will have been synced once the command is done */
+      dirty_at_start = cache_content_dirty_bytes();
+      drained = 0;
+      journal_offset = -1;
+      cache_content_journal_flushed_bytes(nfs_param.cache_layers_param.
+                                          cache_content_client_param.cache_dir,
+                                          &journal_offset);
+
       if((command_stream = popen(command, "r")) == NULL)
         LogCrit(COMPONENT_MAIN,
                 "NFS FILE CONTENT GARBAGE COLLECTION : /!\\ Cannot lauch command %s",
                 command);
       else
-        LogEvent(COMPONENT_MAIN,
-                 "NFS FILE CONTENT GARBAGE COLLECTION : I launched command %s",
-                 command);
+        {
+          LogEvent(COMPONENT_MAIN,
+                   "NFS FILE CONTENT GARBAGE COLLECTION : I launched command %s",
+                   command);
+
+          /* The throttled writers go on as the files get flushed, the command
+           * journals each of them. Its output is not used. */
+          pfd.fd = fileno(command_stream);
+          pfd.events = POLLIN;
+
+          for(done = FALSE; !done;)
+            {
+              if(poll(&pfd, 1, CACHE_CONTENT_FLUSH_PROGRESS_DELAY) > 0 &&
+                 read(pfd.fd, discard, sizeof(discard)) <= 0)
+                done = TRUE;
+
+              flushed = cache_content_journal_flushed_bytes(nfs_param.cache_layers_param.
+                                                            cache_content_client_param.
+                                                            cache_dir, &journal_offset);
 
-      pclose(command_stream);
+              if(flushed > dirty_at_start - drained)
+                flushed = dirty_at_start - drained;
+
+              if(flushed != 0)
+                {
+                  cache_content_dirty_drain(flushed);
+                  drained += flushed;
+                }
+            }
+
+          pclose(command_stream);
+        }
+
+      /* The pass is over, what was dirty at its start is synced */
+      cache_content_dirty_drain(dirty_at_start - drained);
+
+      /* No flush process appends to the journal until the next pass */
+      if(cache_content_journal_checkpoint_due(nfs_param.cache_layers_param.
+                                              cache_content_client_param.cache_dir) &&
+         cache_content_journal_checkpoint(nfs_param.cache_layers_param.
+                                          cache_content_client_param.cache_dir) != 0)
+        LogCrit(COMPONENT_MAIN,
+                "NFS FILE CONTENT GARBAGE COLLECTION : the data cache journal could not be checkpointed");
     }
   tcb_remove(&gccb);
 }                               /* file_content_gc_thread */
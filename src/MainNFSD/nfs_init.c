@@ -59,6 +59,8 @@
 #include "nfs_tools.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "timer_wheel.h"
+#include "nfs_qos.h"
 #include "config_parsing.h"
 #include "SemN.h"
 #include "external_tools.h"
@@ -98,7 +100,11 @@ pthread_t stat_thrid;
 pthread_t stat_exporter_thrid;
 pthread_t admin_thrid;
 pthread_t fcc_gc_thrid;
+pthread_t cache_inode_snapshot_thrid;
+static int cache_inode_snapshot_started = FALSE;
 pthread_t sigmgr_thrid;
+pthread_t timer_wheel_thrid;
+pthread_t worker_pool_thrid;
 nfs_tcb_t gccb;
 
 #ifdef _USE_9P
@@ -111,6 +117,31 @@ pthread_t upcall_simulator_thrid;
 
 char config_path[MAXPATHLEN];
 
+/* Startup timeline, one mark per init phase */
+#define NFS_INIT_TIMELINE_SIZE 64
+
+typedef struct nfs_init_timeline_mark__
+{
+  const char *phase;
+  unsigned long long usec;
+} nfs_init_timeline_mark_t;
+
+static nfs_init_timeline_mark_t nfs_init_timeline[NFS_INIT_TIMELINE_SIZE];
+static unsigned int nfs_init_timeline_count = 0;
+static struct timeval nfs_init_timeline_start;
+static struct timeval nfs_init_timeline_last;
+
+/* Workers slots are initialized by at most that many threads at startup */
+#define NFS_INIT_MAX_THREADS 8
+
+typedef struct nfs_init_slots__
+{
+  hash_table_t *ht;
+  unsigned int next;
+  unsigned int nb_slots;
+  int failed;
+} nfs_init_slots_t;
+
 /**
  *
  * This thread is in charge of signal management 
@@ -156,6 +187,13 @@ void *sigmgr_thread( void * arg )
     LogDebug(COMPONENT_THREAD,
              "Done waiting for worker threads to exit");
 
+  /* Last snapshot of the cache, before the FSAL goes away */
+  if(cache_inode_snapshot_started)
+    {
+      cache_inode_snapshot_stop();
+      pthread_join(cache_inode_snapshot_thrid, NULL);
+    }
+
   LogEvent(COMPONENT_MAIN, "NFS EXIT: synchonizing FSAL");
 
 #ifdef _USE_MFSL
@@ -231,6 +269,9 @@ void nfs_print_param_config()
   printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tNb_Worker = %u ; \n", nfs_param.core_param.nb_worker);
+  printf("\tNb_Max_Worker = %u ; \n", nfs_param.core_param.nb_max_worker);
+  printf("\tWorker_Spawn_Wait = %u ; \n", nfs_param.core_param.worker_spawn_wait);
+  printf("\tWorker_Idle_Timeout = %u ; \n", nfs_param.core_param.worker_idle_timeout);
   printf("\tb_Call_Before_Queue_Avg = %u ; \n", nfs_param.core_param.nb_call_before_queue_avg);
   printf("\tNb_MaxConcurrentGC = %u ; \n", nfs_param.core_param.nb_max_concurrent_gc);
   printf("\tDupReq_Expiration = %lu ; \n", nfs_param.core_param.expiration_dupreq);
@@ -283,6 +324,9 @@ void nfs_set_param_default()
 
   /* Core parameters */
   nfs_param.core_param.nb_worker = NB_WORKER_THREAD_DEFAULT;
+  nfs_param.core_param.nb_max_worker = 0;     /* same as nb_worker */
+  nfs_param.core_param.worker_spawn_wait = WORKER_SPAWN_WAIT_DEFAULT;
+  nfs_param.core_param.worker_idle_timeout = WORKER_IDLE_TIMEOUT_DEFAULT;
   nfs_param.core_param.nb_call_before_queue_avg = NB_REQUEST_BEFORE_QUEUE_AVG;
   nfs_param.core_param.nb_max_concurrent_gc = NB_MAX_CONCURRENT_GC;
   nfs_param.core_param.expiration_dupreq = DUPREQ_EXPIRATION;
@@ -326,9 +370,13 @@ void nfs_set_param_default()
 
   nfs_param.core_param.max_send_buffer_size = NFS_DEFAULT_SEND_BUFFER_SIZE;
   nfs_param.core_param.max_recv_buffer_size = NFS_DEFAULT_RECV_BUFFER_SIZE;
+  nfs_param.core_param.use_qos_scheduler = FALSE;
+  nfs_param.core_param.qos_queue_depth = QOS_QUEUE_DEPTH_DEFAULT;
 
 #ifdef _USE_NLM
   nfs_param.core_param.nsm_use_caller_name = FALSE;
+  nfs_param.core_param.nb_nlm_async_thread = NB_NLM_ASYNC_THREAD_DEFAULT;
+  nfs_param.core_param.nlm_grant_window = NLM_GRANT_WINDOW_DEFAULT;
 #endif
 
   /* Worker parameters : LRU */
@@ -412,9 +460,13 @@ void nfs_set_param_default()
   nfs_param.uidmap_cache_param.hash_param.hash_func_rbt = idmapper_rbt_hash_func;
   nfs_param.uidmap_cache_param.hash_param.compare_key = compare_idmapper;
   nfs_param.uidmap_cache_param.hash_param.key_to_str = display_idmapper_key;
-  nfs_param.uidmap_cache_param.hash_param.val_to_str = display_idmapper_val;
+  nfs_param.uidmap_cache_param.hash_param.val_to_str = display_idmapper_entry;
   nfs_param.uidmap_cache_param.hash_param.name = "UID Map Cache";
   strncpy(nfs_param.uidmap_cache_param.mapfile, "", MAXPATHLEN);
+  strncpy(nfs_param.uidmap_cache_param.preload, "", MAXPATHLEN);
+  nfs_param.uidmap_cache_param.expiration = IDMAP_EXPIRATION;
+  nfs_param.uidmap_cache_param.negative_expiration = IDMAP_NEGATIVE_EXPIRATION;
+  nfs_param.uidmap_cache_param.nb_resolvers = IDMAP_NB_RESOLVERS;
 
   /*  Worker parameters : UNAME_MAPPER hash table */
   nfs_param.unamemap_cache_param.hash_param.index_size = PRIME_ID_MAPPER;
@@ -424,9 +476,13 @@ void nfs_set_param_default()
   nfs_param.unamemap_cache_param.hash_param.hash_func_rbt = namemapper_rbt_hash_func;
   nfs_param.unamemap_cache_param.hash_param.compare_key = compare_namemapper;
   nfs_param.unamemap_cache_param.hash_param.key_to_str = display_idmapper_val;
-  nfs_param.unamemap_cache_param.hash_param.val_to_str = display_idmapper_key;
+  nfs_param.unamemap_cache_param.hash_param.val_to_str = display_idmapper_entry;
   nfs_param.unamemap_cache_param.hash_param.name = "UNAME Map Cache";
   strncpy(nfs_param.unamemap_cache_param.mapfile, "", MAXPATHLEN);
+  strncpy(nfs_param.unamemap_cache_param.preload, "", MAXPATHLEN);
+  nfs_param.unamemap_cache_param.expiration = IDMAP_EXPIRATION;
+  nfs_param.unamemap_cache_param.negative_expiration = IDMAP_NEGATIVE_EXPIRATION;
+  nfs_param.unamemap_cache_param.nb_resolvers = IDMAP_NB_RESOLVERS;
 
   /*  Worker parameters : GID_MAPPER hash table */
   nfs_param.gidmap_cache_param.hash_param.index_size = PRIME_ID_MAPPER;
@@ -436,9 +492,13 @@ void nfs_set_param_default()
   nfs_param.gidmap_cache_param.hash_param.hash_func_rbt = idmapper_rbt_hash_func;
   nfs_param.gidmap_cache_param.hash_param.compare_key = compare_idmapper;
   nfs_param.gidmap_cache_param.hash_param.key_to_str = display_idmapper_key;
-  nfs_param.gidmap_cache_param.hash_param.val_to_str = display_idmapper_val;
+  nfs_param.gidmap_cache_param.hash_param.val_to_str = display_idmapper_entry;
   nfs_param.gidmap_cache_param.hash_param.name = "GID Map Cache";
   strncpy(nfs_param.gidmap_cache_param.mapfile, "", MAXPATHLEN);
+  strncpy(nfs_param.gidmap_cache_param.preload, "", MAXPATHLEN);
+  nfs_param.gidmap_cache_param.expiration = IDMAP_EXPIRATION;
+  nfs_param.gidmap_cache_param.negative_expiration = IDMAP_NEGATIVE_EXPIRATION;
+  nfs_param.gidmap_cache_param.nb_resolvers = IDMAP_NB_RESOLVERS;
 
   /*  Worker parameters : UID->GID  hash table (for RPCSEC_GSS) */
   nfs_param.uidgidmap_cache_param.hash_param.index_size = PRIME_ID_MAPPER;
@@ -460,9 +520,13 @@ void nfs_set_param_default()
   nfs_param.gnamemap_cache_param.hash_param.hash_func_rbt = namemapper_rbt_hash_func;
   nfs_param.gnamemap_cache_param.hash_param.compare_key = compare_namemapper;
   nfs_param.gnamemap_cache_param.hash_param.key_to_str = display_idmapper_val;
-  nfs_param.gnamemap_cache_param.hash_param.val_to_str = display_idmapper_key;
+  nfs_param.gnamemap_cache_param.hash_param.val_to_str = display_idmapper_entry;
   nfs_param.gnamemap_cache_param.hash_param.name = "GNAME Map Cache";
   strncpy(nfs_param.gnamemap_cache_param.mapfile, "", MAXPATHLEN);
+  strncpy(nfs_param.gnamemap_cache_param.preload, "", MAXPATHLEN);
+  nfs_param.gnamemap_cache_param.expiration = IDMAP_EXPIRATION;
+  nfs_param.gnamemap_cache_param.negative_expiration = IDMAP_NEGATIVE_EXPIRATION;
+  nfs_param.gnamemap_cache_param.nb_resolvers = IDMAP_NB_RESOLVERS;
 
   /*  Worker parameters : IP/stats hash table */
   nfs_param.ip_stats_param.hash_param.index_size = PRIME_IP_STATS;
@@ -529,6 +593,12 @@ void nfs_set_param_default()
   /* pNFS parameters */
   nfs_param.pnfs_param.layoutfile.stripe_width = 1;
   nfs_param.pnfs_param.layoutfile.stripe_size = 8192;
+  nfs_param.pnfs_param.layoutfile.nb_ds = 1;
+
+  /* A single device, made of the default data server */
+  nfs_param.pnfs_param.layoutfile.nb_devices = 1;
+  nfs_param.pnfs_param.layoutfile.devices[0].stripe_width = 1;
+  nfs_param.pnfs_param.layoutfile.devices[0].ds_index[0] = 0;
 
   nfs_param.pnfs_param.layoutfile.ds_param[0].ipaddr = htonl(0x7F000001);
   strncpy(nfs_param.pnfs_param.layoutfile.ds_param[0].ipaddr_ascii, "127.0.0.1",
@@ -657,6 +727,10 @@ void nfs_set_param_default()
   nfs_param.cache_layers_param.cache_inode_client_param.use_fd_cache = 0;
   nfs_param.cache_layers_param.cache_inode_client_param.use_fsal_hash = 1;
   nfs_param.cache_layers_param.cache_inode_client_param.retention = 60;
+  nfs_param.cache_layers_param.cache_inode_client_param.max_open_files = 0;
+  nfs_param.cache_layers_param.cache_inode_client_param.snapshot_file[0] = '\0';
+  nfs_param.cache_layers_param.cache_inode_client_param.snapshot_max_entries = 16384;
+  nfs_param.cache_layers_param.cache_inode_client_param.snapshot_interval = 0;
 
   /* Data cache client parameters */
   nfs_param.cache_layers_param.cache_content_client_param.nb_prealloc_entry = 128;
@@ -675,6 +749,9 @@ void nfs_set_param_default()
   nfs_param.cache_layers_param.dcgcpol.run_interval = 3600;  /* 1h */
   nfs_param.cache_layers_param.dcgcpol.nb_call_before_gc = 1000;
   nfs_param.cache_layers_param.dcgcpol.emergency_grace_delay = 3600; /* 1h */
+  nfs_param.cache_layers_param.dcgcpol.flush_bandwidth = 0;          /* No limit */
+  nfs_param.cache_layers_param.dcgcpol.flush_outstanding = 4;
+  nfs_param.cache_layers_param.dcgcpol.dirty_threshold = 0;          /* No throttling */
 
 #ifdef _USE_SHARED_FSAL
   saved_fsalid = FSAL_GetId() ;
@@ -1342,6 +1419,8 @@ int nfs_set_param_from_conf(nfs_start_info_t * p_start_info)
 #endif
     }
 
+  nfs_Build_export_index(nfs_param.pexportlist);
+
   LogEvent(COMPONENT_INIT, "Configuration file successfully parsed");
 
   /* freeing syntax tree : */
@@ -1377,7 +1456,27 @@ int nfs_check_param_consistency()
       return 1;
     }
 
-  if( 2*nfs_param.core_param.nb_worker  >  nfs_param.cache_layers_param.cache_param.hparam.index_size )
+  /* No maximum means a fixed size worker pool */
+  if(nfs_param.core_param.nb_max_worker == 0)
+    nfs_param.core_param.nb_max_worker = nfs_param.core_param.nb_worker;
+
+  if(nfs_param.core_param.nb_max_worker < nfs_param.core_param.nb_worker ||
+     nfs_param.core_param.nb_max_worker > NB_MAX_WORKER_THREAD)
+    {
+      LogCrit(COMPONENT_INIT,
+              "BAD PARAMETER: Nb_Max_Worker must be between Nb_Worker (%d) and %d",
+              nfs_param.core_param.nb_worker, NB_MAX_WORKER_THREAD);
+      return 1;
+    }
+
+  if(nfs_param.core_param.worker_spawn_wait == 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "BAD PARAMETER: Worker_Spawn_Wait must be at least 1 msec");
+      return 1;
+    }
+
+  if( 2*nfs_param.core_param.nb_max_worker  >  nfs_param.cache_layers_param.cache_param.hparam.index_size )
     {
       LogCrit(COMPONENT_INIT,
               "BAD PARAMETER: number of workers is too large compared to Cache_Inode's index size, it should be smaller than half of it");
@@ -1571,9 +1670,20 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
   LogDebug(COMPONENT_THREAD,
            "sigmgr thread started");
 
+  /* Starting the timer wheel thread, before anything arms an entry */
+  if((rc =
+      pthread_create(&timer_wheel_thrid, &attr_thr, timer_wheel_thread, NULL)) != 0)
+    {
+      LogFatal(COMPONENT_THREAD,
+               "Could not create timer_wheel_thread, error = %d (%s)",
+               errno, strerror(errno));
+    }
+  LogEvent(COMPONENT_THREAD, "timer wheel thread was started successfully");
+
   /* Starting all of the worker thread */
   for(i = 0; i < nfs_param.core_param.nb_worker; i++)
     {
+      workers_data[i].running = TRUE;
       if((rc =
           pthread_create(&(worker_thrid[i]), &attr_thr, worker_thread, (void *)i)) != 0)
         {
@@ -1586,6 +1696,21 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
            "%d worker threads were started successfully",
 	   nfs_param.core_param.nb_worker);
 
+  /* Starting the worker pool manager, if the pool may grow */
+  if(nfs_param.core_param.nb_max_worker > nfs_param.core_param.nb_worker)
+    {
+      if((rc =
+          pthread_create(&worker_pool_thrid, &attr_thr, worker_pool_thread, NULL)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create worker_pool_thread, error = %d (%s)",
+                   errno, strerror(errno));
+        }
+      LogEvent(COMPONENT_THREAD,
+               "worker pool thread was started successfully, up to %u workers",
+               nfs_param.core_param.nb_max_worker);
+    }
+
 #ifdef _USE_NLM
   /* Start NLM threads */
   if(!flush_datacache_mode)
@@ -1675,6 +1800,23 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
                "file content gc thread was started successfully");
     }
 
+  /* Starting the cache inode snapshot thread, it reloads the cache in the background */
+  if(!flush_datacache_mode &&
+     nfs_param.cache_layers_param.cache_inode_client_param.snapshot_file[0] != '\0')
+    {
+      if((rc =
+          pthread_create(&cache_inode_snapshot_thrid, &attr_thr, cache_inode_snapshot_thread,
+                         (void *)workers_data[0].ht)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create cache_inode_snapshot_thread, error = %d (%s)",
+                   errno, strerror(errno));
+        }
+      cache_inode_snapshot_started = TRUE;
+      LogEvent(COMPONENT_THREAD,
+               "cache inode snapshot thread was started successfully");
+    }
+
 #ifdef _USE_UPCALL_SIMULATOR
   /* Starts the thread that mimics upcalls from the FSAL */
    /* Starting the stats thread */
@@ -1691,6 +1833,250 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
 
 }                               /* nfs_Start_threads */
 
+/**
+ * nfs_Init_timeline_mark: Records the time spent in a startup phase.
+ *
+ * The phase is accounted from the previous mark (or the beginning of the
+ * startup) to now.
+ *
+ * @param phase [IN] name of the phase that just ended.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void nfs_Init_timeline_mark(const char *phase)
+{
+  struct timeval now;
+  unsigned long long usec;
+
+  gettimeofday(&now, NULL);
+
+  if(nfs_init_timeline_start.tv_sec == 0)
+    {
+      /* First mark, it starts the timeline */
+      nfs_init_timeline_start = now;
+      nfs_init_timeline_last = now;
+      return;
+    }
+
+  usec = (now.tv_sec - nfs_init_timeline_last.tv_sec) * 1000000ULL
+      + now.tv_usec - nfs_init_timeline_last.tv_usec;
+  nfs_init_timeline_last = now;
+
+  LogDebug(COMPONENT_INIT, "Startup phase '%s' took %llu.%03llu ms",
+           phase, usec / 1000, usec % 1000);
+
+  if(nfs_init_timeline_count < NFS_INIT_TIMELINE_SIZE)
+    {
+      nfs_init_timeline[nfs_init_timeline_count].phase = phase;
+      nfs_init_timeline[nfs_init_timeline_count].usec = usec;
+      nfs_init_timeline_count += 1;
+    }
+}                               /* nfs_Init_timeline_mark */
+
+/**
+ * nfs_Init_timeline_report: Logs how long each startup phase took.
+ *
+ * @return nothing (void function).
+ *
+ */
+static void nfs_Init_timeline_report(void)
+{
+  unsigned long long total;
+  unsigned int i;
+
+  total = (nfs_init_timeline_last.tv_sec - nfs_init_timeline_start.tv_sec) * 1000000ULL
+      + nfs_init_timeline_last.tv_usec - nfs_init_timeline_start.tv_usec;
+
+  LogEvent(COMPONENT_INIT, "Startup timeline (%u phases, %llu.%03llu ms):",
+           nfs_init_timeline_count, total / 1000, total % 1000);
+
+  for(i = 0; i < nfs_init_timeline_count; i++)
+    LogEvent(COMPONENT_INIT, "    %-32s %8llu.%03llu ms",
+             nfs_init_timeline[i].phase,
+             nfs_init_timeline[i].usec / 1000,
+             nfs_init_timeline[i].usec % 1000);
+}                               /* nfs_Init_timeline_report */
+
+/**
+ * nfs_Init_worker_slot: Initializes the data of a worker slot.
+ *
+ * The first Nb_Worker slots are initialized at startup, the others only when
+ * the worker pool grows into them. The pools of a slot are kept when its
+ * thread retires, the next thread to serve the slot reuses them.
+ *
+ * @param index [IN] index of the slot in workers_data.
+ * @param ht    [IN] the cache inode hash table.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int nfs_Init_worker_slot(unsigned int index, hash_table_t * ht)
+{
+  char name[256];
+  nfs_ip_stats_parameter_t ip_stats_param = nfs_param.ip_stats_param;
+
+  /* Set the index (mostly used for debug purpose */
+  workers_data[index].worker_index = index;
+
+  /* Fill in workers fields (semaphores and other stangenesses */
+  if(nfs_Init_worker_data(&(workers_data[index])) != 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "Error while initializing worker data #%u", index);
+      return -1;
+    }
+
+  /* Set the pointer for the Cache inode hash table */
+  workers_data[index].ht = ht;
+
+  /* Slots may be initialized concurrently, use a private copy of the parameters */
+  sprintf(name, "IP Stats for worker %u", index);
+  ip_stats_param.hash_param.name = Str_Dup(name);
+  ht_ip_stats[index] = nfs_Init_ip_stats(ip_stats_param);
+
+  if(ht_ip_stats[index] == NULL)
+    {
+      LogCrit(COMPONENT_INIT,
+              "Error while initializing IP/stats cache #%u", index);
+      return -1;
+    }
+
+  workers_data[index].ht_ip_stats = ht_ip_stats[index];
+
+  /* The pools are not pre-allocated, each is filled on its first use */
+  InitPool(&workers_data[index].request_pool,
+           nfs_param.worker_param.nb_pending_prealloc,
+           request_data_t,
+           constructor_request_data_t, NULL);
+  NamePool(&workers_data[index].request_pool, "Request Data Pool %u", index);
+
+  InitPool(&workers_data[index].dupreq_pool,
+           nfs_param.worker_param.nb_dupreq_prealloc,
+           dupreq_entry_t, NULL, NULL);
+  NamePool(&workers_data[index].dupreq_pool, "Duplicate Request Pool %u", index);
+
+  InitPool(&workers_data[index].ip_stats_pool,
+           nfs_param.worker_param.nb_ip_stats_prealloc,
+           nfs_ip_stats_t, NULL, NULL);
+  NamePool(&workers_data[index].ip_stats_pool, "IP Stats Cache Pool %u", index);
+
+  InitPool(&workers_data[index].clientid_pool,
+           nfs_param.worker_param.nb_client_id_prealloc,
+           nfs_client_id_t, NULL, NULL);
+  NamePool(&workers_data[index].clientid_pool, "Client ID Pool %u", index);
+
+  LogDebug(COMPONENT_INIT, "worker data #%u successfully initialized", index);
+
+  return 0;
+}                               /* nfs_Init_worker_slot */
+
+/**
+ * nfs_Init_worker_slots_thread: Initializes worker slots until none is left.
+ *
+ * Several of these threads share the slots of the workers started at boot.
+ * The memory they allocate stays in use after they exit.
+ *
+ * @param arg [INOUT] the nfs_init_slots_t shared by the threads.
+ *
+ * @return NULL.
+ *
+ */
+static void *nfs_Init_worker_slots_thread(void *arg)
+{
+  nfs_init_slots_t *pslots = (nfs_init_slots_t *) arg;
+  unsigned int index;
+
+  SetNameFunction("init_slots");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      LogCrit(COMPONENT_INIT,
+              "Worker slots init thread: Memory manager could not be initialized");
+      pslots->failed = TRUE;
+      return NULL;
+    }
+#endif
+
+  while(!pslots->failed &&
+        (index = __sync_fetch_and_add(&pslots->next, 1)) < pslots->nb_slots)
+    {
+      if(nfs_Init_worker_slot(index, pslots->ht) != 0)
+        pslots->failed = TRUE;
+    }
+
+  return NULL;
+}                               /* nfs_Init_worker_slots_thread */
+
+/**
+ * nfs_Init_worker_slots: Initializes the slots of the workers started at boot.
+ *
+ * The slots are spread among a few threads, at most one per processor.
+ *
+ * @param nb_slots [IN] number of slots to initialize.
+ * @param ht       [IN] the cache inode hash table.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+static int nfs_Init_worker_slots(unsigned int nb_slots, hash_table_t * ht)
+{
+  pthread_t thrid[NFS_INIT_MAX_THREADS];
+  pthread_attr_t attr_thr;
+  nfs_init_slots_t slots;
+  unsigned int nb_threads = NFS_INIT_MAX_THREADS;
+  unsigned int started = 0;
+  unsigned int i;
+  long nb_cpu;
+  int rc;
+
+  nb_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if(nb_cpu > 0 && nb_cpu < nb_threads)
+    nb_threads = nb_cpu;
+  if(nb_slots < nb_threads)
+    nb_threads = nb_slots;
+
+  slots.ht = ht;
+  slots.next = 0;
+  slots.nb_slots = nb_slots;
+  slots.failed = FALSE;
+
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_JOINABLE);
+  pthread_attr_setstacksize(&attr_thr, THREAD_STACK_SIZE);
+
+  /* With a single thread, not worth spawning it */
+  for(i = 0; nb_threads > 1 && i < nb_threads; i++)
+    {
+      if((rc = pthread_create(&thrid[started], &attr_thr,
+                              nfs_Init_worker_slots_thread, &slots)) != 0)
+        {
+          /* The threads already started do the job */
+          LogError(COMPONENT_THREAD, ERR_SYS, ERR_PTHREAD_CREATE, rc);
+          break;
+        }
+      started += 1;
+    }
+
+  /* None was started, do it here */
+  if(started == 0)
+    for(i = 0; i < nb_slots && !slots.failed; i++)
+      if(nfs_Init_worker_slot(i, ht) != 0)
+        slots.failed = TRUE;
+
+  for(i = 0; i < started; i++)
+    pthread_join(thrid[i], NULL);
+
+  pthread_attr_destroy(&attr_thr);
+
+  LogDebug(COMPONENT_INIT, "%u worker slots initialized by %u threads",
+           nb_slots, started);
+
+  return slots.failed ? -1 : 0;
+}                               /* nfs_Init_worker_slots */
+
 /**
  * nfs_Init: Init the nfs daemon 
  *
@@ -1709,7 +2095,6 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   cache_inode_status_t cache_status;
   state_status_t state_status;
   fsal_status_t fsal_status;
-  unsigned int i = 0;
   int rc = 0;
 #ifdef _HAVE_GSSAPI
   gss_name_t gss_service_name;
@@ -1718,6 +2103,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   char GssError[MAXNAMLEN];
 #endif
 #ifdef _USE_SHARED_FSAL
+  unsigned int i = 0;
   unsigned int saved_fsalid = 0 ;
   unsigned int fsalid = 0 ;
 #endif
@@ -1741,7 +2127,14 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
    }
   FSAL_SetId( fsalid ) ;
   LogInfo(COMPONENT_INIT, "All FSAL libraries successfully initialized");
+  nfs_Init_timeline_mark("FSAL");
 #else
+#ifdef _USE_PROXY
+  /* With FSAL_test_access, access is checked from the attributes, an ACCESS
+   * asked along with each lookup would never be used */
+  ((proxyfs_specific_initinfo_t *) &nfs_param.fsal_param.fs_specific_info)->lookup_access =
+      (nfs_param.cache_layers_param.cache_inode_client_param.use_test_access != 1);
+#endif
   fsal_status = FSAL_Init(&nfs_param.fsal_param);
   if(FSAL_IS_ERROR(fsal_status))
     {
@@ -1749,6 +2142,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
       LogFatal(COMPONENT_INIT, "FSAL library could not be initialized");
     }
   LogInfo(COMPONENT_INIT, "FSAL library successfully initialized");
+  nfs_Init_timeline_mark("FSAL");
 #endif
 
 #ifdef _USE_MFSL
@@ -1760,6 +2154,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
       LogFatal(COMPONENT_INIT, "MFSL library could not be initialized");
     }
   LogInfo(COMPONENT_INIT, "MFSL library  successfully initialized");
+  nfs_Init_timeline_mark("MFSL");
 #endif
 
   /* Cache Inode Initialisation */
@@ -1771,6 +2166,12 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
                cache_inode_err_str(cache_status));
     }
 
+  /* Descriptors kept open by all the workers, half of the process' limit by default */
+  if(nfs_param.cache_layers_param.cache_inode_client_param.max_open_files != 0)
+    cache_inode_fd_cache_init(nfs_param.cache_layers_param.cache_inode_client_param.max_open_files);
+  else
+    cache_inode_fd_cache_init(nfs_param.core_param.nb_max_fd / 2);
+
 #ifdef _USE_BLOCKING_LOCKS
   if(state_lock_init(&state_status,
                      nfs_param.cache_layers_param.cache_param.cookie_param)
@@ -1784,6 +2185,8 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
                state_err_str(state_status));
     }
   LogInfo(COMPONENT_INIT, "Cache Inode library successfully initialized");
+  nfs_Init_timeline_mark("cache inode");
+
   /* Initialize thread control block */
   tcb_head_init();
 
@@ -1861,21 +2264,26 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
 #endif /* HAVE_KRB5 */
 #endif /* _HAVE_GSSAPI */
 
+#ifdef _HAVE_GSSAPI
+  nfs_Init_timeline_mark("RPCSEC_GSS");
+#endif
+
   /* RPC Initialisation - exits on failure*/
   nfs_Init_svc();
   LogInfo(COMPONENT_INIT,  "RPC ressources successfully initialized");
+  nfs_Init_timeline_mark("RPC");
 
   /* Worker initialisation */
   if((workers_data =
       (nfs_worker_data_t *) Mem_Alloc_Label(sizeof(nfs_worker_data_t) *
-                                            nfs_param.core_param.nb_worker,
+                                            nfs_param.core_param.nb_max_worker,
                                             "nfs_worker_data_t")) == NULL)
     {
       LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
       Fatal();
     }
   memset((char *)workers_data, 0,
-         sizeof(nfs_worker_data_t) * nfs_param.core_param.nb_worker);
+         sizeof(nfs_worker_data_t) * nfs_param.core_param.nb_max_worker);
 
   if(nfs_Init_gc_counter() != 0)
     {
@@ -1885,82 +2293,11 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
 
   LogDebug(COMPONENT_INIT, "Initializing workers data structure");
 
-  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
-    {
-      char name[256];
-
-      /* Set the index (mostly used for debug purpose */
-      workers_data[i].worker_index = i;
-
-      /* Fill in workers fields (semaphores and other stangenesses */
-      if(nfs_Init_worker_data(&(workers_data[i])) != 0)
-        LogFatal(COMPONENT_INIT,
-                 "Error while initializing worker data #%d", i);
-
-      /* Set the pointer for the Cache inode hash table */
-      workers_data[i].ht = ht;
-
-      sprintf(name, "IP Stats for worker %d", i);
-      nfs_param.ip_stats_param.hash_param.name = Str_Dup(name);
-      ht_ip_stats[i] = nfs_Init_ip_stats(nfs_param.ip_stats_param);
-
-      if(ht_ip_stats[i] == NULL)
-        LogFatal(COMPONENT_INIT,
-                 "Error while initializing IP/stats cache #%d", i);
-
-      workers_data[i].ht_ip_stats = ht_ip_stats[i];
-
-      /* Allocation of the nfs request pool */
-      MakePool(&workers_data[i].request_pool,
-               nfs_param.worker_param.nb_pending_prealloc,
-               request_data_t,
-               constructor_request_data_t, NULL);
-      NamePool(&workers_data[i].request_pool, "Request Data Pool %d", i);
-               
-      if(!IsPoolPreallocated(&workers_data[i].request_pool))
-        {
-          LogCrit(COMPONENT_INIT,
-                  "Error while allocating request data pool #%d", i);
-          LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
-          Fatal();
-        }
-
-      /* Allocation of the nfs dupreq pool */
-      MakePool(&workers_data[i].dupreq_pool,
-               nfs_param.worker_param.nb_dupreq_prealloc,
-               dupreq_entry_t, NULL, NULL);
-      NamePool(&workers_data[i].dupreq_pool, "Duplicate Request Pool %d", i);
-
-      if(!IsPoolPreallocated(&workers_data[i].dupreq_pool))
-        {
-          LogCrit(COMPONENT_INIT,
-                  "Error while allocating duplicate request pool #%d", i);
-          LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
-          Fatal();
-        }
-
-      /* Allocation of the IP/name pool */
-      MakePool(&workers_data[i].ip_stats_pool,
-               nfs_param.worker_param.nb_ip_stats_prealloc,
-               nfs_ip_stats_t, NULL, NULL);
-      NamePool(&workers_data[i].ip_stats_pool, "IP Stats Cache Pool %d", i);
-
-      if(!IsPoolPreallocated(&workers_data[i].ip_stats_pool))
-        {
-          LogCrit(COMPONENT_INIT,
-                  "Error while allocating IP stats cache pool #%d", i);
-          LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
-          Fatal();
-        }
-
-      /* Initialize, but do not pre-alloc client-id pool */
-      InitPool(&workers_data[i].clientid_pool,
-               nfs_param.worker_param.nb_client_id_prealloc,
-               nfs_client_id_t, NULL, NULL);
-      NamePool(&workers_data[i].clientid_pool, "Client ID Pool %d", i);
+  if(nfs_Init_worker_slots(nfs_param.core_param.nb_worker, ht) != 0)
+    Fatal();
 
-      LogDebug(COMPONENT_INIT, "worker data #%d successfully initialized", i);
-    }                           /* for i */
+  nfs_worker_pool_init();
+  nfs_Init_timeline_mark("workers data");
 
   /* Admin initialisation */
   nfs_Init_admin_data(ht);
@@ -1976,6 +2313,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
 
   LogInfo(COMPONENT_INIT,
           "NFSv4 pseudo file system successfully initialized");
+  nfs_Init_timeline_mark("admin and pseudo fs");
 
   /* Init duplicate request cache */
   LogDebug(COMPONENT_INIT, "Now building duplicate request hash table cache");
@@ -1988,6 +2326,21 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   LogInfo(COMPONENT_INIT,
           "duplicate request hash table cache successfully initialized");
 
+  /* Init the fair share scheduler, classes come with the exports */
+  if(nfs_qos_init(nfs_param.pexportlist) != 0)
+    {
+      LogFatal(COMPONENT_INIT, "Error while initializing the fair share scheduler");
+    }
+  LogInfo(COMPONENT_INIT, "fair share scheduler successfully initialized");
+
+  /* Init the timer wheel used for expiring entries */
+  if(timer_wheel_init() != 0)
+    {
+      LogFatal(COMPONENT_INIT, "Error while initializing the timer wheel");
+    }
+  LogInfo(COMPONENT_INIT, "timer wheel successfully initialized");
+  nfs_Init_timeline_mark("dupreq, qos and timer wheel");
+
   /* Init the IP/name cache */
   LogDebug(COMPONENT_INIT, "Now building IP/name cache");
   if(nfs_Init_ip_name(nfs_param.ip_name_param) != IP_NAME_SUCCESS)
@@ -2020,6 +2373,16 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   LogInfo(COMPONENT_INIT,
           "UIDGID_MAPPER cache successfully initialized");
 
+  /* Init the cache of the group lists of the users (for Manage_Gids) */
+  LogDebug(COMPONENT_INIT, "Now building UID->Groups cache");
+  if(uid2grp_init(nfs_param.uidgidmap_cache_param) != ID_MAPPER_SUCCESS)
+    {
+      LogFatal(COMPONENT_INIT,
+              "Error while initializing UID->Groups cache");
+    }
+  LogInfo(COMPONENT_INIT,
+          "UID->Groups cache successfully initialized");
+
   /* Init the GID_MAPPER cache */
   LogDebug(COMPONENT_INIT, "Now building GID_MAPPER cache");
   if((idmap_gid_init(nfs_param.gidmap_cache_param) != ID_MAPPER_SUCCESS) ||
@@ -2030,6 +2393,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
     }
   LogInfo(COMPONENT_INIT,
           "GID_MAPPER cache successfully initialized");
+  nfs_Init_timeline_mark("ip/name and id mappers");
 
   /* Init the NFSv4 Clientid cache */
   LogDebug(COMPONENT_INIT, "Now building NFSv4 clientid cache");
@@ -2107,6 +2471,8 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
           "NFSv4 ACL cache successfully initialized");
 #endif                          /* _USE_NFS4_ACL */
 
+  nfs_Init_timeline_mark("NFSv4 state");
+
 #ifdef _USE_9P
   LogDebug(COMPONENT_INIT, "Now building 9P resources");
   if( _9p_init( &nfs_param._9p_param ) )
@@ -2117,6 +2483,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
     }
   LogInfo(COMPONENT_INIT,
           "9P resources successfully initialized");
+  nfs_Init_timeline_mark("9P");
 #endif /* _USE_9P */
 
   /* Create the root entries for each exported FS */
@@ -2125,6 +2492,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
       LogFatal(COMPONENT_INIT,
                "Error initializing Cache Inode root entries");
     }
+  nfs_Init_timeline_mark("export root entries");
 
   /* Creation of FSAL_UP threads */
   /* This thread depends on ALL parts of Ganesha being initialized. 
@@ -2133,6 +2501,7 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   nfs_param.fsal_up_param.ht = ht;
   nfs_Init_FSAL_UP(); /* initalizes an event pool */
   create_fsal_up_threads();
+  nfs_Init_timeline_mark("FSAL_UP");
 #endif /* _USE_FSAL_UP */
 
   LogInfo(COMPONENT_INIT,
@@ -2290,6 +2659,9 @@ void nfs_start(nfs_start_info_t * p_start_info)
   /* store the start info so it is available for all layers */
   nfs_start_info = *p_start_info;
 
+  /* Starts the startup timeline */
+  nfs_Init_timeline_mark("start");
+
   if(p_start_info->dump_default_config == TRUE)
     {
       nfs_print_param_config();
@@ -2354,6 +2726,7 @@ void nfs_start(nfs_start_info_t * p_start_info)
     }
   else
     LogInfo(COMPONENT_INIT, "File Content Cache directory initialized");
+  nfs_Init_timeline_mark("limits and datacache directories");
 
   /* Print the worker parameters in log */
   Print_param_worker_in_log(&(nfs_param.worker_param));
@@ -2373,6 +2746,8 @@ void nfs_start(nfs_start_info_t * p_start_info)
 
   /* Spawns service threads */
   nfs_Start_threads(p_start_info->flush_datacache_mode);
+  nfs_Init_timeline_mark("service threads");
+  nfs_Init_timeline_report();
 
   if(p_start_info->flush_datacache_mode)
     {
@@ -2479,6 +2854,28 @@ void nfs_start(nfs_start_info_t * p_start_info)
             LogDebug(COMPONENT_INIT, "GID_MAPPER was NOT populated");
         }
 
+      /* Load the users and groups of the directory ahead of their first use */
+      if(nfs_param.uidmap_cache_param.preload[0] != '\0')
+        {
+          LogDebug(COMPONENT_INIT, "Preloading UID_MAPPER with file %s",
+                   nfs_param.uidmap_cache_param.preload);
+          if(idmap_preload(nfs_param.uidmap_cache_param.preload, UIDMAP_TYPE) !=
+             ID_MAPPER_SUCCESS)
+            LogDebug(COMPONENT_INIT, "UID_MAPPER was NOT preloaded");
+        }
+
+      if(nfs_param.gidmap_cache_param.preload[0] != '\0')
+        {
+          LogDebug(COMPONENT_INIT, "Preloading GID_MAPPER with file %s",
+                   nfs_param.gidmap_cache_param.preload);
+          if(idmap_preload(nfs_param.gidmap_cache_param.preload, GIDMAP_TYPE) !=
+             ID_MAPPER_SUCCESS)
+            LogDebug(COMPONENT_INIT, "GID_MAPPER was NOT preloaded");
+        }
+
+      if(idmap_resolver_init() != ID_MAPPER_SUCCESS)
+        LogCrit(COMPONENT_INIT, "Not all the id mapper resolver threads could be started");
+
       if(nfs_param.ip_name_param.mapfile[0] == '\0')
         {
           LogDebug(COMPONENT_INIT, "No Hosts Map file is used");
@@ -0,0 +1,699 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_qos.c
+ * \brief   Fair share scheduler between the dispatcher and the workers.
+ *
+ * nfs_qos.c : Fair share scheduler between the dispatcher and the workers.
+ *
+ * When Use_QoS_Scheduler is set, the dispatcher no longer pushes every
+ * request to a worker as soon as it is decoded. Requests wait in flows, and at most QoS_Queue_Depth requests
+ * per worker are handed to the workers at a time. When room is made, the
+ * flows are served in deficit round robin order: each flow gets a credit
+ * proportional to the weight of its class at each round, and a request
+ * costs NFS_QOS_BASE_COST plus its READ/WRITE payload.
+ *
+ * NFSv2/v3 requests on an export with a QoS_Class go to the flow of that
+ * class, which may also limit its concurrency and bandwidth. All the other
+ * requests are hashed by client address on the flows of the default class,
+ * so one busy client cannot fill all the workers.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "nfs_file_handle.h"
+#include "nfs_proto_functions.h"
+#include "nfs_qos.h"
+
+extern nfs_parameter_t nfs_param;
+
+static pthread_mutex_t qos_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static nfs_qos_class_t qos_classes[NFS_QOS_MAX_CLASSES];
+static unsigned int qos_nb_classes = 0;
+
+static nfs_qos_flow_t qos_client_flows[NFS_QOS_CLIENT_FLOWS];
+
+/* Class of each export, indexed by export id, NULL for the default class.
+ * Requests find their class here instead of in the export list. */
+static nfs_qos_class_t **qos_export_classes = NULL;
+static unsigned int qos_nb_export_classes = 0;
+
+static struct glist_head qos_active;           /* flows with waiting requests */
+static unsigned int qos_nb_active = 0;
+static unsigned int qos_inflight = 0;
+
+static void nfs_qos_schedule(void);
+
+static void nfs_qos_flow_init(nfs_qos_flow_t * pflow, nfs_qos_class_t * pclass)
+{
+  init_glist(&pflow->active_list);
+  init_glist(&pflow->queue);
+  pflow->deficit = 0;
+  pflow->has_turn = FALSE;
+  pflow->pclass = pclass;
+}
+
+static void nfs_qos_release_class_locked(nfs_qos_class_t * pclass);
+
+static void nfs_qos_refill_timer(timer_wheel_entry_t * pentry, void *arg)
+{
+  nfs_qos_class_t *pclass = (nfs_qos_class_t *) arg;
+
+  P(qos_mutex);
+  pclass->refill_armed = FALSE;
+  nfs_qos_release_class_locked(pclass);
+  V(qos_mutex);
+
+  /* Tokens are back, let the throttled class go */
+  nfs_qos_schedule();
+}
+
+/* Fill a new class in a free slot, qos_mutex held */
+static nfs_qos_class_t *nfs_qos_new_class_locked(char *name,
+                                                 unsigned int weight,
+                                                 unsigned int max_inflight,
+                                                 unsigned long long max_bandwidth)
+{
+  nfs_qos_class_t *pclass;
+  unsigned int i;
+
+  for(i = 0; i < qos_nb_classes; i++)
+    if(!qos_classes[i].in_use)
+      break;
+
+  if(i == NFS_QOS_MAX_CLASSES)
+    return NULL;
+
+  if(i == qos_nb_classes)
+    qos_nb_classes++;
+
+  pclass = &qos_classes[i];
+
+  memset(pclass, 0, sizeof(nfs_qos_class_t));
+  strncpy(pclass->name, name, MAXNAMLEN - 1);
+  pclass->weight = (weight == 0) ? 1 : weight;
+  pclass->max_inflight = max_inflight;
+  pclass->max_bandwidth = max_bandwidth;
+  pclass->tokens = (long long)max_bandwidth;
+  gettimeofday(&pclass->last_refill, NULL);
+  timer_wheel_entry_init(&pclass->refill_timer, nfs_qos_refill_timer, pclass, NULL);
+  nfs_qos_flow_init(&pclass->flow, pclass);
+  pclass->in_use = TRUE;
+
+  LogEvent(COMPONENT_DISPATCH,
+           "QoS class %s: weight=%u max_inflight=%u max_bandwidth=%llu bytes/s",
+           pclass->name, pclass->weight, pclass->max_inflight,
+           pclass->max_bandwidth);
+
+  return pclass;
+}
+
+/* Give the limits of a new configuration to a class, qos_mutex held */
+static void nfs_qos_set_limits_locked(nfs_qos_class_t * pclass,
+                                      unsigned int weight,
+                                      unsigned int max_inflight,
+                                      unsigned long long max_bandwidth)
+{
+  if(weight == 0)
+    weight = 1;
+
+  if(pclass->weight == weight && pclass->max_inflight == max_inflight &&
+     pclass->max_bandwidth == max_bandwidth)
+    return;
+
+  /* Tokens saved under the old limit must not exceed the new one */
+  if(pclass->max_bandwidth == 0 || pclass->tokens > (long long)max_bandwidth)
+    {
+      pclass->tokens = (long long)max_bandwidth;
+      gettimeofday(&pclass->last_refill, NULL);
+    }
+
+  pclass->weight = weight;
+  pclass->max_inflight = max_inflight;
+  pclass->max_bandwidth = max_bandwidth;
+
+  LogEvent(COMPONENT_DISPATCH,
+           "QoS class %s updated: weight=%u max_inflight=%u max_bandwidth=%llu bytes/s",
+           pclass->name, pclass->weight, pclass->max_inflight,
+           pclass->max_bandwidth);
+}
+
+/* Free the slot of a class no export uses, once no request and no timer
+ * refer to it any more, qos_mutex held */
+static void nfs_qos_release_class_locked(nfs_qos_class_t * pclass)
+{
+  if(!pclass->retired || pclass->stats.queue_depth != 0 ||
+     pclass->stats.inflight != 0 || pclass->refill_armed)
+    return;
+
+  LogEvent(COMPONENT_DISPATCH, "QoS class %s is no longer used", pclass->name);
+
+  pclass->in_use = FALSE;
+  pclass->retired = FALSE;
+}
+
+/* Get the class named by an export, qos_mutex held. The first export that
+ * names a class in a list gives it its limits. */
+static nfs_qos_class_t *nfs_qos_export_class_locked(exportlist_t * pexport,
+                                                   char *configured)
+{
+  nfs_qos_class_t *pclass;
+  unsigned int i;
+
+  if(pexport == NULL || pexport->qos_class_name[0] == '\0')
+    return &qos_classes[0];
+
+  for(i = 1; i < qos_nb_classes; i++)
+    if(qos_classes[i].in_use &&
+       !strncmp(qos_classes[i].name, pexport->qos_class_name, MAXNAMLEN))
+      break;
+
+  if(i < qos_nb_classes)
+    {
+      pclass = &qos_classes[i];
+
+      if(!configured[i])
+        nfs_qos_set_limits_locked(pclass, pexport->qos_weight,
+                                  pexport->qos_max_inflight,
+                                  pexport->qos_max_bandwidth);
+      else if(pexport->qos_weight != 0 && pexport->qos_weight != pclass->weight)
+        LogWarn(COMPONENT_DISPATCH,
+                "Export %u: QoS class %s already has weight %u, ignoring %u",
+                pexport->id, pclass->name, pclass->weight, pexport->qos_weight);
+    }
+  else
+    {
+      pclass = nfs_qos_new_class_locked(pexport->qos_class_name,
+                                        pexport->qos_weight,
+                                        pexport->qos_max_inflight,
+                                        pexport->qos_max_bandwidth);
+      if(pclass == NULL)
+        {
+          LogCrit(COMPONENT_DISPATCH,
+                  "Export %u: too many QoS classes, %s is merged with the default class",
+                  pexport->id, pexport->qos_class_name);
+          return &qos_classes[0];
+        }
+    }
+
+  configured[pclass - qos_classes] = TRUE;
+  pclass->retired = FALSE;
+
+  return pclass;
+}
+
+/* Find the export id of a NFSv2/v3 request, from the file handle in its
+ * arguments, or -1 if it has none */
+static short nfs_qos_get_exportid(nfs_request_data_t * preqnfs)
+{
+  if(preqnfs->req.rq_prog != nfs_param.core_param.program[P_NFS])
+    return -1;
+
+  /* NFSv4 crosses exports inside of a COMPOUND, it stays per client */
+  switch (preqnfs->req.rq_vers)
+    {
+    case NFS_V2:
+      /* The arguments of the others start with a file handle */
+      if(preqnfs->req.rq_proc == NFSPROC_NULL ||
+         preqnfs->req.rq_proc == NFSPROC_ROOT ||
+         preqnfs->req.rq_proc == NFSPROC_WRITECACHE ||
+         preqnfs->req.rq_proc > NFSPROC_STATFS)
+        return -1;
+      return nfs2_FhandleToExportId((fhandle2 *) & preqnfs->arg_nfs);
+
+    case NFS_V3:
+      if(preqnfs->req.rq_proc == NFSPROC3_NULL ||
+         preqnfs->req.rq_proc > NFSPROC3_COMMIT)
+        return -1;
+      return nfs3_FhandleToExportId((nfs_fh3 *) & preqnfs->arg_nfs);
+    }
+
+  return -1;
+}
+
+static unsigned int nfs_qos_payload(nfs_request_data_t * preqnfs)
+{
+  if(preqnfs->req.rq_prog != nfs_param.core_param.program[P_NFS])
+    return 0;
+
+  switch (preqnfs->req.rq_vers)
+    {
+    case NFS_V2:
+      if(preqnfs->req.rq_proc == NFSPROC_READ)
+        return preqnfs->arg_nfs.arg_read2.count;
+      if(preqnfs->req.rq_proc == NFSPROC_WRITE)
+        return preqnfs->arg_nfs.arg_write2.data.nfsdata2_len;
+      break;
+
+    case NFS_V3:
+      if(preqnfs->req.rq_proc == NFSPROC3_READ)
+        return preqnfs->arg_nfs.arg_read3.count;
+      if(preqnfs->req.rq_proc == NFSPROC3_WRITE)
+        return preqnfs->arg_nfs.arg_write3.count;
+      break;
+    }
+
+  return 0;
+}
+
+/* Tells if the class may have one more request in the workers, qos_mutex held */
+static int nfs_qos_can_run_locked(nfs_qos_class_t * pclass, struct timeval *pnow)
+{
+  long long elapsed;
+  unsigned int delay;
+
+  if(pclass->max_inflight != 0 && pclass->stats.inflight >= pclass->max_inflight)
+    return FALSE;
+
+  if(pclass->max_bandwidth == 0)
+    return TRUE;
+
+  elapsed = (long long)(pnow->tv_sec - pclass->last_refill.tv_sec) * 1000000 +
+      (pnow->tv_usec - pclass->last_refill.tv_usec);
+
+  if(elapsed > 0)
+    {
+      /* At most one second worth of burst */
+      if(elapsed > 1000000)
+        elapsed = 1000000;
+
+      pclass->tokens += (long long)pclass->max_bandwidth * elapsed / 1000000;
+      if(pclass->tokens > (long long)pclass->max_bandwidth)
+        pclass->tokens = (long long)pclass->max_bandwidth;
+      pclass->last_refill = *pnow;
+    }
+
+  if(pclass->tokens > 0)
+    return TRUE;
+
+  pclass->stats.nb_throttled++;
+
+  /* Nothing else may wake the scheduler up if the class is alone */
+  if(!pclass->refill_armed)
+    {
+      delay = (unsigned int)((1 - pclass->tokens) * 1000 / pclass->max_bandwidth) + 1;
+      pclass->refill_armed = TRUE;
+      timer_wheel_add(&pclass->refill_timer, delay);
+    }
+
+  return FALSE;
+}
+
+/**
+ *
+ * nfs_qos_init: initializes the fair share scheduler.
+ *
+ * @param pexportlist [IN] the export list, to report the configured classes.
+ *
+ * @return 0 if successful.
+ *
+ */
+int nfs_qos_init(exportlist_t * pexportlist)
+{
+  unsigned int i;
+
+  init_glist(&qos_active);
+
+  P(qos_mutex);
+
+  if(nfs_qos_new_class_locked(NFS_QOS_DEFAULT_CLASS, 1, 0, 0) == NULL)
+    {
+      V(qos_mutex);
+      return -1;
+    }
+
+  for(i = 0; i < NFS_QOS_CLIENT_FLOWS; i++)
+    nfs_qos_flow_init(&qos_client_flows[i], &qos_classes[0]);
+
+  V(qos_mutex);
+
+  return nfs_qos_update_exports(pexportlist);
+}                               /* nfs_qos_init */
+
+/**
+ *
+ * nfs_qos_update_exports: maps the exports of a new list to their class.
+ *
+ * Called at startup and after a reload, by the thread that owns the list.
+ * The classes kept get the limits of the new list, those no export names
+ * any more are freed once their last request is done.
+ *
+ * @param pexportlist [IN] the export list.
+ *
+ * @return 0 if successful.
+ *
+ */
+int nfs_qos_update_exports(exportlist_t * pexportlist)
+{
+  exportlist_t *pexport;
+  nfs_qos_class_t **pclasses = NULL;
+  nfs_qos_class_t *pclass;
+  char configured[NFS_QOS_MAX_CLASSES];
+  unsigned int size = 0;
+  unsigned int i;
+
+  for(pexport = pexportlist; pexport != NULL; pexport = pexport->next)
+    if(pexport->id >= size)
+      size = pexport->id + 1;
+
+  if(size > 0)
+    {
+      pclasses = (nfs_qos_class_t **) Mem_Alloc(size * sizeof(nfs_qos_class_t *));
+      if(pclasses == NULL)
+        {
+          LogCrit(COMPONENT_DISPATCH,
+                  "nfs_qos_update_exports: could not allocate the export classes");
+          return -1;
+        }
+      memset(pclasses, 0, size * sizeof(nfs_qos_class_t *));
+    }
+
+  memset(configured, FALSE, sizeof(configured));
+
+  P(qos_mutex);
+
+  /* The first entry wins, as in the list */
+  for(pexport = pexportlist; pexport != NULL; pexport = pexport->next)
+    if(pclasses[pexport->id] == NULL)
+      {
+        pclass = nfs_qos_export_class_locked(pexport, configured);
+        pclasses[pexport->id] = (pclass == &qos_classes[0]) ? NULL : pclass;
+      }
+
+  for(i = 1; i < qos_nb_classes; i++)
+    if(qos_classes[i].in_use && !configured[i])
+      {
+        qos_classes[i].retired = TRUE;
+        nfs_qos_release_class_locked(&qos_classes[i]);
+      }
+
+  /* The table is only used under qos_mutex */
+  if(qos_export_classes != NULL)
+    Mem_Free(qos_export_classes);
+  qos_export_classes = pclasses;
+  qos_nb_export_classes = size;
+
+  V(qos_mutex);
+
+  return 0;
+}                               /* nfs_qos_update_exports */
+
+/**
+ *
+ * nfs_qos_enqueue: queues a decoded request for the workers.
+ *
+ * @param preq         [IN] the request.
+ * @param worker_index [IN] the worker whose pool the request comes from, it will process it.
+ *
+ */
+void nfs_qos_enqueue(request_data_t * preq, unsigned int worker_index)
+{
+  nfs_request_data_t *preqnfs = &preq->rcontent.nfs;
+  short exportid;
+  nfs_qos_class_t *pclass;
+  nfs_qos_flow_t *pflow;
+  sockaddr_t addr;
+  unsigned long hash = 0;
+
+  /* Also used by the worker pool to measure the queue wait */
+  gettimeofday(&preqnfs->qos_time, NULL);
+
+  if(!nfs_param.core_param.use_qos_scheduler)
+    {
+      preqnfs->qos_class = NULL;
+      DispatchWorkNFS(preq, worker_index);
+      return;
+    }
+
+  exportid = nfs_qos_get_exportid(preqnfs);
+
+  preqnfs->qos_payload = nfs_qos_payload(preqnfs);
+  preqnfs->qos_cost = NFS_QOS_BASE_COST + preqnfs->qos_payload;
+  preqnfs->qos_worker = worker_index;
+
+  if(copy_xprt_addr(&addr, preqnfs->xprt) == 1)
+    {
+      /* Fold the whole address, IPv4 ones differ in their last bytes */
+      hash = hash_sockaddr(&addr, IGNORE_PORT);
+      hash ^= hash >> 16;
+      hash ^= hash >> 8;
+    }
+
+  P(qos_mutex);
+
+  pclass = NULL;
+  if(exportid >= 0 && (unsigned int)exportid < qos_nb_export_classes)
+    pclass = qos_export_classes[exportid];
+  if(pclass == NULL)
+    pclass = &qos_classes[0];
+
+  if(pclass == &qos_classes[0])
+    pflow = &qos_client_flows[hash % NFS_QOS_CLIENT_FLOWS];
+  else
+    pflow = &pclass->flow;
+
+  preqnfs->qos_class = pclass;
+  glist_add_tail(&pflow->queue, &preqnfs->qos_list);
+
+  if(glist_empty(&pflow->active_list))
+    {
+      glist_add_tail(&qos_active, &pflow->active_list);
+      qos_nb_active++;
+    }
+
+  pclass->stats.queue_depth++;
+  if(pclass->stats.queue_depth > pclass->stats.max_queue_depth)
+    pclass->stats.max_queue_depth = pclass->stats.queue_depth;
+
+  V(qos_mutex);
+
+  nfs_qos_schedule();
+}                               /* nfs_qos_enqueue */
+
+/**
+ *
+ * nfs_qos_complete: tells the scheduler a worker is done with a request.
+ *
+ * @param preq [IN] the request.
+ *
+ */
+void nfs_qos_complete(request_data_t * preq)
+{
+  nfs_qos_class_t *pclass;
+
+  if(preq->rtype != NFS_REQUEST || preq->rcontent.nfs.qos_class == NULL)
+    return;
+
+  P(qos_mutex);
+
+  pclass = preq->rcontent.nfs.qos_class;
+  pclass->stats.inflight--;
+  qos_inflight--;
+  preq->rcontent.nfs.qos_class = NULL;
+  nfs_qos_release_class_locked(pclass);
+
+  V(qos_mutex);
+
+  nfs_qos_schedule();
+}                               /* nfs_qos_complete */
+
+/**
+ *
+ * nfs_qos_schedule: hands as many requests as possible to the workers.
+ *
+ */
+static void nfs_qos_schedule(void)
+{
+  struct glist_head ready;
+  struct glist_head *glist, *glistn;
+  struct timeval now;
+  nfs_request_data_t *preqnfs;
+  request_data_t *preq;
+  nfs_qos_flow_t *pflow;
+  nfs_qos_class_t *pclass;
+  unsigned long long wait;
+  unsigned int limit;
+  unsigned int nb_blocked = 0;
+
+  init_glist(&ready);
+  gettimeofday(&now, NULL);
+
+  limit = nfs_worker_pool_nb_running() * nfs_param.core_param.qos_queue_depth;
+  if(limit == 0)
+    limit = 1;
+
+  P(qos_mutex);
+
+  while(qos_inflight < limit && qos_nb_active != 0 && nb_blocked < qos_nb_active)
+    {
+      pflow = glist_first_entry(&qos_active, nfs_qos_flow_t, active_list);
+      pclass = pflow->pclass;
+
+      if(!nfs_qos_can_run_locked(pclass, &now))
+        {
+          /* Its class is at its limit, let the other flows go */
+          glist_del(&pflow->active_list);
+          glist_add_tail(&qos_active, &pflow->active_list);
+          nb_blocked++;
+          continue;
+        }
+      nb_blocked = 0;
+
+      if(!pflow->has_turn)
+        {
+          pflow->deficit += NFS_QOS_QUANTUM * pclass->weight;
+          pflow->has_turn = TRUE;
+        }
+
+      preqnfs = glist_first_entry(&pflow->queue, nfs_request_data_t, qos_list);
+
+      if(preqnfs->qos_cost > pflow->deficit)
+        {
+          /* End of its turn, keep the credit for the next round */
+          pflow->has_turn = FALSE;
+          glist_del(&pflow->active_list);
+          glist_add_tail(&qos_active, &pflow->active_list);
+          continue;
+        }
+
+      glist_del(&preqnfs->qos_list);
+      pflow->deficit -= preqnfs->qos_cost;
+      pclass->tokens -= preqnfs->qos_payload;
+
+      wait = (unsigned long long)(now.tv_sec - preqnfs->qos_time.tv_sec) * 1000000 +
+          (now.tv_usec - preqnfs->qos_time.tv_usec);
+      pclass->stats.queue_depth--;
+      pclass->stats.inflight++;
+      pclass->stats.nb_dispatched++;
+      pclass->stats.total_wait += wait;
+      if(wait > pclass->stats.max_wait)
+        pclass->stats.max_wait = wait;
+      qos_inflight++;
+
+      glist_add_tail(&ready, &preqnfs->qos_list);
+
+      if(glist_empty(&pflow->queue))
+        {
+          /* An idle flow does not save credit */
+          pflow->deficit = 0;
+          pflow->has_turn = FALSE;
+          glist_del(&pflow->active_list);
+          init_glist(&pflow->active_list);
+          qos_nb_active--;
+        }
+    }
+
+  V(qos_mutex);
+
+  glist_for_each_safe(glist, glistn, &ready)
+    {
+      preqnfs = glist_entry(glist, nfs_request_data_t, qos_list);
+      glist_del(glist);
+      preq = container_of(preqnfs, request_data_t, rcontent.nfs);
+      DispatchWorkNFS(preq, preqnfs->qos_worker);
+    }
+}                               /* nfs_qos_schedule */
+
+/**
+ *
+ * nfs_qos_oldest_wait: tells how long the oldest waiting request has waited.
+ *
+ * @param pnow [IN] the current time.
+ *
+ * @return the wait time in usec, 0 if no request waits.
+ *
+ */
+unsigned long long nfs_qos_oldest_wait(struct timeval *pnow)
+{
+  struct glist_head *glist;
+  nfs_qos_flow_t *pflow;
+  nfs_request_data_t *preqnfs;
+  long long wait;
+  unsigned long long oldest = 0;
+
+  P(qos_mutex);
+
+  /* Flows are FIFO, only their first request needs a look */
+  glist_for_each(glist, &qos_active)
+    {
+      pflow = glist_entry(glist, nfs_qos_flow_t, active_list);
+      preqnfs = glist_first_entry(&pflow->queue, nfs_request_data_t, qos_list);
+
+      wait = (long long)(pnow->tv_sec - preqnfs->qos_time.tv_sec) * 1000000 +
+          (pnow->tv_usec - preqnfs->qos_time.tv_usec);
+      if(wait > 0 && (unsigned long long)wait > oldest)
+        oldest = wait;
+    }
+
+  V(qos_mutex);
+
+  return oldest;
+}                               /* nfs_qos_oldest_wait */
+
+/**
+ *
+ * nfs_qos_get_stats: gets the statistics of each class.
+ *
+ * @param pstat  [OUT] array filled with the classes' statistics.
+ * @param nb_max [IN]  size of the array.
+ *
+ * @return the number of filled entries.
+ *
+ */
+unsigned int nfs_qos_get_stats(nfs_qos_class_stat_t * pstat, unsigned int nb_max)
+{
+  unsigned int i;
+  unsigned int nb = 0;
+
+  P(qos_mutex);
+
+  for(i = 0; i < qos_nb_classes && nb < nb_max; i++)
+    if(qos_classes[i].in_use)
+      {
+        memcpy(pstat[nb].name, qos_classes[i].name, MAXNAMLEN);
+        pstat[nb].stats = qos_classes[i].stats;
+        nb++;
+      }
+
+  V(qos_mutex);
+
+  return nb;
+}                               /* nfs_qos_get_stats */
@@ -66,6 +66,7 @@
 #include "nfs_creds.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "nfs_qos.h"
 #include "nfs_file_handle.h"
 #include "nfs_stat.h"
 #include "SemN.h"
@@ -665,6 +666,7 @@ unsigned int nfs_core_select_worker_queue()
   unsigned int i;
   static unsigned int last;
   unsigned int cpt = 0;
+  unsigned int nb_worker = nfs_worker_pool_nb_slots();
   worker_available_rc rc;
 
   P(lock_worker_selection);
@@ -673,20 +675,20 @@ unsigned int nfs_core_select_worker_queue()
   /* Calculate the average queue length if counter is bigger than configured value. */
   if(counter > nfs_param.core_param.nb_call_before_queue_avg)
     {
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nb_worker; i++)
         {
           total_number_pending += workers_data[i].pending_request->nb_entry;
         }
-      avg_number_pending = total_number_pending / nfs_param.core_param.nb_worker;
+      avg_number_pending = total_number_pending / nb_worker;
       /* Reset counter. */
       counter = 0;
     }
   V(lock_worker_selection);
 
   /* Choose the queue whose length is smaller than average. */
-      for(i = (last + 1) % nfs_param.core_param.nb_worker, cpt = 0;
-          cpt < nfs_param.core_param.nb_worker;
-          cpt++, i = (i + 1) % nfs_param.core_param.nb_worker)
+      for(i = (last + 1) % nb_worker, cpt = 0;
+          cpt < nb_worker;
+          cpt++, i = (i + 1) % nb_worker)
         {
           /* Choose only fully initialized workers and that does not gc. */
           rc = worker_available(i, avg_number_pending);
@@ -710,7 +712,7 @@ unsigned int nfs_core_select_worker_queue()
         }
 
   if(worker_index == NO_VALUE_CHOOSEN)
-    worker_index = (last + 1) % nfs_param.core_param.nb_worker;
+    worker_index = (last + 1) % nb_worker;
 
   last = worker_index;
 
@@ -898,8 +900,9 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
       pnfsreq->rcontent.nfs.xprt = pnfsreq->rcontent.nfs.xprt_copy;
       preq->rq_xprt = pnfsreq->rcontent.nfs.xprt_copy;
 
-      /* Regular management of the request (UDP request or TCP request on connected handler */
-      DispatchWorkNFS(pnfsreq, worker_index);
+      /* Regular management of the request (UDP request or TCP request on connected handler,
+       * the fair share scheduler decides when it reaches the worker */
+      nfs_qos_enqueue(pnfsreq, worker_index);
 
       gettimeofday(&timer_end, NULL);
       timer_diff = time_diff(timer_start, timer_end);
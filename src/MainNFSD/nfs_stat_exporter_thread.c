@@ -323,7 +323,7 @@ int merge_stats(nfs_request_stat_item_t *global_stat_items,
   int rc = ERR_STAT_NO_ERROR;
   unsigned int i = 0;
 
-  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+  for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
     {
       if(i == 0)
         {
@@ -428,7 +428,8 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
   unsigned int i = 0;
   unsigned int num_cmds = 0;
   nfs_request_stat_item_t *global_stat_items = NULL;
-  nfs_request_stat_item_t *workers_stat_items[nfs_param.core_param.nb_worker];
+  /* Sized for every slot, the pool may grow while the stats are merged */
+  nfs_request_stat_item_t *workers_stat_items[nfs_param.core_param.nb_max_worker];
   char **function_names = NULL;
 
   switch(stat_client_req->nfs_version)
@@ -436,7 +437,7 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
       case 2:
         num_cmds = NFS_V2_NB_COMMAND;
         global_stat_items = (global_data->stat_req.stat_req_nfs2);
-        for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        for(i = 0; i < nfs_param.core_param.nb_max_worker; i++)
           {
             workers_stat_items[i] = (workers_data[i].stats.stat_req.stat_req_nfs2);
           }
@@ -446,7 +447,7 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
       case 3:
         num_cmds = NFS_V3_NB_COMMAND;
         global_stat_items = (global_data->stat_req.stat_req_nfs3);
-        for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        for(i = 0; i < nfs_param.core_param.nb_max_worker; i++)
           {
             workers_stat_items[i] = (workers_data[i].stats.stat_req.stat_req_nfs3);
           }
@@ -456,7 +457,7 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
       case 4:
         num_cmds = NFS_V4_NB_COMMAND;
         global_stat_items = (global_data->stat_req.stat_req_nfs4);
-        for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        for(i = 0; i < nfs_param.core_param.nb_max_worker; i++)
           {
             workers_stat_items[i] = (workers_data[i].stats.stat_req.stat_req_nfs4);
           }
@@ -677,7 +678,7 @@ void *long_processing_thread(void *addr)
       sleep(1);
       gettimeofday(&timer_end, NULL);
 
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         {
           if(workers_data[i].timer_start.tv_sec == 0)
             continue;
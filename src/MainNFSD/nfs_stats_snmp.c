@@ -245,15 +245,15 @@ static int get_inode_stat_nb(snmp_adm_type_union * param, void *opt)
   switch (cs)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].cache_inode_client.stat.nb_gc_lru_active;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].cache_inode_client.stat.nb_gc_lru_total;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].cache_inode_client.stat.nb_call_total;
       break;
     default:
@@ -275,21 +275,21 @@ static int get_inode_stat_func_stat(snmp_adm_type_union * param, void *opt)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer +=
             workers_data[i].cache_inode_client.stat.func_stats.nb_success[j];
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].cache_inode_client.stat.func_stats.nb_call[j];
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer +=
             workers_data[i].cache_inode_client.stat.func_stats.nb_err_retryable[j];
       break;
     case 3:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer +=
             workers_data[i].cache_inode_client.stat.func_stats.nb_err_unrecover[j];
       break;
@@ -410,35 +410,35 @@ static int get_workerstat(snmp_adm_type_union * param, void *opt)
   switch (cs)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.nb_total_req;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.nb_udp_req;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.nb_tcp_req;
       break;
     case 3:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.nb_mnt1_req;
       break;
     case 4:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.nb_mnt3_req;
       break;
     case 5:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.nb_nfs2_req;
       break;
     case 6:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.nb_nfs3_req;
       break;
     case 7:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.nb_nfs4_req;
       break;
     default:
@@ -459,7 +459,7 @@ static int get_pending(snmp_adm_type_union * param, void *opt_arg)
   unsigned total_pending_request = 0;
   unsigned len_pending_request = 0;
 
-  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+  for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
     {
       len_pending_request =
           workers_data[i].pending_request->nb_entry -
@@ -487,7 +487,7 @@ static int get_pending(snmp_adm_type_union * param, void *opt_arg)
       param->integer = total_pending_request;
       break;
     case 3:
-      param->integer = total_pending_request / nfs_param.core_param.nb_worker;
+      param->integer = total_pending_request / nfs_worker_pool_nb_slots();
       break;
     default:
       return 1;
@@ -507,15 +507,15 @@ static int get_mnt1(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt1[cmd].total;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt1[cmd].success;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt1[cmd].dropped;
       break;
     default:
@@ -536,15 +536,15 @@ static int get_mnt3(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt3[cmd].total;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt3[cmd].success;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_mnt3[cmd].dropped;
       break;
     default:
@@ -565,15 +565,15 @@ static int get_nfs2(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs2[cmd].total;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs2[cmd].success;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs2[cmd].dropped;
       break;
     default:
@@ -594,15 +594,15 @@ static int get_nfs3(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs3[cmd].total;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs3[cmd].success;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs3[cmd].dropped;
       break;
     default:
@@ -623,15 +623,15 @@ static int get_nfs4(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs4[cmd].total;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs4[cmd].success;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.stat_req.stat_req_nfs4[cmd].dropped;
       break;
     default:
@@ -652,20 +652,20 @@ static int get_fsal(snmp_adm_type_union * param, void *opt_arg)
   switch (stat)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.fsal_stats.func_stats.nb_call[cmd];
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer += workers_data[i].stats.fsal_stats.func_stats.nb_success[cmd];
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer +=
             workers_data[i].stats.fsal_stats.func_stats.nb_err_retryable[cmd];
       break;
     case 3:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->integer +=
             workers_data[i].stats.fsal_stats.func_stats.nb_err_unrecover[cmd];
       break;
@@ -686,50 +686,50 @@ static int get_buddy(snmp_adm_type_union * param, void *opt_arg)
   switch (cs)
     {
     case 0:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.TotalMemSpace;
       break;
     case 1:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.StdMemSpace;
       break;
     case 2:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.ExtraMemSpace;
       break;
     case 3:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.StdUsedSpace;
       break;
     case 4:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.StdUsedSpace;
 
-      param->bigint /= nfs_param.core_param.nb_worker;
+      param->bigint /= nfs_worker_pool_nb_slots();
 
       break;
     case 5:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         if(workers_data[i].stats.buddy_stats.StdUsedSpace > param->bigint)
           param->bigint = workers_data[i].stats.buddy_stats.StdUsedSpace;
       break;
     case 6:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.NbStdPages;
       break;
     case 7:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.NbStdUsed;
       break;
     case 8:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         param->bigint += workers_data[i].stats.buddy_stats.NbStdUsed;
 
-      param->bigint /= nfs_param.core_param.nb_worker;
+      param->bigint /= nfs_worker_pool_nb_slots();
 
       break;
     case 9:
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         if(workers_data[i].stats.buddy_stats.NbStdUsed > param->bigint)
           param->bigint = workers_data[i].stats.buddy_stats.NbStdUsed;
       break;
@@ -1659,6 +1659,6 @@ int stats_snmp(nfs_worker_data_t * workers_data_local)
       /* Now managed IP stats dump */
 /* FIXME 
       nfs_ip_stats_dump(  ht_ip_stats, 
-                          nfs_param.core_param.nb_worker, 
+                          nfs_worker_pool_nb_slots(), 
                           nfs_param.core_param.stats_per_client_directory  ) ;
 */
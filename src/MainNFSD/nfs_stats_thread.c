@@ -49,6 +49,7 @@
 #include "nfs_core.h"
 #include "nfs_stat.h"
 #include "nfs_exports.h"
+#include "nfs_qos.h"
 #include "log_macros.h"
 
 extern hash_table_t *ht_ip_stats[NB_MAX_WORKER_THREAD];
@@ -88,9 +89,11 @@ void *stats_thread(void *addr)
   nfs_worker_data_t *workers_data = addr;
 
   cache_inode_stat_t global_cache_inode_stat;
+  cache_inode_fd_cache_stat_t fd_cache_stat;
   nfs_worker_stat_t global_worker_stat;
   hash_stat_t hstat;
   hash_stat_t hstat_reverse;
+  idmap_cache_stat_t idmap_cache_stat;
 
   unsigned long long total_fsal_calls;
   fsal_statistics_t global_fsal_stat;
@@ -103,6 +106,9 @@ void *stats_thread(void *addr)
 
   unsigned int avg_latency;
 
+  nfs_qos_class_stat_t qos_stat[NFS_QOS_MAX_CLASSES];
+  unsigned int nb_qos_class;
+
 #ifndef _NO_BUDDY_SYSTEM
   int rc = 0;
   buddy_stats_t global_buddy_stat;
@@ -220,7 +226,7 @@ void *stats_thread(void *addr)
              sizeof(unsigned int) * CACHE_INODE_NB_COMMAND);
 
       /* Merging the cache inode stats for every thread */
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         {
           global_cache_inode_stat.nb_gc_lru_active +=
               workers_data[i].cache_inode_client.stat.nb_gc_lru_active;
@@ -291,6 +297,15 @@ void *stats_thread(void *addr)
               hstat.dynamic.err.nb_get, hstat.dynamic.ok.nb_del,
               hstat.dynamic.notfound.nb_del, hstat.dynamic.err.nb_del);
 
+      /* Printing the descriptors kept open by cache_inode, shared by all the workers */
+      cache_inode_fd_cache_get_stats(&fd_cache_stat);
+
+      fprintf(stats_file, "CACHE_INODE_FD,%s;%u,%u|%u,%u,%u,%u,%u,%u\n",
+              strdate, fd_cache_stat.nb_open, fd_cache_stat.max_open,
+              fd_cache_stat.nb_opened, fd_cache_stat.nb_closed,
+              fd_cache_stat.nb_open_avoided, fd_cache_stat.nb_close_avoided,
+              fd_cache_stat.nb_upgraded, fd_cache_stat.nb_evicted);
+
       /* Merging the NFS protocols stats together */
       global_worker_stat.nb_total_req = 0;
       global_worker_stat.nb_udp_req = 0;
@@ -313,7 +328,7 @@ void *stats_thread(void *addr)
       average_pending_request = 0;
       len_pending_request = 0;
 
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         {
           global_worker_stat.nb_total_req += workers_data[i].stats.nb_total_req;
           global_worker_stat.nb_udp_req += workers_data[i].stats.nb_udp_req;
@@ -582,7 +597,7 @@ void *stats_thread(void *addr)
         }                       /* for( i = 0 ; i < nfs_param.core_param.nb_worker ; i++ ) */
 
       /* Compute average pending request */
-      average_pending_request = total_pending_request / nfs_param.core_param.nb_worker;
+      average_pending_request = total_pending_request / nfs_worker_pool_nb_slots();
 
       fprintf(stats_file, "NFS/MOUNT STATISTICS,%s;%u,%u,%u|%u,%u,%u,%u,%u|%u,%u,%u,%u\n",
               strdate,
@@ -702,6 +717,17 @@ void *stats_thread(void *addr)
                 global_worker_stat.stat_req.stat_req_rquota2[j].dropped);
       fprintf(stats_file, "\n");
 
+      /* Printing the fair share scheduler stats, per QoS class */
+      nb_qos_class = nfs_qos_get_stats(qos_stat, NFS_QOS_MAX_CLASSES);
+      for(i = 0; i < nb_qos_class; i++)
+        fprintf(stats_file, "QOS_CLASS,%s;%s,%u,%u,%u|%llu,%llu|%llu,%llu\n",
+                strdate, qos_stat[i].name, qos_stat[i].stats.queue_depth,
+                qos_stat[i].stats.max_queue_depth, qos_stat[i].stats.inflight,
+                qos_stat[i].stats.nb_dispatched, qos_stat[i].stats.nb_throttled,
+                (qos_stat[i].stats.nb_dispatched == 0) ? 0ULL :
+                qos_stat[i].stats.total_wait / qos_stat[i].stats.nb_dispatched,
+                qos_stat[i].stats.max_wait);
+
       /* Printing the cache inode hash stat */
       nfs_dupreq_get_stats(&hstat);
 
@@ -766,6 +792,40 @@ void *stats_thread(void *addr)
               hstat_reverse.dynamic.err.nb_get, hstat_reverse.dynamic.ok.nb_del,
               hstat_reverse.dynamic.notfound.nb_del, hstat_reverse.dynamic.err.nb_del);
 
+      /* Lookups served by the id mapper caches, latency of the directory in usec */
+      idmap_get_cache_stats(UIDMAP_TYPE, &idmap_cache_stat);
+      fprintf(stats_file,
+              "UIDMAP_CACHE,%s;%u,%u,%u,%u|%u,%u,%u,%u|%llu,%u\n", strdate,
+              idmap_cache_stat.nb_hit, idmap_cache_stat.nb_hit_stale,
+              idmap_cache_stat.nb_hit_negative, idmap_cache_stat.nb_miss,
+              idmap_cache_stat.nb_resolve, idmap_cache_stat.nb_resolve_err,
+              idmap_cache_stat.nb_refresh, idmap_cache_stat.nb_refresh_dropped,
+              (idmap_cache_stat.nb_resolve == 0) ? 0 :
+              idmap_cache_stat.total_latency / idmap_cache_stat.nb_resolve,
+              idmap_cache_stat.max_latency);
+
+      idmap_get_cache_stats(GIDMAP_TYPE, &idmap_cache_stat);
+      fprintf(stats_file,
+              "GIDMAP_CACHE,%s;%u,%u,%u,%u|%u,%u,%u,%u|%llu,%u\n", strdate,
+              idmap_cache_stat.nb_hit, idmap_cache_stat.nb_hit_stale,
+              idmap_cache_stat.nb_hit_negative, idmap_cache_stat.nb_miss,
+              idmap_cache_stat.nb_resolve, idmap_cache_stat.nb_resolve_err,
+              idmap_cache_stat.nb_refresh, idmap_cache_stat.nb_refresh_dropped,
+              (idmap_cache_stat.nb_resolve == 0) ? 0 :
+              idmap_cache_stat.total_latency / idmap_cache_stat.nb_resolve,
+              idmap_cache_stat.max_latency);
+
+      uid2grp_get_stats(&idmap_cache_stat);
+      fprintf(stats_file,
+              "UID2GRP_CACHE,%s;%u,%u,%u,%u|%u,%u,%u,%u|%llu,%u\n", strdate,
+              idmap_cache_stat.nb_hit, idmap_cache_stat.nb_hit_stale,
+              idmap_cache_stat.nb_hit_negative, idmap_cache_stat.nb_miss,
+              idmap_cache_stat.nb_resolve, idmap_cache_stat.nb_resolve_err,
+              idmap_cache_stat.nb_refresh, idmap_cache_stat.nb_refresh_dropped,
+              (idmap_cache_stat.nb_resolve == 0) ? 0 :
+              idmap_cache_stat.total_latency / idmap_cache_stat.nb_resolve,
+              idmap_cache_stat.max_latency);
+
       /* Stats for the IP/Name hashtable */
       nfs_ip_name_get_stats(&hstat);
       fprintf(stats_file,
@@ -785,7 +845,7 @@ void *stats_thread(void *addr)
       memset(&global_fsal_stat, 0, sizeof(fsal_statistics_t));
       total_fsal_calls = 0;
 
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         {
 
           for(j = 0; j < FSAL_NB_FUNC; j++)
@@ -819,7 +879,7 @@ void *stats_thread(void *addr)
 
       memset(&global_buddy_stat, 0, sizeof(buddy_stats_t));
 
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      for(i = 0; i < nfs_worker_pool_nb_slots(); i++)
         {
 
           global_buddy_stat.TotalMemSpace +=
@@ -842,6 +902,13 @@ void *stats_thread(void *addr)
           if(workers_data[i].stats.buddy_stats.NbStdUsed > global_buddy_stat.WM_NbStdUsed)
             global_buddy_stat.WM_NbStdUsed = workers_data[i].stats.buddy_stats.NbStdUsed;
 
+          global_buddy_stat.CachedSpace += workers_data[i].stats.buddy_stats.CachedSpace;
+          global_buddy_stat.LargeCachedSpace +=
+              workers_data[i].stats.buddy_stats.LargeCachedSpace;
+          global_buddy_stat.NbCacheHits += workers_data[i].stats.buddy_stats.NbCacheHits;
+          global_buddy_stat.NbCacheMisses += workers_data[i].stats.buddy_stats.NbCacheMisses;
+          global_buddy_stat.NbRemoteFrees += workers_data[i].stats.buddy_stats.NbRemoteFrees;
+
         }
 
       /* total memory space preallocated, total space preallocated for pages, total space that overflows pages */
@@ -855,12 +922,22 @@ void *stats_thread(void *addr)
               (unsigned long)global_buddy_stat.ExtraMemSpace,
               (unsigned long)global_buddy_stat.StdUsedSpace,
               (unsigned long)(global_buddy_stat.StdUsedSpace /
-                              nfs_param.core_param.nb_worker),
+                              nfs_worker_pool_nb_slots()),
               (unsigned long)global_buddy_stat.WM_StdUsedSpace,
               global_buddy_stat.NbStdPages, global_buddy_stat.NbStdUsed,
-              global_buddy_stat.NbStdUsed / nfs_param.core_param.nb_worker,
+              global_buddy_stat.NbStdUsed / nfs_worker_pool_nb_slots(),
               global_buddy_stat.WM_NbStdUsed);
 
+      /* space in the small and extra block caches, allocations served by them, missed, blocks freed by another thread */
+
+      fprintf(stats_file, "BUDDY_CACHE,%s;%lu,%lu|%lu,%lu,%lu\n",
+              strdate,
+              (unsigned long)global_buddy_stat.CachedSpace,
+              (unsigned long)global_buddy_stat.LargeCachedSpace,
+              global_buddy_stat.NbCacheHits,
+              global_buddy_stat.NbCacheMisses,
+              global_buddy_stat.NbRemoteFrees);
+
 #endif
 
       /* Flush the data written */
@@ -869,7 +946,7 @@ void *stats_thread(void *addr)
 
       /* Now managed IP stats dump */
       nfs_ip_stats_dump(ht_ip_stats,
-                        nfs_param.core_param.nb_worker,
+                        nfs_worker_pool_nb_slots(),
                         nfs_param.core_param.stats_per_client_directory);
 
     }                           /* while ( 1 ) */
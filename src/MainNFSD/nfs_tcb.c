@@ -103,6 +103,49 @@ void tcb_remove(nfs_tcb_t *element)
   V(gtcb_mutex);
 }
 
+/**
+ * tcb_revive: (Re)insert the tcb of a thread about to be started after the
+ * other threads, in the state they are in. The tcb may still be in the list
+ * when it comes from tcb_new.
+ * Returns -1 if the threads are exiting.
+ */
+int tcb_revive(nfs_tcb_t *element)
+{
+  P(gtcb_mutex);
+  if(pause_state == STATE_EXIT)
+    {
+      V(gtcb_mutex);
+      return -1;
+    }
+
+  P(element->tcb_mutex);
+  switch(pause_state)
+    {
+      case STATE_AWAKE:
+      case STATE_AWAKEN:
+        element->tcb_state = STATE_AWAKEN;
+        break;
+
+      case STATE_PAUSE:
+      case STATE_PAUSED:
+        /* Not counted as active, so nothing to wait for: sleep until awaken */
+        element->tcb_state = STATE_PAUSED;
+        break;
+
+      default:
+        element->tcb_state = pause_state;
+        break;
+    }
+  element->tcb_ready = FALSE;
+  V(element->tcb_mutex);
+
+  glist_del(&element->tcb_list);
+  glist_add_tail(&tcb_head, &element->tcb_list);
+  V(gtcb_mutex);
+
+  return 0;
+}
+
 /**
  * tcb_new: Initialize and insert the new tcb element
  * If no inext to prefix with the name, pass -1.
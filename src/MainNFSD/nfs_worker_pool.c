@@ -0,0 +1,440 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_worker_pool.c
+ * \brief   Grows and shrinks the set of worker threads with the load.
+ *
+ * nfs_worker_pool.c : Grows and shrinks the set of worker threads with the load.
+ *
+ * Nb_Worker workers are started at boot and always run. When the oldest
+ * request waiting for a worker (in the QoS scheduler or in a worker queue)
+ * has waited more than Worker_Spawn_Wait msec, the pool thread adds one
+ * worker, up to Nb_Max_Worker. An added worker exits once it has been idle
+ * for Worker_Idle_Timeout seconds.
+ *
+ * A worker slot is only initialized the first time the pool grows into it.
+ * Its data (queues, pools, cache clients) is kept when its thread retires:
+ * the cache inode entries allocated by a worker may still be in the cache
+ * inode hash table. The next thread on the slot takes them over, so a
+ * respawn only costs a thread creation. The duplicate requests of a retired
+ * slot still expire: the pool thread releases them until a thread is back.
+ *
+ * Core_param's nb_worker is the number of initialized slots. It only grows,
+ * it is stored once the slot is complete and is read through
+ * nfs_worker_pool_nb_slots by the threads that loop on the workers.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_tcb.h"
+#include "nfs_qos.h"
+#include "nfs_dupreq.h"
+
+extern nfs_parameter_t nfs_param;
+extern nfs_worker_data_t *workers_data;
+extern pthread_t worker_thrid[NB_MAX_WORKER_THREAD];
+
+static pthread_mutex_t worker_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_attr_t worker_pool_attr;
+static unsigned int worker_pool_min = 0;
+static unsigned int worker_pool_running = 0;
+
+/* The thread that last served a slot has exited and is to be joined */
+static bool_t worker_exited[NB_MAX_WORKER_THREAD];
+
+/**
+ *
+ * nfs_worker_pool_init: sets up the pool with the workers started at boot.
+ *
+ */
+void nfs_worker_pool_init(void)
+{
+  worker_pool_min = nfs_param.core_param.nb_worker;
+  worker_pool_running = nfs_param.core_param.nb_worker;
+
+  pthread_attr_init(&worker_pool_attr);
+  pthread_attr_setscope(&worker_pool_attr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&worker_pool_attr, PTHREAD_CREATE_JOINABLE);
+  pthread_attr_setstacksize(&worker_pool_attr, THREAD_STACK_SIZE);
+}                               /* nfs_worker_pool_init */
+
+/**
+ *
+ * nfs_worker_pool_nb_running: tells how many workers currently run.
+ *
+ * @return the number of running workers.
+ *
+ */
+unsigned int nfs_worker_pool_nb_running(void)
+{
+  return worker_pool_running;
+}                               /* nfs_worker_pool_nb_running */
+
+/**
+ *
+ * nfs_worker_pool_nb_slots: tells how many worker slots are initialized.
+ *
+ * Pairs with the store of nfs_worker_pool_grow: the data of every slot below
+ * the value returned is complete.
+ *
+ * @return the number of initialized slots.
+ *
+ */
+unsigned int nfs_worker_pool_nb_slots(void)
+{
+  return __atomic_load_n(&nfs_param.core_param.nb_worker, __ATOMIC_ACQUIRE);
+}                               /* nfs_worker_pool_nb_slots */
+
+/**
+ *
+ * nfs_worker_pool_start_locked: starts a thread on an initialized slot.
+ *
+ * Must be called with worker_pool_mutex held.
+ *
+ * @param worker_index [IN] the slot.
+ *
+ * @return 0 if successful (or already running), -1 otherwise.
+ *
+ */
+static int nfs_worker_pool_start_locked(unsigned long worker_index)
+{
+  nfs_worker_data_t *pworker_data = &workers_data[worker_index];
+  int rc;
+
+  if(pworker_data->running)
+    return 0;
+
+  if(worker_exited[worker_index])
+    {
+      /* It has marked itself done, it is about to return */
+      pthread_join(worker_thrid[worker_index], NULL);
+      worker_exited[worker_index] = FALSE;
+    }
+
+  if(tcb_revive(&pworker_data->wcb) != 0)
+    return -1;
+
+  P(pworker_data->wcb.tcb_mutex);
+  pworker_data->running = TRUE;
+  pworker_data->last_activity = time(NULL);
+  V(pworker_data->wcb.tcb_mutex);
+
+  if((rc = pthread_create(&worker_thrid[worker_index], &worker_pool_attr,
+                          worker_thread, (void *)worker_index)) != 0)
+    {
+      LogCrit(COMPONENT_THREAD,
+              "Could not create worker_thread #%lu, error = %d (%s)",
+              worker_index, rc, strerror(rc));
+      tcb_remove(&pworker_data->wcb);
+      P(pworker_data->wcb.tcb_mutex);
+      pworker_data->running = FALSE;
+      V(pworker_data->wcb.tcb_mutex);
+      return -1;
+    }
+
+  worker_pool_running++;
+
+  return 0;
+}                               /* nfs_worker_pool_start_locked */
+
+/**
+ *
+ * nfs_worker_pool_grow: adds a worker, reusing a retired slot if any.
+ *
+ */
+static void nfs_worker_pool_grow(void)
+{
+  unsigned int i;
+  unsigned int nb_worker;
+  int rc;
+
+  P(worker_pool_mutex);
+
+  nb_worker = nfs_param.core_param.nb_worker;
+
+  for(i = worker_pool_min; i < nb_worker; i++)
+    if(!workers_data[i].running)
+      break;
+
+  if(i == nb_worker)
+    {
+      if(nb_worker == nfs_param.core_param.nb_max_worker)
+        {
+          V(worker_pool_mutex);
+          return;
+        }
+
+      if(nfs_Init_worker_slot(i, workers_data[0].ht) != 0)
+        {
+          V(worker_pool_mutex);
+          LogCrit(COMPONENT_THREAD,
+                  "Could not initialize worker slot #%u, the pool keeps %u workers",
+                  i, worker_pool_running);
+          return;
+        }
+      workers_data[i].elastic = TRUE;
+    }
+
+  rc = nfs_worker_pool_start_locked(i);
+
+  /* The slot and its thread are complete, the loops on the workers may now
+   * see it. A slot whose thread could not start is revived when a request
+   * is queued to it. */
+  if(i == nb_worker)
+    __atomic_store_n(&nfs_param.core_param.nb_worker, nb_worker + 1, __ATOMIC_RELEASE);
+
+  if(rc == 0)
+    LogEvent(COMPONENT_THREAD,
+             "Worker Thread #%u started on load, %u workers running",
+             i, worker_pool_running);
+
+  V(worker_pool_mutex);
+}                               /* nfs_worker_pool_grow */
+
+/**
+ *
+ * nfs_worker_pool_gc_retired: releases the expired duplicate requests of the retired slots.
+ *
+ * A slot's duplicate requests are only released by the thread on the slot.
+ * While it has none, the pool thread does it, under worker_pool_mutex so
+ * that no thread starts on the slot meanwhile.
+ *
+ */
+static void nfs_worker_pool_gc_retired(void)
+{
+  unsigned int i;
+  int nb_released;
+
+  P(worker_pool_mutex);
+
+  for(i = worker_pool_min; i < nfs_param.core_param.nb_worker; i++)
+    {
+      if(workers_data[i].running || workers_data[i].dupreq_expired.twq_count == 0)
+        continue;
+
+      nb_released = nfs_dupreq_gc_expired(workers_data[i].duplicate_request,
+                                          &workers_data[i].dupreq_expired,
+                                          &workers_data[i].dupreq_pool);
+
+      LogFullDebug(COMPONENT_THREAD,
+                   "Released %d duplicate requests of retired worker slot #%u",
+                   nb_released, i);
+    }
+
+  V(worker_pool_mutex);
+}                               /* nfs_worker_pool_gc_retired */
+
+/**
+ *
+ * nfs_worker_pool_revive: starts again the thread of a retired slot.
+ *
+ * Used when a request was queued to a worker that retired meanwhile.
+ *
+ * @param worker_index [IN] the slot.
+ *
+ */
+void nfs_worker_pool_revive(unsigned int worker_index)
+{
+  P(worker_pool_mutex);
+  nfs_worker_pool_start_locked(worker_index);
+  V(worker_pool_mutex);
+}                               /* nfs_worker_pool_revive */
+
+/**
+ *
+ * nfs_worker_pool_retire: lets an idle worker exit.
+ *
+ * Called by the worker itself, without any lock held. If it returns TRUE,
+ * the worker is marked done and must return at once.
+ *
+ * @param pworker_data [INOUT] the worker.
+ *
+ * @return TRUE if the worker may exit, FALSE if it has work or is needed.
+ *
+ */
+bool_t nfs_worker_pool_retire(nfs_worker_data_t * pworker_data)
+{
+  if(!pworker_data->elastic)
+    return FALSE;
+
+  P(worker_pool_mutex);
+  P(pworker_data->wcb.tcb_mutex);
+
+  /* A request may have been queued since the wait timed out */
+  if(pworker_data->wcb.tcb_state != STATE_AWAKE ||
+     pworker_data->pending_request->nb_entry !=
+     pworker_data->pending_request->nb_invalid)
+    {
+      V(pworker_data->wcb.tcb_mutex);
+      V(worker_pool_mutex);
+      return FALSE;
+    }
+
+  pworker_data->running = FALSE;
+  V(pworker_data->wcb.tcb_mutex);
+
+  worker_exited[pworker_data->worker_index] = TRUE;
+  worker_pool_running--;
+
+  mark_thread_done(&pworker_data->wcb);
+
+  LogEvent(COMPONENT_THREAD,
+           "Worker Thread #%u retired, %u workers running",
+           pworker_data->worker_index, worker_pool_running);
+
+  V(worker_pool_mutex);
+
+  return TRUE;
+}                               /* nfs_worker_pool_retire */
+
+/**
+ *
+ * nfs_worker_pool_queue_wait: tells how long the oldest request queued to a worker has waited.
+ *
+ * The first request of a queue is the one being processed, it does not count.
+ *
+ * @param pnow [IN] the current time.
+ *
+ * @return the wait time in usec.
+ *
+ */
+static unsigned long long nfs_worker_pool_queue_wait(struct timeval *pnow)
+{
+  unsigned int i;
+  LRU_entry_t *pentry;
+  request_data_t *preq;
+  bool_t first;
+  long long wait;
+  unsigned long long oldest = 0;
+  unsigned int nb_worker = nfs_worker_pool_nb_slots();
+
+  for(i = 0; i < nb_worker; i++)
+    {
+      P(workers_data[i].request_pool_mutex);
+
+      first = TRUE;
+      for(pentry = workers_data[i].pending_request->LRU; pentry != NULL;
+          pentry = pentry->next)
+        {
+          if(pentry->valid_state != LRU_ENTRY_VALID)
+            continue;
+
+          if(first)
+            {
+              first = FALSE;
+              continue;
+            }
+
+          /* Queues are FIFO, the next valid entry is the oldest waiting one */
+          preq = (request_data_t *) pentry->buffdata.pdata;
+          if(preq->rtype == NFS_REQUEST)
+            {
+              wait = (long long)(pnow->tv_sec - preq->rcontent.nfs.qos_time.tv_sec) * 1000000 +
+                  (pnow->tv_usec - preq->rcontent.nfs.qos_time.tv_usec);
+              if(wait > 0 && (unsigned long long)wait > oldest)
+                oldest = wait;
+            }
+          break;
+        }
+
+      V(workers_data[i].request_pool_mutex);
+    }
+
+  return oldest;
+}                               /* nfs_worker_pool_queue_wait */
+
+/**
+ *
+ * worker_pool_thread: adds workers while requests wait too long.
+ *
+ * @param UnusedArg not used.
+ *
+ * @return never returns.
+ *
+ */
+void *worker_pool_thread(void *UnusedArg)
+{
+  struct timeval now;
+  unsigned long long wait;
+  unsigned long long wait_max;
+  unsigned int period;
+  int rc;
+
+  SetNameFunction("worker_pool");
+
+#ifndef _NO_BUDDY_SYSTEM
+  /* Worker slots added on load are allocated from here */
+  if((rc = BuddyInit(&nfs_param.buddy_param_worker)) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogFatal(COMPONENT_THREAD,
+               "Memory manager could not be initialized");
+    }
+#endif
+
+  wait_max = (unsigned long long)nfs_param.core_param.worker_spawn_wait * 1000;
+
+  /* Look twice per threshold so that a worker comes soon after it is crossed */
+  period = nfs_param.core_param.worker_spawn_wait * 500;
+  if(period < 1000)
+    period = 1000;
+
+  while(1)
+    {
+      usleep(period);
+
+      gettimeofday(&now, NULL);
+
+      wait = nfs_qos_oldest_wait(&now);
+      if(wait < wait_max)
+        wait = nfs_worker_pool_queue_wait(&now);
+
+      if(wait >= wait_max)
+        {
+          LogDebug(COMPONENT_THREAD,
+                   "A request has waited %llu usec, adding a worker", wait);
+          nfs_worker_pool_grow();
+        }
+
+      nfs_worker_pool_gc_retired();
+    }
+
+  return NULL;
+}                               /* worker_pool_thread */
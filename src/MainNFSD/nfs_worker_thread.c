@@ -68,6 +68,7 @@
 #include "nfs_file_handle.h"
 #include "nfs_stat.h"
 #include "nfs_tcb.h"
+#include "nfs_qos.h"
 #include "SemN.h"
 
 #ifdef _USE_PNFS
@@ -1503,7 +1504,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                      ptr_req,
                                      preqnfs->xprt,
                                      &res_nfs,
-                                     lru_dupreq);
+                                     lru_dupreq,
+                                     &pworker_data->dupreq_expired);
         }
     } /* rc == NFS_REQ_DROP */
 
@@ -1621,6 +1623,8 @@ worker_available_rc worker_available(unsigned long worker_index, unsigned int av
 int nfs_Init_worker_data(nfs_worker_data_t * pdata)
 {
   LRU_status_t status = LRU_LIST_SUCCESS;
+  LRU_parameter_t lru_param = nfs_param.worker_param.lru_param;
+  LRU_parameter_t lru_dupreq = nfs_param.worker_param.lru_dupreq;
   char name[256];
 
   if(pthread_mutex_init(&(pdata->request_pool_mutex), NULL) != 0)
@@ -1631,25 +1635,25 @@ int nfs_Init_worker_data(nfs_worker_data_t * pdata)
     return -1;
 
   sprintf(name, "Worker Thread #%u Pending Request", pdata->worker_index);
-  nfs_param.worker_param.lru_param.name = Str_Dup(name);
+  lru_param.name = Str_Dup(name);
 
-  if((pdata->pending_request =
-      LRU_Init(nfs_param.worker_param.lru_param, &status)) == NULL)
+  if((pdata->pending_request = LRU_Init(lru_param, &status)) == NULL)
     {
       LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
       return -1;
     }
 
   sprintf(name, "Worker Thread #%u Duplicate Request", pdata->worker_index);
-  nfs_param.worker_param.lru_dupreq.name = Str_Dup(name);
+  lru_dupreq.name = Str_Dup(name);
 
-  if((pdata->duplicate_request =
-      LRU_Init(nfs_param.worker_param.lru_dupreq, &status)) == NULL)
+  if((pdata->duplicate_request = LRU_Init(lru_dupreq, &status)) == NULL)
     {
       LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
       return -1;
     }
 
+  timer_wheel_queue_init(&pdata->dupreq_expired);
+
   pdata->passcounter = 0;
   pdata->wcb.tcb_ready = FALSE;
   pdata->gc_in_progress = FALSE;
@@ -1664,6 +1668,7 @@ void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index)
   LRU_status_t status;
   struct svc_req *ptr_req = &pnfsreq->rcontent.nfs.req;
   unsigned int rpcxid = get_rpc_xid(ptr_req);
+  bool_t running;
 
   LogDebug(COMPONENT_DISPATCH,
            "Awaking Worker Thread #%u for request %p, xid=%u",
@@ -1696,8 +1701,13 @@ void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index)
                errno, strerror(errno), worker_index);
       Fatal();
     }
+  running = workers_data[worker_index].running;
   V(workers_data[worker_index].request_pool_mutex);
   V(workers_data[worker_index].wcb.tcb_mutex);
+
+  /* The worker was chosen before it retired: get a thread back on its queue */
+  if(!running)
+    nfs_worker_pool_revive(worker_index);
 }
 
 enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
@@ -1807,6 +1817,7 @@ void *worker_thread(void *IndexArg)
   cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
   unsigned int gc_allowed = FALSE;
   char thr_name[32];
+  struct timespec idle_deadline;
 
 #ifdef _USE_MFSL
   fsal_status_t fsal_status ;
@@ -1879,47 +1890,59 @@ void *worker_thread(void *IndexArg)
     }
 #endif /* _USE_SHARED_FSAL */
 
-  /* Init the Cache inode client for this worker */
-  if(cache_inode_client_init(&pmydata->cache_inode_client,
-                             nfs_param.cache_layers_param.cache_inode_client_param,
-                             worker_index, pmydata))
+  /* The cache clients of the slot outlive its threads: their pools hold
+   * entries that are still in the cache inode hash table. A thread that
+   * serves the slot again after a retired one just takes them over. */
+  if(!pmydata->clients_initialized)
     {
-      /* Failed init */
-      LogFatal(COMPONENT_DISPATCH,
-               "Cache Inode client could not be initialized");
-    }
-  LogFullDebug(COMPONENT_DISPATCH,
-               "Cache Inode client successfully initialized");
+      /* Init the Cache inode client for this worker */
+      if(cache_inode_client_init(&pmydata->cache_inode_client,
+                                 nfs_param.cache_layers_param.cache_inode_client_param,
+                                 worker_index, pmydata))
+        {
+          /* Failed init */
+          LogFatal(COMPONENT_DISPATCH,
+                   "Cache Inode client could not be initialized");
+        }
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Cache Inode client successfully initialized");
 
 #ifdef _USE_MFSL
 
 #ifdef _USE_SHARED_FSAL
 #error "For the moment, no MFSL are supported with dynamic FSALs"
 #else
-  if(FSAL_IS_ERROR(MFSL_GetContext(&pmydata->cache_inode_client.mfsl_context, (&(pmydata->thread_fsal_context) ) ) ) ) 
+      if(FSAL_IS_ERROR(MFSL_GetContext(&pmydata->cache_inode_client.mfsl_context, (&(pmydata->thread_fsal_context) ) ) ) ) 
 #endif
-    {
-      /* Failed init */
-      LogFatal(COMPONENT_DISPATCH, "Error initing MFSL");
-    }
+        {
+          /* Failed init */
+          LogFatal(COMPONENT_DISPATCH, "Error initing MFSL");
+        }
 #endif
 
-  /* Init the Cache content client for this worker */
-  if(cache_content_client_init(&pmydata->cache_content_client,
-                               nfs_param.cache_layers_param.cache_content_client_param,
-                               thr_name))
-    {
-      /* Failed init */
-      LogFatal(COMPONENT_DISPATCH,
-               "Cache Content client could not be initialized");
-    }
-  LogFullDebug(COMPONENT_DISPATCH,
-               "Cache Content client successfully initialized");
+      /* Init the Cache content client for this worker */
+      if(cache_content_client_init(&pmydata->cache_content_client,
+                                   nfs_param.cache_layers_param.cache_content_client_param,
+                                   thr_name))
+        {
+          /* Failed init */
+          LogFatal(COMPONENT_DISPATCH,
+                   "Cache Content client could not be initialized");
+        }
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Cache Content client successfully initialized");
+
+      /* _USE_PNFS */
+
+      /* Bind the data cache client to the inode cache client */
+      pmydata->cache_inode_client.pcontent_client = (caddr_t) & pmydata->cache_content_client;
 
-  /* _USE_PNFS */
+      nfs_export_reader_register(&pmydata->export_reader);
 
-  /* Bind the data cache client to the inode cache client */
-  pmydata->cache_inode_client.pcontent_client = (caddr_t) & pmydata->cache_content_client;
+      pmydata->clients_initialized = TRUE;
+    }
+
+  pmydata->last_activity = time(NULL);
 
   LogInfo(COMPONENT_DISPATCH, "Worker successfully initialized");
 
@@ -1976,8 +1999,33 @@ void *worker_thread(void *IndexArg)
                         pmydata->pending_request->nb_invalid)
                       {
                         /* No work; wait */
-                        pthread_cond_wait(&(pmydata->wcb.tcb_condvar),
-                                          &(pmydata->wcb.tcb_mutex));
+                        if(pmydata->elastic &&
+                           nfs_param.core_param.worker_idle_timeout != 0)
+                          {
+                            /* A worker added on load goes away when idle */
+                            idle_deadline.tv_sec = pmydata->last_activity +
+                                nfs_param.core_param.worker_idle_timeout;
+                            idle_deadline.tv_nsec = 0;
+
+                            if(pthread_cond_timedwait(&(pmydata->wcb.tcb_condvar),
+                                                      &(pmydata->wcb.tcb_mutex),
+                                                      &idle_deadline) == ETIMEDOUT)
+                              {
+                                V(pmydata->wcb.tcb_mutex);
+                                if(nfs_worker_pool_retire(pmydata))
+                                  {
+                                    LogDebug(COMPONENT_DISPATCH,
+                                             "Worker exiting after %u seconds idle",
+                                             nfs_param.core_param.worker_idle_timeout);
+                                    return NULL;
+                                  }
+                                pmydata->last_activity = time(NULL);
+                                continue;
+                              }
+                          }
+                        else
+                          pthread_cond_wait(&(pmydata->wcb.tcb_condvar),
+                                            &(pmydata->wcb.tcb_mutex));
                         V(pmydata->wcb.tcb_mutex);
                         continue;
                       }
@@ -2019,7 +2067,8 @@ void *worker_thread(void *IndexArg)
 
       pnfsreq = (request_data_t *) (pentry->buffdata.pdata);
 
-     
+      nfs_export_read_begin(&pmydata->export_reader);
+
       switch( pnfsreq->rtype )
        {
           case NFS_REQUEST:
@@ -2062,6 +2111,12 @@ void *worker_thread(void *IndexArg)
 	    break ;
          }
 
+      nfs_export_read_end(&pmydata->export_reader);
+
+      /* Let the scheduler hand out the next request */
+      nfs_qos_complete(pnfsreq);
+      pmydata->last_activity = time(NULL);
+
       /* Free the req by releasing the entry */
       LogFullDebug(COMPONENT_DISPATCH,
                    "Invalidating processed entry");
@@ -2073,41 +2128,20 @@ void *worker_thread(void *IndexArg)
         }
       V(pmydata->request_pool_mutex);
 
-      if(pmydata->passcounter > nfs_param.worker_param.nb_before_gc)
+      /* Garbage collection on dup req cache, the timer wheel has already
+       * picked the expired entries */
+      if(pmydata->dupreq_expired.twq_count != 0)
         {
-          /* Garbage collection on dup req cache */
+          rc = nfs_dupreq_gc_expired(pmydata->duplicate_request,
+                                     &pmydata->dupreq_expired,
+                                     &pmydata->dupreq_pool);
           LogFullDebug(COMPONENT_DISPATCH,
-                       "before dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_invalidate_by_function(pmydata->duplicate_request,
-                                         nfs_dupreq_gc_function,
-                                         NULL)) != LRU_LIST_SUCCESS)
-            {
-              LogCrit(COMPONENT_DISPATCH,
-                      "FAILURE: Impossible to invalidate entries for duplicate request cache (error %d)",
-                      rc);
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_gc_invalid(pmydata->duplicate_request,
-                             (void *)&pmydata->dupreq_pool)) != LRU_LIST_SUCCESS)
-            LogCrit(COMPONENT_DISPATCH,
-                    "FAILURE: Impossible to gc entries for duplicate request cache (error %d)",
-                    rc);
-          else
-            LogFullDebug(COMPONENT_DISPATCH,
-                         "gc entries for duplicate request cache OK");
-
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq gc nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
+                       "after dupreq gc released=%d nb_entry=%d",
+                       rc, pmydata->duplicate_request->nb_entry);
+        }
 
+      if(pmydata->passcounter > nfs_param.worker_param.nb_before_gc)
+        {
           /* Performing garbabbge collection */
           LogFullDebug(COMPONENT_DISPATCH,
                        "Garbage collecting on pending request list");
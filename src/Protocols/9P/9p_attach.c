@@ -147,6 +147,10 @@ int _9p_attach( _9p_request_data_t * preq9p,
 #else
   memcpy( &pfid->fsal_op_context, &pwkrdata->thread_fsal_context, sizeof( fsal_op_context_t ) ) ;
 #endif
+#ifndef _USE_HPSS
+  /* The fid outlives the request, it does not hold the group list of the worker */
+  pfid->fsal_op_context.credential.grouplist = NULL ;
+#endif
 
   /* Is user name provided as a string or as an uid ? */
   if( *uname_len != 0 )
@@ -97,30 +97,13 @@ int nfs41_op_getdeviceinfo(struct nfs_argop4 *op,
   return res_GETDEVICEINFO4.gdir_status;
 #else
 
-  char *buffin = NULL;
-  unsigned int lenbuffin = 0;
-
-  char *buff = NULL;
-  unsigned int lenbuff = 0;
-
-  if((buff = Mem_Alloc(1024)) == NULL)
-    {
-      res_GETDEVICEINFO4.gdir_status = NFS4ERR_SERVERFAULT;
-      return res_GETDEVICEINFO4.gdir_status;
-    }
-
-  /** @todo handle multiple DS here when this will be implemented (switch on deviceid arg) */
   res_GETDEVICEINFO4.GETDEVICEINFO4res_u.gdir_resok4.gdir_notification.bitmap4_len = 0;
   res_GETDEVICEINFO4.GETDEVICEINFO4res_u.gdir_resok4.gdir_notification.bitmap4_val = NULL;
 
   res_GETDEVICEINFO4.GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_layout_type =
       LAYOUT4_NFSV4_1_FILES;
 
-  res_GETDEVICEINFO4.GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.
-      da_addr_body_len = 1024; /** @todo For wanting of something better */
-  res_GETDEVICEINFO4.GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.
-      da_addr_body_val = buff;
-
+  /* The pNFS service function encodes the device's address body */
   if( ( rc = pnfs_getdeviceinfo( &arg_GETDEVICEINFO4, data, &res_GETDEVICEINFO4 ) ) != NFS4_OK )
     {
        res_GETDEVICEINFO4.gdir_status = rc ; 
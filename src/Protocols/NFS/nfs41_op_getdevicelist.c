@@ -122,5 +122,11 @@ int nfs41_op_getdevicelist(struct nfs_argop4 *op,
  */
 void nfs41_op_getdevicelist_Free(GETDEVICELIST4res * resp)
 {
+  if(resp->gdlr_status == NFS4_OK)
+    if(resp->GETDEVICELIST4res_u.gdlr_resok4.gdlr_deviceid_list.
+       gdlr_deviceid_list_val != NULL)
+      Mem_Free(resp->GETDEVICELIST4res_u.gdlr_resok4.gdlr_deviceid_list.
+               gdlr_deviceid_list_val);
+
   return;
 }                               /* nfs41_op_exchange_id_Free */
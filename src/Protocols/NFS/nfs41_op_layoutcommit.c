@@ -88,8 +88,6 @@ int nfs41_op_layoutcommit(struct nfs_argop4 *op, compound_data_t * data,
                           struct nfs_resop4 *resp)
 {
 #ifdef _USE_PNFS
-  cache_inode_status_t cache_status;
-  fsal_attrib_list_t fsal_attr;
   nfsstat4 rc ; 
 #endif
 
@@ -140,19 +138,7 @@ int nfs41_op_layoutcommit(struct nfs_argop4 *op, compound_data_t * data,
       return res_LAYOUTCOMMIT4.locr_status;
     }
 
-  /* Update the mds */
-  if(cache_inode_truncate(data->current_entry,
-                          (fsal_size_t) arg_LAYOUTCOMMIT4.loca_length,
-                          &fsal_attr,
-                          data->ht,
-                          data->pclient,
-                          data->pcontext, &cache_status) != CACHE_INODE_SUCCESS)
-    {
-      res_LAYOUTCOMMIT4.locr_status = nfs4_Errno(cache_status);
-      return res_LAYOUTCOMMIT4.locr_status;
-    }
-
-  /* Call pNFS service function */
+  /* Call pNFS service function, it updates the size known to the mds */
   if( ( rc = pnfs_layoutcommit( &arg_LAYOUTCOMMIT4, data, &res_LAYOUTCOMMIT4 ) ) != NFS4_OK )
     {
       res_LAYOUTCOMMIT4.locr_status = rc ;
@@ -110,28 +110,9 @@ int nfs41_op_layoutget(struct nfs_argop4 *op, compound_data_t * data,
   res_LAYOUTGET4.logr_status = NFS4ERR_NOTSUPP;
   return res_LAYOUTGET4.logr_status;
 #else
-  char *buff = NULL;
-  unsigned int lenbuff = 0;
-
-  /* Lock are not supported */
-  resp->resop = NFS4_OP_LAYOUTGET;
-
-  if((buff = Mem_Alloc(1024)) == NULL)
-    {
-      res_LAYOUTGET4.logr_status = NFS4ERR_SERVERFAULT;
-      return res_LAYOUTGET4.logr_status;
-    }
-
-
   /* Lock are not supported */
   resp->resop = NFS4_OP_LAYOUTGET;
 
-  if((buff = Mem_Alloc(1024)) == NULL)
-    {
-      res_LAYOUTGET4.logr_status = NFS4ERR_SERVERFAULT;
-      return res_LAYOUTGET4.logr_status;
-    }
-
   /* If there is no FH */
   if(nfs4_Is_Fh_Empty(&(data->currentFH)))
     {
@@ -231,23 +212,6 @@ int nfs41_op_layoutget(struct nfs_argop4 *op, compound_data_t * data,
   //file_state->stateid_other, OTHERSIZE);
 
   /* Now the layout specific information */
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_len = 1;  /** @todo manages more than one segment */
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val =
-      (layout4 *) Mem_Alloc(sizeof(layout4));
-
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_offset =
-      arg_LAYOUTGET4.loga_offset;
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_length = 0xFFFFFFFFFFFFFFFFLL;   /* Whole file */
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_iomode =
-      arg_LAYOUTGET4.loga_iomode;
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_type = LAYOUT4_NFSV4_1_FILES;
-
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_body.loc_body_len = 1024 ;
-  res_LAYOUTGET4.LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_body.loc_body_val = buff;
-
   if( ( rc = pnfs_layoutget( &arg_LAYOUTGET4, data, &res_LAYOUTGET4 ) ) != NFS4_OK )
     {
        res_LAYOUTGET4.logr_status = rc ;
@@ -271,12 +235,18 @@ int nfs41_op_layoutget(struct nfs_argop4 *op, compound_data_t * data,
  */
 void nfs41_op_layoutget_Free(LAYOUTGET4res * resp)
 {
-  if(resp->logr_status == NFS4_OK)
+  unsigned int i;
+
+  if(resp->logr_status == NFS4_OK &&
+     resp->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val != NULL)
     {
-      if(resp->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_content.
-         loc_body.loc_body_val != NULL)
-        Mem_Free((char *)resp->LAYOUTGET4res_u.logr_resok4.logr_layout.
-                 logr_layout_val[0].lo_content.loc_body.loc_body_val);
+      for(i = 0; i < resp->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_len; i++)
+        if(resp->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[i].lo_content.
+           loc_body.loc_body_val != NULL)
+          Mem_Free((char *)resp->LAYOUTGET4res_u.logr_resok4.logr_layout.
+                   logr_layout_val[i].lo_content.loc_body.loc_body_val);
+
+      Mem_Free((char *)resp->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val);
     }
 
   return;
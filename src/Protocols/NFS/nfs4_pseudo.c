@@ -105,6 +105,162 @@ pseudofs_t *nfs4_GetPseudoFs(void)
   return &gPseudoFs;
 }                               /*  nfs4_GetExportList */
 
+/**
+ * nfs4_PseudoFS_AddExport: Adds the junction of an export to the pseudo fs
+ *
+ * The directories of the pseudo path that do not exist yet are created. A node is fully set before
+ * it is linked in the tree, so that lookups may walk it meanwhile.
+ *
+ * @param PseudoFs    [INOUT] the pseudo fs
+ * @param entry       [IN]    the export entry
+ * @param PathTok     [INOUT] parsing table of NB_TOK_PATH tokens
+ * @param ppjunction  [OUT]   the junction of the export, NULL if it has none
+ *
+ * @return 0 if successfull, ENOMEM if a node could not be allocated.
+ *
+ */
+
+static int nfs4_PseudoFS_AddExport(pseudofs_t * PseudoFs, exportlist_t * entry,
+                                   char **PathTok, pseudofs_entry_t ** ppjunction)
+{
+  int j = 0;
+  int found = 0;
+  char tmp_pseudopath[MAXPATHLEN];
+  int NbTokPath;
+  pseudofs_entry_t *PseudoFsCurrent = NULL;
+  pseudofs_entry_t *newPseudoFsEntry = NULL;
+  pseudofs_entry_t *iterPseudoFs = NULL;
+
+  *ppjunction = NULL;
+
+  /* To not forget to init "/" entry */
+  PseudoFsCurrent = &(PseudoFs->root);
+  PseudoFs->reverse_tab[0] = &(PseudoFs->root);
+
+  /* skip exports that aren't for NFS v4 */
+  if((entry->options & EXPORT_OPTION_NFSV4) == 0)
+    return 0;
+
+  if((entry->options & EXPORT_OPTION_PSEUDO) == 0)
+    return 0;
+
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: Id          = %d",
+               entry->id);
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: ANON        = %d",
+               entry->anonymous_uid);
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: Path        = %s",
+               entry->fullpath);
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: Options     = 0x%x",
+               entry->options);
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: Num Clients = %d",
+               entry->clients.num_clients);
+
+  /* A pseudo path is to ne managed */
+  LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+               "BUILDING PSEUDOFS: Now managing %s seen as %s",
+               entry->fullpath, entry->pseudopath);
+
+  /* Parsing the path */
+  strncpy(tmp_pseudopath, entry->pseudopath, MAXPATHLEN);
+  if((NbTokPath =
+      nfs_ParseConfLine(PathTok, NB_TOK_PATH, tmp_pseudopath, find_slash,
+                        find_endLine)) < 0)
+    {
+      /* Path is badly formed */
+      LogCrit(COMPONENT_NFS_V4_PSEUDO,
+              "BUILDING PSEUDOFS: Invalid 'pseudo' option: %s",
+              entry->pseudopath);
+      return 0;
+    }
+
+  /* there must be a leading '/' in the pseudo path */
+  if(entry->pseudopath[0] != '/')
+    {
+      /* Path is badly formed */
+      LogCrit(COMPONENT_NFS_V4_PSEUDO,
+              "Pseudo Path '%s' is badly formed",
+              entry->pseudopath);
+      return 0;
+    }
+
+  /* Loop on each token. Because first character in pseudo path is '/'
+   * we can avoid looking at PathTok[0] which is necessary '\0'. That's 
+   * the reason why we start looping at pos = 1 */
+  for(j = 1; j < NbTokPath; j++)
+    LogFullDebug(COMPONENT_NFS_V4, "     tokens are #%s#", PathTok[j]);
+
+  for(j = 1; j < NbTokPath; j++)
+    {
+      found = 0;
+      for(iterPseudoFs = PseudoFsCurrent->sons; iterPseudoFs != NULL;
+          iterPseudoFs = iterPseudoFs->next)
+        {
+          /* Looking for a matching entry */
+          if(!strcmp(iterPseudoFs->name, PathTok[j]))
+            {
+              found = 1;
+              break;
+            }
+        }               /* for iterPseudoFs */
+
+      if(found)
+        {
+          /* a matching entry was found in the tree */
+          PseudoFsCurrent = iterPseudoFs;
+          continue;
+        }
+
+      if(PseudoFs->last_pseudo_id + 1 >= MAX_PSEUDO_ENTRY)
+        {
+          LogCrit(COMPONENT_NFS_V4_PSEUDO,
+                  "BUILDING PSEUDOFS: more than %d entries, %s is not added",
+                  MAX_PSEUDO_ENTRY, entry->pseudopath);
+          return 0;
+        }
+
+      /* a new entry is to be created */
+      if((newPseudoFsEntry =
+          (pseudofs_entry_t *) Mem_Alloc(sizeof(pseudofs_entry_t))) == NULL)
+        return ENOMEM;
+
+      /* Creating the new entry, allocate an id for it and add it to reverse tab */
+      strncpy(newPseudoFsEntry->name, PathTok[j], MAXNAMLEN);
+      newPseudoFsEntry->pseudo_id = PseudoFs->last_pseudo_id + 1;
+      newPseudoFsEntry->junction_export = NULL;
+      newPseudoFsEntry->last = newPseudoFsEntry;
+      newPseudoFsEntry->next = NULL;
+      newPseudoFsEntry->sons = NULL;
+      newPseudoFsEntry->parent = PseudoFsCurrent;
+      snprintf(newPseudoFsEntry->fullname, MAXPATHLEN, "%s/%s",
+               PseudoFsCurrent->fullname, PathTok[j]);
+
+      PseudoFs->reverse_tab[newPseudoFsEntry->pseudo_id] = newPseudoFsEntry;
+      __sync_synchronize();
+      PseudoFs->last_pseudo_id = newPseudoFsEntry->pseudo_id;
+
+      /* Step into the new entry and attach it to the tree */
+      if(PseudoFsCurrent->sons == NULL)
+        PseudoFsCurrent->sons = newPseudoFsEntry;
+      else
+        {
+          PseudoFsCurrent->sons->last->next = newPseudoFsEntry;
+          PseudoFsCurrent->sons->last = newPseudoFsEntry;
+        }
+      PseudoFsCurrent = newPseudoFsEntry;
+    }                   /* for j */
+
+  /* Now that all entries are added to pseudofs tree, add the junction to the pseudofs */
+  PseudoFsCurrent->junction_export = entry;
+  *ppjunction = PseudoFsCurrent;
+
+  return 0;
+}                               /* nfs4_PseudoFS_AddExport */
+
 /**
  * nfs4_ExportToPseudoFS: Build a pseudo fs from an exportlist
  * 
@@ -117,20 +273,12 @@ pseudofs_t *nfs4_GetPseudoFs(void)
 int nfs4_ExportToPseudoFS(exportlist_t * pexportlist)
 {
   exportlist_t *entry;
-  exportlist_t *next;           /* exportlist entry   */
   int i = 0;
-  int j = 0;
-  int found = 0;
-  char tmp_pseudopath[MAXPATHLEN];
+  int rc = 0;
   char *PathTok[NB_TOK_PATH];
-  int NbTokPath;
   pseudofs_t *PseudoFs = NULL;
   pseudofs_entry_t *PseudoFsRoot = NULL;
-  pseudofs_entry_t *PseudoFsCurrent = NULL;
-  pseudofs_entry_t *newPseudoFsEntry = NULL;
-  pseudofs_entry_t *iterPseudoFs = NULL;
-
-  entry = pexportlist;
+  pseudofs_entry_t *junction = NULL;
 
   PseudoFs = &gPseudoFs;
 
@@ -149,144 +297,73 @@ int nfs4_ExportToPseudoFS(exportlist_t * pexportlist)
     if((PathTok[i] = (char *)Mem_Alloc(MAXNAMLEN)) == NULL)
       return ENOMEM;
 
-  while(entry)
-    {
-      /* To not forget to init "/" entry */
-      PseudoFsCurrent = &(PseudoFs->root);
-      PseudoFs->reverse_tab[0] = &(PseudoFs->root);
-
-      /* skip exports that aren't for NFS v4 */
-      if((entry->options & EXPORT_OPTION_NFSV4) == 0)
-        {
-          next = entry->next;
-          entry = next;
-          continue;
-        }
+  for(entry = pexportlist; entry != NULL; entry = entry->next)
+    if((rc = nfs4_PseudoFS_AddExport(PseudoFs, entry, PathTok, &junction)) != 0)
+      break;
 
-      if(entry->options & EXPORT_OPTION_PSEUDO)
-        {
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: Id          = %d",
-                       entry->id);
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: ANON        = %d",
-                       entry->anonymous_uid);
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: Path        = %s",
-                       entry->fullpath);
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: Options     = 0x%x",
-                       entry->options);
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: Num Clients = %d",
-                       entry->clients.num_clients);
-
-          /* A pseudo path is to ne managed */
-          LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
-                       "BUILDING PSEUDOFS: Now managing %s seen as %s",
-                       entry->fullpath, entry->pseudopath);
-
-          /* Parsing the path */
-          strncpy(tmp_pseudopath, entry->pseudopath, MAXPATHLEN);
-          if((NbTokPath =
-              nfs_ParseConfLine(PathTok, NB_TOK_PATH, tmp_pseudopath, find_slash,
-                                find_endLine)) < 0)
-            {
-              /* Path is badly formed */
-              LogCrit(COMPONENT_NFS_V4_PSEUDO,
-                      "BUILDING PSEUDOFS: Invalid 'pseudo' option: %s",
-                      entry->pseudopath);
-              next = entry->next;
-              entry = next;
-              continue;
-            }
+  /* desalocation of the parsing table */
+  for(i = 0; i < NB_TOK_PATH; i++)
+    Mem_Free(PathTok[i]);
 
-          /* there must be a leading '/' in the pseudo path */
-          if(entry->pseudopath[0] != '/')
-            {
-              /* Path is badly formed */
-              LogCrit(COMPONENT_NFS_V4_PSEUDO,
-                      "Pseudo Path '%s' is badly formed",
-                      entry->pseudopath);
-              next = entry->next;
-              entry = next;
-              continue;
-            }
+  return rc;
+}                               /* nfs4_ExportToPseudoFS */
 
-          /* Loop on each token. Because first character in pseudo path is '/'
-           * we can avoid looking at PathTok[0] which is necessary '\0'. That's 
-           * the reason why we start looping at pos = 1 */
-          for(j = 1; j < NbTokPath; j++)
-            LogFullDebug(COMPONENT_NFS_V4, "     tokens are #%s#", PathTok[j]);
+/**
+ * nfs4_PseudoFS_Reload: Updates the pseudo fs for a reloaded exportlist
+ *
+ * The pseudo fs is patched in place while requests use it: the nodes of the new pseudo paths are added,
+ * the junctions are pointed to the new entries and the junctions of the removed exports are cleared.
+ * Nodes are never removed, a path without junction is an empty directory.
+ *
+ * @param pexportlist [IN] the new export list
+ *
+ * @return 0 if successfull, ENOMEM otherwise.
+ *
+ */
 
-          for(j = 1; j < NbTokPath; j++)
-            {
-              found = 0;
-              for(iterPseudoFs = PseudoFsCurrent->sons; iterPseudoFs != NULL;
-                  iterPseudoFs = iterPseudoFs->next)
-                {
-                  /* Looking for a matching entry */
-                  if(!strcmp(iterPseudoFs->name, PathTok[j]))
-                    {
-                      found = 1;
-                      break;
-                    }
-                }               /* for iterPseudoFs */
-
-              if(found)
-                {
-                  /* a matching entry was found in the tree */
-                  PseudoFsCurrent = iterPseudoFs;
-                }
-              else
-                {
-                  /* a new entry is to be created */
-                  if((newPseudoFsEntry =
-                      (pseudofs_entry_t *) Mem_Alloc(sizeof(pseudofs_entry_t))) == NULL)
-                    return ENOMEM;
-
-                  /* Creating the new entry, allocate an id for it and add it to reverse tab */
-                  strncpy(newPseudoFsEntry->name, PathTok[j], MAXNAMLEN);
-                  newPseudoFsEntry->pseudo_id = PseudoFs->last_pseudo_id + 1;
-                  PseudoFs->last_pseudo_id = newPseudoFsEntry->pseudo_id;
-                  PseudoFs->reverse_tab[PseudoFs->last_pseudo_id] = newPseudoFsEntry;
-                  newPseudoFsEntry->junction_export = NULL;
-                  newPseudoFsEntry->last = newPseudoFsEntry;
-                  newPseudoFsEntry->next = NULL;
-                  newPseudoFsEntry->sons = NULL;
-                  snprintf(newPseudoFsEntry->fullname, MAXPATHLEN, "%s/%s",
-                           PseudoFsCurrent->fullname, PathTok[j]);
-
-                  /* Step into the new entry and attach it to the tree */
-                  if(PseudoFsCurrent->sons == NULL)
-                    PseudoFsCurrent->sons = newPseudoFsEntry;
-                  else
-                    {
-                      PseudoFsCurrent->sons->last->next = newPseudoFsEntry;
-                      PseudoFsCurrent->sons->last = newPseudoFsEntry;
-                    }
-                  newPseudoFsEntry->parent = PseudoFsCurrent;
-                  PseudoFsCurrent = newPseudoFsEntry;
-                }
+int nfs4_PseudoFS_Reload(exportlist_t * pexportlist)
+{
+  exportlist_t *entry;
+  int i = 0;
+  int rc = 0;
+  char *PathTok[NB_TOK_PATH];
+  bool_t reassigned[MAX_PSEUDO_ENTRY];
+  pseudofs_t *PseudoFs = &gPseudoFs;
+  pseudofs_entry_t *junction = NULL;
 
-            }                   /* for j */
+  memset(reassigned, 0, sizeof(reassigned));
 
-          /* Now that all entries are added to pseudofs tree, add the junction to the pseudofs */
-          PseudoFsCurrent->junction_export = entry;
+  for(i = 0; i < NB_TOK_PATH; i++)
+    if((PathTok[i] = (char *)Mem_Alloc(MAXNAMLEN)) == NULL)
+      return ENOMEM;
 
-        }
-      /* if( entry->options & EXPORT_OPTION_PSEUDO ) */
-      next = entry->next;
+  for(entry = pexportlist; entry != NULL; entry = entry->next)
+    {
+      if((rc = nfs4_PseudoFS_AddExport(PseudoFs, entry, PathTok, &junction)) != 0)
+        break;
 
-      entry = next;
-    }                           /* while( entry ) */
+      if(junction != NULL)
+        reassigned[junction->pseudo_id] = TRUE;
+    }
 
-  /* desalocation of the parsing table */
   for(i = 0; i < NB_TOK_PATH; i++)
     Mem_Free(PathTok[i]);
 
-  return (0);
-}
+  if(rc != 0)
+    return rc;
+
+  /* The other junctions lead to exports that are gone */
+  for(i = 0; i <= (int)PseudoFs->last_pseudo_id && i < MAX_PSEUDO_ENTRY; i++)
+    if(!reassigned[i] && PseudoFs->reverse_tab[i]->junction_export != NULL)
+      {
+        LogFullDebug(COMPONENT_NFS_V4_PSEUDO,
+                     "RELOADING PSEUDOFS: %s is no longer a junction",
+                     PseudoFs->reverse_tab[i]->fullname);
+        PseudoFs->reverse_tab[i]->junction_export = NULL;
+      }
+
+  return 0;
+}                               /* nfs4_PseudoFS_Reload */
 
 /**
  * nfs4_PseudoToFattr: Gets the attributes for an entry in the pseudofs
@@ -1496,6 +1573,7 @@ int nfs4_op_lookup_pseudo(struct nfs_argop4 *op,
   char __attribute__ ((__unused__)) funcname[] = "nfs4_op_lookup_pseudo";
   pseudofs_entry_t psfsentry;
   pseudofs_entry_t *iter = NULL;
+  exportlist_t *pjunction = NULL;
   int found = FALSE;
   int pseudo_is_slash = FALSE ;
   int error = 0;
@@ -1552,8 +1630,17 @@ int nfs4_op_lookup_pseudo(struct nfs_argop4 *op,
       return res_LOOKUP4.status;
     }
 
-  /* A matching entry was found */
-  if(iter->junction_export == NULL)
+  /* A matching entry was found, an export reload may change its junction */
+  pjunction = iter->junction_export;
+
+  if(pjunction != NULL && pjunction->status != EXPORTLIST_OK)
+    {
+      /* The export is being removed */
+      res_LOOKUP4.status = NFS4ERR_NOENT;
+      return res_LOOKUP4.status;
+    }
+
+  if(pjunction == NULL)
     {
       /* The entry is not a junction, we stay within the pseudo fs */
       if(!nfs4_PseudoToFhandle(&(data->currentFH), iter))
@@ -1566,14 +1653,14 @@ int nfs4_op_lookup_pseudo(struct nfs_argop4 *op,
     {
 #ifdef _USE_SHARED_FSAL 
       /* Set the FSAL ID here */
-      FSAL_SetId( iter->junction_export->fsalid ) ;
+      FSAL_SetId( pjunction->fsalid ) ;
 #endif
 
       /* The entry is a junction */
       LogFullDebug(COMPONENT_NFS_V4_PSEUDO,      
                    "A junction in pseudo fs is traversed: name = %s, id = %d",
-                   iter->name, iter->junction_export->id);
-      data->pexport = iter->junction_export;
+                   iter->name, pjunction->id);
+      data->pexport = pjunction;
       strncpy(data->MntPath, iter->fullname, NFS_MAXPATHLEN);
 
       /* Build credentials */
@@ -102,6 +102,9 @@ int nlm4_Granted_Res(nfs_arg_t * parg /* IN     */ ,
 
   V(cookie_entry->sce_pentry->object.file.lock_list_mutex);
 
+  /* The client answered, release its slot in the callback window */
+  nlm_signal_async_resp(cookie_entry);
+
   if(arg->stat.stat != NLM4_GRANTED)
     {
       LogMajor(COMPONENT_NLM,
@@ -118,7 +121,6 @@ int nlm4_Granted_Res(nfs_arg_t * parg /* IN     */ ,
   else
     {
       state_complete_grant(pcontext, cookie_entry, pclient);
-      nlm_signal_async_resp(cookie_entry);
     }
 
   return NFS_REQ_OK;
@@ -30,6 +30,7 @@
 #endif
 
 #include <stdio.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "stuff_alloc.h"
@@ -38,14 +39,62 @@
 #include "nlm_util.h"
 #include "nlm_async.h"
 #include "nfs_tcb.h"
+#include "nfs_core.h"
 
-static pthread_t               nlm_async_thread_id;
-static struct glist_head       nlm_async_queue;
-pthread_mutex_t                nlm_async_resp_mutex  = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t                 nlm_async_resp_cond   = PTHREAD_COND_INITIALIZER;
+/* Time we wait for a GRANTED_RES before giving up on it */
+#define NLM_ASYNC_RESP_TIMEOUT 5
+
+/*
+ * A GRANTED_MSG that has been sent and whose GRANTED_RES has not yet been
+ * seen. It occupies one slot of the client's pipelining window.
+ */
+typedef struct nlm_async_pending_t
+{
+  struct glist_head    nap_glist;
+  void               * nap_key;
+  state_nlm_client_t * nap_host;
+  time_t               nap_sent;
+} nlm_async_pending_t;
+
+/*
+ * One asynchronous callback sender. Every client is bound to a single
+ * sender (see nlm_async_sender_of), so the callbacks to a given client are
+ * sent in order and its callback CLIENT handle is only ever used by one
+ * thread, while different clients are served in parallel.
+ */
+typedef struct nlm_async_sender_t
+{
+  unsigned int           nas_index;
+  pthread_t              nas_thread_id;
+  nfs_tcb_t              nas_tcb;
+  struct glist_head      nas_queue;     /* work waiting to be sent, FIFO */
+  struct glist_head      nas_pending;   /* GRANTED_MSG waiting for GRANTED_RES */
+  cache_inode_client_t   nas_cache_inode_client;
+} nlm_async_sender_t;
+
+static nlm_async_sender_t    * nlm_async_senders;
+static unsigned int            nlm_async_nb_senders;
 cache_inode_client_parameter_t nlm_async_cache_inode_client_param;
-cache_inode_client_t           nlm_async_cache_inode_client;
-extern nfs_tcb_t               nlmtcb;
+
+static nlm_async_sender_t *nlm_async_sender_of(state_nlm_client_t * host)
+{
+  return &nlm_async_senders[((unsigned long) host >> 4) % nlm_async_nb_senders];
+}
+
+/* Queue work on the sender that owns the client */
+static int nlm_async_enqueue(nlm_async_queue_t *arg)
+{
+  nlm_async_sender_t *sender = nlm_async_sender_of(arg->nlm_async_host);
+  int                 rc;
+
+  P(sender->nas_tcb.tcb_mutex);
+  rc = pthread_cond_signal(&sender->nas_tcb.tcb_condvar);
+  if(rc != -1)
+    glist_add_tail(&sender->nas_queue, &arg->nlm_async_glist);
+  V(sender->nas_tcb.tcb_mutex);
+
+  return rc;
+}
 
 int nlm_send_async_res_nlm4(state_nlm_client_t * host,
                             nlm_callback_func    func,
@@ -73,18 +122,14 @@ int nlm_send_async_res_nlm4(state_nlm_client_t * host,
       return NFS_REQ_DROP;
    }
 
-  P(nlmtcb.tcb_mutex);
-  glist_add_tail(&nlm_async_queue, &arg->nlm_async_glist);
-  if(pthread_cond_signal(&nlmtcb.tcb_condvar) == -1)
+  if(nlm_async_enqueue(arg) == -1)
     {
       LogFullDebug(COMPONENT_NLM,
                    "Unable to signal nlm_asyn_thread");
-      glist_del(&arg->nlm_async_glist);
       netobj_free(&arg->nlm_async_args.nlm_async_res.res_nlm4.cookie);
       Mem_Free(arg);
       arg = NULL;
     }
-  V(nlmtcb.tcb_mutex);
 
   return arg != NULL ? NFS_REQ_OK : NFS_REQ_DROP;
 }
@@ -127,37 +172,166 @@ int nlm_send_async_res_nlm4test(state_nlm_client_t * host,
       return NFS_REQ_DROP;
    }
 
-  P(nlmtcb.tcb_mutex);
-  glist_add_tail(&nlm_async_queue, &arg->nlm_async_glist);
-  if(pthread_cond_signal(&nlmtcb.tcb_condvar) == -1)
+  if(nlm_async_enqueue(arg) == -1)
     {
       LogFullDebug(COMPONENT_NLM,
                    "Unable to signal nlm_asyn_thread");
-      glist_del(&arg->nlm_async_glist);
       netobj_free(&arg->nlm_async_args.nlm_async_res.res_nlm4test.cookie);
       if(pres->res_nlm4test.test_stat.stat == NLM4_DENIED)
         netobj_free(&arg->nlm_async_args.nlm_async_res.res_nlm4test.test_stat.nlm4_testrply_u.holder.oh);
       Mem_Free(arg);
       arg = NULL;
     }
-  V(nlmtcb.tcb_mutex);
 
   return arg != NULL ? NFS_REQ_OK : NFS_REQ_DROP;
 }
 
-/* Execute a func from the async queue */
+/* Number of GRANTED_MSG to host still waiting for their GRANTED_RES.
+ * Called with the sender's tcb_mutex held.
+ */
+static unsigned int nlm_async_outstanding(nlm_async_sender_t * sender,
+                                          state_nlm_client_t * host)
+{
+  struct glist_head   * glist;
+  nlm_async_pending_t * pending;
+  unsigned int          count = 0;
+
+  glist_for_each(glist, &sender->nas_pending)
+    {
+      pending = glist_entry(glist, nlm_async_pending_t, nap_glist);
+      if(pending->nap_host == host)
+        count++;
+    }
+
+  return count;
+}
+
+/* Forget about GRANTED_RES that never came, freeing their window slots.
+ * Called with the sender's tcb_mutex held, the released pending entries
+ * are moved to expired so the client references are dropped unlocked.
+ * Returns the time at which the oldest remaining entry expires (0 if none).
+ */
+static time_t nlm_async_expire_pending(nlm_async_sender_t * sender,
+                                       struct glist_head  * expired)
+{
+  struct glist_head   * glist, * glistn;
+  nlm_async_pending_t * pending;
+  time_t                now = time(NULL);
+
+  glist_for_each_safe(glist, glistn, &sender->nas_pending)
+    {
+      pending = glist_entry(glist, nlm_async_pending_t, nap_glist);
+
+      /* entries are in send order, the first one alive is the oldest */
+      if(pending->nap_sent + NLM_ASYNC_RESP_TIMEOUT > now)
+        return pending->nap_sent + NLM_ASYNC_RESP_TIMEOUT;
+
+      LogFullDebug(COMPONENT_NLM,
+                   "No response for key %p, releasing its slot",
+                   pending->nap_key);
+      glist_del(&pending->nap_glist);
+      glist_add_tail(expired, &pending->nap_glist);
+    }
+
+  return 0;
+}
+
+static void nlm_async_free_pending(struct glist_head * list)
+{
+  struct glist_head   * glist, * glistn;
+  nlm_async_pending_t * pending;
+
+  glist_for_each_safe(glist, glistn, list)
+    {
+      pending = glist_entry(glist, nlm_async_pending_t, nap_glist);
+      glist_del(&pending->nap_glist);
+      dec_nlm_client_ref(pending->nap_host);
+      Mem_Free(pending);
+    }
+}
+
+/* TRUE if an item queued ahead of entry, for the same client, is held
+ * back. Collected items have already left the queue, so whatever is ahead
+ * of entry is held back. Called with the sender's tcb_mutex held.
+ */
+static int nlm_async_held_back(nlm_async_sender_t * sender,
+                               nlm_async_queue_t  * entry)
+{
+  struct glist_head * glist;
+  nlm_async_queue_t * ahead;
+
+  glist_for_each(glist, &sender->nas_queue)
+    {
+      ahead = glist_entry(glist, nlm_async_queue_t, nlm_async_glist);
+      if(ahead == entry)
+        return FALSE;
+      if(ahead->nlm_async_host == entry->nlm_async_host)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Move to batch every queued item whose client still has room in its
+ * window. Once an item of a client whose window is full stays queued,
+ * all the items of that client behind it stay queued too, in order.
+ * Called with the sender's tcb_mutex held.
+ */
+static void nlm_async_collect(nlm_async_sender_t * sender,
+                              struct glist_head  * batch)
+{
+  struct glist_head   * glist, * glistn;
+  nlm_async_queue_t   * entry;
+  nlm_async_pending_t * pending;
+  unsigned int          window = nfs_param.core_param.nlm_grant_window;
+
+  glist_for_each_safe(glist, glistn, &sender->nas_queue)
+    {
+      entry = glist_entry(glist, nlm_async_queue_t, nlm_async_glist);
+
+      if(nlm_async_held_back(sender, entry))
+        continue;
+
+      if(entry->nlm_async_key != NULL)
+        {
+          if(nlm_async_outstanding(sender, entry->nlm_async_host) >= window)
+            continue;
+
+          /* Take the window slot now, the response may race the send */
+          pending = (nlm_async_pending_t *) Mem_Alloc(sizeof(*pending));
+          if(pending == NULL)
+            continue;
+
+          pending->nap_key  = entry->nlm_async_key;
+          pending->nap_host = entry->nlm_async_host;
+          pending->nap_sent = time(NULL);
+          inc_nlm_client_ref(pending->nap_host);
+          glist_add_tail(&sender->nas_pending, &pending->nap_glist);
+        }
+
+      glist_del(glist);
+      glist_add_tail(batch, glist);
+    }
+}
+
+/* Execute funcs from a sender's async queue */
 void *nlm_async_thread(void *argp)
 {
 #ifndef _NO_BUDDY_SYSTEM
   int rc;
 #endif
+  nlm_async_sender_t *sender = (nlm_async_sender_t *) argp;
   nlm_async_queue_t *entry;
   struct timeval now;
   struct timespec timeout;
   struct glist_head nlm_async_tmp_queue;
+  struct glist_head expired;
   struct glist_head *glist, *glistn;
+  time_t next_expiry;
+  char thr_name[128];
 
-  SetNameFunction("nlm_async_thread");
+  snprintf(thr_name, sizeof(thr_name), "nlm_async_thread #%u", sender->nas_index);
+  SetNameFunction(thr_name);
 
 #ifndef _NO_BUDDY_SYSTEM
   if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
@@ -169,10 +343,10 @@ void *nlm_async_thread(void *argp)
   LogInfo(COMPONENT_NLM,
           "NLM async thread: Memory manager successfully initialized");
 #endif
-  if(mark_thread_existing(&nlmtcb) == PAUSE_EXIT)
+  if(mark_thread_existing(&sender->nas_tcb) == PAUSE_EXIT)
     {
       /* Oops, that didn't last long... exit. */
-      mark_thread_done(&nlmtcb);
+      mark_thread_done(&sender->nas_tcb);
       LogDebug(COMPONENT_NLM,
                "NLM async thread: exiting before initialization");
       return NULL;
@@ -183,83 +357,74 @@ void *nlm_async_thread(void *argp)
 
   while(1)
     {
-      /* Check without tcb lock*/
-      if((nlmtcb.tcb_state != STATE_AWAKE) || glist_empty(&nlm_async_queue))
+      init_glist(&nlm_async_tmp_queue);
+      init_glist(&expired);
+
+      P(sender->nas_tcb.tcb_mutex);
+
+      while(1)
         {
-          while(1)
+          next_expiry = nlm_async_expire_pending(sender, &expired);
+
+          /* Collect all the work items that can be sent now and add them
+           * to the temp list. Later we iterate over tmp list without
+           * holding the tcb_mutex.
+           */
+          if(sender->nas_tcb.tcb_state == STATE_AWAKE)
             {
-              P(nlmtcb.tcb_mutex);
-              if((nlmtcb.tcb_state == STATE_AWAKE) &&
-                  !glist_empty(&nlm_async_queue))
-                {
-                  V(nlmtcb.tcb_mutex);
-                  break;
-                }
-              switch(thread_sm_locked(&nlmtcb))
-                {
-                  case THREAD_SM_RECHECK:
-                    V(nlmtcb.tcb_mutex);
-                    continue;
-
-                  case THREAD_SM_BREAK:
-                    if(glist_empty(&nlm_async_queue))
-                      {
-                        gettimeofday(&now, NULL);
-                        timeout.tv_sec = 10 + now.tv_sec;
-                        timeout.tv_nsec = 0;
-                        pthread_cond_timedwait(&nlmtcb.tcb_condvar,
-                                               &nlmtcb.tcb_mutex,
-                                               &timeout);
-                      }
-                    V(nlmtcb.tcb_mutex);
-                    continue;
-
-                  case THREAD_SM_EXIT:
-                    V(nlmtcb.tcb_mutex);
-                    return NULL;
-                }
+              nlm_async_collect(sender, &nlm_async_tmp_queue);
+              if(!glist_empty(&nlm_async_tmp_queue))
+                break;
+            }
+
+          switch(thread_sm_locked(&sender->nas_tcb))
+            {
+              case THREAD_SM_RECHECK:
+                continue;
+
+              case THREAD_SM_BREAK:
+                /* Nothing we may send, sleep until new work, a response
+                 * that frees a window slot, or the oldest slot expires.
+                 */
+                gettimeofday(&now, NULL);
+                timeout.tv_sec = 10 + now.tv_sec;
+                if(next_expiry != 0 && next_expiry < timeout.tv_sec)
+                  timeout.tv_sec = next_expiry;
+                timeout.tv_nsec = 0;
+                pthread_cond_timedwait(&sender->nas_tcb.tcb_condvar,
+                                       &sender->nas_tcb.tcb_mutex,
+                                       &timeout);
+                continue;
+
+              case THREAD_SM_EXIT:
+                V(sender->nas_tcb.tcb_mutex);
+                nlm_async_free_pending(&expired);
+                return NULL;
             }
         }
 
-      P(nlmtcb.tcb_mutex);
-      init_glist(&nlm_async_tmp_queue);
-      /* Collect all the work items and add it to the temp
-       * list. Later we iterate over tmp list without holding
-       * the nlmtcb.tcb_mutex.
-       */
-      glist_for_each_safe(glist, glistn, &nlm_async_queue)
-      {
-        entry = glist_entry(glist, nlm_async_queue_t, nlm_async_glist);
-        glist_del(glist);
-        glist_add(&nlm_async_tmp_queue, glist);
+      V(sender->nas_tcb.tcb_mutex);
 
-      }
-      V(nlmtcb.tcb_mutex);
+      nlm_async_free_pending(&expired);
+
+      /* Send the whole batch back to back, responses are matched later */
       glist_for_each_safe(glist, glistn, &nlm_async_tmp_queue)
       {
         entry = glist_entry(glist, nlm_async_queue_t, nlm_async_glist);
         glist_del(&entry->nlm_async_glist);
+        entry->nlm_async_pclient = &sender->nas_cache_inode_client;
         entry->nlm_async_func(entry);
       }
     }
-  tcb_remove(&nlmtcb);
+  tcb_remove(&sender->nas_tcb);
 }
 
 /* Insert 'func' to async queue */
 int nlm_async_callback(nlm_async_queue_t *arg)
 {
-  int rc;
-
   LogFullDebug(COMPONENT_NLM, "Callback %p", arg);
 
-  P(nlmtcb.tcb_mutex);
-  glist_add_tail(&nlm_async_queue, &arg->nlm_async_glist);
-  rc = pthread_cond_signal(&nlmtcb.tcb_condvar);
-  if(rc == -1)
-    glist_del(&arg->nlm_async_glist);
-  V(nlmtcb.tcb_mutex);
-
-  return rc;
+  return nlm_async_enqueue(arg);
 }
 
 static int local_lru_inode_entry_to_str(LRU_data_t data, char *str)
@@ -272,9 +437,41 @@ static int local_lru_inode_clean_entry(LRU_entry_t * entry, void *adddata)
   return 0;
 }                               /* lru_clean_entry */
 
+/* Allocate the senders and register their control blocks */
+int nlm_async_tcb_init()
+{
+  unsigned int i;
+  char         name[256];
+
+  nlm_async_nb_senders = nfs_param.core_param.nb_nlm_async_thread;
+  if(nlm_async_nb_senders == 0)
+    nlm_async_nb_senders = 1;
+
+  if(nfs_param.core_param.nlm_grant_window == 0)
+    nfs_param.core_param.nlm_grant_window = 1;
+
+  nlm_async_senders = (nlm_async_sender_t *)
+      Mem_Calloc_Label(nlm_async_nb_senders, sizeof(nlm_async_sender_t),
+                       "nlm_async_sender_t");
+  if(nlm_async_senders == NULL)
+    return -1;
+
+  for(i = 0; i < nlm_async_nb_senders; i++)
+    {
+      nlm_async_senders[i].nas_index = i;
+      init_glist(&nlm_async_senders[i].nas_queue);
+      init_glist(&nlm_async_senders[i].nas_pending);
+      snprintf(name, sizeof(name), "NLM async thread #%u", i);
+      if(tcb_new(&nlm_async_senders[i].nas_tcb, name) != 0)
+        return -1;
+    }
+
+  return 0;
+}
+
 int nlm_async_callback_init()
 {
-  init_glist(&nlm_async_queue);
+  unsigned int i;
 
   /* setting the 'nlm_async_cache_inode_client_param' structure */
   nlm_async_cache_inode_client_param.lru_param.nb_entry_prealloc = 10;
@@ -295,16 +492,28 @@ int nlm_async_callback_init()
   nlm_async_cache_inode_client_param.use_test_access = 1;
   nlm_async_cache_inode_client_param.attrmask = 0;
 
-  if(cache_inode_client_init(&nlm_async_cache_inode_client,
-                             nlm_async_cache_inode_client_param,
-                             NLM_THREAD_INDEX, NULL))
+  for(i = 0; i < nlm_async_nb_senders; i++)
     {
-      LogCrit(COMPONENT_NLM,
-              "Could not initialize cache inode client for NLM Async Thread");
-      return -1;
+      if(cache_inode_client_init(&nlm_async_senders[i].nas_cache_inode_client,
+                                 nlm_async_cache_inode_client_param,
+                                 NLM_THREAD_INDEX + i, NULL))
+        {
+          LogCrit(COMPONENT_NLM,
+                  "Could not initialize cache inode client for NLM Async Thread #%u",
+                  i);
+          return -1;
+        }
+
+      if(pthread_create(&nlm_async_senders[i].nas_thread_id, NULL,
+                        nlm_async_thread, &nlm_async_senders[i]) != 0)
+        return -1;
     }
-  
-  return pthread_create(&nlm_async_thread_id, NULL, nlm_async_thread, NULL);
+
+  LogEvent(COMPONENT_NLM,
+           "%u NLM async threads were started successfully",
+           nlm_async_nb_senders);
+
+  return 0;
 }
 
 nlm_reply_proc_t nlm_reply_proc[] = {
@@ -336,9 +545,9 @@ nlm_reply_proc_t nlm_reply_proc[] = {
   ,
 };
 
-static void *resp_key;
-
-/* Client routine  to send the asynchrnous response, key is used to wait for a response */
+/* Client routine  to send the asynchrnous response, key is used to match a
+ * response (it holds a slot in the client's window until the response).
+ */
 int nlm_send_async(int                  proc,
                    state_nlm_client_t * host,
                    void               * inarg,
@@ -347,8 +556,6 @@ int nlm_send_async(int                  proc,
   struct timeval tout = { 0, 10 };
   xdrproc_t inproc = NULL, outproc = NULL;
   int retval;
-  struct timeval start, now;
-  struct timespec timeout;
 
   if(host->slc_callback_clnt == NULL)
     {
@@ -367,6 +574,8 @@ int nlm_send_async(int                  proc,
                    "Cannot create NLM async %s connection to client %s",
                    xprt_type_to_str(host->slc_client_type),
                    host->slc_nsm_client->ssc_nlm_caller_name);
+          if(key != NULL)
+            nlm_signal_async_resp(key);
           return -1;
         }
     }
@@ -374,10 +583,6 @@ int nlm_send_async(int                  proc,
   inproc = nlm_reply_proc[proc].inproc;
   outproc = nlm_reply_proc[proc].outproc;
 
-  pthread_mutex_lock(&nlm_async_resp_mutex);
-  resp_key = key;
-  pthread_mutex_unlock(&nlm_async_resp_mutex);
-
   LogFullDebug(COMPONENT_NLM, "About to make clnt_call");
   retval = clnt_call(host->slc_callback_clnt, proc, inproc, inarg, outproc, NULL, tout);
   LogFullDebug(COMPONENT_NLM, "Done with clnt_call");
@@ -389,50 +594,55 @@ int nlm_send_async(int                  proc,
       LogMajor(COMPONENT_NLM,
                "%s: NLM async Client procedure call %d failed with return code %d",
                __func__, proc, retval);
-      pthread_mutex_lock(&nlm_async_resp_mutex);
-      resp_key = NULL;
-      pthread_mutex_unlock(&nlm_async_resp_mutex);
+      /* No response will ever come, release the window slot */
+      if(key != NULL)
+        nlm_signal_async_resp(key);
     }
 
-  pthread_mutex_lock(&nlm_async_resp_mutex);
-  if(resp_key != NULL)
-    {
-      /* Wait for 5 seconds or a signal */
-      gettimeofday(&start, NULL);
-      gettimeofday(&now, NULL);
-      timeout.tv_sec = 5 + start.tv_sec;
-      timeout.tv_nsec = 0;
-      LogFullDebug(COMPONENT_NLM,
-                   "About to wait for signal for key %p",
-                   resp_key);
-      while(resp_key != NULL && now.tv_sec < (start.tv_sec + 5))
-        {
-          int rc = pthread_cond_timedwait(&nlm_async_resp_cond, &nlm_async_resp_mutex, &timeout);
-          LogFullDebug(COMPONENT_NLM,
-                       "pthread_cond_timedwait returned %d", rc);
-          gettimeofday(&now, NULL);
-        }
-      LogFullDebug(COMPONENT_NLM, "Done waiting");
-    }
-  pthread_mutex_unlock(&nlm_async_resp_mutex);
-
   return retval;
 }
 
 void nlm_signal_async_resp(void *key)
 {
-  pthread_mutex_lock(&nlm_async_resp_mutex);
-  if(resp_key == key)
+  unsigned int          i;
+  struct glist_head   * glist;
+  nlm_async_pending_t * pending = NULL;
+  nlm_async_sender_t  * sender;
+
+  for(i = 0; i < nlm_async_nb_senders && pending == NULL; i++)
+    {
+      sender = &nlm_async_senders[i];
+
+      P(sender->nas_tcb.tcb_mutex);
+      glist_for_each(glist, &sender->nas_pending)
+        {
+          pending = glist_entry(glist, nlm_async_pending_t, nap_glist);
+          if(pending->nap_key == key)
+            break;
+          pending = NULL;
+        }
+
+      if(pending != NULL)
+        {
+          /* A window slot is free, the sender may have work waiting for it */
+          glist_del(&pending->nap_glist);
+          pthread_cond_signal(&sender->nas_tcb.tcb_condvar);
+        }
+      V(sender->nas_tcb.tcb_mutex);
+    }
+
+  if(pending != NULL)
     {
-      resp_key = NULL;
-      pthread_cond_signal(&nlm_async_resp_cond);
       LogFullDebug(COMPONENT_NLM,
-                   "Signaled condition variable");
+                   "Released window slot for key %p",
+                   key);
+      dec_nlm_client_ref(pending->nap_host);
+      Mem_Free(pending);
     }
   else
     {
       LogFullDebug(COMPONENT_NLM,
-                   "Didn't signal condition variable");
+                   "No pending response for key %p",
+                   key);
     }
-  pthread_mutex_unlock(&nlm_async_resp_mutex);
 }
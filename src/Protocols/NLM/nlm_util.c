@@ -43,7 +43,6 @@
 #include "nfs_core.h"
 #include "nfs_tcb.h"
 
-nfs_tcb_t  nlmtcb;
 /* nlm grace time tracking */
 static struct timeval nlm_grace_tv;
 #define NLM4_GRACE_PERIOD 10
@@ -191,7 +190,10 @@ void nlm_init(void)
   granted_cookie.gc_seconds      = (unsigned long) nlm_grace_tv.tv_sec;
   granted_cookie.gc_microseconds = (unsigned long) nlm_grace_tv.tv_usec;
   granted_cookie.gc_cookie       = 0;
-  tcb_new(&nlmtcb, "NLM async thread");
+
+  if(nlm_async_tcb_init() != 0)
+    LogFatal(COMPONENT_INIT,
+             "Could not allocate NLM async threads");
 }
 
 void nlm_startup(void)
@@ -224,12 +226,13 @@ static void nlm4_send_grant_msg(nlm_async_queue_t *arg)
   state_status_t         state_status = STATE_SUCCESS;
   state_cookie_entry_t * cookie_entry;
   fsal_op_context_t      context, * pcontext = &context;
+  cache_inode_client_t * pclient = arg->nlm_async_pclient;
+
+  netobj_to_string(&arg->nlm_async_args.nlm_async_grant.cookie,
+                   buffer, sizeof(buffer));
 
   if(isDebug(COMPONENT_NLM))
     {
-      netobj_to_string(&arg->nlm_async_args.nlm_async_grant.cookie,
-                       buffer, sizeof(buffer));
-
       LogDebug(COMPONENT_NLM,
                "Sending GRANTED for arg=%p svid=%d start=%llx len=%llx cookie=%s",
                arg, arg->nlm_async_args.nlm_async_grant.alock.svid,
@@ -243,11 +246,12 @@ static void nlm4_send_grant_msg(nlm_async_queue_t *arg)
                           &(arg->nlm_async_args.nlm_async_grant),
                           arg->nlm_async_key);
 
-  free_grant_arg(arg);
-
   /* If success, we are done. */
   if(retval == RPC_SUCCESS)
-    return;
+    {
+      free_grant_arg(arg);
+      return;
+    }
 
   /*
    * We are not able call granted callback. Some client may retry
@@ -260,16 +264,19 @@ static void nlm4_send_grant_msg(nlm_async_queue_t *arg)
   if(state_find_grant(arg->nlm_async_args.nlm_async_grant.cookie.n_bytes,
                       arg->nlm_async_args.nlm_async_grant.cookie.n_len,
                       &cookie_entry,
-                      &nlm_async_cache_inode_client,
+                      pclient,
                       &state_status) != STATE_SUCCESS)
     {
       /* This must be an old NLM_GRANTED_RES */
       LogFullDebug(COMPONENT_NLM,
                    "Could not find cookie=%s status=%s",
                    buffer, state_err_str(state_status));
+      free_grant_arg(arg);
       return;
     }
 
+  free_grant_arg(arg);
+
   P(cookie_entry->sce_pentry->object.file.lock_list_mutex);
 
   if(cookie_entry->sce_lock_entry->sle_block_data == NULL ||
@@ -288,7 +295,7 @@ static void nlm4_send_grant_msg(nlm_async_queue_t *arg)
 
   if(state_release_grant(pcontext,
                          cookie_entry,
-                         &nlm_async_cache_inode_client,
+                         pclient,
                          &state_status) != STATE_SUCCESS)
     {
       /* Huh? */
@@ -427,6 +434,8 @@ int nlm_process_parameters(struct svc_req        * preq,
                   &pcontext->credential, sizeof( hpssfsal_cred_t ) ) ;
 #else
           (*ppblock_data)->sbd_block_data.sbd_nlm_block_data.sbd_credential = pcontext->credential;
+          /* The group list belongs to the context of the worker */
+          (*ppblock_data)->sbd_block_data.sbd_nlm_block_data.sbd_credential.grouplist = NULL;
 #endif
         }
     }
@@ -32,6 +32,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
 #include "config_parsing.h"
+#include "pnfs_service.h"
 
 int nfs_read_conf_pnfs_ds_conf(config_item_t subblock,
                                pnfs_ds_parameter_t * pds_conf)
@@ -190,7 +191,7 @@ int nfs_read_pnfs_conf(config_file_t in_config, pnfs_parameter_t * pparam)
             }
           else if(!strcasecmp(key_name, "Stripe_Size"))
             {
-              pparam->layoutfile.stripe_size = StrToBoolean(key_value);
+              pparam->layoutfile.stripe_size = atoi(key_value);
             }
           else if(!strcasecmp(key_name, "Stripe_Width"))
             {
@@ -209,15 +210,29 @@ int nfs_read_pnfs_conf(config_file_t in_config, pnfs_parameter_t * pparam)
         case CONFIG_ITEM_BLOCK:
           block_name = config_GetBlockName(item);
 
-          if(!strcasecmp(block_name, "DataServer"))
-            if(nfs_read_conf_pnfs_ds_conf(item, &pparam->layoutfile.ds_param[ds_count]) !=
-               0)
-              {
-                LogCrit(COMPONENT_CONFIG,
-                        "Unknown or unsettable key: %s (item %s)", key_name,
-                        CONF_LABEL_PNFS);
-                return -1;
-              }
+          if(strcasecmp(block_name, "DataServer"))
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Unknown sub-block: %s (item %s)", block_name,
+                      CONF_LABEL_PNFS);
+              return -1;
+            }
+
+          if(ds_count == NB_MAX_PNFS_DS)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Too many pNFS data servers (at most %u)", NB_MAX_PNFS_DS);
+              return -1;
+            }
+
+          if(nfs_read_conf_pnfs_ds_conf(item, &pparam->layoutfile.ds_param[ds_count]) !=
+             0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Error while reading pNFS data server #%u (item %s)", ds_count,
+                      CONF_LABEL_PNFS);
+              return -1;
+            }
 
           ds_count += 1;
           break;
@@ -232,15 +247,37 @@ int nfs_read_pnfs_conf(config_file_t in_config, pnfs_parameter_t * pparam)
 
     }                           /* for */
 
+  /* Without DataServer block, the default data server is kept */
+  if(ds_count > 0)
+    pparam->layoutfile.nb_ds = ds_count;
+
   /* Sanity check : as much or less DS configured than stripe_size  */
-  if(ds_count < pparam->layoutfile.stripe_width)
+  if(pparam->layoutfile.nb_ds < pparam->layoutfile.stripe_width)
     {
       LogCrit(COMPONENT_CONFIG,
               "You must define more pNFS data server for strip_width=%u (only %u defined)",
-              pparam->layoutfile.stripe_width, ds_count);
+              pparam->layoutfile.stripe_width, pparam->layoutfile.nb_ds);
+      return -1;
+    }
+
+  if(pparam->layoutfile.stripe_width == 0)
+    {
+      LogCrit(COMPONENT_CONFIG, "pNFS Stripe_Width must be at least 1");
       return -1;
     }
 
+  /* The low bits of nfl_util are flags */
+  if(pparam->layoutfile.stripe_size == 0 ||
+     (pparam->layoutfile.stripe_size & ~NFL4_UFLG_STRIPE_UNIT_SIZE_MASK) != 0)
+    {
+      LogCrit(COMPONENT_CONFIG,
+              "pNFS Stripe_Size=%u must be a non null multiple of 64",
+              pparam->layoutfile.stripe_size);
+      return -1;
+    }
+
+  pnfs_parallel_fs_build_devices(&pparam->layoutfile);
+
   return 0;
 }                               /* nfs_read_pnfs_conf */
 
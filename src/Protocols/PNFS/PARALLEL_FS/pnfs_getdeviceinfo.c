@@ -58,77 +58,91 @@ nfsstat4 pnfs_parallel_fs_getdeviceinfo( GETDEVICEINFO4args  * pgetdeviceinfoarg
 			            compound_data_t     * data,
 				    GETDEVICEINFO4res   * pgetdeviceinfores )
 {
-  unsigned int offset = 0;
-  uint32_t int32 = 0;
-  char tmpchar[MAXNAMLEN];
-  unsigned int tmplen = 0;
-  unsigned int padlen = 0;
+  pnfs_layoutfile_parameter_t * pparam = &nfs_param.pnfs_param.layoutfile ;
+  pnfs_layoutfile_device_t * pdevice ;
+  pnfs_ds_parameter_t * pds ;
+  nfsv4_1_file_layout_ds_addr4 ds_addr ;
+  uint32_t stripe_indices[NB_MAX_PNFS_DS] ;
+  multipath_list4 multipath[NB_MAX_PNFS_DS] ;
+  netaddr4 netaddr[NB_MAX_PNFS_DS] ;
+  char uaddr[NB_MAX_PNFS_DS][MAXNAMLEN] ;
+  char netid[] = "tcp" ;
+  unsigned int buffsize ;
+  unsigned short port ;
   unsigned int i = 0;
-
+  int index ;
   char *buff = NULL ;
+  XDR xdrs ;
+
+  if( pgetdeviceinfoargs->gdia_layout_type != LAYOUT4_NFSV4_1_FILES )
+    {
+      pgetdeviceinfores->gdir_status = NFS4ERR_UNKNOWN_LAYOUTTYPE ;
+      return pgetdeviceinfores->gdir_status ;
+    }
+
+  if( ( index = pnfs_parallel_fs_deviceid_to_index( pgetdeviceinfoargs->gdia_device_id,
+                                                    pparam ) ) < 0 )
+    {
+      pgetdeviceinfores->gdir_status = NFS4ERR_NOENT ;
+      return pgetdeviceinfores->gdir_status ;
+    }
+
+  pdevice = &pparam->devices[index] ;
+
+  /* Stripe i goes to the i-th data server of the device, each one with a
+   * single address */
+  buffsize = 2 * sizeof( uint32_t ) ;
+  for( i = 0; i < pdevice->stripe_width; i++ )
+    {
+      pds = &pparam->ds_param[pdevice->ds_index[i]] ;
+      port = ntohs( pds->ipport ) ;
+
+      /* Universal address: h1.h2.h3.h4.p1.p2 */
+      snprintf( uaddr[i], MAXNAMLEN, "%s.%u.%u",
+                pds->ipaddr_ascii, port >> 8, port & 0xFF ) ;
 
-  buff = (char *)pgetdeviceinfores->GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.da_addr_body_val ;
+      netaddr[i].na_r_netid = netid ;
+      netaddr[i].na_r_addr = uaddr[i] ;
+      multipath[i].multipath_list4_len = 1 ;
+      multipath[i].multipath_list4_val = &netaddr[i] ;
+      stripe_indices[i] = i ;
 
-  /* nflda_stripe_indices.nflda_stripe_indices_len */
-  int32 = htonl(nfs_param.pnfs_param.layoutfile.stripe_width);
-  memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-  offset += sizeof(int32);
+      buffsize += 5 * sizeof( uint32_t ) + sizeof( netid ) + strlen( uaddr[i] ) + 3 ;
+    }
 
-  for(i = 0; i < nfs_param.pnfs_param.layoutfile.stripe_width; i++)
+  ds_addr.nflda_stripe_indices.nflda_stripe_indices_len = pdevice->stripe_width ;
+  ds_addr.nflda_stripe_indices.nflda_stripe_indices_val = stripe_indices ;
+  ds_addr.nflda_multipath_ds_list.nflda_multipath_ds_list_len = pdevice->stripe_width ;
+  ds_addr.nflda_multipath_ds_list.nflda_multipath_ds_list_val = multipath ;
+
+  if( ( buff = Mem_Alloc( buffsize ) ) == NULL )
     {
-      /* nflda_stripe_indices.nflda_stripe_indices_val */
-      int32 = htonl(i);
-      memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-      offset += sizeof(int32);
+      pgetdeviceinfores->gdir_status = NFS4ERR_SERVERFAULT ;
+      return pgetdeviceinfores->gdir_status ;
     }
 
-  /* nflda_multipath_ds_list.nflda_multipath_ds_list_len */
-  int32 = htonl(nfs_param.pnfs_param.layoutfile.stripe_width);
-  memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-  offset += sizeof(int32);
+  xdrmem_create( &xdrs, buff, buffsize, XDR_ENCODE ) ;
+  if( !xdr_nfsv4_1_file_layout_ds_addr4( &xdrs, &ds_addr ) )
+    {
+      LogCrit( COMPONENT_PNFS,
+               "pnfs_parallel_fs_getdeviceinfo: could not encode device %d", index ) ;
+      Mem_Free( buff ) ;
+      pgetdeviceinfores->gdir_status = NFS4ERR_SERVERFAULT ;
+      return pgetdeviceinfores->gdir_status ;
+    }
 
-  for(i = 0; i < nfs_param.pnfs_param.layoutfile.stripe_width; i++)
+  if( pgetdeviceinfoargs->gdia_maxcount > 0 &&
+      xdr_getpos( &xdrs ) > pgetdeviceinfoargs->gdia_maxcount )
     {
-      /* nflda_multipath_ds_list.nflda_multipath_ds_list_val[i].multipath_list4_len */
-      int32 = htonl(1);
-      memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-      offset += sizeof(int32);
-
-      /* nflda_multipath_ds_list.nflda_multipath_ds_list_val[i].multipath_list4_val[0].na_r_netid */
-      int32 = htonl(3);         /* because strlen( "tcp" ) = 3 */
-      memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-      offset += sizeof(int32);
-
-      memset(tmpchar, 0, MAXNAMLEN);
-      strncpy(tmpchar, "tcp", MAXNAMLEN);
-      memcpy((char *)(buff + offset), tmpchar, 4);      /* 4 bytes = 3 bytes for "tcp" and 1 to keep XDR alignment */
-      offset += 4;
-
-      /* nflda_multipath_ds_list.nflda_multipath_ds_list_val[i].multipath_list4_val[0].na_r_addr */
-      memset(tmpchar, 0, MAXNAMLEN);
-      snprintf(tmpchar, MAXNAMLEN, "%s.%u.%u",
-               nfs_param.pnfs_param.layoutfile.ds_param[i].ipaddr_ascii,
-               nfs_param.pnfs_param.layoutfile.ds_param[i].ipport & 0x0F,
-               nfs_param.pnfs_param.layoutfile.ds_param[i].ipport >> 8);
-      tmplen = strnlen(tmpchar, MAXNAMLEN);
-
-      /* XDR padding : keep stuff aligned on 32 bits pattern */
-      if(tmplen % 4 == 0)
-        padlen = 0;
-      else
-        padlen = 4 - (tmplen % 4);
-
-      /* len of na_r_addr */
-      int32 = htonl(tmplen);
-      memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-      offset += sizeof(int32);
-
-      memcpy((char *)(buff + offset), tmpchar, tmplen + padlen);
-      offset += tmplen + padlen;
-
-    }                           /* for */
- 
-  pgetdeviceinfores->GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.da_addr_body_len = offset ;
+      Mem_Free( buff ) ;
+      pgetdeviceinfores->GETDEVICEINFO4res_u.gdir_mincount = xdr_getpos( &xdrs ) ;
+      pgetdeviceinfores->gdir_status = NFS4ERR_TOOSMALL ;
+      return pgetdeviceinfores->gdir_status ;
+    }
+
+  pgetdeviceinfores->GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.da_addr_body_len = xdr_getpos( &xdrs ) ;
+  pgetdeviceinfores->GETDEVICEINFO4res_u.gdir_resok4.gdir_device_addr.da_addr_body.da_addr_body_val = buff ;
+  xdr_destroy( &xdrs ) ;
  
   pgetdeviceinfores->gdir_status = NFS4_OK;
 
@@ -51,6 +51,87 @@
 #include "pnfs.h" 
 #include "pnfs_service.h" 
 
+/**
+ *
+ * pnfs_parallel_fs_build_devices: builds the device table from the data servers.
+ *
+ * Device k stripes the files over stripe_width data servers, starting at data
+ * server k. When every data server is in the stripe, the rotations of the
+ * pattern are given by nfl_first_stripe_index and one device is enough.
+ *
+ * @param pparam [INOUT] pNFS/File parameters, with nb_ds and stripe_width set.
+ *
+ */
+
+void pnfs_parallel_fs_build_devices( pnfs_layoutfile_parameter_t * pparam )
+{
+  unsigned int i ;
+  unsigned int j ;
+
+  if( pparam->nb_ds == 0 || pparam->stripe_width == 0 )
+    {
+      pparam->nb_devices = 0 ;
+      return ;
+    }
+
+  if( pparam->stripe_width >= pparam->nb_ds )
+    pparam->nb_devices = 1 ;
+  else
+    pparam->nb_devices = pparam->nb_ds ;
+
+  for( i = 0 ; i < pparam->nb_devices ; i++ )
+    {
+      pparam->devices[i].stripe_width = pparam->stripe_width ;
+
+      for( j = 0 ; j < pparam->stripe_width ; j++ )
+        pparam->devices[i].ds_index[j] = ( i + j ) % pparam->nb_ds ;
+    }
+
+  LogInfo( COMPONENT_PNFS,
+           "pNFS: %u devices striping over %u of the %u data servers, stripe unit %u",
+           pparam->nb_devices, pparam->stripe_width, pparam->nb_ds,
+           pparam->stripe_size ) ;
+}                               /* pnfs_parallel_fs_build_devices */
+
+void pnfs_parallel_fs_index_to_deviceid( unsigned int index,
+                                         deviceid4 deviceid )
+{
+  uint32_t int32 = htonl( index + 1 ) ;
+
+  memset( deviceid, 0, NFS4_DEVICEID4_SIZE ) ;
+  memcpy( deviceid, (char *)&int32, sizeof( int32 ) ) ;
+}                               /* pnfs_parallel_fs_index_to_deviceid */
+
+/**
+ *
+ * pnfs_parallel_fs_deviceid_to_index: finds a device in the device table.
+ *
+ * @param deviceid [IN] the device id sent by the client.
+ * @param pparam   [IN] pNFS/File parameters.
+ *
+ * @return the rank of the device in the table, -1 if it is unknown.
+ *
+ */
+
+int pnfs_parallel_fs_deviceid_to_index( deviceid4 deviceid,
+                                        pnfs_layoutfile_parameter_t * pparam )
+{
+  deviceid4 expected ;
+  uint32_t int32 ;
+
+  memcpy( (char *)&int32, deviceid, sizeof( int32 ) ) ;
+  int32 = ntohl( int32 ) ;
+
+  if( int32 == 0 || int32 > pparam->nb_devices )
+    return -1 ;
+
+  pnfs_parallel_fs_index_to_deviceid( int32 - 1, expected ) ;
+  if( memcmp( expected, deviceid, NFS4_DEVICEID4_SIZE ) )
+    return -1 ;
+
+  return int32 - 1 ;
+}                               /* pnfs_parallel_fs_deviceid_to_index */
+
 /**
  *
  * pnfs_parallel_fs_getdevicelist: manages the OP4_GETDEVICELIST operation for pNFS/File on top of PARALLEL_FS
@@ -69,7 +150,53 @@ nfsstat4 pnfs_parallel_fs_getdevicelist( GETDEVICELIST4args  * pgetdevicelistarg
 			            compound_data_t     * data,
 				    GETDEVICELIST4res   * pgetdevicelistres )
 {
-  
+  pnfs_layoutfile_parameter_t * pparam = &nfs_param.pnfs_param.layoutfile ;
+  GETDEVICELIST4resok * presok = &pgetdevicelistres->GETDEVICELIST4res_u.gdlr_resok4 ;
+  unsigned int first ;
+  unsigned int count ;
+  unsigned int i ;
+
+  if( pgetdevicelistargs->gdla_layout_type != LAYOUT4_NFSV4_1_FILES )
+    {
+      pgetdevicelistres->gdlr_status = NFS4ERR_UNKNOWN_LAYOUTTYPE ;
+      return pgetdevicelistres->gdlr_status ;
+    }
+
+  /* The cookie is the rank of the next device to return */
+  if( pgetdevicelistargs->gdla_cookie > pparam->nb_devices )
+    {
+      pgetdevicelistres->gdlr_status = NFS4ERR_BAD_COOKIE ;
+      return pgetdevicelistres->gdlr_status ;
+    }
+
+  first = (unsigned int)pgetdevicelistargs->gdla_cookie ;
+  count = pparam->nb_devices - first ;
+  if( pgetdevicelistargs->gdla_maxdevices > 0 &&
+      count > pgetdevicelistargs->gdla_maxdevices )
+    count = pgetdevicelistargs->gdla_maxdevices ;
+
+  presok->gdlr_deviceid_list.gdlr_deviceid_list_len = 0 ;
+  presok->gdlr_deviceid_list.gdlr_deviceid_list_val = NULL ;
+
+  if( count > 0 )
+    {
+      if( ( presok->gdlr_deviceid_list.gdlr_deviceid_list_val =
+              (deviceid4 *)Mem_Alloc( count * sizeof( deviceid4 ) ) ) == NULL )
+        {
+          pgetdevicelistres->gdlr_status = NFS4ERR_SERVERFAULT ;
+          return pgetdevicelistres->gdlr_status ;
+        }
+
+      for( i = 0 ; i < count ; i++ )
+        pnfs_parallel_fs_index_to_deviceid( first + i,
+                                            presok->gdlr_deviceid_list.gdlr_deviceid_list_val[i] ) ;
+      presok->gdlr_deviceid_list.gdlr_deviceid_list_len = count ;
+    }
+
+  presok->gdlr_cookie = first + count ;
+  memset( presok->gdlr_cookieverf, 0, NFS4_VERIFIER_SIZE ) ;
+  presok->gdlr_eof = ( first + count == pparam->nb_devices ) ;
+
   pgetdevicelistres->gdlr_status = NFS4_OK;
 
   return pgetdevicelistres->gdlr_status  ;
@@ -55,7 +55,10 @@
  *
  * pnfs_parallel_fs_layoutcommit: manages the OP4_LAYOUTCOMMIT operation for pNFS/File on top of PARALLEL_FS
  *
- * Manages the OP4_LAYOUTCOMMIT operation for pNFS/File on top of PARALLEL_FS
+ * The data servers wrote in the parallel filesystem, behind the back of the
+ * cache: the attributes are fetched again, then the file is extended if the
+ * last write the client reports ends beyond its size. The file is never
+ * shrunk, other clients may have written further through other data servers.
  *
  * @param playoutcommitargs [IN]  pointer to layoutcommit's arguments
  * @param data              [INOUT]  pointer to related compoud request
@@ -69,10 +72,46 @@ nfsstat4 pnfs_parallel_fs_layoutcommit( LAYOUTCOMMIT4args  * playoutcommitargs,
 			           compound_data_t    * data,
 				   LAYOUTCOMMIT4res   * playoutcommitres )
 {
-  
-  /* For the moment, returns no new size */
-  playoutcommitres->LAYOUTCOMMIT4res_u.locr_resok4.locr_newsize.ns_sizechanged = TRUE;
-  playoutcommitres->LAYOUTCOMMIT4res_u.locr_resok4.locr_newsize.newsize4_u.ns_size =playoutcommitargs->loca_length ;
+  cache_entry_t * pentry = data->current_entry ;
+  cache_inode_status_t cache_status ;
+  fsal_attrib_list_t attr ;
+  fsal_size_t cached_size ;
+  fsal_size_t last_write_end ;
+
+  cache_inode_get_attributes( pentry, &attr ) ;
+  cached_size = attr.filesize ;
+
+  P_w( &pentry->lock ) ;
+  pentry->internal_md.valid_state = STALE ;
+  V_w( &pentry->lock ) ;
+
+  if( cache_inode_getattr( pentry, &attr, data->ht, data->pclient,
+                           data->pcontext, &cache_status ) != CACHE_INODE_SUCCESS )
+    {
+      playoutcommitres->locr_status = nfs4_Errno( cache_status ) ;
+      return playoutcommitres->locr_status ;
+    }
+
+  if( playoutcommitargs->loca_last_write_offset.no_newoffset )
+    {
+      last_write_end = playoutcommitargs->loca_last_write_offset.newoffset4_u.no_offset + 1 ;
+
+      if( last_write_end > attr.filesize )
+        {
+          if( cache_inode_truncate( pentry, last_write_end, &attr, data->ht,
+                                    data->pclient, data->pcontext,
+                                    &cache_status ) != CACHE_INODE_SUCCESS )
+            {
+              playoutcommitres->locr_status = nfs4_Errno( cache_status ) ;
+              return playoutcommitres->locr_status ;
+            }
+        }
+    }
+
+  playoutcommitres->LAYOUTCOMMIT4res_u.locr_resok4.locr_newsize.ns_sizechanged =
+      ( attr.filesize != cached_size ) ;
+  playoutcommitres->LAYOUTCOMMIT4res_u.locr_resok4.locr_newsize.newsize4_u.ns_size =
+      attr.filesize ;
 
   playoutcommitres->locr_status = NFS4_OK;
 
@@ -51,115 +51,110 @@
 #include "pnfs.h" 
 #include "pnfs_service.h" 
 
+/**
+ *
+ * pnfs_parallel_fs_layoutget: manages the OP4_LAYOUTGET operation for pNFS/File on top of PARALLEL_FS
+ *
+ * Hands out a whole file segment. The data servers share the parallel
+ * filesystem with the metadata server, they are given its file handle and
+ * address the file at its real offsets (sparse striping). The files are
+ * spread over the devices and over the first stripe of their device by
+ * fileid, so that the small files do not all land on the same data server.
+ *
+ * @param playoutgetargs [IN]  pointer to layoutget's arguments
+ * @param data           [INOUT]  pointer to related compoud request
+ * @param playoutgetres  [OUT] pointer to layoutget's results
+ *
+ * @return  NFSv4 status (with NFSv4 error code)
+ *
+ */
+
 nfsstat4 pnfs_parallel_fs_layoutget( LAYOUTGET4args   * playoutgetargs,
 				compound_data_t  * data,
 				LAYOUTGET4res    * playoutgetres )
 {
- unsigned int offset = 0;
-  uint32_t int32 = 0;
-  int64_t int64 = 0LL;
-  unsigned int padlen = 0;
-  char deviceid[NFS4_DEVICEID4_SIZE];
-  unsigned int i;
+  pnfs_layoutfile_parameter_t * pparam = &nfs_param.pnfs_param.layoutfile ;
+  nfsv4_1_file_layout4 file_layout ;
+  fsal_attrib_list_t attr ;
+  layout4 * playout ;
+  unsigned int buffsize ;
+  unsigned int index ;
   char * buff = NULL ; 
-  unsigned int stripe = 1 ;
   nfs_fh4 * pnfsfh4 ;
+  XDR xdrs ;
 
   if( !data || !playoutgetres )
     return NFS4ERR_SERVERFAULT ;
 
-  pnfsfh4 = &data->currentFH ; 
-
-  if((buff = Mem_Alloc(1024)) == NULL)
+  if( pparam->nb_devices == 0 )
     {
-      playoutgetres->logr_status = NFS4ERR_SERVERFAULT;
+      playoutgetres->logr_status = NFS4ERR_LAYOUTUNAVAILABLE ;
       return playoutgetres->logr_status ;
     }
 
-  /* No return on close for the moment */
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_return_on_close = FALSE;
-
-  /* Manages the stateid */
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_stateid.seqid = 1;
-  memcpy(playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_stateid.other,
-         playoutgetargs->loga_stateid.other, 12);
-  //file_state->stateid_other, 12);
-
-  /* Now the layout specific information */
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_len = 1;  /** @todo manages more than one segment */
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val =
-      (layout4 *) Mem_Alloc(sizeof(layout4));
-
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_offset =
-      playoutgetargs->loga_offset;
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_length = 0xFFFFFFFFFFFFFFFFLL;   /* Whole file */
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].lo_iomode =
-      playoutgetargs->loga_iomode;
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_type = LAYOUT4_NFSV4_1_FILES;
-
-
-  /** @todo It should be better to use xdr_nfsv4_1_file_layout4 on a xdrmem stream */
-
-  /* nfl_deviceid */
-  memset(deviceid, 0, NFS4_DEVICEID4_SIZE);
-  deviceid[0] = 1 ; /** @todo : this part of the code is to be reviewed */
-  memcpy((char *)(buff + offset), deviceid, NFS4_DEVICEID4_SIZE);
-  offset += NFS4_DEVICEID4_SIZE;
-
-  /* nfl_util */
-  int32 = htonl(0x2000);
-  memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-  offset += sizeof(int32);
-
-  /* nfl_first_stripe_index */
-  int32 = 0;
-  memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-  offset += sizeof(int32);
-
-  /* nfl_pattern_offset */
-  int64 = 0LL;
-  memcpy((char *)(buff + offset), (char *)&int64, sizeof(int64));
-  offset += sizeof(int64);
-
-  /* nfl_fh_list.nfl_fh_list_len */
-  int32 = htonl( stripe );
-  memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-  offset += sizeof(int32);
-
-  for(i = 0; i < stripe; i++)
+  if( playoutgetargs->loga_iomode != LAYOUTIOMODE4_READ &&
+      playoutgetargs->loga_iomode != LAYOUTIOMODE4_RW )
     {
-      /* nfl_fh_list.nfl_fh_list_val[i].nfs_fh4_len */
-      int32 = htonl(pnfsfh4->nfs_fh4_len);
-      memcpy((char *)(buff + offset), (char *)&int32, sizeof(int32));
-      offset += sizeof(int32);
+      playoutgetres->logr_status = NFS4ERR_BADIOMODE ;
+      return playoutgetres->logr_status ;
+    }
+
+  pnfsfh4 = &data->currentFH ; 
 
-      /* nfl_fh_list.nfl_fh_list_val[i].nfs_fh4_len */
-      memcpy((char *)(buff + offset), pnfsfh4->nfs_fh4_val, pnfsfh4->nfs_fh4_len ) ;
+  cache_inode_get_attributes( data->current_entry, &attr ) ;
+  index = attr.fileid % pparam->nb_devices ;
 
-      /* Turn the file handle to a 'DS file handle' */
-      //if(pds_file->filepart[i].is_ganesha == FALSE)
-      //  ((char *)(buff + offset))[2] = 9;
+  pnfs_parallel_fs_index_to_deviceid( index, file_layout.nfl_deviceid ) ;
+  file_layout.nfl_util = pparam->stripe_size & NFL4_UFLG_STRIPE_UNIT_SIZE_MASK ;
+  file_layout.nfl_first_stripe_index =
+      ( attr.fileid / pparam->nb_devices ) % pparam->devices[index].stripe_width ;
+  file_layout.nfl_pattern_offset = 0LL ;
 
-      /* Update the offset for encoding */
-      offset += pnfsfh4->nfs_fh4_len ;
+  /* A single file handle is used with every data server */
+  file_layout.nfl_fh_list.nfl_fh_list_len = 1 ;
+  file_layout.nfl_fh_list.nfl_fh_list_val = pnfsfh4 ;
 
-      /* XDR padding : keep stuff aligned on 32 bits pattern */
-      if( pnfsfh4->nfs_fh4_len  == 0)
-        padlen = 0;
-      else
-        padlen = 4 - ( pnfsfh4->nfs_fh4_len % 4);
+  buffsize = NFS4_DEVICEID4_SIZE + 4 * sizeof( uint32_t ) + sizeof( offset4 ) +
+             pnfsfh4->nfs_fh4_len + 3 ;
 
-      if(padlen > 0)
-        memset((char *)(buff + offset), 0, padlen);
+  if( ( buff = Mem_Alloc( buffsize ) ) == NULL )
+    {
+      playoutgetres->logr_status = NFS4ERR_SERVERFAULT;
+      return playoutgetres->logr_status ;
+    }
+
+  xdrmem_create( &xdrs, buff, buffsize, XDR_ENCODE ) ;
+  if( !xdr_nfsv4_1_file_layout4( &xdrs, &file_layout ) )
+    {
+      LogCrit( COMPONENT_PNFS,
+               "pnfs_parallel_fs_layoutget: could not encode the layout" ) ;
+      Mem_Free( buff ) ;
+      playoutgetres->logr_status = NFS4ERR_SERVERFAULT;
+      return playoutgetres->logr_status ;
+    }
 
-      offset += padlen;
-    }                           /* for */
+  if( ( playout = (layout4 *) Mem_Alloc( sizeof( layout4 ) ) ) == NULL )
+    {
+      Mem_Free( buff ) ;
+      playoutgetres->logr_status = NFS4ERR_SERVERFAULT;
+      return playoutgetres->logr_status ;
+    }
 
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_body.loc_body_len = offset ;
-  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val[0].
-      lo_content.loc_body.loc_body_val = buff;
+  playout->lo_offset = 0LL ;
+  playout->lo_length = NFS4_UINT64_MAX ;   /* Whole file */
+  playout->lo_iomode = playoutgetargs->loga_iomode ;
+  playout->lo_content.loc_type = LAYOUT4_NFSV4_1_FILES ;
+  playout->lo_content.loc_body.loc_body_len = xdr_getpos( &xdrs ) ;
+  playout->lo_content.loc_body.loc_body_val = buff ;
+  xdr_destroy( &xdrs ) ;
+
+  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_len = 1 ;
+  playoutgetres->LAYOUTGET4res_u.logr_resok4.logr_layout.logr_layout_val = playout ;
+
+  LogFullDebug( COMPONENT_PNFS,
+                "pnfs_parallel_fs_layoutget: fileid %llu on device %u, first stripe %u",
+                (unsigned long long)attr.fileid, index + 1,
+                file_layout.nfl_first_stripe_index ) ;
 
   playoutgetres->logr_status = NFS4_OK ;
   return NFS4_OK ;
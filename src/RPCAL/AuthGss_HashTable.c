@@ -27,155 +27,219 @@
 #include <gssapi/gssapi_generic.h>
 #endif
 
-#define GSS_CNAMELEN  1024
-#define GSS_CKSUM_LEN 1024
+/* The contexts are spread over shards, each with its own lock, so that the
+ * lookups of the receivers do not wait for each other */
+#define GSS_CTX_SHARDS 16
 
-struct svc_rpc_gss_data_stored
+typedef struct gss_ctx_shard__
 {
-  bool_t established;
-  gss_buffer_desc ctx_exported;
-  struct rpc_gss_sec sec;
-  char cname_val[GSS_CNAMELEN];
-  size_t cname_len;
-  u_int seq;
-  u_int win;
-  u_int seqlast;
-  uint32_t seqmask;
-  gss_name_t client_name;
-  char checksum_val[GSS_CKSUM_LEN];
-  size_t checksum_len;
-};
+  rw_lock_t lock;
+  gss_ctx_cache_entry_t **buckets;
+} gss_ctx_shard_t;
+
+static gss_ctx_shard_t gss_ctx_shards[GSS_CTX_SHARDS];
+static unsigned int gss_ctx_nb_buckets = 0;
+static unsigned int gss_ctx_nb_entries = 0;
+
+static unsigned long gss_ctx_key_hash(gss_union_ctx_id_desc * pgss_ctx)
+{
+  unsigned long h;
+
+  /* Both are addresses, their low bits are alignment */
+  h = ((unsigned long)pgss_ctx->mech_type >> 3) ^
+      ((unsigned long)pgss_ctx->internal_ctx_id >> 3);
+  h ^= h >> 17;
+  h *= 0x9e3779b1UL;
+  h ^= h >> 13;
+
+  return h;
+}
+
+static gss_ctx_shard_t *gss_ctx_shard(gss_union_ctx_id_desc * pgss_ctx,
+                                      gss_ctx_cache_entry_t *** ppbucket)
+{
+  unsigned long h = gss_ctx_key_hash(pgss_ctx);
+  gss_ctx_shard_t *pshard = &gss_ctx_shards[h % GSS_CTX_SHARDS];
+
+  *ppbucket = &pshard->buckets[(h / GSS_CTX_SHARDS) % gss_ctx_nb_buckets];
+
+  return pshard;
+}
+
+/* The cache entry is freed with its context when its last reference goes */
+static void gss_ctx_entry_unref(gss_ctx_cache_entry_t * pentry)
+{
+  OM_uint32 min_stat;
+
+  if(__sync_sub_and_fetch(&pentry->refcount, 1) != 0)
+    return;
+
+  gss_delete_sec_context(&min_stat, &pentry->ctx, GSS_C_NO_BUFFER);
+  gss_release_buffer(&min_stat, &pentry->cname);
+  if(pentry->client_name)
+    gss_release_name(&min_stat, &pentry->client_name);
+
+  pthread_mutex_destroy(&pentry->ctx_mutex);
+  Mem_Free(pentry);
+}
+
+/* Makes gd use the context of the cache entry, gd gets a reference */
+static void gss_ctx_entry_lend(gss_ctx_cache_entry_t * pentry,
+                               struct svc_rpc_gss_data *gd)
+{
+  gd->pcached = pentry;
+  gd->established = TRUE;
+  gd->ctx = pentry->ctx;
+  gd->client_name = pentry->client_name;
+  gd->cname = pentry->cname;
+  gd->sec = pentry->sec;
+  gd->win = pentry->win;
+}
+
+/**
+ *
+ * Gss_ctx_Hash_Release: gd no longer uses its context.
+ *
+ * A context borrowed from the cache is given back, a context of its own is
+ * deleted.
+ *
+ * @param gd [INOUT] the rpcsec_gss data of a transport
+ *
+ */
+void Gss_ctx_Hash_Release(struct svc_rpc_gss_data *gd)
+{
+  OM_uint32 min_stat;
+
+  if(gd->pcached != NULL)
+    {
+      gss_ctx_entry_unref(gd->pcached);
+      gd->pcached = NULL;
+      gd->ctx = GSS_C_NO_CONTEXT;
+      gd->client_name = NULL;
+      gd->cname.value = NULL;
+      gd->cname.length = 0;
+    }
+  else
+    {
+      gss_delete_sec_context(&min_stat, &gd->ctx, GSS_C_NO_BUFFER);
+      gss_release_buffer(&min_stat, &gd->cname);
+      if(gd->client_name)
+        gss_release_name(&min_stat, &gd->client_name);
+    }
+
+  gd->established = FALSE;
+}                               /* Gss_ctx_Hash_Release */
 
 /**
  *
- *  gss_data2stored: converts a rpc_gss_data into a storable structure.
+ * Gss_ctx_Hash_Ref: a copy of gd uses the same cached context.
+ *
+ * @param gd [IN] the rpcsec_gss data that was copied
+ *
+ */
+void Gss_ctx_Hash_Ref(struct svc_rpc_gss_data *gd)
+{
+  if(gd->pcached != NULL)
+    __sync_add_and_fetch(&gd->pcached->refcount, 1);
+}                               /* Gss_ctx_Hash_Ref */
+
+/**
  *
- * converts a rpc_gss_data into a storable structure.
+ * Gss_ctx_Lock: serializes the per message calls on a shared context.
  *
- * @param gd      [IN]  the structure to be used for authentication
- * @param pstored [OUT] the stored value
+ * The calls that produce a token (gss_get_mic, gss_wrap) update the sequence
+ * number of the context, they are always serialized. The calls that check a
+ * token are only serialized if the context does replay or sequence detection.
+ * A context that is not shared is not locked.
  *
- * @return 1 is operation is a success, 0 otherwise
+ * @param gd      [IN] the rpcsec_gss data
+ * @param produce [IN] TRUE for a call that produces a token
  *
  */
-static const char *gss_data2stored(struct svc_rpc_gss_data *gd,
-                                   struct svc_rpc_gss_data_stored *pstored)
+void Gss_ctx_Lock(struct svc_rpc_gss_data *gd, bool_t produce)
 {
-  OM_uint32 major;
-  OM_uint32 minor;
-
-  /* Save the data with a fixed size */
-  pstored->established = gd->established;
-  pstored->sec = gd->sec;
-  pstored->seq = gd->seq;
-  pstored->win = gd->win;
-  pstored->seqlast = gd->seqlast;
-  pstored->seqmask = gd->seqmask;
-
-  /* keep the gss_buffer_desc */
-  memcpy(pstored->cname_val, gd->cname.value, gd->cname.length);
-  pstored->cname_len = gd->cname.length;
-
-  memcpy(pstored->checksum_val, gd->checksum.value, gd->checksum.length);
-  pstored->checksum_len = gd->checksum.length;
-
-  /* Duplicate the gss_name */
-  if((major = gss_duplicate_name(&minor,
-                                 gd->client_name,
-                                 &pstored->client_name)) != GSS_S_COMPLETE)
-    return "could not duplicate client_name";
-
-  /* export the sec context */
-  if((major = gss_export_sec_context(&minor,
-                                     &gd->ctx, &pstored->ctx_exported)) != GSS_S_COMPLETE)
-    return "could not export context";
-
-  return NULL;
-}                               /* gss_data2stored */
+  if(gd->pcached != NULL && (produce || gd->pcached->serialize))
+    P(gd->pcached->ctx_mutex);
+}                               /* Gss_ctx_Lock */
+
+void Gss_ctx_Unlock(struct svc_rpc_gss_data *gd, bool_t produce)
+{
+  if(gd->pcached != NULL && (produce || gd->pcached->serialize))
+    V(gd->pcached->ctx_mutex);
+}                               /* Gss_ctx_Unlock */
 
 /**
  *
- *  gss_stored2data: converts a stored rpc_gss_data into a usable structure.
+ * Gss_ctx_Seq_Check: checks a sequence number against the window of a context.
  *
- *  Converts a stored rpc_gss_data into a usable structure.
+ * The window is a single word (last sequence number and bitmap of the ones
+ * seen), updated with a compare and swap: requests of the same context do not
+ * take any lock. The number is first checked without commit, to drop replays
+ * before their checksum is verified, and committed once it is.
  *
- * @param gd      [OUT] the structure to be used for authentication
- * @param pstored [IN]  the stored value
+ * @param gd     [INOUT] the rpcsec_gss data, its seqlast and seqmask are updated
+ * @param seq    [IN]    the sequence number of the request
+ * @param commit [IN]    TRUE to mark the number as seen
  *
- * @return 1 is operation is a success, 0 otherwise
+ * @return TRUE if the number is in the window and not seen yet.
  *
  */
-static const char *gss_stored2data(struct svc_rpc_gss_data *gd,
-                                   struct svc_rpc_gss_data_stored *pstored)
+bool_t Gss_ctx_Seq_Check(struct svc_rpc_gss_data *gd, u_int seq, bool_t commit)
 {
-  OM_uint32 major;
-  OM_uint32 minor;
-
-  /* Get the data with a fixed size */
-  gd->established = pstored->established;
-  gd->sec = pstored->sec;
-  gd->seq = pstored->seq;
-  gd->win = pstored->win;
-  gd->seqlast = pstored->seqlast;
-  gd->seqmask = pstored->seqmask;
-
-  /* Get the gss_buffer_desc */
-  if(gd->cname.length <= pstored->cname_len && gd->cname.length != 0)
-    {
-      /* If the current buffer is too small, release it */
-      LogFullDebug(COMPONENT_RPCSEC_GSS,
-                   "gss_stored2data releasing cname.value=%p length was %d need %d",
-                   gd->cname.value, (int)gd->cname.length, (int)pstored->cname_len);
-      gss_release_buffer(&minor, &gd->cname);
-    }
-  if(gd->cname.value == NULL && pstored->cname_len != 0)
-    {
-      if((gd->cname.value = (void *)malloc(pstored->cname_len+1)) == NULL)
-        return "could not allocate cname";
-    }
-  memcpy(gd->cname.value, pstored->cname_val, pstored->cname_len);
-  ((char *)gd->cname.value)[pstored->cname_len] = '\0';
-  gd->cname.length = pstored->cname_len;
+  gss_ctx_cache_entry_t *pentry = gd->pcached;
+  uint64_t oldwin;
+  uint64_t newwin;
+  u_int seqlast;
+  uint32_t seqmask;
+  u_int offset;
 
-  if(gd->checksum.length < pstored->checksum_len && gd->checksum.length != 0)
-    {
-      /* If the current buffer is too small, release it */
-      LogFullDebug(COMPONENT_RPCSEC_GSS,
-                   "gss_stored2data releasing checksum.value=%p length was %d need %d",
-                   gd->checksum.value, (int)gd->checksum.length, (int)pstored->checksum_len);
-      gss_release_buffer(&minor, &gd->checksum);
-    }
-  if(gd->checksum.value == NULL && pstored->checksum_len != 0)
-    {
-      if((gd->checksum.value = (char *)malloc(pstored->checksum_len)) == NULL)
-        return "could not allocate checksum";
-    }
-  memcpy(gd->checksum.value, pstored->checksum_val, pstored->checksum_len);
-  gd->checksum.length = pstored->checksum_len;
+  if(pentry == NULL)
+    return FALSE;
 
-  /* Duplicate the gss_name */
-  if(gd->client_name)
+  do
     {
-      LogFullDebug(COMPONENT_RPCSEC_GSS,
-                   "gss_stored2data releasing client_name=%p",
-                   gd->client_name);
-      gss_release_name(&minor, &gd->client_name);
+      oldwin = pentry->seqwin;
+      seqlast = (u_int) (oldwin >> 32);
+      seqmask = (uint32_t) oldwin;
+
+      if(seq > seqlast)
+        {
+          /* The window slides */
+          offset = seq - seqlast;
+          seqmask = (offset >= 32) ? 0 : seqmask << offset;
+          seqlast = seq;
+          offset = 0;
+        }
+      else
+        {
+          offset = seqlast - seq;
+          if(offset >= pentry->win || offset >= 32 || (seqmask & (1U << offset)))
+            {
+              if(offset >= pentry->win || offset >= 32)
+                LogDebug(COMPONENT_RPCSEC_GSS,
+                         "BAD AUTH: the current seqnum is lower than seqlast by %u and out of the seq window of size %u.",
+                         offset, pentry->win);
+              else
+                LogDebug(COMPONENT_RPCSEC_GSS,
+                         "BAD AUTH: the current seqnum has already been used.");
+              return FALSE;
+            }
+        }
+
+      seqmask |= 1U << offset;
+
+      if(!commit)
+        break;
+
+      newwin = ((uint64_t) seqlast << 32) | seqmask;
     }
-  if((major = gss_duplicate_name(&minor,
-                                 pstored->client_name,
-                                 &gd->client_name)) != GSS_S_COMPLETE)
-    return "could not duplicate client_name";
+  while(!__sync_bool_compare_and_swap(&pentry->seqwin, oldwin, newwin));
 
-  /* Import the sec context */
-  gss_delete_sec_context(&minor, &gd->ctx, GSS_C_NO_BUFFER);
-  if((major = gss_import_sec_context(&minor,
-                                     &pstored->ctx_exported, &gd->ctx)) != GSS_S_COMPLETE)
-    return "could not import context";
+  gd->seqlast = seqlast;
+  gd->seqmask = seqmask;
 
-  return NULL;
-}                               /* gss_stored2data */
-
-hash_table_t *ht_gss_ctx;
+  return TRUE;
+}                               /* Gss_ctx_Seq_Check */
 
 /**
  *
@@ -311,66 +375,87 @@ int display_gss_ctx(hash_buffer_t * pbuff, char *str)
 
 int display_gss_svc_data(hash_buffer_t * pbuff, char *str)
 {
-  struct svc_rpc_gss_data_stored *gd;
+  gss_ctx_cache_entry_t *pentry;
 
-  gd = (struct svc_rpc_gss_data_stored *)pbuff->pdata;
+  pentry = (gss_ctx_cache_entry_t *) pbuff->pdata;
 
   return sprintf(str,
-                 "established=%u ctx=(%lu) sec=(mech=%p,qop=%u,svc=%u,cred=%p,flags=%u) cname=(%lu|%s) seq=%u win=%u seqlast=%u seqmask=%u",
-                 gd->established, (long unsigned int)gd->ctx_exported.length, gd->sec.mech, gd->sec.qop,
-                 gd->sec.svc, gd->sec.cred, gd->sec.req_flags, (long unsigned int)gd->cname_len,
-                 gd->cname_val, gd->seq, gd->win, gd->seqlast, gd->seqmask);
+                 "refcount=%u sec=(mech=%p,qop=%u,svc=%u,flags=%u) cname=(%lu|%.*s) win=%u seqlast=%u seqmask=%x",
+                 pentry->refcount, pentry->sec.mech, pentry->sec.qop,
+                 pentry->sec.svc, pentry->sec.req_flags,
+                 (long unsigned int)pentry->cname.length,
+                 (int)pentry->cname.length, (char *)pentry->cname.value,
+                 pentry->win, (u_int) (pentry->seqwin >> 32),
+                 (uint32_t) pentry->seqwin);
 }                               /* display_gss_svc_data */
 
 /**
  *
  * Gss_ctx_Hash_Set
  *
- * This routine sets a Gss Ctx into the Gss Context's hashtable.
+ * This routine moves the established context of gd into the Gss Context's
+ * cache. gd keeps using it, as a borrower: the context is no longer exported
+ * and imported at each request.
  *
  * @return 1 if ok, 0 otherwise.
  *
  */
 int Gss_ctx_Hash_Set(gss_union_ctx_id_desc *pgss_ctx, struct svc_rpc_gss_data *gd)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  struct svc_rpc_gss_data_stored *stored_gd;
+  gss_ctx_cache_entry_t *pentry;
+  gss_ctx_cache_entry_t **pbucket;
+  gss_ctx_cache_entry_t *piter;
+  gss_ctx_shard_t *pshard;
   char ctx_str[64];
   const char *failure;
 
-  sprint_ctx(ctx_str, (char *)pgss_ctx, sizeof(*pgss_ctx));
+  sprint_ctx(ctx_str, (unsigned char *)pgss_ctx, sizeof(*pgss_ctx));
 
-  if((buffkey.pdata = (caddr_t) Mem_Alloc(sizeof(*pgss_ctx))) == NULL)
+  if((pentry = (gss_ctx_cache_entry_t *) Mem_Alloc(sizeof(*pentry))) == NULL)
     {
       failure = "no memory for context";
       goto fail;
     }
 
-  memcpy(buffkey.pdata, pgss_ctx, sizeof(*pgss_ctx));
-  buffkey.len = sizeof(*pgss_ctx);
-
-  if((buffval.pdata =
-      (caddr_t) Mem_Alloc(sizeof(struct svc_rpc_gss_data_stored))) == NULL)
+  memset(pentry, 0, sizeof(*pentry));
+  pentry->key = *pgss_ctx;
+  pentry->ctx = gd->ctx;
+  pentry->client_name = gd->client_name;
+  pentry->cname = gd->cname;
+  pentry->sec = gd->sec;
+  pentry->win = gd->win;
+  pentry->seqwin = 0;
+  pentry->serialize =
+      (gd->sec.req_flags & (GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG)) != 0;
+  pentry->refcount = 2;         /* the cache and gd */
+  pthread_mutex_init(&pentry->ctx_mutex, NULL);
+
+  pshard = gss_ctx_shard(pgss_ctx, &pbucket);
+
+  P_w(&pshard->lock);
+
+  for(piter = *pbucket; piter != NULL; piter = piter->next)
+    if(piter->key.internal_ctx_id == pgss_ctx->internal_ctx_id &&
+       piter->key.mech_type == pgss_ctx->mech_type)
+      break;
+
+  if(piter != NULL)
     {
-      failure = "no memory for stored data";
+      V_w(&pshard->lock);
+      pthread_mutex_destroy(&pentry->ctx_mutex);
+      Mem_Free(pentry);
+      failure = "unable to set context";
       goto fail;
     }
 
-  stored_gd = (struct svc_rpc_gss_data_stored *)buffval.pdata;
-
-  failure = gss_data2stored(gd, stored_gd);
-  if(failure != NULL)
-    goto fail;
+  pentry->next = *pbucket;
+  *pbucket = pentry;
+  gss_ctx_nb_entries++;
 
+  V_w(&pshard->lock);
 
-  if(HashTable_Test_And_Set
-     (ht_gss_ctx, &buffkey, &buffval,
-      HASHTABLE_SET_HOW_SET_NO_OVERWRITE) != HASHTABLE_SUCCESS)
-    {
-      failure = "unable to set context";
-      goto fail;
-    }
+  /* gd now borrows what it owned */
+  gss_ctx_entry_lend(pentry, gd);
 
   LogFullDebug(COMPONENT_RPCSEC_GSS,
                "Gss context %s added to hash",
@@ -389,51 +474,51 @@ int Gss_ctx_Hash_Set(gss_union_ctx_id_desc *pgss_ctx, struct svc_rpc_gss_data *g
  *
  * Gss_ctx_Hash_Get
  *
- * This routine gets a Gss Ctx from the hashtable and returns
- * a pointers to a the established, seqlast, and seqmask variables
- * of the context.
+ * This routine finds a Gss Ctx in the cache and makes gd use it in place. The
+ * context gd used before is released. The sequence window stays in the cache
+ * entry, see Gss_ctx_Seq_Check.
  *
  * @return 1 if ok, 0 otherwise.
  *
  */
-int Gss_ctx_Hash_Get(gss_union_ctx_id_desc *pgss_ctx,
-		     struct svc_rpc_gss_data *gd,
-		     bool_t **established,
-		     u_int **seqlast,
-		     uint32_t **seqmask)
+int Gss_ctx_Hash_Get(gss_union_ctx_id_desc *pgss_ctx, struct svc_rpc_gss_data *gd)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  struct svc_rpc_gss_data_stored *stored_gd;
+  gss_ctx_cache_entry_t **pbucket;
+  gss_ctx_cache_entry_t *pentry;
+  gss_ctx_shard_t *pshard;
   char ctx_str[64];
-  const char *failure;
 
-  sprint_ctx(ctx_str, (char *)pgss_ctx, sizeof(*pgss_ctx));
+  if(pgss_ctx == NULL)
+    return 0;
+
+  pshard = gss_ctx_shard(pgss_ctx, &pbucket);
 
-  buffkey.pdata = (caddr_t) pgss_ctx;
-  buffkey.len = sizeof(gss_union_ctx_id_desc);
+  P_r(&pshard->lock);
 
-  if(HashTable_Get(ht_gss_ctx, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+  for(pentry = *pbucket; pentry != NULL; pentry = pentry->next)
+    if(pentry->key.internal_ctx_id == pgss_ctx->internal_ctx_id &&
+       pentry->key.mech_type == pgss_ctx->mech_type)
+      break;
+
+  /* The transport already uses it, most of the time */
+  if(pentry != NULL && pentry != gd->pcached)
+    __sync_add_and_fetch(&pentry->refcount, 1);
+
+  V_r(&pshard->lock);
+
+  if(pentry == NULL)
     {
+      sprint_ctx(ctx_str, (unsigned char *)pgss_ctx, sizeof(*pgss_ctx));
       LogCrit(COMPONENT_RPCSEC_GSS,
               "Gss context %s could not be found in hash",
               ctx_str);
       return 0;
     }
 
-  stored_gd = (struct svc_rpc_gss_data_stored *)buffval.pdata;
-  failure = gss_stored2data(gd, stored_gd);
-  if(failure != NULL)
-    {
-      LogCrit(COMPONENT_RPCSEC_GSS,
-              "Gss context %s could not be recovered from hash because %s",
-              ctx_str, failure);
-      return 0;
-    }
+  if(pentry != gd->pcached)
+    Gss_ctx_Hash_Release(gd);
 
-  *established = &stored_gd->established;
-  *seqlast = &stored_gd->seqlast;
-  *seqmask = &stored_gd->seqmask;
+  gss_ctx_entry_lend(pentry, gd);
 
   return 1;
 }                               /* Gss_ctx_Hash_Get */
@@ -442,45 +527,81 @@ int Gss_ctx_Hash_Get(gss_union_ctx_id_desc *pgss_ctx,
  *
  * Gss_ctx_Hash_Del
  *
- * This routine removes a state from the Gss ctx hashtable.
+ * This routine removes a context from the Gss ctx cache. It is deleted when
+ * the last transport that uses it lets it go.
  *
  * @return 1 if ok, 0 otherwise.
  *
  */
 int Gss_ctx_Hash_Del(gss_union_ctx_id_desc * pgss_ctx)
 {
-  hash_buffer_t buffkey, old_key, old_value;
+  gss_ctx_cache_entry_t **pbucket;
+  gss_ctx_cache_entry_t **ppentry;
+  gss_ctx_cache_entry_t *pentry = NULL;
+  gss_ctx_shard_t *pshard;
 
-  buffkey.pdata = (caddr_t) pgss_ctx;
-  buffkey.len = sizeof(gss_union_ctx_id_desc);
+  if(pgss_ctx == NULL)
+    return 0;
 
-  if(HashTable_Del(ht_gss_ctx, &buffkey, &old_key, &old_value) == HASHTABLE_SUCCESS)
-    {
-      /* free the key that was stored in hash table */
-      Mem_Free((void *)old_key.pdata);
-      Mem_Free((void *)old_value.pdata);
+  pshard = gss_ctx_shard(pgss_ctx, &pbucket);
 
-      return 1;
-    }
-  else
+  P_w(&pshard->lock);
+
+  for(ppentry = pbucket; *ppentry != NULL; ppentry = &(*ppentry)->next)
+    if((*ppentry)->key.internal_ctx_id == pgss_ctx->internal_ctx_id &&
+       (*ppentry)->key.mech_type == pgss_ctx->mech_type)
+      {
+        pentry = *ppentry;
+        *ppentry = pentry->next;
+        gss_ctx_nb_entries--;
+        break;
+      }
+
+  V_w(&pshard->lock);
+
+  if(pentry == NULL)
     return 0;
+
+  gss_ctx_entry_unref(pentry);
+
+  return 1;
 }                               /* Gss_ctx_Hash_Del */
 
 /**
  *
- * Gss_ctx_Hash_Init: Init the hashtable for GSS Ctx
+ * Gss_ctx_Hash_Init: Init the cache for GSS Ctx
  *
- * Perform all the required initialization for hashtable Gss ctx cache
+ * Perform all the required initialization for the Gss ctx cache. Each shard
+ * gets hash_param.index_size buckets.
  *
  * @return 0 if successful, -1 otherwise
  *
  */
 int Gss_ctx_Hash_Init(nfs_krb5_parameter_t param)
 {
-  if((ht_gss_ctx = HashTable_Init(param.hash_param)) == NULL)
+  unsigned int i;
+
+  gss_ctx_nb_buckets = param.hash_param.index_size;
+  if(gss_ctx_nb_buckets == 0)
+    gss_ctx_nb_buckets = 1;
+
+  for(i = 0; i < GSS_CTX_SHARDS; i++)
     {
-      LogCrit(COMPONENT_RPCSEC_GSS, "GSS_CTX_HASH: Cannot init GSS CTX  cache");
-      return -1;
+      if(rw_lock_init(&gss_ctx_shards[i].lock) != 0)
+        {
+          LogCrit(COMPONENT_RPCSEC_GSS, "GSS_CTX_HASH: Cannot init GSS CTX  cache");
+          return -1;
+        }
+
+      gss_ctx_shards[i].buckets = (gss_ctx_cache_entry_t **)
+          Mem_Alloc(gss_ctx_nb_buckets * sizeof(gss_ctx_cache_entry_t *));
+      if(gss_ctx_shards[i].buckets == NULL)
+        {
+          LogCrit(COMPONENT_RPCSEC_GSS, "GSS_CTX_HASH: Cannot init GSS CTX  cache");
+          return -1;
+        }
+      memset(gss_ctx_shards[i].buckets, 0,
+             gss_ctx_nb_buckets * sizeof(gss_ctx_cache_entry_t *));
     }
 
   return 0;
@@ -488,14 +609,47 @@ int Gss_ctx_Hash_Init(nfs_krb5_parameter_t param)
 
 /**
  *
- * Gss_ctx_Hash_Print: Displays the content of the hash table (for debugging)
+ * Gss_ctx_Hash_Print: Displays the content of the cache (for debugging)
  *
- * Displays the content of the hash table (for debugging).
+ * Displays the content of the cache (for debugging).
  *
  * @return nothing (void function)
  *
  */
 void Gss_ctx_Hash_Print(void)
 {
-  HashTable_Log(COMPONENT_RPCSEC_GSS, ht_gss_ctx);
+  gss_ctx_cache_entry_t *pentry;
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  char key_str[HASHTABLE_DISPLAY_STRLEN];
+  char val_str[HASHTABLE_DISPLAY_STRLEN];
+  unsigned int i;
+  unsigned int j;
+
+  LogFullDebug(COMPONENT_RPCSEC_GSS,
+               "GSS context cache: %u contexts in %u shards",
+               gss_ctx_nb_entries, GSS_CTX_SHARDS);
+
+  for(i = 0; i < GSS_CTX_SHARDS; i++)
+    {
+      P_r(&gss_ctx_shards[i].lock);
+
+      for(j = 0; j < gss_ctx_nb_buckets; j++)
+        for(pentry = gss_ctx_shards[i].buckets[j]; pentry != NULL; pentry = pentry->next)
+          {
+            buffkey.pdata = (caddr_t) & pentry->key;
+            buffkey.len = sizeof(pentry->key);
+            buffval.pdata = (caddr_t) pentry;
+            buffval.len = sizeof(*pentry);
+
+            display_gss_ctx(&buffkey, key_str);
+            display_gss_svc_data(&buffval, val_str);
+
+            LogFullDebug(COMPONENT_RPCSEC_GSS,
+                         "shard=%u bucket=%u key=%s val=%s",
+                         i, j, key_str, val_str);
+          }
+
+      V_r(&gss_ctx_shards[i].lock);
+    }
 }                               /* Gss_ctx_Hash_Print */
@@ -311,6 +311,9 @@ Svcauth_gss_accept_sec_context(struct svc_req *rqst, struct rpc_gss_init_res *gr
 
   if(gr->gr_major == GSS_S_COMPLETE)
     {
+      /* Tells if the context checks the sequence of the tokens */
+      gd->sec.req_flags = ret_flags;
+
 #ifdef SPKM
       /* spkm3: no src_name (anonymous) */
       if(!g_OID_equal(gss_mech_spkm3, mech))
@@ -462,7 +465,9 @@ Svcauth_gss_validate(struct svc_req *rqst, struct svc_rpc_gss_data *gd,
                    checksum.value, (unsigned int) checksum.length);
     }
 
+  Gss_ctx_Lock(gd, FALSE);
   maj_stat = gss_verify_mic(&min_stat, gd->ctx, &rpcbuf, &checksum, &qop_state);
+  Gss_ctx_Unlock(gd, FALSE);
 
   if(maj_stat != GSS_S_COMPLETE)
     {
@@ -489,7 +494,9 @@ static bool_t Svcauth_gss_nextverf(struct svc_req *rqst, u_int num)
   signbuf.value = &num;
   signbuf.length = sizeof(num);
 
+  Gss_ctx_Lock(gd, TRUE);
   maj_stat = gss_get_mic(&min_stat, gd->ctx, gd->sec.qop, &signbuf, &gd->checksum);
+  Gss_ctx_Unlock(gd, TRUE);
 
   if(maj_stat != GSS_S_COMPLETE)
     {
@@ -513,18 +520,11 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
   struct svc_rpc_gss_data *gd;
   struct rpc_gss_cred *gc;
   struct rpc_gss_init_res gr;
-  int call_stat, offset;
+  int call_stat;
   OM_uint32 min_stat;
   gss_union_ctx_id_desc *gss_ctx_data;
   char ctx_str[64];
 
-  /* Used to update the hashtable entries. 
-   * These should not be used for purposes other than updating
-   * hashtable entries. */
-  bool_t *p_established = NULL;
-  u_int *p_seqlast = NULL;
-  uint32_t *p_seqmask = NULL;
-
   /* Initialize reply. */
   LogFullDebug(COMPONENT_RPCSEC_GSS, "Gssrpc__svcauth_gss called");
 
@@ -579,7 +579,8 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
     }
 
   /* If we do not retrieve gss data from the cache, then this important
-   * variables could not possibly be meaningful. */
+   * variables could not possibly be meaningful. The transport keeps the
+   * context it borrowed, the next request is likely to use it again. */
   gd->seqlast = 0;
   gd->seqmask = 0;
   gd->established = 0;
@@ -597,12 +598,8 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
       
       LogFullDebug(COMPONENT_RPCSEC_GSS, "Getting gss data struct from hashtable.");
       
-      /* Fill in svc_rpc_gss_data from cache */
-      if(!Gss_ctx_Hash_Get(gss_ctx_data,
-			   gd,
-			   &p_established,
-			   &p_seqlast,
-			   &p_seqmask))
+      /* Make svc_rpc_gss_data use the cached context */
+      if(!Gss_ctx_Hash_Get(gss_ctx_data, gd))
 	{
           LogCrit(COMPONENT_RPCSEC_GSS, "Could not find gss context ");
           ret_freegc(AUTH_REJECTEDCRED);
@@ -663,32 +660,14 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
 	  ret_freegc(RPCSEC_GSS_CTXPROBLEM);
 	}
 
-      /* Check the difference between the current sequence number 
-       * and the last sequence number. */
-      LogFullDebug(COMPONENT_RPCSEC_GSS, "seqlast: %d  seqnum: %d offset: %d seqwin: %d seqmask: %x",
-		   gd->seqlast, gc->gc_seq, gd->seqlast - gc->gc_seq, gd->win, gd->seqmask);
-
-      if((offset = gd->seqlast - gc->gc_seq) < 0)
+      /* Drop replays and numbers out of the window before their checksum is
+       * verified, the number is committed once it is */
+      if(!Gss_ctx_Seq_Check(gd, gc->gc_seq, FALSE))
         {
-          gd->seqlast = gc->gc_seq;
-          offset = 0 - offset;
-          gd->seqmask <<= offset;
-          offset = 0;
-        }
-      else if((unsigned int)offset >= gd->win
-              || (gd->seqmask & (1 << (unsigned int)offset)))
-        {
-	  if ((unsigned int)offset >= gd->win)
-	    LogDebug(COMPONENT_RPCSEC_GSS, "BAD AUTH: the current seqnum is lower"
-		     " than seqlast by %d and out of the seq window of size %d.", offset, gd->win);
-	  else
-	    LogDebug(COMPONENT_RPCSEC_GSS, "BAD AUTH: the current seqnum has already been used.");
-
           *no_dispatch = TRUE;
           ret_freegc(RPCSEC_GSS_CTXPROBLEM);
         }
       gd->seq = gc->gc_seq;
-      gd->seqmask |= (1 << offset);
     }
 
   if(gd->established)
@@ -715,6 +694,10 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
 	  ret_freegc(AUTH_FAILED);        /* XXX ? */
 	}
 
+      /* A new context is negotiated, not the cached one the transport used */
+      if(gd->pcached != NULL)
+        Gss_ctx_Hash_Release(gd);
+
       if(!Svcauth_gss_acquire_cred())
 	{
 	  LogFullDebug(COMPONENT_RPCSEC_GSS, "BAD AUTH: Can't acquire credentials from RPC request.");
@@ -787,13 +770,12 @@ Gssrpc__svcauth_gss(struct svc_req *rqst, struct rpc_msg *msg, bool_t * no_dispa
 	  ret_freegc(AUTH_FAILED);
 	}
 
-      /* Update a few important values in the hashtable entry */
-      if ( p_established != NULL)
-	*p_established = gd->established;
-      if ( p_seqlast != NULL)
-	*p_seqlast = gd->seqlast;
-      if (p_seqmask != NULL)
-	*p_seqmask = gd->seqmask;
+      /* A request with the same number may have been verified meanwhile */
+      if(!Gss_ctx_Seq_Check(gd, gc->gc_seq, TRUE))
+        {
+          *no_dispatch = TRUE;
+          ret_freegc(RPCSEC_GSS_CTXPROBLEM);
+        }
 
       break;
 
@@ -863,14 +845,11 @@ static bool_t Svcauth_gss_destroy(SVCAUTH * auth)
 
   gd = SVCAUTH_PRIVATE(auth);
 
-  gss_delete_sec_context(&min_stat, &gd->ctx, GSS_C_NO_BUFFER);
+  /* Gives the cached context back, or deletes the one of its own */
+  Gss_ctx_Hash_Release(gd);
 
-  gss_release_buffer(&min_stat, &gd->cname);
   gss_release_buffer(&min_stat, &gd->checksum);
 
-  if(gd->client_name)
-    gss_release_name(&min_stat, &gd->client_name);
-
   Mem_Free(gd);
   Mem_Free(auth);
 
@@ -1093,6 +1072,7 @@ static bool_t
 Svcauth_gss_wrap(SVCAUTH * auth, XDR * xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr)
 {
   struct svc_rpc_gss_data *gd;
+  bool_t rc;
 
   gd = SVCAUTH_PRIVATE(auth);
 
@@ -1100,19 +1080,25 @@ Svcauth_gss_wrap(SVCAUTH * auth, XDR * xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr
     {
       return ((*xdr_func) (xdrs, xdr_ptr));
     }
+
+  Gss_ctx_Lock(gd, TRUE);
 #ifndef DONT_USE_WRAPUNWRAP
-  return (Xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
-                           gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq));
+  rc = Xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
+                        gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq);
 #else
-  return (xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
-                           gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq));
+  rc = xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
+                        gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq);
 #endif
+  Gss_ctx_Unlock(gd, TRUE);
+
+  return rc;
 }
 
 static bool_t
 Svcauth_gss_unwrap(SVCAUTH * auth, XDR * xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr)
 {
   struct svc_rpc_gss_data *gd;
+  bool_t rc;
 
   gd = SVCAUTH_PRIVATE(auth);
 
@@ -1120,13 +1106,18 @@ Svcauth_gss_unwrap(SVCAUTH * auth, XDR * xdrs, xdrproc_t xdr_func, caddr_t xdr_p
     {
       return ((*xdr_func) (xdrs, xdr_ptr));
     }
+
+  Gss_ctx_Lock(gd, FALSE);
 #ifndef DONT_USE_WRAPUNWRAP
-  return (Xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
-                           gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq));
+  rc = Xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
+                        gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq);
 #else
-  return (xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
-                           gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq));
+  rc = xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr,
+                        gd->ctx, gd->sec.qop, gd->sec.svc, gd->seq);
 #endif
+  Gss_ctx_Unlock(gd, FALSE);
+
+  return rc;
 }
 
 int copy_svc_authgss(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig)
@@ -1157,10 +1148,19 @@ int copy_svc_authgss(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig)
           /* Leave the original without the various pointed to things */
           gd_o->checksum.length = 0;
           gd_o->checksum.value  = NULL;
-          gd_o->cname.length    = 0;
-          gd_o->cname.value     = NULL;
-          gd_o->client_name     = NULL;
-          gd_o->ctx             = NULL;
+
+          if(gd_o->pcached != NULL)
+            {
+              /* Both use the cached context */
+              Gss_ctx_Hash_Ref(gd_o);
+            }
+          else
+            {
+              gd_o->cname.length    = 0;
+              gd_o->cname.value     = NULL;
+              gd_o->client_name     = NULL;
+              gd_o->ctx             = NULL;
+            }
 
           /* fill in xp_auth */
           xprt_copy->xp_auth->svc_ah_private = (void *)gd_c;
@@ -196,7 +196,18 @@ void FreeXprt(SVCXPRT *xprt)
   else if (xprt->xp_ops == &vc_ops)
     {
       struct cf_conn *cd = (struct cf_conn *)xprt->xp_p1;
-      XDR_DESTROY(&(cd->xdrs));
+      if(cd)
+        {
+          struct vc_outbuf *pbuf, *pnext;
+
+          XDR_DESTROY(&(cd->xdrs));
+          for(pbuf = cd->stage_head; pbuf != NULL; pbuf = pnext)
+            {
+              pnext = pbuf->next;
+              Mem_Free(pbuf);
+            }
+          Svc_vc_outq_release(cd->outq);
+        }
       xp_free(xprt->xp_p1); /* cd */
     }
   else if (xprt->xp_ops == &rendezvous_ops)
@@ -306,6 +317,9 @@ SVCXPRT *Svcxprt_copy(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig)
         goto fail;
       memcpy(cd_c, cd_o, sizeof(*cd_c));
       xprt_copy->xp_p1 = cd_c;
+      /* Replies of the copy go through the queue of the connection */
+      cd_c->outq = Svc_vc_outq_get(cd_o->outq);
+      cd_c->stage_head = cd_c->stage_tail = NULL;
 #ifndef NO_XDRREC_PATCH
       Xdrrec_create(&(cd_c->xdrs), cd_c->sendsize, cd_c->recvsize, xprt_copy, Read_vc, Write_vc);
 #else
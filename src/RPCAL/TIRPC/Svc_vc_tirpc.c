@@ -84,6 +84,9 @@ static bool_t Svc_vc_recv(SVCXPRT *, struct rpc_msg *);
 static bool_t Svc_vc_getargs(SVCXPRT *, xdrproc_t, void *);
 static bool_t Svc_vc_freeargs(SVCXPRT *, xdrproc_t, void *);
 static bool_t Svc_vc_reply(SVCXPRT *, struct rpc_msg *);
+static struct vc_outq *Svc_vc_outq_create(int);
+static void Svc_vc_outbuf_free(struct vc_outbuf *);
+static bool_t Svc_vc_outq_commit(struct cf_conn *);
 static void Svc_vc_rendezvous_ops(SVCXPRT *);
 static void Svc_vc_ops(SVCXPRT *);
 static bool_t Svc_vc_control(SVCXPRT * xprt, const u_int rq, void *in);
@@ -199,12 +202,18 @@ static SVCXPRT *Makefd_xprt(int fd, u_int sendsize, u_int recvsize)
     goto fail;
   xprt->xp_p1 = cd;
 
+  cd->stage_head = cd->stage_tail = NULL;
+  cd->outq = NULL;
+
   cd->strm_stat = XPRT_IDLE;
 #ifndef NO_XDRREC_PATCH
   Xdrrec_create(&(cd->xdrs), sendsize, recvsize, xprt, Read_vc, Write_vc);
 #else
   xdrrec_create(&(cd->xdrs), sendsize, recvsize, xprt, Read_vc, Write_vc);
 #endif
+  cd->outq = Svc_vc_outq_create(fd);
+  if(cd->outq == NULL)
+    goto fail;
   xprt->xp_verf.oa_base = cd->verf_body;
   xprt->xp_port = 0;            /* this is a connection, not a rendezvouser */
   xprt->xp_fd = fd;
@@ -345,7 +354,32 @@ void Svc_vc_destroy(SVCXPRT *xprt)
 
 void __Svc_vc_dodestroy(SVCXPRT *xprt)
 {
-  if(xprt->xp_fd != RPC_ANYFD)
+  struct cf_conn *cd = (struct cf_conn *)xprt->xp_p1;
+
+  bool_t close_fd = TRUE;
+
+  /* Copies held by the workers may outlive the connection, stop their replies */
+  if(cd != NULL && cd->outq != NULL)
+    {
+      pthread_mutex_lock(&cd->outq->mutex);
+      cd->outq->dead = TRUE;
+      Svc_vc_outbuf_free(cd->outq->head);
+      cd->outq->head = cd->outq->tail = NULL;
+      LogFullDebug(COMPONENT_RPC,
+                   "Connection fd=%d sent %llu replies in %llu sends",
+                   xprt->xp_fd, cd->outq->nb_records, cd->outq->nb_sends);
+
+      /* A sender may still be writing to the fd, it closes it once done so
+       * that the fd number is not reused by another client meanwhile */
+      if(cd->outq->flushing && cd->outq->fd == xprt->xp_fd)
+        {
+          cd->outq->close_pending = TRUE;
+          close_fd = FALSE;
+        }
+      pthread_mutex_unlock(&cd->outq->mutex);
+    }
+
+  if(close_fd && xprt->xp_fd != RPC_ANYFD)
     (void)close(xprt->xp_fd);
   FreeXprt(xprt);
 }
@@ -376,6 +410,269 @@ bool_t Svc_vc_rendezvous_control(SVCXPRT *xprt, const u_int rq, void *in)
   return (TRUE);
 }
 
+/*
+ * Output queue of a connection.
+ */
+#define VC_OUTQ_IOV 64
+
+static struct vc_outq *Svc_vc_outq_create(int fd)
+{
+  struct vc_outq *q;
+
+  q = (struct vc_outq *)Mem_Alloc(sizeof(struct vc_outq));
+  if(q == NULL)
+    return NULL;
+
+  memset(q, 0, sizeof(struct vc_outq));
+  pthread_mutex_init(&q->mutex, NULL);
+  q->fd = fd;
+  q->refcount = 1;
+
+  return q;
+}
+
+struct vc_outq *Svc_vc_outq_get(struct vc_outq *q)
+{
+  if(q == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&q->mutex);
+  q->refcount++;
+  pthread_mutex_unlock(&q->mutex);
+
+  return q;
+}
+
+static void Svc_vc_outbuf_free(struct vc_outbuf *pbuf)
+{
+  struct vc_outbuf *pnext;
+
+  for(; pbuf != NULL; pbuf = pnext)
+    {
+      pnext = pbuf->next;
+      Mem_Free(pbuf);
+    }
+}
+
+void Svc_vc_outq_release(struct vc_outq *q)
+{
+  int refcount;
+
+  if(q == NULL)
+    return;
+
+  pthread_mutex_lock(&q->mutex);
+  refcount = --q->refcount;
+  pthread_mutex_unlock(&q->mutex);
+
+  if(refcount == 0)
+    {
+      Svc_vc_outbuf_free(q->head);
+      pthread_mutex_destroy(&q->mutex);
+      Mem_Free(q);
+    }
+}
+
+/*
+ * Sends an iovec array entirely, with MSG_MORE if more data is known to
+ * follow right away. Called by the sender of the queue only.
+ */
+static bool_t Svc_vc_outq_sendmsg(struct vc_outq *q, int fd,
+                                  struct iovec *iov, int iovcnt,
+                                  bool_t more, bool_t nonblock)
+{
+  struct msghdr msg;
+  struct pollfd pollfd;
+  struct timeval tv0, tv1;
+  int i, flags;
+  ssize_t sent;
+
+  if(nonblock)
+    gettimeofday(&tv0, NULL);
+
+  flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_MORE
+  if(more)
+    flags |= MSG_MORE;
+#endif
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+
+  while(msg.msg_iovlen > 0)
+    {
+      sent = sendmsg(fd, &msg, flags);
+      if(sent < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          if(errno != EAGAIN || !nonblock)
+            return FALSE;
+
+          /*
+           * For non-blocking connections, do not
+           * take more than 2 seconds writing the
+           * data out.
+           */
+          gettimeofday(&tv1, NULL);
+          if(tv1.tv_sec - tv0.tv_sec >= 2)
+            return FALSE;
+
+          pollfd.fd = fd;
+          pollfd.events = POLLOUT;
+          pollfd.revents = 0;
+          (void)poll(&pollfd, 1, 100);
+          continue;
+        }
+
+      q->nb_sends++;
+
+      /* Skip what was sent, a short send may stop inside an iovec */
+      for(i = 0; i < (int)msg.msg_iovlen && sent >= (ssize_t)msg.msg_iov[i].iov_len; i++)
+        sent -= msg.msg_iov[i].iov_len;
+      msg.msg_iov += i;
+      msg.msg_iovlen -= i;
+      if(msg.msg_iovlen > 0)
+        {
+          msg.msg_iov[0].iov_base = (char *)msg.msg_iov[0].iov_base + sent;
+          msg.msg_iov[0].iov_len -= sent;
+        }
+    }
+
+  return TRUE;
+}
+
+/*
+ * Sends a list of records with as few sendmsg as possible. MSG_MORE is set
+ * when more data is known to follow right away (the list does not fit in
+ * one sendmsg, or other replies were queued meanwhile), so that the kernel
+ * fills the segments; the last send of a flush always pushes the data.
+ */
+static bool_t Svc_vc_outq_write(struct vc_outq *q, int fd,
+                                struct vc_outbuf *pbuf, bool_t nonblock)
+{
+  struct iovec iov[VC_OUTQ_IOV];
+  int iovcnt;
+
+  while(pbuf != NULL)
+    {
+      for(iovcnt = 0; pbuf != NULL && iovcnt < VC_OUTQ_IOV; pbuf = pbuf->next, iovcnt++)
+        {
+          iov[iovcnt].iov_base = pbuf->data;
+          iov[iovcnt].iov_len = pbuf->len;
+        }
+
+      /* Unlocked peek, a stale value only costs a push */
+      if(!Svc_vc_outq_sendmsg(q, fd, iov, iovcnt,
+                              pbuf != NULL || q->head != NULL, nonblock))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * The sender is done with the queue. If the connection was closed while it
+ * was sending, the fd is closed now. Called with the queue mutex held.
+ */
+static void Svc_vc_outq_done(struct vc_outq *q)
+{
+  q->flushing = FALSE;
+
+  if(q->close_pending)
+    {
+      (void)close(q->fd);
+      q->close_pending = FALSE;
+    }
+}
+
+/*
+ * Moves the staged record of a connection (or copy) to the output queue of
+ * the connection. If nobody is sending, the caller becomes the sender and
+ * sends all the queued records until the queue is empty; otherwise the
+ * current sender will pick the record up with the next batch.
+ */
+static bool_t Svc_vc_outq_commit(struct cf_conn *cd)
+{
+  struct vc_outq *q = cd->outq;
+  struct vc_outbuf *pbatch;
+  int fd;
+  bool_t rc;
+
+  if(cd->stage_head == NULL && !cd->sending)
+    return TRUE;
+
+  pthread_mutex_lock(&q->mutex);
+
+  if(cd->sending)
+    {
+      /* The record went out as it was encoded, the caller is the sender */
+      cd->sending = FALSE;
+      q->nb_records++;
+    }
+  else
+    {
+      if(q->dead)
+        {
+          pthread_mutex_unlock(&q->mutex);
+          Svc_vc_outbuf_free(cd->stage_head);
+          cd->stage_head = cd->stage_tail = NULL;
+          return FALSE;
+        }
+
+      if(q->tail == NULL)
+        q->head = cd->stage_head;
+      else
+        q->tail->next = cd->stage_head;
+      q->tail = cd->stage_tail;
+      cd->stage_head = cd->stage_tail = NULL;
+      q->nb_records++;
+
+      if(q->flushing)
+        {
+          pthread_mutex_unlock(&q->mutex);
+          return TRUE;
+        }
+
+      q->flushing = TRUE;
+    }
+
+  fd = q->fd;
+
+  while(q->head != NULL && !q->dead)
+    {
+      pbatch = q->head;
+      q->head = q->tail = NULL;
+      pthread_mutex_unlock(&q->mutex);
+
+      rc = Svc_vc_outq_write(q, fd, pbatch, cd->nonblock);
+      Svc_vc_outbuf_free(pbatch);
+
+      pthread_mutex_lock(&q->mutex);
+      if(!rc)
+        q->dead = TRUE;
+    }
+
+  if(q->dead)
+    {
+      Svc_vc_outbuf_free(q->head);
+      q->head = q->tail = NULL;
+    }
+
+  rc = !q->dead;
+  Svc_vc_outq_done(q);
+  pthread_mutex_unlock(&q->mutex);
+
+  if(!rc)
+    cd->strm_stat = XPRT_DIED;
+
+  return rc;
+}
+
 /*
  * reads data from the tcp or uip connection.
  * any error is fatal and the connection is closed.
@@ -459,6 +756,81 @@ int Write_vc(void *xprtp, void *buf, int len)
 
   cd = (struct cf_conn *)xprt->xp_p1;
 
+  if(cd->outq != NULL)
+    {
+      struct vc_outq *q = cd->outq;
+      struct vc_outbuf *pbuf;
+      struct iovec iov;
+      bool_t last;
+
+      pthread_mutex_lock(&q->mutex);
+
+      if(q->dead)
+        {
+          if(cd->sending)
+            {
+              cd->sending = FALSE;
+              Svc_vc_outq_done(q);
+            }
+          pthread_mutex_unlock(&q->mutex);
+          cd->strm_stat = XPRT_DIED;
+          return (-1);
+        }
+
+      /* Nobody else is sending, nothing is waiting: the fragment is sent
+       * from the caller's buffer, and the whole record goes out this way
+       * as the caller stays the sender until Svc_vc_outq_commit */
+      if(!cd->sending && !q->flushing && q->head == NULL && cd->stage_head == NULL)
+        {
+          q->flushing = TRUE;
+          cd->sending = TRUE;
+        }
+
+      pthread_mutex_unlock(&q->mutex);
+
+      if(cd->sending)
+        {
+          /* Push at the end of the record only, see Xdrrec_endofrecord */
+          last = (len >= (int)sizeof(u_int32_t) &&
+                  (ntohl(*(u_int32_t *) buf) & 0x80000000) != 0);
+
+          iov.iov_base = buf;
+          iov.iov_len = len;
+          if(Svc_vc_outq_sendmsg(q, q->fd, &iov, 1, !last, cd->nonblock))
+            return (len);
+
+          pthread_mutex_lock(&q->mutex);
+          q->dead = TRUE;
+          Svc_vc_outbuf_free(q->head);
+          q->head = q->tail = NULL;
+          cd->sending = FALSE;
+          Svc_vc_outq_done(q);
+          pthread_mutex_unlock(&q->mutex);
+          cd->strm_stat = XPRT_DIED;
+          return (-1);
+        }
+
+      /* Another reply is being sent, keep the fragment until the record
+       * is complete, see Svc_vc_reply */
+      pbuf = (struct vc_outbuf *)Mem_Alloc(sizeof(struct vc_outbuf) + len);
+      if(pbuf == NULL)
+        {
+          cd->strm_stat = XPRT_DIED;
+          return (-1);
+        }
+      pbuf->next = NULL;
+      pbuf->len = len;
+      memcpy(pbuf->data, buf, len);
+
+      if(cd->stage_tail == NULL)
+        cd->stage_head = pbuf;
+      else
+        cd->stage_tail->next = pbuf;
+      cd->stage_tail = pbuf;
+
+      return (len);
+    }
+
   if(cd->nonblock)
     gettimeofday(&tv0, NULL);
 
@@ -607,6 +979,11 @@ bool_t Svc_vc_reply(SVCXPRT *xprt, struct rpc_msg *msg)
       stat = TRUE;
     }
   (void)Xdrrec_endofrecord(xdrs, TRUE);
+
+  /* The whole record is staged, queue it as one piece */
+  if(cd->outq != NULL && !Svc_vc_outq_commit(cd))
+    stat = FALSE;
+
   return (stat);
 }
 
@@ -29,6 +29,32 @@ struct cf_rendezvous
   int maxrec;
 };
 
+/*
+ * Replies on a connection are not written by the workers themselves: they
+ * are queued on the connection, and whoever finds nobody sending takes all
+ * the queued replies and sends them with a single sendmsg.
+ */
+struct vc_outbuf
+{
+  struct vc_outbuf *next;
+  int len;
+  char data[];
+};
+
+struct vc_outq
+{                               /* shared by a connection and its copies */
+  pthread_mutex_t mutex;
+  int fd;
+  int refcount;
+  bool_t flushing;              /* someone is sending, just queue */
+  bool_t dead;                  /* a send failed or the connection is closed */
+  bool_t close_pending;         /* closed while flushing, the sender closes fd */
+  struct vc_outbuf *head;
+  struct vc_outbuf *tail;
+  unsigned long long nb_records;
+  unsigned long long nb_sends;
+};
+
 struct cf_conn
 {                               /* kept in xprt->xp_p1 for actual connection */
   enum xprt_stat strm_stat;
@@ -40,6 +66,10 @@ struct cf_conn
   int maxrec;
   bool_t nonblock;
   struct timeval last_recv_time;
+  struct vc_outq *outq;
+  struct vc_outbuf *stage_head; /* fragments of the reply being encoded */
+  struct vc_outbuf *stage_tail;
+  bool_t sending;               /* the reply being encoded is sent as it goes */
 };
 
 #define	SPARSENESS 4            /* 75% sparse */
@@ -95,6 +125,8 @@ extern pthread_mutex_t dupreq_lock;
 extern int Svc_dg_enablecache(SVCXPRT *, u_int);
 extern int Read_vc(void *, void *, int);
 extern int Write_vc(void *, void *, int);
+extern struct vc_outq *Svc_vc_outq_get(struct vc_outq *);
+extern void Svc_vc_outq_release(struct vc_outq *);
 
 #ifndef NO_XDRREC_PATCH
 extern void Xdrrec_create(XDR *xdrs,
@@ -270,6 +270,9 @@ static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
   if (nfs_req_status == NFS_REQ_OK)
     funcdesc.free_function(&(pdupreq->res_nfs));
 
+  /* The entry must not expire once back in the pool */
+  timer_wheel_cancel(&pdupreq->dupreq_timer);
+
   /* Send the entry back to the pool */
   ReleaseToPool(pdupreq, dupreq_pool);
   Mem_Free(usedbuffkey.pdata);
@@ -512,6 +515,8 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
  *
  * @param xid [IN] the transfer id to be used as key
  * @param pnfsreq [IN] the request pointer to cache
+ * @param lru_dupreq [INOUT] the worker's LRU the entry is added to
+ * @param pexpired [INOUT] the worker's queue the entry is delivered to when it expires
  *
  * @return DUPREQ_SUCCESS if successfull\n.
  * @return DUPREQ_INSERT_MALLOC_ERROR if an error occured during the insertion process.
@@ -576,6 +581,7 @@ int nfs_dupreq_add_not_finished(long xid,
   pdupreq->rq_proc = ptr_req->rq_proc;
   pdupreq->timestamp = time(NULL);
   pdupreq->processing = 1;
+  timer_wheel_entry_init(&pdupreq->dupreq_timer, NULL, pdupreq, NULL);
   buffdata.pdata = (caddr_t) pdupreq;
   buffdata.len = sizeof(dupreq_entry_t);
 
@@ -635,7 +641,8 @@ int nfs_dupreq_finish(long xid,
                       struct svc_req *ptr_req,
                       SVCXPRT *xprt,
                       nfs_res_t * p_res_nfs,
-                      LRU_list_t * lru_dupreq)
+                      LRU_list_t * lru_dupreq,
+                      timer_wheel_queue_t * pexpired)
 {
   hash_buffer_t buffkey;
   hash_buffer_t buffval;
@@ -676,6 +683,12 @@ int nfs_dupreq_finish(long xid,
   pentry->buffdata.pdata = buffval.pdata;
   pentry->buffdata.len = buffval.len;
 
+  /* Let the timer wheel tell the worker when the entry expires */
+  pdupreq->plru_entry = pentry;
+  pdupreq->dupreq_timer.twe_queue = pexpired;
+  timer_wheel_add(&pdupreq->dupreq_timer,
+                  (nfs_param.core_param.expiration_dupreq + 1) * 1000);
+
   return DUPREQ_SUCCESS;
 }                               /* nfs_dupreq_finish */
 
@@ -745,6 +758,7 @@ nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *
  *
  * @see LRU_invalidate_by_function
  * @see LRU_gc_invalid
+ * @see nfs_dupreq_gc_expired
  *
  */
 int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam)
@@ -760,6 +774,52 @@ int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam)
   return LRU_LIST_DO_NOT_SET_INVALID;
 }                               /* nfs_dupreq_fc_function */
 
+/**
+ *
+ * nfs_dupreq_gc_expired: releases the entries the timer wheel reported as expired.
+ *
+ * Releases the entries the timer wheel reported as expired. Only the expired
+ * entries are visited. An entry that was hit since it was armed is armed
+ * again for the remaining time.
+ *
+ * @param lru_dupreq [INOUT] the worker's duplicate request LRU
+ * @param pexpired [INOUT] the worker's queue of expired entries
+ * @param dupreq_pool [INOUT] the worker's duplicate request pool
+ *
+ * @return the number of released entries.
+ *
+ */
+int nfs_dupreq_gc_expired(LRU_list_t * lru_dupreq,
+                          timer_wheel_queue_t * pexpired,
+                          struct prealloc_pool *dupreq_pool)
+{
+  timer_wheel_entry_t *ptimer;
+  dupreq_entry_t *pdupreq;
+  time_t age;
+  int nb_released = 0;
+
+  while((ptimer = timer_wheel_queue_get(pexpired)) != NULL)
+    {
+      pdupreq = (dupreq_entry_t *) ptimer->twe_arg;
+
+      /* Test if entry is still expired, nfs_dupreq_get may have refreshed it */
+      age = time(NULL) - pdupreq->timestamp;
+      if(age <= nfs_param.core_param.expiration_dupreq)
+        {
+          timer_wheel_add(ptimer,
+                          (nfs_param.core_param.expiration_dupreq - age + 1) * 1000);
+          continue;
+        }
+
+      if(LRU_gc_entry(lru_dupreq, pdupreq->plru_entry, dupreq_pool) != LRU_LIST_SUCCESS)
+        LogCrit(COMPONENT_DUPREQ,
+                "FAILURE: Impossible to gc an entry of the duplicate request cache");
+      nb_released++;
+    }
+
+  return nb_released;
+}                               /* nfs_dupreq_gc_expired */
+
 /**
  *
  * nfs_dupreq_get_stats: gets the hash table statistics for the duplicate requests.
@@ -39,6 +39,25 @@ typedef struct gss_union_ctx_id_t
   gss_ctx_id_t internal_ctx_id;
 } gss_union_ctx_id_desc, *gss_union_ctx_id_t;
 
+#include "RW_Lock.h"
+
+/* An established context, shared by the transports of the client. The
+ * transports borrow its ctx, cname and client_name, see SVCAUTH_PRIVATE */
+typedef struct gss_ctx_cache_entry__
+{
+  gss_union_ctx_id_desc key;    /* the handle given to the client */
+  gss_ctx_id_t ctx;
+  gss_name_t client_name;
+  gss_buffer_desc cname;
+  struct rpc_gss_sec sec;
+  u_int win;
+  volatile uint64_t seqwin;     /* last sequence number << 32 | bitmap of the ones seen */
+  bool_t serialize;             /* the mechanism checks the sequence of the tokens */
+  pthread_mutex_t ctx_mutex;    /* serializes the calls on ctx, see Gss_ctx_Lock */
+  volatile unsigned int refcount;
+  struct gss_ctx_cache_entry__ *next;
+} gss_ctx_cache_entry_t;
+
 extern int copy_svc_authgss(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig);
 extern void free_svc_authgss(SVCXPRT *xprt);
 extern int sprint_ctx(char *buff, unsigned char *ctx, int len);
@@ -47,10 +66,12 @@ extern int Gss_ctx_Hash_Set(gss_union_ctx_id_desc *pgss_ctx,
 extern int Gss_ctx_Hash_Del(gss_union_ctx_id_desc *pgss_ctx);
 extern void Gss_ctx_Hash_Print(void);
 extern int Gss_ctx_Hash_Get(gss_union_ctx_id_desc *pgss_ctx,
-                            struct svc_rpc_gss_data *gd,
-			    bool_t **established,
-			    u_int **seqlast,
-			    uint32_t **seqmask);
+                            struct svc_rpc_gss_data *gd);
+extern void Gss_ctx_Hash_Release(struct svc_rpc_gss_data *gd);
+extern void Gss_ctx_Hash_Ref(struct svc_rpc_gss_data *gd);
+extern void Gss_ctx_Lock(struct svc_rpc_gss_data *gd, bool_t produce);
+extern void Gss_ctx_Unlock(struct svc_rpc_gss_data *gd, bool_t produce);
+extern bool_t Gss_ctx_Seq_Check(struct svc_rpc_gss_data *gd, u_int seq, bool_t commit);
 #endif                          /* _HAVE_GSSAPI */
 
 #endif /* GANESHA_RPCAL_H */
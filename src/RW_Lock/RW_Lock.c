@@ -39,6 +39,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include "RW_Lock.h"
 
 /*
@@ -130,6 +131,30 @@ int P_w(rw_lock_t * plock)
   return 0;
 }                               /* P_w */
 
+/*
+ * Take the lock for writting if nobody holds or waits for it,
+ * returns EBUSY instead of blocking
+ */
+int P_w_try(rw_lock_t * plock)
+{
+  P(plock->mutexProtect);
+
+  print_lock("P_w_try.1", plock);
+
+  if(plock->nbr_active > 0 || plock->nbw_active > 0 || plock->nbw_waiting > 0)
+    {
+      V(plock->mutexProtect);
+      return EBUSY;
+    }
+
+  plock->nbw_active++;
+
+  V(plock->mutexProtect);
+
+  print_lock("P_w_try.end", plock);
+  return 0;
+}                               /* P_w_try */
+
 /*
  * Release the lock after writting 
  */
@@ -74,6 +74,12 @@
  * The value is ref counted with nlm_lock_entry->sle_ref_count so that a
  * parallel cancel/unlock won't endup freeing the datastructure. The last
  * release on the data structure ensure that it is freed.
+ *
+ * Blocked lock entries (any sle_blocked other than STATE_NON_BLOCKING) are
+ * additionally linked, in arrival order, on pentry->object.file.lock_blocked_list
+ * through sle_blocked_locks. This FIFO is also protected by lock_list_mutex
+ * and lets grant_blocked_locks visit only the waiters instead of every lock
+ * held on the file.
  */
 #ifdef _DEBUG_MEMLEAKS
 static struct glist_head state_all_locks;
@@ -395,6 +401,8 @@ static state_lock_entry_t *create_state_lock_entry(cache_entry_t      * pentry,
       return NULL;
     }
 
+  init_glist(&new_entry->sle_blocked_locks);
+
   new_entry->sle_ref_count  = 1;
   new_entry->sle_pentry     = pentry;
   new_entry->sle_blocked    = blocked;
@@ -551,6 +559,7 @@ static void remove_from_locklist(state_lock_entry_t   * lock_entry,
 
   lock_entry->sle_owner = NULL;
   glist_del(&lock_entry->sle_list);
+  glist_del(&lock_entry->sle_blocked_locks);
   lock_entry_dec_ref(lock_entry);
 }
 
@@ -826,6 +835,17 @@ static bool_t subtract_lock_from_list(cache_entry_t        * pentry,
       /* free the enttries on the remove_list*/
       free_list(&remove_list, pclient);
 
+      /* split pieces of a blocked lock are still waiters */
+      if(list == &pentry->object.file.lock_list)
+        glist_for_each(glist, &split_lock_list)
+          {
+            found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+
+            if(found_entry->sle_blocked != STATE_NON_BLOCKING)
+              glist_add_tail(&pentry->object.file.lock_blocked_list,
+                             &found_entry->sle_blocked_locks);
+          }
+
       /* now add the split lock list */
       glist_add_list_tail(list, &split_lock_list);
     }
@@ -1241,6 +1261,7 @@ void grant_blocked_lock_immediate(cache_entry_t         * pentry,
 
   /* Mark lock as granted */
   lock_entry->sle_blocked = STATE_NON_BLOCKING;
+  glist_del(&lock_entry->sle_blocked_locks);
 
   /* Merge any touching or overlapping locks into this one. */
   merge_lock_entry(pentry, pcontext, lock_entry, pclient);
@@ -1264,6 +1285,7 @@ void state_complete_grant(fsal_op_context_t     * pcontext,
     {
       /* Mark lock as granted */
       lock_entry->sle_blocked = STATE_NON_BLOCKING;
+      glist_del(&lock_entry->sle_blocked_locks);
 
       /* Merge any touching or overlapping locks into this one. */
       merge_lock_entry(pentry, pcontext, lock_entry, pclient);
@@ -1280,8 +1302,34 @@ void state_complete_grant(fsal_op_context_t     * pcontext,
   V(pentry->object.file.lock_list_mutex);
 }
 
+/* Number of locks granted by one pass of grant_blocked_locks that are
+ * remembered to short circuit conflict checks of the following waiters.
+ */
+#define GRANT_BATCH_SIZE 32
+
+static inline bool_t locks_overlap(state_lock_desc_t *lock1,
+                                   state_lock_desc_t *lock2)
+{
+  return (lock_end(lock1) >= lock2->sld_offset) &&
+         (lock1->sld_offset <= lock_end(lock2));
+}
+
+/**
+ *
+ * grant_blocked_locks: Hand out locks to waiters made grantable by a release.
+ *
+ * Only the FIFO of blocked locks is walked, in arrival order, and waiters
+ * that do not overlap the released range are skipped since nothing that
+ * could block them has changed. A NULL range means any waiter may be
+ * grantable. The locks granted by this pass are remembered so that a herd
+ * of waiters behind a freshly granted exclusive lock is turned away without
+ * walking the whole lock list for each of them. The granted call backs only
+ * queue the grant, so the grants produced by one pass are sent as a batch.
+ *
+ */
 static void grant_blocked_locks(cache_entry_t        * pentry,
                                 fsal_op_context_t    * pcontext,
+                                state_lock_desc_t    * preleased,
                                 cache_inode_client_t * pclient)
 {
   state_lock_entry_t   * found_entry;
@@ -1289,15 +1337,34 @@ static void grant_blocked_locks(cache_entry_t        * pentry,
   state_status_t         status;
   granted_callback_t     call_back;
   state_blocking_t       blocked;
+  state_lock_entry_t   * granted[GRANT_BATCH_SIZE];
+  unsigned int           nb_granted = 0;
+  unsigned int           i;
+  bool_t                 conflict;
 
-  glist_for_each_safe(glist, glistn, &pentry->object.file.lock_list)
+  glist_for_each_safe(glist, glistn, &pentry->object.file.lock_blocked_list)
     {
-      found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+      found_entry = glist_entry(glist, state_lock_entry_t, sle_blocked_locks);
 
       if(found_entry->sle_blocked != STATE_NLM_BLOCKING &&
          found_entry->sle_blocked != STATE_NFSV4_BLOCKING)
           continue;
 
+      /* Waiters outside of the released range are still blocked */
+      if(preleased != NULL && !locks_overlap(&found_entry->sle_lock, preleased))
+        continue;
+
+      /* First check against what this pass just granted, it's cheap */
+      conflict = FALSE;
+      for(i = 0; i < nb_granted && !conflict; i++)
+        conflict = locks_overlap(&granted[i]->sle_lock, &found_entry->sle_lock) &&
+                   (granted[i]->sle_lock.sld_type == STATE_LOCK_W ||
+                    found_entry->sle_lock.sld_type == STATE_LOCK_W) &&
+                   different_owners(granted[i]->sle_owner, found_entry->sle_owner);
+
+      if(conflict)
+        continue;
+
       /* Found a blocked entry for this file, see if we can place the lock. */
       if(get_overlapping_entry(pentry,
                                pcontext,
@@ -1327,7 +1394,11 @@ static void grant_blocked_locks(cache_entry_t        * pentry,
 
           /* Grant is still in progress, keep the lock in the list */
           if(status == STATE_SUCCESS)
-            continue;
+            {
+              if(nb_granted < GRANT_BATCH_SIZE)
+                granted[nb_granted++] = found_entry;
+              continue;
+            }
         }
 
       /* There was no call back data or the call back failed, remove lock from list */
@@ -1448,11 +1519,13 @@ state_status_t state_release_grant(fsal_op_context_t     * pcontext,
 {
   state_lock_entry_t   * lock_entry;
   cache_entry_t        * pentry;
+  state_lock_desc_t      released;
 
   *pstatus = STATE_SUCCESS;
 
   lock_entry = cookie_entry->sce_lock_entry;
   pentry     = cookie_entry->sce_pentry;
+  released   = lock_entry->sle_lock;
 
   P(pentry->object.file.lock_list_mutex);
 
@@ -1495,7 +1568,7 @@ state_status_t state_release_grant(fsal_op_context_t     * pcontext,
   free_cookie(cookie_entry, TRUE);
 
   /* Check to see if we can grant any blocked locks. */
-  grant_blocked_locks(pentry, pcontext, pclient);
+  grant_blocked_locks(pentry, pcontext, &released, pclient);
 
   V(pentry->object.file.lock_list_mutex);
 
@@ -1818,20 +1891,24 @@ state_status_t state_test(cache_entry_t        * pentry,
 
   V(pentry->object.file.lock_list_mutex);
 
+  /* Drop the reference taken by the open */
+  cache_inode_close(pentry, pclient, &cache_status);
+
   return *pstatus;
 }
 
-state_status_t state_lock(cache_entry_t         * pentry,
-                          fsal_op_context_t     * pcontext,
-                          state_owner_t         * powner,
-                          state_t               * pstate,
-                          state_blocking_t        blocking,
-                          state_block_data_t    * block_data,
-                          state_lock_desc_t     * plock,
-                          state_owner_t        ** holder,   /* owner that holds conflicting lock */
-                          state_lock_desc_t     * conflict, /* description of conflicting lock */
-                          cache_inode_client_t  * pclient,
-                          state_status_t        * pstatus)
+/* state_lock, once the file is open */
+static state_status_t do_state_lock(cache_entry_t         * pentry,
+                                    fsal_op_context_t     * pcontext,
+                                    state_owner_t         * powner,
+                                    state_t               * pstate,
+                                    state_blocking_t        blocking,
+                                    state_block_data_t    * block_data,
+                                    state_lock_desc_t     * plock,
+                                    state_owner_t        ** holder,   /* owner that holds conflicting lock */
+                                    state_lock_desc_t     * conflict, /* description of conflicting lock */
+                                    cache_inode_client_t  * pclient,
+                                    state_status_t        * pstatus)
 {
   bool_t                 allow = TRUE, overlap = FALSE;
   struct glist_head    * glist;
@@ -1839,19 +1916,10 @@ state_status_t state_lock(cache_entry_t         * pentry,
   state_blocking_t       blocked = blocking;
   uint64_t               found_entry_end;
   uint64_t               plock_end = lock_end(plock);
-  cache_inode_status_t   cache_status;
   state_block_data_t   * pass_block_data = NULL;
 
   /* TODO FSF: add support for async blocking lock */
 
-  if(cache_inode_open(pentry, pclient, FSAL_O_RDWR, pcontext, &cache_status) != CACHE_INODE_SUCCESS)
-    {
-      *pstatus = cache_inode_status_to_state_status(cache_status);
-      LogFullDebug(COMPONENT_STATE,
-                   "Could not open file");
-      return *pstatus;
-    }
-
 #ifdef _USE_BLOCKING_LOCKS
   P(pentry->object.file.lock_list_mutex);
   if(blocking != STATE_NON_BLOCKING)
@@ -2036,6 +2104,10 @@ state_status_t state_lock(cache_entry_t         * pentry,
 
   glist_add_tail(&pentry->object.file.lock_list, &found_entry->sle_list);
 
+  if(blocked != STATE_NON_BLOCKING)
+    glist_add_tail(&pentry->object.file.lock_blocked_list,
+                   &found_entry->sle_blocked_locks);
+
   V(pentry->object.file.lock_list_mutex);
   if(blocked == STATE_NON_BLOCKING)
     *pstatus = STATE_SUCCESS;
@@ -2044,6 +2116,38 @@ state_status_t state_lock(cache_entry_t         * pentry,
   return *pstatus;
 }
 
+state_status_t state_lock(cache_entry_t         * pentry,
+                          fsal_op_context_t     * pcontext,
+                          state_owner_t         * powner,
+                          state_t               * pstate,
+                          state_blocking_t        blocking,
+                          state_block_data_t    * block_data,
+                          state_lock_desc_t     * plock,
+                          state_owner_t        ** holder,   /* owner that holds conflicting lock */
+                          state_lock_desc_t     * conflict, /* description of conflicting lock */
+                          cache_inode_client_t  * pclient,
+                          state_status_t        * pstatus)
+{
+  cache_inode_status_t   cache_status;
+
+  if(cache_inode_open(pentry, pclient, FSAL_O_RDWR, pcontext, &cache_status) != CACHE_INODE_SUCCESS)
+    {
+      *pstatus = cache_inode_status_to_state_status(cache_status);
+      LogFullDebug(COMPONENT_STATE,
+                   "Could not open file");
+      return *pstatus;
+    }
+
+  do_state_lock(pentry, pcontext, powner, pstate, blocking, block_data, plock,
+                holder, conflict, pclient, pstatus);
+
+  /* Drop the reference taken by the open, the descriptor is kept while the
+   * file holds locks */
+  cache_inode_close(pentry, pclient, &cache_status);
+
+  return *pstatus;
+}
+
 state_status_t state_unlock(cache_entry_t        * pentry,
                             fsal_op_context_t    * pcontext,
                             state_owner_t        * powner,
@@ -2130,7 +2234,7 @@ state_status_t state_unlock(cache_entry_t        * pentry,
     empty = LogList("Lock List", pentry, &pentry->object.file.lock_list);
 
 #ifdef _USE_BLOCKING_LOCKS
-  grant_blocked_locks(pentry, pcontext, pclient);
+  grant_blocked_locks(pentry, pcontext, plock, pclient);
 #endif
 
   V(pentry->object.file.lock_list_mutex);
@@ -2199,7 +2303,7 @@ state_status_t state_cancel(cache_entry_t        * pentry,
                  state_err_str(*pstatus));
 
       /* Check to see if we can grant any blocked locks. */
-      grant_blocked_locks(pentry, pcontext, pclient);
+      grant_blocked_locks(pentry, pcontext, plock, pclient);
 
       break;
     }
@@ -139,6 +139,23 @@ typedef struct buddy_paremeter__
    */
   unsigned int keep_minimum;
 
+  /* Amount of memory (in bytes) each thread keeps
+   * in its cache of freed small blocks, to serve the next
+   * allocations of the same size without splitting
+   * and merging buddies. 0 disables the cache.
+   */
+  size_t thread_cache_size;
+
+  /* Number of freed extra blocks (I/O buffers, mostly)
+   * each thread keeps for reuse.
+   */
+  unsigned int large_cache_count;
+
+  /* Indicates if extra blocks of half a huge page or more
+   * are mapped in huge pages.
+   */
+  int huge_pages;
+
 } buddy_parameter_t;
 
 /**
@@ -231,7 +248,7 @@ typedef struct buddy_stats__
   size_t StdMemSpace;           /* Total Space used for standard pages */
   size_t WM_StdMemSpace;        /* High watermark for memory used for std pages */
 
-  size_t StdUsedSpace;          /* Total Space really used */
+  size_t StdUsedSpace;          /* Total Space really used (cached blocks apart) */
   size_t WM_StdUsedSpace;       /* High watermark for memory used in std pages */
 
   size_t StdPageSize;           /* Standard Pages size */
@@ -247,6 +264,14 @@ typedef struct buddy_stats__
   unsigned int NbExtraPages;    /* Number of extra pages (current) */
   unsigned int WM_NbExtraPages; /* Watermark of extra pages */
 
+  /* Thread cache */
+
+  size_t CachedSpace;           /* Space held by the small block cache (current) */
+  size_t LargeCachedSpace;      /* Space held by the extra block cache (current) */
+  unsigned long NbCacheHits;    /* Allocations served by the thread cache */
+  unsigned long NbCacheMisses;  /* Cachable allocations not served by it */
+  unsigned long NbRemoteFrees;  /* Blocks released by another thread */
+
 } buddy_stats_t;
 
 /**
@@ -254,6 +279,13 @@ typedef struct buddy_stats__
  */
 void BuddyGetStats(buddy_stats_t * budd_stats);
 
+/**
+ *  Displays a summary of the allocations of current thread
+ *  by label (in debug builds, all the allocated blocks are
+ *  counted; otherwise, labeled allocations are sampled).
+ */
+void BuddyLabelsSummary(log_components_t component);
+
 #ifdef _DEBUG_MEMLEAKS
 
 /**
@@ -306,12 +338,6 @@ const char *BuddyGetDebugLabel(BUDDY_ADDR_T ptr);
  */
 int BuddyCountDebugLabel(char *label);
 
-/**
- *  Displays a summary of all allocated blocks
- *  with their labels
- */
-void BuddyLabelsSummary(log_components_t component);
-
 /**
  * Display allocation map, and fragmentation info.
  */
@@ -329,6 +355,17 @@ int _BuddyCheck_Autolabel(BUDDY_ADDR_T ptr,
 #define BuddyCheck(ptr, ok)           _BuddyCheck_Autolabel((BUDDY_ADDR_T) ptr, ok, __FILE__, __FUNCTION__, __LINE__, "BuddyCheck")
 #define BuddyCheckLabel(ptr, ok, lbl) _BuddyCheck_Autolabel((BUDDY_ADDR_T) ptr, ok, __FILE__, __FUNCTION__, __LINE__, lbl)
 #else
+
+/**
+ * Those functions allocate memory for a labeled call site.
+ * One allocation out of BUDDY_LABEL_SAMPLING is counted
+ * for its label.
+ */
+BUDDY_ADDR_T BuddyMallocExit_Label(size_t Size, const char *label);
+
+BUDDY_ADDR_T BuddyCalloc_Label(size_t NumberOfElements, size_t ElementSize,
+                               const char *label);
+
 /**
  *  test memory corruption for a block.
  *  true if the block is OK,
@@ -127,6 +127,9 @@ typedef struct
 typedef struct
 {
   fsal_posixdb_conn_params_t dbparams;
+  char index_dir[FSAL_MAX_PATH_LEN];    /* local index of the namespace, none if empty */
+  int index_sync;                       /* wait for the index changes to be on disk */
+  unsigned int index_commit_delay;      /* usec the index flusher waits for a batch to fill */
 } posixfs_specific_initinfo_t;
 
 /**< directory cookie */
@@ -71,6 +71,9 @@
 #define FSAL_PROXY_RECV_BUFFER_SIZE   32768
 #define FSAL_PROXY_NFS_V4             4
 #define FSAL_PROXY_RETRY_SLEEPTIME    10
+#define FSAL_PROXY_NB_CONNECTIONS     4
+#define FSAL_PROXY_MAX_IO_CHUNKS      16
+#define FSAL_PROXY_COMPOUND_OVERHEAD  1024
 
 #include "fsal_glue_const.h"
 
@@ -183,6 +186,9 @@ typedef struct
   unsigned int sec_type;
   bool_t active_krb5;
   char openfh_wd[MAXPATHLEN];
+  unsigned int nb_connections;          /**< Pipelined connections, 0 for none */
+  unsigned int io_chunk_size;           /**< READ/WRITE split size, 0 for auto */
+  unsigned int lookup_access;           /**< Ask ACCESS along with LOOKUP */
 
   /* initialization info for handle mapping */
 
@@ -117,9 +117,21 @@ typedef struct
 #define FSAL_OP_CONTEXT_TO_UID( pcontext ) ( pcontext->credential.user )
 #define FSAL_OP_CONTEXT_TO_GID( pcontext ) ( pcontext->credential.group )
 
+/* Asynchronous IO (io_uring) defaults, see the VFS block */
+#define VFS_ASYNC_IO_DEPTH_DEFAULT 0
+#define VFS_ASYNC_IO_FILES_DEFAULT 1024
+
+/* Readdir helper threads defaults, see the VFS block */
+#define VFS_READDIR_THREADS_DEFAULT      4
+#define VFS_READDIR_PARALLEL_MIN_DEFAULT 256
+
 typedef struct
 {
   char vfs_mount_point[MAXPATHLEN];
+  unsigned int async_io_depth;          /**< io_uring entries, 0 disables it       */
+  unsigned int async_io_files;          /**< Descriptors registered to the ring    */
+  unsigned int readdir_threads;         /**< Readdir helpers, 0 disables them      */
+  unsigned int readdir_parallel_min;    /**< Entries needed to use the helpers     */
 } vfsfs_specific_initinfo_t;
 
 /**< directory cookie */
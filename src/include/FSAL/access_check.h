@@ -15,4 +15,7 @@ fsal_status_t fsal_check_access(fsal_op_context_t * p_context,   /* IN */
 				fsal_accessflags_t access_type,  /* IN */
 				struct stat *p_buffstat, /* IN */
 				fsal_attrib_list_t * p_object_attributes /* IN */ );
+
+fsal_boolean_t fsal_is_group_member(fsal_op_context_t * p_context,  /* IN */
+				    fsal_gid_t gid /* IN */ );
 #endif 
@@ -89,6 +89,7 @@ typedef int LRU_status_t;
 LRU_entry_t *LRU_new_entry(LRU_list_t * plru, LRU_status_t * pstatus);
 LRU_list_t *LRU_Init(LRU_parameter_t lru_param, LRU_status_t * pstatus);
 int LRU_gc_invalid(LRU_list_t * plru, void *cleanparam);
+int LRU_gc_entry(LRU_list_t * plru, LRU_entry_t * pentry, void *cleanparam);
 int LRU_invalidate(LRU_list_t * plru, LRU_entry_t * pentry);
 int LRU_invalidate_by_function(LRU_list_t * plru,
                                int (*testfunc) (LRU_entry_t *, void *addparam),
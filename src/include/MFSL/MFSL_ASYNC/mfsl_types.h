@@ -49,6 +49,10 @@
 #define MFSL_ASYNC_DEFAULT_NB_PREALLOCATED_DIRS  10
 #define MFSL_ASYNC_DEFAULT_NB_PREALLOCATED_FILES 100
 
+/* Objects and directory entries an asynchronous operation is ordered on */
+#define MFSL_ASYNC_DEP_MAX_KEYS        2
+#define MFSL_ASYNC_DEP_HASH_SIZE       1021
+
 /* other includes */
 #include <sys/types.h>
 #include <sys/param.h>
@@ -57,6 +61,7 @@
 #include "config_parsing.h"
 #include "LRU_List.h"
 #include "HashTable.h"
+#include "nlm_list.h"
 #include "err_fsal.h"
 #include "err_mfsl.h"
 
@@ -139,6 +144,7 @@ typedef struct mfsl_async_op_create_args__
   fsal_accessmode_t mode;
   fsal_uid_t owner;
   fsal_gid_t group;
+  fsal_attrib_list_t attr_set;  /* setattrs coalesced with this op */
 } mfsl_async_op_create_args_t;
 
 typedef struct mfsl_async_op_create_res__
@@ -154,6 +160,7 @@ typedef struct mfsl_async_op_mkdir_args__
   fsal_accessmode_t mode;
   fsal_uid_t owner;
   fsal_gid_t group;
+  fsal_attrib_list_t attr_set;  /* setattrs coalesced with this op */
 } mfsl_async_op_mkdir_args_t;
 
 typedef struct mfsl_async_op_mkdir_res__
@@ -256,6 +263,29 @@ typedef union mfsl_async_op_res__
   mfsl_async_op_symlink_res_t symlink;
 } mfsl_async_op_res_t;
 
+struct mfsl_async_op_desc__;
+
+/* An operation that waits for another one to be done */
+typedef struct mfsl_async_dep_edge__
+{
+  struct mfsl_async_op_desc__ *psucc;
+  struct mfsl_async_dep_edge__ *next;
+} mfsl_async_dep_edge_t;
+
+/* The pending operations on an object (empty name) or on one of its
+ * directory entries, they are done in the order they were posted */
+typedef struct mfsl_async_dep_track__
+{
+  fsal_handle_t handle;
+  fsal_name_t name;
+  struct mfsl_async_op_desc__ *plast;            /**< Last posted op not done yet        */
+  unsigned int refcount;                         /**< Pending ops and entries' tracks    */
+  struct mfsl_async_dep_track__ *pparent;        /**< The directory's track, for entries */
+  struct glist_head children;                    /**< Tracks of the directory's entries  */
+  struct glist_head child_link;
+  struct glist_head hash_link;
+} mfsl_async_dep_track_t;
+
 typedef struct mfsl_async_op_desc__
 {
   struct timeval op_time;
@@ -267,6 +297,11 @@ typedef struct mfsl_async_op_desc__
   fsal_op_context_t fsal_op_context;
   caddr_t ptr_mfsl_context;
   unsigned int related_synclet_index;
+  unsigned int nb_pred;                          /**< Pending ops this one waits for     */
+  mfsl_async_dep_edge_t *psucc;                  /**< Ops that wait for this one         */
+  mfsl_async_dep_track_t *ptrack[MFSL_ASYNC_DEP_MAX_KEYS];
+  unsigned int nb_track;
+  unsigned int dispatched;
 } mfsl_async_op_desc_t;
 
 void *mfsl_synclet_thread(void *Arg);
@@ -318,6 +353,11 @@ fsal_status_t mfsl_async_post_async_op(mfsl_async_op_desc_t * popdes,
                                        mfsl_object_t * pmobject);
 fsal_status_t MFSL_async_post(mfsl_async_op_desc_t * popdesc);
 
+int mfsl_async_dep_init(void);
+int mfsl_async_dep_post(mfsl_async_op_desc_t * popdesc);
+int mfsl_async_dep_complete(mfsl_async_op_desc_t * popdesc);
+int mfsl_async_merge_attrs(fsal_attrib_list_t * pdest, fsal_attrib_list_t * psrc);
+
 fsal_status_t mfsl_async_init_precreated_directories(fsal_op_context_t    *pcontext,
                                                      struct prealloc_pool *pool_dirs);
 
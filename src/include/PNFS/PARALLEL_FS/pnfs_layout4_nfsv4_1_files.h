@@ -73,4 +73,13 @@ nfsstat4 pnfs_parallel_fs_layoutreturn( LAYOUTRETURN4args * pargs,
 				        compound_data_t * data,
 				        LAYOUTRETURN4res  * pres ) ; 
 
+/* Device table */
+void pnfs_parallel_fs_build_devices( pnfs_layoutfile_parameter_t * pparam ) ;
+
+int pnfs_parallel_fs_deviceid_to_index( deviceid4 deviceid,
+                                        pnfs_layoutfile_parameter_t * pparam ) ;
+
+void pnfs_parallel_fs_index_to_deviceid( unsigned int index,
+                                         deviceid4 deviceid ) ;
+
 #endif 
@@ -59,7 +59,7 @@
 #include "nfs23.h"
 #include "nfs4.h"
 
-#define NB_MAX_PNFS_DS 2
+#define NB_MAX_PNFS_DS 32
 #define PNFS_NFS4      4
 #define PNFS_SENDSIZE 32768
 #define PNFS_RECVSIZE 32768
@@ -79,11 +79,23 @@ typedef struct pnfs_ds_parameter__
   bool_t is_ganesha;
 } pnfs_ds_parameter_t;
 
+/* A device is a stripe pattern: stripe i of a file goes to data server
+ * ds_index[(first_stripe_index + i) % stripe_width]. Its deviceid4 carries
+ * its rank in the device table, starting at 1, in network order. */
+typedef struct pnfs_layoutfile_device__
+{
+  unsigned int stripe_width;
+  unsigned int ds_index[NB_MAX_PNFS_DS];
+} pnfs_layoutfile_device_t;
+
 typedef struct pnfs_layoutfile_parameter__
 {
   unsigned int stripe_size;
   unsigned int stripe_width;
+  unsigned int nb_ds;
   pnfs_ds_parameter_t ds_param[NB_MAX_PNFS_DS];
+  unsigned int nb_devices;
+  pnfs_layoutfile_device_t devices[NB_MAX_PNFS_DS];
 } pnfs_layoutfile_parameter_t;
 
 
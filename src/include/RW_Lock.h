@@ -64,6 +64,7 @@ typedef struct _RW_LOCK
 int rw_lock_init(rw_lock_t * plock);
 int rw_lock_destroy(rw_lock_t * plock);
 int P_w(rw_lock_t * plock);
+int P_w_try(rw_lock_t * plock);
 int V_w(rw_lock_t * plock);
 int P_r(rw_lock_t * plock);
 int V_r(rw_lock_t * plock);
@@ -64,6 +64,9 @@ typedef struct cache_content_gc_policy__
   unsigned int nb_call_before_gc;
   unsigned int hwmark_df;
   unsigned int lwmark_df;
+  unsigned int flush_bandwidth;           /**< Max flush throughput to the FSAL in MB/s, 0 for no limit   */
+  unsigned int flush_outstanding;         /**< Writes in flight per flushed file                           */
+  unsigned int dirty_threshold;           /**< Dirty MB above which writes are slowed down, 0 for no limit */
 } cache_content_gc_policy_t;
 
 #define CONF_LABEL_CACHE_CONTENT_GCPOL  "FileContent_GC_Policy"
@@ -245,6 +248,44 @@ typedef enum cache_content_refresh_how__
   DEFAULT_REFRESH
 } cache_content_refresh_how_t;
 
+/*
+ * Binary journal of the data cache (used for crash recovery)
+ */
+#define CACHE_CONTENT_JOURNAL_NAME        "datacache.journal"
+#define CACHE_CONTENT_JOURNAL_MAGIC       0x4443464aU    /* "DCFJ" */
+#define CACHE_CONTENT_JOURNAL_CHECKPOINT  65536          /* records appended before the GC checkpoints */
+#define CACHE_CONTENT_JOURNAL_VALIDATORS  8              /* max threads checking data files at recovery */
+
+typedef enum cache_content_journal_op__
+{ CACHE_CONTENT_JOURNAL_ADD = 1,
+  CACHE_CONTENT_JOURNAL_DIRTY = 2,
+  CACHE_CONTENT_JOURNAL_CLEAN = 3,
+  CACHE_CONTENT_JOURNAL_RELEASE = 4
+} cache_content_journal_op_t;
+
+typedef struct cache_content_journal_record__
+{
+  unsigned int magic;                     /**< CACHE_CONTENT_JOURNAL_MAGIC                         */
+  unsigned int checksum;                  /**< Checksum of the record, computed with checksum = 0  */
+  unsigned int op;                        /**< A cache_content_journal_op_t                        */
+  unsigned int sync_state;                /**< Sync state of the entry when the record was written */
+  u_int64_t seq;                          /**< Order of the record in the journal                  */
+  u_int64_t fileid;                       /**< Fileid used to name the files in the data cache     */
+  u_int64_t size;                         /**< Size of the file when the record was written        */
+  int64_t read_time;                      /**< Epoch time of the last read operation               */
+  int64_t mod_time;                       /**< Epoch time of the last change operation             */
+  int64_t last_flush_time;                /**< Epoch time of the last flush                        */
+  fsal_handle_t handle;                   /**< FSAL handle of the cached file                      */
+} cache_content_journal_record_t;
+
+/*
+ * Data cache flusher
+ */
+#define CACHE_CONTENT_FLUSH_CHUNK            1048576   /* size of a single write to the FSAL            */
+#define CACHE_CONTENT_FLUSH_MAX_OUTSTANDING  32        /* upper bound for Flush_Outstanding_Writes      */
+#define CACHE_CONTENT_THROTTLE_MAX_DELAY     1000      /* max delay of a throttled write (milliseconds) */
+#define CACHE_CONTENT_FLUSH_PROGRESS_DELAY   100       /* between two looks at a flush pass (milliseconds) */
+
 typedef struct cache_content_flush_thread_data__
 {
   unsigned int thread_pos;
@@ -342,6 +383,37 @@ cache_content_status_t cache_content_crash_recover(unsigned short exportid,
                                                    fsal_op_context_t * pcontext,
                                                    cache_content_status_t * pstatus);
 
+void cache_content_journal_append(cache_content_entry_t * pentry,
+                                  cache_content_journal_op_t op,
+                                  cache_content_client_t * pclient);
+
+void cache_content_journal_forget(char *cache_dir, u_int64_t fileid);
+
+int cache_content_journal_checkpoint(char *cache_dir);
+int cache_content_journal_checkpoint_due(char *cache_dir);
+u_int64_t cache_content_journal_flushed_bytes(char *cache_dir, off_t * poffset);
+
+int cache_content_journal_replay(char *cache_dir,
+                                 cache_content_journal_record_t ** pprecords,
+                                 unsigned int *pcount);
+
+cache_content_status_t cache_content_flusher_run(char *cachedir,
+                                                cache_content_flush_behaviour_t flushhow,
+                                                unsigned int lw_mark_trigger_flag,
+                                                time_t grace_period,
+                                                unsigned int *p_nb_flushed,
+                                                unsigned int *p_nb_too_young,
+                                                unsigned int *p_nb_errors,
+                                                unsigned int *p_nb_orphans,
+                                                fsal_op_context_t * pcontext,
+                                                cache_content_status_t * pstatus);
+
+void cache_content_dirty_account(fsal_size_t size);
+u_int64_t cache_content_dirty_bytes(void);
+void cache_content_dirty_drain(u_int64_t size);
+void cache_content_write_throttle(void);
+int cache_content_flush_wait_request(unsigned int seconds);
+
 int cache_content_get_export_id(char *dirname);
 u_int64_t cache_content_get_inum(char *filename);
 int cache_content_get_datapath(char *basepath, u_int64_t inum, char *datapath);
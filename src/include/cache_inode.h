@@ -194,6 +194,10 @@ typedef struct cache_inode_client_parameter__
   time_t retention;                                    /**< Fd retention duration                            */
   unsigned int use_fd_cache;                           /** Do we cache fd or not ?                           */
   unsigned int use_fsal_hash ;                         /** Do we rely on FSAL to hash handle or not ?        */
+  unsigned int max_open_files;                         /**< Max fd kept open by all the clients, 0 for auto  */
+  char snapshot_file[MAXPATHLEN];                      /**< Snapshot of the hottest entries, empty if none   */
+  unsigned int snapshot_max_entries;                   /**< Max number of entries kept in the snapshot       */
+  unsigned int snapshot_interval;                      /**< Seconds between snapshots, 0 for shutdown only   */
 } cache_inode_client_parameter_t;
 
 typedef struct cache_inode_opened_file__
@@ -206,8 +210,30 @@ typedef struct cache_inode_opened_file__
   unsigned int fileno;
   fsal_openflags_t openflags;
   time_t last_op;
+  struct glist_head fd_lru;                            /**< Link in the global fd LRU, under its mutex       */
+  unsigned int in_fd_lru;                              /**< Is the descriptor in the global fd LRU ?         */
+  unsigned int refcount;                               /**< Users of the descriptor, it is not evicted if >0 */
+  unsigned int evicting;                               /**< The descriptor is being closed by the fd LRU     */
+#ifdef _USE_MFSL
+  mfsl_file_t retired_mfsl_fd;                         /**< Descriptor replaced while in use                 */
+#else
+  fsal_file_t retired_fd;                              /**< Descriptor replaced while in use                 */
+#endif
+  unsigned int retired_refcount;                       /**< Users left of the retired descriptor             */
 } cache_inode_opened_file_t;
 
+typedef struct cache_inode_fd_cache_stat__
+{
+  unsigned int nb_open;                 /**< Descriptors currently kept open       */
+  unsigned int max_open;                /**< Cap on the descriptors kept open      */
+  unsigned int nb_opened;               /**< FSAL opens done                       */
+  unsigned int nb_closed;               /**< FSAL closes done                      */
+  unsigned int nb_open_avoided;         /**< Opens served by a cached descriptor   */
+  unsigned int nb_close_avoided;        /**< Closes for which the fd was kept      */
+  unsigned int nb_upgraded;             /**< Reopens as read/write to serve both   */
+  unsigned int nb_evicted;              /**< Descriptors closed by the LRU         */
+} cache_inode_fd_cache_stat_t;
+
 typedef enum cache_inode_file_type__
 { UNASSIGNED = 1,
   REGULAR_FILE = 2,
@@ -323,6 +349,7 @@ struct cache_entry_t
       void *pentry_content;                                          /**< Entry in file content cache (NULL if not cached)     */
       struct glist_head state_list;                                  /**< Pointers for state list                              */
       struct glist_head lock_list;                                   /**< Pointers for lock list                               */
+      struct glist_head lock_blocked_list;                           /**< FIFO of blocked lock requests (subset of lock list)  */
       pthread_mutex_t lock_list_mutex;                               /**< Mutex to protect lock list                           */
       cache_inode_unstable_data_t unstable_data;                     /**< Unstable data, for use with WRITE/COMMIT             */
     } file;                                   /**< file related filed     */
@@ -379,8 +406,43 @@ typedef struct cache_inode_fsal_data__
   uint64_t cookie;                              /**< Cache inode cookie    */
 } cache_inode_fsal_data_t;
 
-#define SMALL_CLIENT_INDEX 0x20000000
-#define NLM_THREAD_INDEX   0x40000000
+#define SMALL_CLIENT_INDEX    0x20000000
+#define SNAPSHOT_CLIENT_INDEX 0x30000000
+#define NLM_THREAD_INDEX      0x40000000
+
+/* create_flag of cache_inode_new_entry for an entry reloaded from a snapshot,
+ * it is added as STALE and revalidated on its first use */
+#define CACHE_INODE_NEW_ENTRY_RELOAD 2
+
+/* Snapshot of the hottest entries, reloaded at startup */
+#define CACHE_INODE_SNAPSHOT_MAGIC     0x43494e53       /* "CINS" */
+#define CACHE_INODE_SNAPSHOT_VERSION   1
+#define CACHE_INODE_SNAPSHOT_NO_PARENT 0xFFFFFFFF
+
+typedef struct cache_inode_snapshot_header__
+{
+  u_int32_t magic;                              /**< CACHE_INODE_SNAPSHOT_MAGIC                     */
+  u_int32_t version;                            /**< CACHE_INODE_SNAPSHOT_VERSION                   */
+  u_int32_t handle_size;                        /**< sizeof(fsal_handle_t) of the writer            */
+  u_int32_t attr_size;                          /**< sizeof(fsal_attrib_list_t) of the writer       */
+  u_int32_t nb_records;                         /**< Number of records following the header         */
+  u_int32_t checksum;                           /**< Checksum of all that follows the header        */
+  u_int64_t saved_time;                         /**< Epoch time of the snapshot                     */
+} cache_inode_snapshot_header_t;
+
+/* A record is followed by name_len bytes of name, then link_len bytes of link content.
+ * Parents always come before their children. */
+typedef struct cache_inode_snapshot_record__
+{
+  u_int32_t parent;                             /**< Index of the parent record, or NO_PARENT       */
+  u_int32_t rank;                               /**< Rank in the LRU, 0 for the most recently used  */
+  u_int32_t type;                               /**< cache_inode_file_type_t of the entry           */
+  u_int32_t policy;                             /**< cache_inode_policy_t of the entry              */
+  u_int32_t name_len;                           /**< Length of the name in the parent directory     */
+  u_int32_t link_len;                           /**< Length of the symbolic link content            */
+  fsal_handle_t handle;                         /**< The FSAL handle                                */
+  fsal_attrib_list_t attributes;                /**< The FSAL attributes when the snapshot was made */
+} cache_inode_snapshot_record_t;
 
 struct cache_inode_client_t
 {
@@ -420,6 +482,9 @@ struct cache_inode_client_t
   int fd_gc_needed;                                                /**< Should we perform fd gc ?                                */
 #ifdef _USE_MFSL
   mfsl_context_t mfsl_context;                                     /**< Context to be used for MFSL module                       */
+#else
+  pthread_mutex_t async_io_mutex;                                  /**< Protects the completion of the client's IO in flight     */
+  pthread_cond_t async_io_cond;                                    /**< Signaled when the client's IO in flight completes        */
 #endif
 };
 
@@ -853,6 +918,8 @@ cache_inode_status_t cache_inode_cookieverf(cache_entry_t * pentry,
                                             uint64_t * pverf,
                                             cache_inode_status_t * pstatus);
 
+void cache_inode_invalidate_all(void);
+
 cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
                                              fsal_attrib_list_t * pattr,
                                              hash_table_t * ht,
@@ -932,6 +999,22 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
                                     cache_inode_client_t * pclient,
                                     cache_inode_status_t * pstatus);
 
+void cache_inode_fd_cache_init(unsigned int max_open);
+void cache_inode_fd_cache_insert(cache_entry_t * pentry);
+void cache_inode_fd_cache_hold(cache_entry_t * pentry);
+unsigned int cache_inode_fd_cache_release(cache_entry_t * pentry,
+                                          cache_inode_client_t * pclient);
+int cache_inode_fd_cache_retire(cache_entry_t * pentry);
+void cache_inode_fd_cache_remove(cache_entry_t * pentry);
+void cache_inode_fd_cache_forget(cache_entry_t * pentry, cache_inode_client_t * pclient);
+int cache_inode_fd_cache_full(void);
+void cache_inode_fd_cache_close_avoided(void);
+void cache_inode_fd_cache_upgraded(void);
+unsigned int cache_inode_fd_cache_reclaim(cache_entry_t * pcaller,
+                                          cache_inode_client_t * pclient,
+                                          int idle_only);
+void cache_inode_fd_cache_get_stats(cache_inode_fd_cache_stat_t * pstat);
+
 cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
                                        cache_inode_status_t * pstatus);
 
@@ -985,6 +1068,19 @@ cache_inode_status_t cache_inode_dump_content(char *path, cache_entry_t * pentry
 
 cache_inode_status_t cache_inode_reload_content(char *path, cache_entry_t * pentry);
 
+cache_inode_status_t cache_inode_snapshot_save(hash_table_t * ht,
+                                               char *path,
+                                               unsigned int max_entries,
+                                               unsigned int *pnb_saved,
+                                               cache_inode_status_t * pstatus);
+
+cache_inode_status_t cache_inode_snapshot_load(hash_table_t * ht,
+                                               char *path,
+                                               cache_inode_client_t * pclient,
+                                               fsal_op_context_t * pcontext,
+                                               unsigned int *pnb_loaded,
+                                               cache_inode_status_t * pstatus);
+
 void cache_inode_expire_to_str(cache_inode_expire_type_t type, time_t value, char *out);
 
 inline unsigned int cache_inode_file_holds_state( cache_entry_t * pentry );
@@ -644,6 +644,40 @@ fsal_status_t FSAL_write(fsal_file_t * file_descriptor, /* IN */
 
 fsal_status_t FSAL_sync(fsal_file_t * file_descriptor /* IN */);
 
+/**
+ * Completion of an asynchronous read or write.
+ * Called once, from any thread, with the outcome of the IO.
+ * end_of_file is only meaningful for a read.
+ */
+typedef void (*fsal_io_callback_t) (void *cb_arg,       /* IN */
+                                    fsal_status_t status,       /* IN */
+                                    fsal_size_t io_amount,      /* IN */
+                                    fsal_boolean_t end_of_file  /* IN */ );
+
+/**
+ * FSAL_read_async, FSAL_write_async:
+ * Submit an IO and return at once; callback is called when it is done.
+ * If the submission itself fails, the error is returned and callback
+ * is never called. On a FSAL with no asynchronous IO, the IO is done
+ * synchronously and callback is called before returning.
+ * Only FSAL_SEEK_SET positioning is supported.
+ */
+fsal_status_t FSAL_read_async(fsal_file_t * file_descriptor,    /* IN */
+                              fsal_seek_t * seek_descriptor,    /* IN */
+                              fsal_size_t buffer_size,  /* IN */
+                              caddr_t buffer,   /* OUT */
+                              fsal_io_callback_t callback,      /* IN */
+                              void *cb_arg      /* IN */
+    );
+
+fsal_status_t FSAL_write_async(fsal_file_t * file_descriptor,   /* IN */
+                               fsal_seek_t * seek_descriptor,   /* IN */
+                               fsal_size_t buffer_size, /* IN */
+                               caddr_t buffer,  /* IN */
+                               fsal_io_callback_t callback,     /* IN */
+                               void *cb_arg     /* IN */
+    );
+
 fsal_status_t FSAL_close(fsal_file_t * file_descriptor  /* IN */
     );
 
@@ -1433,6 +1467,22 @@ typedef struct fsal_functions__
 
   fsal_status_t(*fsal_sync) (fsal_file_t * p_file_descriptor  /* IN */);
 
+  /* FSAL_read_async (optional, NULL if not supported) */
+  fsal_status_t(*fsal_read_async) (fsal_file_t * p_file_descriptor,     /* IN */
+                                   fsal_seek_t * p_seek_descriptor,     /* IN */
+                                   fsal_size_t buffer_size,     /* IN */
+                                   caddr_t buffer,      /* OUT */
+                                   fsal_io_callback_t callback, /* IN */
+                                   void *cb_arg /* IN */ );
+
+  /* FSAL_write_async (optional, NULL if not supported) */
+  fsal_status_t(*fsal_write_async) (fsal_file_t * p_file_descriptor,    /* IN */
+                                    fsal_seek_t * p_seek_descriptor,    /* IN */
+                                    fsal_size_t buffer_size,    /* IN */
+                                    caddr_t buffer,     /* IN */
+                                    fsal_io_callback_t callback,        /* IN */
+                                    void *cb_arg /* IN */ );
+
   /* FSAL_UP functions */
 #ifdef _USE_FSAL_UP
   fsal_status_t(*fsal_up_init) (struct fsal_up_event_bus_parameter_t_ * pebparam,      /* IN */
@@ -201,11 +201,27 @@ typedef enum fsal_nodetype__
 
 /** object name.  */
 
+/* Groups of a user resolved by the server, shared by the contexts of the
+ * requests made by this user. */
+typedef struct fsal_grouplist__
+{
+  uid_t uid;
+  unsigned int refcount;
+  time_t expire;
+  time_t refresh_asked;
+  unsigned int negative;        /* the user is unknown, no groups */
+  unsigned int nbgroups;
+  gid_t *groups;                /* sorted */
+} fsal_grouplist_t;
+
 struct user_credentials {
 	uid_t user;
 	gid_t group;
 	int nbgroups;
 	gid_t alt_groups[FSAL_NGROUPS_MAX];
+	fsal_grouplist_t *grouplist;	/* all the groups of user, or NULL. It is
+					 * held by the context of a worker, a copy
+					 * that outlives the request clears it */
 };
 
 typedef struct fsal_name__
@@ -62,6 +62,7 @@
 #include "mount.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "timer_wheel.h"
 #include "err_LRU_List.h"
 #include "err_HashTable.h"
 
@@ -94,6 +95,11 @@
 /* NFS daemon behavior default values */
 #define NB_WORKER_THREAD_DEFAULT  16
 #define NB_FLUSHER_THREAD_DEFAULT 16
+#define NB_NLM_ASYNC_THREAD_DEFAULT 4
+#define NLM_GRANT_WINDOW_DEFAULT 16
+#define QOS_QUEUE_DEPTH_DEFAULT 2
+#define WORKER_SPAWN_WAIT_DEFAULT 100      /* msec */
+#define WORKER_IDLE_TIMEOUT_DEFAULT 300    /* sec  */
 #define NB_REQUEST_BEFORE_QUEUE_AVG  1000
 #define NB_MAX_CONCURRENT_GC 3
 #define NB_MAX_PENDING_REQUEST 30
@@ -163,6 +169,10 @@
 #define TMP_STR_LEN 256
 #define AUTH_STR_LEN 30
 #define  PWENT_MAX_LEN 81       /* MUST be a multiple of 9 */
+#define IDMAP_EXPIRATION 900
+#define IDMAP_NEGATIVE_EXPIRATION 60
+#define IDMAP_NB_RESOLVERS 2
+#define IDMAP_REFRESH_QUEUE_SIZE 1024
 
 /* IP/name cache error */
 #define CLIENT_ID_SUCCESS             0
@@ -275,7 +285,10 @@ typedef struct nfs_core_param__
   unsigned short port[P_COUNT];
   struct sockaddr_in bind_addr; // IPv4 only for now...
   unsigned int program[P_COUNT];
-  unsigned int nb_worker;
+  unsigned int nb_worker;            /* Worker slots in use, grows up to nb_max_worker */
+  unsigned int nb_max_worker;
+  unsigned int worker_spawn_wait;    /* Queue wait (msec) above which a worker is added */
+  unsigned int worker_idle_timeout;  /* Idle time (sec) after which an added worker exits */
   unsigned int nb_call_before_queue_avg;
   unsigned int nb_max_concurrent_gc;
   long core_dump_size;
@@ -295,8 +308,12 @@ typedef struct nfs_core_param__
   unsigned int core_options;
   unsigned int max_send_buffer_size; /* Size of RPC send buffer */
   unsigned int max_recv_buffer_size; /* Size of RPC recv buffer */
+  bool_t use_qos_scheduler;          /* Fair share between clients and QoS classes */
+  unsigned int qos_queue_depth;      /* Requests handed to a worker ahead of time */
 #ifdef _USE_NLM
   bool_t nsm_use_caller_name;
+  unsigned int nb_nlm_async_thread; /* Threads sending NLM call backs */
+  unsigned int nlm_grant_window;    /* GRANTED_MSG in flight per client */
 #endif
 } nfs_core_parameter_t;
 
@@ -322,6 +339,10 @@ typedef struct nfs_idmap_cache_param__
 {
   hash_parameter_t hash_param;
   char mapfile[MAXPATHLEN];
+  char preload[MAXPATHLEN];                 /**< getent passwd/group dump read at startup  */
+  unsigned int expiration;                  /**< Refresh a mapping after that (s), 0=never */
+  unsigned int negative_expiration;         /**< Remember a failed lookup that long (s)     */
+  unsigned int nb_resolvers;                /**< Threads refreshing the expired mappings   */
 } nfs_idmap_cache_parameter_t;
 
 #ifdef _USE_NFS4_1
@@ -434,6 +455,8 @@ typedef struct nfs_dupreq_stat__
   hash_stat_t htstat;
 } nfs_dupreq_stat_t;
 
+struct nfs_qos_class__;
+
 typedef struct nfs_request_data__
 {
   SVCXPRT *xprt;
@@ -443,6 +466,14 @@ typedef struct nfs_request_data__
   char cred_area[2 * MAX_AUTH_BYTES + RQCRED_SIZE];
   nfs_res_t res_nfs;
   nfs_arg_t arg_nfs;
+
+  /* Fair share scheduler bookkeeping, see nfs_qos.c */
+  struct glist_head qos_list;
+  struct nfs_qos_class__ *qos_class;
+  unsigned int qos_cost;
+  unsigned int qos_payload;
+  unsigned int qos_worker;
+  struct timeval qos_time;
 } nfs_request_data_t;
 
 typedef enum request_type__
@@ -489,6 +520,30 @@ typedef enum idmap_type__
   GIDMAP_TYPE = 2
 } idmap_type_t;
 
+/* Value of the entries of the id mapper caches */
+typedef struct idmap_entry__
+{
+  char name[PWENT_MAX_LEN];
+  unsigned long id;
+  time_t expire;                /* 0 if the mapping never expires */
+  time_t refresh_asked;         /* when a resolver was last asked to refresh it */
+  unsigned int negative;        /* the lookup failed */
+} idmap_entry_t;
+
+typedef struct idmap_cache_stat__
+{
+  unsigned int nb_hit;
+  unsigned int nb_hit_stale;    /* expired mapping used while it is refreshed */
+  unsigned int nb_hit_negative; /* failed lookup remembered */
+  unsigned int nb_miss;
+  unsigned int nb_resolve;
+  unsigned int nb_resolve_err;
+  unsigned int nb_refresh;
+  unsigned int nb_refresh_dropped;
+  unsigned long long total_latency;     /* usec spent by the lookups */
+  unsigned int max_latency;
+} idmap_cache_stat_t;
+
 typedef enum pause_state
 {
   STATE_STARTUP,
@@ -516,6 +571,7 @@ typedef struct nfs_worker_data__
   LRU_list_t *duplicate_request;
   struct prealloc_pool request_pool;
   struct prealloc_pool dupreq_pool;
+  timer_wheel_queue_t dupreq_expired;
   struct prealloc_pool ip_stats_pool;
   struct prealloc_pool clientid_pool;
   cache_inode_client_t cache_inode_client;
@@ -539,6 +595,14 @@ typedef struct nfs_worker_data__
   /* Description of current or most recent function processed and start time (or 0) */
   const nfs_function_desc_t *pfuncdesc;
   struct timeval timer_start;
+
+  /* Elastic pool management, see nfs_worker_pool.c */
+  bool_t elastic;                  /* Slot added on load, its thread may retire */
+  bool_t running;                  /* A thread is serving this slot             */
+  bool_t clients_initialized;      /* Cache clients are kept for the next thread */
+  time_t last_activity;
+
+  nfs_export_reader_t export_reader; /* Exports found by a request outlive a reload */
 } nfs_worker_data_t;
 
 /* flush thread data */
@@ -552,6 +616,7 @@ typedef struct nfs_flush_thread_data__
   unsigned int nb_errors;
   unsigned int nb_orphans;
 
+  nfs_export_reader_t export_reader; /* The exports flushed outlive a reload */
 } nfs_flush_thread_data_t;
 
 typedef struct fridge_entry__
@@ -619,6 +684,12 @@ pause_rc wake_workers(awaken_reason_t reason);
 pause_rc wait_for_workers_to_awaken();
 void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index);
 void *worker_thread(void *IndexArg);
+void *worker_pool_thread(void *UnusedArg);
+void nfs_worker_pool_init(void);
+void nfs_worker_pool_revive(unsigned int worker_index);
+bool_t nfs_worker_pool_retire(nfs_worker_data_t * pworker_data);
+unsigned int nfs_worker_pool_nb_running(void);
+unsigned int nfs_worker_pool_nb_slots(void);
 process_status_t process_rpc_request(SVCXPRT *xprt);
 void *rpc_dispatcher_thread(void *arg);
 void *admin_thread(void *arg);
@@ -628,6 +699,8 @@ void *stat_exporter_thread(void *IndexArg);
 int stats_snmp(nfs_worker_data_t * workers_data_local);
 void *file_content_gc_thread(void *IndexArg);
 void *nfs_file_content_flush_thread(void *flush_data_arg);
+void *cache_inode_snapshot_thread(void *arg);
+void cache_inode_snapshot_stop(void);
 
 #ifdef _USE_UPCALL_SIMULATOR
 void * upcall_simulator_thread( void * UnusedArg ) ;
@@ -646,6 +719,7 @@ void nfs_operate_on_sighup() ;
 void nfs_Init_svc(void);
 void nfs_Init_admin_data(hash_table_t *ht);
 int nfs_Init_worker_data(nfs_worker_data_t * pdata);
+int nfs_Init_worker_slot(unsigned int index, hash_table_t * ht);
 int nfs_Init_request_data(nfs_request_data_t * pdata);
 int nfs_Init_gc_counter(void);
 void constructor_nfs_request_data_t(void *ptr);
@@ -694,6 +768,22 @@ int export_client_matchv6(struct in6_addr *paddrv6,
                           exportlist_client_t *clients,
                           exportlist_client_entry_t * pclient_found,
                           unsigned int export_option);
+int export_client_entry_match(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_entry_t * pclient,
+                              unsigned int i);
+
+/* Compiled client lists, with a cache of the decisions per client address */
+int nfs_export_compile(exportlist_t * pexportlist);
+time_t nfs_export_refresh_netgroups(exportlist_t * pexportlist);
+int export_matcher_compile(exportlist_client_t * clients);
+void export_matcher_free(exportlist_client_t * clients);
+int export_matcher_match(struct export_matcher__ *pmatcher,
+                         sockaddr_t *hostaddr,
+                         char *ipstring,
+                         exportlist_client_t *clients,
+                         exportlist_client_entry_t * pclient_found,
+                         unsigned int export_option);
 
 /* Config reparsing routines */
 void admin_replace_exports();
@@ -830,6 +920,28 @@ int namemap_clear();
 void idmap_get_stats(idmap_type_t maptype, hash_stat_t * phstat,
                      hash_stat_t * phstat_reverse);
 
+int display_idmapper_entry(hash_buffer_t * pbuff, char *str);
+int idmap_preload(char *path, idmap_type_t maptype);
+int idmap_cache_set(idmap_type_t maptype, char *name, unsigned int id, time_t expire);
+int idmap_cache_set_negative_id(idmap_type_t maptype, unsigned int id, time_t expire);
+int idmap_cache_set_negative_name(idmap_type_t maptype, char *name, time_t expire);
+int idmap_cache_get_id(idmap_type_t maptype, unsigned int id, idmap_entry_t * pentry,
+                       int *prefresh);
+int idmap_cache_get_name(idmap_type_t maptype, char *name, idmap_entry_t * pentry,
+                         int *prefresh);
+void idmap_cache_account_resolve(idmap_type_t maptype, int success,
+                                 unsigned int latency, int background);
+void idmap_cache_account_dropped(idmap_type_t maptype);
+void idmap_get_cache_stats(idmap_type_t maptype, idmap_cache_stat_t * pstat);
+int idmap_resolver_init(void);
+void idmap_refresh_grouplist(uid_t uid);
+
+int uid2grp_init(nfs_idmap_cache_parameter_t param);
+fsal_grouplist_t *uid2grp_get(uid_t uid);
+void uid2grp_release(fsal_grouplist_t * plist);
+void uid2grp_refresh(uid_t uid);
+void uid2grp_get_stats(idmap_cache_stat_t * pstat);
+
 int fridgethr_get( pthread_t * pthrid, void *(*thrfunc)(void*), void * thrarg ) ;
 fridge_entry_t * fridgethr_freeze( ) ;
 int fridgethr_init() ;
@@ -867,6 +979,7 @@ const nfs_function_desc_t *nfs_rpc_get_funcdesc(nfs_request_data_t * preqnfs);
 int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pfuncdesc);
 
 void create_fsal_up_threads();
+void stop_fsal_up_threads(exportlist_t ** pentries, unsigned int nb_entries);
 void nfs_Init_FSAL_UP();
 
 #endif                          /* _NFS_CORE_H */
@@ -52,6 +52,7 @@ typedef unsigned long u_long;
 #include "nfs4.h"
 #include "fsal.h"
 #include "nfs_tools.h"
+#include "timer_wheel.h"
 
 typedef struct dupreq_key__
 {
@@ -86,6 +87,8 @@ typedef struct dupreq_entry__
   u_long rq_vers;               /* service protocol version      */
   u_long rq_proc;
   time_t timestamp;
+  timer_wheel_entry_t dupreq_timer;  /* armed once the reply is cached */
+  LRU_entry_t *plru_entry;           /* entry in the owning worker's LRU */
 } dupreq_entry_t;
 
 unsigned int get_rpc_xid(struct svc_req *reqp);
@@ -94,6 +97,9 @@ int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2);
 int print_entry_dupreq(LRU_data_t data, char *str);
 int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam);
 int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam);
+int nfs_dupreq_gc_expired(LRU_list_t * lru_dupreq,
+                          timer_wheel_queue_t * pexpired,
+                          struct prealloc_pool *dupreq_pool);
 
 nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *pstatus);
 int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt,
@@ -108,7 +114,8 @@ int nfs_dupreq_finish(long xid,
 		      struct svc_req *ptr_req,
 		      SVCXPRT *xprt,
 		      nfs_res_t * p_res_nfs,
-		      LRU_list_t * lru_dupreq);
+		      LRU_list_t * lru_dupreq,
+		      timer_wheel_queue_t * pexpired);
 
 unsigned long dupreq_value_hash_func(hash_parameter_t * p_hparam,
                                      hash_buffer_t * buffclef);
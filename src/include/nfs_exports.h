@@ -139,10 +139,13 @@ typedef struct exportlist_client_entry__
 
 #define EXPORTS_NB_MAX_CLIENTS 128
 
+struct export_matcher__;
+
 typedef struct exportlist_client__
 {
   unsigned int num_clients;     /* num clients        */
   exportlist_client_entry_t clientarray[EXPORTS_NB_MAX_CLIENTS];        /* allowed clients    */
+  struct export_matcher__ *matcher;     /* compiled list, NULL if not compiled */
 } exportlist_client_t;
 
 /* fsal up filter list is needed in exportlist.
@@ -150,6 +153,7 @@ typedef struct exportlist_client__
 #ifdef _USE_FSAL_UP
 struct fsal_up_filter_list_t_;
 #endif
+struct nfs_qos_class__;
 
 typedef struct exportlist__
 {
@@ -185,6 +189,7 @@ typedef struct exportlist__
 
   bool_t use_ganesha_write_buffer;
   bool_t use_commit;
+  bool_t manage_gids;           /* Groups of the users are resolved by the server */
 
   fsal_size_t MaxRead;          /* Max Read for this entry                           */
   fsal_size_t MaxWrite;         /* Max Write for this entry                          */
@@ -201,11 +206,19 @@ typedef struct exportlist__
 
   cache_inode_policy_t cache_inode_policy ;
 
+  unsigned long long config_signature;  /* Hash of the configuration block, to detect changes at reload */
+
+  char qos_class_name[MAXNAMLEN];       /* QoS class of the scheduler, empty for none  */
+  unsigned int qos_weight;              /* Share of the class, relative to the others  */
+  unsigned int qos_max_inflight;        /* Requests of the class in workers, 0 = any   */
+  unsigned long long qos_max_bandwidth; /* READ/WRITE bytes per second, 0 = unlimited */
+
 #ifdef _USE_FSAL_UP
   bool_t use_fsal_up;
   char fsal_up_type[MAXPATHLEN];
   fsal_time_t fsal_up_timeout;
   pthread_t fsal_up_thr; /* This value may be modified later to point to an FSAL CB thread. */
+  volatile bool_t fsal_up_stop; /* Set when the export is removed, its FSAL CB thread exits */
   struct fsal_up_filter_list_t_ *fsal_up_filter_list; /* List of filters to apply through FSAL CB interface. */
 #endif /* _USE_FSAL_UP */
 } exportlist_t;
@@ -355,6 +368,23 @@ typedef struct compoud_data
 
 /* Export list related functions */
 exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exportid);
+void nfs_Build_export_index(exportlist_t * exportroot);
+
+/* A thread that uses export entries. The entries it finds between
+ * nfs_export_read_begin and nfs_export_read_end are not freed by a reload.
+ * The sections may nest, the outermost one counts. */
+typedef struct nfs_export_reader__
+{
+  volatile unsigned int epoch;  /* Grace period it entered in, 0 when outside */
+  unsigned int depth;           /* Sections the thread is in */
+  int registered;
+  struct nfs_export_reader__ *next;
+} nfs_export_reader_t;
+
+void nfs_export_reader_register(nfs_export_reader_t * preader);
+void nfs_export_read_begin(nfs_export_reader_t * preader);
+void nfs_export_read_end(nfs_export_reader_t * preader);
+void nfs_export_synchronize(void);
 int nfs_check_anon(exportlist_client_entry_t * pexport_client,
                     exportlist_t * pexport,
                     struct user_cred *user_credentials);
@@ -0,0 +1,110 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_qos.h
+ * \brief   Fair share scheduler between the dispatcher and the workers.
+ *
+ * nfs_qos.h : Fair share scheduler between the dispatcher and the workers.
+ *
+ * Requests are sorted in flows and handed to the workers in deficit round
+ * robin order, only as fast as the workers consume them. Requests on an
+ * export with a QoS_Class share the flow of that class, the other requests
+ * are spread on per client flows.
+ *
+ */
+
+#ifndef _NFS_QOS_H
+#define _NFS_QOS_H
+
+#include <sys/time.h>
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "timer_wheel.h"
+
+/* Number of flows the clients without a QoS class are hashed on */
+#define NFS_QOS_CLIENT_FLOWS   64
+
+/* Maximum number of classes (including the default one) */
+#define NFS_QOS_MAX_CLASSES    32
+
+/* Cost of a request, on top of its READ/WRITE payload */
+#define NFS_QOS_BASE_COST      4096
+
+/* Credit given to a flow of weight 1 at each round */
+#define NFS_QOS_QUANTUM        65536
+
+#define NFS_QOS_DEFAULT_CLASS  "default"
+
+typedef struct nfs_qos_stat__
+{
+  unsigned int queue_depth;                    /**< Requests waiting now                  */
+  unsigned int max_queue_depth;
+  unsigned int inflight;                       /**< Requests given to the workers now     */
+  unsigned long long nb_dispatched;
+  unsigned long long nb_throttled;             /**< Rounds skipped for the bandwidth limit */
+  unsigned long long total_wait;               /**< Time spent in the scheduler, in usec  */
+  unsigned long long max_wait;
+} nfs_qos_stat_t;
+
+typedef struct nfs_qos_flow__
+{
+  struct glist_head active_list;               /**< Link in the round robin list          */
+  struct glist_head queue;                     /**< Waiting requests, oldest first        */
+  unsigned int deficit;
+  int has_turn;
+  struct nfs_qos_class__ *pclass;
+} nfs_qos_flow_t;
+
+typedef struct nfs_qos_class__
+{
+  char name[MAXNAMLEN];
+  unsigned int weight;
+  unsigned int max_inflight;                   /**< 0 means no limit                      */
+  unsigned long long max_bandwidth;            /**< bytes per second, 0 means no limit    */
+  long long tokens;
+  struct timeval last_refill;
+  timer_wheel_entry_t refill_timer;
+  int refill_armed;
+  nfs_qos_flow_t flow;                         /**< Not used by the default class         */
+  nfs_qos_stat_t stats;
+  int in_use;                                  /**< The slot holds a class                */
+  int retired;                                 /**< No export uses it, freed once idle    */
+} nfs_qos_class_t;
+
+typedef struct nfs_qos_class_stat__
+{
+  char name[MAXNAMLEN];
+  nfs_qos_stat_t stats;
+} nfs_qos_class_stat_t;
+
+int nfs_qos_init(exportlist_t * pexportlist);
+int nfs_qos_update_exports(exportlist_t * pexportlist);
+void nfs_qos_enqueue(request_data_t * preq, unsigned int worker_index);
+void nfs_qos_complete(request_data_t * preq);
+unsigned long long nfs_qos_oldest_wait(struct timeval *pnow);
+unsigned int nfs_qos_get_stats(nfs_qos_class_stat_t * pstat, unsigned int nb_max);
+
+#endif                          /* _NFS_QOS_H */
@@ -26,6 +26,7 @@ pause_rc wait_for_threads_to_awaken(void);
 void wait_for_threads_to_exit(void);
 pause_rc _wait_for_threads_to_pause(void);
 int tcb_new(nfs_tcb_t *element, char *name);
+int tcb_revive(nfs_tcb_t *element);
 thread_sm_t thread_sm_locked(nfs_tcb_t *tcbp);
 
 #endif
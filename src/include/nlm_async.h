@@ -34,10 +34,6 @@
 #include "cache_inode.h"
 #include "sal_data.h"
 
-extern pthread_mutex_t                nlm_async_resp_mutex;
-extern pthread_cond_t                 nlm_async_resp_cond;
-extern cache_inode_client_t           nlm_async_cache_inode_client;
-
 
 typedef struct nlm_async_queue_t nlm_async_queue_t;
 
@@ -49,6 +45,7 @@ struct nlm_async_queue_t
   nlm_callback_func        * nlm_async_func;
   state_nlm_client_t       * nlm_async_host;
   void                     * nlm_async_key;
+  cache_inode_client_t     * nlm_async_pclient;   /* set by the sender running func */
   union
     {
       nfs_res_t              nlm_async_res;
@@ -57,6 +54,7 @@ struct nlm_async_queue_t
 };
 
 int nlm_async_callback(nlm_async_queue_t *arg);
+int nlm_async_tcb_init();
 int nlm_async_callback_init();
 
 int nlm_send_async_res_nlm4(state_nlm_client_t * host,
@@ -73,7 +71,7 @@ typedef struct
   xdrproc_t outproc;
 } nlm_reply_proc_t;
 
-/* Client routine  to send the asynchrnous response, key is used to wait for a response */
+/* Client routine  to send the asynchrnous response, key is used to match a response */
 int nlm_send_async(int                  proc,
                    state_nlm_client_t * host,
                    void               * inarg,
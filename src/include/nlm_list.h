@@ -82,7 +82,7 @@ static inline void glist_add_list_tail(struct glist_head *list, struct glist_hea
   struct glist_head *first = new->next;
   struct glist_head *last = new->prev;
 
-  if(new->next == new->prev)
+  if(new->next == new)
     {
       /* nothing to add */
       return;
@@ -119,6 +119,8 @@ struct svc_rpc_gss_data
   uint32_t seqmask;             /* bitmask of seqnums */
   gss_name_t client_name;       /* unparsed name string */
   gss_buffer_desc checksum;     /* so we can free it */
+  struct gss_ctx_cache_entry__ *pcached; /* cached context that ctx, cname and client_name
+                                          * are borrowed from, NULL if they are owned */
 };
 
 typedef struct nfs_krb5_param__
@@ -381,6 +381,7 @@ struct state_lock_entry_t
   struct glist_head      sle_list;
   struct glist_head      sle_owner_locks;
   struct glist_head      sle_locks;
+  struct glist_head      sle_blocked_locks;
 #ifdef _DEBUG_MEMLEAKS
   struct glist_head      sle_all_locks;
 #endif
@@ -80,8 +80,8 @@ struct prealloc_pool;
 #  define Mem_Alloc( a )                  BuddyMallocExit( a )
 #  define Mem_Calloc( s1, s2 )            BuddyCalloc( s1, s2 )
 #  define Mem_Realloc( p, s)              BuddyRealloc( (caddr_t)(p), s )
-#  define Mem_Alloc_Label( a, lbl )       BuddyMallocExit( a )
-#  define Mem_Calloc_Label( s1, s2, lbl ) BuddyCalloc( s1, s2 )
+#  define Mem_Alloc_Label( a, lbl )       BuddyMallocExit_Label( a, lbl )
+#  define Mem_Calloc_Label( s1, s2, lbl ) BuddyCalloc_Label( s1, s2, lbl )
 #  define Mem_Realloc_Label( p, s, lbl)   BuddyRealloc( (caddr_t)(p), s )
 #  define Mem_Free( a )                   BuddyFree( (caddr_t) (a) )
 #  define Mem_Free_Label( a, lbl )        BuddyFree( (caddr_t) (a) )
@@ -0,0 +1,118 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    timer_wheel.h
+ * \brief   Hierarchical timer wheel used for every expiry in the server.
+ *
+ * timer_wheel.h : Hierarchical timer wheel used for every expiry in the server.
+ *
+ * Subsystems embed a timer_wheel_entry_t in the object that expires and arm
+ * it with a delay. Insertion and cancellation are O(1), and the wheel thread
+ * only touches the entries that actually expire.
+ *
+ * An expired entry is either handed to its call back, run in the wheel
+ * thread, or, for objects owned by another thread (like a worker's duplicate
+ * request cache), appended to a timer_wheel_queue_t that the owner drains
+ * at its convenience.
+ *
+ */
+
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "nlm_list.h"
+
+/* Resolution of the wheel */
+#define TIMER_WHEEL_TICK_MSEC  100
+
+/* Level 0 has 256 one tick slots, the upper levels 64 slots each */
+#define TIMER_WHEEL_ROOT_BITS  8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_NB_LEVELS  4
+
+#define TIMER_WHEEL_ROOT_SIZE  (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+
+typedef enum timer_wheel_state__
+{
+  TIMER_WHEEL_IDLE   = 0,
+  TIMER_WHEEL_ARMED  = 1,
+  TIMER_WHEEL_QUEUED = 2,
+  TIMER_WHEEL_FIRING = 3                       /**< Expired, its call back is about to run */
+} timer_wheel_state_t;
+
+typedef struct timer_wheel_entry__ timer_wheel_entry_t;
+
+typedef void (*timer_wheel_func_t) (timer_wheel_entry_t * pentry, void *arg);
+
+typedef struct timer_wheel_queue__
+{
+  struct glist_head twq_list;                  /**< Expired entries, oldest first         */
+  unsigned int twq_count;                      /**< Number of entries in twq_list          */
+} timer_wheel_queue_t;
+
+struct timer_wheel_entry__
+{
+  struct glist_head twe_list;                  /**< Link in a wheel slot or in a queue     */
+  uint64_t twe_expire;                         /**< Expiry, in ticks                       */
+  timer_wheel_state_t twe_state;
+  timer_wheel_func_t twe_func;                 /**< Call back, or NULL if twe_queue is set */
+  void *twe_arg;
+  timer_wheel_queue_t *twe_queue;              /**< Where to deliver when expired          */
+};
+
+/* Ticks elapsed since timer_wheel_init */
+typedef uint64_t(*timer_wheel_clock_t) (void);
+
+typedef struct timer_wheel_stat__
+{
+  unsigned long long nb_armed;                 /**< Entries currently in the wheel         */
+  unsigned long long nb_add;
+  unsigned long long nb_cancel;
+  unsigned long long nb_expired;
+  unsigned long long nb_cascaded;
+} timer_wheel_stat_t;
+
+int timer_wheel_init(void);
+void *timer_wheel_thread(void *arg);
+void timer_wheel_tick(void);
+void timer_wheel_set_clock(timer_wheel_clock_t clock);
+
+void timer_wheel_entry_init(timer_wheel_entry_t * pentry,
+                            timer_wheel_func_t func,
+                            void *arg,
+                            timer_wheel_queue_t * pqueue);
+void timer_wheel_add(timer_wheel_entry_t * pentry, unsigned int delay_msec);
+int timer_wheel_cancel(timer_wheel_entry_t * pentry);
+
+void timer_wheel_queue_init(timer_wheel_queue_t * pqueue);
+timer_wheel_entry_t *timer_wheel_queue_get(timer_wheel_queue_t * pqueue);
+
+void timer_wheel_get_stats(timer_wheel_stat_t * pstat);
+
+#endif                          /* _TIMER_WHEEL_H */
@@ -120,10 +120,15 @@ cache_content_client_t recover_datacache_client;
 #define CONF_EXPORT_PNFS               "Use_pNFS"
 #define CONF_EXPORT_USE_COMMIT                  "Use_NFS_Commit"
 #define CONF_EXPORT_USE_GANESHA_WRITE_BUFFER    "Use_Ganesha_Write_Buffer"
+#define CONF_EXPORT_MANAGE_GIDS        "Manage_Gids"
 #define CONF_EXPORT_USE_FSAL_UP        "Use_FSAL_UP"
 #define CONF_EXPORT_FSAL_UP_FILTERS    "FSAL_UP_Filters"
 #define CONF_EXPORT_FSAL_UP_TIMEOUT    "FSAL_UP_Timeout"
 #define CONF_EXPORT_FSAL_UP_TYPE       "FSAL_UP_Type"
+#define CONF_EXPORT_QOS_CLASS          "QoS_Class"
+#define CONF_EXPORT_QOS_WEIGHT         "QoS_Weight"
+#define CONF_EXPORT_QOS_MAX_INFLIGHT   "QoS_Max_Inflight"
+#define CONF_EXPORT_QOS_MAX_BANDWIDTH  "QoS_Max_Bandwidth"
 
 /** @todo : add encrypt handles option */
 
@@ -625,6 +630,26 @@ int parseAccessParam(char *var_name, char *var_value,
   return rc;
 }
 
+/**
+ * export_signature_add : adds a "name = value" item to the signature of an
+ * export block (FNV-1a 64). Two blocks with the same items in the same order
+ * get the same signature, this is how a reload finds the unchanged exports.
+ */
+static unsigned long long export_signature_add(unsigned long long signature,
+                                               char *var_name, char *var_value)
+{
+  unsigned char *p;
+
+  for(p = (unsigned char *)var_name; *p != '\0'; p++)
+    signature = (signature ^ *p) * 1099511628211ULL;
+  signature = (signature ^ '=') * 1099511628211ULL;
+  for(p = (unsigned char *)var_value; *p != '\0'; p++)
+    signature = (signature ^ *p) * 1099511628211ULL;
+  signature = (signature ^ '\n') * 1099511628211ULL;
+
+  return signature;
+}
+
 /**
  * BuildExportEntry : builds an export entry from configutation file.
  * Don't stop immediately on error,
@@ -662,6 +687,7 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
   memset(p_entry, 0, sizeof(exportlist_t));
 
   p_entry->status = EXPORTLIST_OK;
+  p_entry->config_signature = 14695981039346656037ULL;
   p_entry->access_type = ACCESSTYPE_RW;
   p_entry->anonymous_uid = (uid_t) ANON_UID;
   p_entry->anonymous_gid = (gid_t) ANON_GID;
@@ -677,6 +703,7 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
   strncpy(p_entry->fsal_up_type,"DUMB", 4);
   /* We don't create the thread until all exports are parsed. */
   memset(&p_entry->fsal_up_thr, 0, sizeof(pthread_t));
+  p_entry->fsal_up_stop = FALSE;
 #endif /* _USE_FSAL_UP */
 
   /* by default, we support auth_none and auth_sys */
@@ -731,6 +758,9 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
           return -1;
         }
 
+      p_entry->config_signature =
+          export_signature_add(p_entry->config_signature, var_name, var_value);
+
       if(!STRCMP(var_name, CONF_EXPORT_ID))
         {
 
@@ -1921,6 +1951,28 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
               p_entry->use_commit = FALSE;
               break;
 
+            default:           /* error */
+              {
+                LogCrit(COMPONENT_CONFIG,
+                        "NFS READ_EXPORT: ERROR: Invalid value for %s (%s): TRUE or FALSE expected.",
+                        var_name, var_value);
+                err_flag = TRUE;
+                continue;
+              }
+            }
+        }
+      else if(!STRCMP(var_name, CONF_EXPORT_MANAGE_GIDS))
+        {
+          switch (StrToBoolean(var_value))
+            {
+            case 1:
+              p_entry->manage_gids = TRUE;
+              break;
+
+            case 0:
+              p_entry->manage_gids = FALSE;
+              break;
+
             default:           /* error */
               {
                 LogCrit(COMPONENT_CONFIG,
@@ -1998,6 +2050,38 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
             }
         }
 #endif /* _USE_FSAL_UP */
+      else if(!STRCMP(var_name, CONF_EXPORT_QOS_CLASS))
+        {
+          strncpy(p_entry->qos_class_name, var_value, MAXNAMLEN - 1);
+          p_entry->qos_class_name[MAXNAMLEN - 1] = '\0';
+        }
+      else if(!STRCMP(var_name, CONF_EXPORT_QOS_WEIGHT) ||
+              !STRCMP(var_name, CONF_EXPORT_QOS_MAX_INFLIGHT) ||
+              !STRCMP(var_name, CONF_EXPORT_QOS_MAX_BANDWIDTH))
+        {
+          long long int value;
+          char *end_ptr;
+
+          errno = 0;
+          value = strtoll(var_value, &end_ptr, 10);
+
+          if(end_ptr == NULL || *end_ptr != '\0' || errno != 0 || value < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "NFS READ_EXPORT: ERROR: Invalid %s: \"%s\"",
+                      var_name, var_value);
+              err_flag = TRUE;
+              continue;
+            }
+
+          if(!STRCMP(var_name, CONF_EXPORT_QOS_WEIGHT))
+            p_entry->qos_weight = (unsigned int) value;
+          else if(!STRCMP(var_name, CONF_EXPORT_QOS_MAX_INFLIGHT))
+            p_entry->qos_max_inflight = (unsigned int) value;
+          else
+            /* Given in kilobytes per second */
+            p_entry->qos_max_bandwidth = (unsigned long long) value * 1024;
+        }
       else if(!STRCMP(var_name, CONF_EXPORT_FSALID))
         {
            if( ( p_entry->fsalid = FSAL_name2fsalid( var_value ) ) == -1 )
@@ -2128,6 +2212,7 @@ exportlist_t *BuildDefaultExport()
   p_entry->options = 0;
   p_entry->status = EXPORTLIST_OK;
   p_entry->clients.num_clients = 0;
+  p_entry->clients.matcher = NULL;
   p_entry->access_type = ACCESSTYPE_RW;
   p_entry->anonymous_uid = (uid_t) ANON_UID;
   p_entry->MaxOffsetWrite = (fsal_off_t) 0;
@@ -2271,10 +2356,153 @@ int ReadExports(config_file_t in_config,        /* The file that contains the ex
     {
       return -1;
     }
-  else
-    return nb_entries;
+
+  /* The client lists are compiled once for all the requests */
+  nfs_export_compile(*ppexportlist);
+
+  return nb_entries;
 }
 
+/**
+ * export_client_entry_match: tests one client of an export list.
+ *
+ * The options of the client are not checked, GSSPRINCIPAL_CLIENT entries are
+ * never matched.
+ *
+ * @param hostaddr [IN] the address of the client.
+ * @param ipstring [IN] the address as a string, for the wildcards.
+ * @param pclient  [IN] the client entry to test.
+ * @param i        [IN] the position of the entry in the list.
+ *
+ * @return TRUE if the client matches the entry, FALSE otherwise.
+ *
+ */
+int export_client_entry_match(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_entry_t * pclient,
+                              unsigned int i)
+{
+  int rc;
+  char hostname[MAXHOSTNAMELEN];
+  in_addr_t addr = get_in_addr(hostaddr);
+
+  switch (pclient->type)
+    {
+    case HOSTIF_CLIENT:
+      if(pclient->client.hostif.clientaddr == addr)
+        {
+          LogFullDebug(COMPONENT_DISPATCH, "This matches host address");
+          return TRUE;
+        }
+      break;
+
+    case NETWORK_CLIENT:
+      LogDebug( COMPONENT_DISPATCH, "test NETWORK_CLIENT: addr=%#.08X, netmask=%#.08X, match with %#.08X",
+                pclient->client.network.netaddr,
+                pclient->client.network.netmask, ntohl(addr));
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Test net %d.%d.%d.%d in %d.%d.%d.%d ??",
+                   (unsigned int)(pclient->client.network.netaddr >> 24),
+                   (unsigned int)((pclient->client.network.netaddr >> 16) & 0xFF),
+                   (unsigned int)((pclient->client.network.netaddr >> 8) & 0xFF),
+                   (unsigned int)(pclient->client.network.netaddr & 0xFF),
+                   (unsigned int)(addr >> 24),
+                   (unsigned int)(addr >> 16) & 0xFF,
+                   (unsigned int)(addr >> 8) & 0xFF,
+                   (unsigned int)(addr & 0xFF));
+
+      if((pclient->client.network.netmask & ntohl(addr)) ==
+         pclient->client.network.netaddr)
+        {
+          LogFullDebug(COMPONENT_DISPATCH, "This matches network address");
+          return TRUE;
+        }
+      break;
+
+    case NETGROUP_CLIENT:
+      /* Try to get the entry from th IP/name cache */
+      if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
+        {
+          if(rc == IP_NAME_NOT_FOUND)
+            {
+              /* IPaddr was not cached, add it to the cache */
+              if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
+                {
+                  /* Major failure, name could not be resolved */
+                  break;
+                }
+            }
+        }
+
+      /* At this point 'hostname' should contain the name that was found */
+      if(innetgr
+         (pclient->client.netgroup.netgroupname, hostname,
+          NULL, NULL) == 1)
+        {
+          return TRUE;
+        }
+      break;
+
+    case WILDCARDHOST_CLIENT:
+      /* Now checking for IP wildcards */
+      if(fnmatch
+         (pclient->client.wildcard.wildcard, ipstring,
+          FNM_PATHNAME) == 0)
+        {
+          return TRUE;
+        }
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Did not match the ip address with a wildcard.");
+
+      /* Try to get the entry from th IP/name cache */
+      if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
+        {
+          if(rc == IP_NAME_NOT_FOUND)
+            {
+              /* IPaddr was not cached, add it to the cache */
+              if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
+                {
+                  /* Major failure, name could not be resolved */
+                  LogFullDebug(COMPONENT_DISPATCH,
+                               "Could not resolve hostame for addr %u.%u.%u.%u ... not checking if a hostname wildcard matches",
+                               (unsigned int)(addr & 0xFF),
+                               (unsigned int)(addr >> 8) & 0xFF,
+                               (unsigned int)(addr >> 16) & 0xFF,
+                               (unsigned int)(addr >> 24));
+                  break;
+                }
+            }
+        }
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Wildcarded hostname: testing if '%s' matches '%s'",
+                   hostname, pclient->client.wildcard.wildcard);
+
+      /* At this point 'hostname' should contain the name that was found */
+      if(fnmatch
+         (pclient->client.wildcard.wildcard, hostname,
+          FNM_PATHNAME) == 0)
+        {
+          return TRUE;
+        }
+      LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
+                   hostname, pclient->client.wildcard.wildcard);
+      break;
+
+    case BAD_CLIENT:
+      LogDebug(COMPONENT_DISPATCH,
+               "Bad client in position %u seen in export list", i);
+      break;
+
+    default:
+      LogCrit(COMPONENT_DISPATCH,
+              "Unsupported client in position %u in export list with type %u", i, pclient->type);
+      break;
+    }                           /* switch */
+
+  return FALSE;
+}                               /* export_client_entry_match */
+
 /**
  * function for matching a specific option in the client export list.
  */
@@ -2284,10 +2512,8 @@ int export_client_match(sockaddr_t *hostaddr,
 			exportlist_client_entry_t * pclient_found,
 			unsigned int export_option)
 {
+  struct export_matcher__ *pmatcher;
   unsigned int i;
-  int rc;
-  char hostname[MAXHOSTNAMELEN];
-  in_addr_t addr = get_in_addr(hostaddr);
 
   if(export_option & EXPORT_OPTION_ROOT)
     LogFullDebug(COMPONENT_DISPATCH,
@@ -2301,6 +2527,13 @@ int export_client_match(sockaddr_t *hostaddr,
     LogFullDebug(COMPONENT_DISPATCH,
                  "Looking for nonroot access write entries");
 
+  /* The lists read from the configuration are compiled, the admin thread may
+   * replace the compiled form meanwhile */
+  pmatcher = clients->matcher;
+  if(pmatcher != NULL)
+    return export_matcher_match(pmatcher, hostaddr, ipstring, clients,
+                                pclient_found, export_option);
+
   for(i = 0; i < clients->num_clients; i++)
     {
       /* Make sure the client entry has the permission flags we're looking for
@@ -2309,131 +2542,19 @@ int export_client_match(sockaddr_t *hostaddr,
          ((clients->clientarray[i].options & EXPORT_OPTION_ROOT) != (export_option & EXPORT_OPTION_ROOT)))
         continue;
 
-      switch (clients->clientarray[i].type)
+      if(clients->clientarray[i].type == GSSPRINCIPAL_CLIENT)
         {
-        case HOSTIF_CLIENT:
-          if(clients->clientarray[i].client.hostif.clientaddr == addr)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "This matches host address");
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
-        case NETWORK_CLIENT:
-          LogDebug( COMPONENT_DISPATCH, "test NETWORK_CLIENT: addr=%#.08X, netmask=%#.08X, match with %#.08X",
-                    clients->clientarray[i].client.network.netaddr,
-                    clients->clientarray[i].client.network.netmask, ntohl(addr));
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Test net %d.%d.%d.%d in %d.%d.%d.%d ??",
-                       (unsigned int)(clients->clientarray[i].client.network.netaddr >> 24),
-                       (unsigned int)((clients->clientarray[i].client.network.netaddr >> 16) & 0xFF),
-                       (unsigned int)((clients->clientarray[i].client.network.netaddr >> 8) & 0xFF),
-                       (unsigned int)(clients->clientarray[i].client.network.netaddr & 0xFF),
-                       (unsigned int)(addr >> 24),
-                       (unsigned int)(addr >> 16) & 0xFF,
-                       (unsigned int)(addr >> 8) & 0xFF,
-                       (unsigned int)(addr & 0xFF));
-
-          if((clients->clientarray[i].client.network.netmask & ntohl(addr)) ==
-             clients->clientarray[i].client.network.netaddr)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "This matches network address");
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
-        case NETGROUP_CLIENT:
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      break;
-                    }
-                }
-            }
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(innetgr
-             (clients->clientarray[i].client.netgroup.netgroupname, hostname,
-              NULL, NULL) == 1)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
-        case WILDCARDHOST_CLIENT:
-          /* Now checking for IP wildcards */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, ipstring,
-              FNM_PATHNAME) == 0)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Did not match the ip address with a wildcard.");
-
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      LogFullDebug(COMPONENT_DISPATCH,
-                                   "Could not resolve hostame for addr %u.%u.%u.%u ... not checking if a hostname wildcard matches",
-                                   (unsigned int)(addr & 0xFF),
-                                   (unsigned int)(addr >> 8) & 0xFF,
-                                   (unsigned int)(addr >> 16) & 0xFF,
-                                   (unsigned int)(addr >> 24));
-                      break;
-                    }
-                }
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Wildcarded hostname: testing if '%s' matches '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, hostname,
-              FNM_PATHNAME) == 0)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
-          break;
-
-        case GSSPRINCIPAL_CLIENT:
           /** @toto BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
           LogFullDebug(COMPONENT_DISPATCH,
                        "----------> Unsupported type GSS_PRINCIPAL_CLIENT");
           return FALSE;
-          break;
-
-       case BAD_CLIENT:
-          LogDebug(COMPONENT_DISPATCH,
-                  "Bad client in position %u seen in export list", i );
-	  continue ;
+        }
 
-        default:
-           LogCrit(COMPONENT_DISPATCH,
-                   "Unsupported client in position %u in export list with type %u", i, clients->clientarray[i].type);
-	   continue ;
-        }                       /* switch */
+      if(export_client_entry_match(hostaddr, ipstring, &clients->clientarray[i], i))
+        {
+          *pclient_found = clients->clientarray[i];
+          return TRUE;
+        }
     }                           /* for */
 
   /* no export found for this option */
@@ -3027,11 +3148,11 @@ int nfs_export_create_root_entry(exportlist_t * pexportlist, hash_table_t * ht)
                        pcurrent->id);
 #ifdef _USE_SHARED_FSAL
               if(cache_content_crash_recover
-                 (pcurrent->id, &recover_datacache_client, &small_client, ht, &context,
+                 (pcurrent->id, 0, 1, &recover_datacache_client, &small_client, ht, &context,
                   &cache_content_status) != CACHE_CONTENT_SUCCESS)
 #else
               if(cache_content_crash_recover
-                 (pcurrent->id, &recover_datacache_client, &small_client, ht, &context[pcurrent->fsalid],
+                 (pcurrent->id, 0, 1, &recover_datacache_client, &small_client, ht, &context[pcurrent->fsalid],
                   &cache_content_status) != CACHE_CONTENT_SUCCESS)
 #endif
                 {
@@ -3066,6 +3187,8 @@ exportlist_t *RemoveExportEntry(exportlist_t * exportEntry)
 
   next = exportEntry->next;
 
+  export_matcher_free(&exportEntry->clients);
+
   if (exportEntry->proot_handle != NULL)
     Mem_Free(exportEntry->proot_handle);
 
@@ -114,6 +114,206 @@ const char *Rpc_gss_svc_name[] =
   "RPCSEC_GSS_SVC_PRIVACY"
 };
 
+/* The exports of nfs_param.pexportlist indexed by id, rebuilt at each reload.
+ * A new index is published in place of the old one, which is freed once no
+ * reader may still use it (see nfs_export_synchronize) */
+typedef struct nfs_export_index__
+{
+  exportlist_t *root;
+  unsigned int size;
+  exportlist_t **entries;
+} nfs_export_index_t;
+
+static nfs_export_index_t *volatile export_index = NULL;
+static nfs_export_index_t *export_index_retired = NULL;
+
+/* Readers of the export list, the epoch is bumped at each grace period.
+ * A reader leaving a section signals export_readers_cond while a grace
+ * period is waited for. */
+static nfs_export_reader_t *export_readers = NULL;
+static volatile unsigned int export_epoch = 1;
+static volatile int export_sync_waiting = FALSE;
+static pthread_mutex_t export_readers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_readers_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ *
+ * nfs_export_reader_register: declares a thread that reads the export list.
+ *
+ * The reader must stay allocated for the life of the server.
+ *
+ * @param preader [INOUT] the reader, zeroed.
+ *
+ */
+void nfs_export_reader_register(nfs_export_reader_t * preader)
+{
+  P(export_readers_mutex);
+  if(!preader->registered)
+    {
+      preader->epoch = 0;
+      preader->depth = 0;
+      preader->next = export_readers;
+      preader->registered = TRUE;
+      export_readers = preader;
+    }
+  V(export_readers_mutex);
+}                               /* nfs_export_reader_register */
+
+/**
+ *
+ * nfs_export_read_begin: the reader starts to use the exports.
+ *
+ * Between nfs_export_read_begin and nfs_export_read_end, the export entries
+ * the reader finds are not freed, even if a reload removes them. A section
+ * begun inside another one ends with it.
+ *
+ * @param preader [INOUT] the reader.
+ *
+ */
+void nfs_export_read_begin(nfs_export_reader_t * preader)
+{
+  if(preader->depth++ != 0)
+    return;
+
+  preader->epoch = export_epoch;
+  __sync_synchronize();
+}                               /* nfs_export_read_begin */
+
+/**
+ *
+ * nfs_export_read_end: the reader no longer uses the exports it found.
+ *
+ * @param preader [INOUT] the reader.
+ *
+ */
+void nfs_export_read_end(nfs_export_reader_t * preader)
+{
+  if(preader->depth == 0)
+    {
+      LogCrit(COMPONENT_MAIN,
+              "nfs_export_read_end: the reader is not in a read section");
+      return;
+    }
+
+  if(--preader->depth != 0)
+    return;
+
+  __sync_synchronize();
+  preader->epoch = 0;
+
+  /* Either the waiter sees the epoch cleared, or it is seen waiting here */
+  __sync_synchronize();
+  if(export_sync_waiting)
+    {
+      P(export_readers_mutex);
+      pthread_cond_broadcast(&export_readers_cond);
+      V(export_readers_mutex);
+    }
+}                               /* nfs_export_read_end */
+
+/**
+ *
+ * nfs_export_synchronize: waits for a grace period.
+ *
+ * Returns once every reader that may have found an entry unpublished before
+ * the call is done with it. The replaced indexes are freed then.
+ *
+ */
+void nfs_export_synchronize(void)
+{
+  nfs_export_reader_t *preader;
+  unsigned int epoch;
+  unsigned int nb_waits = 0;
+
+  P(export_readers_mutex);
+
+  __sync_synchronize();
+  epoch = ++export_epoch;
+  export_sync_waiting = TRUE;
+  __sync_synchronize();
+
+  /* The readers leaving a section wake this thread up, they take
+   * export_readers_mutex to do so and can't miss the wait */
+  for(preader = export_readers; preader != NULL; preader = preader->next)
+    while(preader->epoch != 0 && preader->epoch < epoch)
+      {
+        pthread_cond_wait(&export_readers_cond, &export_readers_mutex);
+        nb_waits++;
+      }
+
+  export_sync_waiting = FALSE;
+
+  V(export_readers_mutex);
+
+  LogDebug(COMPONENT_MAIN,
+           "Export list grace period %u elapsed after %u wake ups",
+           epoch, nb_waits);
+
+  if(export_index_retired != NULL)
+    {
+      Mem_Free(export_index_retired);
+      export_index_retired = NULL;
+    }
+}                               /* nfs_export_synchronize */
+
+/**
+ *
+ * nfs_Build_export_index: Indexes the entries of an export list by id.
+ *
+ * nfs_Get_export_by_id uses the index for this list, the other lists are still
+ * scanned. The index replaced is freed by the next nfs_export_synchronize.
+ *
+ * The workers are not stopped while the index is replaced. Only the admin
+ * thread builds an index; it is filled before it is published, and a reader
+ * loads the published pointer once per lookup, inside its read section, so
+ * it sees the old index or the new one, whole. The entries it returns stay
+ * allocated until the section ends: the admin thread frees the replaced
+ * index and the removed entries only after a grace period.
+ *
+ * @param exportroot [IN] the root for the export list
+ *
+ */
+void nfs_Build_export_index(exportlist_t * exportroot)
+{
+  exportlist_t *piter;
+  nfs_export_index_t *pindex = NULL;
+  unsigned int size = 0;
+
+  for(piter = exportroot; piter != NULL; piter = piter->next)
+    if(piter->id >= size)
+      size = piter->id + 1;
+
+  if(size > 0)
+    {
+      pindex = (nfs_export_index_t *) Mem_Alloc(sizeof(nfs_export_index_t) +
+                                                size * sizeof(exportlist_t *));
+      if(pindex == NULL)
+        LogCrit(COMPONENT_INIT,
+                "nfs_Build_export_index: could not allocate the index, exports will be looked up in the list");
+      else
+        {
+          pindex->root = exportroot;
+          pindex->size = size;
+          pindex->entries = (exportlist_t **) (pindex + 1);
+          memset(pindex->entries, 0, size * sizeof(exportlist_t *));
+
+          /* The first entry wins, as in the list */
+          for(piter = exportroot; piter != NULL; piter = piter->next)
+            if(pindex->entries[piter->id] == NULL)
+              pindex->entries[piter->id] = piter;
+        }
+    }
+
+  if(export_index_retired != NULL)
+    LogCrit(COMPONENT_INIT,
+            "nfs_Build_export_index: an export index is replaced twice without a grace period");
+  else
+    export_index_retired = export_index;
+
+  __sync_synchronize();
+  export_index = pindex;
+}                               /* nfs_Build_export_index */
+
 /**
  *
  * nfs_Get_export_by_id: Gets an export entry from its export id. 
@@ -131,6 +331,11 @@ exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exp
   exportlist_t *piter;
   int found = 0;
 
+  nfs_export_index_t *pindex = export_index;
+
+  if(pindex != NULL && exportroot == pindex->root)
+    return (exportid < pindex->size) ? pindex->entries[exportid] : NULL;
+
   for(piter = exportroot; piter != NULL; piter = piter->next)
     {
       if(piter->id == exportid)
@@ -343,15 +548,38 @@ int nfs_build_fsal_context(struct svc_req *ptr_req,
                            struct user_cred *user_credentials)
 {
   fsal_status_t fsal_status;
+  fsal_grouplist_t *plist = NULL;
+  fsal_grouplist_t *pold_list = NULL;
+  gid_t *garray;
+  unsigned int glen;
 
   if (user_credentials == NULL)
     return FALSE;
 
+  garray = user_credentials->caller_garray;
+  glen = user_credentials->caller_glen;
+
+#ifndef _USE_HPSS
+  /* The groups of the credential are replaced by all the groups of the user
+   * known to the server, not for the anonymous user */
+  if(pexport->manage_gids && ptr_req->rq_cred.oa_flavor != AUTH_NONE &&
+     user_credentials->caller_uid != pexport->anonymous_uid &&
+     (plist = uid2grp_get(user_credentials->caller_uid)) != NULL)
+    {
+      garray = plist->groups;
+      glen = plist->nbgroups;
+    }
+
+  /* The context holds the list of its previous request until it is built
+   * again, FSAL_GetClientContext resets it */
+  pold_list = pcontext->credential.grouplist;
+#endif
+
   /* Build the credentials */
   fsal_status = FSAL_GetClientContext(pcontext,
                                       &pexport->FS_export_context,
                                       user_credentials->caller_uid, user_credentials->caller_gid,
-                                      user_credentials->caller_garray, user_credentials->caller_glen);
+                                      garray, glen);
 
   if(FSAL_IS_ERROR(fsal_status))
     {
@@ -359,12 +587,23 @@ int nfs_build_fsal_context(struct svc_req *ptr_req,
                "NFS DISPATCHER: FAILURE: Could not get credentials for (uid=%d,gid=%d), fsal error=(%d,%d)",
                user_credentials->caller_uid, user_credentials->caller_gid,
                fsal_status.major, fsal_status.minor);
+#ifndef _USE_HPSS
+      uid2grp_release(plist);
+      uid2grp_release(pold_list);
+      pcontext->credential.grouplist = NULL;
+#endif
       return FALSE;
     }
   else
     LogDebug(COMPONENT_DISPATCH,
-             "NFS DISPATCHER: FSAL Cred acquired for (uid=%d,gid=%d)",
-             user_credentials->caller_uid, user_credentials->caller_gid);
+             "NFS DISPATCHER: FSAL Cred acquired for (uid=%d,gid=%d,groups=%u)",
+             user_credentials->caller_uid, user_credentials->caller_gid, glen);
+
+#ifndef _USE_HPSS
+  /* The context holds its list until it is built for another request */
+  uid2grp_release(pold_list);
+  pcontext->credential.grouplist = plist;
+#endif
 
   return TRUE;
 }                               /* nfs_build_fsal_context */
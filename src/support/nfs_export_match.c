@@ -0,0 +1,830 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_export_match.c
+ * \brief   Compiled client lists of the exports.
+ *
+ * nfs_export_match.c : the client list of an export is compiled when the
+ * exports are read. The hosts are hashed by address, the networks are put
+ * in a radix trie on their prefix and the netgroups are expanded into a set
+ * of host names hashed by name. Only the wildcards, and the netgroups that
+ * could not be expanded, are still tested one by one.
+ *
+ * export_client_match returns the first client of the list that matches, the
+ * compiled form keeps the position of each client so that it returns the
+ * same one. The decisions are cached per client address, for the lifetime of
+ * the IP/name cache entries (the names of the clients may change). A decision
+ * taken while the name of the client could not be resolved is only kept for
+ * EXPORT_DECISION_UNRESOLVED_TTL seconds, a DNS failure does not last.
+ *
+ * The lists with expanded netgroups are compiled again by the admin thread
+ * when the IP/name cache entries expire (nfs_export_refresh_netgroups), the
+ * new list replaces the old one while the workers run. export_client_match
+ * loads clients->matcher once, inside the read section of the request
+ * (nfs_export_read_begin); the replaced list is destroyed after
+ * nfs_export_synchronize, once every section that may have loaded it ended.
+ * Reloading the exports compiles the new and changed lists, with empty caches.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include "cidr.h"
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Decisions cached per export, direct mapped on the client address */
+#define EXPORT_DECISION_CACHE_SIZE 1024
+#define EXPORT_DECISION_LOCKS 16
+
+/* Lifetime of a decision taken without the name of the client (s) */
+#define EXPORT_DECISION_UNRESOLVED_TTL 10
+
+#define EXPORT_MATCH_NONE -1
+
+/* A host address, a member of a netgroup or a network */
+typedef struct export_match_node__
+{
+  uint32_t key;                 /* address, or hash of the host name */
+  char *name;                   /* host name, NULL for the addresses */
+  unsigned int index;           /* position of the client in the list */
+  int next;                     /* next node of the bucket, -1 at the end */
+} export_match_node_t;
+
+typedef struct export_match_set__
+{
+  unsigned int nb_buckets;      /* a power of 2 */
+  int *buckets;
+} export_match_set_t;
+
+/* Node of the radix trie of the networks, one level per bit of the prefix */
+typedef struct export_match_trie__
+{
+  int child[2];
+  int items;                    /* networks whose prefix ends here */
+} export_match_trie_t;
+
+typedef struct export_decision__
+{
+  in_addr_t addr;
+  unsigned int option;
+  int index;                    /* client found, EXPORT_MATCH_NONE if none */
+  time_t expire;                /* 0 for a free slot */
+} export_decision_t;
+
+typedef struct export_matcher__
+{
+  export_match_node_t *nodes;
+  unsigned int nb_nodes;
+  unsigned int max_nodes;
+
+  export_match_set_t hosts;     /* HOSTIF_CLIENT, by address */
+  export_match_set_t members;   /* members of the netgroups, by name */
+  unsigned int first_netgroup;  /* position of the first expanded netgroup */
+  time_t netgroups_expire;      /* the netgroups are expanded again then, 0 never */
+
+  export_match_trie_t *trie;    /* NETWORK_CLIENT, root is trie[0] */
+  unsigned int nb_trie;
+  unsigned int max_trie;
+
+  unsigned int linear[EXPORTS_NB_MAX_CLIENTS];  /* tested one by one, in order */
+  unsigned int nb_linear;
+  unsigned int stops[EXPORTS_NB_MAX_CLIENTS];   /* GSSPRINCIPAL_CLIENT, end the search */
+  unsigned int nb_stops;
+
+  pthread_mutex_t decision_mutex[EXPORT_DECISION_LOCKS];
+  export_decision_t decisions[EXPORT_DECISION_CACHE_SIZE];
+} export_matcher_t;
+
+static uint32_t export_match_hash_name(char *name)
+{
+  uint32_t h = 2166136261U;
+
+  for(; *name != '\0'; name++)
+    h = (h ^ (unsigned char)tolower((unsigned char)*name)) * 16777619U;
+
+  return h;
+}                               /* export_match_hash_name */
+
+static uint32_t export_match_hash_addr(uint32_t addr)
+{
+  /* All the bits of the address end up in the low bits */
+  addr ^= addr >> 16;
+  addr *= 0x85ebca6bU;
+  addr ^= addr >> 13;
+  addr *= 0xc2b2ae35U;
+  addr ^= addr >> 16;
+
+  return addr;
+}                               /* export_match_hash_addr */
+
+/* The names are hashed already, the addresses are not */
+static uint32_t export_match_node_hash(export_match_node_t * pnode)
+{
+  return (pnode->name != NULL) ? pnode->key : export_match_hash_addr(pnode->key);
+}                               /* export_match_node_hash */
+
+static int export_match_option_ok(exportlist_client_entry_t * pclient,
+                                  unsigned int export_option)
+{
+  return ((pclient->options & export_option) != 0) &&
+      ((pclient->options & EXPORT_OPTION_ROOT) == (export_option & EXPORT_OPTION_ROOT));
+}                               /* export_match_option_ok */
+
+static int export_match_add_node(export_matcher_t * pmatcher, uint32_t key,
+                                 char *name, unsigned int index)
+{
+  export_match_node_t *pnodes;
+  unsigned int max;
+
+  if(pmatcher->nb_nodes == pmatcher->max_nodes)
+    {
+      max = (pmatcher->max_nodes == 0) ? 64 : 2 * pmatcher->max_nodes;
+      pnodes = (export_match_node_t *) Mem_Realloc(pmatcher->nodes,
+                                                   max * sizeof(export_match_node_t));
+      if(pnodes == NULL)
+        return EXPORT_MATCH_NONE;
+      pmatcher->nodes = pnodes;
+      pmatcher->max_nodes = max;
+    }
+
+  pmatcher->nodes[pmatcher->nb_nodes].key = key;
+  pmatcher->nodes[pmatcher->nb_nodes].name = name;
+  pmatcher->nodes[pmatcher->nb_nodes].index = index;
+  pmatcher->nodes[pmatcher->nb_nodes].next = EXPORT_MATCH_NONE;
+
+  return pmatcher->nb_nodes++;
+}                               /* export_match_add_node */
+
+/* Hashes the nodes [first, last[ into a set */
+static int export_match_set_build(export_matcher_t * pmatcher, export_match_set_t * pset,
+                                  unsigned int first, unsigned int last)
+{
+  unsigned int i, b;
+
+  pset->nb_buckets = 16;
+  while(pset->nb_buckets < 2 * (last - first))
+    pset->nb_buckets <<= 1;
+
+  pset->buckets = (int *)Mem_Alloc(pset->nb_buckets * sizeof(int));
+  if(pset->buckets == NULL)
+    return FALSE;
+
+  for(b = 0; b < pset->nb_buckets; b++)
+    pset->buckets[b] = EXPORT_MATCH_NONE;
+
+  /* Chained backward so that each bucket stays sorted by position */
+  for(i = last; i > first; i--)
+    {
+      b = export_match_node_hash(&pmatcher->nodes[i - 1]) & (pset->nb_buckets - 1);
+      pmatcher->nodes[i - 1].next = pset->buckets[b];
+      pset->buckets[b] = i - 1;
+    }
+
+  return TRUE;
+}                               /* export_match_set_build */
+
+static int export_match_trie_child(export_matcher_t * pmatcher, unsigned int node,
+                                   unsigned int bit)
+{
+  export_match_trie_t *ptrie;
+  unsigned int max;
+
+  if(pmatcher->trie[node].child[bit] != EXPORT_MATCH_NONE)
+    return pmatcher->trie[node].child[bit];
+
+  if(pmatcher->nb_trie == pmatcher->max_trie)
+    {
+      max = 2 * pmatcher->max_trie;
+      ptrie = (export_match_trie_t *) Mem_Realloc(pmatcher->trie,
+                                                  max * sizeof(export_match_trie_t));
+      if(ptrie == NULL)
+        return EXPORT_MATCH_NONE;
+      pmatcher->trie = ptrie;
+      pmatcher->max_trie = max;
+    }
+
+  pmatcher->trie[pmatcher->nb_trie].child[0] = EXPORT_MATCH_NONE;
+  pmatcher->trie[pmatcher->nb_trie].child[1] = EXPORT_MATCH_NONE;
+  pmatcher->trie[pmatcher->nb_trie].items = EXPORT_MATCH_NONE;
+  pmatcher->trie[node].child[bit] = pmatcher->nb_trie;
+
+  return pmatcher->nb_trie++;
+}                               /* export_match_trie_child */
+
+/* Length of the prefix of a netmask, -1 if the mask is not contiguous */
+static int export_match_pflen(unsigned int netmask)
+{
+  struct in_addr inaddr;
+  CIDR *pcidr;
+  int pflen;
+
+  inaddr.s_addr = htonl(netmask);
+  if((pcidr = cidr_from_inaddr(&inaddr)) == NULL)
+    return -1;
+
+  memcpy(&pcidr->mask[12], &inaddr.s_addr, 4);
+  pflen = cidr_get_pflen(pcidr);
+  cidr_free(pcidr);
+
+  return pflen;
+}                               /* export_match_pflen */
+
+static int export_match_add_network(export_matcher_t * pmatcher,
+                                    exportlist_client_net_t * pnet, unsigned int index)
+{
+  unsigned int node = 0;
+  int depth, pflen, item;
+
+  if((pflen = export_match_pflen(pnet->netmask)) < 0)
+    return FALSE;
+
+  for(depth = 0; depth < pflen; depth++)
+    if((node = export_match_trie_child(pmatcher, node,
+                                       (pnet->netaddr >> (31 - depth)) & 1)) ==
+       (unsigned int)EXPORT_MATCH_NONE)
+      return FALSE;
+
+  if((item = export_match_add_node(pmatcher, pnet->netaddr, NULL, index)) < 0)
+    return FALSE;
+
+  pmatcher->nodes[item].next = pmatcher->trie[node].items;
+  pmatcher->trie[node].items = item;
+
+  return TRUE;
+}                               /* export_match_add_network */
+
+/* Adds the hosts of a netgroup to the members, FALSE if it can't be expanded */
+static int export_match_add_netgroup(export_matcher_t * pmatcher, char *netgroupname,
+                                     unsigned int index)
+{
+  char buffer[1024];
+  char *host, *user, *domain;
+  char *name;
+  unsigned int first = pmatcher->nb_nodes;
+  unsigned int i;
+  int rc = TRUE;
+
+  if(setnetgrent(netgroupname) == 0)
+    return FALSE;
+
+  while(getnetgrent_r(&host, &user, &domain, buffer, sizeof(buffer)) == 1)
+    {
+      /* A triple with no host matches all the hosts */
+      if(host == NULL || host[0] == '\0')
+        {
+          rc = FALSE;
+          break;
+        }
+
+      if(!strcmp(host, "-"))
+        continue;
+
+      if((name = (char *)Mem_Alloc(strlen(host) + 1)) == NULL)
+        {
+          rc = FALSE;
+          break;
+        }
+
+      for(i = 0; host[i] != '\0'; i++)
+        name[i] = tolower((unsigned char)host[i]);
+      name[i] = '\0';
+
+      if(export_match_add_node(pmatcher, export_match_hash_name(name), name, index) < 0)
+        {
+          Mem_Free(name);
+          rc = FALSE;
+          break;
+        }
+    }
+
+  endnetgrent();
+
+  if(!rc)
+    {
+      /* Done one by one with innetgr */
+      while(pmatcher->nb_nodes > first)
+        Mem_Free(pmatcher->nodes[--pmatcher->nb_nodes].name);
+    }
+
+  return rc;
+}                               /* export_match_add_netgroup */
+
+/**
+ *
+ * export_matcher_free: frees the compiled form of a client list.
+ *
+ * @param clients [INOUT] the client list.
+ *
+ */
+static void export_matcher_destroy(export_matcher_t * pmatcher)
+{
+  unsigned int i;
+
+  for(i = 0; i < pmatcher->nb_nodes; i++)
+    if(pmatcher->nodes[i].name != NULL)
+      Mem_Free(pmatcher->nodes[i].name);
+
+  if(pmatcher->nodes != NULL)
+    Mem_Free(pmatcher->nodes);
+  if(pmatcher->hosts.buckets != NULL)
+    Mem_Free(pmatcher->hosts.buckets);
+  if(pmatcher->members.buckets != NULL)
+    Mem_Free(pmatcher->members.buckets);
+  if(pmatcher->trie != NULL)
+    Mem_Free(pmatcher->trie);
+
+  for(i = 0; i < EXPORT_DECISION_LOCKS; i++)
+    pthread_mutex_destroy(&pmatcher->decision_mutex[i]);
+
+  Mem_Free(pmatcher);
+}                               /* export_matcher_destroy */
+
+void export_matcher_free(exportlist_client_t * clients)
+{
+  export_matcher_t *pmatcher = clients->matcher;
+
+  if(pmatcher == NULL)
+    return;
+
+  clients->matcher = NULL;
+  export_matcher_destroy(pmatcher);
+}                               /* export_matcher_free */
+
+/* Compiles a client list, NULL if it can't be */
+static export_matcher_t *export_matcher_build(exportlist_client_t * clients)
+{
+  export_matcher_t *pmatcher;
+  exportlist_client_entry_t *pclient;
+  unsigned int i, first_member;
+  int rc = TRUE;
+
+  if((pmatcher = (export_matcher_t *) Mem_Alloc(sizeof(export_matcher_t))) == NULL)
+    return NULL;
+
+  memset(pmatcher, 0, sizeof(export_matcher_t));
+  for(i = 0; i < EXPORT_DECISION_LOCKS; i++)
+    pthread_mutex_init(&pmatcher->decision_mutex[i], NULL);
+  pmatcher->first_netgroup = EXPORTS_NB_MAX_CLIENTS;
+
+  pmatcher->max_trie = 64;
+  if((pmatcher->trie = (export_match_trie_t *)
+      Mem_Alloc(pmatcher->max_trie * sizeof(export_match_trie_t))) == NULL)
+    {
+      export_matcher_destroy(pmatcher);
+      return NULL;
+    }
+  pmatcher->trie[0].child[0] = EXPORT_MATCH_NONE;
+  pmatcher->trie[0].child[1] = EXPORT_MATCH_NONE;
+  pmatcher->trie[0].items = EXPORT_MATCH_NONE;
+  pmatcher->nb_trie = 1;
+
+  /* Hosts first, so that they are contiguous in the nodes */
+  for(i = 0; i < clients->num_clients && rc; i++)
+    if(clients->clientarray[i].type == HOSTIF_CLIENT)
+      rc = (export_match_add_node(pmatcher, clients->clientarray[i].client.hostif.clientaddr,
+                                  NULL, i) >= 0);
+
+  if(rc)
+    rc = export_match_set_build(pmatcher, &pmatcher->hosts, 0, pmatcher->nb_nodes);
+
+  /* Then the members of the netgroups */
+  first_member = pmatcher->nb_nodes;
+  for(i = 0; i < clients->num_clients && rc; i++)
+    {
+      pclient = &clients->clientarray[i];
+
+      switch (pclient->type)
+        {
+        case HOSTIF_CLIENT:
+        case HOSTIF_CLIENT_V6:
+        case BAD_CLIENT:
+        case NETWORK_CLIENT:
+          break;
+
+        case NETGROUP_CLIENT:
+          if(export_match_add_netgroup(pmatcher, pclient->client.netgroup.netgroupname, i))
+            {
+              if(pmatcher->first_netgroup == EXPORTS_NB_MAX_CLIENTS)
+                pmatcher->first_netgroup = i;
+            }
+          else
+            {
+              LogDebug(COMPONENT_CONFIG,
+                       "Netgroup %s could not be expanded, it will be checked with innetgr",
+                       pclient->client.netgroup.netgroupname);
+              pmatcher->linear[pmatcher->nb_linear++] = i;
+            }
+          break;
+
+        case GSSPRINCIPAL_CLIENT:
+          pmatcher->stops[pmatcher->nb_stops++] = i;
+          break;
+
+        default:
+          pmatcher->linear[pmatcher->nb_linear++] = i;
+          break;
+        }
+    }
+
+  if(rc)
+    rc = export_match_set_build(pmatcher, &pmatcher->members, first_member,
+                                pmatcher->nb_nodes);
+
+  /* Then the networks, the nodes of the trie are not hashed */
+  for(i = 0; i < clients->num_clients && rc; i++)
+    {
+      pclient = &clients->clientarray[i];
+
+      if(pclient->type != NETWORK_CLIENT)
+        continue;
+
+      if(!export_match_add_network(pmatcher, &pclient->client.network, i))
+        {
+          /* Not a CIDR mask (or no memory): the linear list is sorted */
+          unsigned int j = pmatcher->nb_linear++;
+
+          while(j > 0 && pmatcher->linear[j - 1] > i)
+            {
+              pmatcher->linear[j] = pmatcher->linear[j - 1];
+              j--;
+            }
+          pmatcher->linear[j] = i;
+        }
+    }
+
+  if(!rc)
+    {
+      export_matcher_destroy(pmatcher);
+      return NULL;
+    }
+
+  if(pmatcher->first_netgroup != EXPORTS_NB_MAX_CLIENTS &&
+     nfs_param.ip_name_param.expiration_time != 0)
+    pmatcher->netgroups_expire = time(NULL) + nfs_param.ip_name_param.expiration_time;
+
+  LogFullDebug(COMPONENT_CONFIG,
+               "Client list compiled: %u clients, %u nodes, %u trie nodes, %u tested one by one",
+               clients->num_clients, pmatcher->nb_nodes, pmatcher->nb_trie,
+               pmatcher->nb_linear);
+
+  return pmatcher;
+}                               /* export_matcher_build */
+
+/**
+ *
+ * export_matcher_compile: compiles a client list.
+ *
+ * On failure, the list is left as it is and is tested client by client.
+ *
+ * @param clients [INOUT] the client list.
+ *
+ * @return TRUE if the list was compiled, FALSE otherwise.
+ *
+ */
+int export_matcher_compile(exportlist_client_t * clients)
+{
+  export_matcher_free(clients);
+
+  clients->matcher = export_matcher_build(clients);
+
+  return (clients->matcher != NULL);
+}                               /* export_matcher_compile */
+
+/**
+ *
+ * nfs_export_compile: compiles the client lists of an export list.
+ *
+ * @param pexportlist [INOUT] the export list.
+ *
+ * @return the number of client lists that could not be compiled.
+ *
+ */
+int nfs_export_compile(exportlist_t * pexportlist)
+{
+  exportlist_t *pexport;
+  int nb_failed = 0;
+
+  for(pexport = pexportlist; pexport != NULL; pexport = pexport->next)
+    if(!export_matcher_compile(&pexport->clients))
+      {
+        LogCrit(COMPONENT_CONFIG,
+                "Could not compile the client list of export %u, its clients will be checked one by one",
+                pexport->id);
+        nb_failed++;
+      }
+
+  return nb_failed;
+}                               /* nfs_export_compile */
+
+/**
+ *
+ * nfs_export_refresh_netgroups: expands again the netgroups of the active exports.
+ *
+ * The client lists whose netgroups expired are compiled again and replace the
+ * old ones, which are freed after a grace period. Called by the admin thread,
+ * that also reloads the exports.
+ *
+ * @param pexportlist [IN] the active export list.
+ *
+ * @return the delay until the next expiration (s), 0 if none.
+ *
+ */
+time_t nfs_export_refresh_netgroups(exportlist_t * pexportlist)
+{
+  exportlist_t *pexport;
+  export_matcher_t *pmatcher;
+  export_matcher_t *pold;
+  export_matcher_t **pretired = NULL;
+  unsigned int nb_retired = 0;
+  unsigned int nb_export = 0;
+  unsigned int i;
+  time_t now = time(NULL);
+  time_t next = 0;
+
+  for(pexport = pexportlist; pexport != NULL; pexport = pexport->next)
+    nb_export++;
+
+  for(pexport = pexportlist; pexport != NULL; pexport = pexport->next)
+    {
+      pold = pexport->clients.matcher;
+      if(pold == NULL || pold->netgroups_expire == 0)
+        continue;
+
+      if(pold->netgroups_expire > now)
+        {
+          if(next == 0 || pold->netgroups_expire - now < next)
+            next = pold->netgroups_expire - now;
+          continue;
+        }
+
+      if(pretired == NULL &&
+         (pretired = (export_matcher_t **) Mem_Alloc(nb_export *
+                                                     sizeof(export_matcher_t *))) == NULL)
+        {
+          LogCrit(COMPONENT_CONFIG,
+                  "nfs_export_refresh_netgroups: could not allocate the retired lists");
+          return EXPORT_DECISION_UNRESOLVED_TTL;
+        }
+
+      if((pmatcher = export_matcher_build(&pexport->clients)) == NULL)
+        {
+          /* Keep the old expansion, try again later */
+          LogCrit(COMPONENT_CONFIG,
+                  "Could not expand again the netgroups of export %u", pexport->id);
+          pold->netgroups_expire = now + EXPORT_DECISION_UNRESOLVED_TTL;
+          if(next == 0 || EXPORT_DECISION_UNRESOLVED_TTL < next)
+            next = EXPORT_DECISION_UNRESOLVED_TTL;
+          continue;
+        }
+
+      LogDebug(COMPONENT_CONFIG,
+               "Netgroups of export %u expanded again", pexport->id);
+
+      /* The requests in progress may still use the old list */
+      __sync_synchronize();
+      pexport->clients.matcher = pmatcher;
+      pretired[nb_retired++] = pold;
+
+      if(pmatcher->netgroups_expire != 0 &&
+         (next == 0 || pmatcher->netgroups_expire - now < next))
+        next = pmatcher->netgroups_expire - now;
+    }
+
+  if(nb_retired != 0)
+    {
+      nfs_export_synchronize();
+
+      for(i = 0; i < nb_retired; i++)
+        export_matcher_destroy(pretired[i]);
+    }
+
+  if(pretired != NULL)
+    Mem_Free(pretired);
+
+  return next;
+}                               /* nfs_export_refresh_netgroups */
+
+/* The first client of the list that matches, EXPORT_MATCH_NONE if none.
+ * *presolved is FALSE if the name of the client was needed but could not be
+ * resolved. */
+static int export_matcher_lookup(export_matcher_t * pmatcher,
+                                 sockaddr_t *hostaddr,
+                                 char *ipstring,
+                                 exportlist_client_t *clients,
+                                 unsigned int export_option,
+                                 int *presolved)
+{
+  export_match_node_t *pnode;
+  exportlist_client_entry_t *pclient;
+  char hostname[MAXHOSTNAMELEN];
+  in_addr_t addr = get_in_addr(hostaddr);
+  uint32_t haddr = ntohl(addr);
+  uint32_t h;
+  unsigned int best = clients->num_clients;
+  unsigned int i, depth;
+  int by_name = FALSE;
+  int n, t;
+
+  *presolved = TRUE;
+
+  /* An unsupported GSS principal ends the search, as in export_client_match */
+  for(i = 0; i < pmatcher->nb_stops; i++)
+    if(export_match_option_ok(&clients->clientarray[pmatcher->stops[i]], export_option))
+      {
+        best = pmatcher->stops[i];
+        break;
+      }
+
+  /* Hosts */
+  h = export_match_hash_addr(addr);
+  for(n = pmatcher->hosts.buckets[h & (pmatcher->hosts.nb_buckets - 1)];
+      n != EXPORT_MATCH_NONE; n = pnode->next)
+    {
+      pnode = &pmatcher->nodes[n];
+      if(pnode->index >= best)
+        break;
+      if(pnode->key == addr &&
+         export_match_option_ok(&clients->clientarray[pnode->index], export_option))
+        {
+          best = pnode->index;
+          break;
+        }
+    }
+
+  /* Networks, from the shortest prefix to the longest. The address is still
+   * compared as export_client_match does, it may have bits out of the mask */
+  for(t = 0, depth = 0; t != EXPORT_MATCH_NONE; depth++)
+    {
+      for(n = pmatcher->trie[t].items; n != EXPORT_MATCH_NONE; n = pnode->next)
+        {
+          pnode = &pmatcher->nodes[n];
+          pclient = &clients->clientarray[pnode->index];
+          if(pnode->index < best && export_match_option_ok(pclient, export_option) &&
+             (pclient->client.network.netmask & haddr) == pclient->client.network.netaddr)
+            best = pnode->index;
+        }
+
+      if(depth == 32)
+        break;
+      t = pmatcher->trie[t].child[(haddr >> (31 - depth)) & 1];
+    }
+
+  /* Netgroups, the name of the client is only needed if one could win */
+  if(pmatcher->first_netgroup < best)
+    {
+      if(nfs_ip_name_get(hostaddr, hostname) != IP_NAME_SUCCESS &&
+         nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
+        {
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "Could not resolve the name of %s, not checking the netgroups",
+                       ipstring);
+          *presolved = FALSE;
+        }
+      else
+        {
+          h = export_match_hash_name(hostname);
+          for(n = pmatcher->members.buckets[h & (pmatcher->members.nb_buckets - 1)];
+              n != EXPORT_MATCH_NONE; n = pnode->next)
+            {
+              pnode = &pmatcher->nodes[n];
+              if(pnode->index >= best)
+                break;
+              if(pnode->key == h && !strcasecmp(pnode->name, hostname) &&
+                 export_match_option_ok(&clients->clientarray[pnode->index], export_option))
+                {
+                  best = pnode->index;
+                  break;
+                }
+            }
+        }
+    }
+
+  /* Wildcards and the rest, in order */
+  for(i = 0; i < pmatcher->nb_linear && pmatcher->linear[i] < best; i++)
+    {
+      pclient = &clients->clientarray[pmatcher->linear[i]];
+      if(!export_match_option_ok(pclient, export_option))
+        continue;
+
+      if(export_client_entry_match(hostaddr, ipstring, pclient, pmatcher->linear[i]))
+        {
+          best = pmatcher->linear[i];
+          break;
+        }
+
+      if(pclient->type == NETGROUP_CLIENT || pclient->type == WILDCARDHOST_CLIENT)
+        by_name = TRUE;
+    }
+
+  /* export_client_entry_match resolved the name, or failed to */
+  if(by_name && *presolved && nfs_ip_name_get(hostaddr, hostname) != IP_NAME_SUCCESS)
+    *presolved = FALSE;
+
+  if(best == clients->num_clients ||
+     clients->clientarray[best].type == GSSPRINCIPAL_CLIENT)
+    return EXPORT_MATCH_NONE;
+
+  return best;
+}                               /* export_matcher_lookup */
+
+/**
+ *
+ * export_matcher_match: export_client_match for a compiled client list.
+ *
+ * @param pmatcher      [IN]  the compiled list.
+ * @param hostaddr      [IN]  the address of the client.
+ * @param ipstring      [IN]  the address as a string.
+ * @param clients       [IN]  the client list.
+ * @param pclient_found [OUT] the client entry found.
+ * @param export_option [IN]  the options looked for.
+ *
+ * @return TRUE if a client entry was found, FALSE otherwise.
+ *
+ */
+int export_matcher_match(export_matcher_t * pmatcher,
+                         sockaddr_t *hostaddr,
+                         char *ipstring,
+                         exportlist_client_t *clients,
+                         exportlist_client_entry_t * pclient_found,
+                         unsigned int export_option)
+{
+  export_decision_t *pdecision;
+  in_addr_t addr = get_in_addr(hostaddr);
+  unsigned int slot;
+  pthread_mutex_t *pmutex;
+  time_t now = time(NULL);
+  int resolved;
+  int index;
+
+  slot = (export_match_hash_addr(addr) ^ export_option) & (EXPORT_DECISION_CACHE_SIZE - 1);
+  pdecision = &pmatcher->decisions[slot];
+  pmutex = &pmatcher->decision_mutex[slot % EXPORT_DECISION_LOCKS];
+
+  P(*pmutex);
+  if(pdecision->expire > now && pdecision->addr == addr &&
+     pdecision->option == export_option)
+    {
+      index = pdecision->index;
+      V(*pmutex);
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Cached decision for %s: client %d", ipstring, index);
+    }
+  else
+    {
+      V(*pmutex);
+
+      index = export_matcher_lookup(pmatcher, hostaddr, ipstring, clients, export_option,
+                                    &resolved);
+
+      P(*pmutex);
+      pdecision->addr = addr;
+      pdecision->option = export_option;
+      pdecision->index = index;
+      pdecision->expire = now + (resolved ? nfs_param.ip_name_param.expiration_time :
+                                 EXPORT_DECISION_UNRESOLVED_TTL);
+      V(*pmutex);
+    }
+
+  if(index == EXPORT_MATCH_NONE)
+    return FALSE;
+
+  *pclient_found = clients->clientarray[index];
+  return TRUE;
+}                               /* export_matcher_match */
@@ -269,6 +269,18 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->nb_worker = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Nb_Max_Worker"))
+        {
+          pparam->nb_max_worker = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Worker_Spawn_Wait"))
+        {
+          pparam->worker_spawn_wait = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Worker_Idle_Timeout"))
+        {
+          pparam->worker_idle_timeout = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Nb_Call_Before_Queue_Avg"))
         {
           pparam->nb_call_before_queue_avg = atoi(key_value);
@@ -462,11 +474,27 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->max_recv_buffer_size = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Use_QoS_Scheduler"))
+        {
+          pparam->use_qos_scheduler = StrToBoolean(key_value);
+        }
+      else if(!strcasecmp(key_name, "QoS_Queue_Depth"))
+        {
+          pparam->qos_queue_depth = atoi(key_value);
+        }
 #ifdef _USE_NLM
       else if(!strcasecmp( key_name, "NSM_Use_Caller_Name" ) )
         {
           pparam->nsm_use_caller_name = StrToBoolean(key_value);
         }
+      else if(!strcasecmp(key_name, "NLM_Async_Threads"))
+        {
+          pparam->nb_nlm_async_thread = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "NLM_Grant_Window"))
+        {
+          pparam->nlm_grant_window = atoi(key_value);
+        }
 #endif
       else
         {
@@ -942,6 +970,22 @@ int nfs_read_uidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
         {
           strncpy(pparam->mapfile, key_value, MAXPATHLEN);
         }
+      else if(!strcasecmp(key_name, "Preload"))
+        {
+          strncpy(pparam->preload, key_value, MAXPATHLEN);
+        }
+      else if(!strcasecmp(key_name, "Expiration"))
+        {
+          pparam->expiration = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Negative_Expiration"))
+        {
+          pparam->negative_expiration = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Resolver_Threads"))
+        {
+          pparam->nb_resolvers = atoi(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -1029,6 +1073,22 @@ int nfs_read_gidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
         {
           strncpy(pparam->mapfile, key_value, MAXPATHLEN);
         }
+      else if(!strcasecmp(key_name, "Preload"))
+        {
+          strncpy(pparam->preload, key_value, MAXPATHLEN);
+        }
+      else if(!strcasecmp(key_name, "Expiration"))
+        {
+          pparam->expiration = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Negative_Expiration"))
+        {
+          pparam->negative_expiration = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Resolver_Threads"))
+        {
+          pparam->nb_resolvers = atoi(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -1265,6 +1325,9 @@ void Print_param_in_log()
   LogInfo(COMPONENT_INIT,
           "NFS PARAM : core_param.nb_worker = %d",
           nfs_param.core_param.nb_worker);
+  LogInfo(COMPONENT_INIT,
+          "NFS PARAM : core_param.nb_max_worker = %d",
+          nfs_param.core_param.nb_max_worker);
   Print_param_worker_in_log(&nfs_param.worker_param);
 }                               /* Print_param_in_log */
 
@@ -0,0 +1,230 @@
+/*
+ * Table driven test of the compiled client lists (nfs_export_match.c).
+ *
+ * The test is linked with nfs_export_match.c only: exports.c needs the
+ * FSAL. The clients the matcher leaves to be tested one by one are tested
+ * here as export_client_entry_match does for the hosts and the networks,
+ * the client names are never resolved.
+ */
+#include "rpc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "nfs_ip_stats.h"
+#include "stuff_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+nfs_parameter_t nfs_param;
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+#define RW (EXPORT_OPTION_READ_ACCESS | EXPORT_OPTION_WRITE_ACCESS)
+#define RO EXPORT_OPTION_READ_ACCESS
+
+/* The client list, in the order of the configuration */
+typedef struct client_def__
+{
+  exportlist_client_type_t type;
+  char *addr;
+  char *mask;                   /* networks only */
+  unsigned int options;
+} client_def_t;
+
+static client_def_t clients_def[] = {
+  {HOSTIF_CLIENT, "10.0.0.5", NULL, RW},                               /* 0 */
+  {NETWORK_CLIENT, "10.0.0.0", "255.255.255.0", RO},                   /* 1 */
+  {NETWORK_CLIENT, "10.0.0.0", "255.255.0.0", RW},                     /* 2 */
+  {HOSTIF_CLIENT, "10.1.2.3", NULL, RO | EXPORT_OPTION_ROOT},          /* 3 */
+  {NETWORK_CLIENT, "192.168.0.9", "255.255.0.255", RO},                /* 4: not a CIDR mask */
+  {GSSPRINCIPAL_CLIENT, NULL, NULL, EXPORT_OPTION_MD_READ_ACCESS},     /* 5: ends the search */
+  {NETWORK_CLIENT, "172.16.0.0", "255.240.0.0", RO},                   /* 6 */
+  {NETWORK_CLIENT, "0.0.0.0", "0.0.0.0", RO},                          /* 7 */
+};
+
+typedef struct match_case__
+{
+  char *addr;
+  unsigned int option;
+  int expected;                 /* position of the client found, -1 if none */
+} match_case_t;
+
+static match_case_t cases[] = {
+  /* a host before the networks that hold it */
+  {"10.0.0.5", RO, 0},
+  {"10.0.0.5", EXPORT_OPTION_WRITE_ACCESS, 0},
+  /* the first network in the list, not the longest prefix */
+  {"10.0.0.7", RO, 1},
+  {"10.0.0.7", EXPORT_OPTION_WRITE_ACCESS, 2},
+  {"10.0.200.1", RO, 2},
+  /* root entries only match root lookups, and the other way round */
+  {"10.1.2.3", RO, 7},
+  {"10.1.2.3", RO | EXPORT_OPTION_ROOT, 3},
+  {"10.0.0.5", RO | EXPORT_OPTION_ROOT, -1},
+  /* tested one by one */
+  {"192.168.7.9", RO, 4},
+  {"192.168.7.8", RO, 7},
+  /* a GSS principal ends the search with its options */
+  {"172.20.0.1", EXPORT_OPTION_MD_READ_ACCESS, -1},
+  {"172.20.0.1", RO, 6},
+  {"172.32.0.1", RO, 7},
+  {"172.32.0.1", EXPORT_OPTION_WRITE_ACCESS, -1},
+};
+
+#define NB_CLIENTS (sizeof(clients_def) / sizeof(clients_def[0]))
+#define NB_CASES (sizeof(cases) / sizeof(cases[0]))
+
+static exportlist_client_t clients;
+
+int export_client_entry_match(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_entry_t * pclient,
+                              unsigned int i)
+{
+  in_addr_t addr = get_in_addr(hostaddr);
+
+  switch (pclient->type)
+    {
+    case HOSTIF_CLIENT:
+      return pclient->client.hostif.clientaddr == addr;
+
+    case NETWORK_CLIENT:
+      return (pclient->client.network.netmask & ntohl(addr)) ==
+          pclient->client.network.netaddr;
+
+    default:
+      return FALSE;
+    }
+}
+
+int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname)
+{
+  return IP_NAME_NOT_FOUND;
+}
+
+int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname)
+{
+  return IP_NAME_NOT_FOUND;
+}
+
+void nfs_export_synchronize(void)
+{
+}
+
+in_addr_t get_in_addr(sockaddr_t *addr)
+{
+  return ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+}
+
+void create_ipv4(char * ip, int port, struct sockaddr_in * addr)
+{
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_port = port;
+    inet_pton(AF_INET, ip, &(addr->sin_addr));
+}
+
+void init()
+{
+    struct in_addr inaddr;
+    unsigned int i;
+
+    BuddyInit(NULL);
+
+    /* the decisions are kept for the lifetime of the IP/name cache entries */
+    nfs_param.ip_name_param.expiration_time = 3600;
+
+    memset(&clients, 0, sizeof(clients));
+    for(i = 0; i < NB_CLIENTS; i++)
+      {
+        clients.clientarray[i].type = clients_def[i].type;
+        clients.clientarray[i].options = clients_def[i].options;
+
+        switch (clients_def[i].type)
+          {
+          case HOSTIF_CLIENT:
+            inet_pton(AF_INET, clients_def[i].addr, &inaddr);
+            clients.clientarray[i].client.hostif.clientaddr = inaddr.s_addr;
+            break;
+
+          case NETWORK_CLIENT:
+            inet_pton(AF_INET, clients_def[i].addr, &inaddr);
+            clients.clientarray[i].client.network.netaddr = ntohl(inaddr.s_addr);
+            inet_pton(AF_INET, clients_def[i].mask, &inaddr);
+            clients.clientarray[i].client.network.netmask = ntohl(inaddr.s_addr);
+            break;
+
+          case GSSPRINCIPAL_CLIENT:
+            strcpy(clients.clientarray[i].client.gssprinc.princname, "nfs@server");
+            break;
+
+          default:
+            break;
+          }
+      }
+    clients.num_clients = NB_CLIENTS;
+
+    EQUALS(export_matcher_compile(&clients), TRUE, "Can't compile the client list");
+}
+
+/* Each case twice: the second answer comes from the decision cache */
+void test_cases()
+{
+    exportlist_client_entry_t found;
+    sockaddr_t hostaddr;
+    unsigned int i, pass;
+    int rc;
+
+    for(pass = 0; pass < 2; pass++)
+      for(i = 0; i < NB_CASES; i++)
+        {
+          create_ipv4(cases[i].addr, 2049, (struct sockaddr_in *) &hostaddr);
+
+          rc = export_matcher_match(clients.matcher, &hostaddr, cases[i].addr, &clients,
+                                    &found, cases[i].option);
+          EQUALS(rc, (cases[i].expected >= 0), "Case %u (%s, %#x): match returned %d, pass %u",
+                 i, cases[i].addr, cases[i].option, rc, pass);
+
+          if(rc)
+            EQUALS(memcmp(&found, &clients.clientarray[cases[i].expected], sizeof(found)), 0,
+                   "Case %u (%s, %#x): client %d was not the one found, pass %u",
+                   i, cases[i].addr, cases[i].option, cases[i].expected, pass);
+        }
+}
+
+/* A list compiled again starts with an empty decision cache */
+void test_recompile()
+{
+    exportlist_client_entry_t found;
+    sockaddr_t hostaddr;
+
+    create_ipv4("10.0.0.7", 2049, (struct sockaddr_in *) &hostaddr);
+
+    clients.clientarray[1].options = RW;
+    EQUALS(export_matcher_compile(&clients), TRUE, "Can't compile the client list again");
+
+    EQUALS(export_matcher_match(clients.matcher, &hostaddr, "10.0.0.7", &clients, &found,
+                                EXPORT_OPTION_WRITE_ACCESS), TRUE,
+           "10.0.0.7 should match after the list is compiled again");
+    EQUALS(memcmp(&found, &clients.clientarray[1], sizeof(found)), 0,
+           "10.0.0.7 should match client 1 after the list is compiled again");
+
+    export_matcher_free(&clients);
+    EQUALS(clients.matcher, NULL, "The compiled list should be freed");
+}
+
+int main()
+{
+    init();
+
+    test_cases();
+    test_recompile();
+
+    printf("ALL EXPORT MATCH TESTS COMPLETED SUCCESSFULLY!!\n");
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Test of the timer wheel (timer_wheel.c), driven by a fake clock.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_macros.h"
+#include "timer_wheel.h"
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if ((a) != (b)) {                         \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+#define MSEC(ticks) ((ticks) * TIMER_WHEEL_TICK_MSEC)
+
+static uint64_t fake_now = 0;
+
+typedef struct test_timer__
+{
+  timer_wheel_entry_t entry;
+  unsigned int nb_fired;
+  uint64_t fired_at;
+} test_timer_t;
+
+static uint64_t fake_clock(void)
+{
+  return fake_now;
+}
+
+static void test_fire(timer_wheel_entry_t * pentry, void *arg)
+{
+  test_timer_t *ptimer = (test_timer_t *) arg;
+
+  ptimer->nb_fired++;
+  ptimer->fired_at = fake_now;
+}
+
+/* Moves the clock one tick at a time, as the wheel thread would */
+static void advance_to(uint64_t tick)
+{
+  while(fake_now < tick)
+    {
+      fake_now++;
+      timer_wheel_tick();
+    }
+}
+
+static void arm(test_timer_t * ptimer, unsigned int ticks)
+{
+  timer_wheel_entry_init(&ptimer->entry, test_fire, ptimer, NULL);
+  ptimer->nb_fired = 0;
+  ptimer->fired_at = 0;
+  timer_wheel_add(&ptimer->entry, MSEC(ticks));
+}
+
+/* An entry fires once, on its tick and not before */
+void test_insert()
+{
+  test_timer_t t;
+
+  arm(&t, 3);
+  EQUALS(t.entry.twe_state, TIMER_WHEEL_ARMED, "The entry should be armed");
+
+  advance_to(fake_now + 2);
+  EQUALS(t.nb_fired, 0, "The entry fired early");
+
+  advance_to(fake_now + 1);
+  EQUALS(t.nb_fired, 1, "The entry should have fired once, fired %u times", t.nb_fired);
+  EQUALS(t.entry.twe_state, TIMER_WHEEL_IDLE, "The entry should be idle after firing");
+
+  advance_to(fake_now + 10);
+  EQUALS(t.nb_fired, 1, "The entry fired again");
+}
+
+/* Entries across the root wrap and from the upper levels fire on their tick */
+void test_wrap()
+{
+  static const unsigned int delays[] = {
+    1, 10, TIMER_WHEEL_ROOT_SIZE - 1, TIMER_WHEEL_ROOT_SIZE, TIMER_WHEEL_ROOT_SIZE + 7,
+    3 * TIMER_WHEEL_ROOT_SIZE + 100, TIMER_WHEEL_ROOT_SIZE * TIMER_WHEEL_LEVEL_SIZE + 33
+  };
+#define NB_DELAYS (sizeof(delays) / sizeof(delays[0]))
+  test_timer_t t[NB_DELAYS];
+  uint64_t start;
+  unsigned int i;
+
+  /* just before the root level wraps */
+  advance_to((fake_now | (TIMER_WHEEL_ROOT_SIZE - 1)) - 4);
+  start = fake_now;
+
+  for(i = 0; i < NB_DELAYS; i++)
+    arm(&t[i], delays[i]);
+
+  advance_to(start + delays[NB_DELAYS - 1] + 1);
+
+  for(i = 0; i < NB_DELAYS; i++)
+    {
+      EQUALS(t[i].nb_fired, 1, "Entry %u (%u ticks) fired %u times", i, delays[i],
+             t[i].nb_fired);
+      EQUALS(t[i].fired_at, start + delays[i], "Entry %u (%u ticks) fired at tick %llu",
+             i, delays[i], (unsigned long long)(t[i].fired_at - start));
+    }
+}
+
+/* A canceled entry never fires, wherever it was */
+void test_cancel()
+{
+  test_timer_t armed, far, rearmed;
+  timer_wheel_queue_t queue;
+  timer_wheel_entry_t queued;
+  timer_wheel_stat_t stats;
+  uint64_t start = fake_now;
+
+  arm(&armed, 5);
+  arm(&far, 2 * TIMER_WHEEL_ROOT_SIZE);
+  arm(&rearmed, 5);
+
+  EQUALS(timer_wheel_cancel(&armed.entry), 1, "Canceling an armed entry should return 1");
+  EQUALS(timer_wheel_cancel(&armed.entry), 0, "Canceling an idle entry should return 0");
+  EQUALS(timer_wheel_cancel(&far.entry), 1, "Canceling an upper level entry should return 1");
+
+  /* re-arming moves the entry */
+  timer_wheel_add(&rearmed.entry, MSEC(20));
+
+  timer_wheel_queue_init(&queue);
+  timer_wheel_entry_init(&queued, NULL, NULL, &queue);
+  timer_wheel_add(&queued, MSEC(2));
+
+  advance_to(start + 2);
+  EQUALS(queued.twe_state, TIMER_WHEEL_QUEUED, "The entry should be in its queue");
+  EQUALS(queue.twq_count, 1, "The queue should hold one entry");
+  EQUALS(timer_wheel_cancel(&queued), 1, "Canceling a queued entry should return 1");
+  EQUALS(queue.twq_count, 0, "The queue should be empty after the cancel");
+  EQUALS(timer_wheel_queue_get(&queue), NULL, "Nothing should be left in the queue");
+
+  /* delivered again after being re-armed */
+  timer_wheel_add(&queued, MSEC(1));
+  advance_to(start + 3);
+  EQUALS(timer_wheel_queue_get(&queue), &queued, "The entry should be delivered");
+  EQUALS(queued.twe_state, TIMER_WHEEL_IDLE, "A delivered entry should be idle");
+
+  advance_to(start + 3 * TIMER_WHEEL_ROOT_SIZE);
+  EQUALS(armed.nb_fired, 0, "A canceled entry fired");
+  EQUALS(far.nb_fired, 0, "A canceled upper level entry fired");
+  EQUALS(rearmed.nb_fired, 1, "The re-armed entry fired %u times", rearmed.nb_fired);
+  EQUALS(rearmed.fired_at, start + 20, "The re-armed entry fired at tick %llu",
+         (unsigned long long)(rearmed.fired_at - start));
+
+  timer_wheel_get_stats(&stats);
+  EQUALS(stats.nb_armed, 0, "%llu entries are still counted as armed", stats.nb_armed);
+}
+
+int main()
+{
+  timer_wheel_set_clock(fake_clock);
+  timer_wheel_init();
+
+  test_insert();
+  test_wrap();
+  test_cancel();
+
+  printf("ALL TIMER WHEEL TESTS COMPLETED SUCCESSFULLY!!\n");
+  return 0;
+}
@@ -0,0 +1,483 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    timer_wheel.c
+ * \brief   Hierarchical timer wheel used for every expiry in the server.
+ *
+ * timer_wheel.c : Hierarchical timer wheel used for every expiry in the server.
+ *
+ * The root level has one slot per tick for the next 256 ticks. Each upper
+ * level has 64 slots, each covering a whole turn of the level below. When
+ * the root level wraps, the current slot of the next level is cascaded,
+ * which spreads its entries on the lower levels. Entries further away than
+ * the wheel can hold are clamped to the last slot and simply cascade again.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_ROOT_MASK  (TIMER_WHEEL_ROOT_SIZE - 1)
+#define TIMER_WHEEL_LEVEL_MASK (TIMER_WHEEL_LEVEL_SIZE - 1)
+
+/* Largest delay, in ticks, the wheel can hold without clamping */
+#define TIMER_WHEEL_MAX_TICKS \
+  ((1ULL << (TIMER_WHEEL_ROOT_BITS + (TIMER_WHEEL_NB_LEVELS - 1) * TIMER_WHEEL_LEVEL_BITS)) - 1)
+
+/* Slot index of a tick in a given upper level (1..TIMER_WHEEL_NB_LEVELS-1) */
+#define TIMER_WHEEL_INDEX(tick, level) \
+  (((tick) >> (TIMER_WHEEL_ROOT_BITS + ((level) - 1) * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_LEVEL_MASK)
+
+static pthread_mutex_t tw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tw_cond = PTHREAD_COND_INITIALIZER;
+
+static struct glist_head tw_root[TIMER_WHEEL_ROOT_SIZE];
+static struct glist_head tw_levels[TIMER_WHEEL_NB_LEVELS - 1][TIMER_WHEEL_LEVEL_SIZE];
+
+static uint64_t tw_current;                    /* next tick to be processed */
+static struct timeval tw_origin;               /* time of tick 0 */
+static timer_wheel_stat_t tw_stats;
+
+static uint64_t timer_wheel_real_clock(void);
+static timer_wheel_clock_t timer_wheel_now = timer_wheel_real_clock;
+
+static uint64_t timer_wheel_real_clock(void)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  /* The clock went backward, stay on the current tick */
+  if(timercmp(&now, &tw_origin, <))
+    return 0;
+
+  return ((uint64_t) (now.tv_sec - tw_origin.tv_sec) * 1000 +
+          (now.tv_usec - tw_origin.tv_usec) / 1000) / TIMER_WHEEL_TICK_MSEC;
+}
+
+/* Put an armed entry in the slot matching its expiry, tw_mutex held */
+static void timer_wheel_insert_locked(timer_wheel_entry_t * pentry)
+{
+  uint64_t expire = pentry->twe_expire;
+  uint64_t delta;
+  struct glist_head *slot;
+  int level;
+
+  if(expire < tw_current)
+    {
+      /* Already late, fire on next tick */
+      expire = tw_current;
+    }
+
+  delta = expire - tw_current;
+
+  if(delta > TIMER_WHEEL_MAX_TICKS)
+    {
+      delta = TIMER_WHEEL_MAX_TICKS;
+      expire = tw_current + delta;
+    }
+
+  if(delta < TIMER_WHEEL_ROOT_SIZE)
+    slot = &tw_root[expire & TIMER_WHEEL_ROOT_MASK];
+  else
+    {
+      for(level = 1; level < TIMER_WHEEL_NB_LEVELS - 1; level++)
+        if(delta < (1ULL << (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS)))
+          break;
+
+      slot = &tw_levels[level - 1][TIMER_WHEEL_INDEX(expire, level)];
+    }
+
+  glist_add_tail(slot, &pentry->twe_list);
+}
+
+/* Respread the current slot of an upper level, returns the slot index */
+static unsigned int timer_wheel_cascade_locked(int level)
+{
+  unsigned int index = TIMER_WHEEL_INDEX(tw_current, level);
+  struct glist_head *slot = &tw_levels[level - 1][index];
+  struct glist_head tmp;
+  struct glist_head *glist, *glistn;
+  timer_wheel_entry_t *pentry;
+
+  init_glist(&tmp);
+  glist_add_list_tail(&tmp, slot);
+  init_glist(slot);
+
+  glist_for_each_safe(glist, glistn, &tmp)
+    {
+      pentry = glist_entry(glist, timer_wheel_entry_t, twe_list);
+      glist_del(glist);
+      timer_wheel_insert_locked(pentry);
+      tw_stats.nb_cascaded++;
+    }
+
+  return index;
+}
+
+/**
+ *
+ * timer_wheel_init: initializes the timer wheel.
+ *
+ * @return 0 if successful.
+ *
+ */
+int timer_wheel_init(void)
+{
+  int i, j;
+
+  for(i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++)
+    init_glist(&tw_root[i]);
+
+  for(i = 0; i < TIMER_WHEEL_NB_LEVELS - 1; i++)
+    for(j = 0; j < TIMER_WHEEL_LEVEL_SIZE; j++)
+      init_glist(&tw_levels[i][j]);
+
+  gettimeofday(&tw_origin, NULL);
+  tw_current = 0;
+  memset(&tw_stats, 0, sizeof(tw_stats));
+
+  return 0;
+}                               /* timer_wheel_init */
+
+/**
+ *
+ * timer_wheel_entry_init: prepares an entry to be armed.
+ *
+ * @param pentry [OUT] the entry.
+ * @param func   [IN]  call back run by the wheel thread when the entry expires.
+ * @param arg    [IN]  argument for func.
+ * @param pqueue [IN]  if not NULL, expired entry is queued there instead.
+ *
+ */
+void timer_wheel_entry_init(timer_wheel_entry_t * pentry,
+                            timer_wheel_func_t func,
+                            void *arg,
+                            timer_wheel_queue_t * pqueue)
+{
+  init_glist(&pentry->twe_list);
+  pentry->twe_expire = 0;
+  pentry->twe_state = TIMER_WHEEL_IDLE;
+  pentry->twe_func = func;
+  pentry->twe_arg = arg;
+  pentry->twe_queue = pqueue;
+}                               /* timer_wheel_entry_init */
+
+/**
+ *
+ * timer_wheel_add: arms (or re-arms) an entry.
+ *
+ * If the entry is already armed or sits expired in its queue, it is moved.
+ *
+ * @param pentry     [INOUT] the entry.
+ * @param delay_msec [IN]    delay before expiry.
+ *
+ */
+void timer_wheel_add(timer_wheel_entry_t * pentry, unsigned int delay_msec)
+{
+  P(tw_mutex);
+
+  if(pentry->twe_state == TIMER_WHEEL_QUEUED)
+    pentry->twe_queue->twq_count--;
+  else if(pentry->twe_state == TIMER_WHEEL_ARMED)
+    tw_stats.nb_armed--;
+
+  /* A firing entry is taken off the wheel thread's list, its call back
+   * will not run for this expiry */
+  if(pentry->twe_state != TIMER_WHEEL_IDLE)
+    glist_del(&pentry->twe_list);
+
+  /* Round up so that an entry never fires early */
+  pentry->twe_expire = timer_wheel_now() +
+      (delay_msec + TIMER_WHEEL_TICK_MSEC - 1) / TIMER_WHEEL_TICK_MSEC;
+  pentry->twe_state = TIMER_WHEEL_ARMED;
+
+  timer_wheel_insert_locked(pentry);
+
+  tw_stats.nb_armed++;
+  tw_stats.nb_add++;
+
+  V(tw_mutex);
+}                               /* timer_wheel_add */
+
+/**
+ *
+ * timer_wheel_cancel: disarms an entry.
+ *
+ * An expired entry waiting in a queue, or whose call back has not started
+ * yet, is removed as well. A call back already running is not waited for.
+ *
+ * @param pentry [INOUT] the entry.
+ *
+ * @return 1 if the entry was armed or queued, 0 otherwise.
+ *
+ */
+int timer_wheel_cancel(timer_wheel_entry_t * pentry)
+{
+  int rc = 0;
+
+  P(tw_mutex);
+
+  switch (pentry->twe_state)
+    {
+    case TIMER_WHEEL_ARMED:
+      tw_stats.nb_armed--;
+      rc = 1;
+      break;
+
+    case TIMER_WHEEL_QUEUED:
+      pentry->twe_queue->twq_count--;
+      rc = 1;
+      break;
+
+    case TIMER_WHEEL_FIRING:
+      rc = 1;
+      break;
+
+    case TIMER_WHEEL_IDLE:
+      break;
+    }
+
+  if(rc)
+    {
+      glist_del(&pentry->twe_list);
+      init_glist(&pentry->twe_list);
+      pentry->twe_state = TIMER_WHEEL_IDLE;
+      tw_stats.nb_cancel++;
+    }
+
+  V(tw_mutex);
+
+  return rc;
+}                               /* timer_wheel_cancel */
+
+/**
+ *
+ * timer_wheel_queue_init: initializes a delivery queue.
+ *
+ */
+void timer_wheel_queue_init(timer_wheel_queue_t * pqueue)
+{
+  init_glist(&pqueue->twq_list);
+  pqueue->twq_count = 0;
+}                               /* timer_wheel_queue_init */
+
+/**
+ *
+ * timer_wheel_queue_get: pops the oldest expired entry from a queue.
+ *
+ * @param pqueue [INOUT] the queue.
+ *
+ * @return the entry (now idle), or NULL if the queue is empty.
+ *
+ */
+timer_wheel_entry_t *timer_wheel_queue_get(timer_wheel_queue_t * pqueue)
+{
+  timer_wheel_entry_t *pentry;
+
+  /* Unlocked peek, the owner is the only one to consume */
+  if(pqueue->twq_count == 0)
+    return NULL;
+
+  P(tw_mutex);
+
+  pentry = glist_first_entry(&pqueue->twq_list, timer_wheel_entry_t, twe_list);
+  if(pentry != NULL)
+    {
+      glist_del(&pentry->twe_list);
+      init_glist(&pentry->twe_list);
+      pentry->twe_state = TIMER_WHEEL_IDLE;
+      pqueue->twq_count--;
+    }
+
+  V(tw_mutex);
+
+  return pentry;
+}                               /* timer_wheel_queue_get */
+
+void timer_wheel_get_stats(timer_wheel_stat_t * pstat)
+{
+  P(tw_mutex);
+  *pstat = tw_stats;
+  V(tw_mutex);
+}                               /* timer_wheel_get_stats */
+
+/**
+ *
+ * timer_wheel_set_clock: replaces the clock of the wheel.
+ *
+ * The tests drive the wheel with their own clock, set before
+ * timer_wheel_init.
+ *
+ * @param clock [IN] the new clock, NULL for the real one.
+ *
+ */
+void timer_wheel_set_clock(timer_wheel_clock_t clock)
+{
+  P(tw_mutex);
+  timer_wheel_now = (clock != NULL) ? clock : timer_wheel_real_clock;
+  V(tw_mutex);
+}                               /* timer_wheel_set_clock */
+
+/**
+ *
+ * timer_wheel_tick: processes the ticks elapsed since the last call.
+ *
+ * Every tick, the due root slot is emptied. Queued entries are delivered
+ * under the wheel mutex, call backs are run without it so they may re-arm
+ * their entry.
+ *
+ */
+void timer_wheel_tick(void)
+{
+  struct glist_head expired;
+  struct glist_head *glist, *glistn;
+  timer_wheel_entry_t *pentry;
+  uint64_t target;
+  int level;
+
+  init_glist(&expired);
+
+  P(tw_mutex);
+
+  target = timer_wheel_now();
+
+  while(tw_current <= target)
+    {
+      unsigned int index = tw_current & TIMER_WHEEL_ROOT_MASK;
+
+      /* On root wrap, bring down the entries of the upper levels */
+      if(index == 0)
+        for(level = 1; level < TIMER_WHEEL_NB_LEVELS; level++)
+          if(timer_wheel_cascade_locked(level) != 0)
+            break;
+
+      glist_for_each_safe(glist, glistn, &tw_root[index])
+        {
+          pentry = glist_entry(glist, timer_wheel_entry_t, twe_list);
+          glist_del(glist);
+          tw_stats.nb_armed--;
+          tw_stats.nb_expired++;
+
+          if(pentry->twe_queue != NULL)
+            {
+              pentry->twe_state = TIMER_WHEEL_QUEUED;
+              glist_add_tail(&pentry->twe_queue->twq_list, &pentry->twe_list);
+              pentry->twe_queue->twq_count++;
+            }
+          else
+            {
+              pentry->twe_state = TIMER_WHEEL_FIRING;
+              glist_add_tail(&expired, &pentry->twe_list);
+            }
+        }
+
+      tw_current++;
+    }
+
+  V(tw_mutex);
+
+  /* The entries stay FIRING on expired until their call back is run:
+   * the list is only walked under the mutex, as add and cancel may
+   * take an entry off it meanwhile */
+  while(1)
+    {
+      P(tw_mutex);
+      pentry = glist_first_entry(&expired, timer_wheel_entry_t, twe_list);
+      if(pentry != NULL)
+        {
+          glist_del(&pentry->twe_list);
+          init_glist(&pentry->twe_list);
+          pentry->twe_state = TIMER_WHEEL_IDLE;
+        }
+      V(tw_mutex);
+
+      if(pentry == NULL)
+        break;
+
+      pentry->twe_func(pentry, pentry->twe_arg);
+    }
+}                               /* timer_wheel_tick */
+
+/**
+ *
+ * timer_wheel_thread: runs the wheel, one timer_wheel_tick per tick.
+ *
+ */
+void *timer_wheel_thread(void *arg)
+{
+#ifndef _NO_BUDDY_SYSTEM
+  int rc;
+#endif
+  struct timeval now;
+  struct timespec timeout;
+
+  SetNameFunction("timer_wheel");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogFatal(COMPONENT_THREAD,
+               "Timer wheel thread: Memory manager could not be initialized");
+    }
+  LogInfo(COMPONENT_THREAD,
+          "Timer wheel thread: Memory manager successfully initialized");
+#endif
+
+  while(1)
+    {
+      timer_wheel_tick();
+
+      /* Sleep until the next tick */
+      P(tw_mutex);
+      gettimeofday(&now, NULL);
+      timeout.tv_sec = now.tv_sec;
+      timeout.tv_nsec = (now.tv_usec + TIMER_WHEEL_TICK_MSEC * 1000) * 1000;
+      if(timeout.tv_nsec >= 1000000000)
+        {
+          timeout.tv_sec += timeout.tv_nsec / 1000000000;
+          timeout.tv_nsec %= 1000000000;
+        }
+      pthread_cond_timedwait(&tw_cond, &tw_mutex, &timeout);
+      V(tw_mutex);
+    }
+
+  return NULL;
+}                               /* timer_wheel_thread */